@@ -3,8 +3,11 @@
 #include "stratum/glue/init_google.h"
 #include "stratum/glue/logging.h"
 #include "stratum/hal/lib/nikss/nikss_chassis_manager.h"
+#include "stratum/hal/lib/nikss/nikss_digest_manager.h"
 #include "stratum/hal/lib/nikss/nikss_wrapper.h"
 #include "stratum/hal/lib/nikss/nikss_node.h"
+#include "stratum/hal/lib/nikss/nikss_packetio_manager.h"
+#include "stratum/hal/lib/nikss/nikss_pre_manager.h"
 #include "stratum/hal/lib/nikss/nikss_switch.h"
 #include "stratum/hal/lib/common/hal.h"
 #include "stratum/hal/lib/phal/phal_sim.h"
@@ -14,6 +17,12 @@
 
 // currently we assume only one device_id for NIKSS
 DEFINE_uint32(device_id, 1, "NIKSS device/node id");
+DEFINE_string(nikss_cpu_port_interface, "psa_cpu",
+              "Linux interface attached to the NIKSS pipeline as CPU port. "
+              "PacketIns are received and PacketOuts sent on this interface.");
+DEFINE_uint32(nikss_packet_in_queue_depth, 1024,
+              "Maximum number of PacketIns queued for the controller. Packets "
+              "received while the queue is full are dropped.");
 
 namespace stratum {
 namespace hal {
@@ -27,15 +36,24 @@ namespace nikss {
 
   auto nikss_wrapper = NikssWrapper::CreateSingleton();
 
+  auto nikss_packetio_manager = NikssPacketioManager::CreateInstance(
+      FLAGS_nikss_cpu_port_interface, FLAGS_nikss_packet_in_queue_depth);
+
+  auto nikss_digest_manager =
+      NikssDigestManager::CreateInstance(nikss_wrapper, node_id);
+
+  auto nikss_pre_manager = NikssPreManager::CreateInstance(nikss_wrapper);
+
   auto nikss_node = NikssNode::CreateInstance(
-      nikss_wrapper, node_id);
+      nikss_wrapper, nikss_packetio_manager.get(), nikss_digest_manager.get(),
+      nikss_pre_manager.get(), node_id);
 
   auto* phal_sim = PhalSim::CreateSingleton();
   absl::flat_hash_map<uint64, NikssNode*> node_id_to_nikss_node = {
       {node_id, nikss_node.get()},
   };
   auto nikss_chassis_manager =
-      NikssChassisManager::CreateInstance(phal_sim);
+      NikssChassisManager::CreateInstance(phal_sim, nikss_wrapper);
 
   auto nikss_switch = NikssSwitch::CreateInstance(
       phal_sim, nikss_chassis_manager.get(), node_id_to_nikss_node);
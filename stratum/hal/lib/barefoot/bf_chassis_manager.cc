@@ -1395,7 +1395,8 @@ void BfChassisManager::TransceiverEventHandler(int slot, int port,
   // Writer, and create Reader thread.
   if (!port_status_event_channel_) {
     port_status_event_channel_ =
-        Channel<PortStatusEvent>::Create(kMaxPortStatusEventDepth);
+        Channel<PortStatusEvent>::Create(kMaxPortStatusEventDepth,
+                                         "bf_port_status_events");
     // Create and hand-off Writer to the BfSdeInterface.
     auto writer =
         ChannelWriter<PortStatusEvent>::Create(port_status_event_channel_);
@@ -1426,7 +1427,8 @@ void BfChassisManager::TransceiverEventHandler(int slot, int port,
   // If we have not done that yet, create transceiver module insert/removal
   // event Channel, register ChannelWriter, and create ChannelReader thread.
   if (xcvr_event_writer_id_ == kInvalidWriterId) {
-    xcvr_event_channel_ = Channel<TransceiverEvent>::Create(kMaxXcvrEventDepth);
+    xcvr_event_channel_ = Channel<TransceiverEvent>::Create(
+        kMaxXcvrEventDepth, "bf_xcvr_events");
     // Create and hand-off ChannelWriter to the PhalInterface.
     auto writer = ChannelWriter<TransceiverEvent>::Create(xcvr_event_channel_);
     int priority = PhalInterface::kTransceiverEventWriterPriorityHigh;
@@ -48,6 +48,17 @@ class BfSdeInterface {
 
     // End the current batch.
     virtual ::util::Status EndBatch() = 0;
+
+    // Start a new transaction. All the following operations of the session
+    // are applied at once on commit, or discarded on abort. If 'atomic' is
+    // true, the data plane sees either none or all of the operations.
+    virtual ::util::Status BeginTransaction(bool atomic) = 0;
+
+    // Commit the current transaction.
+    virtual ::util::Status CommitTransaction() = 0;
+
+    // Abort the current transaction, rolling back all its operations.
+    virtual ::util::Status AbortTransaction() = 0;
   };
 
   // TableKeyInterface is a proxy class for BfRt table keys.
@@ -19,6 +19,9 @@ class SessionMock : public BfSdeInterface::SessionInterface {
  public:
   MOCK_METHOD0(BeginBatch, ::util::Status());
   MOCK_METHOD0(EndBatch, ::util::Status());
+  MOCK_METHOD1(BeginTransaction, ::util::Status(bool atomic));
+  MOCK_METHOD0(CommitTransaction, ::util::Status());
+  MOCK_METHOD0(AbortTransaction, ::util::Status());
 };
 
 class TableKeyMock : public BfSdeInterface::TableKeyInterface {
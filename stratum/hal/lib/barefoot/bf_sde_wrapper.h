@@ -117,6 +117,20 @@ class BfSdeWrapper : public BfSdeInterface {
       RETURN_IF_BFRT_ERROR(bfrt_session_->sessionCompleteOperations());
       return ::util::OkStatus();
     }
+    ::util::Status BeginTransaction(bool atomic) override {
+      RETURN_IF_BFRT_ERROR(bfrt_session_->beginTransaction(atomic));
+      return ::util::OkStatus();
+    }
+    ::util::Status CommitTransaction() override {
+      RETURN_IF_BFRT_ERROR(
+          bfrt_session_->commitTransaction(/*hardware sync*/ true));
+      RETURN_IF_BFRT_ERROR(bfrt_session_->sessionCompleteOperations());
+      return ::util::OkStatus();
+    }
+    ::util::Status AbortTransaction() override {
+      RETURN_IF_BFRT_ERROR(bfrt_session_->abortTransaction());
+      return ::util::OkStatus();
+    }
 
     static ::util::StatusOr<std::shared_ptr<BfSdeInterface::SessionInterface>>
     CreateSession() {
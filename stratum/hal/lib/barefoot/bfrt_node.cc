@@ -5,11 +5,18 @@
 
 #include <unistd.h>
 
+#include <algorithm>
+#include <atomic>
 #include <memory>
 #include <string>
 #include <utility>
+#include <vector>
 
+#include "absl/container/flat_hash_map.h"
 #include "absl/memory/memory.h"
+#include "absl/strings/str_cat.h"
+#include "gflags/gflags.h"
+#include "google/protobuf/arena.h"
 #include "stratum/glue/status/status_macros.h"
 #include "stratum/hal/lib/barefoot/bf_pipeline_utils.h"
 #include "stratum/hal/lib/barefoot/bf_sde_interface.h"
@@ -20,10 +27,117 @@
 #include "stratum/lib/utils.h"
 #include "stratum/public/proto/error.pb.h"
 
+DEFINE_int32(bfrt_write_parallelism, 4,
+             "Maximum number of threads concurrently writing the updates of a "
+             "WriteRequest to different P4 objects. 1 writes all the updates "
+             "sequentially.");
+DEFINE_int32(bfrt_parallel_write_min_updates, 256,
+             "Minimum number of updates in a WriteRequest for it to be written "
+             "by multiple threads.");
+DEFINE_int32(bfrt_read_parallelism, 4,
+             "Maximum number of threads concurrently reading the table entries "
+             "of a ReadRequest, e.g. the tables of an expanded wildcard read. "
+             "1 reads all the entities sequentially.");
+
 namespace stratum {
 namespace hal {
 namespace barefoot {
 
+namespace {
+
+// Returns the ID of the P4 object an update writes to, if the update may be
+// written concurrently with the updates to other objects. Returns 0 for updates
+// which have to be written in request order with respect to all the others,
+// e.g. action profile members referenced by subsequent table entries.
+uint32 ConcurrentWriteKey(const ::p4::v1::Entity& entity) {
+  switch (entity.entity_case()) {
+    case ::p4::v1::Entity::kTableEntry:
+      return entity.table_entry().table_id();
+    case ::p4::v1::Entity::kDirectCounterEntry:
+      return entity.direct_counter_entry().table_entry().table_id();
+    case ::p4::v1::Entity::kCounterEntry:
+      return entity.counter_entry().counter_id();
+    case ::p4::v1::Entity::kRegisterEntry:
+      return entity.register_entry().register_id();
+    case ::p4::v1::Entity::kMeterEntry:
+      return entity.meter_entry().meter_id();
+    default:
+      return 0;
+  }
+}
+
+// Streams the responses of concurrent table entry reads to the actual writer
+// in request order. The responses of the first incomplete read are written
+// right away, those of later reads are buffered until all reads before them
+// are complete. Writes to the actual writer are serialized.
+class OrderedReadResponseWriter {
+ public:
+  OrderedReadResponseWriter(size_t num_reads,
+                            WriterInterface<::p4::v1::ReadResponse>* writer)
+      : writer_(writer),
+        head_(0),
+        buffers_(num_reads),
+        complete_(num_reads, false),
+        ok_(true) {}
+
+  // Writes a response of the read at the given position.
+  bool Write(size_t position, const ::p4::v1::ReadResponse& resp)
+      LOCKS_EXCLUDED(lock_) {
+    absl::MutexLock l(&lock_);
+    if (position != head_) {
+      buffers_[position].push_back(resp);
+      return true;
+    }
+    ok_ = ok_ && writer_->Write(resp);
+    return ok_;
+  }
+
+  // Marks the read at the given position as complete and writes the buffered
+  // responses of the reads which are next in order.
+  void Complete(size_t position) LOCKS_EXCLUDED(lock_) {
+    absl::MutexLock l(&lock_);
+    complete_[position] = true;
+    while (head_ < complete_.size() && complete_[head_]) {
+      if (++head_ == complete_.size()) break;
+      for (const auto& resp : buffers_[head_]) {
+        ok_ = ok_ && writer_->Write(resp);
+      }
+      std::vector<::p4::v1::ReadResponse>().swap(buffers_[head_]);
+    }
+  }
+
+  // Returns false if a write to the actual writer failed.
+  bool ok() LOCKS_EXCLUDED(lock_) {
+    absl::MutexLock l(&lock_);
+    return ok_;
+  }
+
+  // Writer for the responses of the read at a given position.
+  class PositionWriter : public WriterInterface<::p4::v1::ReadResponse> {
+   public:
+    PositionWriter(OrderedReadResponseWriter* parent, size_t position)
+        : parent_(parent), position_(position) {}
+    bool Write(const ::p4::v1::ReadResponse& resp) override {
+      return parent_->Write(position_, resp);
+    }
+
+   private:
+    OrderedReadResponseWriter* const parent_;  // not owned by this class.
+    const size_t position_;
+  };
+
+ private:
+  absl::Mutex lock_;
+  WriterInterface<::p4::v1::ReadResponse>* const writer_;  // not owned.
+  // Position of the first incomplete read.
+  size_t head_ GUARDED_BY(lock_);
+  std::vector<std::vector<::p4::v1::ReadResponse>> buffers_ GUARDED_BY(lock_);
+  std::vector<bool> complete_ GUARDED_BY(lock_);
+  bool ok_ GUARDED_BY(lock_);
+};
+
+}  // namespace
+
 BfrtNode::BfrtNode(BfrtTableManager* bfrt_table_manager,
                    BfrtPacketioManager* bfrt_packetio_manager,
                    BfrtPreManager* bfrt_pre_manager,
@@ -188,72 +302,45 @@ std::unique_ptr<BfrtNode> BfrtNode::CreateInstance(
   absl::WriterMutexLock l(&lock_);
   RET_CHECK(req.device_id() == node_id_)
       << "Request device id must be same as id of this BfrtNode.";
-  RET_CHECK(req.atomicity() == ::p4::v1::WriteRequest::CONTINUE_ON_ERROR)
-      << "Request atomicity "
-      << ::p4::v1::WriteRequest::Atomicity_Name(req.atomicity())
-      << " is not supported.";
   if (!initialized_ || !pipeline_initialized_) {
     return MAKE_ERROR(ERR_NOT_INITIALIZED) << "Not initialized!";
   }
 
-  bool success = true;
+  // The status of every update, in request order.
+  std::vector<::util::Status> update_results(req.updates_size());
   ASSIGN_OR_RETURN(auto session, bf_sde_interface_->CreateSession());
-  RETURN_IF_ERROR(session->BeginBatch());
-  for (const auto& update : req.updates()) {
-    ::util::Status status = ::util::OkStatus();
-    switch (update.entity().entity_case()) {
-      case ::p4::v1::Entity::kTableEntry:
-        status = bfrt_table_manager_->WriteTableEntry(
-            session, update.type(), update.entity().table_entry());
-        break;
-      case ::p4::v1::Entity::kExternEntry:
-        status = WriteExternEntry(session, update.type(),
-                                  update.entity().extern_entry());
-        break;
-      case ::p4::v1::Entity::kActionProfileMember:
-        status = bfrt_table_manager_->WriteActionProfileMember(
-            session, update.type(), update.entity().action_profile_member());
-        break;
-      case ::p4::v1::Entity::kActionProfileGroup:
-        status = bfrt_table_manager_->WriteActionProfileGroup(
-            session, update.type(), update.entity().action_profile_group());
-        break;
-      case ::p4::v1::Entity::kPacketReplicationEngineEntry:
-        status = bfrt_pre_manager_->WritePreEntry(
-            session, update.type(),
-            update.entity().packet_replication_engine_entry());
-        break;
-      case ::p4::v1::Entity::kDirectCounterEntry:
-        status = bfrt_table_manager_->WriteDirectCounterEntry(
-            session, update.type(), update.entity().direct_counter_entry());
-        break;
-      case ::p4::v1::Entity::kCounterEntry:
-        status = bfrt_counter_manager_->WriteIndirectCounterEntry(
-            session, update.type(), update.entity().counter_entry());
-        break;
-      case ::p4::v1::Entity::kRegisterEntry: {
-        status = bfrt_table_manager_->WriteRegisterEntry(
-            session, update.type(), update.entity().register_entry());
-        break;
-      }
-      case ::p4::v1::Entity::kMeterEntry: {
-        status = bfrt_table_manager_->WriteMeterEntry(
-            session, update.type(), update.entity().meter_entry());
-        break;
+  switch (req.atomicity()) {
+    case ::p4::v1::WriteRequest::CONTINUE_ON_ERROR:
+      if (FLAGS_bfrt_write_parallelism > 1 &&
+          req.updates_size() >= FLAGS_bfrt_parallel_write_min_updates) {
+        WriteUpdatesConcurrently(session, req, absl::MakeSpan(update_results));
+      } else {
+        RETURN_IF_ERROR(session->BeginBatch());
+        for (int i = 0; i < req.updates_size(); ++i) {
+          update_results[i] = WriteUpdate(session, req.updates(i));
+        }
+        RETURN_IF_ERROR(session->EndBatch());
       }
-      case ::p4::v1::Entity::kDirectMeterEntry:
-      case ::p4::v1::Entity::kValueSetEntry:
-      case ::p4::v1::Entity::kDigestEntry:
-      default:
-        status = MAKE_ERROR(ERR_UNIMPLEMENTED)
-                 << "Unsupported entity type: " << update.ShortDebugString();
-        break;
-    }
+      break;
+    case ::p4::v1::WriteRequest::ROLLBACK_ON_ERROR:
+    case ::p4::v1::WriteRequest::DATAPLANE_ATOMIC:
+      RETURN_IF_ERROR(WriteUpdatesInTransaction(
+          session, req,
+          req.atomicity() == ::p4::v1::WriteRequest::DATAPLANE_ATOMIC,
+          absl::MakeSpan(update_results)));
+      break;
+    default:
+      return MAKE_ERROR(ERR_INVALID_PARAM)
+             << "Request atomicity "
+             << ::p4::v1::WriteRequest::Atomicity_Name(req.atomicity())
+             << " is not supported.";
+  }
+
+  bool success = true;
+  for (const auto& status : update_results) {
     success &= status.ok();
     results->push_back(status);
   }
-  RETURN_IF_ERROR(session->EndBatch());
-
   if (!success) {
     return MAKE_ERROR(ERR_AT_LEAST_ONE_OPER_FAILED)
            << "One or more write operations failed.";
@@ -264,6 +351,177 @@ std::unique_ptr<BfrtNode> BfrtNode::CreateInstance(
   return ::util::OkStatus();
 }
 
+::util::Status BfrtNode::WriteUpdate(
+    std::shared_ptr<BfSdeInterface::SessionInterface> session,
+    const ::p4::v1::Update& update) {
+  switch (update.entity().entity_case()) {
+    case ::p4::v1::Entity::kTableEntry:
+      return bfrt_table_manager_->WriteTableEntry(
+          session, update.type(), update.entity().table_entry());
+    case ::p4::v1::Entity::kExternEntry:
+      return WriteExternEntry(session, update.type(),
+                              update.entity().extern_entry());
+    case ::p4::v1::Entity::kActionProfileMember:
+      return bfrt_table_manager_->WriteActionProfileMember(
+          session, update.type(), update.entity().action_profile_member());
+    case ::p4::v1::Entity::kActionProfileGroup:
+      return bfrt_table_manager_->WriteActionProfileGroup(
+          session, update.type(), update.entity().action_profile_group());
+    case ::p4::v1::Entity::kPacketReplicationEngineEntry:
+      return bfrt_pre_manager_->WritePreEntry(
+          session, update.type(),
+          update.entity().packet_replication_engine_entry());
+    case ::p4::v1::Entity::kDirectCounterEntry:
+      return bfrt_table_manager_->WriteDirectCounterEntry(
+          session, update.type(), update.entity().direct_counter_entry());
+    case ::p4::v1::Entity::kCounterEntry:
+      return bfrt_counter_manager_->WriteIndirectCounterEntry(
+          session, update.type(), update.entity().counter_entry());
+    case ::p4::v1::Entity::kRegisterEntry:
+      return bfrt_table_manager_->WriteRegisterEntry(
+          session, update.type(), update.entity().register_entry());
+    case ::p4::v1::Entity::kMeterEntry:
+      return bfrt_table_manager_->WriteMeterEntry(
+          session, update.type(), update.entity().meter_entry());
+    case ::p4::v1::Entity::kDirectMeterEntry:
+    case ::p4::v1::Entity::kValueSetEntry:
+    case ::p4::v1::Entity::kDigestEntry:
+    default:
+      return MAKE_ERROR(ERR_UNIMPLEMENTED)
+             << "Unsupported entity type: " << update.ShortDebugString();
+  }
+}
+
+::util::Status BfrtNode::WriteUpdatesInTransaction(
+    std::shared_ptr<BfSdeInterface::SessionInterface> session,
+    const ::p4::v1::WriteRequest& req, bool atomic,
+    absl::Span<::util::Status> results) {
+  RETURN_IF_ERROR(session->BeginTransaction(atomic));
+  bfrt_table_manager_->BeginTableEntryCacheTransaction(session);
+  int failed_update = -1;
+  for (int i = 0; i < req.updates_size(); ++i) {
+    results[i] = WriteUpdate(session, req.updates(i));
+    if (!results[i].ok()) {
+      failed_update = i;
+      break;
+    }
+  }
+  std::string abort_reason;
+  if (failed_update < 0) {
+    ::util::Status status = session->CommitTransaction();
+    if (status.ok()) {
+      bfrt_table_manager_->EndTableEntryCacheTransaction(session,
+                                                         /*commit=*/true);
+      return ::util::OkStatus();
+    }
+    abort_reason = absl::StrCat("the transaction failed to commit: ",
+                                status.error_message());
+  } else {
+    abort_reason = absl::StrCat("update ", failed_update, " failed");
+  }
+
+  // Roll back the whole request. Every update but the failed one is reported
+  // as aborted.
+  ::util::Status abort_status = session->AbortTransaction();
+  bfrt_table_manager_->EndTableEntryCacheTransaction(session,
+                                                     /*commit=*/false);
+  const ::util::Status aborted = MAKE_ERROR(ERR_ABORTED).without_logging()
+                                 << "Rolled back as " << abort_reason << ".";
+  for (int i = 0; i < req.updates_size(); ++i) {
+    if (i != failed_update) results[i] = aborted;
+  }
+  if (!abort_status.ok()) {
+    return MAKE_ERROR(ERR_INTERNAL)
+           << "Failed to roll back the write request after " << abort_reason
+           << ": " << abort_status.error_message();
+  }
+
+  return ::util::OkStatus();
+}
+
+void BfrtNode::WriteUpdatesConcurrently(
+    std::shared_ptr<BfSdeInterface::SessionInterface> session,
+    const ::p4::v1::WriteRequest& req, absl::Span<::util::Status> results) {
+  // The request is cut into stages at every update which has to be written in
+  // request order. Such updates are written on their own, once all the
+  // previous updates have been written. Within a stage, the updates to the
+  // same P4 object form a group, which is written sequentially in request
+  // order, while different groups are written concurrently.
+  int begin = 0;
+  while (begin < req.updates_size()) {
+    if (ConcurrentWriteKey(req.updates(begin).entity()) == 0) {
+      const int stage_begin = begin;
+      ::util::Status status = session->BeginBatch();
+      for (; begin < req.updates_size() &&
+             ConcurrentWriteKey(req.updates(begin).entity()) == 0;
+           ++begin) {
+        results[begin] =
+            status.ok() ? WriteUpdate(session, req.updates(begin)) : status;
+      }
+      if (status.ok()) status = session->EndBatch();
+      if (!status.ok()) {
+        // The updates of a batch which failed to be ended may not have been
+        // applied.
+        for (int i = stage_begin; i < begin; ++i) {
+          if (results[i].ok()) results[i] = status;
+        }
+      }
+      continue;
+    }
+    std::vector<std::vector<int>> groups;
+    absl::flat_hash_map<uint32, size_t> key_to_group;
+    for (; begin < req.updates_size(); ++begin) {
+      uint32 key = ConcurrentWriteKey(req.updates(begin).entity());
+      if (key == 0) break;
+      auto it = key_to_group.emplace(key, groups.size()).first;
+      if (it->second == groups.size()) groups.emplace_back();
+      groups[it->second].push_back(begin);
+    }
+    WriteGroupsConcurrently(req, groups, results);
+  }
+}
+
+void BfrtNode::WriteGroupsConcurrently(
+    const ::p4::v1::WriteRequest& req,
+    const std::vector<std::vector<int>>& groups,
+    absl::Span<::util::Status> results) {
+  const int num_workers = std::min<int>(FLAGS_bfrt_write_parallelism,
+                                        static_cast<int>(groups.size()));
+  std::atomic<size_t> next_group(0);
+  // Every worker writes whole groups, in its own session and batch.
+  worker_pool_.Run(num_workers, [this, &req, &groups, &results,
+                                 &next_group]() {
+    size_t g = next_group++;
+    if (g >= groups.size()) return;
+    ::util::Status status;
+    std::shared_ptr<BfSdeInterface::SessionInterface> session;
+    auto session_or = bf_sde_interface_->CreateSession();
+    if (session_or.ok()) {
+      session = session_or.ConsumeValueOrDie();
+      status = session->BeginBatch();
+    } else {
+      status = session_or.status();
+    }
+    std::vector<int> written;
+    for (; g < groups.size(); g = next_group++) {
+      for (int i : groups[g]) {
+        if (status.ok()) {
+          results[i] = WriteUpdate(session, req.updates(i));
+          written.push_back(i);
+        } else {
+          results[i] = status;
+        }
+      }
+    }
+    if (status.ok()) status = session->EndBatch();
+    if (!status.ok()) {
+      for (int i : written) {
+        if (results[i].ok()) results[i] = status;
+      }
+    }
+  });
+}
+
 ::util::Status BfrtNode::ReadForwardingEntries(
     const ::p4::v1::ReadRequest& req,
     WriterInterface<::p4::v1::ReadResponse>* writer,
@@ -277,14 +535,39 @@ std::unique_ptr<BfrtNode> BfrtNode::CreateInstance(
   if (!initialized_ || !pipeline_initialized_) {
     return MAKE_ERROR(ERR_NOT_INITIALIZED) << "Not initialized!";
   }
-  ::p4::v1::ReadResponse resp;
+  // Entities which are not streamed by the managers are collected in a
+  // response allocated on an arena, which is freed at once at the end.
+  ::google::protobuf::Arena arena;
+  auto* resp =
+      ::google::protobuf::Arena::CreateMessage<::p4::v1::ReadResponse>(&arena);
   bool success = true;
   ASSIGN_OR_RETURN(auto session, bf_sde_interface_->CreateSession());
-  for (const auto& entity : req.entities()) {
+  // Multiple table entries, e.g. from an expanded wildcard read, are read
+  // concurrently upfront. Their responses are streamed in request order as
+  // soon as all entries before them are read, ahead of the responses of the
+  // other entities.
+  std::vector<int> table_entry_indices;
+  for (int i = 0; i < req.entities_size(); ++i) {
+    if (req.entities(i).has_table_entry()) table_entry_indices.push_back(i);
+  }
+  std::vector<::util::Status> table_entry_results;
+  if (FLAGS_bfrt_read_parallelism > 1 && table_entry_indices.size() > 1) {
+    table_entry_results.resize(req.entities_size());
+    RET_CHECK(ReadTableEntriesConcurrently(req, table_entry_indices, writer,
+                                           absl::MakeSpan(table_entry_results)))
+        << "Write to stream channel failed.";
+  }
+  for (int i = 0; i < req.entities_size(); ++i) {
+    const auto& entity = req.entities(i);
     switch (entity.entity_case()) {
       case ::p4::v1::Entity::kTableEntry: {
-        auto status = bfrt_table_manager_->ReadTableEntry(
-            session, entity.table_entry(), writer);
+        ::util::Status status;
+        if (table_entry_results.empty()) {
+          status = bfrt_table_manager_->ReadTableEntry(
+              session, entity.table_entry(), writer);
+        } else {
+          status = table_entry_results[i];
+        }
         success &= status.ok();
         details->push_back(status);
         break;
@@ -324,7 +607,7 @@ std::unique_ptr<BfrtNode> BfrtNode::CreateInstance(
           details->push_back(status.status());
           break;
         }
-        resp.add_entities()->mutable_direct_counter_entry()->CopyFrom(
+        resp->add_entities()->mutable_direct_counter_entry()->CopyFrom(
             status.ValueOrDie());
         break;
       }
@@ -361,7 +644,7 @@ std::unique_ptr<BfrtNode> BfrtNode::CreateInstance(
       }
     }
   }
-  RET_CHECK(writer->Write(resp)) << "Write to stream channel failed.";
+  RET_CHECK(writer->Write(*resp)) << "Write to stream channel failed.";
   if (!success) {
     return MAKE_ERROR(ERR_AT_LEAST_ONE_OPER_FAILED)
            << "One or more read operations failed.";
@@ -369,6 +652,36 @@ std::unique_ptr<BfrtNode> BfrtNode::CreateInstance(
   return ::util::OkStatus();
 }
 
+bool BfrtNode::ReadTableEntriesConcurrently(
+    const ::p4::v1::ReadRequest& req, const std::vector<int>& indices,
+    WriterInterface<::p4::v1::ReadResponse>* writer,
+    absl::Span<::util::Status> results) {
+  const int num_workers = std::min<int>(FLAGS_bfrt_read_parallelism,
+                                        static_cast<int>(indices.size()));
+  OrderedReadResponseWriter ordered_writer(indices.size(), writer);
+  std::atomic<size_t> next_index(0);
+  // Every worker reads table entries in its own session.
+  worker_pool_.Run(num_workers, [this, &req, &indices, &ordered_writer,
+                                 &results, &next_index]() {
+    size_t j = next_index++;
+    if (j >= indices.size()) return;
+    auto session_or = bf_sde_interface_->CreateSession();
+    for (; j < indices.size(); j = next_index++) {
+      const int i = indices[j];
+      OrderedReadResponseWriter::PositionWriter position_writer(
+          &ordered_writer, j);
+      results[i] = session_or.ok()
+                       ? bfrt_table_manager_->ReadTableEntry(
+                             session_or.ValueOrDie(),
+                             req.entities(i).table_entry(), &position_writer)
+                       : session_or.status();
+      ordered_writer.Complete(j);
+    }
+  });
+
+  return ordered_writer.ok();
+}
+
 ::util::Status BfrtNode::RegisterStreamMessageResponseWriter(
     const std::shared_ptr<WriterInterface<::p4::v1::StreamMessageResponse>>&
         writer) {
@@ -379,7 +692,9 @@ std::unique_ptr<BfrtNode> BfrtNode::CreateInstance(
   auto packet_in_writer =
       std::make_shared<ProtoOneofWriterWrapper<::p4::v1::StreamMessageResponse,
                                                ::p4::v1::PacketIn>>(
-          writer, &::p4::v1::StreamMessageResponse::mutable_packet);
+          writer,
+          &::p4::v1::StreamMessageResponse::unsafe_arena_set_allocated_packet,
+          &::p4::v1::StreamMessageResponse::unsafe_arena_release_packet);
 
   return bfrt_packetio_manager_->RegisterPacketReceiveWriter(packet_in_writer);
 }
@@ -8,6 +8,7 @@
 #include <vector>
 
 #include "absl/synchronization/mutex.h"
+#include "absl/types/span.h"
 #include "p4/v1/p4runtime.grpc.pb.h"
 #include "p4/v1/p4runtime.pb.h"
 #include "stratum/glue/integral_types.h"
@@ -18,6 +19,7 @@
 #include "stratum/hal/lib/barefoot/bfrt_packetio_manager.h"
 #include "stratum/hal/lib/barefoot/bfrt_pre_manager.h"
 #include "stratum/hal/lib/barefoot/bfrt_table_manager.h"
+#include "stratum/hal/lib/barefoot/bfrt_worker_pool.h"
 #include "stratum/hal/lib/common/common.pb.h"
 #include "stratum/hal/lib/common/writer_interface.h"
 
@@ -91,6 +93,47 @@ class BfrtNode {
            BfrtP4RuntimeTranslator* bfrt_p4runtime_translator,
            BfSdeInterface* bf_sde_interface, int device_id);
 
+  // Writes a single update of a WriteRequest.
+  ::util::Status WriteUpdate(
+      std::shared_ptr<BfSdeInterface::SessionInterface> session,
+      const ::p4::v1::Update& update);
+
+  // Writes all the updates of a WriteRequest in a single SDE transaction of the
+  // given session, which is rolled back as soon as one of the updates fails.
+  // If 'atomic' is true, the transaction is also applied atomically to the
+  // data plane. The status of every update is saved at its index in 'results'.
+  ::util::Status WriteUpdatesInTransaction(
+      std::shared_ptr<BfSdeInterface::SessionInterface> session,
+      const ::p4::v1::WriteRequest& req, bool atomic,
+      absl::Span<::util::Status> results);
+
+  // Writes the updates of a large WriteRequest using up to
+  // FLAGS_bfrt_write_parallelism threads. Updates to the same P4 object and
+  // updates which other updates may depend on are still written in request
+  // order. The status of every update is saved at its index in 'results',
+  // including the errors of the batches the updates are written in.
+  void WriteUpdatesConcurrently(
+      std::shared_ptr<BfSdeInterface::SessionInterface> session,
+      const ::p4::v1::WriteRequest& req, absl::Span<::util::Status> results);
+
+  // Writes every group of update indices sequentially, with the groups
+  // distributed over the threads of worker_pool_, having a session each.
+  void WriteGroupsConcurrently(
+      const ::p4::v1::WriteRequest& req,
+      const std::vector<std::vector<int>>& groups,
+      absl::Span<::util::Status> results);
+
+  // Reads the table entries at the given entity indices of a ReadRequest using
+  // up to FLAGS_bfrt_read_parallelism threads of worker_pool_, each in its own
+  // session. The responses are streamed to 'writer' in request order as soon
+  // as the reads of all entries before them are complete, and the status of
+  // every read is saved at its entity index in 'results'. Returns false if a
+  // write to 'writer' failed.
+  bool ReadTableEntriesConcurrently(
+      const ::p4::v1::ReadRequest& req, const std::vector<int>& indices,
+      WriterInterface<::p4::v1::ReadResponse>* writer,
+      absl::Span<::util::Status> results) SHARED_LOCKS_REQUIRED(lock_);
+
   // Write extern entries like ActionProfile, DirectCounter, PortMetadata
   ::util::Status WriteExternEntry(
       std::shared_ptr<BfSdeInterface::SessionInterface> session,
@@ -144,6 +187,9 @@ class BfrtNode {
   // managed by this class instance. Assigned in the class constructor.
   const int device_id_;
 
+  // Threads writing and reading the entities of large requests concurrently.
+  BfrtWorkerPool worker_pool_;
+
   friend class BfrtNodeTest;
 };
 
@@ -8,6 +8,9 @@
 
 #include "absl/memory/memory.h"
 #include "absl/synchronization/mutex.h"
+#include "absl/synchronization/notification.h"
+#include "absl/time/time.h"
+#include "gflags/gflags.h"
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 #include "stratum/glue/status/canonical_errors.h"
@@ -22,6 +25,10 @@
 #include "stratum/hal/lib/common/writer_mock.h"
 #include "stratum/lib/utils.h"
 
+DECLARE_int32(bfrt_write_parallelism);
+DECLARE_int32(bfrt_parallel_write_min_updates);
+DECLARE_int32(bfrt_read_parallelism);
+
 namespace stratum {
 namespace hal {
 namespace barefoot {
@@ -1015,6 +1022,194 @@ TEST_F(BfrtNodeTest, WriteForwardingEntriesSuccess_DeleteTableEntry) {
   EXPECT_EQ(1U, results.size());
 }
 
+TEST_F(BfrtNodeTest, WriteForwardingEntriesConcurrently) {
+  ::gflags::FlagSaver flag_saver;
+  FLAGS_bfrt_write_parallelism = 2;
+  FLAGS_bfrt_parallel_write_min_updates = 1;
+  ASSERT_NO_FATAL_FAILURE(PushChassisConfigWithCheck());
+  ASSERT_NO_FATAL_FAILURE(PushForwardingPipelineConfigWithCheck());
+
+  // Entries of two tables, with an action profile member in between which has
+  // to be written after the first two entries and before the last one.
+  ::p4::v1::WriteRequest req;
+  auto* table_entry1 = SetupTableEntryToInsert(&req, kNodeId);
+  table_entry1->set_table_id(1);
+  auto* table_entry2 = SetupTableEntryToInsert(&req, kNodeId);
+  table_entry2->set_table_id(2);
+  auto* update = req.add_updates();
+  update->set_type(::p4::v1::Update::INSERT);
+  auto* member = update->mutable_entity()->mutable_action_profile_member();
+  member->set_member_id(kMemberId);
+  auto* table_entry3 = SetupTableEntryToInsert(&req, kNodeId);
+  table_entry3->set_table_id(1);
+  table_entry3->set_priority(10);
+
+  std::shared_ptr<BfSdeInterface::SessionInterface> session_mock =
+      std::make_shared<SessionMock>();
+  EXPECT_CALL(*bf_sde_mock_, CreateSession())
+      .WillRepeatedly(Return(session_mock));
+  {
+    InSequence s;
+    EXPECT_CALL(*bfrt_table_manager_mock_,
+                WriteTableEntry(_, ::p4::v1::Update::INSERT,
+                                EqualsProto(*table_entry1)))
+        .WillOnce(Return(::util::OkStatus()));
+    EXPECT_CALL(*bfrt_table_manager_mock_,
+                WriteActionProfileMember(_, ::p4::v1::Update::INSERT,
+                                         EqualsProto(*member)))
+        .WillOnce(Return(::util::OkStatus()));
+    EXPECT_CALL(*bfrt_table_manager_mock_,
+                WriteTableEntry(_, ::p4::v1::Update::INSERT,
+                                EqualsProto(*table_entry3)))
+        .WillOnce(Return(::util::OkStatus()));
+  }
+  EXPECT_CALL(*bfrt_table_manager_mock_,
+              WriteTableEntry(_, ::p4::v1::Update::INSERT,
+                              EqualsProto(*table_entry2)))
+      .WillOnce(Return(
+          ::util::Status(StratumErrorSpace(), ERR_INVALID_PARAM, kErrorMsg)));
+
+  std::vector<::util::Status> results = {};
+  ::util::Status status = WriteForwardingEntries(req, &results);
+  EXPECT_EQ(ERR_AT_LEAST_ONE_OPER_FAILED, status.error_code());
+  ASSERT_EQ(4U, results.size());
+  EXPECT_OK(results[0]);
+  EXPECT_EQ(ERR_INVALID_PARAM, results[1].error_code());
+  EXPECT_OK(results[2]);
+  EXPECT_OK(results[3]);
+}
+
+TEST_F(BfrtNodeTest, WriteForwardingEntriesConcurrentlyReportsBatchErrors) {
+  ::gflags::FlagSaver flag_saver;
+  FLAGS_bfrt_write_parallelism = 2;
+  FLAGS_bfrt_parallel_write_min_updates = 1;
+  ASSERT_NO_FATAL_FAILURE(PushChassisConfigWithCheck());
+  ASSERT_NO_FATAL_FAILURE(PushForwardingPipelineConfigWithCheck());
+
+  // An action profile member, written in a batch on its own, followed by a
+  // table entry written in the batch of a worker.
+  ::p4::v1::WriteRequest req;
+  auto* update = req.add_updates();
+  update->set_type(::p4::v1::Update::INSERT);
+  auto* member = update->mutable_entity()->mutable_action_profile_member();
+  member->set_member_id(kMemberId);
+  auto* table_entry = SetupTableEntryToInsert(&req, kNodeId);
+  table_entry->set_table_id(1);
+
+  auto session_mock = std::make_shared<SessionMock>();
+  EXPECT_CALL(*bf_sde_mock_, CreateSession())
+      .WillRepeatedly(Return(session_mock));
+  EXPECT_CALL(*session_mock, BeginBatch())
+      .WillRepeatedly(Return(::util::OkStatus()));
+  // The batch of the member fails to be ended. The table entry is still
+  // written.
+  EXPECT_CALL(*session_mock, EndBatch())
+      .WillOnce(Return(
+          ::util::Status(StratumErrorSpace(), ERR_INTERNAL, kErrorMsg)))
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_CALL(*bfrt_table_manager_mock_,
+              WriteActionProfileMember(_, ::p4::v1::Update::INSERT,
+                                       EqualsProto(*member)))
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_CALL(*bfrt_table_manager_mock_,
+              WriteTableEntry(_, ::p4::v1::Update::INSERT,
+                              EqualsProto(*table_entry)))
+      .WillOnce(Return(::util::OkStatus()));
+
+  std::vector<::util::Status> results = {};
+  ::util::Status status = WriteForwardingEntries(req, &results);
+  EXPECT_EQ(ERR_AT_LEAST_ONE_OPER_FAILED, status.error_code());
+  ASSERT_EQ(2U, results.size());
+  EXPECT_EQ(ERR_INTERNAL, results[0].error_code());
+  EXPECT_OK(results[1]);
+}
+
+TEST_F(BfrtNodeTest, WriteForwardingEntriesRollbackOnError) {
+  ASSERT_NO_FATAL_FAILURE(PushChassisConfigWithCheck());
+  ASSERT_NO_FATAL_FAILURE(PushForwardingPipelineConfigWithCheck());
+
+  ::p4::v1::WriteRequest req;
+  req.set_atomicity(::p4::v1::WriteRequest::ROLLBACK_ON_ERROR);
+  auto* table_entry1 = SetupTableEntryToInsert(&req, kNodeId);
+  table_entry1->set_table_id(1);
+  auto* table_entry2 = SetupTableEntryToInsert(&req, kNodeId);
+  table_entry2->set_table_id(2);
+  auto* table_entry3 = SetupTableEntryToInsert(&req, kNodeId);
+  table_entry3->set_table_id(3);
+
+  auto session_mock = std::make_shared<SessionMock>();
+  EXPECT_CALL(*bf_sde_mock_, CreateSession()).WillOnce(Return(session_mock));
+  {
+    InSequence s;
+    EXPECT_CALL(*session_mock, BeginTransaction(false))
+        .WillOnce(Return(::util::OkStatus()));
+    EXPECT_CALL(*bfrt_table_manager_mock_,
+                WriteTableEntry(_, ::p4::v1::Update::INSERT,
+                                EqualsProto(*table_entry1)))
+        .WillOnce(Return(::util::OkStatus()));
+    EXPECT_CALL(*bfrt_table_manager_mock_,
+                WriteTableEntry(_, ::p4::v1::Update::INSERT,
+                                EqualsProto(*table_entry2)))
+        .WillOnce(Return(
+            ::util::Status(StratumErrorSpace(), ERR_INVALID_PARAM, kErrorMsg)));
+    EXPECT_CALL(*session_mock, AbortTransaction())
+        .WillOnce(Return(::util::OkStatus()));
+    EXPECT_CALL(*bfrt_table_manager_mock_,
+                EndTableEntryCacheTransaction(_, false));
+  }
+  EXPECT_CALL(*bfrt_table_manager_mock_,
+              WriteTableEntry(_, _, EqualsProto(*table_entry3)))
+      .Times(0);
+  EXPECT_CALL(*session_mock, CommitTransaction()).Times(0);
+
+  std::vector<::util::Status> results = {};
+  ::util::Status status = WriteForwardingEntries(req, &results);
+  EXPECT_EQ(ERR_AT_LEAST_ONE_OPER_FAILED, status.error_code());
+  ASSERT_EQ(3U, results.size());
+  EXPECT_EQ(ERR_ABORTED, results[0].error_code());
+  EXPECT_EQ(ERR_INVALID_PARAM, results[1].error_code());
+  EXPECT_EQ(ERR_ABORTED, results[2].error_code());
+}
+
+TEST_F(BfrtNodeTest, WriteForwardingEntriesDataplaneAtomic) {
+  ASSERT_NO_FATAL_FAILURE(PushChassisConfigWithCheck());
+  ASSERT_NO_FATAL_FAILURE(PushForwardingPipelineConfigWithCheck());
+
+  ::p4::v1::WriteRequest req;
+  req.set_atomicity(::p4::v1::WriteRequest::DATAPLANE_ATOMIC);
+  auto* table_entry1 = SetupTableEntryToInsert(&req, kNodeId);
+  table_entry1->set_table_id(1);
+  auto* table_entry2 = SetupTableEntryToInsert(&req, kNodeId);
+  table_entry2->set_table_id(2);
+
+  auto session_mock = std::make_shared<SessionMock>();
+  EXPECT_CALL(*bf_sde_mock_, CreateSession()).WillOnce(Return(session_mock));
+  {
+    InSequence s;
+    EXPECT_CALL(*session_mock, BeginTransaction(true))
+        .WillOnce(Return(::util::OkStatus()));
+    EXPECT_CALL(*bfrt_table_manager_mock_,
+                WriteTableEntry(_, ::p4::v1::Update::INSERT,
+                                EqualsProto(*table_entry1)))
+        .WillOnce(Return(::util::OkStatus()));
+    EXPECT_CALL(*bfrt_table_manager_mock_,
+                WriteTableEntry(_, ::p4::v1::Update::INSERT,
+                                EqualsProto(*table_entry2)))
+        .WillOnce(Return(::util::OkStatus()));
+    EXPECT_CALL(*session_mock, CommitTransaction())
+        .WillOnce(Return(::util::OkStatus()));
+    EXPECT_CALL(*bfrt_table_manager_mock_,
+                EndTableEntryCacheTransaction(_, true));
+  }
+  EXPECT_CALL(*session_mock, AbortTransaction()).Times(0);
+
+  std::vector<::util::Status> results = {};
+  EXPECT_OK(WriteForwardingEntries(req, &results));
+  ASSERT_EQ(2U, results.size());
+  EXPECT_OK(results[0]);
+  EXPECT_OK(results[1]);
+}
+
 TEST_F(BfrtNodeTest, WriteForwardingEntriesSuccess_InsertActionProfileMember) {
   ASSERT_NO_FATAL_FAILURE(PushChassisConfigWithCheck());
   ASSERT_NO_FATAL_FAILURE(PushForwardingPipelineConfigWithCheck());
@@ -1410,6 +1605,128 @@ TEST_F(BfrtNodeTest, ReadForwardingEntriesSuccess_TableEntry) {
   EXPECT_EQ(1U, results.size());
 }
 
+TEST_F(BfrtNodeTest, ReadForwardingEntriesConcurrently) {
+  ::gflags::FlagSaver flag_saver;
+  FLAGS_bfrt_read_parallelism = 2;
+  ASSERT_NO_FATAL_FAILURE(PushChassisConfigWithCheck());
+  ASSERT_NO_FATAL_FAILURE(PushForwardingPipelineConfigWithCheck());
+
+  ::p4::v1::ReadRequest req;
+  auto* table_entry1 = SetupTableEntryToRead(&req, kNodeId);
+  table_entry1->set_table_id(1);
+  auto* table_entry2 = SetupTableEntryToRead(&req, kNodeId);
+  table_entry2->set_table_id(2);
+  auto* table_entry3 = SetupTableEntryToRead(&req, kNodeId);
+  table_entry3->set_table_id(3);
+
+  // Every table entry read responds with the table entry itself.
+  auto response = [](const ::p4::v1::TableEntry& table_entry) {
+    ::p4::v1::ReadResponse resp;
+    *resp.add_entities()->mutable_table_entry() = table_entry;
+    return resp;
+  };
+  auto write_response = [&response](
+                            const ::p4::v1::TableEntry& table_entry,
+                            WriterInterface<::p4::v1::ReadResponse>* writer) {
+    EXPECT_TRUE(writer->Write(response(table_entry)));
+    return ::util::OkStatus();
+  };
+
+  // The responses are streamed in request order, whichever read completes
+  // first, followed by the response of the other entities.
+  WriterMock<::p4::v1::ReadResponse> writer_mock;
+  {
+    InSequence sequence;
+    EXPECT_CALL(writer_mock, Write(EqualsProto(response(*table_entry1))))
+        .WillOnce(Return(true));
+    EXPECT_CALL(writer_mock, Write(EqualsProto(response(*table_entry3))))
+        .WillOnce(Return(true));
+    EXPECT_CALL(writer_mock, Write(EqualsProto(::p4::v1::ReadResponse())))
+        .WillOnce(Return(true));
+  }
+  std::shared_ptr<BfSdeInterface::SessionInterface> session_mock =
+      std::make_shared<SessionMock>();
+  EXPECT_CALL(*bf_sde_mock_, CreateSession())
+      .WillRepeatedly(Return(session_mock));
+  EXPECT_CALL(*bfrt_table_manager_mock_,
+              ReadTableEntry(_, EqualsProto(*table_entry1), _))
+      .WillOnce(WithArgs<1, 2>(Invoke(write_response)));
+  EXPECT_CALL(*bfrt_table_manager_mock_,
+              ReadTableEntry(_, EqualsProto(*table_entry2), _))
+      .WillOnce(Return(
+          ::util::Status(StratumErrorSpace(), ERR_INVALID_PARAM, kErrorMsg)));
+  EXPECT_CALL(*bfrt_table_manager_mock_,
+              ReadTableEntry(_, EqualsProto(*table_entry3), _))
+      .WillOnce(WithArgs<1, 2>(Invoke(write_response)));
+
+  std::vector<::util::Status> results = {};
+  ::util::Status status = ReadForwardingEntries(req, &writer_mock, &results);
+  EXPECT_EQ(ERR_AT_LEAST_ONE_OPER_FAILED, status.error_code());
+  ASSERT_EQ(3U, results.size());
+  EXPECT_OK(results[0]);
+  EXPECT_EQ(ERR_INVALID_PARAM, results[1].error_code());
+  EXPECT_OK(results[2]);
+}
+
+TEST_F(BfrtNodeTest, ReadForwardingEntriesStreamsCompletedTables) {
+  ::gflags::FlagSaver flag_saver;
+  FLAGS_bfrt_read_parallelism = 2;
+  ASSERT_NO_FATAL_FAILURE(PushChassisConfigWithCheck());
+  ASSERT_NO_FATAL_FAILURE(PushForwardingPipelineConfigWithCheck());
+
+  ::p4::v1::ReadRequest req;
+  auto* table_entry1 = SetupTableEntryToRead(&req, kNodeId);
+  table_entry1->set_table_id(1);
+  auto* table_entry2 = SetupTableEntryToRead(&req, kNodeId);
+  table_entry2->set_table_id(2);
+  ::p4::v1::ReadResponse resp1;
+  *resp1.add_entities()->mutable_table_entry() = *table_entry1;
+  ::p4::v1::ReadResponse resp2;
+  *resp2.add_entities()->mutable_table_entry() = *table_entry2;
+
+  // The response of the first table is streamed while the second table is
+  // still being read.
+  absl::Notification first_table_written;
+  WriterMock<::p4::v1::ReadResponse> writer_mock;
+  {
+    InSequence sequence;
+    EXPECT_CALL(writer_mock, Write(EqualsProto(resp1)))
+        .WillOnce(DoAll(Invoke([&first_table_written](
+                                   const ::p4::v1::ReadResponse&) {
+                          first_table_written.Notify();
+                        }),
+                        Return(true)));
+    EXPECT_CALL(writer_mock, Write(EqualsProto(resp2))).WillOnce(Return(true));
+    EXPECT_CALL(writer_mock, Write(EqualsProto(::p4::v1::ReadResponse())))
+        .WillOnce(Return(true));
+  }
+  std::shared_ptr<BfSdeInterface::SessionInterface> session_mock =
+      std::make_shared<SessionMock>();
+  EXPECT_CALL(*bf_sde_mock_, CreateSession())
+      .WillRepeatedly(Return(session_mock));
+  EXPECT_CALL(*bfrt_table_manager_mock_,
+              ReadTableEntry(_, EqualsProto(*table_entry1), _))
+      .WillOnce(WithArgs<2>(
+          Invoke([&resp1](WriterInterface<::p4::v1::ReadResponse>* writer) {
+            EXPECT_TRUE(writer->Write(resp1));
+            return ::util::OkStatus();
+          })));
+  EXPECT_CALL(*bfrt_table_manager_mock_,
+              ReadTableEntry(_, EqualsProto(*table_entry2), _))
+      .WillOnce(WithArgs<2>(Invoke(
+          [&resp2, &first_table_written](
+              WriterInterface<::p4::v1::ReadResponse>* writer) {
+            EXPECT_TRUE(first_table_written.WaitForNotificationWithTimeout(
+                absl::Seconds(10)));
+            EXPECT_TRUE(writer->Write(resp2));
+            return ::util::OkStatus();
+          })));
+
+  std::vector<::util::Status> results = {};
+  EXPECT_OK(ReadForwardingEntries(req, &writer_mock, &results));
+  ASSERT_EQ(2U, results.size());
+}
+
 // RegisterStreamMessageResponseWriter() should forward the call to
 // BfrtPacketioManager and return success or error based on the returned result.
 TEST_F(BfrtNodeTest, RegisterStreamMessageResponseWriter) {
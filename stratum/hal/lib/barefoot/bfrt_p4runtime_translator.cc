@@ -522,22 +522,29 @@ BfrtP4RuntimeTranslator::TranslatePacketMetadata(
 
 ::util::StatusOr<::p4::v1::PacketIn> BfrtP4RuntimeTranslator::TranslatePacketIn(
     const ::p4::v1::PacketIn& packet_in) {
+  ::p4::v1::PacketIn translated_packet_in(packet_in);
+  RETURN_IF_ERROR(TranslatePacketInInPlace(&translated_packet_in));
+  return translated_packet_in;
+}
+
+::util::Status BfrtP4RuntimeTranslator::TranslatePacketInInPlace(
+    ::p4::v1::PacketIn* packet_in) {
   absl::ReaderMutexLock l(&lock_);
   if (!pipeline_require_translation_) {
-    return packet_in;
+    return ::util::OkStatus();
   }
-  ::p4::v1::PacketIn translated_packet_in(packet_in);
-  for (auto& md : *translated_packet_in.mutable_metadata()) {
+  for (auto& md : *packet_in->mutable_metadata()) {
     const std::string* uri =
         gtl::FindOrNull(packet_in_meta_to_type_uri_, md.metadata_id());
     const int32* bit_width =
         gtl::FindOrNull(packet_in_meta_to_bit_width_, md.metadata_id());
     if (uri && bit_width) {
-      ASSIGN_OR_RETURN(
-          md, TranslatePacketMetadata(md, *uri, *bit_width, /*to_sdk=*/false))
+      ASSIGN_OR_RETURN(*md.mutable_value(),
+                       TranslateValue(md.value(), *uri, /*to_sdk=*/false,
+                                      *bit_width));
     }
   }
-  return translated_packet_in;
+  return ::util::OkStatus();
 }
 
 ::util::StatusOr<::p4::v1::PacketOut>
@@ -63,6 +63,10 @@ class BfrtP4RuntimeTranslator {
       LOCKS_EXCLUDED(lock_);
   virtual ::util::StatusOr<::p4::v1::PacketIn> TranslatePacketIn(
       const ::p4::v1::PacketIn& packet_in) LOCKS_EXCLUDED(lock_);
+  // Same as TranslatePacketIn, but translates the metadata of the given
+  // PacketIn in place instead of returning a copy of the whole packet.
+  virtual ::util::Status TranslatePacketInInPlace(::p4::v1::PacketIn* packet_in)
+      LOCKS_EXCLUDED(lock_);
   virtual ::util::StatusOr<::p4::v1::PacketOut> TranslatePacketOut(
       const ::p4::v1::PacketOut& packet_out) LOCKS_EXCLUDED(lock_);
   // A helper function which removes custom type from the P4Info.
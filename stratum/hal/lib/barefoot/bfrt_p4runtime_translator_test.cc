@@ -1254,6 +1254,32 @@ TEST_F(BfrtP4RuntimeTranslatorTest, PacketIn) {
                        &BfrtP4RuntimeTranslator::TranslatePacketIn);
 }
 
+TEST_F(BfrtP4RuntimeTranslatorTest, PacketInInPlace) {
+  EXPECT_OK(PushChassisConfig());
+  EXPECT_OK(PushForwardingPipelineConfig());
+  const char packet_in_str[] = R"pb(
+    payload: "<raw packet>"
+    metadata {
+      metadata_id: 1
+      value: "\x01\x2C" # ingress port
+    }
+  )pb";
+  const char expected_packet_in_str[] = R"pb(
+    payload: "<raw packet>"
+    metadata {
+      metadata_id: 1
+      value: "\x01" # ingress port
+    }
+  )pb";
+  ::p4::v1::PacketIn packet_in;
+  ::p4::v1::PacketIn expected_packet_in;
+  EXPECT_OK(ParseProtoFromString(packet_in_str, &packet_in));
+  EXPECT_OK(ParseProtoFromString(expected_packet_in_str, &expected_packet_in));
+
+  EXPECT_OK(bfrt_p4runtime_translator_->TranslatePacketInInPlace(&packet_in));
+  EXPECT_THAT(packet_in, EqualsProto(expected_packet_in));
+}
+
 // Counter entry
 TEST_F(BfrtP4RuntimeTranslatorTest, WriteCounterEntry) {
   EXPECT_OK(PushChassisConfig());
@@ -12,6 +12,7 @@
 #include <deque>
 #include <string>
 
+#include "google/protobuf/arena.h"
 #include "stratum/glue/gtl/map_util.h"
 #include "stratum/hal/lib/common/constants.h"
 #include "stratum/hal/lib/p4/utils.h"
@@ -74,7 +75,8 @@ std::unique_ptr<BfrtPacketioManager> BfrtPacketioManager::CreateInstance(
   // PushForwardingPipelineConfig resets the bf_pkt driver.
   RETURN_IF_ERROR(bf_sde_interface_->StartPacketIo(device_));
   if (!initialized_) {
-    packet_receive_channel_ = Channel<std::string>::Create(128);
+    packet_receive_channel_ =
+        Channel<std::string>::Create(128, "bfrt_packet_rx");
     if (sde_rx_thread_id_ == 0) {
       int ret = pthread_create(&sde_rx_thread_id_, nullptr,
                                &BfrtPacketioManager::SdeRxThreadFunc, this);
@@ -311,8 +313,13 @@ class BitBuffer {
     reader = ChannelReader<std::string>::Create(packet_receive_channel_);
   }
 
+  // The parsed PacketIns are allocated on an arena that is reset after every
+  // packet, so that its blocks are reused instead of allocating the metadata
+  // of every packet on the heap.
+  ::google::protobuf::Arena arena;
+  std::string buffer;
   while (true) {
-    std::string buffer;
+    arena.Reset();
     int code = reader->Read(&buffer, absl::InfiniteDuration()).error_code();
     if (code == ERR_CANCELLED) break;
     if (code == ERR_ENTRY_NOT_FOUND) {
@@ -320,23 +327,25 @@ class BitBuffer {
       continue;
     }
 
-    ::p4::v1::PacketIn packet_in;
-    ::util::Status status = ParsePacketIn(buffer, &packet_in);
+    auto* packet_in =
+        ::google::protobuf::Arena::CreateMessage<::p4::v1::PacketIn>(&arena);
+    ::util::Status status = ParsePacketIn(buffer, packet_in);
     if (!status.ok()) {
       LOG(ERROR) << "ParsePacketIn failed: " << status;
       continue;
     }
-    const auto& translated_packet_in =
-        bfrt_p4runtime_translator_->TranslatePacketIn(packet_in);
-    if (!translated_packet_in.ok()) {
+    // The metadata is translated in place, so that the packet is passed on to
+    // the writer without being copied out of the arena.
+    status = bfrt_p4runtime_translator_->TranslatePacketInInPlace(packet_in);
+    if (!status.ok()) {
       LOG(ERROR) << "TranslatePacketIn failed: " << status;
       continue;
     }
     {
       absl::WriterMutexLock l(&rx_writer_lock_);
-      rx_writer_->Write(translated_packet_in.ValueOrDie());
+      rx_writer_->Write(*packet_in);
     }
-    VLOG(1) << "Handled PacketIn: " << packet_in.ShortDebugString();
+    VLOG(1) << "Handled PacketIn: " << packet_in->ShortDebugString();
   }
 
   return ::util::OkStatus();
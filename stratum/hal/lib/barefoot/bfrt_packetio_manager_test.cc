@@ -26,8 +26,8 @@ using ::testing::DoAll;
 using ::testing::HasSubstr;
 using ::testing::Invoke;
 using ::testing::InvokeWithoutArgs;
+using ::testing::Pointee;
 using ::testing::Return;
-using ::testing::ReturnArg;
 
 class BfrtPacketioManagerTest : public ::testing::Test {
  protected:
@@ -347,10 +347,10 @@ TEST_F(BfrtPacketioManagerTest, TestPacketIn) {
               return false;
             }
           }));
-  EXPECT_CALL(*bfrt_p4runtime_translator_mock_,
-              TranslatePacketIn(EqualsProto(expected_packet_in)))
-      .WillOnce(
-          Return(::util::StatusOr<::p4::v1::PacketIn>(expected_packet_in)));
+  EXPECT_CALL(
+      *bfrt_p4runtime_translator_mock_,
+      TranslatePacketInInPlace(Pointee(EqualsProto(expected_packet_in))))
+      .WillOnce(Return(::util::OkStatus()));
   EXPECT_OK(packet_rx_writer->Write(packet_from_asic, absl::Milliseconds(100)));
 
   // Here we need to wait until we receive and verify the packet from the mock
@@ -377,8 +377,8 @@ TEST_F(BfrtPacketioManagerTest, MalformedPacketInShouldNotStopRxThread) {
           return false;
         }
       }));
-  EXPECT_CALL(*bfrt_p4runtime_translator_mock_, TranslatePacketIn(_))
-      .WillRepeatedly(ReturnArg<0>());
+  EXPECT_CALL(*bfrt_p4runtime_translator_mock_, TranslatePacketInInPlace(_))
+      .WillRepeatedly(Return(::util::OkStatus()));
   const std::string malformed_packet_from_asic("\0",  // metadata too short
                                                1);
   const std::string valid_packet_from_asic(
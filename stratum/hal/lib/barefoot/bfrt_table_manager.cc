@@ -12,6 +12,7 @@
 #include "absl/synchronization/notification.h"
 #include "gflags/gflags.h"
 #include "p4/config/v1/p4info.pb.h"
+#include "stratum/glue/gtl/map_util.h"
 #include "stratum/glue/status/status_macros.h"
 #include "stratum/hal/lib/barefoot/bfrt_constants.h"
 #include "stratum/hal/lib/barefoot/utils.h"
@@ -22,11 +23,45 @@ DEFINE_uint32(
     bfrt_table_sync_timeout_ms,
     stratum::hal::barefoot::kDefaultSyncTimeout / absl::Milliseconds(1),
     "The timeout for table sync operation like counters and registers.");
+DEFINE_bool(bfrt_table_entry_cache, false,
+            "If true, a shadow copy of all the table entries written by "
+            "P4Runtime is kept and table entry reads not asking for counter "
+            "or meter data are served from it, without querying the SDE. Only "
+            "enable if the non-const tables are exclusively programmed via "
+            "P4Runtime.");
 
 namespace stratum {
 namespace hal {
 namespace barefoot {
 
+namespace {
+
+// Returns a copy of the given table entry with only the fields read back
+// from the SDE, and the match fields sorted by ID.
+::p4::v1::TableEntry NormalizeTableEntry(const ::p4::v1::TableEntry& entry) {
+  ::p4::v1::TableEntry result;
+  result.set_table_id(entry.table_id());
+  *result.mutable_match() = entry.match();
+  std::sort(result.mutable_match()->begin(), result.mutable_match()->end(),
+            [](const ::p4::v1::FieldMatch& a, const ::p4::v1::FieldMatch& b) {
+              return a.field_id() < b.field_id();
+            });
+  if (entry.has_action()) *result.mutable_action() = entry.action();
+  result.set_priority(entry.priority());
+  return result;
+}
+
+// Returns the key of a normalized table entry within its table, made of the
+// match fields and the priority.
+std::string TableEntryCacheKey(const ::p4::v1::TableEntry& entry) {
+  ::p4::v1::TableEntry key;
+  *key.mutable_match() = entry.match();
+  key.set_priority(entry.priority());
+  return key.SerializeAsString();
+}
+
+}  // namespace
+
 BfrtTableManager::BfrtTableManager(
     OperationMode mode, BfSdeInterface* bf_sde_interface,
     BfrtP4RuntimeTranslator* bfrt_p4runtime_translator, int device)
@@ -34,6 +69,7 @@ BfrtTableManager::BfrtTableManager(
       bf_sde_interface_(ABSL_DIE_IF_NULL(bf_sde_interface)),
       bfrt_p4runtime_translator_(ABSL_DIE_IF_NULL(bfrt_p4runtime_translator)),
       p4_info_manager_(nullptr),
+      table_entry_cache_enabled_(FLAGS_bfrt_table_entry_cache),
       device_(device) {}
 
 BfrtTableManager::BfrtTableManager()
@@ -41,6 +77,7 @@ BfrtTableManager::BfrtTableManager()
       bf_sde_interface_(nullptr),
       bfrt_p4runtime_translator_(nullptr),
       p4_info_manager_(nullptr),
+      table_entry_cache_enabled_(false),
       device_(-1) {}
 
 BfrtTableManager::~BfrtTableManager() = default;
@@ -62,6 +99,11 @@ std::unique_ptr<BfrtTableManager> BfrtTableManager::CreateInstance(
       absl::make_unique<P4InfoManager>(p4_info);
   RETURN_IF_ERROR(p4_info_manager->InitializeAndVerify());
   p4_info_manager_ = std::move(p4_info_manager);
+  {
+    // The SDE tables are empty after a pipeline push.
+    absl::MutexLock cache_lock(&cache_lock_);
+    table_entry_cache_.clear();
+  }
 
   return ::util::OkStatus();
 }
@@ -292,6 +334,9 @@ std::unique_ptr<BfrtTableManager> BfrtTableManager::CreateInstance(
                << "Unsupported update type: " << type << " in table entry "
                << translated_table_entry.ShortDebugString() << ".";
     }
+    if (table_entry_cache_enabled_) {
+      UpdateTableEntryCache(session, type, translated_table_entry);
+    }
   } else {
     RET_CHECK(type == ::p4::v1::Update::MODIFY)
         << "The table default entry can only be modified.";
@@ -317,6 +362,125 @@ std::unique_ptr<BfrtTableManager> BfrtTableManager::CreateInstance(
   return ::util::OkStatus();
 }
 
+bool BfrtTableManager::IsTableEntryCached(
+    const ::p4::v1::TableEntry& table_entry) {
+  if (!table_entry_cache_enabled_) return false;
+  if (table_entry.has_counter_data() || table_entry.has_meter_config()) {
+    return false;
+  }
+  // Const tables are populated by the P4 program and not through writes.
+  auto table = p4_info_manager_->FindTableByID(table_entry.table_id());
+  return table.ok() && !table.ValueOrDie().is_const_table();
+}
+
+void BfrtTableManager::UpdateTableEntryCache(
+    std::shared_ptr<BfSdeInterface::SessionInterface> session,
+    const ::p4::v1::Update::Type type,
+    const ::p4::v1::TableEntry& table_entry) {
+  ::p4::v1::TableEntry cached_entry = NormalizeTableEntry(table_entry);
+  std::string key = TableEntryCacheKey(cached_entry);
+  absl::MutexLock l(&cache_lock_);
+  auto& table_cache = table_entry_cache_[table_entry.table_id()];
+  auto* undo_log = gtl::FindOrNull(cache_undo_logs_, session.get());
+  if (undo_log != nullptr) {
+    TableEntryCacheUndo undo{table_entry.table_id(), key, absl::nullopt};
+    const auto* previous_entry = gtl::FindOrNull(table_cache, key);
+    if (previous_entry != nullptr) undo.table_entry = *previous_entry;
+    undo_log->push_back(std::move(undo));
+  }
+  if (type == ::p4::v1::Update::DELETE) {
+    table_cache.erase(key);
+  } else {
+    table_cache[std::move(key)] = std::move(cached_entry);
+  }
+}
+
+void BfrtTableManager::BeginTableEntryCacheTransaction(
+    std::shared_ptr<BfSdeInterface::SessionInterface> session) {
+  if (!table_entry_cache_enabled_) return;
+  absl::MutexLock l(&cache_lock_);
+  cache_undo_logs_[session.get()].clear();
+}
+
+void BfrtTableManager::EndTableEntryCacheTransaction(
+    std::shared_ptr<BfSdeInterface::SessionInterface> session, bool commit) {
+  if (!table_entry_cache_enabled_) return;
+  absl::MutexLock l(&cache_lock_);
+  auto it = cache_undo_logs_.find(session.get());
+  if (it == cache_undo_logs_.end()) return;
+  if (!commit) {
+    // Revert the changes in reverse order.
+    for (auto undo = it->second.rbegin(); undo != it->second.rend(); ++undo) {
+      auto& table_cache = table_entry_cache_[undo->table_id];
+      if (undo->table_entry.has_value()) {
+        table_cache[undo->key] = std::move(*undo->table_entry);
+      } else {
+        table_cache.erase(undo->key);
+      }
+    }
+  }
+  cache_undo_logs_.erase(it);
+}
+
+::util::Status BfrtTableManager::ReadCachedTableEntry(
+    const ::p4::v1::TableEntry& table_entry,
+    WriterInterface<::p4::v1::ReadResponse>* writer) {
+  ::p4::v1::ReadResponse resp;
+  {
+    const std::string key =
+        TableEntryCacheKey(NormalizeTableEntry(table_entry));
+    absl::MutexLock l(&cache_lock_);
+    const auto* table_cache =
+        gtl::FindOrNull(table_entry_cache_, table_entry.table_id());
+    const auto* cached_entry =
+        table_cache ? gtl::FindOrNull(*table_cache, key) : nullptr;
+    if (cached_entry == nullptr) {
+      return MAKE_ERROR(ERR_ENTRY_NOT_FOUND)
+             << "Table entry " << table_entry.ShortDebugString()
+             << " not found.";
+    }
+    *resp.add_entities()->mutable_table_entry() = *cached_entry;
+  }
+  auto* entry = resp.mutable_entities(0)->mutable_table_entry();
+  ASSIGN_OR_RETURN(*entry, bfrt_p4runtime_translator_->TranslateTableEntry(
+                               *entry, /*to_sdk=*/false));
+  VLOG(1) << "ReadCachedTableEntry resp " << resp.DebugString();
+  if (!writer->Write(resp)) {
+    return MAKE_ERROR(ERR_INTERNAL) << "Write to stream for failed.";
+  }
+
+  return ::util::OkStatus();
+}
+
+::util::Status BfrtTableManager::ReadCachedTableEntries(
+    const ::p4::v1::TableEntry& table_entry,
+    WriterInterface<::p4::v1::ReadResponse>* writer) {
+  ::p4::v1::ReadResponse resp;
+  {
+    // Only the entries are copied under the lock, translation is done after.
+    absl::MutexLock l(&cache_lock_);
+    const auto* table_cache =
+        gtl::FindOrNull(table_entry_cache_, table_entry.table_id());
+    if (table_cache != nullptr) {
+      resp.mutable_entities()->Reserve(table_cache->size());
+      for (const auto& e : *table_cache) {
+        *resp.add_entities()->mutable_table_entry() = e.second;
+      }
+    }
+  }
+  for (auto& entity : *resp.mutable_entities()) {
+    auto* entry = entity.mutable_table_entry();
+    ASSIGN_OR_RETURN(*entry, bfrt_p4runtime_translator_->TranslateTableEntry(
+                                 *entry, /*to_sdk=*/false));
+  }
+  VLOG(1) << "ReadCachedTableEntries resp " << resp.DebugString();
+  if (!writer->Write(resp)) {
+    return MAKE_ERROR(ERR_INTERNAL) << "Write to stream for failed.";
+  }
+
+  return ::util::OkStatus();
+}
+
 // TODO(max): the need for the original request might go away when the table
 // data is correctly initialized with only the fields we care about.
 ::util::StatusOr<::p4::v1::TableEntry> BfrtTableManager::BuildP4TableEntry(
@@ -446,6 +610,9 @@ std::unique_ptr<BfrtTableManager> BfrtTableManager::CreateInstance(
     std::shared_ptr<BfSdeInterface::SessionInterface> session,
     const ::p4::v1::TableEntry& table_entry,
     WriterInterface<::p4::v1::ReadResponse>* writer) {
+  if (IsTableEntryCached(table_entry)) {
+    return ReadCachedTableEntry(table_entry, writer);
+  }
   ASSIGN_OR_RETURN(uint32 table_id,
                    bf_sde_interface_->GetBfRtId(table_entry.table_id()));
   ASSIGN_OR_RETURN(auto table_key, bf_sde_interface_->CreateTableKey(table_id));
@@ -519,6 +686,9 @@ std::unique_ptr<BfrtTableManager> BfrtTableManager::CreateInstance(
       << "Metadata filters on wildcard reads are not supported.";
   RET_CHECK(table_entry.is_default_action() == false)
       << "Default action filters on wildcard reads are not supported.";
+  if (IsTableEntryCached(table_entry)) {
+    return ReadCachedTableEntries(table_entry, writer);
+  }
 
   ASSIGN_OR_RETURN(uint32 table_id,
                    bf_sde_interface_->GetBfRtId(table_entry.table_id()));
@@ -527,6 +697,7 @@ std::unique_ptr<BfrtTableManager> BfrtTableManager::CreateInstance(
   RETURN_IF_ERROR(bf_sde_interface_->GetAllTableEntries(
       device_, session, table_id, &keys, &datas));
   ::p4::v1::ReadResponse resp;
+  resp.mutable_entities()->Reserve(keys.size());
   for (size_t i = 0; i < keys.size(); ++i) {
     const std::unique_ptr<BfSdeInterface::TableKeyInterface>& table_key =
         keys[i];
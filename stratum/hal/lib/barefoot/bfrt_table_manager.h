@@ -4,10 +4,12 @@
 #define STRATUM_HAL_LIB_BAREFOOT_BFRT_TABLE_MANAGER_H_
 
 #include <memory>
+#include <string>
 #include <vector>
 
 #include "absl/container/flat_hash_map.h"
 #include "absl/synchronization/mutex.h"
+#include "absl/types/optional.h"
 #include "p4/v1/p4runtime.grpc.pb.h"
 #include "p4/v1/p4runtime.pb.h"
 #include "stratum/glue/integral_types.h"
@@ -113,6 +115,19 @@ class BfrtTableManager {
       const ::p4::v1::MeterEntry& meter_entry,
       WriterInterface<::p4::v1::ReadResponse>* writer) LOCKS_EXCLUDED(lock_);
 
+  // Starts recording the changes made to the table entry cache by the table
+  // entry writes of the given session, so that they can be reverted if the
+  // transaction of the session is aborted.
+  virtual void BeginTableEntryCacheTransaction(
+      std::shared_ptr<BfSdeInterface::SessionInterface> session)
+      LOCKS_EXCLUDED(cache_lock_);
+
+  // Stops recording the changes of the given session. The recorded changes are
+  // reverted if 'commit' is false.
+  virtual void EndTableEntryCacheTransaction(
+      std::shared_ptr<BfSdeInterface::SessionInterface> session, bool commit)
+      LOCKS_EXCLUDED(cache_lock_);
+
   // Creates a table manager instance.
   static std::unique_ptr<BfrtTableManager> CreateInstance(
       OperationMode mode, BfSdeInterface* bf_sde_interface,
@@ -161,6 +176,30 @@ class BfrtTableManager {
       WriterInterface<::p4::v1::ReadResponse>* writer)
       SHARED_LOCKS_REQUIRED(lock_);
 
+  // Returns true if reads of the given table entry are served from the table
+  // entry cache. This is the case for tables written by P4Runtime only, as
+  // long as no counter or meter data is requested.
+  bool IsTableEntryCached(const ::p4::v1::TableEntry& table_entry)
+      SHARED_LOCKS_REQUIRED(lock_);
+
+  // Updates the table entry cache after the given table entry has been
+  // successfully written to the SDE.
+  void UpdateTableEntryCache(
+      std::shared_ptr<BfSdeInterface::SessionInterface> session,
+      const ::p4::v1::Update::Type type,
+      const ::p4::v1::TableEntry& table_entry) LOCKS_EXCLUDED(cache_lock_);
+
+  // Reads a single table entry or all table entries of a table from the table
+  // entry cache, instead of the SDE.
+  ::util::Status ReadCachedTableEntry(
+      const ::p4::v1::TableEntry& table_entry,
+      WriterInterface<::p4::v1::ReadResponse>* writer)
+      LOCKS_EXCLUDED(cache_lock_);
+  ::util::Status ReadCachedTableEntries(
+      const ::p4::v1::TableEntry& table_entry,
+      WriterInterface<::p4::v1::ReadResponse>* writer)
+      LOCKS_EXCLUDED(cache_lock_);
+
   // Construct a P4RT table entry from a table entry request, table key and
   // table data.
   ::util::StatusOr<::p4::v1::TableEntry> BuildP4TableEntry(
@@ -194,6 +233,33 @@ class BfrtTableManager {
   // to all feature managers.
   std::unique_ptr<P4InfoManager> p4_info_manager_ GUARDED_BY(lock_);
 
+  // Whether reads of table entries are served from the table entry cache. Set
+  // upon construction and never changed afterwards.
+  const bool table_entry_cache_enabled_;
+
+  // Lock protecting the table entry cache. Acquired after lock_, as writes of
+  // different table entries can run concurrently under a reader lock_.
+  mutable absl::Mutex cache_lock_;
+
+  // Shadow copy of all the table entries written to the SDE (as translated to
+  // the SDK side), keyed by P4 table ID and the key of the entry.
+  absl::flat_hash_map<uint32,
+                      absl::flat_hash_map<std::string, ::p4::v1::TableEntry>>
+      table_entry_cache_ GUARDED_BY(cache_lock_);
+
+  // The previous state of a table entry cache entry changed in a transaction.
+  struct TableEntryCacheUndo {
+    uint32 table_id;
+    std::string key;
+    absl::optional<::p4::v1::TableEntry> table_entry;
+  };
+
+  // The changes made to the table entry cache by the sessions with an ongoing
+  // transaction, in order.
+  absl::flat_hash_map<const BfSdeInterface::SessionInterface*,
+                      std::vector<TableEntryCacheUndo>>
+      cache_undo_logs_ GUARDED_BY(cache_lock_);
+
   // Fixed zero-based Tofino device number corresponding to the node/ASIC
   // managed by this class instance. Assigned in the class constructor.
   const int device_;
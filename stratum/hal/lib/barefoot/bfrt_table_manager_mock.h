@@ -85,6 +85,13 @@ class BfrtTableManagerMock : public BfrtTableManager {
       ::util::Status(std::shared_ptr<BfSdeInterface::SessionInterface> session,
                      const ::p4::v1::MeterEntry& meter_entry,
                      WriterInterface<::p4::v1::ReadResponse>* writer));
+  MOCK_METHOD1(
+      BeginTableEntryCacheTransaction,
+      void(std::shared_ptr<BfSdeInterface::SessionInterface> session));
+  MOCK_METHOD2(
+      EndTableEntryCacheTransaction,
+      void(std::shared_ptr<BfSdeInterface::SessionInterface> session,
+           bool commit));
 };
 
 }  // namespace barefoot
@@ -7,6 +7,7 @@
 #include <utility>
 
 #include "absl/memory/memory.h"
+#include "gflags/gflags.h"
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 #include "stratum/glue/status/status_test_util.h"
@@ -20,6 +21,7 @@
 // FIXME
 DEFINE_string(bfrt_sde_config_dir, "/var/run/stratum/bfrt_config",
               "The dir used by the SDE to load the device configuration.");
+DECLARE_bool(bfrt_table_entry_cache);
 
 namespace stratum {
 namespace hal {
@@ -583,6 +585,71 @@ TEST_F(BfrtTableManagerTest, DeleteTableEntryTest) {
       session_mock, ::p4::v1::Update::DELETE, entry));
 }
 
+TEST_F(BfrtTableManagerTest, ReadTableEntriesFromCacheTest) {
+  ::gflags::FlagSaver flag_saver;
+  FLAGS_bfrt_table_entry_cache = true;
+  bfrt_table_manager_ = BfrtTableManager::CreateInstance(
+      OPERATION_MODE_STANDALONE, bf_sde_wrapper_mock_.get(),
+      bfrt_p4runtime_translator_mock_.get(), kDevice1);
+  ASSERT_OK(PushTestConfig());
+  constexpr int kP4TableId = 33583783;
+  constexpr int kP4ActionId = 16783057;
+  constexpr int kBfRtTableId = 20;
+  auto table_key_mock = absl::make_unique<TableKeyMock>();
+  auto table_data_mock = absl::make_unique<TableDataMock>();
+  auto session_mock = std::make_shared<SessionMock>();
+  WriterMock<::p4::v1::ReadResponse> writer_mock;
+
+  EXPECT_CALL(*bf_sde_wrapper_mock_, GetBfRtId(kP4TableId))
+      .WillOnce(Return(kBfRtTableId));
+  EXPECT_CALL(*bf_sde_wrapper_mock_,
+              InsertTableEntry(kDevice1, _, kBfRtTableId, table_key_mock.get(),
+                               table_data_mock.get()))
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_CALL(*bf_sde_wrapper_mock_, CreateTableKey(kBfRtTableId))
+      .WillOnce(Return(ByMove(
+          ::util::StatusOr<std::unique_ptr<BfSdeInterface::TableKeyInterface>>(
+              std::move(table_key_mock)))));
+  EXPECT_CALL(*bf_sde_wrapper_mock_, CreateTableData(kBfRtTableId, kP4ActionId))
+      .WillOnce(Return(ByMove(
+          ::util::StatusOr<std::unique_ptr<BfSdeInterface::TableDataInterface>>(
+              std::move(table_data_mock)))));
+  // Reads must not hit the SDE.
+  EXPECT_CALL(*bf_sde_wrapper_mock_, GetAllTableEntries(_, _, _, _, _))
+      .Times(0);
+  EXPECT_CALL(*bf_sde_wrapper_mock_, GetTableEntry(_, _, _, _, _)).Times(0);
+
+  ::p4::v1::TableEntry entry;
+  ASSERT_OK(ParseProtoFromString(kTableEntryText, &entry));
+  EXPECT_CALL(*bfrt_p4runtime_translator_mock_,
+              TranslateTableEntry(EqualsProto(entry), true))
+      .WillRepeatedly(Return(::util::StatusOr<::p4::v1::TableEntry>(entry)));
+  EXPECT_CALL(*bfrt_p4runtime_translator_mock_,
+              TranslateTableEntry(EqualsProto(entry), false))
+      .WillRepeatedly(Return(::util::StatusOr<::p4::v1::TableEntry>(entry)));
+  ::p4::v1::ReadResponse resp;
+  *resp.add_entities()->mutable_table_entry() = entry;
+  EXPECT_CALL(writer_mock, Write(EqualsProto(resp)))
+      .Times(2)
+      .WillRepeatedly(Return(true));
+  ASSERT_OK(bfrt_table_manager_->WriteTableEntry(
+      session_mock, ::p4::v1::Update::INSERT, entry));
+
+  // Wildcard read of the table.
+  ::p4::v1::TableEntry wildcard_entry;
+  wildcard_entry.set_table_id(kP4TableId);
+  EXPECT_CALL(*bfrt_p4runtime_translator_mock_,
+              TranslateTableEntry(EqualsProto(wildcard_entry), true))
+      .WillOnce(
+          Return(::util::StatusOr<::p4::v1::TableEntry>(wildcard_entry)));
+  EXPECT_OK(bfrt_table_manager_->ReadTableEntry(session_mock, wildcard_entry,
+                                                &writer_mock));
+
+  // Read of the single entry.
+  EXPECT_OK(
+      bfrt_table_manager_->ReadTableEntry(session_mock, entry, &writer_mock));
+}
+
 TEST_F(BfrtTableManagerTest, RejectWriteTableUnspecifiedTypeTest) {
   ASSERT_OK(PushTestConfig());
   auto session_mock = std::make_shared<SessionMock>();
@@ -0,0 +1,60 @@
+// Copyright 2020-present Open Networking Foundation
+// SPDX-License-Identifier: Apache-2.0
+
+#include "stratum/hal/lib/barefoot/bfrt_worker_pool.h"
+
+#include <algorithm>
+
+namespace stratum {
+namespace hal {
+namespace barefoot {
+
+BfrtWorkerPool::BfrtWorkerPool() : shutdown_(false) {}
+
+BfrtWorkerPool::~BfrtWorkerPool() {
+  std::vector<std::thread> threads;
+  {
+    absl::MutexLock l(&lock_);
+    shutdown_ = true;
+    threads.swap(threads_);
+  }
+  for (auto& thread : threads) thread.join();
+}
+
+void BfrtWorkerPool::Run(int parallelism,
+                         const std::function<void()>& task) {
+  Job job;
+  job.task = &task;
+  job.running = 0;
+  {
+    absl::MutexLock l(&lock_);
+    while (static_cast<int>(threads_.size()) < parallelism - 1) {
+      threads_.emplace_back(&BfrtWorkerPool::RunWorker, this);
+    }
+    for (int i = 1; i < parallelism; ++i) queue_.push_back(&job);
+  }
+  task();
+  absl::MutexLock l(&lock_);
+  queue_.erase(std::remove(queue_.begin(), queue_.end(), &job), queue_.end());
+  lock_.Await(absl::Condition(
+      +[](Job* job) { return job->running == 0; }, &job));
+}
+
+void BfrtWorkerPool::RunWorker() {
+  absl::MutexLock l(&lock_);
+  while (true) {
+    lock_.Await(absl::Condition(this, &BfrtWorkerPool::HasWork));
+    if (shutdown_) return;
+    Job* job = queue_.front();
+    queue_.pop_front();
+    ++job->running;
+    lock_.Unlock();
+    (*job->task)();
+    lock_.Lock();
+    --job->running;
+  }
+}
+
+}  // namespace barefoot
+}  // namespace hal
+}  // namespace stratum
@@ -0,0 +1,67 @@
+// Copyright 2020-present Open Networking Foundation
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef STRATUM_HAL_LIB_BAREFOOT_BFRT_WORKER_POOL_H_
+#define STRATUM_HAL_LIB_BAREFOOT_BFRT_WORKER_POOL_H_
+
+#include <deque>
+#include <functional>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/synchronization/mutex.h"
+
+namespace stratum {
+namespace hal {
+namespace barefoot {
+
+// A set of threads running the parts of a request which BfrtNode spreads over
+// multiple threads. The threads are created on demand and kept until the pool
+// is destroyed, so that requests do not pay for creating threads.
+class BfrtWorkerPool {
+ public:
+  BfrtWorkerPool();
+  // Stops and joins the threads. No Run() may be in progress.
+  ~BfrtWorkerPool();
+
+  // Runs 'task' 'parallelism' times concurrently, once on the calling thread
+  // and the other times on the threads of the pool, and returns once all the
+  // runs have returned. The runs are expected to share the work, e.g. by
+  // taking items from a common counter: the runs which no thread has started
+  // by the time the run on the calling thread returns are skipped, so that a
+  // busy pool never delays the request.
+  void Run(int parallelism, const std::function<void()>& task)
+      LOCKS_EXCLUDED(lock_);
+
+  // BfrtWorkerPool is neither copyable nor movable.
+  BfrtWorkerPool(const BfrtWorkerPool&) = delete;
+  BfrtWorkerPool& operator=(const BfrtWorkerPool&) = delete;
+
+ private:
+  // A call of Run().
+  struct Job {
+    const std::function<void()>* task;
+    // Number of runs of the task in progress on the threads of the pool.
+    int running;
+  };
+
+  // Main loop of the threads of the pool.
+  void RunWorker() LOCKS_EXCLUDED(lock_);
+
+  bool HasWork() const EXCLUSIVE_LOCKS_REQUIRED(lock_) {
+    return shutdown_ || !queue_.empty();
+  }
+
+  absl::Mutex lock_;
+  // One entry per run of a job which has yet to be started.
+  std::deque<Job*> queue_ GUARDED_BY(lock_);
+  std::vector<std::thread> threads_ GUARDED_BY(lock_);
+  bool shutdown_ GUARDED_BY(lock_);
+};
+
+}  // namespace barefoot
+}  // namespace hal
+}  // namespace stratum
+
+#endif  // STRATUM_HAL_LIB_BAREFOOT_BFRT_WORKER_POOL_H_
@@ -0,0 +1,77 @@
+// Copyright 2020-present Open Networking Foundation
+// SPDX-License-Identifier: Apache-2.0
+
+#include "stratum/hal/lib/barefoot/bfrt_worker_pool.h"
+
+#include <set>
+#include <thread>  // NOLINT
+
+#include "absl/synchronization/mutex.h"
+#include "absl/synchronization/notification.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace stratum {
+namespace hal {
+namespace barefoot {
+
+TEST(BfrtWorkerPoolTest, RunsTaskConcurrently) {
+  BfrtWorkerPool pool;
+  absl::Mutex lock;
+  int started = 0;
+  // Every run waits for the others, so none of them can be skipped.
+  auto task = [&lock, &started]() {
+    absl::MutexLock l(&lock);
+    ++started;
+    lock.Await(absl::Condition(
+        +[](int* started) { return *started >= 3; }, &started));
+  };
+  pool.Run(3, task);
+  EXPECT_EQ(3, started);
+
+  // The threads are kept for the next requests.
+  started = 0;
+  pool.Run(3, task);
+  EXPECT_EQ(3, started);
+}
+
+TEST(BfrtWorkerPoolTest, SkipsRunsNotStartedByBusyPool) {
+  BfrtWorkerPool pool;
+  absl::Notification pool_busy;
+  absl::Notification release;
+  // Keep the only thread of the pool busy.
+  std::thread busy([&pool, &pool_busy, &release]() {
+    const std::thread::id caller = std::this_thread::get_id();
+    pool.Run(2, [caller, &pool_busy, &release]() {
+      if (std::this_thread::get_id() == caller) {
+        pool_busy.WaitForNotification();
+      } else {
+        pool_busy.Notify();
+        release.WaitForNotification();
+      }
+    });
+  });
+  pool_busy.WaitForNotification();
+
+  absl::Mutex lock;
+  std::set<std::thread::id> threads;
+  pool.Run(2, [&lock, &threads]() {
+    absl::MutexLock l(&lock);
+    threads.insert(std::this_thread::get_id());
+  });
+  EXPECT_THAT(threads, ::testing::ElementsAre(std::this_thread::get_id()));
+
+  release.Notify();
+  busy.join();
+}
+
+TEST(BfrtWorkerPoolTest, RunsTaskOnCallingThreadOnly) {
+  BfrtWorkerPool pool;
+  int runs = 0;
+  pool.Run(1, [&runs]() { ++runs; });
+  EXPECT_EQ(1, runs);
+}
+
+}  // namespace barefoot
+}  // namespace hal
+}  // namespace stratum
@@ -1395,7 +1395,8 @@ bool IsGePortOnTridentPlus(const BcmPort& bcm_port,
   // Writer, and create Reader thread.
   if (linkscan_event_writer_id_ == kInvalidWriterId) {
     linkscan_event_channel_ =
-        Channel<LinkscanEvent>::Create(kMaxLinkscanEventDepth);
+        Channel<LinkscanEvent>::Create(kMaxLinkscanEventDepth,
+                                       "bcm_linkscan_events");
     // Create and hand-off Writer to the BcmSdkInterface.
     auto writer = ChannelWriter<LinkscanEvent>::Create(linkscan_event_channel_);
     int priority = BcmSdkInterface::kLinkscanEventWriterPriorityHigh;
@@ -1428,7 +1429,8 @@ bool IsGePortOnTridentPlus(const BcmPort& bcm_port,
   // If we have not done that yet, create transceiver module insert/removal
   // event Channel, register ChannelWriter, and create ChannelReader thread.
   if (xcvr_event_writer_id_ == kInvalidWriterId) {
-    xcvr_event_channel_ = Channel<TransceiverEvent>::Create(kMaxXcvrEventDepth);
+    xcvr_event_channel_ = Channel<TransceiverEvent>::Create(
+        kMaxXcvrEventDepth, "bcm_xcvr_events");
     // Create and hand-off ChannelWriter to the PhalInterface.
     auto writer = ChannelWriter<TransceiverEvent>::Create(xcvr_event_channel_);
     int priority = PhalInterface::kTransceiverEventWriterPriorityHigh;
@@ -329,7 +329,9 @@ BcmNode::~BcmNode() {}
   auto packet_in_writer =
       std::make_shared<ProtoOneofWriterWrapper<::p4::v1::StreamMessageResponse,
                                                ::p4::v1::PacketIn>>(
-          writer, &::p4::v1::StreamMessageResponse::mutable_packet);
+          writer,
+          &::p4::v1::StreamMessageResponse::unsafe_arena_set_allocated_packet,
+          &::p4::v1::StreamMessageResponse::unsafe_arena_release_packet);
 
   return bcm_packetio_manager_->RegisterPacketReceiveWriter(
       GoogleConfig::BCM_KNET_INTF_PURPOSE_CONTROLLER, packet_in_writer);
@@ -466,7 +466,8 @@ void Bmv2ChassisManager::ReadPortStatusChangeEvents() {
   }
 
   port_status_change_event_channel_ =
-      Channel<PortStatusChangeEvent>::Create(kMaxPortStatusChangeEventDepth);
+      Channel<PortStatusChangeEvent>::Create(kMaxPortStatusChangeEventDepth,
+                                             "bmv2_port_status_events");
 
   port_status_change_event_writer_ =
       ChannelWriter<PortStatusChangeEvent>::Create(
@@ -0,0 +1,29 @@
+// Copyright 2018-present Open Networking Foundation
+// SPDX-License-Identifier: Apache-2.0
+
+#include "stratum/hal/lib/common/async_grpc.h"
+
+namespace stratum {
+namespace hal {
+
+namespace {
+
+// Whether the current thread is running PollCompletionQueue().
+thread_local bool polling_completion_queue = false;
+
+}  // namespace
+
+void PollCompletionQueue(::grpc::ServerCompletionQueue* cq) {
+  polling_completion_queue = true;
+  void* tag;
+  bool ok;
+  while (cq->Next(&tag, &ok)) {
+    static_cast<AsyncTag*>(tag)->Run(ok);
+  }
+  polling_completion_queue = false;
+}
+
+bool IsCompletionQueueThread() { return polling_completion_queue; }
+
+}  // namespace hal
+}  // namespace stratum
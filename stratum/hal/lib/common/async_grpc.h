@@ -0,0 +1,286 @@
+// Copyright 2018-present Open Networking Foundation
+// SPDX-License-Identifier: Apache-2.0
+
+// Building blocks of the asynchronous gRPC server mode of HAL. In this mode
+// the calls of the long-lived streaming RPCs are state machines driven by a
+// small, fixed number of threads polling the completion queues of the server,
+// instead of pinning a thread of the synchronous server each. The handlers of
+// these calls must not block, as they run on the polling threads.
+
+#ifndef STRATUM_HAL_LIB_COMMON_ASYNC_GRPC_H_
+#define STRATUM_HAL_LIB_COMMON_ASYNC_GRPC_H_
+
+#include <deque>
+#include <functional>
+#include <memory>
+#include <utility>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/synchronization/mutex.h"
+#include "grpcpp/grpcpp.h"
+
+namespace stratum {
+namespace hal {
+
+// The tag of an operation started on a completion queue. The thread polling
+// the queue runs the handler with the result of the operation.
+class AsyncTag {
+ public:
+  explicit AsyncTag(std::function<void(bool ok)> handler)
+      : handler_(std::move(handler)) {}
+
+  void Run(bool ok) { handler_(ok); }
+
+ private:
+  const std::function<void(bool ok)> handler_;
+};
+
+// Runs the AsyncTags completed on 'cq' until the queue has been shut down and
+// drained. To be called by each completion queue polling thread.
+void PollCompletionQueue(::grpc::ServerCompletionQueue* cq);
+
+// Returns true if the calling thread is running PollCompletionQueue(). Such a
+// thread must never wait for an operation to complete, since it may be the one
+// which has to run the tag of the operation.
+bool IsCompletionQueueThread();
+
+// Limits the responses waiting to be written to the stream of an
+// AsyncBidiStreamingCall.
+struct AsyncWriteQueueOptions {
+  // Max number of responses queued behind the one being written.
+  size_t max_queued_writes = 64;
+  // Whether a Write() to a full queue waits for room, rather than failing.
+  bool block_when_full = false;
+};
+
+// Handles the messages of one call of a bidirectional streaming RPC. The
+// methods are called one at a time from the completion queue threads and must
+// not block.
+template <typename W, typename R>
+class AsyncStreamHandler {
+ public:
+  virtual ~AsyncStreamHandler() {}
+
+  // Called when the call has been accepted. Responses can be written to
+  // 'stream' from any thread until the handler is destroyed. The writes of
+  // the handler methods themselves are always queued, and the next request is
+  // only read once the queue has room again. Requests cannot be read from
+  // 'stream', they are passed to OnRead() instead. A non-OK status finishes
+  // the call.
+  virtual ::grpc::Status OnStart(
+      ::grpc::ServerContext* context,
+      ::grpc::ServerReaderWriterInterface<W, R>* stream) = 0;
+
+  // Called for every request received. A non-OK status finishes the call.
+  virtual ::grpc::Status OnRead(const R& request) = 0;
+
+  // Called once after a successful OnStart(), when no more requests will be
+  // received. Returns the status the call is finished with if the client
+  // closed its side of the stream.
+  virtual ::grpc::Status OnDone() = 0;
+};
+
+// A call of a bidirectional streaming RPC. Requests are passed to an
+// AsyncStreamHandler, responses are queued and sent one by one. The queue is
+// bounded by AsyncWriteQueueOptions: once it is full, writes from other
+// threads than the completion queue threads wait or fail, and no request is
+// read until the queue has room again.
+template <typename Service, typename W, typename R>
+class AsyncBidiStreamingCall
+    : public ::grpc::ServerReaderWriterInterface<W, R> {
+ public:
+  using RequestMethod = void (Service::*)(
+      ::grpc::ServerContext*, ::grpc::ServerAsyncReaderWriter<W, R>*,
+      ::grpc::CompletionQueue*, ::grpc::ServerCompletionQueue*, void*);
+  using HandlerFactory =
+      std::function<std::unique_ptr<AsyncStreamHandler<W, R>>()>;
+
+  // Waits for the next call of the RPC on 'cq'. Every accepted call waits for
+  // its successor and deletes itself once it has been finished.
+  static void Start(Service* service, RequestMethod method,
+                    HandlerFactory factory,
+                    const AsyncWriteQueueOptions& options,
+                    ::grpc::ServerCompletionQueue* cq) {
+    new AsyncBidiStreamingCall(service, method, std::move(factory), options,
+                               cq);
+  }
+
+  ~AsyncBidiStreamingCall() override {
+    // The handler has to stop all its writers before the call goes away.
+    handler_.reset();
+  }
+
+  // Initial metadata is sent along with the first response.
+  void SendInitialMetadata() override {}
+
+  // Queues the message. Returns false if the call is being finished, or if
+  // the queue is full and the options do not allow to wait for room.
+  using ::grpc::internal::WriterInterface<W>::Write;
+  bool Write(const W& msg, ::grpc::WriteOptions options) override
+      LOCKS_EXCLUDED(lock_) {
+    absl::MutexLock l(&lock_);
+    if (WriteQueueFull() && !IsCompletionQueueThread()) {
+      if (!options_.block_when_full) return false;
+      lock_.Await(absl::Condition(this, &AsyncBidiStreamingCall::CanWrite));
+    }
+    if (finishing_ || write_failed_) return false;
+    if (writing_) {
+      write_queue_.emplace_back(msg, options);
+    } else {
+      writing_ = true;
+      stream_.Write(msg, options, &write_tag_);
+    }
+    return true;
+  }
+
+  // Requests are passed to AsyncStreamHandler::OnRead().
+  bool NextMessageSize(uint32_t* sz) override { return false; }
+  bool Read(R* msg) override { return false; }
+
+  // AsyncBidiStreamingCall is neither copyable nor movable.
+  AsyncBidiStreamingCall(const AsyncBidiStreamingCall&) = delete;
+  AsyncBidiStreamingCall& operator=(const AsyncBidiStreamingCall&) = delete;
+
+ private:
+  AsyncBidiStreamingCall(Service* service, RequestMethod method,
+                         HandlerFactory factory,
+                         const AsyncWriteQueueOptions& options,
+                         ::grpc::ServerCompletionQueue* cq)
+      : service_(service),
+        method_(method),
+        factory_(std::move(factory)),
+        options_(options),
+        cq_(cq),
+        stream_(&context_),
+        request_tag_([this](bool ok) { OnRequest(ok); }),
+        read_tag_([this](bool ok) { OnReadDone(ok); }),
+        write_tag_([this](bool ok) { OnWriteDone(ok); }),
+        finish_tag_([this](bool ok) { delete this; }),
+        writing_(false),
+        write_failed_(false),
+        read_paused_(false),
+        finishing_(false),
+        finish_started_(false) {
+    (service_->*method_)(&context_, &stream_, cq_, cq_, &request_tag_);
+  }
+
+  void OnRequest(bool ok) {
+    if (!ok) {
+      // The server is shutting down.
+      delete this;
+      return;
+    }
+    Start(service_, method_, factory_, options_, cq_);
+    handler_ = factory_();
+    ::grpc::Status status = handler_->OnStart(&context_, this);
+    if (!status.ok()) {
+      RequestFinish(status);
+      return;
+    }
+    ReadNext();
+  }
+
+  void OnReadDone(bool ok) {
+    if (!ok) {
+      // The client closed its side of the stream or the call is dead.
+      RequestFinish(handler_->OnDone());
+      return;
+    }
+    ::grpc::Status status = handler_->OnRead(request_);
+    if (!status.ok()) {
+      handler_->OnDone();
+      RequestFinish(status);
+      return;
+    }
+    ReadNext();
+  }
+
+  // Reads the next request, unless the write queue is full. In that case the
+  // read is started by OnWriteDone() once the queue has room again, so that a
+  // client which does not read its responses cannot make the queue grow.
+  void ReadNext() LOCKS_EXCLUDED(lock_) {
+    absl::MutexLock l(&lock_);
+    if (WriteQueueFull()) {
+      read_paused_ = true;
+      return;
+    }
+    stream_.Read(&request_, &read_tag_);
+  }
+
+  void OnWriteDone(bool ok) LOCKS_EXCLUDED(lock_) {
+    absl::MutexLock l(&lock_);
+    if (!ok) {
+      write_failed_ = true;
+      write_queue_.clear();
+    }
+    if (!write_queue_.empty()) {
+      stream_.Write(write_queue_.front().first, write_queue_.front().second,
+                    &write_tag_);
+      write_queue_.pop_front();
+    } else {
+      writing_ = false;
+    }
+    // After a failed write, the read fails as well and finishes the call.
+    if (read_paused_ && !WriteQueueFull()) {
+      read_paused_ = false;
+      stream_.Read(&request_, &read_tag_);
+    }
+    if (!writing_ && finishing_) StartFinish();
+  }
+
+  bool WriteQueueFull() const EXCLUSIVE_LOCKS_REQUIRED(lock_) {
+    return writing_ && write_queue_.size() >= options_.max_queued_writes;
+  }
+
+  bool CanWrite() const EXCLUSIVE_LOCKS_REQUIRED(lock_) {
+    return finishing_ || write_failed_ || !WriteQueueFull();
+  }
+
+  // Finishes the call once all the queued responses have been sent. No read
+  // must be pending.
+  void RequestFinish(const ::grpc::Status& status) LOCKS_EXCLUDED(lock_) {
+    absl::MutexLock l(&lock_);
+    finishing_ = true;
+    finish_status_ = status;
+    if (!writing_) StartFinish();
+  }
+
+  void StartFinish() EXCLUSIVE_LOCKS_REQUIRED(lock_) {
+    if (finish_started_) return;
+    finish_started_ = true;
+    stream_.Finish(finish_status_, &finish_tag_);
+  }
+
+  Service* const service_;  // not owned by this class.
+  const RequestMethod method_;
+  const HandlerFactory factory_;
+  const AsyncWriteQueueOptions options_;
+  ::grpc::ServerCompletionQueue* const cq_;  // not owned by this class.
+  ::grpc::ServerContext context_;
+  ::grpc::ServerAsyncReaderWriter<W, R> stream_;
+  R request_;
+  AsyncTag request_tag_;
+  AsyncTag read_tag_;
+  AsyncTag write_tag_;
+  AsyncTag finish_tag_;
+
+  // Protects the write side of the stream, which is used by the threads of
+  // the handler as well as the completion queue threads.
+  absl::Mutex lock_;
+  std::deque<std::pair<W, ::grpc::WriteOptions>> write_queue_
+      GUARDED_BY(lock_);
+  bool writing_ GUARDED_BY(lock_);
+  bool write_failed_ GUARDED_BY(lock_);
+  // Set while the next read waits for room in write_queue_.
+  bool read_paused_ GUARDED_BY(lock_);
+  bool finishing_ GUARDED_BY(lock_);
+  bool finish_started_ GUARDED_BY(lock_);
+  ::grpc::Status finish_status_ GUARDED_BY(lock_);
+
+  std::unique_ptr<AsyncStreamHandler<W, R>> handler_;
+};
+
+}  // namespace hal
+}  // namespace stratum
+
+#endif  // STRATUM_HAL_LIB_COMMON_ASYNC_GRPC_H_
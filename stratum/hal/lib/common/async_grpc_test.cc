@@ -0,0 +1,353 @@
+// Copyright 2018-present Open Networking Foundation
+// SPDX-License-Identifier: Apache-2.0
+
+#include "stratum/hal/lib/common/async_grpc.h"
+
+#include <chrono>  // NOLINT
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "absl/memory/memory.h"
+#include "absl/strings/str_cat.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/synchronization/notification.h"
+#include "gmock/gmock.h"
+#include "grpcpp/grpcpp.h"
+#include "gtest/gtest.h"
+#include "p4/v1/p4runtime.grpc.pb.h"
+#include "stratum/glue/integral_types.h"
+#include "stratum/glue/net_util/ports.h"
+
+namespace stratum {
+namespace hal {
+
+using ::testing::ElementsAre;
+
+typedef ::p4::v1::P4Runtime::WithAsyncMethod_StreamChannel<
+    ::p4::v1::P4Runtime::Service>
+    TestService;
+typedef ::grpc::ServerReaderWriterInterface<::p4::v1::StreamMessageResponse,
+                                            ::p4::v1::StreamMessageRequest>
+    ServerStream;
+typedef ::grpc::ClientReaderWriter<::p4::v1::StreamMessageRequest,
+                                   ::p4::v1::StreamMessageResponse>
+    ClientStream;
+
+// The state of the calls of the test service, shared with the test.
+struct TestState {
+  // The status returned by OnStart().
+  ::grpc::Status start_status;
+  absl::Notification started;
+  absl::Notification done;
+  absl::Notification destroyed;
+  // Notified by OnRead() when it blocks for a "block" request, which waits for
+  // 'release' to be notified.
+  absl::Notification blocked;
+  absl::Notification release;
+  // If set, run by a thread of the handler from OnStart() on. The handler
+  // joins the thread when it is destroyed, like the handlers of HAL stop their
+  // writers.
+  std::function<void(ServerStream* stream)> writer;
+  absl::Mutex lock;
+  ServerStream* stream GUARDED_BY(lock) = nullptr;
+  // The IDs of the requests passed to OnRead().
+  std::vector<uint64> requests GUARDED_BY(lock);
+};
+
+// Handles the requests built by Request() below, and records the calls in the
+// given TestState.
+class TestHandler
+    : public AsyncStreamHandler<::p4::v1::StreamMessageResponse,
+                                ::p4::v1::StreamMessageRequest> {
+ public:
+  explicit TestHandler(TestState* state) : state_(state) {}
+
+  ~TestHandler() override {
+    if (writer_.joinable()) writer_.join();
+    state_->destroyed.Notify();
+  }
+
+  ::grpc::Status OnStart(::grpc::ServerContext* context,
+                         ServerStream* stream) override {
+    {
+      absl::MutexLock l(&state_->lock);
+      state_->stream = stream;
+    }
+    stream_ = stream;
+    if (state_->writer) {
+      writer_ = std::thread(state_->writer, stream);
+    }
+    state_->started.Notify();
+    return state_->start_status;
+  }
+
+  ::grpc::Status OnRead(
+      const ::p4::v1::StreamMessageRequest& request) override {
+    uint64 id = request.arbitration().device_id();
+    {
+      absl::MutexLock l(&state_->lock);
+      state_->requests.push_back(id);
+    }
+    for (uint64 i = 0; i < request.arbitration().election_id().low(); ++i) {
+      EXPECT_TRUE(stream_->Write(Response(absl::StrCat(id, "-", i))));
+    }
+    const std::string& action = request.arbitration().role().name();
+    if (action == "block") {
+      state_->blocked.Notify();
+      state_->release.WaitForNotification();
+    } else if (action == "fail") {
+      return ::grpc::Status(::grpc::StatusCode::INVALID_ARGUMENT, "fail");
+    }
+    return ::grpc::Status::OK;
+  }
+
+  ::grpc::Status OnDone() override {
+    state_->done.Notify();
+    return ::grpc::Status::OK;
+  }
+
+  // Returns a response with the given payload.
+  static ::p4::v1::StreamMessageResponse Response(const std::string& payload) {
+    ::p4::v1::StreamMessageResponse response;
+    response.mutable_packet()->set_payload(payload);
+    return response;
+  }
+
+ private:
+  TestState* const state_;
+  ServerStream* stream_;
+  std::thread writer_;
+};
+
+class AsyncBidiStreamingCallTest : public ::testing::Test {
+ protected:
+  // Starts a server with a single completion queue thread, which handles the
+  // StreamChannel calls with TestHandlers.
+  void StartServer(const AsyncWriteQueueOptions& options) {
+    std::string url =
+        "localhost:" + std::to_string(stratum::PickUnusedPortOrDie());
+    ::grpc::ServerBuilder builder;
+    builder.AddListeningPort(url, ::grpc::InsecureServerCredentials());
+    builder.RegisterService(&service_);
+    cq_ = builder.AddCompletionQueue();
+    server_ = builder.BuildAndStart();
+    ASSERT_NE(server_, nullptr);
+    TestState* state = &state_;
+    AsyncBidiStreamingCall<TestService, ::p4::v1::StreamMessageResponse,
+                           ::p4::v1::StreamMessageRequest>::
+        Start(&service_, &TestService::RequestStreamChannel,
+              [state]() { return absl::make_unique<TestHandler>(state); },
+              options, cq_.get());
+    cq_thread_ = std::thread(PollCompletionQueue, cq_.get());
+    stub_ = ::p4::v1::P4Runtime::NewStub(
+        ::grpc::CreateChannel(url, ::grpc::InsecureChannelCredentials()));
+    ASSERT_NE(stub_, nullptr);
+  }
+
+  void TearDown() override {
+    if (server_ == nullptr) return;
+    // Cancels the calls still open.
+    server_->Shutdown(std::chrono::system_clock::now());
+    cq_->Shutdown();
+    cq_thread_.join();
+  }
+
+  // Returns a request with the given ID. The handler writes 'num_responses'
+  // responses for it, then does the given action: "block" or "fail".
+  static ::p4::v1::StreamMessageRequest Request(
+      uint64 id, uint64 num_responses, const std::string& action = "") {
+    ::p4::v1::StreamMessageRequest request;
+    request.mutable_arbitration()->set_device_id(id);
+    request.mutable_arbitration()->mutable_election_id()->set_low(
+        num_responses);
+    request.mutable_arbitration()->mutable_role()->set_name(action);
+    return request;
+  }
+
+  // Reads 'count' responses from the stream and returns their payloads.
+  static std::vector<std::string> ReadPayloads(ClientStream* stream,
+                                               int count) {
+    std::vector<std::string> payloads;
+    ::p4::v1::StreamMessageResponse response;
+    for (int i = 0; i < count && stream->Read(&response); ++i) {
+      payloads.push_back(response.packet().payload());
+    }
+    return payloads;
+  }
+
+  // Returns the stream passed to OnStart(), once the call has been started.
+  ServerStream* GetServerStream() {
+    state_.started.WaitForNotification();
+    absl::MutexLock l(&state_.lock);
+    return state_.stream;
+  }
+
+  std::vector<uint64> GetRequests() {
+    absl::MutexLock l(&state_.lock);
+    return state_.requests;
+  }
+
+  TestState state_;
+  TestService service_;
+  std::unique_ptr<::grpc::ServerCompletionQueue> cq_;
+  std::unique_ptr<::grpc::Server> server_;
+  std::thread cq_thread_;
+  std::unique_ptr<::p4::v1::P4Runtime::Stub> stub_;
+};
+
+TEST_F(AsyncBidiStreamingCallTest, RequestsArePassedToHandlerInOrder) {
+  StartServer(AsyncWriteQueueOptions());
+  ::grpc::ClientContext context;
+  std::unique_ptr<ClientStream> stream = stub_->StreamChannel(&context);
+  ASSERT_TRUE(stream->Write(Request(1, 1)));
+  ASSERT_TRUE(stream->Write(Request(2, 0)));
+  ASSERT_TRUE(stream->Write(Request(3, 2)));
+  ASSERT_TRUE(stream->WritesDone());
+
+  EXPECT_THAT(ReadPayloads(stream.get(), 4),
+              ElementsAre("1-0", "3-0", "3-1"));
+  EXPECT_TRUE(stream->Finish().ok());
+  EXPECT_TRUE(state_.done.HasBeenNotified());
+  EXPECT_THAT(GetRequests(), ElementsAre(1U, 2U, 3U));
+  state_.destroyed.WaitForNotification();
+}
+
+TEST_F(AsyncBidiStreamingCallTest, OnStartErrorFinishesTheCall) {
+  state_.start_status =
+      ::grpc::Status(::grpc::StatusCode::PERMISSION_DENIED, "denied");
+  StartServer(AsyncWriteQueueOptions());
+  ::grpc::ClientContext context;
+  std::unique_ptr<ClientStream> stream = stub_->StreamChannel(&context);
+  stream->Write(Request(1, 1));
+
+  ::grpc::Status status = stream->Finish();
+  EXPECT_EQ(::grpc::StatusCode::PERMISSION_DENIED, status.error_code());
+  state_.destroyed.WaitForNotification();
+  // OnDone() is only called for the calls which have been started.
+  EXPECT_FALSE(state_.done.HasBeenNotified());
+  EXPECT_TRUE(GetRequests().empty());
+}
+
+TEST_F(AsyncBidiStreamingCallTest, HandlerWritesAreQueuedWhileReadsPause) {
+  AsyncWriteQueueOptions options;
+  options.max_queued_writes = 1;
+  StartServer(options);
+  ::grpc::ClientContext context;
+  std::unique_ptr<ClientStream> stream = stub_->StreamChannel(&context);
+  // The writes of the handler do not wait for room in the queue. The next
+  // request is read once the queue has drained.
+  ASSERT_TRUE(stream->Write(Request(1, 10)));
+  ASSERT_TRUE(stream->Write(Request(2, 1)));
+  ASSERT_TRUE(stream->WritesDone());
+
+  std::vector<std::string> expected;
+  for (int i = 0; i < 10; ++i) expected.push_back(absl::StrCat("1-", i));
+  expected.push_back("2-0");
+  EXPECT_EQ(expected, ReadPayloads(stream.get(), 12));
+  EXPECT_TRUE(stream->Finish().ok());
+  EXPECT_THAT(GetRequests(), ElementsAre(1U, 2U));
+}
+
+TEST_F(AsyncBidiStreamingCallTest, WritesToFullQueueWaitForRoom) {
+  AsyncWriteQueueOptions options;
+  options.max_queued_writes = 1;
+  options.block_when_full = true;
+  const int kNumWrites = 20;
+  state_.writer = [](ServerStream* stream) {
+    for (int i = 0; i < kNumWrites; ++i) {
+      EXPECT_TRUE(stream->Write(TestHandler::Response(absl::StrCat("w-", i))));
+    }
+  };
+  StartServer(options);
+  ::grpc::ClientContext context;
+  std::unique_ptr<ClientStream> stream = stub_->StreamChannel(&context);
+
+  std::vector<std::string> expected;
+  for (int i = 0; i < kNumWrites; ++i) {
+    expected.push_back(absl::StrCat("w-", i));
+  }
+  EXPECT_EQ(expected, ReadPayloads(stream.get(), kNumWrites));
+
+  ASSERT_TRUE(stream->WritesDone());
+  EXPECT_TRUE(stream->Finish().ok());
+}
+
+TEST_F(AsyncBidiStreamingCallTest, WritesToFullQueueFailWithoutBlocking) {
+  AsyncWriteQueueOptions options;
+  options.max_queued_writes = 1;
+  options.block_when_full = false;
+  StartServer(options);
+  ::grpc::ClientContext context;
+  std::unique_ptr<ClientStream> stream = stub_->StreamChannel(&context);
+  // Keep the completion queue thread busy, so that no write completes.
+  ASSERT_TRUE(stream->Write(Request(1, 0, "block")));
+  state_.blocked.WaitForNotification();
+
+  ServerStream* server_stream = GetServerStream();
+  EXPECT_TRUE(server_stream->Write(TestHandler::Response("w-0")));
+  EXPECT_TRUE(server_stream->Write(TestHandler::Response("w-1")));
+  EXPECT_FALSE(server_stream->Write(TestHandler::Response("w-2")));
+  state_.release.Notify();
+
+  EXPECT_THAT(ReadPayloads(stream.get(), 2), ElementsAre("w-0", "w-1"));
+  ASSERT_TRUE(stream->WritesDone());
+  EXPECT_TRUE(stream->Finish().ok());
+}
+
+TEST_F(AsyncBidiStreamingCallTest, FinishWaitsForWritesInFlight) {
+  AsyncWriteQueueOptions options;
+  options.max_queued_writes = 2;
+  StartServer(options);
+  ::grpc::ClientContext context;
+  std::unique_ptr<ClientStream> stream = stub_->StreamChannel(&context);
+  // The handler fails the call right after queueing its responses.
+  ASSERT_TRUE(stream->Write(Request(1, 5, "fail")));
+
+  EXPECT_THAT(ReadPayloads(stream.get(), 6),
+              ElementsAre("1-0", "1-1", "1-2", "1-3", "1-4"));
+  ::grpc::Status status = stream->Finish();
+  EXPECT_EQ(::grpc::StatusCode::INVALID_ARGUMENT, status.error_code());
+  EXPECT_TRUE(state_.done.HasBeenNotified());
+  state_.destroyed.WaitForNotification();
+}
+
+TEST_F(AsyncBidiStreamingCallTest, ClientCancelCallsOnDone) {
+  StartServer(AsyncWriteQueueOptions());
+  ::grpc::ClientContext context;
+  std::unique_ptr<ClientStream> stream = stub_->StreamChannel(&context);
+  ASSERT_TRUE(stream->Write(Request(1, 0)));
+  GetServerStream();
+
+  context.TryCancel();
+  state_.done.WaitForNotification();
+  state_.destroyed.WaitForNotification();
+  EXPECT_EQ(::grpc::StatusCode::CANCELLED, stream->Finish().error_code());
+}
+
+TEST_F(AsyncBidiStreamingCallTest, ShutdownFinishesOpenCalls) {
+  AsyncWriteQueueOptions options;
+  options.max_queued_writes = 1;
+  options.block_when_full = true;
+  // The client does not read, so that the writer ends up waiting for room in
+  // the queue. The shutdown of the server has to fail its writes.
+  state_.writer = [](ServerStream* stream) {
+    const std::string payload(64 * 1024, 'x');
+    while (stream->Write(TestHandler::Response(payload))) {
+    }
+  };
+  StartServer(options);
+  ::grpc::ClientContext context;
+  std::unique_ptr<ClientStream> stream = stub_->StreamChannel(&context);
+  GetServerStream();
+
+  server_->Shutdown(std::chrono::system_clock::now());
+  state_.done.WaitForNotification();
+  state_.destroyed.WaitForNotification();
+  EXPECT_FALSE(stream->Finish().ok());
+}
+
+}  // namespace hal
+}  // namespace stratum
@@ -392,8 +392,18 @@ void ReportError(const std::string& msg,
 
 constexpr int kThousandMilliseconds = 1000 /* milliseconds */;
 
+// Reports that the stream has been closed before the subscription request has
+// been received.
+::util::Status ReportNoSubscribeRequest(
+    ServerSubscribeReaderWriterInterface* stream) {
+  // Report error to the remote side.
+  ReportError("No subscription request received.", stream);
+  return MAKE_ERROR(ERR_INVALID_PARAM) << "No subscription request received.";
+}
+
 ::util::Status HandleInitialSubscribeRequest(
     GnmiPublisher* publisher, ::grpc::ServerContext* context,
+    const ::gnmi::SubscribeRequest& req,
     ServerSubscribeReaderWriterInterface* stream,
     PathToHandleMap* subscriptions, PathToHandleMap* polls) {
   // Setting send_sync_response to `true` triggers sending a notification to the
@@ -401,13 +411,6 @@ constexpr int kThousandMilliseconds = 1000 /* milliseconds */;
   // for initial ON_CHANGE values and the ONCE operation.
   bool send_sync_response = false;
   ::util::Status status;
-  ::gnmi::SubscribeRequest req;
-  if (!stream->Read(&req)) {
-    // The client called WritesDone() or the stream has been closed.
-    // Report error to the remote side.
-    ReportError("No subscription request received.", stream);
-    return MAKE_ERROR(ERR_INVALID_PARAM) << "No subscription request received.";
-  }
   if (!req.has_subscribe()) {
     // The request did not contain actual subscribe request.
     // Report error to the remote side.
@@ -557,6 +560,52 @@ constexpr int kThousandMilliseconds = 1000 /* milliseconds */;
   return ::util::OkStatus();
 }
 
+// Handles a request received after the initial subscription request. The only
+// valid requests at this stage are POLL and ALIAS.
+void HandleSubsequentSubscribeRequest(
+    GnmiPublisher* publisher, const std::string& uri,
+    const ::gnmi::SubscribeRequest& req, const PathToHandleMap& polls,
+    ServerSubscribeReaderWriterInterface* stream) {
+  LOG(INFO) << "Subscribe request from " << uri << " over stream " << stream
+            << ".";
+  VLOG(1) << "SubscribeRequest: " << req.ShortDebugString();
+  if (req.has_subscribe()) {
+    // Invalid type of request at this stage! Such message is valid only
+    // once at the very beginning.
+    // Report error to the remote side.
+    ReportError(
+        "Invalid subscription request received. Only one per call "
+        "allowed.",
+        stream);
+  } else if (req.has_poll()) {
+    // A poll request. Get updates on all subscribed paths.
+    VLOG(1) << "poll";
+    for (const auto& mapping : polls) {
+      if (publisher->HandlePoll(mapping.second) != ::util::OkStatus()) {
+        ReportError("Error while executing POLL.", stream);
+      }
+    }
+  } else if (req.has_aliases()) {
+    // Received aliases to be created.
+    ReportError("Received an alias request. Unsupported.", stream);
+  } else {
+    // Empty request!?
+    ReportError("Received an empty request.", stream);
+  }
+}
+
+// Unsubscribes and deletes all subscriptions and polls. This stops scheduled
+// timers and prevents access to freed gRPC resources.
+void CancelSubscriptions(GnmiPublisher* publisher,
+                         PathToHandleMap* subscriptions,
+                         PathToHandleMap* polls) {
+  for (auto& subscription : *subscriptions) {
+    publisher->UnSubscribe(subscription.second);
+  }
+  subscriptions->clear();
+  polls->clear();
+}
+
 }  // namespace
 
 ::grpc::Status ConfigMonitoringService::DoSubscribe(
@@ -567,44 +616,24 @@ constexpr int kThousandMilliseconds = 1000 /* milliseconds */;
   ::util::Status status;
   // First process the subscription request. According to the spec there can be
   // only one!
-  if ((status = HandleInitialSubscribeRequest(publisher, context, stream,
-                                              &subscriptions, &polls)) !=
-      ::util::OkStatus()) {
+  ::gnmi::SubscribeRequest req;
+  if (!stream->Read(&req)) {
+    // The client called WritesDone() or the stream has been closed.
+    status = ReportNoSubscribeRequest(stream);
+  } else {
+    status = HandleInitialSubscribeRequest(publisher, context, req, stream,
+                                           &subscriptions, &polls);
+  }
+  if (status != ::util::OkStatus()) {
     return ::grpc::Status(::grpc::StatusCode::INTERNAL, status.ToString());
   }
 
   std::string uri = context->peer();  // remote connection uri
   // Now the only valid requests can be either POLL or ALIAS.
-  ::gnmi::SubscribeRequest req;
   while (true) {
     if (stream->Read(&req)) {
       // All good! The message has been received! Let's process it!
-      LOG(INFO) << "Subscribe request from " << uri << " over stream " << stream
-                << ".";
-      VLOG(1) << "SubscribeRequest: " << req.ShortDebugString();
-      if (req.has_subscribe()) {
-        // Invalid type of request at this stage! Such message is valid only
-        // once at the very beginning.
-        // Report error to the remote side.
-        ReportError(
-            "Invalid subscription request received. Only one per call "
-            "allowed.",
-            stream);
-      } else if (req.has_poll()) {
-        // A poll request. Get updates on all subscribed paths.
-        VLOG(1) << "poll";
-        for (const auto& mapping : polls) {
-          if (publisher->HandlePoll(mapping.second) != ::util::OkStatus()) {
-            ReportError("Error while executing POLL.", stream);
-          }
-        }
-      } else if (req.has_aliases()) {
-        // Received aliases to be created.
-        ReportError("Received an alias request. Unsupported.", stream);
-      } else {
-        // Empty request!?
-        ReportError("Received an empty request.", stream);
-      }
+      HandleSubsequentSubscribeRequest(publisher, uri, req, polls, stream);
     } else {
       // The client called WritesDone() or the stream has been closed.
       // Now the infinite loop should be stopped - no more requests will be
@@ -615,16 +644,100 @@ constexpr int kThousandMilliseconds = 1000 /* milliseconds */;
     }
   }
 
-  // Unsubscribe and delete all subscriptions and polls. This stops scheduled
-  // timers and prevents access to freed gRPC resources.
-  for (auto& subscription : subscriptions) {
-    publisher->UnSubscribe(subscription.second);
-  }
-  subscriptions.clear();
-  polls.clear();
+  CancelSubscriptions(publisher, &subscriptions, &polls);
 
   return ::grpc::Status::OK;
 }
 
+// Keeps the state of one Subscribe call in the asynchronous server.
+class ConfigMonitoringAsyncService::SubscribeHandler
+    : public AsyncStreamHandler<::gnmi::SubscribeResponse,
+                                ::gnmi::SubscribeRequest> {
+ public:
+  explicit SubscribeHandler(ConfigMonitoringService* service)
+      : service_(service), stream_(nullptr), initial_request_received_(false) {}
+
+  ::grpc::Status OnStart(
+      ::grpc::ServerContext* context,
+      ServerSubscribeReaderWriterInterface* stream) override {
+    RETURN_IF_NOT_AUTHORIZED(service_->auth_policy_checker_,
+                             ConfigMonitoringService, Subscribe, context);
+    context_ = context;
+    stream_ = stream;
+    uri_ = context->peer();
+    return ::grpc::Status::OK;
+  }
+
+  ::grpc::Status OnRead(const ::gnmi::SubscribeRequest& req) override {
+    GnmiPublisher* publisher = &service_->gnmi_publisher_;
+    if (initial_request_received_) {
+      HandleSubsequentSubscribeRequest(publisher, uri_, req, polls_, stream_);
+      return ::grpc::Status::OK;
+    }
+    // According to the spec there can be only one subscription request and it
+    // has to be the first one.
+    initial_request_received_ = true;
+    ::util::Status status = HandleInitialSubscribeRequest(
+        publisher, context_, req, stream_, &subscriptions_, &polls_);
+    if (status != ::util::OkStatus()) {
+      return ::grpc::Status(::grpc::StatusCode::INTERNAL, status.ToString());
+    }
+    return ::grpc::Status::OK;
+  }
+
+  ::grpc::Status OnDone() override {
+    CancelSubscriptions(&service_->gnmi_publisher_, &subscriptions_, &polls_);
+    if (!initial_request_received_) {
+      ::util::Status status = ReportNoSubscribeRequest(stream_);
+      return ::grpc::Status(::grpc::StatusCode::INTERNAL, status.ToString());
+    }
+    LOG(INFO) << "Subscribe stream " << stream_ << " from " << uri_
+              << " has been closed.";
+    return ::grpc::Status::OK;
+  }
+
+ private:
+  ConfigMonitoringService* const service_;  // not owned by this class.
+  ::grpc::ServerContext* context_;           // not owned by this class.
+  ServerSubscribeReaderWriterInterface* stream_;  // not owned by this class.
+  std::string uri_;
+  bool initial_request_received_;
+  PathToHandleMap subscriptions_;
+  PathToHandleMap polls_;
+};
+
+void ConfigMonitoringAsyncService::Start(::grpc::ServerCompletionQueue* cq,
+                                         size_t max_queued_writes) {
+  ConfigMonitoringService* service = service_;
+  AsyncWriteQueueOptions options;
+  options.max_queued_writes = max_queued_writes;
+  options.block_when_full = false;
+  AsyncBidiStreamingCall<ConfigMonitoringAsyncService,
+                         ::gnmi::SubscribeResponse, ::gnmi::SubscribeRequest>::
+      Start(this, &ConfigMonitoringAsyncService::RequestSubscribe,
+            [service]() {
+              return absl::make_unique<SubscribeHandler>(service);
+            },
+            options, cq);
+}
+
+::grpc::Status ConfigMonitoringAsyncService::Capabilities(
+    ::grpc::ServerContext* context, const ::gnmi::CapabilityRequest* req,
+    ::gnmi::CapabilityResponse* resp) {
+  return service_->Capabilities(context, req, resp);
+}
+
+::grpc::Status ConfigMonitoringAsyncService::Set(
+    ::grpc::ServerContext* context, const ::gnmi::SetRequest* req,
+    ::gnmi::SetResponse* resp) {
+  return service_->Set(context, req, resp);
+}
+
+::grpc::Status ConfigMonitoringAsyncService::Get(
+    ::grpc::ServerContext* context, const ::gnmi::GetRequest* req,
+    ::gnmi::GetResponse* resp) {
+  return service_->Get(context, req, resp);
+}
+
 }  // namespace hal
 }  // namespace stratum
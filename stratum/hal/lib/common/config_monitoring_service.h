@@ -13,6 +13,7 @@
 #include "grpcpp/grpcpp.h"
 #include "stratum/glue/integral_types.h"
 #include "stratum/glue/status/status.h"
+#include "stratum/hal/lib/common/async_grpc.h"
 #include "stratum/hal/lib/common/common.pb.h"
 #include "stratum/hal/lib/common/error_buffer.h"
 #include "stratum/hal/lib/common/gnmi_publisher.h"
@@ -166,9 +167,51 @@ class ConfigMonitoringService final : public ::gnmi::gNMI::Service {
   // An object handling gNMI Subscribe, Set and Get requests.
   GnmiPublisher gnmi_publisher_;
 
+  friend class ConfigMonitoringAsyncService;
   friend class ConfigMonitoringServiceTest;
 };
 
+// The gNMI service registered in the asynchronous server mode. Subscribe calls
+// are handled on the completion queues of the server, without pinning a
+// thread each. The other RPCs are forwarded to the synchronous
+// ConfigMonitoringService.
+class ConfigMonitoringAsyncService final
+    : public ::gnmi::gNMI::WithAsyncMethod_Subscribe<::gnmi::gNMI::Service> {
+ public:
+  explicit ConfigMonitoringAsyncService(ConfigMonitoringService* service)
+      : service_(service) {}
+
+  // Starts accepting calls on 'cq'. To be called for every completion queue
+  // once the server has been started. Once 'max_queued_writes' responses wait
+  // to be written to a stream, the responses of the publisher fail instead of
+  // blocking its threads, which hold locks the completion queues may need.
+  void Start(::grpc::ServerCompletionQueue* cq, size_t max_queued_writes);
+
+  ::grpc::Status Capabilities(::grpc::ServerContext* context,
+                              const ::gnmi::CapabilityRequest* req,
+                              ::gnmi::CapabilityResponse* resp) override;
+
+  ::grpc::Status Set(::grpc::ServerContext* context,
+                     const ::gnmi::SetRequest* req,
+                     ::gnmi::SetResponse* resp) override;
+
+  ::grpc::Status Get(::grpc::ServerContext* context,
+                     const ::gnmi::GetRequest* req,
+                     ::gnmi::GetResponse* resp) override;
+
+  // ConfigMonitoringAsyncService is neither copyable nor movable.
+  ConfigMonitoringAsyncService(const ConfigMonitoringAsyncService&) = delete;
+  ConfigMonitoringAsyncService& operator=(const ConfigMonitoringAsyncService&) =
+      delete;
+
+ private:
+  class SubscribeHandler;
+
+  // Pointer to the ConfigMonitoringService handling the calls. Not owned by
+  // this class.
+  ConfigMonitoringService* service_;
+};
+
 }  // namespace hal
 }  // namespace stratum
 
@@ -4,19 +4,24 @@
 
 #include "stratum/hal/lib/common/config_monitoring_service.h"
 
+#include <chrono>  // NOLINT
 #include <memory>
 #include <string>
+#include <thread>  // NOLINT
 
 #include "absl/memory/memory.h"
 #include "absl/strings/substitute.h"
 #include "absl/synchronization/mutex.h"
+#include "absl/synchronization/notification.h"
 #include "gflags/gflags.h"
 #include "gmock/gmock.h"
 #include "google/protobuf/text_format.h"
 #include "grpcpp/grpcpp.h"
 #include "gtest/gtest.h"
 #include "openconfig/openconfig.pb.h"
+#include "stratum/glue/net_util/ports.h"
 #include "stratum/glue/status/status_test_util.h"
+#include "stratum/hal/lib/common/async_grpc.h"
 #include "stratum/hal/lib/common/error_buffer.h"
 #include "stratum/hal/lib/common/gnmi_events.h"
 #include "stratum/hal/lib/common/gnmi_publisher.h"
@@ -1190,11 +1195,149 @@ TEST_P(ConfigMonitoringServiceTest, CapabilitiesTest) {
 
 // TODO(unknown): Finish the unit testing.
 
+typedef ::grpc::ClientReaderWriter<::gnmi::SubscribeRequest,
+                                   ::gnmi::SubscribeResponse>
+    ClientSubscribeReaderWriter;
+
+// Runs the service with the ConfigMonitoringAsyncService of the asynchronous
+// server mode.
+class ConfigMonitoringAsyncServiceTest : public ConfigMonitoringServiceTest {
+ protected:
+  void SetUp() override {
+    ConfigMonitoringServiceTest::SetUp();
+    async_service_ = absl::make_unique<ConfigMonitoringAsyncService>(
+        config_monitoring_service_.get());
+    std::string url =
+        "localhost:" + std::to_string(stratum::PickUnusedPortOrDie());
+    ::grpc::ServerBuilder builder;
+    builder.AddListeningPort(url, ::grpc::InsecureServerCredentials());
+    builder.RegisterService(async_service_.get());
+    cq_ = builder.AddCompletionQueue();
+    server_ = builder.BuildAndStart();
+    ASSERT_NE(server_, nullptr);
+    async_service_->Start(cq_.get(), /*max_queued_writes=*/2);
+    cq_thread_ = std::thread(PollCompletionQueue, cq_.get());
+    stub_ = ::gnmi::gNMI::NewStub(
+        ::grpc::CreateChannel(url, ::grpc::InsecureChannelCredentials()));
+    ASSERT_NE(stub_, nullptr);
+  }
+
+  void TearDown() override {
+    if (server_ == nullptr) return;
+    // Cancels the calls still open.
+    server_->Shutdown(std::chrono::system_clock::now());
+    cq_->Shutdown();
+    cq_thread_.join();
+  }
+
+  std::unique_ptr<ConfigMonitoringAsyncService> async_service_;
+  std::unique_ptr<::grpc::ServerCompletionQueue> cq_;
+  std::unique_ptr<::grpc::Server> server_;
+  std::thread cq_thread_;
+  std::unique_ptr<::gnmi::gNMI::Stub> stub_;
+};
+
+TEST_P(ConfigMonitoringAsyncServiceTest, SubscribeFailureForAuthError) {
+  EXPECT_CALL(*auth_policy_checker_mock_,
+              Authorize("ConfigMonitoringService", "Subscribe", _))
+      .WillOnce(Return(
+          ::util::Status(StratumErrorSpace(), ERR_INTERNAL, "Some error")));
+
+  ::grpc::ClientContext context;
+  std::unique_ptr<ClientSubscribeReaderWriter> stream =
+      stub_->Subscribe(&context);
+  ::gnmi::SubscribeResponse resp;
+  EXPECT_FALSE(stream->Read(&resp));
+  ::grpc::Status status = stream->Finish();
+  EXPECT_FALSE(status.ok());
+  EXPECT_THAT(status.error_message(), HasSubstr("Some error"));
+}
+
+TEST_P(ConfigMonitoringAsyncServiceTest, SubscribeFailureForNoRequest) {
+  EXPECT_CALL(*auth_policy_checker_mock_,
+              Authorize("ConfigMonitoringService", "Subscribe", _))
+      .WillOnce(Return(::util::OkStatus()));
+
+  // The error reported on the stream is sent before the call is finished.
+  ::grpc::ClientContext context;
+  std::unique_ptr<ClientSubscribeReaderWriter> stream =
+      stub_->Subscribe(&context);
+  ASSERT_TRUE(stream->WritesDone());
+  ::gnmi::SubscribeResponse resp;
+  ASSERT_TRUE(stream->Read(&resp));
+  EXPECT_THAT(resp.error().message(), HasSubstr("No subscription request"));
+  EXPECT_FALSE(stream->Read(&resp));
+  ::grpc::Status status = stream->Finish();
+  EXPECT_EQ(::grpc::StatusCode::INTERNAL, status.error_code());
+}
+
+TEST_P(ConfigMonitoringAsyncServiceTest, SubscribeFailureForInvalidRequest) {
+  EXPECT_CALL(*auth_policy_checker_mock_,
+              Authorize("ConfigMonitoringService", "Subscribe", _))
+      .WillOnce(Return(::util::OkStatus()));
+
+  ::grpc::ClientContext context;
+  std::unique_ptr<ClientSubscribeReaderWriter> stream =
+      stub_->Subscribe(&context);
+  ::gnmi::SubscribeRequest req;
+  req.mutable_poll();
+  ASSERT_TRUE(stream->Write(req));
+  ::gnmi::SubscribeResponse resp;
+  ASSERT_TRUE(stream->Read(&resp));
+  EXPECT_THAT(resp.error().message(),
+              HasSubstr("No valid subscription request"));
+  EXPECT_FALSE(stream->Read(&resp));
+  ::grpc::Status status = stream->Finish();
+  EXPECT_EQ(::grpc::StatusCode::INTERNAL, status.error_code());
+}
+
+TEST_P(ConfigMonitoringAsyncServiceTest, SubscribeClientCancel) {
+  // The call has been started once it is authorized.
+  absl::Notification started;
+  EXPECT_CALL(*auth_policy_checker_mock_,
+              Authorize("ConfigMonitoringService", "Subscribe", _))
+      .WillOnce(DoAll(Invoke([&started](const std::string&, const std::string&,
+                                        const ::grpc::AuthContext&) {
+                        started.Notify();
+                      }),
+                      Return(::util::OkStatus())));
+
+  ::grpc::ClientContext context;
+  std::unique_ptr<ClientSubscribeReaderWriter> stream =
+      stub_->Subscribe(&context);
+  started.WaitForNotification();
+  context.TryCancel();
+  EXPECT_EQ(::grpc::StatusCode::CANCELLED, stream->Finish().error_code());
+}
+
+TEST_P(ConfigMonitoringAsyncServiceTest, ShutdownFinishesOpenSubscriptions) {
+  // The call has been started once it is authorized.
+  absl::Notification started;
+  EXPECT_CALL(*auth_policy_checker_mock_,
+              Authorize("ConfigMonitoringService", "Subscribe", _))
+      .WillOnce(DoAll(Invoke([&started](const std::string&, const std::string&,
+                                        const ::grpc::AuthContext&) {
+                        started.Notify();
+                      }),
+                      Return(::util::OkStatus())));
+
+  ::grpc::ClientContext context;
+  std::unique_ptr<ClientSubscribeReaderWriter> stream =
+      stub_->Subscribe(&context);
+  started.WaitForNotification();
+  server_->Shutdown(std::chrono::system_clock::now());
+  EXPECT_FALSE(stream->Finish().ok());
+}
+
 INSTANTIATE_TEST_SUITE_P(ConfigMonitoringServiceTestWithMode,
                          ConfigMonitoringServiceTest,
                          ::testing::Values(OPERATION_MODE_STANDALONE,
                                            OPERATION_MODE_COUPLED,
                                            OPERATION_MODE_SIM));
 
+INSTANTIATE_TEST_SUITE_P(ConfigMonitoringAsyncServiceTestWithMode,
+                         ConfigMonitoringAsyncServiceTest,
+                         ::testing::Values(OPERATION_MODE_STANDALONE));
+
 }  // namespace hal
 }  // namespace stratum
@@ -0,0 +1,143 @@
+// Copyright 2018-present Open Networking Foundation
+// SPDX-License-Identifier: Apache-2.0
+
+#include "stratum/hal/lib/common/gnmi_coalescing_stream.h"
+
+#include <algorithm>
+
+#include "stratum/glue/logging.h"
+#include "stratum/glue/status/status_macros.h"
+#include "stratum/lib/macros.h"
+#include "stratum/public/lib/error.h"
+
+namespace stratum {
+namespace hal {
+
+GnmiRateLimiter::GnmiRateLimiter(double rate_per_sec, int burst,
+                                 absl::Time now)
+    : rate_per_sec_(rate_per_sec),
+      burst_(std::max(burst, 1)),
+      tokens_(burst_),
+      last_refill_(now) {}
+
+bool GnmiRateLimiter::TryAcquire(absl::Time now, absl::Duration* wait) {
+  if (rate_per_sec_ <= 0) return true;
+  // Refill the bucket with the tokens accumulated since the last call.
+  if (now > last_refill_) {
+    const double refill =
+        absl::ToDoubleSeconds(now - last_refill_) * rate_per_sec_;
+    tokens_ = std::min(burst_, tokens_ + refill);
+    last_refill_ = now;
+  }
+  if (tokens_ >= 1) {
+    tokens_ -= 1;
+    return true;
+  }
+  *wait = absl::Seconds((1 - tokens_) / rate_per_sec_);
+  return false;
+}
+
+CoalescingGnmiSubscribeStream::CoalescingGnmiSubscribeStream(
+    GnmiSubscribeStream* stream, absl::Duration window,
+    const std::shared_ptr<GnmiRateLimiter>& rate_limiter)
+    : stream_(ABSL_DIE_IF_NULL(stream)),
+      window_(window),
+      rate_limiter_(rate_limiter),
+      pending_timestamp_(0),
+      flush_scheduled_(false),
+      num_coalesced_updates_(0) {}
+
+bool CoalescingGnmiSubscribeStream::Write(const ::gnmi::SubscribeResponse& msg,
+                                          ::grpc::WriteOptions options) {
+  if (!IsCoalescable(msg)) {
+    // The buffered updates precede this message.
+    bool result = pending_updates_.empty() || WritePendingUpdates();
+    return stream_->Write(msg, options) && result;
+  }
+  if (window_ == absl::ZeroDuration() && pending_updates_.empty()) {
+    // No coalescing window, the update is sent right away if the rate limit
+    // permits it.
+    absl::Duration wait;
+    if (rate_limiter_->TryAcquire(absl::Now(), &wait)) {
+      return stream_->Write(msg, options);
+    }
+    Merge(msg.update());
+    ScheduleFlush(wait);
+    return true;
+  }
+  Merge(msg.update());
+  ScheduleFlush(window_);
+  return true;
+}
+
+::util::Status CoalescingGnmiSubscribeStream::Flush(absl::Time now) {
+  flush_scheduled_ = false;
+  if (pending_updates_.empty()) return ::util::OkStatus();
+  absl::Duration wait;
+  if (!rate_limiter_->TryAcquire(now, &wait)) {
+    // Try again when the next token is available. More updates may be merged
+    // in the meantime.
+    ScheduleFlush(wait);
+    return ::util::OkStatus();
+  }
+  if (!WritePendingUpdates()) {
+    return MAKE_ERROR(ERR_INTERNAL)
+           << "Writing coalesced gNMI notification failed!";
+  }
+  return ::util::OkStatus();
+}
+
+bool CoalescingGnmiSubscribeStream::IsCoalescable(
+    const ::gnmi::SubscribeResponse& msg) {
+  if (!msg.has_update()) return false;
+  const ::gnmi::Notification& notification = msg.update();
+  // Only notifications with absolute paths and no deletions are merged.
+  return notification.update_size() > 0 && notification.delete__size() == 0 &&
+         !notification.has_prefix();
+}
+
+void CoalescingGnmiSubscribeStream::Merge(
+    const ::gnmi::Notification& notification) {
+  pending_timestamp_ = std::max(pending_timestamp_, notification.timestamp());
+  for (const auto& update : notification.update()) {
+    // The text format prints map entries sorted by key, so the same path
+    // always yields the same string.
+    std::string key = update.path().ShortDebugString();
+    auto it = pending_paths_.find(key);
+    if (it != pending_paths_.end()) {
+      // A newer value of a buffered path replaces the older one.
+      pending_updates_[it->second] = update;
+      ++num_coalesced_updates_;
+      continue;
+    }
+    pending_paths_.emplace(key, pending_updates_.size());
+    pending_updates_.push_back(update);
+  }
+}
+
+bool CoalescingGnmiSubscribeStream::WritePendingUpdates() {
+  ::gnmi::SubscribeResponse resp;
+  ::gnmi::Notification* notification = resp.mutable_update();
+  notification->set_timestamp(pending_timestamp_);
+  for (auto& update : pending_updates_) {
+    notification->add_update()->Swap(&update);
+  }
+  pending_updates_.clear();
+  pending_paths_.clear();
+  pending_timestamp_ = 0;
+  if (!stream_->Write(resp, ::grpc::WriteOptions())) {
+    LOG(ERROR) << "Writing coalesced gNMI notification with "
+               << notification->update_size() << " updates failed.";
+    return false;
+  }
+  return true;
+}
+
+void CoalescingGnmiSubscribeStream::ScheduleFlush(absl::Duration delay) {
+  if (flush_scheduled_) return;
+  flush_scheduled_ = true;
+  if (schedule_flush_) schedule_flush_(delay);
+}
+
+}  // namespace hal
+}  // namespace stratum
@@ -0,0 +1,154 @@
+// Copyright 2018-present Open Networking Foundation
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef STRATUM_HAL_LIB_COMMON_GNMI_COALESCING_STREAM_H_
+#define STRATUM_HAL_LIB_COMMON_GNMI_COALESCING_STREAM_H_
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/time/time.h"
+#include "gnmi/gnmi.grpc.pb.h"
+#include "stratum/glue/integral_types.h"
+#include "stratum/glue/status/status.h"
+#include "stratum/hal/lib/common/gnmi_events.h"
+
+namespace stratum {
+namespace hal {
+
+// GnmiRateLimiter is a token bucket limiting the number of notifications sent
+// over one gNMI stream. The bucket holds up to 'burst' tokens and is refilled
+// at 'rate_per_sec' tokens per second; every notification takes one token. A
+// rate of zero disables the limit.
+//
+// This class is not thread-safe; the GnmiPublisher serializes all the calls
+// under its lock.
+class GnmiRateLimiter {
+ public:
+  GnmiRateLimiter(double rate_per_sec, int burst, absl::Time now);
+  virtual ~GnmiRateLimiter() {}
+
+  // Takes a token at time 'now' and returns true if one was available.
+  // Otherwise returns false and sets 'wait' to the time until the next token
+  // is available.
+  bool TryAcquire(absl::Time now, absl::Duration* wait);
+
+ private:
+  const double rate_per_sec_;
+  const double burst_;
+  double tokens_;
+  absl::Time last_refill_;
+};
+
+// CoalescingGnmiSubscribeStream wraps the stream of an ON_CHANGE subscription
+// to protect the client from event storms (e.g. link flaps or a line-card
+// reset). The update notifications written to it are buffered for 'window'
+// and merged: an update of a path already in the buffer replaces the previous
+// value. When the window expires, all the buffered updates are packed into a
+// single notification with one Update per path and sent as soon as the
+// GnmiRateLimiter of the underlying stream permits it.
+//
+// The wrapper does not own a timer. When it needs to be flushed, it calls the
+// FlushScheduler with the delay after which Flush() is expected to be called.
+//
+// This class is not thread-safe; the GnmiPublisher serializes all the calls
+// under its lock.
+class CoalescingGnmiSubscribeStream : public GnmiSubscribeStream {
+ public:
+  using FlushScheduler = std::function<void(absl::Duration delay)>;
+
+  // Does not take the ownership of 'stream'. 'rate_limiter' must not be null
+  // and may be shared by all the subscriptions of the same underlying stream.
+  // With a zero 'window' the updates are only buffered while rate limited.
+  CoalescingGnmiSubscribeStream(
+      GnmiSubscribeStream* stream, absl::Duration window,
+      const std::shared_ptr<GnmiRateLimiter>& rate_limiter);
+  ~CoalescingGnmiSubscribeStream() override {}
+
+  // Buffers the updates in 'msg'. Any other message (e.g. a deletion or a
+  // sync_response) is written through, after the buffered updates, to keep the
+  // order of the stream, and is not rate limited. Returns false only if a write
+  // to the underlying stream failed.
+  bool Write(const ::gnmi::SubscribeResponse& msg,
+             ::grpc::WriteOptions options) override;
+
+  // Sends the buffered updates in one notification if the rate limit permits
+  // it. Otherwise reschedules the flush for when a token is available.
+  ::util::Status Flush(absl::Time now);
+
+  // Sets the functor called when a Flush() has to be scheduled. Must be set
+  // before the first Write().
+  void SetFlushScheduler(const FlushScheduler& scheduler) {
+    schedule_flush_ = scheduler;
+  }
+
+  // Returns the number of updates waiting in the buffer.
+  size_t GetNumPendingUpdates() const { return pending_updates_.size(); }
+
+  // Returns the number of updates which were merged into a later update of the
+  // same path and never sent.
+  uint64 GetNumCoalescedUpdates() const { return num_coalesced_updates_; }
+
+ private:
+  // Required by the interface but not used. Made private to prevent their
+  // accidental usage.
+  void SendInitialMetadata() override { CHECK(false); }
+  bool NextMessageSize(uint32_t* sz) override { CHECK(false); }
+  bool Read(::gnmi::SubscribeRequest* msg) override { CHECK(false); }
+
+  // Returns true if 'msg' carries only updates that can be merged.
+  static bool IsCoalescable(const ::gnmi::SubscribeResponse& msg);
+
+  // Adds the updates of 'notification' to the buffer.
+  void Merge(const ::gnmi::Notification& notification);
+
+  // Packs the buffered updates into one message, writes it to the underlying
+  // stream and empties the buffer.
+  bool WritePendingUpdates();
+
+  // Asks for Flush() to be called after 'delay'.
+  void ScheduleFlush(absl::Duration delay);
+
+  // The stream to the client (the controller). Not owned by this class.
+  GnmiSubscribeStream* stream_;
+  const absl::Duration window_;
+  std::shared_ptr<GnmiRateLimiter> rate_limiter_;
+  FlushScheduler schedule_flush_;
+  // The buffered updates in the order their paths were first seen and the
+  // index of every path in this vector.
+  std::vector<::gnmi::Update> pending_updates_;
+  absl::flat_hash_map<std::string, size_t> pending_paths_;
+  // The timestamp of the most recent buffered notification.
+  int64 pending_timestamp_;
+  // True if a Flush() has been scheduled and not executed yet.
+  bool flush_scheduled_;
+  uint64 num_coalesced_updates_;
+};
+
+// The record of an ON_CHANGE subscription whose updates go through a
+// CoalescingGnmiSubscribeStream. The record owns the wrapper.
+class CoalescingEventHandlerRecord : public EventHandlerRecord {
+ public:
+  CoalescingEventHandlerRecord(
+      const GnmiEventHandler& handler,
+      std::unique_ptr<CoalescingGnmiSubscribeStream> stream)
+      : EventHandlerRecord(handler, stream.get()),
+        coalescing_stream_(std::move(stream)) {}
+  ~CoalescingEventHandlerRecord() override {}
+
+  CoalescingGnmiSubscribeStream* coalescing_stream() {
+    return coalescing_stream_.get();
+  }
+
+ private:
+  std::unique_ptr<CoalescingGnmiSubscribeStream> coalescing_stream_;
+};
+
+}  // namespace hal
+}  // namespace stratum
+
+#endif  // STRATUM_HAL_LIB_COMMON_GNMI_COALESCING_STREAM_H_
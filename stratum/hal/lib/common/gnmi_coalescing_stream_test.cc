@@ -0,0 +1,198 @@
+// Copyright 2018-present Open Networking Foundation
+// SPDX-License-Identifier: Apache-2.0
+
+#include "stratum/hal/lib/common/gnmi_coalescing_stream.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/memory/memory.h"
+#include "gmock/gmock.h"
+#include "gnmi/gnmi.pb.h"
+#include "gtest/gtest.h"
+#include "stratum/glue/status/status_test_util.h"
+#include "stratum/hal/lib/common/subscribe_reader_writer_mock.h"
+
+namespace stratum {
+namespace hal {
+
+using ::testing::_;
+using ::testing::DoAll;
+using ::testing::ElementsAre;
+using ::testing::InSequence;
+using ::testing::Invoke;
+using ::testing::Return;
+using ::testing::SaveArg;
+
+namespace {
+
+// Returns an update message of the 'leaf' of port 'port' set to 'value'.
+::gnmi::SubscribeResponse GetUpdate(const std::string& port,
+                                    const std::string& leaf, uint64 value,
+                                    int64 timestamp) {
+  ::gnmi::SubscribeResponse resp;
+  ::gnmi::Notification* notification = resp.mutable_update();
+  notification->set_timestamp(timestamp);
+  ::gnmi::Update* update = notification->add_update();
+  ::gnmi::PathElem* elem = update->mutable_path()->add_elem();
+  elem->set_name("interface");
+  (*elem->mutable_key())["name"] = port;
+  update->mutable_path()->add_elem()->set_name(leaf);
+  update->mutable_val()->set_uint_val(value);
+  return resp;
+}
+
+}  // namespace
+
+class CoalescingGnmiSubscribeStreamTest : public ::testing::Test {
+ protected:
+  void SetUp() override { start_ = absl::Now(); }
+
+  // Creates the stream under test. The requested flushes are recorded in
+  // flush_delays_.
+  void CreateStream(absl::Duration window, double rate_per_sec, int burst) {
+    coalescing_stream_ = absl::make_unique<CoalescingGnmiSubscribeStream>(
+        &stream_, window,
+        std::make_shared<GnmiRateLimiter>(rate_per_sec, burst, start_));
+    coalescing_stream_->SetFlushScheduler(
+        [this](absl::Duration delay) { flush_delays_.push_back(delay); });
+  }
+
+  // Writes an update of the oper-status of 'port' to the stream under test.
+  bool WriteUpdate(const std::string& port, uint64 value, int64 timestamp) {
+    return coalescing_stream_->Write(
+        GetUpdate(port, "oper-status", value, timestamp),
+        ::grpc::WriteOptions());
+  }
+
+  absl::Time start_;
+  SubscribeReaderWriterMock stream_;
+  std::unique_ptr<CoalescingGnmiSubscribeStream> coalescing_stream_;
+  std::vector<absl::Duration> flush_delays_;
+};
+
+TEST(GnmiRateLimiterTest, TokensAreRefilledAtConfiguredRate) {
+  const absl::Time start = absl::Now();
+  GnmiRateLimiter limiter(10, 2, start);
+  absl::Duration wait;
+
+  // The full burst is available right away.
+  EXPECT_TRUE(limiter.TryAcquire(start, &wait));
+  EXPECT_TRUE(limiter.TryAcquire(start, &wait));
+  EXPECT_FALSE(limiter.TryAcquire(start, &wait));
+  EXPECT_EQ(absl::Milliseconds(100), wait);
+  EXPECT_FALSE(limiter.TryAcquire(start + absl::Milliseconds(60), &wait));
+  EXPECT_EQ(absl::Milliseconds(40), wait);
+  EXPECT_TRUE(limiter.TryAcquire(start + absl::Milliseconds(100), &wait));
+  // A long pause does not accumulate more than the burst.
+  EXPECT_TRUE(limiter.TryAcquire(start + absl::Seconds(10), &wait));
+  EXPECT_TRUE(limiter.TryAcquire(start + absl::Seconds(10), &wait));
+  EXPECT_FALSE(limiter.TryAcquire(start + absl::Seconds(10), &wait));
+}
+
+TEST(GnmiRateLimiterTest, ZeroRateIsUnlimited) {
+  const absl::Time start = absl::Now();
+  GnmiRateLimiter limiter(0, 1, start);
+  absl::Duration wait;
+  for (int i = 0; i < 1000; ++i) EXPECT_TRUE(limiter.TryAcquire(start, &wait));
+}
+
+TEST_F(CoalescingGnmiSubscribeStreamTest, UpdatesOfSamePathAreMerged) {
+  CreateStream(absl::Milliseconds(50), 0, 1);
+
+  // Nothing is sent before the window expires.
+  EXPECT_CALL(stream_, Write(_, _)).Times(0);
+  EXPECT_TRUE(WriteUpdate("ce-1/1", 1, 1));
+  EXPECT_TRUE(WriteUpdate("ce-1/2", 1, 2));
+  EXPECT_TRUE(WriteUpdate("ce-1/1", 2, 3));
+  EXPECT_EQ(2U, coalescing_stream_->GetNumPendingUpdates());
+  EXPECT_EQ(1U, coalescing_stream_->GetNumCoalescedUpdates());
+  // Only the first update schedules a flush.
+  EXPECT_THAT(flush_delays_, ElementsAre(absl::Milliseconds(50)));
+  ::testing::Mock::VerifyAndClearExpectations(&stream_);
+
+  // Both ports are sent in one notification, with the latest values.
+  ::gnmi::SubscribeResponse resp;
+  EXPECT_CALL(stream_, Write(_, _))
+      .WillOnce(DoAll(SaveArg<0>(&resp), Return(true)));
+  EXPECT_OK(coalescing_stream_->Flush(start_ + absl::Milliseconds(50)));
+  EXPECT_EQ(0U, coalescing_stream_->GetNumPendingUpdates());
+  EXPECT_EQ(3, resp.update().timestamp());
+  ASSERT_EQ(2, resp.update().update_size());
+  EXPECT_EQ("ce-1/1", resp.update().update(0).path().elem(0).key().at("name"));
+  EXPECT_EQ(2U, resp.update().update(0).val().uint_val());
+  EXPECT_EQ("ce-1/2", resp.update().update(1).path().elem(0).key().at("name"));
+  EXPECT_EQ(1U, resp.update().update(1).val().uint_val());
+
+  // A flush with an empty buffer sends nothing.
+  EXPECT_OK(coalescing_stream_->Flush(start_ + absl::Milliseconds(60)));
+}
+
+TEST_F(CoalescingGnmiSubscribeStreamTest, OtherMessagesKeepStreamOrder) {
+  CreateStream(absl::Milliseconds(50), 0, 1);
+  EXPECT_TRUE(WriteUpdate("ce-1/1", 1, 1));
+
+  // The buffered update is sent before the sync_response.
+  ::gnmi::SubscribeResponse sync;
+  sync.set_sync_response(true);
+  {
+    InSequence s;
+    EXPECT_CALL(stream_, Write(_, _))
+        .WillOnce(Invoke([](const ::gnmi::SubscribeResponse& msg,
+                            ::grpc::WriteOptions options) {
+          EXPECT_EQ(1, msg.update().update_size());
+          return true;
+        }));
+    EXPECT_CALL(stream_, Write(_, _))
+        .WillOnce(Invoke([](const ::gnmi::SubscribeResponse& msg,
+                            ::grpc::WriteOptions options) {
+          EXPECT_TRUE(msg.sync_response());
+          return true;
+        }));
+  }
+  EXPECT_TRUE(coalescing_stream_->Write(sync, ::grpc::WriteOptions()));
+  EXPECT_EQ(0U, coalescing_stream_->GetNumPendingUpdates());
+}
+
+TEST_F(CoalescingGnmiSubscribeStreamTest, UpdatesAreRateLimited) {
+  // No window: the updates are only held back by the rate limit.
+  CreateStream(absl::ZeroDuration(), 10, 1);
+
+  EXPECT_CALL(stream_, Write(_, _)).WillOnce(Return(true));
+  EXPECT_TRUE(WriteUpdate("ce-1/1", 1, 1));
+  EXPECT_THAT(flush_delays_, ElementsAre());
+  ::testing::Mock::VerifyAndClearExpectations(&stream_);
+
+  // The bucket is empty, so the storm is merged until a token is available.
+  EXPECT_CALL(stream_, Write(_, _)).Times(0);
+  for (int i = 2; i < 100; ++i) {
+    EXPECT_TRUE(WriteUpdate("ce-1/1", i, i));
+  }
+  EXPECT_EQ(1U, coalescing_stream_->GetNumPendingUpdates());
+  EXPECT_EQ(1U, flush_delays_.size());
+  // A flush before the next token reschedules itself for the remaining ~50ms.
+  EXPECT_OK(coalescing_stream_->Flush(start_ + absl::Milliseconds(50)));
+  ASSERT_EQ(2U, flush_delays_.size());
+  EXPECT_GE(flush_delays_.back(), absl::Milliseconds(50));
+  EXPECT_LT(flush_delays_.back(), absl::Milliseconds(100));
+  ::testing::Mock::VerifyAndClearExpectations(&stream_);
+
+  ::gnmi::SubscribeResponse resp;
+  EXPECT_CALL(stream_, Write(_, _))
+      .WillOnce(DoAll(SaveArg<0>(&resp), Return(true)));
+  EXPECT_OK(coalescing_stream_->Flush(start_ + absl::Milliseconds(200)));
+  ASSERT_EQ(1, resp.update().update_size());
+  EXPECT_EQ(99U, resp.update().update(0).val().uint_val());
+}
+
+TEST_F(CoalescingGnmiSubscribeStreamTest, FailedWriteIsReported) {
+  CreateStream(absl::Milliseconds(50), 0, 1);
+  EXPECT_TRUE(WriteUpdate("ce-1/1", 1, 1));
+  EXPECT_CALL(stream_, Write(_, _)).WillOnce(Return(false));
+  EXPECT_FALSE(coalescing_stream_->Flush(start_ + absl::Milliseconds(50)).ok());
+  EXPECT_EQ(0U, coalescing_stream_->GetNumPendingUpdates());
+}
+
+}  // namespace hal
+}  // namespace stratum
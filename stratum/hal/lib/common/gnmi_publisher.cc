@@ -8,12 +8,33 @@
 #include <string>
 #include <utility>
 
+#include "absl/memory/memory.h"
 #include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "gflags/gflags.h"
 #include "gnmi/gnmi.pb.h"
 #include "stratum/glue/gtl/map_util.h"
 #include "stratum/hal/lib/common/channel_writer_wrapper.h"
+#include "stratum/hal/lib/common/gnmi_coalescing_stream.h"
 #include "stratum/hal/lib/common/yang_parse_tree_paths.h"
 
+DEFINE_bool(gnmi_coalesce_periodic_reads, false,
+            "Coalesce the switch reads of the leaves of a periodic gNMI "
+            "subscription into one batched request per node and timer tick. "
+            "By default, every leaf reads its value on its own.");
+DEFINE_int32(gnmi_on_change_coalesce_window_ms, 0,
+             "Time for which the updates of an ON_CHANGE gNMI subscription are "
+             "buffered and merged before they are sent in one notification. "
+             "0 sends every update right away.");
+DEFINE_double(gnmi_on_change_max_notifications_per_sec, 0,
+              "Maximum rate of the ON_CHANGE notifications sent over one gNMI "
+              "stream. The updates exceeding it are merged until they can be "
+              "sent. 0 disables the limit.");
+DEFINE_int32(gnmi_on_change_max_notifications_burst, 10,
+             "Number of ON_CHANGE notifications that can be sent over one gNMI "
+             "stream in a burst above "
+             "--gnmi_on_change_max_notifications_per_sec.");
+
 namespace stratum {
 namespace hal {
 
@@ -103,6 +124,22 @@ GnmiPublisher::~GnmiPublisher() {}
   return ::util::OkStatus();
 }
 
+::util::Status GnmiPublisher::HandleTimerEvent(
+    const EventHandlerRecordPtr& h, TelemetrySnapshot* snapshot) {
+  absl::WriterMutexLock l(&access_lock_);
+
+  std::shared_ptr<EventHandlerRecord> handler = h.lock();
+  if (handler == nullptr) return ::util::OkStatus();
+  if (snapshot == nullptr) return (*handler)(TimerEvent());
+  // All the leaves handled in this tick read the switch through the snapshot.
+  snapshot->BeginTick();
+  parse_tree_.SetTelemetrySnapshot(snapshot);
+  ::util::Status status = (*handler)(TimerEvent());
+  parse_tree_.SetTelemetrySnapshot(nullptr);
+  snapshot->EndTick();
+  return status;
+}
+
 ::util::Status GnmiPublisher::HandlePoll(const SubscriptionHandle& handle) {
   absl::WriterMutexLock l(&access_lock_);
 
@@ -119,9 +156,18 @@ GnmiPublisher::~GnmiPublisher() {}
     return status;
   }
   EventHandlerRecordPtr weak(*h);
+  // The snapshot lives as long as the timer that uses it.
+  std::shared_ptr<TelemetrySnapshot> snapshot;
+  if (FLAGS_gnmi_coalesce_periodic_reads) {
+    absl::WriterMutexLock l(&access_lock_);
+    snapshot =
+        std::make_shared<TelemetrySnapshot>(parse_tree_.GetSwitchInterface());
+  }
   if (TimerDaemon::RequestPeriodicTimer(
           freq.delay_ms_, freq.period_ms_,
-          [weak, this]() { return this->HandleEvent(TimerEvent(), weak); },
+          [weak, snapshot, this]() {
+            return this->HandleTimerEvent(weak, snapshot.get());
+          },
           (*h)->mutable_timer()) != ::util::OkStatus()) {
     return MAKE_ERROR(ERR_INTERNAL) << "Cannot start timer.";
   }
@@ -149,8 +195,66 @@ GnmiPublisher::~GnmiPublisher() {}
   // all event handler lists that handle events of the type this handler is
   // prepared to handle.
   absl::WriterMutexLock l(&access_lock_);
-  return parse_tree_.FindNodeOrNull(path)->DoOnChangeRegistration(
-      EventHandlerRecordPtr(*h));
+  const TreeNode* node = parse_tree_.FindNodeOrNull(path);
+  if (FLAGS_gnmi_on_change_coalesce_window_ms > 0 ||
+      FLAGS_gnmi_on_change_max_notifications_per_sec > 0) {
+    MakeCoalescing(*node, stream, h);
+  }
+  return node->DoOnChangeRegistration(EventHandlerRecordPtr(*h));
+}
+
+void GnmiPublisher::MakeCoalescing(const TreeNode& node,
+                                   GnmiSubscribeStream* stream,
+                                   SubscriptionHandle* h) {
+  // Drop the rate limiters of the streams that have no subscriptions left.
+  for (auto it = rate_limiters_.begin(); it != rate_limiters_.end();) {
+    if (it->second.expired()) {
+      rate_limiters_.erase(it++);
+    } else {
+      ++it;
+    }
+  }
+  std::shared_ptr<GnmiRateLimiter> rate_limiter = rate_limiters_[stream].lock();
+  if (rate_limiter == nullptr) {
+    rate_limiter = std::make_shared<GnmiRateLimiter>(
+        FLAGS_gnmi_on_change_max_notifications_per_sec,
+        FLAGS_gnmi_on_change_max_notifications_burst, absl::Now());
+    rate_limiters_[stream] = rate_limiter;
+  }
+  auto coalescing_stream = absl::make_unique<CoalescingGnmiSubscribeStream>(
+      stream, absl::Milliseconds(FLAGS_gnmi_on_change_coalesce_window_ms),
+      rate_limiter);
+  CoalescingGnmiSubscribeStream* wrapper = coalescing_stream.get();
+  h->reset(new CoalescingEventHandlerRecord(node.GetOnChangeHandler(),
+                                            std::move(coalescing_stream)));
+  // The flush is requested by the event handlers and by the flushes
+  // themselves, all of which run under access_lock_. The timer is owned by the
+  // record, so it is canceled when the subscription is gone.
+  EventHandlerRecordPtr weak(*h);
+  wrapper->SetFlushScheduler([this, weak](absl::Duration delay) {
+    std::shared_ptr<EventHandlerRecord> record = weak.lock();
+    if (record == nullptr) return;
+    uint64 delay_ms = absl::ToInt64Milliseconds(
+        absl::Ceil(delay, absl::Milliseconds(1)));
+    if (TimerDaemon::RequestOneShotTimer(
+            delay_ms, [this, weak]() { return this->HandleFlushEvent(weak); },
+            record->mutable_timer()) != ::util::OkStatus()) {
+      LOG(ERROR) << "Cannot start the flush timer of an ON_CHANGE "
+                 << "subscription.";
+    }
+  });
+}
+
+::util::Status GnmiPublisher::HandleFlushEvent(const EventHandlerRecordPtr& h) {
+  absl::WriterMutexLock l(&access_lock_);
+
+  std::shared_ptr<EventHandlerRecord> handler = h.lock();
+  if (handler == nullptr) return ::util::OkStatus();
+  auto* record = dynamic_cast<CoalescingEventHandlerRecord*>(handler.get());
+  if (record == nullptr) {
+    return MAKE_ERROR(ERR_INTERNAL) << "Not a coalescing subscription!";
+  }
+  return record->coalescing_stream()->Flush(absl::Now());
 }
 
 ::util::Status GnmiPublisher::Subscribe(
@@ -265,7 +369,8 @@ void* GnmiPublisher::ThreadReadGnmiEvents(void* arg) {
   // If we have not done that yet, create notification event Channel, register
   // it, and create Reader thread.
   if (event_channel_ == nullptr && switch_interface_ != nullptr) {
-    event_channel_ = Channel<GnmiEventPtr>::Create(kMaxGnmiEventDepth);
+    event_channel_ =
+        Channel<GnmiEventPtr>::Create(kMaxGnmiEventDepth, "gnmi_events");
     // Create and register writer to channel with the BcmSdkInterface.
     auto writer = std::make_shared<ChannelWriterWrapper<GnmiEventPtr>>(
         ChannelWriter<GnmiEventPtr>::Create(event_channel_));
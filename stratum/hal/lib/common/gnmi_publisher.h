@@ -21,6 +21,7 @@
 #include "stratum/glue/status/status.h"
 #include "stratum/glue/status/status_macros.h"
 #include "stratum/hal/lib/common/gnmi_events.h"
+#include "stratum/hal/lib/common/telemetry_snapshot.h"
 #include "stratum/hal/lib/common/yang_parse_tree.h"
 #include "stratum/lib/timer_daemon.h"
 #include "stratum/public/lib/error.h"
@@ -29,6 +30,7 @@ namespace stratum {
 namespace hal {
 
 class ConfigMonitoringServiceTest;
+class GnmiRateLimiter;
 class SubscriptionTest;
 
 // A container for all paremeters needed to define how often a subscriber wants
@@ -159,6 +161,25 @@ class GnmiPublisher {
                              const EventHandlerRecordPtr& h)
       LOCKS_EXCLUDED(access_lock_);
 
+  // Handles a timer tick of a periodic subscription. If 'snapshot' is not
+  // nullptr, the switch reads of all the leaves handled in this tick are
+  // coalesced through it.
+  ::util::Status HandleTimerEvent(const EventHandlerRecordPtr& h,
+                                  TelemetrySnapshot* snapshot)
+      LOCKS_EXCLUDED(access_lock_);
+
+  // Sends the updates buffered by a coalescing ON_CHANGE subscription.
+  ::util::Status HandleFlushEvent(const EventHandlerRecordPtr& h)
+      LOCKS_EXCLUDED(access_lock_);
+
+  // Wraps the stream of the ON_CHANGE subscription 'h' in a
+  // CoalescingGnmiSubscribeStream, as configured by the
+  // --gnmi_on_change_coalesce_window_ms and
+  // --gnmi_on_change_max_notifications_per_sec flags.
+  void MakeCoalescing(const TreeNode& node, GnmiSubscribeStream* stream,
+                      SubscriptionHandle* h)
+      EXCLUSIVE_LOCKS_REQUIRED(access_lock_);
+
   // A generic method handling all types of subscriptions. Requires long list of
   // parameters, so, it has been hidden here and specialized methods calling it
   // have been exposed as public interface.
@@ -211,6 +232,12 @@ class GnmiPublisher {
               };  // NOLINT
   SubscriptionHandle on_config_pushed_;
 
+  // The ON_CHANGE rate limiters, one per client stream. They are shared by all
+  // the coalescing subscriptions of the stream and are destroyed with the last
+  // of them.
+  absl::flat_hash_map<GnmiSubscribeStream*, std::weak_ptr<GnmiRateLimiter>>
+      rate_limiters_ GUARDED_BY(access_lock_);
+
   friend class ConfigMonitoringServiceTest;
   friend class SubscriptionTestBase;
 };
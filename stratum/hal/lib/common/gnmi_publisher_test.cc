@@ -5,6 +5,7 @@
 #include "stratum/hal/lib/common/gnmi_publisher.h"
 
 #include "absl/synchronization/mutex.h"
+#include "gflags/gflags.h"
 #include "gmock/gmock.h"
 #include "gnmi/gnmi.pb.h"
 #include "gtest/gtest.h"
@@ -13,6 +14,8 @@
 #include "stratum/hal/lib/common/switch_mock.h"
 #include "stratum/lib/utils.h"
 
+DECLARE_int32(gnmi_on_change_coalesce_window_ms);
+
 namespace stratum {
 namespace hal {
 
@@ -119,6 +122,16 @@ class SubscriptionTestBase {
     LOG(INFO) << path.ShortDebugString();
   }
 
+  ::util::Status HandleTimerEvent(const SubscriptionHandle& h,
+                                  TelemetrySnapshot* snapshot) {
+    return gnmi_publisher_->HandleTimerEvent(EventHandlerRecordPtr(h),
+                                             snapshot);
+  }
+
+  ::util::Status HandleFlushEvent(const SubscriptionHandle& h) {
+    return gnmi_publisher_->HandleFlushEvent(EventHandlerRecordPtr(h));
+  }
+
   ChassisConfig hal_config_;
   SwitchMock switch_mock_;
   std::unique_ptr<GnmiPublisher> gnmi_publisher_;
@@ -231,6 +244,76 @@ TEST_F(SubscriptionTest, HandleTimer) {
   EXPECT_OK(gnmi_publisher_->HandleChange(TimerEvent()));
 }
 
+TEST_F(SubscriptionTest, HandleTimerCoalescesSwitchReads) {
+  SubscribeReaderWriterMock stream;
+  SubscriptionHandle h;
+  ::gnmi::Path path = GetPath("interfaces")(
+      "interface", "device1.domain.net.com:ce-1/1")("state")("counters")();
+  EXPECT_OK(
+      gnmi_publisher_->SubscribePeriodic(Periodic(1000), path, &stream, &h));
+
+  // All 14 counters of the port are sent in every tick.
+  EXPECT_CALL(stream, Write(_, _)).Times(3 * 14).WillRepeatedly(Return(true));
+  // Mock implementation of RetrieveValue() that answers every request with
+  // the port counters.
+  int num_requests = 0;
+  EXPECT_CALL(switch_mock_, RetrieveValue(_, _, _, _))
+      .WillRepeatedly(Invoke([&num_requests](
+                                 uint64 node_id, const DataRequest& req,
+                                 WriterInterface<DataResponse>* w,
+                                 std::vector<::util::Status>* details) {
+        for (const auto& r : req.requests()) {
+          EXPECT_TRUE(r.has_port_counters());
+          DataResponse resp;
+          resp.mutable_port_counters()->set_in_octets(1234);
+          w->Write(resp);
+          if (details) details->push_back(::util::OkStatus());
+          ++num_requests;
+        }
+        return ::util::OkStatus();
+      }));
+
+  // Without a snapshot every leaf queries the switch.
+  EXPECT_OK(HandleTimerEvent(h, nullptr));
+  EXPECT_EQ(14, num_requests);
+
+  // With a snapshot the first tick retrieves the counters once and the
+  // following ones prefetch them in one batched call.
+  TelemetrySnapshot snapshot(&switch_mock_);
+  EXPECT_OK(HandleTimerEvent(h, &snapshot));
+  EXPECT_EQ(1U, snapshot.GetNumSwitchCalls());
+  EXPECT_OK(HandleTimerEvent(h, &snapshot));
+  EXPECT_EQ(2U, snapshot.GetNumSwitchCalls());
+  EXPECT_EQ(14 + 2, num_requests);
+}
+
+TEST_F(SubscriptionTest, OnChangeUpdatesAreCoalesced) {
+  ::gflags::FlagSaver flag_saver;
+  // A long window, so the flush timer never fires during the test.
+  FLAGS_gnmi_on_change_coalesce_window_ms = 60000;
+  SubscribeReaderWriterMock stream;
+  SubscriptionHandle h;
+  ::gnmi::Path path = GetPath("interfaces")(
+      "interface", "device1.domain.net.com:ce-1/1")("state")("oper-status")();
+  EXPECT_OK(gnmi_publisher_->SubscribeOnChange(path, &stream, &h));
+
+  // Nothing is sent while the port is flapping.
+  EXPECT_CALL(stream, Write(_, _)).Times(0);
+  for (int i = 0; i < 10; ++i) {
+    EXPECT_OK(gnmi_publisher_->HandleChange(PortOperStateChangedEvent(
+        1, 1, i % 2 ? PORT_STATE_UP : PORT_STATE_DOWN, 0)));
+  }
+  ::testing::Mock::VerifyAndClearExpectations(&stream);
+
+  // Only the last state is sent when the window expires.
+  ::gnmi::SubscribeResponse resp;
+  EXPECT_CALL(stream, Write(_, _))
+      .WillOnce(DoAll(SaveArg<0>(&resp), Return(true)));
+  EXPECT_OK(HandleFlushEvent(h));
+  ASSERT_EQ(1, resp.update().update_size());
+  EXPECT_EQ("UP", resp.update().update(0).val().string_val());
+}
+
 TEST_F(SubscriptionTest, OnUpdateUnSupportedPath) {
   // Configure the device - the model will reconfigure itself to reflect the
   // configuration.
@@ -6,6 +6,7 @@
 
 #include <limits.h>
 
+#include <thread>  // NOLINT
 #include <utility>
 
 #include "absl/base/macros.h"
@@ -15,6 +16,7 @@
 #include "absl/synchronization/mutex.h"
 #include "gflags/gflags.h"
 #include "stratum/glue/logging.h"
+#include "stratum/hal/lib/common/async_grpc.h"
 #include "stratum/lib/constants.h"
 #include "stratum/lib/macros.h"
 #include "stratum/lib/utils.h"
@@ -38,6 +40,17 @@ DEFINE_uint32(grpc_max_recv_msg_size, 256 * 1024 * 1024,
               "grpc server max receive message size (0 = gRPC default).");
 DEFINE_uint32(grpc_max_send_msg_size, 0,
               "grpc server max send message size (0 = gRPC default).");
+DEFINE_bool(grpc_async_server, false,
+            "Handle the P4Runtime StreamChannel and the gNMI Subscribe RPCs "
+            "on completion queues, instead of a thread per call.");
+DEFINE_uint32(grpc_async_server_threads, 2,
+              "Number of completion queues, each polled by one thread, used "
+              "when grpc_async_server is set.");
+DEFINE_uint32(grpc_async_server_max_queued_writes, 64,
+              "Max number of responses waiting to be written to a stream when "
+              "grpc_async_server is set. P4Runtime stream messages wait for "
+              "room, gNMI notifications written to a full stream are "
+              "dropped.");
 
 namespace stratum {
 namespace hal {
@@ -93,6 +106,10 @@ Hal::Hal(OperationMode mode, SwitchInterface* switch_interface,
       certificate_management_service_(nullptr),
       diag_service_(nullptr),
       file_service_(nullptr),
+      config_monitoring_async_service_(nullptr),
+      p4_async_service_(nullptr),
+      completion_queues_(),
+      completion_queue_threads_(),
       external_server_(nullptr),
       old_signal_handlers_(),
       signal_waiter_tid_() {}
@@ -205,18 +222,40 @@ Hal::~Hal() {
     if (FLAGS_grpc_max_send_msg_size > 0) {
       builder.SetMaxSendMessageSize(FLAGS_grpc_max_send_msg_size);
     }
-    builder.RegisterService(config_monitoring_service_.get());
-    builder.RegisterService(p4_service_.get());
+    if (FLAGS_grpc_async_server) {
+      RET_CHECK(FLAGS_grpc_async_server_threads > 0)
+          << "grpc_async_server_threads must be positive.";
+      builder.RegisterService(config_monitoring_async_service_.get());
+      builder.RegisterService(p4_async_service_.get());
+      for (uint32 i = 0; i < FLAGS_grpc_async_server_threads; ++i) {
+        completion_queues_.push_back(builder.AddCompletionQueue());
+      }
+    } else {
+      builder.RegisterService(config_monitoring_service_.get());
+      builder.RegisterService(p4_service_.get());
+    }
     builder.RegisterService(admin_service_.get());
     builder.RegisterService(certificate_management_service_.get());
     builder.RegisterService(diag_service_.get());
     builder.RegisterService(file_service_.get());
     external_server_ = builder.BuildAndStart();
     if (external_server_ == nullptr) {
+      StopCompletionQueues();
       return MAKE_ERROR(ERR_INTERNAL)
              << "Failed to start Stratum external facing services. This is an "
              << "internal error.";
     }
+    for (const auto& cq : completion_queues_) {
+      config_monitoring_async_service_->Start(
+          cq.get(), FLAGS_grpc_async_server_max_queued_writes);
+      p4_async_service_->Start(cq.get(),
+                               FLAGS_grpc_async_server_max_queued_writes);
+      completion_queue_threads_.emplace_back(PollCompletionQueue, cq.get());
+    }
+    if (!completion_queues_.empty()) {
+      LOG(INFO) << "Serving P4Runtime and gNMI streams asynchronously on "
+                << completion_queues_.size() << " completion queues.";
+    }
     LOG(ERROR) << "Stratum external facing services are listening to "
                << absl::StrJoin(external_stratum_urls, ", ") << ", "
                << FLAGS_local_stratum_url << "...";
@@ -224,9 +263,19 @@ Hal::~Hal() {
 
   external_server_->Wait();  // blocking until external_server_->Shutdown()
                              // is called. We dont wait on internal_service.
+  StopCompletionQueues();
   return Teardown();
 }
 
+void Hal::StopCompletionQueues() {
+  for (const auto& cq : completion_queues_) cq->Shutdown();
+  for (auto& thread : completion_queue_threads_) thread.join();
+  // Drain the queues which have never been polled.
+  for (const auto& cq : completion_queues_) PollCompletionQueue(cq.get());
+  completion_queue_threads_.clear();
+  completion_queues_.clear();
+}
+
 void Hal::HandleSignal(int value) {
   LOG(INFO) << "Received signal: " << strsignal(value);
   // Calling Shutdown() so the blocking call to Wait() returns.
@@ -280,6 +329,8 @@ Hal* Hal::GetSingleton() {
   CHECK_IS_NULL(certificate_management_service_);
   CHECK_IS_NULL(diag_service_);
   CHECK_IS_NULL(file_service_);
+  CHECK_IS_NULL(config_monitoring_async_service_);
+  CHECK_IS_NULL(p4_async_service_);
   CHECK_IS_NULL(external_server_);
   // FIXME(boc) google only
   // CHECK_IS_NULL(internal_server_);
@@ -302,6 +353,10 @@ Hal* Hal::GetSingleton() {
       mode_, switch_interface_, auth_policy_checker_, error_buffer_.get());
   file_service_ = absl::make_unique<FileService>(
       mode_, switch_interface_, auth_policy_checker_, error_buffer_.get());
+  config_monitoring_async_service_ =
+      absl::make_unique<ConfigMonitoringAsyncService>(
+          config_monitoring_service_.get());
+  p4_async_service_ = absl::make_unique<P4AsyncService>(p4_service_.get());
 
   return ::util::OkStatus();
 }
@@ -12,6 +12,7 @@
 
 #include <memory>
 #include <string>
+#include <thread>  // NOLINT
 #include <vector>
 
 #include "absl/base/thread_annotations.h"
@@ -115,6 +116,11 @@ class Hal final {
   // HAL shutdown.
   static void* SignalWaiterThreadFunc(void*);
 
+  // Shuts down the completion queues of the asynchronous server mode, waits
+  // for their polling threads and drains them. To be called after the server
+  // has been shut down.
+  void StopCompletionQueues();
+
   // Determines the mode of operation:
   // - OPERATION_MODE_STANDALONE: when Stratum stack runs independently and
   // therefore needs to do all the SDK initialization itself.
@@ -147,6 +153,19 @@ class Hal final {
   std::unique_ptr<DiagService> diag_service_;
   std::unique_ptr<FileService> file_service_;
 
+  // Services registered instead of ConfigMonitoringService and P4Service in the
+  // asynchronous server mode. They forward the calls to the services above.
+  // Owned by the class.
+  std::unique_ptr<ConfigMonitoringAsyncService>
+      config_monitoring_async_service_;
+  std::unique_ptr<P4AsyncService> p4_async_service_;
+
+  // The completion queues of the asynchronous server mode and the threads
+  // polling them, one per queue.
+  std::vector<std::unique_ptr<::grpc::ServerCompletionQueue>>
+      completion_queues_;
+  std::vector<std::thread> completion_queue_threads_;
+
   // Unique pointer to the gRPC server serving the external RPC connections
   // serviced by ConfigMonitoringService and P4Service. Owned by the class.
   std::unique_ptr<::grpc::Server> external_server_;
@@ -0,0 +1,292 @@
+// Copyright 2018-present Open Networking Foundation
+// SPDX-License-Identifier: Apache-2.0
+
+#include "stratum/hal/lib/common/p4_request_logger.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <utility>
+
+#include "absl/memory/memory.h"
+#include "absl/strings/str_cat.h"
+#include "google/protobuf/io/coded_stream.h"
+#include "google/protobuf/io/zero_copy_stream_impl_lite.h"
+#include "stratum/glue/logging.h"
+#include "stratum/lib/macros.h"
+#include "stratum/public/lib/error.h"
+
+namespace stratum {
+namespace hal {
+
+namespace {
+
+// Appends a text line in the format stratum_replay expects.
+void AppendTextEntry(const std::string& timestamp, uint64 node_id,
+                     const ::google::protobuf::Message& entry,
+                     const std::string& error, std::string* buffer) {
+  absl::StrAppend(buffer, timestamp, ";", node_id, ";",
+                  entry.ShortDebugString(), ";", error, "\n");
+}
+
+// Appends a length-prefixed binary record.
+void AppendBinaryEntry(int64 timestamp_us, uint64 node_id,
+                       const ::google::protobuf::Message& entry,
+                       const std::string& error, std::string* buffer) {
+  std::string record;
+  {
+    ::google::protobuf::io::StringOutputStream stream(&record);
+    ::google::protobuf::io::CodedOutputStream out(&stream);
+    out.WriteLittleEndian64(static_cast<uint64>(timestamp_us));
+    out.WriteVarint64(node_id);
+    out.WriteVarint32(entry.ByteSizeLong());
+    entry.SerializeWithCachedSizes(&out);
+    out.WriteVarint32(error.size());
+    out.WriteString(error);
+  }
+  ::google::protobuf::io::StringOutputStream stream(buffer);
+  ::google::protobuf::io::CodedOutputStream out(&stream);
+  out.WriteVarint32(record.size());
+  out.WriteString(record);
+}
+
+std::vector<std::string> ErrorMessages(
+    const std::vector<::util::Status>& results) {
+  std::vector<std::string> errors;
+  errors.reserve(results.size());
+  for (const auto& status : results) errors.push_back(status.error_message());
+  return errors;
+}
+
+}  // namespace
+
+P4RequestLogger::P4RequestLogger(const std::string& path,
+                                 const P4RequestLoggerOptions& options)
+    : path_(path),
+      options_(options),
+      num_requests_(0),
+      queue_(),
+      num_queued_(0),
+      num_written_(0),
+      num_dropped_(0),
+      shutdown_(false),
+      fd_(-1),
+      file_size_(0) {}
+
+P4RequestLogger::~P4RequestLogger() {
+  {
+    absl::MutexLock l(&lock_);
+    shutdown_ = true;
+    queued_cond_.Signal();
+  }
+  if (writer_thread_.joinable()) writer_thread_.join();
+  if (fd_ >= 0) close(fd_);
+}
+
+std::unique_ptr<P4RequestLogger> P4RequestLogger::CreateInstance(
+    const std::string& path, const P4RequestLoggerOptions& options) {
+  auto logger = absl::WrapUnique(new P4RequestLogger(path, options));
+  logger->writer_thread_ = std::thread(&P4RequestLogger::Run, logger.get());
+  return logger;
+}
+
+void P4RequestLogger::LogWriteRequest(
+    uint64 node_id, const ::p4::v1::WriteRequest& req,
+    const std::vector<::util::Status>& results, absl::Time timestamp) {
+  if (results.empty()) {
+    // Nothing to log as the switch interface did not fill in any error details.
+    // TODO(max): Consider logging the requests with the overall status in this
+    //            case. But keep in mind that LogWriteRequest will not be called
+    //            for auth errors or invalid device IDs.
+    return;
+  }
+  if (results.size() != req.updates_size()) {
+    LOG(ERROR) << "Size mismatch: " << results.size()
+               << " != " << req.updates_size() << ". Did not log anything!";
+    return;
+  }
+  if (!Sample()) return;
+  Record record;
+  record.timestamp = timestamp;
+  record.node_id = node_id;
+  record.is_write = true;
+  record.write_req = req;
+  record.errors = ErrorMessages(results);
+  Enqueue(std::move(record));
+}
+
+void P4RequestLogger::LogReadRequest(uint64 node_id,
+                                     const ::p4::v1::ReadRequest& req,
+                                     const std::vector<::util::Status>& results,
+                                     absl::Time timestamp) {
+  if (results.empty()) {
+    // Nothing to log as the switch interface did not fill in any error details.
+    // TODO(max): Consider logging the requests with the overall status in this
+    //            case. But keep in mind that LogReadRequest will not be called
+    //            for auth errors or invalid device IDs.
+    return;
+  }
+  if (results.size() != req.entities_size()) {
+    LOG(ERROR) << "Size mismatch: " << results.size()
+               << " != " << req.entities_size() << ". Did not log anything!";
+    return;
+  }
+  if (!Sample()) return;
+  Record record;
+  record.timestamp = timestamp;
+  record.node_id = node_id;
+  record.is_write = false;
+  record.read_req = req;
+  record.errors = ErrorMessages(results);
+  Enqueue(std::move(record));
+}
+
+void P4RequestLogger::Flush() {
+  absl::MutexLock l(&lock_);
+  const uint64 target = num_queued_;
+  while (num_written_ < target) written_cond_.Wait(&lock_);
+}
+
+uint64 P4RequestLogger::GetDroppedRequests() const {
+  absl::MutexLock l(&lock_);
+  return num_dropped_;
+}
+
+bool P4RequestLogger::Sample() {
+  if (options_.sample_rate <= 1) return true;
+  return num_requests_.fetch_add(1, std::memory_order_relaxed) %
+             options_.sample_rate ==
+         0;
+}
+
+void P4RequestLogger::Enqueue(Record record) {
+  absl::MutexLock l(&lock_);
+  if (queue_.size() >= options_.max_queued_requests) {
+    ++num_dropped_;
+    LOG_EVERY_N(WARNING, 100)
+        << "Request log queue for " << path_ << " is full. Dropped "
+        << num_dropped_ << " requests so far.";
+    return;
+  }
+  queue_.push_back(std::move(record));
+  ++num_queued_;
+  queued_cond_.Signal();
+}
+
+void P4RequestLogger::Run() {
+  std::vector<Record> batch;
+  std::string buffer;
+  while (true) {
+    {
+      absl::MutexLock l(&lock_);
+      while (queue_.empty() && !shutdown_) queued_cond_.Wait(&lock_);
+      if (queue_.empty()) break;  // Shut down and drained.
+      batch.swap(queue_);
+    }
+    buffer.clear();
+    for (const auto& record : batch) FormatRecord(record, &buffer);
+    ::util::Status status = WriteToFile(buffer);
+    LOG_IF_EVERY_N(ERROR, !status.ok(), 50)
+        << "Failed to log the requests to " << path_ << ": "
+        << status.error_message();
+    {
+      absl::MutexLock l(&lock_);
+      num_written_ += batch.size();
+      written_cond_.SignalAll();
+    }
+    batch.clear();
+  }
+}
+
+void P4RequestLogger::FormatRecord(const Record& record,
+                                   std::string* buffer) const {
+  const int num_entries = record.is_write ? record.write_req.updates_size()
+                                          : record.read_req.entities_size();
+  if (options_.format == P4RequestLogFormat::kBinary) {
+    const int64 timestamp_us = absl::ToUnixMicros(record.timestamp);
+    for (int i = 0; i < num_entries; ++i) {
+      if (record.is_write) {
+        AppendBinaryEntry(timestamp_us, record.node_id,
+                          record.write_req.updates(i), record.errors[i],
+                          buffer);
+      } else {
+        AppendBinaryEntry(timestamp_us, record.node_id,
+                          record.read_req.entities(i), record.errors[i],
+                          buffer);
+      }
+    }
+    return;
+  }
+  const std::string timestamp = absl::FormatTime(
+      "%Y-%m-%d %H:%M:%E6S", record.timestamp, absl::LocalTimeZone());
+  for (int i = 0; i < num_entries; ++i) {
+    if (record.is_write) {
+      AppendTextEntry(timestamp, record.node_id, record.write_req.updates(i),
+                      record.errors[i], buffer);
+    } else {
+      AppendTextEntry(timestamp, record.node_id, record.read_req.entities(i),
+                      record.errors[i], buffer);
+    }
+  }
+}
+
+::util::Status P4RequestLogger::WriteToFile(const std::string& buffer) {
+  if (fd_ < 0) RETURN_IF_ERROR(OpenFile());
+  if (options_.max_file_size_bytes > 0 && file_size_ > 0 &&
+      file_size_ + buffer.size() > options_.max_file_size_bytes) {
+    RETURN_IF_ERROR(RotateFile());
+  }
+  size_t offset = 0;
+  while (offset < buffer.size()) {
+    ssize_t n = write(fd_, buffer.data() + offset, buffer.size() - offset);
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      return MAKE_ERROR(ERR_INTERNAL)
+             << "Failed to write to " << path_ << ": " << strerror(errno);
+    }
+    offset += n;
+  }
+  file_size_ += buffer.size();
+
+  return ::util::OkStatus();
+}
+
+::util::Status P4RequestLogger::OpenFile() {
+  fd_ = open(path_.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+  if (fd_ < 0) {
+    return MAKE_ERROR(ERR_INTERNAL)
+           << "Failed to open " << path_ << ": " << strerror(errno);
+  }
+  struct stat st;
+  file_size_ = fstat(fd_, &st) == 0 ? st.st_size : 0;
+
+  return ::util::OkStatus();
+}
+
+::util::Status P4RequestLogger::RotateFile() {
+  close(fd_);
+  fd_ = -1;
+  if (options_.max_rotated_files > 0) {
+    for (int i = options_.max_rotated_files - 1; i > 0; --i) {
+      // Older files may not exist yet, so errors are ignored.
+      rename(absl::StrCat(path_, ".", i).c_str(),
+             absl::StrCat(path_, ".", i + 1).c_str());
+    }
+    if (rename(path_.c_str(), absl::StrCat(path_, ".1").c_str()) != 0) {
+      return MAKE_ERROR(ERR_INTERNAL)
+             << "Failed to rotate " << path_ << ": " << strerror(errno);
+    }
+  } else if (unlink(path_.c_str()) != 0) {
+    return MAKE_ERROR(ERR_INTERNAL)
+           << "Failed to remove " << path_ << ": " << strerror(errno);
+  }
+
+  return OpenFile();
+}
+
+}  // namespace hal
+}  // namespace stratum
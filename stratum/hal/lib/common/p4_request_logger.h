@@ -0,0 +1,140 @@
+// Copyright 2018-present Open Networking Foundation
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef STRATUM_HAL_LIB_COMMON_P4_REQUEST_LOGGER_H_
+#define STRATUM_HAL_LIB_COMMON_P4_REQUEST_LOGGER_H_
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "p4/v1/p4runtime.pb.h"
+#include "stratum/glue/integral_types.h"
+#include "stratum/glue/status/status.h"
+
+namespace stratum {
+namespace hal {
+
+// Format of the records of a request log file.
+enum class P4RequestLogFormat {
+  // One line per update or entity, as consumed by stratum_replay:
+  // <timestamp>;<node_id>;<update or entity proto>;<status>
+  kText,
+  // One length-prefixed record per update or entity. The record starts with
+  // its length as varint32, followed by the timestamp in microseconds since
+  // the epoch as fixed64, the node ID as varint64, the serialized update or
+  // entity and the status message, each prefixed with its length as varint32.
+  kBinary,
+};
+
+struct P4RequestLoggerOptions {
+  P4RequestLogFormat format = P4RequestLogFormat::kText;
+  // The file is rotated once it would grow beyond this size. 0 disables the
+  // rotation.
+  uint64 max_file_size_bytes = 0;
+  // Number of rotated files kept, named <path>.1 (newest) to <path>.N.
+  int max_rotated_files = 3;
+  // Only one out of every 'sample_rate' requests is logged.
+  int sample_rate = 1;
+  // Requests logged while this many are waiting to be written are dropped.
+  size_t max_queued_requests = 4096;
+};
+
+// P4RequestLogger logs P4Runtime Write and Read requests, together with the
+// status of every update or entity, to a file. Callers only copy the request
+// into a queue. Formatting and writing is done in batches by a background
+// thread, which keeps the file open across requests.
+class P4RequestLogger {
+ public:
+  ~P4RequestLogger();
+
+  // Queues a Write request. 'results' has to hold a status per update,
+  // otherwise nothing is logged.
+  void LogWriteRequest(uint64 node_id, const ::p4::v1::WriteRequest& req,
+                       const std::vector<::util::Status>& results,
+                       absl::Time timestamp) LOCKS_EXCLUDED(lock_);
+
+  // Queues a Read request. 'results' has to hold a status per entity,
+  // otherwise nothing is logged.
+  void LogReadRequest(uint64 node_id, const ::p4::v1::ReadRequest& req,
+                      const std::vector<::util::Status>& results,
+                      absl::Time timestamp) LOCKS_EXCLUDED(lock_);
+
+  // Blocks until all the requests queued so far have been written.
+  void Flush() LOCKS_EXCLUDED(lock_);
+
+  // Returns the number of requests dropped because the queue was full.
+  uint64 GetDroppedRequests() const LOCKS_EXCLUDED(lock_);
+
+  // Creates a logger writing to 'path' and starts its background thread.
+  static std::unique_ptr<P4RequestLogger> CreateInstance(
+      const std::string& path, const P4RequestLoggerOptions& options);
+
+  // P4RequestLogger is neither copyable nor movable.
+  P4RequestLogger(const P4RequestLogger&) = delete;
+  P4RequestLogger& operator=(const P4RequestLogger&) = delete;
+
+ private:
+  // A queued request with the error message of each of its updates/entities.
+  struct Record {
+    absl::Time timestamp;
+    uint64 node_id;
+    bool is_write;
+    ::p4::v1::WriteRequest write_req;
+    ::p4::v1::ReadRequest read_req;
+    std::vector<std::string> errors;
+  };
+
+  P4RequestLogger(const std::string& path,
+                  const P4RequestLoggerOptions& options);
+
+  // Returns true if the next request should be logged.
+  bool Sample();
+
+  // Queues a record, unless the queue is full.
+  void Enqueue(Record record) LOCKS_EXCLUDED(lock_);
+
+  // Thread function writing the queued records.
+  void Run() LOCKS_EXCLUDED(lock_);
+
+  // Appends the formatted record to 'buffer'.
+  void FormatRecord(const Record& record, std::string* buffer) const;
+
+  // Writes 'buffer' to the file, rotating the file first if needed.
+  ::util::Status WriteToFile(const std::string& buffer);
+  ::util::Status OpenFile();
+  ::util::Status RotateFile();
+
+  const std::string path_;
+  const P4RequestLoggerOptions options_;
+
+  // Counter used for sampling the requests.
+  std::atomic<uint64> num_requests_;
+
+  mutable absl::Mutex lock_;
+  // Signaled when records are queued or the logger shuts down.
+  absl::CondVar queued_cond_;
+  // Signaled when a batch of records has been written.
+  absl::CondVar written_cond_;
+  std::vector<Record> queue_ GUARDED_BY(lock_);
+  uint64 num_queued_ GUARDED_BY(lock_);
+  uint64 num_written_ GUARDED_BY(lock_);
+  uint64 num_dropped_ GUARDED_BY(lock_);
+  bool shutdown_ GUARDED_BY(lock_);
+
+  // The log file, only accessed by the background thread.
+  int fd_;
+  uint64 file_size_;
+
+  std::thread writer_thread_;
+};
+
+}  // namespace hal
+}  // namespace stratum
+
+#endif  // STRATUM_HAL_LIB_COMMON_P4_REQUEST_LOGGER_H_
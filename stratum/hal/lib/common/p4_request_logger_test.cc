@@ -0,0 +1,171 @@
+// Copyright 2018-present Open Networking Foundation
+// SPDX-License-Identifier: Apache-2.0
+
+#include "stratum/hal/lib/common/p4_request_logger.h"
+
+#include <string>
+#include <vector>
+
+#include "absl/strings/str_split.h"
+#include "gflags/gflags.h"
+#include "gmock/gmock.h"
+#include "google/protobuf/io/coded_stream.h"
+#include "gtest/gtest.h"
+#include "stratum/glue/status/status_test_util.h"
+#include "stratum/lib/utils.h"
+#include "stratum/public/lib/error.h"
+
+DECLARE_string(test_tmpdir);
+
+namespace stratum {
+namespace hal {
+
+using ::testing::HasSubstr;
+
+class P4RequestLoggerTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    path_ = FLAGS_test_tmpdir + "/p4_request_log.txt";
+    for (const auto& path :
+         {path_, path_ + ".1", path_ + ".2", path_ + ".3"}) {
+      if (PathExists(path)) ASSERT_OK(RemoveFile(path));
+    }
+  }
+
+  // Returns a WriteRequest with the given number of table entry inserts.
+  static ::p4::v1::WriteRequest MakeWriteRequest(int num_updates) {
+    ::p4::v1::WriteRequest req;
+    req.set_device_id(kNodeId);
+    for (int i = 0; i < num_updates; ++i) {
+      auto* update = req.add_updates();
+      update->set_type(::p4::v1::Update::INSERT);
+      update->mutable_entity()->mutable_table_entry()->set_table_id(i + 1);
+    }
+    return req;
+  }
+
+  std::string ReadLog(const std::string& path) {
+    std::string s;
+    EXPECT_OK(ReadFileToString(path, &s));
+    return s;
+  }
+
+  static constexpr uint64 kNodeId = 123;
+  std::string path_;
+};
+
+constexpr uint64 P4RequestLoggerTest::kNodeId;
+
+TEST_F(P4RequestLoggerTest, LogWriteRequestInTextFormat) {
+  auto logger = P4RequestLogger::CreateInstance(path_, {});
+  auto req = MakeWriteRequest(2);
+  logger->LogWriteRequest(
+      kNodeId, req,
+      {::util::OkStatus(),
+       ::util::Status(StratumErrorSpace(), ERR_INVALID_PARAM, "some error")},
+      absl::Now());
+  logger->Flush();
+
+  std::vector<std::string> lines =
+      absl::StrSplit(ReadLog(path_), '\n', absl::SkipEmpty());
+  ASSERT_EQ(2U, lines.size());
+  EXPECT_THAT(lines[0], HasSubstr(";123;" + req.updates(0).ShortDebugString() +
+                                  ";"));
+  EXPECT_THAT(lines[1], HasSubstr(";123;" + req.updates(1).ShortDebugString() +
+                                  ";some error"));
+}
+
+TEST_F(P4RequestLoggerTest, LogReadRequestInTextFormat) {
+  auto logger = P4RequestLogger::CreateInstance(path_, {});
+  ::p4::v1::ReadRequest req;
+  req.set_device_id(kNodeId);
+  req.add_entities()->mutable_table_entry()->set_table_id(1);
+  logger->LogReadRequest(kNodeId, req, {::util::OkStatus()}, absl::Now());
+  logger->Flush();
+
+  EXPECT_THAT(ReadLog(path_),
+              HasSubstr(";123;" + req.entities(0).ShortDebugString() + ";\n"));
+}
+
+TEST_F(P4RequestLoggerTest, RequestsWithoutResultsAreNotLogged) {
+  auto logger = P4RequestLogger::CreateInstance(path_, {});
+  logger->LogWriteRequest(kNodeId, MakeWriteRequest(2), {}, absl::Now());
+  logger->LogWriteRequest(kNodeId, MakeWriteRequest(2), {::util::OkStatus()},
+                          absl::Now());
+  logger->Flush();
+
+  EXPECT_FALSE(PathExists(path_));
+}
+
+TEST_F(P4RequestLoggerTest, LogWriteRequestInBinaryFormat) {
+  P4RequestLoggerOptions options;
+  options.format = P4RequestLogFormat::kBinary;
+  auto logger = P4RequestLogger::CreateInstance(path_, options);
+  auto req = MakeWriteRequest(1);
+  absl::Time timestamp = absl::FromUnixMicros(1234567);
+  logger->LogWriteRequest(kNodeId, req, {::util::OkStatus()}, timestamp);
+  logger->Flush();
+
+  std::string s = ReadLog(path_);
+  ::google::protobuf::io::CodedInputStream in(
+      reinterpret_cast<const uint8*>(s.data()), s.size());
+  uint32 record_size, entry_size, error_size;
+  uint64 timestamp_us, node_id;
+  std::string entry, error;
+  ASSERT_TRUE(in.ReadVarint32(&record_size));
+  ASSERT_TRUE(in.ReadLittleEndian64(&timestamp_us));
+  ASSERT_TRUE(in.ReadVarint64(&node_id));
+  ASSERT_TRUE(in.ReadVarint32(&entry_size));
+  ASSERT_TRUE(in.ReadString(&entry, entry_size));
+  ASSERT_TRUE(in.ReadVarint32(&error_size));
+  ASSERT_TRUE(in.ReadString(&error, error_size));
+  EXPECT_EQ(s.size(), in.CurrentPosition());
+  EXPECT_EQ(1234567U, timestamp_us);
+  EXPECT_EQ(kNodeId, node_id);
+  ::p4::v1::Update update;
+  ASSERT_TRUE(update.ParseFromString(entry));
+  EXPECT_EQ(req.updates(0).SerializeAsString(), update.SerializeAsString());
+  EXPECT_TRUE(error.empty());
+}
+
+TEST_F(P4RequestLoggerTest, FileIsRotatedWhenFull) {
+  P4RequestLoggerOptions options;
+  options.max_file_size_bytes = 1;
+  options.max_rotated_files = 2;
+  auto logger = P4RequestLogger::CreateInstance(path_, options);
+  for (int i = 1; i <= 4; ++i) {
+    logger->LogWriteRequest(kNodeId, MakeWriteRequest(i),
+                            std::vector<::util::Status>(i), absl::Now());
+    logger->Flush();
+  }
+
+  // Every request ends up in its own file, of which the last three are kept.
+  auto count_lines = [this](const std::string& path) {
+    std::vector<std::string> lines =
+        absl::StrSplit(ReadLog(path), '\n', absl::SkipEmpty());
+    return lines.size();
+  };
+  EXPECT_EQ(4U, count_lines(path_));
+  EXPECT_EQ(3U, count_lines(path_ + ".1"));
+  EXPECT_EQ(2U, count_lines(path_ + ".2"));
+  EXPECT_FALSE(PathExists(path_ + ".3"));
+}
+
+TEST_F(P4RequestLoggerTest, RequestsAreSampled) {
+  P4RequestLoggerOptions options;
+  options.sample_rate = 3;
+  auto logger = P4RequestLogger::CreateInstance(path_, options);
+  for (int i = 0; i < 7; ++i) {
+    logger->LogWriteRequest(kNodeId, MakeWriteRequest(1), {::util::OkStatus()},
+                            absl::Now());
+  }
+  logger->Flush();
+
+  // Requests 0, 3 and 6 are logged.
+  std::vector<std::string> lines =
+      absl::StrSplit(ReadLog(path_), '\n', absl::SkipEmpty());
+  EXPECT_EQ(3U, lines.size());
+}
+
+}  // namespace hal
+}  // namespace stratum
@@ -4,10 +4,13 @@
 
 #include "stratum/hal/lib/common/p4_service.h"
 
+#include <atomic>
 #include <functional>
+#include <memory>
 #include <sstream>  // IWYU pragma: keep
 #include <utility>
 
+#include "absl/base/call_once.h"
 #include "absl/cleanup/cleanup.h"
 #include "absl/memory/memory.h"
 #include "absl/numeric/int128.h"
@@ -16,6 +19,7 @@
 #include "absl/time/time.h"
 #include "gflags/gflags.h"
 #include "google/protobuf/any.pb.h"
+#include "google/protobuf/arena.h"
 #include "google/rpc/code.pb.h"
 #include "google/rpc/status.pb.h"
 #include "stratum/glue/gtl/map_util.h"
@@ -41,11 +45,36 @@ DEFINE_string(read_req_log_file, "/var/log/stratum/p4_reads.pb.txt",
               "The log file for all the individual read request and "
               "the corresponding result. The format for each line is: "
               "<timestamp>;<node_id>;<request proto>;<status>.");
+DEFINE_bool(req_log_binary_format, false,
+            "If true, the write and read request logs are written as "
+            "length-prefixed binary records instead of the text format "
+            "consumed by stratum_replay.");
+DEFINE_uint64(req_log_max_file_size, 0,
+              "Size in bytes beyond which the write and read request log files "
+              "are rotated. 0 disables the rotation.");
+DEFINE_int32(req_log_max_rotated_files, 3,
+             "Number of rotated write and read request log files kept.");
+DEFINE_int32(req_log_sample_rate, 1,
+             "Only one out of every N write and read requests is logged.");
+DEFINE_int32(req_log_max_queued_requests, 4096,
+             "Max number of requests waiting to be written to a request log "
+             "file. Requests logged while the queue is full are dropped.");
 DEFINE_int32(max_num_controllers_per_node, 5,
              "Max number of controllers that can manage a node.");
 DEFINE_int32(max_num_controller_connections, 20,
              "Max number of active/inactive streaming connections from outside "
              "controllers (for all of the nodes combined).");
+DEFINE_int32(stream_message_send_queue_depth, 1024,
+             "Max number of stream messages, e.g. PacketIns, queued for a "
+             "controller connection. Arbitration updates are always queued.");
+DEFINE_bool(stream_message_send_queue_drop_oldest, true,
+            "If true, the oldest queued stream message is dropped when the "
+            "send queue of a controller connection is full, otherwise the "
+            "message being sent is dropped.");
+DEFINE_int32(stream_message_send_queue_drain_timeout_ms, 1000,
+             "Time in milliseconds given to a closing controller connection "
+             "to send its queued stream messages before the stream is "
+             "cancelled.");
 
 namespace stratum {
 namespace hal {
@@ -57,6 +86,7 @@ P4Service::P4Service(OperationMode mode, SwitchInterface* switch_interface,
                      AuthPolicyChecker* auth_policy_checker,
                      ErrorBuffer* error_buffer)
     : node_id_to_controller_manager_(),
+      arbitration_snapshot_(std::make_shared<const ArbitrationSnapshot>()),
       num_controller_connections_(),
       forwarding_pipeline_configs_(nullptr),
       mode_(mode),
@@ -84,6 +114,7 @@ P4Service::~P4Service() {}
   {
     absl::WriterMutexLock l(&controller_lock_);
     node_id_to_controller_manager_.clear();
+    UpdateArbitrationSnapshot();
     num_controller_connections_ = 0;
   }
   {
@@ -190,102 +221,83 @@ namespace {
     }                                                                        \
   } while (0)
 
+// Returns true if the client asked for the compact encoding of the error
+// details of a failed Write or Read.
+bool WantsCompactErrorDetails(const ::grpc::ServerContext* context) {
+  const auto& metadata = context->client_metadata();
+  auto it = metadata.find(kErrorDetailsMetadataKey);
+  return it != metadata.end() &&
+         it->second == ::grpc::string_ref(kCompactErrorDetails);
+}
+
 // TODO(unknown): This needs to be changed later per p4 runtime error
 // reporting scheme.
 ::grpc::Status ToGrpcStatus(const ::util::Status& status,
-                            const std::vector<::util::Status>& details) {
+                            const std::vector<::util::Status>& details,
+                            bool compact_details) {
+  if (status.ok()) return ::grpc::Status::OK;
+
   // We need to create a ::google::rpc::Status and populate it with all the
-  // details, then convert it to ::grpc::Status.
-  ::google::rpc::Status from;
-  if (!status.ok()) {
-    from.set_code(ToGoogleRpcCode(status.CanonicalCode()));
-    from.set_message(status.error_message());
-    // Add individual errors only when the top level error code is not OK.
-    for (const auto& detail : details) {
-      // Each individual detail is converted to another ::google::rpc::Status,
-      // which is then serialized as one proto any in 'from' message above.
-      ::p4::v1::Error error;
-      if (!detail.ok()) {
-        error.set_canonical_code(ToGoogleRpcCode(detail.CanonicalCode()));
-        error.set_code(detail.error_code());
-        error.set_message(detail.error_message());
-      } else {
-        error.set_code(::google::rpc::OK);
-      }
-      from.add_details()->PackFrom(error);
+  // details, then convert it to ::grpc::Status. A failed batch can carry one
+  // detail per update, so all the messages are allocated on an arena and
+  // freed at once.
+  ::google::protobuf::Arena arena;
+  auto* from =
+      ::google::protobuf::Arena::CreateMessage<::google::rpc::Status>(&arena);
+  auto* error =
+      ::google::protobuf::Arena::CreateMessage<::p4::v1::Error>(&arena);
+  from->set_code(ToGoogleRpcCode(status.CanonicalCode()));
+  from->set_message(status.error_message());
+  if (!compact_details) from->mutable_details()->Reserve(details.size());
+  // All the OK details are the same, so the first one is packed and the
+  // following ones are copied from it.
+  const ::google::protobuf::Any* ok_detail = nullptr;
+  for (size_t i = 0; i < details.size();) {
+    // Each individual detail is converted to a ::p4::v1::Error, which is then
+    // serialized as one proto any in 'from' message above.
+    if (!details[i].ok()) {
+      error->Clear();
+      error->set_canonical_code(ToGoogleRpcCode(details[i].CanonicalCode()));
+      error->set_code(details[i].error_code());
+      error->set_message(details[i].error_message());
+      from->add_details()->PackFrom(*error);
+      ++i;
+    } else if (compact_details) {
+      size_t j = i + 1;
+      while (j < details.size() && details[j].ok()) ++j;
+      error->Clear();
+      error->set_space(kOkRunErrorSpace);
+      error->set_code(static_cast<int32>(j - i));
+      from->add_details()->PackFrom(*error);
+      i = j;
+    } else if (ok_detail == nullptr) {
+      error->Clear();
+      error->set_code(::google::rpc::OK);
+      auto* detail = from->add_details();
+      detail->PackFrom(*error);
+      ok_detail = detail;
+      ++i;
+    } else {
+      *from->add_details() = *ok_detail;
+      ++i;
     }
-  } else {
-    from.set_code(::google::rpc::OK);
   }
 
-  return ::grpc::Status(ToGrpcCode(from.code()), from.message(),
-                        from.SerializeAsString());
+  std::string serialized;
+  from->SerializeToString(&serialized);
+  return ::grpc::Status(ToGrpcCode(from->code()), from->message(), serialized);
 }
 
-// Helper to facilitate logging the write requests to the desired log file.
-void LogWriteRequest(uint64 node_id, const ::p4::v1::WriteRequest& req,
-                     const std::vector<::util::Status>& results,
-                     const absl::Time timestamp) {
-  if (FLAGS_write_req_log_file.empty()) {
-    return;
-  }
-  if (results.empty()) {
-    // Nothing to log as the switch interface did not fill in any error details.
-    // TODO(max): Consider logging the requests with the overall status in this
-    //            case. But keep in mind that LogWriteRequest will not be called
-    //            for auth errors or invalid device IDs.
-    return;
-  }
-  if (results.size() != req.updates_size()) {
-    LOG(ERROR) << "Size mismatch: " << results.size()
-               << " != " << req.updates_size() << ". Did not log anything!";
-    return;
-  }
-  std::string msg = "";
-  std::string ts =
-      absl::FormatTime("%Y-%m-%d %H:%M:%E6S", timestamp, absl::LocalTimeZone());
-  for (size_t i = 0; i < results.size(); ++i) {
-    absl::StrAppend(&msg, ts, ";", node_id, ";",
-                    req.updates(i).ShortDebugString(), ";",
-                    results[i].error_message(), "\n");
-  }
-  ::util::Status status =
-      WriteStringToFile(msg, FLAGS_write_req_log_file, /*append=*/true);
-  LOG_IF_EVERY_N(ERROR, !status.ok(), 50)
-      << "Failed to log the write request: " << status.error_message();
-}
-
-// Helper to facilitate logging the read requests to the desired log file.
-void LogReadRequest(uint64 node_id, const ::p4::v1::ReadRequest& req,
-                    const std::vector<::util::Status>& results,
-                    const absl::Time timestamp) {
-  if (FLAGS_read_req_log_file.empty()) {
-    return;
-  }
-  if (results.empty()) {
-    // Nothing to log as the switch interface did not fill in any error details.
-    // TODO(max): Consider logging the requests with the overall status in this
-    //            case. But keep in mind that LogReadRequest will not be called
-    //            for auth errors or invalid device IDs.
-    return;
-  }
-  if (results.size() != req.entities_size()) {
-    LOG(ERROR) << "Size mismatch: " << results.size()
-               << " != " << req.entities_size() << ". Did not log anything!";
-    return;
-  }
-  std::string msg = "";
-  std::string ts =
-      absl::FormatTime("%Y-%m-%d %H:%M:%E6S", timestamp, absl::LocalTimeZone());
-  for (size_t i = 0; i < results.size(); ++i) {
-    absl::StrAppend(&msg, ts, ";", node_id, ";",
-                    req.entities(i).ShortDebugString(), ";",
-                    results[i].error_message(), "\n");
-  }
-  ::util::Status status =
-      WriteStringToFile(msg, FLAGS_read_req_log_file, /*append=*/true);
-  LOG_IF_EVERY_N(ERROR, !status.ok(), 50)
-      << "Failed to log the read request: " << status.error_message();
+// Returns the options of the write and read request loggers, from the flags.
+P4RequestLoggerOptions GetRequestLoggerOptions() {
+  P4RequestLoggerOptions options;
+  options.format = FLAGS_req_log_binary_format ? P4RequestLogFormat::kBinary
+                                               : P4RequestLogFormat::kText;
+  options.max_file_size_bytes = FLAGS_req_log_max_file_size;
+  options.max_rotated_files = FLAGS_req_log_max_rotated_files;
+  options.sample_rate = FLAGS_req_log_sample_rate;
+  options.max_queued_requests = FLAGS_req_log_max_queued_requests;
+  return options;
 }
 
 // Helper function to generate a StreamMessageResponse from a failed Status.
@@ -345,9 +357,15 @@ void LogReadRequest(uint64 node_id, const ::p4::v1::ReadRequest& req,
   }
 
   // Log debug info for future debugging.
-  LogWriteRequest(node_id, *req, results, timestamp);
+  if (!FLAGS_write_req_log_file.empty()) {
+    absl::call_once(write_req_logger_once_, [this]() {
+      write_req_logger_ = P4RequestLogger::CreateInstance(
+          FLAGS_write_req_log_file, GetRequestLoggerOptions());
+    });
+    write_req_logger_->LogWriteRequest(node_id, *req, results, timestamp);
+  }
 
-  return ToGrpcStatus(status, results);
+  return ToGrpcStatus(status, results, WantsCompactErrorDetails(context));
 }
 
 ::grpc::Status P4Service::Read(
@@ -398,9 +416,16 @@ void LogReadRequest(uint64 node_id, const ::p4::v1::ReadRequest& req,
   }
 
   // Log debug info for future debugging.
-  LogReadRequest(node_id, *original_req, details, timestamp);
+  if (!FLAGS_read_req_log_file.empty()) {
+    absl::call_once(read_req_logger_once_, [this]() {
+      read_req_logger_ = P4RequestLogger::CreateInstance(
+          FLAGS_read_req_log_file, GetRequestLoggerOptions());
+    });
+    read_req_logger_->LogReadRequest(node_id, *original_req, details,
+                                     timestamp);
+  }
 
-  return ToGrpcStatus(status, details);
+  return ToGrpcStatus(status, details, WantsCompactErrorDetails(context));
 }
 
 ::grpc::Status P4Service::SetForwardingPipelineConfig(
@@ -562,9 +587,6 @@ void LogReadRequest(uint64 node_id, const ::p4::v1::ReadRequest& req,
 
 ::grpc::Status P4Service::StreamChannel(
     ::grpc::ServerContext* context, ServerStreamChannelReaderWriter* stream) {
-  RETURN_IF_NOT_AUTHORIZED(auth_policy_checker_, P4Service, StreamChannel,
-                           context);
-
   // Here are the rules:
   // 1- When a client (aka controller) connects for the first time, we do not do
   //    anything until a MasterArbitrationUpdate proto is received.
@@ -572,17 +594,8 @@ void LogReadRequest(uint64 node_id, const ::p4::v1::ReadRequest& req,
   //    this many time), the controller becomes/stays master or slave.
   // 3- At any point of time, only the master stream is capable of sending
   //    and receiving packets.
-
-  // First thing to do is to ensure that we're not already handling too many
-  // connections and increment the counter by one.
-  auto ret = CheckAndIncrementConnectionCount();
-  if (!ret.ok()) {
-    return ::grpc::Status(ToGrpcCode(ret.CanonicalCode()), ret.error_message());
-  }
-
-  // We create a unique SDN connection object for every active connection.
-  auto sdn_connection =
-      absl::make_unique<p4runtime::SdnConnection>(context, stream);
+  std::unique_ptr<p4runtime::SdnConnection> sdn_connection;
+  RETURN_IF_GRPC_ERROR(StartStreamChannel(context, stream, &sdn_connection));
 
   // The ID of the node this stream channel corresponds to. This is MUST NOT
   // change after it is set for the first time.
@@ -595,88 +608,126 @@ void LogReadRequest(uint64 node_id, const ::p4::v1::ReadRequest& req,
 
   ::p4::v1::StreamMessageRequest req;
   while (stream->Read(&req)) {
-    switch (req.update_case()) {
-      case ::p4::v1::StreamMessageRequest::kArbitration: {
-        if (req.arbitration().device_id() == 0) {
-          return ::grpc::Status(::grpc::StatusCode::INVALID_ARGUMENT,
-                                "Invalid node (aka device) ID.");
-        } else if (node_id == 0) {
-          node_id = req.arbitration().device_id();
-        }
-        absl::uint128 election_id =
-            absl::MakeUint128(req.arbitration().election_id().high(),
-                              req.arbitration().election_id().low());
-        if (election_id == 0) {
-          return ::grpc::Status(::grpc::StatusCode::INVALID_ARGUMENT,
-                                "Invalid election ID.");
-        }
-        // Try to add the controller to controllers_.
-        auto status = AddOrModifyController(node_id, req.arbitration(),
-                                            sdn_connection.get());
-        if (!status.ok()) {
-          return ::grpc::Status(ToGrpcCode(status.CanonicalCode()),
-                                status.error_message());
-        }
-        LOG(INFO) << "Controller " << sdn_connection->GetName()
-                  << " is connected as "
-                  << (IsMasterController(node_id, sdn_connection->GetRoleName(),
-                                         sdn_connection->GetElectionId())
-                          ? "MASTER"
-                          : "SLAVE")
-                  << " for node (aka device) with ID " << node_id << ".";
-        break;
+    RETURN_IF_GRPC_ERROR(
+        HandleStreamChannelRequest(req, &node_id, sdn_connection.get()));
+  }
+
+  return ::grpc::Status::OK;
+}
+
+::grpc::Status P4Service::StartStreamChannel(
+    ::grpc::ServerContext* context,
+    ServerStreamChannelReaderWriterInterface* stream,
+    std::unique_ptr<p4runtime::SdnConnection>* connection) {
+  RETURN_IF_NOT_AUTHORIZED(auth_policy_checker_, P4Service, StreamChannel,
+                           context);
+
+  // First thing to do is to ensure that we're not already handling too many
+  // connections and increment the counter by one.
+  auto ret = CheckAndIncrementConnectionCount();
+  if (!ret.ok()) {
+    return ::grpc::Status(ToGrpcCode(ret.CanonicalCode()), ret.error_message());
+  }
+
+  // We create a unique SDN connection object for every active connection.
+  p4runtime::SendQueueOptions send_queue_options;
+  send_queue_options.max_depth = FLAGS_stream_message_send_queue_depth;
+  send_queue_options.drop_policy =
+      FLAGS_stream_message_send_queue_drop_oldest
+          ? p4runtime::SendQueueDropPolicy::kDropOldest
+          : p4runtime::SendQueueDropPolicy::kDropNewest;
+  send_queue_options.drain_timeout =
+      absl::Milliseconds(FLAGS_stream_message_send_queue_drain_timeout_ms);
+  *connection = absl::make_unique<p4runtime::SdnConnection>(context, stream,
+                                                            send_queue_options);
+
+  return ::grpc::Status::OK;
+}
+
+::grpc::Status P4Service::HandleStreamChannelRequest(
+    const ::p4::v1::StreamMessageRequest& req, uint64* node_id,
+    p4runtime::SdnConnection* sdn_connection) {
+  switch (req.update_case()) {
+    case ::p4::v1::StreamMessageRequest::kArbitration: {
+      if (req.arbitration().device_id() == 0) {
+        return ::grpc::Status(::grpc::StatusCode::INVALID_ARGUMENT,
+                              "Invalid node (aka device) ID.");
+      } else if (*node_id == 0) {
+        *node_id = req.arbitration().device_id();
       }
-      case ::p4::v1::StreamMessageRequest::kPacket: {
-        // If this stream is not the master stream generate a stream error.
-        ::util::Status status;
-        if (!IsMasterController(node_id, sdn_connection->GetRoleName(),
-                                sdn_connection->GetElectionId())) {
-          status = MAKE_ERROR(ERR_PERMISSION_DENIED).without_logging()
-                   << "Controller " << sdn_connection->GetName()
-                   << " is not a master";
-        } else {
-          // If master, try to transmit the packet.
-          status = switch_interface_->HandleStreamMessageRequest(node_id, req);
-        }
-        if (!status.ok()) {
-          LOG_EVERY_N(INFO, 500) << "Failed to transmit packet: " << status;
-          auto resp = ToStreamMessageResponse(status);
-          *resp.mutable_error()->mutable_packet_out()->mutable_packet_out() =
-              req.packet();
-          sdn_connection->SendStreamMessageResponse(resp);  // Best effort.
-        }
-        break;
+      absl::uint128 election_id =
+          absl::MakeUint128(req.arbitration().election_id().high(),
+                            req.arbitration().election_id().low());
+      if (election_id == 0) {
+        return ::grpc::Status(::grpc::StatusCode::INVALID_ARGUMENT,
+                              "Invalid election ID.");
       }
-      case ::p4::v1::StreamMessageRequest::kDigestAck: {
-        // If this stream is not the master stream generate a stream error.
-        ::util::Status status;
-        if (!IsMasterController(node_id, sdn_connection->GetRoleName(),
-                                sdn_connection->GetElectionId())) {
-          status = MAKE_ERROR(ERR_PERMISSION_DENIED).without_logging()
-                   << "Controller " << sdn_connection->GetName()
-                   << " is not a master";
-        } else {
-          // If master, try to ack the digest.
-          status = switch_interface_->HandleStreamMessageRequest(node_id, req);
-        }
-        if (!status.ok()) {
-          LOG(INFO) << "Failed to ack digest: " << status;
-          // TODO(max): investigate if creating responses for every failure is
-          // too resource intensive.
-          auto resp = ToStreamMessageResponse(status);
-          *resp.mutable_error()
-               ->mutable_digest_list_ack()
-               ->mutable_digest_list_ack() = req.digest_ack();
-          sdn_connection->SendStreamMessageResponse(resp);  // Best effort.
-        }
-        break;
+      // Try to add the controller to controllers_.
+      auto status =
+          AddOrModifyController(*node_id, req.arbitration(), sdn_connection);
+      if (!status.ok()) {
+        return ::grpc::Status(ToGrpcCode(status.CanonicalCode()),
+                              status.error_message());
+      }
+      LOG(INFO) << "Controller " << sdn_connection->GetName()
+                << " is connected as "
+                << (IsMasterController(*node_id, sdn_connection->GetRoleName(),
+                                       sdn_connection->GetElectionId())
+                        ? "MASTER"
+                        : "SLAVE")
+                << " for node (aka device) with ID " << *node_id << ".";
+      break;
+    }
+    case ::p4::v1::StreamMessageRequest::kPacket: {
+      // If this stream is not the master stream generate a stream error.
+      ::util::Status status;
+      if (!IsMasterController(*node_id, sdn_connection->GetRoleName(),
+                              sdn_connection->GetElectionId())) {
+        status = MAKE_ERROR(ERR_PERMISSION_DENIED).without_logging()
+                 << "Controller " << sdn_connection->GetName()
+                 << " is not a master";
+      } else {
+        // If master, try to transmit the packet.
+        status = switch_interface_->HandleStreamMessageRequest(*node_id, req);
+      }
+      if (!status.ok()) {
+        LOG_EVERY_N(INFO, 500) << "Failed to transmit packet: " << status;
+        auto resp = ToStreamMessageResponse(status);
+        *resp.mutable_error()->mutable_packet_out()->mutable_packet_out() =
+            req.packet();
+        sdn_connection->SendStreamMessageResponse(resp);  // Best effort.
+      }
+      break;
+    }
+    case ::p4::v1::StreamMessageRequest::kDigestAck: {
+      // If this stream is not the master stream generate a stream error.
+      ::util::Status status;
+      if (!IsMasterController(*node_id, sdn_connection->GetRoleName(),
+                              sdn_connection->GetElectionId())) {
+        status = MAKE_ERROR(ERR_PERMISSION_DENIED).without_logging()
+                 << "Controller " << sdn_connection->GetName()
+                 << " is not a master";
+      } else {
+        // If master, try to ack the digest.
+        status = switch_interface_->HandleStreamMessageRequest(*node_id, req);
       }
-      case ::p4::v1::StreamMessageRequest::UPDATE_NOT_SET:
-      case ::p4::v1::StreamMessageRequest::kOther:
-        return ::grpc::Status(
-            ::grpc::StatusCode::INVALID_ARGUMENT,
-            "Need to specify either arbitration, packet or digest ack.");
+      if (!status.ok()) {
+        LOG(INFO) << "Failed to ack digest: " << status;
+        // TODO(max): investigate if creating responses for every failure is
+        // too resource intensive.
+        auto resp = ToStreamMessageResponse(status);
+        *resp.mutable_error()
+             ->mutable_digest_list_ack()
+             ->mutable_digest_list_ack() = req.digest_ack();
+        sdn_connection->SendStreamMessageResponse(resp);  // Best effort.
+      }
+      break;
     }
+    case ::p4::v1::StreamMessageRequest::UPDATE_NOT_SET:
+    case ::p4::v1::StreamMessageRequest::kOther:
+      return ::grpc::Status(
+          ::grpc::StatusCode::INVALID_ARGUMENT,
+          "Need to specify either arbitration, packet or digest ack.");
   }
 
   return ::grpc::Status::OK;
@@ -714,7 +765,8 @@ void LogReadRequest(uint64 node_id, const ::p4::v1::ReadRequest& req,
     // an RX response writer for it. If the node_id is invalid, registration
     // will fail.
     std::shared_ptr<Channel<::p4::v1::StreamMessageResponse>> channel =
-        Channel<::p4::v1::StreamMessageResponse>::Create(128);
+        Channel<::p4::v1::StreamMessageResponse>::Create(
+            128, "p4_stream_responses");
     // Create the writer and register with the SwitchInterface.
     auto writer =
         std::make_shared<ChannelWriterWrapper<::p4::v1::StreamMessageResponse>>(
@@ -753,6 +805,7 @@ void LogReadRequest(uint64 node_id, const ::p4::v1::ReadRequest& req,
 
   ::grpc::Status status =
       it->second.HandleArbitrationUpdate(update, controller);
+  UpdateArbitrationSnapshot();
   if (!status.ok()) {
     return ::util::Status(static_cast<::util::error::Code>(status.error_code()),
                           status.error_message());
@@ -768,6 +821,16 @@ void P4Service::RemoveController(uint64 node_id,
   auto it = node_id_to_controller_manager_.find(node_id);
   if (it == node_id_to_controller_manager_.end()) return;
   it->second.Disconnect(connection);
+  UpdateArbitrationSnapshot();
+}
+
+void P4Service::UpdateArbitrationSnapshot() {
+  auto snapshot = std::make_shared<ArbitrationSnapshot>();
+  for (const auto& e : node_id_to_controller_manager_) {
+    (*snapshot)[e.first] = e.second.GetPrimaryElectionIds();
+  }
+  std::atomic_store(&arbitration_snapshot_,
+                    std::shared_ptr<const ArbitrationSnapshot>(snapshot));
 }
 
 ::grpc::Status P4Service::IsWritePermitted(
@@ -806,10 +869,13 @@ void P4Service::RemoveController(uint64 node_id,
 bool P4Service::IsMasterController(
     uint64 node_id, const absl::optional<std::string>& role_name,
     const absl::optional<absl::uint128>& election_id) const {
-  absl::ReaderMutexLock l(&controller_lock_);
-  auto it = node_id_to_controller_manager_.find(node_id);
-  if (it == node_id_to_controller_manager_.end()) return false;
-  return it->second.AllowRequest(role_name, election_id).ok();
+  if (!election_id.has_value()) return false;
+  std::shared_ptr<const ArbitrationSnapshot> snapshot =
+      std::atomic_load(&arbitration_snapshot_);
+  auto node = snapshot->find(node_id);
+  if (node == snapshot->end()) return false;
+  auto primary = node->second.find(role_name);
+  return primary != node->second.end() && primary->second == *election_id;
 }
 
 ::util::StatusOr<::p4::v1::ForwardingPipelineConfig>
@@ -888,5 +954,84 @@ void P4Service::StreamResponseReceiveHandler(
       << " to primary controller: " << status.ToString();
 }
 
+// Keeps the state of one StreamChannel call in the asynchronous server.
+class P4AsyncService::StreamChannelHandler
+    : public AsyncStreamHandler<::p4::v1::StreamMessageResponse,
+                                ::p4::v1::StreamMessageRequest> {
+ public:
+  explicit StreamChannelHandler(P4Service* p4_service)
+      : p4_service_(p4_service), node_id_(0) {}
+
+  ::grpc::Status OnStart(
+      ::grpc::ServerContext* context,
+      ServerStreamChannelReaderWriterInterface* stream) override {
+    return p4_service_->StartStreamChannel(context, stream, &sdn_connection_);
+  }
+
+  ::grpc::Status OnRead(const ::p4::v1::StreamMessageRequest& req) override {
+    return p4_service_->HandleStreamChannelRequest(req, &node_id_,
+                                                   sdn_connection_.get());
+  }
+
+  ::grpc::Status OnDone() override {
+    p4_service_->RemoveController(node_id_, sdn_connection_.get());
+    return ::grpc::Status::OK;
+  }
+
+ private:
+  P4Service* const p4_service_;  // not owned by this class.
+  uint64 node_id_;
+  std::unique_ptr<p4runtime::SdnConnection> sdn_connection_;
+};
+
+void P4AsyncService::Start(::grpc::ServerCompletionQueue* cq,
+                           size_t max_queued_writes) {
+  P4Service* p4_service = p4_service_;
+  // All the responses are written by the writer thread of the SdnConnection,
+  // which may wait for room in the queue.
+  AsyncWriteQueueOptions options;
+  options.max_queued_writes = max_queued_writes;
+  options.block_when_full = true;
+  AsyncBidiStreamingCall<P4AsyncService, ::p4::v1::StreamMessageResponse,
+                         ::p4::v1::StreamMessageRequest>::
+      Start(this, &P4AsyncService::RequestStreamChannel,
+            [p4_service]() {
+              return absl::make_unique<StreamChannelHandler>(p4_service);
+            },
+            options, cq);
+}
+
+::grpc::Status P4AsyncService::Write(::grpc::ServerContext* context,
+                                     const ::p4::v1::WriteRequest* req,
+                                     ::p4::v1::WriteResponse* resp) {
+  return p4_service_->Write(context, req, resp);
+}
+
+::grpc::Status P4AsyncService::Read(
+    ::grpc::ServerContext* context, const ::p4::v1::ReadRequest* req,
+    ::grpc::ServerWriter<::p4::v1::ReadResponse>* writer) {
+  return p4_service_->Read(context, req, writer);
+}
+
+::grpc::Status P4AsyncService::SetForwardingPipelineConfig(
+    ::grpc::ServerContext* context,
+    const ::p4::v1::SetForwardingPipelineConfigRequest* req,
+    ::p4::v1::SetForwardingPipelineConfigResponse* resp) {
+  return p4_service_->SetForwardingPipelineConfig(context, req, resp);
+}
+
+::grpc::Status P4AsyncService::GetForwardingPipelineConfig(
+    ::grpc::ServerContext* context,
+    const ::p4::v1::GetForwardingPipelineConfigRequest* req,
+    ::p4::v1::GetForwardingPipelineConfigResponse* resp) {
+  return p4_service_->GetForwardingPipelineConfig(context, req, resp);
+}
+
+::grpc::Status P4AsyncService::Capabilities(
+    ::grpc::ServerContext* context, const ::p4::v1::CapabilitiesRequest* req,
+    ::p4::v1::CapabilitiesResponse* resp) {
+  return p4_service_->Capabilities(context, req, resp);
+}
+
 }  // namespace hal
 }  // namespace stratum
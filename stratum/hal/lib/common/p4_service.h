@@ -14,6 +14,7 @@
 #include <unordered_map>
 #include <vector>
 
+#include "absl/base/call_once.h"
 #include "absl/base/thread_annotations.h"
 #include "absl/container/flat_hash_map.h"
 #include "absl/numeric/int128.h"
@@ -23,9 +24,11 @@
 #include "stratum/glue/integral_types.h"
 #include "stratum/glue/status/status.h"
 #include "stratum/glue/status/statusor.h"
+#include "stratum/hal/lib/common/async_grpc.h"
 #include "stratum/hal/lib/common/channel_writer_wrapper.h"
 #include "stratum/hal/lib/common/common.pb.h"
 #include "stratum/hal/lib/common/error_buffer.h"
+#include "stratum/hal/lib/common/p4_request_logger.h"
 #include "stratum/hal/lib/common/switch_interface.h"
 #include "stratum/hal/lib/p4/forwarding_pipeline_configs.pb.h"
 #include "stratum/lib/p4runtime/sdn_controller_manager.h"
@@ -38,6 +41,19 @@ namespace hal {
 typedef ::grpc::ServerReaderWriter<::p4::v1::StreamMessageResponse,
                                    ::p4::v1::StreamMessageRequest>
     ServerStreamChannelReaderWriter;
+typedef ::grpc::ServerReaderWriterInterface<::p4::v1::StreamMessageResponse,
+                                            ::p4::v1::StreamMessageRequest>
+    ServerStreamChannelReaderWriterInterface;
+
+// By default, a failed Write or Read returns one ::p4::v1::Error per update or
+// entity in the details of the status, as the P4Runtime spec mandates. Clients
+// sending large batches can set the kErrorDetailsMetadataKey metadata to
+// kCompactErrorDetails instead. Every run of consecutive successful updates or
+// entities is then returned as a single ::p4::v1::Error with an OK canonical
+// code, kOkRunErrorSpace as space and the length of the run as code.
+constexpr char kErrorDetailsMetadataKey[] = "p4rt-error-details";
+constexpr char kCompactErrorDetails[] = "compact";
+constexpr char kOkRunErrorSpace[] = "stratum.ok-run";
 
 // The "P4Service" class implements P4Runtime::Service. It handles all
 // the RPCs that are part of the P4-based PI API.
@@ -120,6 +136,21 @@ class P4Service final : public ::p4::v1::P4Runtime::Service {
   // Specifies the max number of controllers that can connect for a node.
   static constexpr size_t kMaxNumControllerPerNode = 5;
 
+  // Authorizes a new StreamChannel and creates the SdnConnection for it. On
+  // success, the caller has to call RemoveController() once the stream is
+  // closed.
+  ::grpc::Status StartStreamChannel(
+      ::grpc::ServerContext* context,
+      ServerStreamChannelReaderWriterInterface* stream,
+      std::unique_ptr<p4runtime::SdnConnection>* connection);
+
+  // Handles a request received on the StreamChannel of 'connection'. Sets
+  // 'node_id' on the first arbitration update. A non-OK status closes the
+  // stream.
+  ::grpc::Status HandleStreamChannelRequest(
+      const ::p4::v1::StreamMessageRequest& req, uint64* node_id,
+      p4runtime::SdnConnection* connection);
+
   // Checks and increments the number of active connections to make sure we do
   // not end with so many dangling threads. Called for every newly connected
   // controller, and before `AddOrModifyController`.
@@ -162,12 +193,19 @@ class P4Service final : public ::p4::v1::P4Runtime::Service {
       LOCKS_EXCLUDED(controller_lock_);
 
   // Returns true if the given role and election_id belongs to the master
-  // controller stream for a node given by its node ID.
+  // controller stream for a node given by its node ID. Called for every
+  // PacketOut, so it reads the arbitration snapshot instead of acquiring
+  // controller_lock_.
   bool IsMasterController(
       uint64 node_id, const absl::optional<std::string>& role_name,
       const absl::optional<absl::uint128>& election_id) const
       LOCKS_EXCLUDED(controller_lock_);
 
+  // Rebuilds the arbitration snapshot from the controller managers. Has to be
+  // called whenever a controller connects, disconnects or changes its
+  // election ID.
+  void UpdateArbitrationSnapshot() EXCLUSIVE_LOCKS_REQUIRED(controller_lock_);
+
   // Return the stored forwarding pipeline for the given node.
   ::util::StatusOr<::p4::v1::ForwardingPipelineConfig>
   DoGetForwardingPipelineConfig(uint64 node_id) const
@@ -219,6 +257,18 @@ class P4Service final : public ::p4::v1::P4Runtime::Service {
   std::unordered_map<uint64, p4runtime::SdnControllerManager>
       node_id_to_controller_manager_ ABSL_GUARDED_BY(controller_lock_);
 
+  // Map from node ID to a map from role name to the election ID of the primary
+  // connection of the role.
+  using ArbitrationSnapshot = absl::flat_hash_map<
+      uint64, absl::flat_hash_map<absl::optional<std::string>, absl::uint128>>;
+
+  // Immutable snapshot of the primary connections of all nodes, RCU-style: it
+  // is rebuilt and swapped as a whole under controller_lock_, and readers load
+  // it with std::atomic_load without taking any lock. A reader may use a
+  // snapshot which has just been replaced, as it would have with a lock taken
+  // right before the arbitration update.
+  std::shared_ptr<const ArbitrationSnapshot> arbitration_snapshot_;
+
   // Holds the number of currently open StreamChannels across all nodes. This is
   // tracked for resource limiting. Note that this count can be different from
   // the sum of connected controllers reported by all controller managers, as
@@ -261,9 +311,68 @@ class P4Service final : public ::p4::v1::P4Runtime::Service {
   // by this class.
   ErrorBuffer* error_buffer_;
 
+  // Loggers of the write and read requests, created on first use if
+  // FLAGS_write_req_log_file and FLAGS_read_req_log_file are set.
+  absl::once_flag write_req_logger_once_;
+  std::unique_ptr<P4RequestLogger> write_req_logger_;
+  absl::once_flag read_req_logger_once_;
+  std::unique_ptr<P4RequestLogger> read_req_logger_;
+
+  friend class P4AsyncService;
   friend class P4ServiceTest;
 };
 
+// The P4Runtime service registered in the asynchronous server mode.
+// StreamChannel calls are handled on the completion queues of the server,
+// without pinning a thread each. The other RPCs, including Write and Read, are
+// forwarded to the synchronous P4Service and run on the threads of the
+// synchronous server, so that they never hold up a completion queue.
+class P4AsyncService final
+    : public ::p4::v1::P4Runtime::WithAsyncMethod_StreamChannel<
+          ::p4::v1::P4Runtime::Service> {
+ public:
+  explicit P4AsyncService(P4Service* p4_service) : p4_service_(p4_service) {}
+
+  // Starts accepting calls on 'cq'. To be called for every completion queue
+  // once the server has been started. At most 'max_queued_writes' responses
+  // wait to be written to a stream. The send queue of the stream waits for
+  // room, so that its drop policy applies to a slow controller.
+  void Start(::grpc::ServerCompletionQueue* cq, size_t max_queued_writes);
+
+  ::grpc::Status Write(::grpc::ServerContext* context,
+                       const ::p4::v1::WriteRequest* req,
+                       ::p4::v1::WriteResponse* resp) override;
+
+  ::grpc::Status Read(
+      ::grpc::ServerContext* context, const ::p4::v1::ReadRequest* req,
+      ::grpc::ServerWriter<::p4::v1::ReadResponse>* writer) override;
+
+  ::grpc::Status SetForwardingPipelineConfig(
+      ::grpc::ServerContext* context,
+      const ::p4::v1::SetForwardingPipelineConfigRequest* req,
+      ::p4::v1::SetForwardingPipelineConfigResponse* resp) override;
+
+  ::grpc::Status GetForwardingPipelineConfig(
+      ::grpc::ServerContext* context,
+      const ::p4::v1::GetForwardingPipelineConfigRequest* req,
+      ::p4::v1::GetForwardingPipelineConfigResponse* resp) override;
+
+  ::grpc::Status Capabilities(
+      ::grpc::ServerContext* context,
+      const ::p4::v1::CapabilitiesRequest* request,
+      ::p4::v1::CapabilitiesResponse* response) override;
+
+  // P4AsyncService is neither copyable nor movable.
+  P4AsyncService(const P4AsyncService&) = delete;
+  P4AsyncService& operator=(const P4AsyncService&) = delete;
+
+ private:
+  class StreamChannelHandler;
+
+  // Pointer to the P4Service handling the calls. Not owned by this class.
+  P4Service* p4_service_;
+};
+
 }  // namespace hal
 }  // namespace stratum
 
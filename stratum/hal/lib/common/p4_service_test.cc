@@ -5,12 +5,15 @@
 #include "stratum/hal/lib/common/p4_service.h"
 
 #include <memory>
+#include <thread>  // NOLINT
 #include <tuple>
 
 #include "absl/memory/memory.h"
 #include "absl/numeric/int128.h"
 #include "absl/strings/substitute.h"
 #include "absl/synchronization/mutex.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
 #include "gflags/gflags.h"
 #include "gmock/gmock.h"
 #include "google/rpc/code.pb.h"
@@ -19,6 +22,7 @@
 #include "stratum/glue/integral_types.h"
 #include "stratum/glue/net_util/ports.h"
 #include "stratum/glue/status/status_test_util.h"
+#include "stratum/hal/lib/common/async_grpc.h"
 #include "stratum/hal/lib/common/error_buffer.h"
 #include "stratum/hal/lib/common/switch_mock.h"
 #include "stratum/lib/macros.h"
@@ -55,6 +59,8 @@ typedef ::grpc::ClientReaderWriter<::p4::v1::StreamMessageRequest,
 class P4ServiceTest
     : public ::testing::TestWithParam<std::tuple<OperationMode, bool>> {
  protected:
+  P4ServiceTest() : async_server_(false) {}
+
   void SetUp() override {
     mode_ = ::testing::get<0>(GetParam());
     role_name_ = ::testing::get<1>(GetParam()) ? kRoleName1 : "";
@@ -68,9 +74,19 @@ class P4ServiceTest
         "localhost:" + std::to_string(stratum::PickUnusedPortOrDie());
     ::grpc::ServerBuilder builder;
     builder.AddListeningPort(url, ::grpc::InsecureServerCredentials());
-    builder.RegisterService(p4_service_.get());
+    if (async_server_) {
+      p4_async_service_ = absl::make_unique<P4AsyncService>(p4_service_.get());
+      builder.RegisterService(p4_async_service_.get());
+      cq_ = builder.AddCompletionQueue();
+    } else {
+      builder.RegisterService(p4_service_.get());
+    }
     server_ = builder.BuildAndStart();
     ASSERT_NE(server_, nullptr);
+    if (async_server_) {
+      p4_async_service_->Start(cq_.get(), kMaxQueuedWrites);
+      cq_thread_ = std::thread(PollCompletionQueue, cq_.get());
+    }
     stub_ = ::p4::v1::P4Runtime::NewStub(
         ::grpc::CreateChannel(url, ::grpc::InsecureChannelCredentials()));
     ASSERT_NE(stub_, nullptr);
@@ -89,7 +105,19 @@ class P4ServiceTest
     }
   }
 
-  void TearDown() override { server_->Shutdown(); }
+  void TearDown() override {
+    server_->Shutdown();
+    if (cq_ != nullptr) {
+      cq_->Shutdown();
+      cq_thread_.join();
+    }
+  }
+
+  // Waits until the logged requests have been written to the log files.
+  void FlushRequestLogs() {
+    if (p4_service_->write_req_logger_) p4_service_->write_req_logger_->Flush();
+    if (p4_service_->read_req_logger_) p4_service_->read_req_logger_->Flush();
+  }
 
   void OnPacketReceive(const ::p4::v1::PacketIn& packet) {
     ::p4::v1::StreamMessageResponse resp;
@@ -154,6 +182,18 @@ class P4ServiceTest
     ASSERT_OK(p4_service_->AddOrModifyController(node_id, request, controller));
   }
 
+  void RemoveFakeController(uint64 node_id,
+                            p4runtime::SdnConnection* controller) {
+    p4_service_->RemoveController(node_id, controller);
+  }
+
+  bool IsMasterController(uint64 node_id,
+                          const absl::optional<absl::uint128>& election_id) {
+    absl::optional<std::string> role_name;
+    if (!role_name_.empty()) role_name = role_name_;
+    return p4_service_->IsMasterController(node_id, role_name, election_id);
+  }
+
   int GetNumberOfActiveConnections(uint64 node_id) {
     absl::WriterMutexLock l(&p4_service_->controller_lock_);
     if (!p4_service_->node_id_to_controller_manager_.count(node_id)) return 0;
@@ -279,13 +319,19 @@ class P4ServiceTest
   static constexpr uint32 kTableId1 = 12;
   static constexpr uint64 kCookie1 = 123;
   static constexpr uint64 kCookie2 = 321;
+  static constexpr size_t kMaxQueuedWrites = 2;
+  // Whether the service is run by the asynchronous server of HAL.
+  bool async_server_;
   OperationMode mode_;
   std::string role_name_;
   std::unique_ptr<SwitchMock> switch_mock_;
   std::unique_ptr<AuthPolicyCheckerMock> auth_policy_checker_mock_;
   std::unique_ptr<ErrorBuffer> error_buffer_;
   std::unique_ptr<P4Service> p4_service_;
+  std::unique_ptr<P4AsyncService> p4_async_service_;
+  std::unique_ptr<::grpc::ServerCompletionQueue> cq_;
   std::unique_ptr<::grpc::Server> server_;
+  std::thread cq_thread_;
   std::unique_ptr<::p4::v1::P4Runtime::Stub> stub_;
 };
 
@@ -738,6 +784,23 @@ TEST_P(P4ServiceTest, SetForwardingPipelineConfigFailureForRoleProhibited) {
   CheckForwardingPipelineConfigs(nullptr, 0 /*ignored*/);
 }
 
+TEST_P(P4ServiceTest, IsMasterControllerFollowsArbitration) {
+  ::grpc::ServerContext context;
+  StreamMessageReaderWriterMock stream;
+  p4runtime::SdnConnection controller(&context, &stream);
+  controller.SetElectionId(kElectionId1);
+  EXPECT_FALSE(IsMasterController(kNodeId1, kElectionId1));
+
+  AddFakeMasterController(kNodeId1, &controller);
+  EXPECT_TRUE(IsMasterController(kNodeId1, kElectionId1));
+  EXPECT_FALSE(IsMasterController(kNodeId1, kElectionId2));
+  EXPECT_FALSE(IsMasterController(kNodeId1, absl::nullopt));
+  EXPECT_FALSE(IsMasterController(kNodeId2, kElectionId1));
+
+  RemoveFakeController(kNodeId1, &controller);
+  EXPECT_FALSE(IsMasterController(kNodeId1, kElectionId1));
+}
+
 TEST_P(P4ServiceTest, WriteSuccess) {
   SetTestForwardingPipelineConfigs();
   ::grpc::ServerContext server_context;
@@ -770,6 +833,7 @@ TEST_P(P4ServiceTest, WriteSuccess) {
   EXPECT_TRUE(status.error_message().empty());
   EXPECT_TRUE(status.error_details().empty());
   std::string s;
+  FlushRequestLogs();
   ASSERT_OK(ReadFileToString(FLAGS_write_req_log_file, &s));
   EXPECT_THAT(s, HasSubstr(req.updates(0).ShortDebugString()));
 }
@@ -893,11 +957,66 @@ TEST_P(P4ServiceTest, WriteFailureWhenWriteForwardingEntriesFails) {
   const auto& errors = error_buffer_->GetErrors();
   EXPECT_TRUE(errors.empty());
   std::string s;
+  FlushRequestLogs();
   ASSERT_OK(ReadFileToString(FLAGS_write_req_log_file, &s));
   EXPECT_THAT(s, HasSubstr(req.updates(0).ShortDebugString()));
   EXPECT_THAT(s, HasSubstr(req.updates(1).ShortDebugString()));
 }
 
+TEST_P(P4ServiceTest, WriteFailureWithCompactErrorDetails) {
+  SetTestForwardingPipelineConfigs();
+  ::grpc::ServerContext server_context;
+  StreamMessageReaderWriterMock stream;
+  p4runtime::SdnConnection controller(&server_context, &stream);
+  controller.SetElectionId(kElectionId1);
+  AddFakeMasterController(kNodeId1, &controller);
+  ::grpc::ClientContext context;
+  context.AddMetadata(kErrorDetailsMetadataKey, kCompactErrorDetails);
+  ::p4::v1::WriteRequest req;
+  ::p4::v1::WriteResponse resp;
+  req.set_device_id(kNodeId1);
+  req.mutable_election_id()->set_high(absl::Uint128High64(kElectionId1));
+  req.mutable_election_id()->set_low(absl::Uint128Low64(kElectionId1));
+  req.set_role(role_name_);
+  for (int i = 0; i < 4; ++i) {
+    auto* update = req.add_updates();
+    update->set_type(::p4::v1::Update::INSERT);
+    update->mutable_entity()->mutable_table_entry()->set_table_id(kTableId1);
+  }
+
+  EXPECT_CALL(*auth_policy_checker_mock_, Authorize("P4Service", "Write", _))
+      .WillOnce(Return(::util::OkStatus()));
+  const std::vector<::util::Status> kExpectedResults = {
+      ::util::OkStatus(), ::util::OkStatus(),
+      ::util::Status(StratumErrorSpace(), ERR_TABLE_FULL, kOperErrorMsg),
+      ::util::OkStatus()};
+  EXPECT_CALL(*switch_mock_, WriteForwardingEntries(EqualsProto(req), _))
+      .WillOnce(DoAll(
+          SetArgPointee<1>(kExpectedResults),
+          Return(::util::Status(StratumErrorSpace(),
+                                ERR_AT_LEAST_ONE_OPER_FAILED, kAggrErrorMsg))));
+
+  // Invoke the RPC and validate that the OK results are run-length encoded.
+  ::grpc::Status status = stub_->Write(&context, req, &resp);
+  EXPECT_FALSE(status.ok());
+  EXPECT_THAT(status.error_message(), HasSubstr(kAggrErrorMsg));
+  ::google::rpc::Status details;
+  ASSERT_TRUE(details.ParseFromString(status.error_details()));
+  ASSERT_EQ(3, details.details_size());
+  ::p4::v1::Error detail;
+  ASSERT_TRUE(details.details(0).UnpackTo(&detail));
+  EXPECT_EQ(::google::rpc::OK, detail.canonical_code());
+  EXPECT_EQ(kOkRunErrorSpace, detail.space());
+  EXPECT_EQ(2, detail.code());
+  ASSERT_TRUE(details.details(1).UnpackTo(&detail));
+  EXPECT_EQ(::google::rpc::OUT_OF_RANGE, detail.canonical_code());
+  EXPECT_EQ(kOperErrorMsg, detail.message());
+  ASSERT_TRUE(details.details(2).UnpackTo(&detail));
+  EXPECT_EQ(::google::rpc::OK, detail.canonical_code());
+  EXPECT_EQ(kOkRunErrorSpace, detail.space());
+  EXPECT_EQ(1, detail.code());
+}
+
 TEST_P(P4ServiceTest, WriteFailureForAuthError) {
   SetTestForwardingPipelineConfigs();
   ::grpc::ClientContext context;
@@ -1042,6 +1161,7 @@ TEST_P(P4ServiceTest, ReadSuccess) {
   ::grpc::Status status = reader->Finish();
   EXPECT_TRUE(status.ok());
   std::string s;
+  FlushRequestLogs();
   ASSERT_OK(ReadFileToString(FLAGS_read_req_log_file, &s));
   EXPECT_THAT(s, HasSubstr(req.entities(0).ShortDebugString()));
 }
@@ -1111,6 +1231,7 @@ TEST_P(P4ServiceTest, ReadSuccessForRoleWildcardExpansion) {
   ::grpc::Status status = reader->Finish();
   EXPECT_TRUE(status.ok());
   std::string s;
+  FlushRequestLogs();
   ASSERT_OK(ReadFileToString(FLAGS_read_req_log_file, &s));
   EXPECT_THAT(s, HasSubstr(req.entities(0).ShortDebugString()));
 }
@@ -1171,6 +1292,7 @@ TEST_P(P4ServiceTest, ReadFailureWhenReadForwardingEntriesFails) {
   const auto& errors = error_buffer_->GetErrors();
   EXPECT_TRUE(errors.empty());
   std::string s;
+  FlushRequestLogs();
   ASSERT_OK(ReadFileToString(FLAGS_read_req_log_file, &s));
   EXPECT_THAT(s, HasSubstr(req.entities(0).ShortDebugString()));
 }
@@ -2454,6 +2576,170 @@ TEST_P(P4ServiceTest, GetCapabilities) {
   ASSERT_EQ(response.p4runtime_api_version(), STRINGIFY(P4RUNTIME_VER));
 }
 
+// Runs the tests with the P4AsyncService of the asynchronous server mode.
+class P4AsyncServiceTest : public P4ServiceTest {
+ protected:
+  P4AsyncServiceTest() { async_server_ = true; }
+};
+
+TEST_P(P4AsyncServiceTest, StreamChannelSuccess) {
+  ::grpc::ClientContext context;
+  ::p4::v1::StreamMessageRequest req;
+  ::p4::v1::StreamMessageResponse resp;
+  ::p4::v1::PacketIn packet;
+  ASSERT_OK(ParseProtoFromString(kTestPacketMetadata3, packet.add_metadata()));
+
+  EXPECT_CALL(*auth_policy_checker_mock_,
+              Authorize("P4Service", "StreamChannel", _))
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_CALL(*switch_mock_, RegisterStreamMessageResponseWriter(kNodeId1, _))
+      .WillOnce(Return(::util::OkStatus()));
+
+  std::unique_ptr<ClientStreamChannelReaderWriter> stream =
+      stub_->StreamChannel(&context);
+  req.mutable_arbitration()->set_device_id(kNodeId1);
+  req.mutable_arbitration()->mutable_election_id()->set_high(
+      absl::Uint128High64(kElectionId1));
+  req.mutable_arbitration()->mutable_election_id()->set_low(
+      absl::Uint128Low64(kElectionId1));
+  ASSERT_TRUE(stream->Write(req));
+  ASSERT_TRUE(stream->Read(&resp));
+  EXPECT_EQ(::google::rpc::OK, resp.arbitration().status().code());
+  EXPECT_EQ(1, GetNumberOfActiveConnections(kNodeId1));
+
+  // More PacketIns than the write queue of the stream holds are delivered in
+  // order.
+  const int kNumPackets = 3 * kMaxQueuedWrites;
+  for (int i = 0; i < kNumPackets; ++i) {
+    packet.set_payload(std::to_string(i));
+    OnPacketReceive(packet);
+  }
+  for (int i = 0; i < kNumPackets; ++i) {
+    ASSERT_TRUE(stream->Read(&resp));
+    EXPECT_EQ(std::to_string(i), resp.packet().payload());
+  }
+
+  stream->WritesDone();
+  EXPECT_TRUE(stream->Finish().ok());
+  EXPECT_EQ(0, GetNumberOfActiveConnections(kNodeId1));
+  EXPECT_EQ(0, GetNumberOfConnections());
+}
+
+TEST_P(P4AsyncServiceTest, StreamChannelFailureForZeroDeviceId) {
+  ::grpc::ClientContext context;
+  ::p4::v1::StreamMessageRequest req;
+  ::p4::v1::StreamMessageResponse resp;
+
+  EXPECT_CALL(*auth_policy_checker_mock_,
+              Authorize("P4Service", "StreamChannel", _))
+      .WillOnce(Return(::util::OkStatus()));
+
+  std::unique_ptr<ClientStreamChannelReaderWriter> stream =
+      stub_->StreamChannel(&context);
+  ASSERT_TRUE(stream->Write(req));
+  ASSERT_FALSE(stream->Read(&resp));  // no resp is sent back
+  ::grpc::Status status = stream->Finish();
+  EXPECT_EQ(::grpc::StatusCode::INVALID_ARGUMENT, status.error_code());
+  EXPECT_EQ(0, GetNumberOfConnections());
+}
+
+TEST_P(P4AsyncServiceTest, StreamChannelClientCancelRemovesController) {
+  ::grpc::ClientContext context;
+  ::p4::v1::StreamMessageRequest req;
+  ::p4::v1::StreamMessageResponse resp;
+
+  EXPECT_CALL(*auth_policy_checker_mock_,
+              Authorize("P4Service", "StreamChannel", _))
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_CALL(*switch_mock_, RegisterStreamMessageResponseWriter(kNodeId1, _))
+      .WillOnce(Return(::util::OkStatus()));
+
+  std::unique_ptr<ClientStreamChannelReaderWriter> stream =
+      stub_->StreamChannel(&context);
+  req.mutable_arbitration()->set_device_id(kNodeId1);
+  req.mutable_arbitration()->mutable_election_id()->set_high(
+      absl::Uint128High64(kElectionId1));
+  req.mutable_arbitration()->mutable_election_id()->set_low(
+      absl::Uint128Low64(kElectionId1));
+  ASSERT_TRUE(stream->Write(req));
+  ASSERT_TRUE(stream->Read(&resp));
+  EXPECT_EQ(1, GetNumberOfActiveConnections(kNodeId1));
+
+  context.TryCancel();
+  EXPECT_EQ(::grpc::StatusCode::CANCELLED, stream->Finish().error_code());
+  // The server learns about the cancellation asynchronously.
+  while (GetNumberOfConnections() != 0) absl::SleepFor(absl::Milliseconds(1));
+  EXPECT_EQ(0, GetNumberOfActiveConnections(kNodeId1));
+}
+
+TEST_P(P4AsyncServiceTest, WriteIsForwardedToP4Service) {
+  SetTestForwardingPipelineConfigs();
+  ::grpc::ServerContext server_context;
+  StreamMessageReaderWriterMock stream;
+  p4runtime::SdnConnection controller(&server_context, &stream);
+  controller.SetElectionId(kElectionId1);
+  AddFakeMasterController(kNodeId1, &controller);
+
+  ::grpc::ClientContext context;
+  ::p4::v1::WriteRequest req;
+  ::p4::v1::WriteResponse resp;
+  req.set_device_id(kNodeId1);
+  req.mutable_election_id()->set_high(absl::Uint128High64(kElectionId1));
+  req.mutable_election_id()->set_low(absl::Uint128Low64(kElectionId1));
+  req.set_role(role_name_);
+  req.add_updates()->set_type(::p4::v1::Update::INSERT);
+  req.mutable_updates(0)->mutable_entity()->mutable_table_entry()->set_table_id(
+      kTableId1);
+
+  EXPECT_CALL(*auth_policy_checker_mock_, Authorize("P4Service", "Write", _))
+      .WillOnce(Return(::util::OkStatus()));
+  const std::vector<::util::Status> kExpectedResults = {::util::OkStatus()};
+  EXPECT_CALL(*switch_mock_, WriteForwardingEntries(EqualsProto(req), _))
+      .WillOnce(DoAll(SetArgPointee<1>(kExpectedResults),
+                      Return(::util::OkStatus())));
+
+  EXPECT_TRUE(stub_->Write(&context, req, &resp).ok());
+}
+
+TEST_P(P4AsyncServiceTest, ReadStreamsAllResponses) {
+  SetTestForwardingPipelineConfigs();
+  ::grpc::ClientContext context;
+  ::p4::v1::ReadRequest req;
+  ::p4::v1::ReadResponse resp;
+  req.set_device_id(kNodeId1);
+  req.set_role(role_name_);
+  req.add_entities()->mutable_table_entry()->set_table_id(kTableId1);
+
+  EXPECT_CALL(*auth_policy_checker_mock_, Authorize("P4Service", "Read", _))
+      .WillOnce(Return(::util::OkStatus()));
+  const int kNumResponses = 3 * kMaxQueuedWrites;
+  const std::vector<::util::Status> kExpectedResults = {::util::OkStatus()};
+  EXPECT_CALL(*switch_mock_, ReadForwardingEntries(EqualsProto(req), _, _))
+      .WillOnce(DoAll(
+          WithArgs<1>(Invoke([](WriterInterface<::p4::v1::ReadResponse>* w) {
+            for (int i = 0; i < kNumResponses; ++i) {
+              ::p4::v1::ReadResponse resp;
+              resp.add_entities()->mutable_table_entry()->set_priority(i);
+              EXPECT_TRUE(w->Write(resp));
+            }
+          })),
+          SetArgPointee<2>(kExpectedResults), Return(::util::OkStatus())));
+
+  std::unique_ptr<::grpc::ClientReader<::p4::v1::ReadResponse>> reader =
+      stub_->Read(&context, req);
+  for (int i = 0; i < kNumResponses; ++i) {
+    ASSERT_TRUE(reader->Read(&resp));
+    EXPECT_EQ(i, resp.entities(0).table_entry().priority());
+  }
+  ASSERT_FALSE(reader->Read(&resp));
+  EXPECT_TRUE(reader->Finish().ok());
+}
+
+INSTANTIATE_TEST_SUITE_P(
+    P4AsyncServiceTestWithMode, P4AsyncServiceTest,
+    ::testing::Combine(::testing::Values(OPERATION_MODE_STANDALONE),
+                       ::testing::Values(true, false) /* with role config */));
+
 INSTANTIATE_TEST_SUITE_P(
     P4ServiceTestWithMode, P4ServiceTest,
     ::testing::Combine(::testing::Values(OPERATION_MODE_STANDALONE,
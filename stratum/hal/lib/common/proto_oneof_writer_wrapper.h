@@ -22,20 +22,31 @@ namespace hal {
 template <typename T, typename R>
 class ProtoOneofWriterWrapper : public WriterInterface<R> {
  public:
-  explicit ProtoOneofWriterWrapper(std::shared_ptr<WriterInterface<T>> writer,
-                                   R* (T::*get_mutable_inner_message)())
+  explicit ProtoOneofWriterWrapper(
+      std::shared_ptr<WriterInterface<T>> writer,
+      void (T::*unsafe_arena_set_allocated_inner_message)(R*),
+      R* (T::*unsafe_arena_release_inner_message)())
       : writer_(std::move(writer)),
-        get_mutable_inner_message_(get_mutable_inner_message) {}
+        unsafe_arena_set_allocated_inner_message_(
+            unsafe_arena_set_allocated_inner_message),
+        unsafe_arena_release_inner_message_(
+            unsafe_arena_release_inner_message) {}
   bool Write(const R& msg) override {
     if (!writer_) return false;
+    // The wrapping message only lives for the duration of the call. Instead of
+    // copying msg into it, it borrows msg and hands it back before it goes out
+    // of scope. Writers which keep the message beyond the call copy it.
     T t;
-    *(t.*get_mutable_inner_message_)() = msg;
-    return writer_->Write(t);
+    (t.*unsafe_arena_set_allocated_inner_message_)(const_cast<R*>(&msg));
+    bool result = writer_->Write(t);
+    (t.*unsafe_arena_release_inner_message_)();
+    return result;
   }
 
  private:
   std::shared_ptr<WriterInterface<T>> writer_;
-  R* (T::*get_mutable_inner_message_)();
+  void (T::*unsafe_arena_set_allocated_inner_message_)(R*);
+  R* (T::*unsafe_arena_release_inner_message_)();
 };
 
 }  // namespace hal
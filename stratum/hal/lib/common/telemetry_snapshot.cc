@@ -0,0 +1,137 @@
+// Copyright 2018-present Open Networking Foundation
+// SPDX-License-Identifier: Apache-2.0
+
+#include "stratum/hal/lib/common/telemetry_snapshot.h"
+
+#include "stratum/glue/gtl/map_util.h"
+#include "stratum/glue/logging.h"
+
+namespace stratum {
+namespace hal {
+
+namespace {
+
+// A writer that collects all the responses written to it.
+class ResponseCollector : public WriterInterface<DataResponse> {
+ public:
+  explicit ResponseCollector(std::vector<DataResponse>* responses)
+      : responses_(ABSL_DIE_IF_NULL(responses)) {}
+  bool Write(const DataResponse& resp) override {
+    responses_->push_back(resp);
+    return true;
+  }
+
+ private:
+  std::vector<DataResponse>* responses_;
+};
+
+}  // namespace
+
+TelemetrySnapshot::TelemetrySnapshot(SwitchInterface* switch_interface)
+    : switch_interface_(ABSL_DIE_IF_NULL(switch_interface)),
+      in_tick_(false),
+      cache_(),
+      requests_(),
+      recorded_(),
+      num_switch_calls_(0),
+      num_cache_hits_(0) {}
+
+void TelemetrySnapshot::BeginTick() {
+  cache_.clear();
+  in_tick_ = true;
+  Prefetch();
+}
+
+void TelemetrySnapshot::EndTick() {
+  in_tick_ = false;
+  cache_.clear();
+}
+
+::util::Status TelemetrySnapshot::RetrieveValue(
+    uint64 node_id, const DataRequest& request,
+    WriterInterface<DataResponse>* writer,
+    std::vector<::util::Status>* details) {
+  if (!in_tick_) {
+    ++num_switch_calls_;
+    return switch_interface_->RetrieveValue(node_id, request, writer, details);
+  }
+  for (const auto& req : request.requests()) {
+    std::string serialized = req.SerializeAsString();
+    const CachedResponse* cached =
+        gtl::FindOrNull(cache_, Key(node_id, serialized));
+    if (cached != nullptr) {
+      ++num_cache_hits_;
+    } else {
+      cached = &Fetch(node_id, req, serialized);
+    }
+    RecordRequest(node_id, req, serialized);
+    // Fan the cached result out to the caller.
+    for (const auto& resp : cached->responses) writer->Write(resp);
+    if (details) details->push_back(cached->status);
+  }
+
+  return ::util::OkStatus();
+}
+
+void TelemetrySnapshot::Prefetch() {
+  std::map<uint64, DataRequest> requests;
+  requests.swap(requests_);
+  recorded_.clear();
+  for (const auto& e : requests) {
+    const uint64 node_id = e.first;
+    const DataRequest& batch = e.second;
+    std::vector<DataResponse> responses;
+    std::vector<::util::Status> details;
+    ResponseCollector collector(&responses);
+    ++num_switch_calls_;
+    ::util::Status status = switch_interface_->RetrieveValue(
+        node_id, batch, &collector, &details);
+    // The switch writes one response per successful request, in order. If the
+    // results cannot be matched to the requests, nothing is cached and the
+    // requests are retrieved one by one when the leaves ask for them.
+    size_t num_ok = 0;
+    for (const auto& detail : details) num_ok += detail.ok();
+    if (!status.ok() ||
+        static_cast<int>(details.size()) != batch.requests_size() ||
+        responses.size() != num_ok) {
+      VLOG(1) << "Cannot use the batched response for node " << node_id
+              << ": " << status << ", " << details.size() << " statuses and "
+              << responses.size() << " responses for "
+              << batch.requests_size() << " requests.";
+      continue;
+    }
+    auto resp = responses.begin();
+    for (int i = 0; i < batch.requests_size(); ++i) {
+      CachedResponse& cached =
+          cache_[Key(node_id, batch.requests(i).SerializeAsString())];
+      cached.status = details[i];
+      if (details[i].ok()) cached.responses.push_back(std::move(*resp++));
+    }
+  }
+}
+
+const TelemetrySnapshot::CachedResponse& TelemetrySnapshot::Fetch(
+    uint64 node_id, const DataRequest::Request& request,
+    const std::string& serialized) {
+  DataRequest req;
+  *req.add_requests() = request;
+  CachedResponse& cached = cache_[Key(node_id, serialized)];
+  std::vector<::util::Status> details;
+  ResponseCollector collector(&cached.responses);
+  ++num_switch_calls_;
+  cached.status =
+      switch_interface_->RetrieveValue(node_id, req, &collector, &details);
+  if (cached.status.ok() && details.size() == 1) cached.status = details[0];
+
+  return cached;
+}
+
+void TelemetrySnapshot::RecordRequest(uint64 node_id,
+                                      const DataRequest::Request& request,
+                                      const std::string& serialized) {
+  if (!recorded_.emplace(node_id, serialized).second) return;
+  *requests_[node_id].add_requests() = request;
+}
+
+}  // namespace hal
+}  // namespace stratum
@@ -0,0 +1,116 @@
+// Copyright 2018-present Open Networking Foundation
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef STRATUM_HAL_LIB_COMMON_TELEMETRY_SNAPSHOT_H_
+#define STRATUM_HAL_LIB_COMMON_TELEMETRY_SNAPSHOT_H_
+
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
+#include "stratum/glue/integral_types.h"
+#include "stratum/glue/status/status.h"
+#include "stratum/hal/lib/common/common.pb.h"
+#include "stratum/hal/lib/common/switch_interface.h"
+#include "stratum/hal/lib/common/writer_interface.h"
+
+namespace stratum {
+namespace hal {
+
+// TelemetrySnapshot coalesces the SwitchInterface::RetrieveValue() calls made
+// by the leaf handlers of a periodic gNMI subscription while processing one
+// timer tick. Within a tick, identical requests are sent to the switch only
+// once and the cached DataResponse is fanned out to all the leaves asking for
+// it (e.g. the ~14 leaves under /interfaces/interface/state/counters all share
+// a single port_counters request per port).
+//
+// The snapshot also remembers which requests were made during the last tick.
+// At the beginning of the next tick, those requests are sent upfront in a
+// single batched DataRequest per node, so a steady-state subscription costs
+// one RetrieveValue() call per node per tick. Requests that were not seen
+// before (e.g. a newly added port) are retrieved on demand and picked up by the
+// batch of the following tick.
+//
+// This class is not thread-safe; it is expected to be used from within the
+// timer handler of a single subscription, which the GnmiPublisher serializes.
+class TelemetrySnapshot {
+ public:
+  explicit TelemetrySnapshot(SwitchInterface* switch_interface);
+  virtual ~TelemetrySnapshot() {}
+
+  // Starts a new tick: drops all the responses cached in the previous tick and
+  // prefetches the requests made during it.
+  void BeginTick();
+
+  // Ends the current tick. Outside of a tick all the requests are passed
+  // through to the switch.
+  void EndTick();
+
+  // Same contract as SwitchInterface::RetrieveValue(). Responses to requests
+  // already retrieved in the current tick are served from the snapshot.
+  ::util::Status RetrieveValue(uint64 node_id, const DataRequest& request,
+                               WriterInterface<DataResponse>* writer,
+                               std::vector<::util::Status>* details);
+
+  // Returns the number of RetrieveValue() calls issued to the switch since the
+  // snapshot was created. Used to monitor the efficiency of the coalescing.
+  uint64 GetNumSwitchCalls() const { return num_switch_calls_; }
+
+  // Returns the number of single requests served from the snapshot instead of
+  // being sent to the switch since the snapshot was created.
+  uint64 GetNumCacheHits() const { return num_cache_hits_; }
+
+  // TelemetrySnapshot is neither copyable nor movable.
+  TelemetrySnapshot(const TelemetrySnapshot&) = delete;
+  TelemetrySnapshot& operator=(const TelemetrySnapshot&) = delete;
+
+ private:
+  // The outcome of a single DataRequest::Request.
+  struct CachedResponse {
+    ::util::Status status;
+    std::vector<DataResponse> responses;
+  };
+
+  // Cache key: the node ID and the serialized DataRequest::Request.
+  using Key = std::pair<uint64, std::string>;
+
+  // Sends all the requests recorded in the previous tick, one batched
+  // DataRequest per node, and caches the results.
+  void Prefetch();
+
+  // Retrieves a single request from the switch and caches the result.
+  const CachedResponse& Fetch(uint64 node_id,
+                              const DataRequest::Request& request,
+                              const std::string& serialized);
+
+  // Records a request made in the current tick so it is prefetched in the
+  // next one.
+  void RecordRequest(uint64 node_id, const DataRequest::Request& request,
+                     const std::string& serialized);
+
+  // The switch the requests are forwarded to. Not owned by this class.
+  SwitchInterface* switch_interface_;
+
+  // Whether a tick is in progress.
+  bool in_tick_;
+
+  // The responses retrieved in the current tick.
+  absl::flat_hash_map<Key, CachedResponse> cache_;
+
+  // The requests made in the current tick, grouped by node ID, and the set of
+  // their keys used for deduplication.
+  std::map<uint64, DataRequest> requests_;
+  absl::flat_hash_set<Key> recorded_;
+
+  // Statistics.
+  uint64 num_switch_calls_;
+  uint64 num_cache_hits_;
+};
+
+}  // namespace hal
+}  // namespace stratum
+
+#endif  // STRATUM_HAL_LIB_COMMON_TELEMETRY_SNAPSHOT_H_
@@ -0,0 +1,174 @@
+// Copyright 2018-present Open Networking Foundation
+// SPDX-License-Identifier: Apache-2.0
+
+#include "stratum/hal/lib/common/telemetry_snapshot.h"
+
+#include <memory>
+#include <vector>
+
+#include "absl/memory/memory.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "stratum/glue/status/status_test_util.h"
+#include "stratum/hal/lib/common/switch_mock.h"
+#include "stratum/lib/macros.h"
+#include "stratum/public/lib/error.h"
+
+namespace stratum {
+namespace hal {
+
+using ::testing::_;
+using ::testing::Invoke;
+
+class TelemetrySnapshotTest : public ::testing::Test {
+ protected:
+  // A writer that saves all the responses.
+  class ResponseWriter : public WriterInterface<DataResponse> {
+   public:
+    bool Write(const DataResponse& resp) override {
+      responses.push_back(resp);
+      return true;
+    }
+    std::vector<DataResponse> responses;
+  };
+
+  void SetUp() override {
+    snapshot_ = absl::make_unique<TelemetrySnapshot>(&switch_mock_);
+    // Answers every port counters request with the port ID as in_octets and
+    // fails all other requests.
+    ON_CALL(switch_mock_, RetrieveValue(_, _, _, _))
+        .WillByDefault(Invoke([](uint64 node_id, const DataRequest& req,
+                                 WriterInterface<DataResponse>* writer,
+                                 std::vector<::util::Status>* details) {
+          for (const auto& r : req.requests()) {
+            if (!r.has_port_counters()) {
+              details->push_back(MAKE_ERROR(ERR_UNIMPLEMENTED)
+                                 << "Not supported.");
+              continue;
+            }
+            DataResponse resp;
+            resp.mutable_port_counters()->set_in_octets(
+                r.port_counters().port_id());
+            writer->Write(resp);
+            details->push_back(::util::OkStatus());
+          }
+          return ::util::OkStatus();
+        }));
+  }
+
+  // Reads the in_octets counter of a port through the snapshot.
+  uint64 ReadInOctets(uint32 port_id) {
+    DataRequest req;
+    auto* request = req.add_requests()->mutable_port_counters();
+    request->set_node_id(kNodeId);
+    request->set_port_id(port_id);
+    uint64 value = 0;
+    std::vector<::util::Status> details;
+    EXPECT_OK(snapshot_->RetrieveValue(kNodeId, req, &writer_, &details));
+    EXPECT_EQ(1U, details.size());
+    if (!writer_.responses.empty()) {
+      value = writer_.responses.back().port_counters().in_octets();
+    }
+    writer_.responses.clear();
+    return value;
+  }
+
+  static constexpr uint64 kNodeId = 1;
+  ::testing::NiceMock<SwitchMock> switch_mock_;
+  ResponseWriter writer_;
+  std::unique_ptr<TelemetrySnapshot> snapshot_;
+};
+
+constexpr uint64 TelemetrySnapshotTest::kNodeId;
+
+TEST_F(TelemetrySnapshotTest, RequestsArePassedThroughOutsideOfTick) {
+  EXPECT_CALL(switch_mock_, RetrieveValue(kNodeId, _, _, _)).Times(2);
+
+  EXPECT_EQ(1U, ReadInOctets(1));
+  EXPECT_EQ(1U, ReadInOctets(1));
+  EXPECT_EQ(2U, snapshot_->GetNumSwitchCalls());
+  EXPECT_EQ(0U, snapshot_->GetNumCacheHits());
+}
+
+TEST_F(TelemetrySnapshotTest, IdenticalRequestsAreCoalescedWithinTick) {
+  EXPECT_CALL(switch_mock_, RetrieveValue(kNodeId, _, _, _)).Times(2);
+
+  snapshot_->BeginTick();
+  for (int i = 0; i < 14; ++i) {
+    EXPECT_EQ(1U, ReadInOctets(1));
+    EXPECT_EQ(2U, ReadInOctets(2));
+  }
+  snapshot_->EndTick();
+
+  EXPECT_EQ(2U, snapshot_->GetNumSwitchCalls());
+  EXPECT_EQ(26U, snapshot_->GetNumCacheHits());
+}
+
+TEST_F(TelemetrySnapshotTest, RequestsOfPreviousTickArePrefetchedInOneBatch) {
+  // First tick: one call per distinct request.
+  snapshot_->BeginTick();
+  for (uint32 port_id = 1; port_id <= 64; ++port_id) {
+    EXPECT_EQ(port_id, ReadInOctets(port_id));
+  }
+  snapshot_->EndTick();
+  EXPECT_EQ(64U, snapshot_->GetNumSwitchCalls());
+
+  // Following ticks: a single batched call for all the ports of the node.
+  for (int tick = 0; tick < 3; ++tick) {
+    snapshot_->BeginTick();
+    for (uint32 port_id = 1; port_id <= 64; ++port_id) {
+      EXPECT_EQ(port_id, ReadInOctets(port_id));
+    }
+    snapshot_->EndTick();
+  }
+  EXPECT_EQ(64U + 3U, snapshot_->GetNumSwitchCalls());
+}
+
+TEST_F(TelemetrySnapshotTest, FailedRequestsAreReportedFromSnapshot) {
+  DataRequest req;
+  req.add_requests()->mutable_node_info()->set_node_id(kNodeId);
+  auto* request = req.add_requests()->mutable_port_counters();
+  request->set_node_id(kNodeId);
+  request->set_port_id(3);
+
+  for (int tick = 0; tick < 2; ++tick) {
+    snapshot_->BeginTick();
+    std::vector<::util::Status> details;
+    EXPECT_OK(snapshot_->RetrieveValue(kNodeId, req, &writer_, &details));
+    snapshot_->EndTick();
+    ASSERT_EQ(2U, details.size());
+    EXPECT_EQ(ERR_UNIMPLEMENTED, details[0].error_code());
+    EXPECT_OK(details[1]);
+    ASSERT_EQ(1U, writer_.responses.size());
+    EXPECT_EQ(3U, writer_.responses[0].port_counters().in_octets());
+    writer_.responses.clear();
+  }
+  // Two calls in the first tick, one batched call in the second.
+  EXPECT_EQ(3U, snapshot_->GetNumSwitchCalls());
+}
+
+TEST_F(TelemetrySnapshotTest, UnusedRequestsAreNoLongerPrefetched) {
+  snapshot_->BeginTick();
+  EXPECT_EQ(1U, ReadInOctets(1));
+  snapshot_->EndTick();
+  // The second tick prefetches port 1 but only reads port 2.
+  snapshot_->BeginTick();
+  EXPECT_EQ(2U, ReadInOctets(2));
+  snapshot_->EndTick();
+
+  DataRequest prefetched;
+  EXPECT_CALL(switch_mock_, RetrieveValue(kNodeId, _, _, _))
+      .WillOnce(Invoke([&prefetched](uint64 node_id, const DataRequest& req,
+                                     WriterInterface<DataResponse>* writer,
+                                     std::vector<::util::Status>* details) {
+        prefetched = req;
+        return ::util::OkStatus();
+      }));
+  snapshot_->BeginTick();
+  snapshot_->EndTick();
+  ASSERT_EQ(1, prefetched.requests_size());
+  EXPECT_EQ(2U, prefetched.requests(0).port_counters().port_id());
+}
+
+}  // namespace hal
+}  // namespace stratum
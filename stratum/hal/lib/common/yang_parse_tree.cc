@@ -131,6 +131,23 @@ void YangParseTree::SendNotification(const GnmiEventPtr& event) {
   }
 }
 
+::util::Status YangParseTree::RetrieveValue(
+    uint64 node_id, const DataRequest& request,
+    WriterInterface<DataResponse>* writer,
+    std::vector<::util::Status>* details) {
+  SwitchInterface* switch_interface;
+  TelemetrySnapshot* snapshot;
+  {
+    absl::WriterMutexLock r(&root_access_lock_);
+    switch_interface = switch_interface_;
+    snapshot = telemetry_snapshot_;
+  }
+  if (snapshot != nullptr) {
+    return snapshot->RetrieveValue(node_id, request, writer, details);
+  }
+  return switch_interface->RetrieveValue(node_id, request, writer, details);
+}
+
 void YangParseTree::ProcessPushedConfig(
     const ConfigHasBeenPushedEvent& change) {
   absl::WriterMutexLock r(&root_access_lock_);
@@ -213,7 +230,8 @@ bool YangParseTree::IsWildcard(const std::string& name) const {
 }
 
 YangParseTree::YangParseTree(SwitchInterface* switch_interface)
-    : switch_interface_(ABSL_DIE_IF_NULL(switch_interface)) {
+    : switch_interface_(ABSL_DIE_IF_NULL(switch_interface)),
+      telemetry_snapshot_(nullptr) {
   // Add the minimum nodes:
   //   /interfaces/interface[name=*]/state/ifindex
   //   /interfaces/interface[name=*]/state/name
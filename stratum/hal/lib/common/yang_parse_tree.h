@@ -10,6 +10,7 @@
 #include <string>
 #include <unordered_map>
 #include <utility>
+#include <vector>
 
 #include "absl/synchronization/mutex.h"
 #include "gnmi/gnmi.grpc.pb.h"
@@ -17,6 +18,7 @@
 #include "stratum/hal/lib/common/common.pb.h"
 #include "stratum/hal/lib/common/gnmi_events.h"
 #include "stratum/hal/lib/common/switch_interface.h"
+#include "stratum/hal/lib/common/telemetry_snapshot.h"
 #include "stratum/hal/lib/common/writer_interface.h"
 #include "stratum/lib/macros.h"
 
@@ -444,6 +446,23 @@ class YangParseTree {
     return switch_interface_;
   }
 
+  // Retrieves a value from the switch. Used by the leaf handlers instead of
+  // calling SwitchInterface::RetrieveValue() directly, so the requests can be
+  // served from the telemetry snapshot of the current timer tick, if any.
+  ::util::Status RetrieveValue(uint64 node_id, const DataRequest& request,
+                               WriterInterface<DataResponse>* writer,
+                               std::vector<::util::Status>* details)
+      LOCKS_EXCLUDED(root_access_lock_);
+
+  // Sets the telemetry snapshot used by RetrieveValue(). The snapshot is not
+  // owned by this class. Passing nullptr disables the snapshot.
+  void SetTelemetrySnapshot(TelemetrySnapshot* snapshot)
+      LOCKS_EXCLUDED(root_access_lock_) {
+    absl::WriterMutexLock r(&root_access_lock_);
+
+    telemetry_snapshot_ = snapshot;
+  }
+
   // A getter providing a functor setting TARGET_DEFINED mode of a leaf to be
   // STREAM:SAMPLE.
   const TreeNode::TargetDefinedModeFunc& GetStreamSampleModeFunc() {
@@ -492,6 +511,8 @@ class YangParseTree {
       GUARDED_BY(root_access_lock_);
 
   TreeNode root_ GUARDED_BY(root_access_lock_);
+  // The snapshot of the timer tick being processed, if any. Not owned.
+  TelemetrySnapshot* telemetry_snapshot_ GUARDED_BY(root_access_lock_);
   // A Mutex used to guard access to the root.
   mutable absl::Mutex root_access_lock_;
 
@@ -17,7 +17,10 @@
 #include "stratum/hal/lib/common/gnmi_publisher.h"
 #include "stratum/hal/lib/common/openconfig_converter.h"
 #include "stratum/hal/lib/common/utils.h"
+#include "stratum/lib/channel/channel_stats.h"
 #include "stratum/lib/constants.h"
+#include "stratum/lib/p4runtime/sdn_controller_manager.h"
+#include "stratum/lib/timer_daemon.h"
 #include "stratum/lib/utils.h"
 
 namespace stratum {
@@ -221,7 +224,7 @@ TreeNodeSetHandler GetOnUpdateFunctor(
 }
 
 // A family of helper methods that request a value of type U from the switch
-// using SwitchInterface::RetrieveValue() call. To do its job it requires:
+// using YangParseTree::RetrieveValue() call. To do its job it requires:
 // - a pointer to method that gets the message of type T that is part of the
 //   DataResponse protobuf and that keeps the value to be returned
 //   ('data_response_get_inner_message_func')
@@ -265,8 +268,7 @@ U GetValue(
   // Query the switch. The returned status is ignored as there is no way to
   // notify the controller that something went wrong. The error is logged when
   // it is created.
-  tree->GetSwitchInterface()
-      ->RetrieveValue(node_id, req, &writer, /* details= */ nullptr)
+  tree->RetrieveValue(node_id, req, &writer, /* details= */ nullptr)
       .IgnoreError();
   // Return the retrieved value.
   return resp;
@@ -306,8 +308,7 @@ U GetValue(
   // Query the switch. The returned status is ignored as there is no way to
   // notify the controller that something went wrong. The error is logged when
   // it is created.
-  tree->GetSwitchInterface()
-      ->RetrieveValue(node_id, req, &writer, /* details= */ nullptr)
+  tree->RetrieveValue(node_id, req, &writer, /* details= */ nullptr)
       .IgnoreError();
   // Return the retrieved value.
   return resp;
@@ -341,8 +342,7 @@ U GetValue(
   // Query the switch. The returned status is ignored as there is no way to
   // notify the controller that something went wrong. The error is logged when
   // it is created.
-  tree->GetSwitchInterface()
-      ->RetrieveValue(/* node_id= */ 0, req, &writer, /* details= */ nullptr)
+  tree->RetrieveValue(/* node_id= */ 0, req, &writer, /* details= */ nullptr)
       .IgnoreError();
   // Return the retrieved value.
   return resp;
@@ -377,8 +377,7 @@ U GetValue(
   // Query the switch. The returned status is ignored as there is no way to
   // notify the controller that something went wrong. The error is logged when
   // it is created.
-  tree->GetSwitchInterface()
-      ->RetrieveValue(node_id, req, &writer, /* details= */ nullptr)
+  tree->RetrieveValue(node_id, req, &writer, /* details= */ nullptr)
       .IgnoreError();
   // Return the retrieved value.
   return resp;
@@ -422,8 +421,7 @@ U GetValue(
   // Query the switch. The returned status is ignored as there is no way to
   // notify the controller that something went wrong. The error is logged when
   // it is created.
-  tree->GetSwitchInterface()
-      ->RetrieveValue(node_id, req, &writer, /* details= */ nullptr)
+  tree->RetrieveValue(node_id, req, &writer, /* details= */ nullptr)
       .IgnoreError();
   // Return the retrieved value.
   return resp;
@@ -512,8 +510,7 @@ TreeNodeEventHandler GetOnPollFunctor(
     // notify the controller that something went wrong. The error is logged when
     // it is created.
     // Here we ignore the node_id since it is not valid in this case.
-    tree->GetSwitchInterface()
-        ->RetrieveValue(/*node_id*/ 0, req, &writer, /* details= */ nullptr)
+    tree->RetrieveValue(/*node_id*/ 0, req, &writer, /* details= */ nullptr)
         .IgnoreError();
     // Return the retrieved value.
     T value = (resp.*inner_message_get_field_func)();
@@ -550,8 +547,7 @@ TreeNodeEventHandler GetOnPollFunctor(
     // notify the controller that something went wrong. The error is logged when
     // it is created.
     // Here we ignore the node_id since it is not valid in this case.
-    tree->GetSwitchInterface()
-        ->RetrieveValue(/*node_id*/ 0, req, &writer, /* details= */ nullptr)
+    tree->RetrieveValue(/*node_id*/ 0, req, &writer, /* details= */ nullptr)
         .IgnoreError();
     // Return the retrieved value. Note that we will return a default value if
     // the second level nest message does not exists.
@@ -1720,8 +1716,8 @@ TreeNodeEventHandler GetPollCounterFunctor(uint64 node_id, uint32 port_id,
     // Query the switch. The returned status is ignored as there is no way to
     // notify the controller that something went wrong. The error is logged when
     // it is created.
-    auto status = tree->GetSwitchInterface()->RetrieveValue(
-        node_id, req, &writer, /* details= */ nullptr);
+    auto status =
+        tree->RetrieveValue(node_id, req, &writer, /* details= */ nullptr);
     return SendResponse(GetResponse(path, resp), stream);
   };
 }
@@ -2110,8 +2106,7 @@ void SetUpComponentsComponentChassisAlarmsMemoryErrorInfo(TreeNode* node,
     // Query the switch. The returned status is ignored as there is no way to
     // notify the controller that something went wrong. The error is logged when
     // it is created.
-    tree->GetSwitchInterface()
-        ->RetrieveValue(/* node_id= */ 0, req, &writer, /* details= */ nullptr)
+    tree->RetrieveValue(/* node_id= */ 0, req, &writer, /* details= */ nullptr)
         .IgnoreError();
     return SendResponse(GetResponse(path, resp), stream);
   };
@@ -2213,8 +2208,7 @@ void SetUpComponentsComponentChassisAlarmsFlowProgrammingExceptionInfo(
     // Query the switch. The returned status is ignored as there is no way to
     // notify the controller that something went wrong. The error is logged when
     // it is created.
-    tree->GetSwitchInterface()
-        ->RetrieveValue(/* node_id= */ 0, req, &writer, /* details= */ nullptr)
+    tree->RetrieveValue(/* node_id= */ 0, req, &writer, /* details= */ nullptr)
         .IgnoreError();
     return SendResponse(GetResponse(path, resp), stream);
   };
@@ -2290,8 +2284,7 @@ void SetUpComponentsComponentTransceiverStateSerialNo(TreeNode* node,
     // Query the switch. The returned status is ignored as there is no
     // way to notify the controller that something went wrong.
     // The error is logged when it is created.
-    tree->GetSwitchInterface()
-        ->RetrieveValue(node_id, req, &writer, /* details= */ nullptr)
+    tree->RetrieveValue(node_id, req, &writer, /* details= */ nullptr)
         .IgnoreError();
     return SendResponse(GetResponse(path, resp), stream);
   };
@@ -2328,8 +2321,7 @@ void SetUpComponentsComponentTransceiverStateVendor(TreeNode* node,
     // Query the switch. The returned status is ignored as there is no way to
     // notify the controller that something went wrong. The error is
     // logged when it is created.
-    tree->GetSwitchInterface()
-        ->RetrieveValue(node_id, req, &writer, /* details= */ nullptr)
+    tree->RetrieveValue(node_id, req, &writer, /* details= */ nullptr)
         .IgnoreError();
     return SendResponse(GetResponse(path, resp), stream);
   };
@@ -2366,8 +2358,7 @@ void SetUpComponentsComponentTransceiverStateVendorPart(TreeNode* node,
     // Query the switch. The returned status is ignored as there is no
     // way to notify the controller that something went wrong.
     // The error is logged when it is created.
-    tree->GetSwitchInterface()
-        ->RetrieveValue(node_id, req, &writer, /* details= */ nullptr)
+    tree->RetrieveValue(node_id, req, &writer, /* details= */ nullptr)
         .IgnoreError();
     return SendResponse(GetResponse(path, resp), stream);
   };
@@ -3012,8 +3003,7 @@ void SetUpComponentsComponentStatePartNo(uint64 node_id, TreeNode* node,
     // Query the switch. The returned status is ignored as there is no way to
     // notify the controller that something went wrong. The error is logged when
     // it is created.
-    tree->GetSwitchInterface()
-        ->RetrieveValue(node_id, req, &writer, /* details= */ nullptr)
+    tree->RetrieveValue(node_id, req, &writer, /* details= */ nullptr)
         .IgnoreError();
     return SendResponse(GetResponse(path, resp), stream);
   };
@@ -3045,8 +3035,7 @@ void SetUpComponentsComponentStateMfgName(uint64 node_id, TreeNode* node,
     // Query the switch. The returned status is ignored as there is no way to
     // notify the controller that something went wrong. The error is logged when
     // it is created.
-    tree->GetSwitchInterface()
-        ->RetrieveValue(node_id, req, &writer, /* details= */ nullptr)
+    tree->RetrieveValue(node_id, req, &writer, /* details= */ nullptr)
         .IgnoreError();
     return SendResponse(GetResponse(path, resp), stream);
   };
@@ -3215,8 +3204,7 @@ void SetUpDebugNodesNodePacketIoDebugString(uint64 node_id, TreeNode* node,
     // Query the switch. The returned status is ignored as there is no way to
     // notify the controller that something went wrong. The error is logged when
     // it is created.
-    tree->GetSwitchInterface()
-        ->RetrieveValue(node_id, req, &writer, /* details= */ nullptr)
+    tree->RetrieveValue(node_id, req, &writer, /* details= */ nullptr)
         .IgnoreError();
     return SendResponse(GetResponse(path, resp), stream);
   };
@@ -3337,6 +3325,47 @@ void SetUpSystemLoggingConsoleStateSeverity(TreeNode* node,
       ->SetOnChangeHandler(on_change_functor);
 }
 
+////////////////////////////////////////////////////////////////////////////////
+// /debug/channels/debug-string
+void SetUpDebugChannelsDebugString(TreeNode* node) {
+  auto poll_functor = [](const GnmiEvent& event, const ::gnmi::Path& path,
+                         GnmiSubscribeStream* stream) {
+    return SendResponse(GetResponse(path, ChannelStats::DumpAll()), stream);
+  };
+  auto on_change_functor = UnsupportedFunc();
+  node->SetOnTimerHandler(poll_functor)
+      ->SetOnPollHandler(poll_functor)
+      ->SetOnChangeHandler(on_change_functor);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// /debug/p4rt/send-queues/debug-string
+void SetUpDebugP4rtSendQueuesDebugString(TreeNode* node) {
+  auto poll_functor = [](const GnmiEvent& event, const ::gnmi::Path& path,
+                         GnmiSubscribeStream* stream) {
+    return SendResponse(
+        GetResponse(path, p4runtime::SdnConnection::SendQueue::DumpAll()),
+        stream);
+  };
+  auto on_change_functor = UnsupportedFunc();
+  node->SetOnTimerHandler(poll_functor)
+      ->SetOnPollHandler(poll_functor)
+      ->SetOnChangeHandler(on_change_functor);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// /debug/timers/debug-string
+void SetUpDebugTimersDebugString(TreeNode* node) {
+  auto poll_functor = [](const GnmiEvent& event, const ::gnmi::Path& path,
+                         GnmiSubscribeStream* stream) {
+    return SendResponse(GetResponse(path, TimerDaemon::DumpStats()), stream);
+  };
+  auto on_change_functor = UnsupportedFunc();
+  node->SetOnTimerHandler(poll_functor)
+      ->SetOnPollHandler(poll_functor)
+      ->SetOnChangeHandler(on_change_functor);
+}
+
 }  // namespace
 
 // Path of leafs created by this method are defined 'manualy' by analysing
@@ -3860,6 +3889,13 @@ void YangParseTreePaths::AddSubtreeSystem(YangParseTree* tree) {
   node = tree->AddNode(
       GetPath("system")("logging")("console")("state")("severity")());
   SetUpSystemLoggingConsoleStateSeverity(node, tree);
+  node = tree->AddNode(GetPath("debug")("channels")("debug-string")());
+  SetUpDebugChannelsDebugString(node);
+  node = tree->AddNode(
+      GetPath("debug")("p4rt")("send-queues")("debug-string")());
+  SetUpDebugP4rtSendQueuesDebugString(node);
+  node = tree->AddNode(GetPath("debug")("timers")("debug-string")());
+  SetUpDebugTimersDebugString(node);
 }
 
 void YangParseTreePaths::AddSubtreeAllInterfaces(YangParseTree* tree) {
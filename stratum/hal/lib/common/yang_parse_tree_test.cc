@@ -16,7 +16,9 @@
 #include "stratum/hal/lib/common/utils.h"
 #include "stratum/hal/lib/common/writer_mock.h"
 #include "stratum/hal/lib/common/yang_parse_tree_mock.h"
+#include "stratum/lib/channel/channel.h"
 #include "stratum/lib/constants.h"
+#include "stratum/lib/p4runtime/sdn_controller_manager.h"
 #include "stratum/lib/test_utils/matchers.h"
 #include "stratum/lib/utils.h"
 
@@ -3435,6 +3437,57 @@ TEST_F(YangParseTreeTest, DebugNodesNodePacketIoDebugStringOnPollSuccess) {
   EXPECT_EQ(resp.update().update(0).val().string_val(), kTestString);
 }
 
+// Check if /debug/channels/debug-string OnPoll action works correctly.
+TEST_F(YangParseTreeTest, DebugChannelsDebugStringOnPollSuccess) {
+  auto path = GetPath("debug")("channels")("debug-string")();
+  auto channel = Channel<int>::Create(4, "test-channel");
+
+  // Call the event handler. 'resp' will contain the message that is sent to the
+  // controller.
+  ::gnmi::SubscribeResponse resp;
+  EXPECT_OK(ExecuteOnPoll(path, &resp));
+
+  // Check that the result of the call is what is expected.
+  ASSERT_EQ(resp.update().update_size(), 1);
+  EXPECT_THAT(resp.update().update(0).val().string_val(),
+              HasSubstr("test-channel: depth 0/4"));
+}
+
+// Check if /debug/p4rt/send-queues/debug-string OnPoll action works correctly.
+TEST_F(YangParseTreeTest, DebugP4rtSendQueuesDebugStringOnPollSuccess) {
+  auto path = GetPath("debug")("p4rt")("send-queues")("debug-string")();
+  p4runtime::SendQueueOptions options;
+  options.max_depth = 8;
+  p4runtime::SdnConnection::SendQueue queue(nullptr, options);
+  queue.SetName("test-connection");
+
+  // Call the event handler. 'resp' will contain the message that is sent to the
+  // controller.
+  ::gnmi::SubscribeResponse resp;
+  EXPECT_OK(ExecuteOnPoll(path, &resp));
+
+  // Check that the result of the call is what is expected.
+  ASSERT_EQ(resp.update().update_size(), 1);
+  EXPECT_THAT(resp.update().update(0).val().string_val(),
+              HasSubstr("test-connection: depth 0/8 (high-water 0), 0 sent, "
+                        "0 dropped, 0 write failures"));
+}
+
+// Check if /debug/timers/debug-string OnPoll action works correctly.
+TEST_F(YangParseTreeTest, DebugTimersDebugStringOnPollSuccess) {
+  auto path = GetPath("debug")("timers")("debug-string")();
+
+  // Call the event handler. 'resp' will contain the message that is sent to the
+  // controller.
+  ::gnmi::SubscribeResponse resp;
+  EXPECT_OK(ExecuteOnPoll(path, &resp));
+
+  // Check that the result of the call is what is expected.
+  ASSERT_EQ(resp.update().update_size(), 1);
+  EXPECT_THAT(resp.update().update(0).val().string_val(),
+              HasSubstr(" executions, "));
+}
+
 // Check if the '/components/component/optical-channel/config/frequency'
 // OnUpdate action works correctly.
 TEST_F(YangParseTreeOpticalChannelTest,
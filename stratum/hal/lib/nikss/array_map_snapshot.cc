@@ -0,0 +1,71 @@
+#include "stratum/hal/lib/nikss/array_map_snapshot.h"
+
+#include <string.h>
+
+#include "stratum/glue/status/status_macros.h"
+#include "stratum/lib/macros.h"
+#include "stratum/public/proto/error.pb.h"
+
+namespace stratum {
+namespace hal {
+namespace nikss {
+
+namespace {
+
+// Reads an unsigned counter field of the given width in host order.
+uint64 ReadCounterField(const uint8* data, size_t width) {
+  if (width == sizeof(uint32)) {
+    uint32 value;
+    memcpy(&value, data, sizeof(value));
+    return value;
+  }
+  uint64 value;
+  memcpy(&value, data, sizeof(value));
+  return value;
+}
+
+}  // namespace
+
+::util::Status ArrayMapSnapshotToCounterData(
+    const ArrayMapSnapshot& snapshot, size_t value_size, size_t size,
+    ::p4::config::v1::CounterSpec::Unit unit,
+    std::vector<::p4::v1::CounterData>* cells) {
+  const bool both = unit == ::p4::config::v1::CounterSpec::BOTH;
+  const size_t field_width = both ? value_size / 2 : value_size;
+  RET_CHECK(field_width == sizeof(uint32) || field_width == sizeof(uint64))
+      << "Unexpected counter value size " << value_size << ".";
+  cells->assign(size, ::p4::v1::CounterData());
+  for (size_t i = 0; i < snapshot.count; ++i) {
+    RET_CHECK(snapshot.keys[i] < size);
+    uint64 first = 0;
+    uint64 second = 0;
+    for (size_t cpu = 0; cpu < snapshot.num_values; ++cpu) {
+      const uint8* value = snapshot.value(i, cpu);
+      first += ReadCounterField(value, field_width);
+      if (both) second += ReadCounterField(value + field_width, field_width);
+    }
+    auto& cell = (*cells)[snapshot.keys[i]];
+    switch (unit) {
+      case ::p4::config::v1::CounterSpec::BYTES:
+        cell.set_byte_count(first);
+        break;
+      case ::p4::config::v1::CounterSpec::PACKETS:
+        cell.set_packet_count(first);
+        break;
+      case ::p4::config::v1::CounterSpec::BOTH:
+        cell.set_byte_count(first);
+        cell.set_packet_count(second);
+        break;
+      default:
+        return MAKE_ERROR(ERR_INVALID_PARAM)
+               << "Unsupported counter unit "
+               << ::p4::config::v1::CounterSpec::Unit_Name(unit) << ".";
+    }
+  }
+
+  return ::util::OkStatus();
+}
+
+}  // namespace nikss
+}  // namespace hal
+}  // namespace stratum
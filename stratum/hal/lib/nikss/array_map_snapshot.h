@@ -0,0 +1,44 @@
+#ifndef STRATUM_HAL_LIB_NIKSS_ARRAY_MAP_SNAPSHOT_H_
+#define STRATUM_HAL_LIB_NIKSS_ARRAY_MAP_SNAPSHOT_H_
+
+#include <stddef.h>
+
+#include <vector>
+
+#include "p4/config/v1/p4info.pb.h"
+#include "p4/v1/p4runtime.pb.h"
+#include "stratum/glue/integral_types.h"
+#include "stratum/glue/status/status.h"
+
+namespace stratum {
+namespace hal {
+namespace nikss {
+
+// Values of all cells of a BPF array map.
+struct ArrayMapSnapshot {
+  std::vector<uint32> keys;
+  std::vector<uint8> values;
+  size_t count;         // Number of cells read.
+  size_t num_values;    // Values per cell, the number of CPUs of per-CPU maps.
+  size_t value_stride;  // Distance between the values of a cell.
+
+  // Returns the value of the i-th cell read on the given CPU.
+  const uint8* value(size_t i, size_t cpu) const {
+    return &values[(i * num_values + cpu) * value_stride];
+  }
+};
+
+// Converts the snapshot of an indirect counter with 'size' cells of
+// 'value_size' bytes into the counter data of every cell. The values of
+// per-CPU maps are summed up. A counter of both bytes and packets stores the
+// bytes first.
+::util::Status ArrayMapSnapshotToCounterData(
+    const ArrayMapSnapshot& snapshot, size_t value_size, size_t size,
+    ::p4::config::v1::CounterSpec::Unit unit,
+    std::vector<::p4::v1::CounterData>* cells);
+
+}  // namespace nikss
+}  // namespace hal
+}  // namespace stratum
+
+#endif  // STRATUM_HAL_LIB_NIKSS_ARRAY_MAP_SNAPSHOT_H_
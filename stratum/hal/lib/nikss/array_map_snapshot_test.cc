@@ -0,0 +1,118 @@
+#include "stratum/hal/lib/nikss/array_map_snapshot.h"
+
+#include <string.h>
+
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "p4/v1/p4runtime.pb.h"
+#include "stratum/glue/integral_types.h"
+#include "stratum/glue/status/status_test_util.h"
+#include "stratum/lib/test_utils/matchers.h"
+
+namespace stratum {
+namespace hal {
+namespace nikss {
+
+using test_utils::EqualsProto;
+using ::testing::ElementsAre;
+
+namespace {
+
+// Returns a snapshot of the given cells with 'num_values' values of
+// 'value_stride' bytes each.
+ArrayMapSnapshot MakeSnapshot(const std::vector<uint32>& keys,
+                              size_t num_values, size_t value_stride) {
+  ArrayMapSnapshot snapshot;
+  snapshot.keys = keys;
+  snapshot.count = keys.size();
+  snapshot.num_values = num_values;
+  snapshot.value_stride = value_stride;
+  snapshot.values.assign(keys.size() * num_values * value_stride, 0);
+  return snapshot;
+}
+
+// Stores a field of the given type at 'offset' of a value of a cell.
+template <typename T>
+void SetField(ArrayMapSnapshot* snapshot, size_t i, size_t cpu, size_t offset,
+              T field) {
+  memcpy(const_cast<uint8*>(snapshot->value(i, cpu)) + offset, &field,
+         sizeof(field));
+}
+
+::p4::v1::CounterData MakeCounterData(uint64 byte_count,
+                                      uint64 packet_count) {
+  ::p4::v1::CounterData data;
+  data.set_byte_count(byte_count);
+  data.set_packet_count(packet_count);
+  return data;
+}
+
+}  // namespace
+
+TEST(ArrayMapSnapshotTest, PerCpuBytesAndPacketsAreSummedUp) {
+  // Bytes precede the packets of a cell, per-CPU values are padded to 8 bytes.
+  ArrayMapSnapshot snapshot = MakeSnapshot({0, 2}, 3, 16);
+  for (size_t cpu = 0; cpu < 3; ++cpu) {
+    SetField<uint64>(&snapshot, 0, cpu, 0, 100 * (cpu + 1));
+    SetField<uint64>(&snapshot, 0, cpu, 8, cpu + 1);
+    SetField<uint64>(&snapshot, 1, cpu, 0, 1000);
+    SetField<uint64>(&snapshot, 1, cpu, 8, 10);
+  }
+  std::vector<::p4::v1::CounterData> cells;
+  ASSERT_OK(ArrayMapSnapshotToCounterData(
+      snapshot, 16, 4, ::p4::config::v1::CounterSpec::BOTH, &cells));
+  // Cells which have not been read stay zero.
+  EXPECT_THAT(cells, ElementsAre(EqualsProto(MakeCounterData(600, 6)),
+                                 EqualsProto(::p4::v1::CounterData()),
+                                 EqualsProto(MakeCounterData(3000, 30)),
+                                 EqualsProto(::p4::v1::CounterData())));
+}
+
+TEST(ArrayMapSnapshotTest, NarrowBytesAndPackets) {
+  ArrayMapSnapshot snapshot = MakeSnapshot({1}, 2, 8);
+  SetField<uint32>(&snapshot, 0, 0, 0, 64);
+  SetField<uint32>(&snapshot, 0, 0, 4, 1);
+  SetField<uint32>(&snapshot, 0, 1, 0, 128);
+  SetField<uint32>(&snapshot, 0, 1, 4, 2);
+  std::vector<::p4::v1::CounterData> cells;
+  ASSERT_OK(ArrayMapSnapshotToCounterData(
+      snapshot, 8, 2, ::p4::config::v1::CounterSpec::BOTH, &cells));
+  EXPECT_THAT(cells, ElementsAre(EqualsProto(::p4::v1::CounterData()),
+                                 EqualsProto(MakeCounterData(192, 3))));
+}
+
+TEST(ArrayMapSnapshotTest, SingleUnitCounters) {
+  // A shared array map holds one value per cell.
+  ArrayMapSnapshot snapshot = MakeSnapshot({0}, 1, 4);
+  SetField<uint32>(&snapshot, 0, 0, 0, 7);
+  std::vector<::p4::v1::CounterData> cells;
+  ASSERT_OK(ArrayMapSnapshotToCounterData(
+      snapshot, 4, 1, ::p4::config::v1::CounterSpec::PACKETS, &cells));
+  EXPECT_THAT(cells, ElementsAre(EqualsProto(MakeCounterData(0, 7))));
+  ASSERT_OK(ArrayMapSnapshotToCounterData(
+      snapshot, 4, 1, ::p4::config::v1::CounterSpec::BYTES, &cells));
+  EXPECT_THAT(cells, ElementsAre(EqualsProto(MakeCounterData(7, 0))));
+}
+
+TEST(ArrayMapSnapshotTest, InvalidSnapshots) {
+  ArrayMapSnapshot snapshot = MakeSnapshot({0}, 1, 6);
+  std::vector<::p4::v1::CounterData> cells;
+  EXPECT_FALSE(ArrayMapSnapshotToCounterData(
+                   snapshot, 6, 1, ::p4::config::v1::CounterSpec::BOTH, &cells)
+                   .ok());
+  snapshot = MakeSnapshot({2}, 1, 8);
+  EXPECT_FALSE(ArrayMapSnapshotToCounterData(
+                   snapshot, 8, 2, ::p4::config::v1::CounterSpec::BYTES,
+                   &cells)
+                   .ok());
+  EXPECT_FALSE(ArrayMapSnapshotToCounterData(
+                   snapshot, 8, 4,
+                   ::p4::config::v1::CounterSpec::UNSPECIFIED, &cells)
+                   .ok());
+}
+
+}  // namespace nikss
+}  // namespace hal
+}  // namespace stratum
@@ -0,0 +1,90 @@
+#ifndef STRATUM_HAL_LIB_NIKSS_CHUNKED_READ_RESPONSE_WRITER_H_
+#define STRATUM_HAL_LIB_NIKSS_CHUNKED_READ_RESPONSE_WRITER_H_
+
+#include <stddef.h>
+
+#include <memory>
+
+#include "google/protobuf/io/coded_stream.h"
+#include "p4/v1/p4runtime.pb.h"
+#include "stratum/hal/lib/common/writer_interface.h"
+
+namespace stratum {
+namespace hal {
+namespace nikss {
+
+// ChunkedReadResponseWriter collects P4Runtime entities of type R (e.g.
+// ::p4::v1::TableEntry) into a ReadResponse and streams it to the underlying
+// writer before an entity would make its serialized size exceed
+// max_chunk_bytes. Only an entity larger than max_chunk_bytes on its own is
+// sent in a bigger ReadResponse, holding just that entity. Reading a large map
+// therefore never materializes more than one chunk in memory and never
+// produces a message exceeding the gRPC limits. Flush() must be called once
+// all entities have been written.
+template <typename R>
+class ChunkedReadResponseWriter : public WriterInterface<R> {
+ public:
+  ChunkedReadResponseWriter(WriterInterface<::p4::v1::ReadResponse>* writer,
+                            R* (::p4::v1::Entity::*get_mutable_entity)(),
+                            size_t max_chunk_bytes)
+      : writer_(writer),
+        get_mutable_entity_(get_mutable_entity),
+        max_chunk_bytes_(max_chunk_bytes),
+        chunk_bytes_(0),
+        num_chunks_(0),
+        ok_(true) {}
+
+  bool Write(const R& msg) override {
+    if (!ok_) return false;
+    auto* entity = response_.add_entities();
+    *(entity->*get_mutable_entity_)() = msg;
+    // Each entity is a length-delimited field (one byte tag) of the response.
+    const size_t entity_bytes = entity->ByteSizeLong();
+    const size_t field_bytes =
+        1 +
+        ::google::protobuf::io::CodedOutputStream::VarintSize64(entity_bytes) +
+        entity_bytes;
+    if (chunk_bytes_ > 0 && chunk_bytes_ + field_bytes > max_chunk_bytes_) {
+      // The entity does not fit, it starts the next chunk.
+      std::unique_ptr<::p4::v1::Entity> next(
+          response_.mutable_entities()->ReleaseLast());
+      if (!Flush()) return false;
+      response_.mutable_entities()->AddAllocated(next.release());
+    }
+    chunk_bytes_ += field_bytes;
+    return true;
+  }
+
+  // Streams the pending chunk, if any. Returns false if the underlying writer
+  // failed, now or for any previous chunk.
+  bool Flush() {
+    if (!ok_) return false;
+    if (response_.entities_size() == 0) return true;
+    ok_ = writer_->Write(response_);
+    ++num_chunks_;
+    response_.Clear();
+    chunk_bytes_ = 0;
+    return ok_;
+  }
+
+  // Returns the number of ReadResponses streamed so far.
+  size_t num_chunks() const { return num_chunks_; }
+
+ private:
+  // Underlying writer. Not owned by this class.
+  WriterInterface<::p4::v1::ReadResponse>* writer_;
+  R* (::p4::v1::Entity::*get_mutable_entity_)();
+  const size_t max_chunk_bytes_;
+
+  // The chunk being filled. Reused across chunks to keep its allocations.
+  ::p4::v1::ReadResponse response_;
+  size_t chunk_bytes_;
+  size_t num_chunks_;
+  bool ok_;
+};
+
+}  // namespace nikss
+}  // namespace hal
+}  // namespace stratum
+
+#endif  // STRATUM_HAL_LIB_NIKSS_CHUNKED_READ_RESPONSE_WRITER_H_
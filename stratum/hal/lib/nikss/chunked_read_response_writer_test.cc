@@ -0,0 +1,181 @@
+#include "stratum/hal/lib/nikss/chunked_read_response_writer.h"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "stratum/glue/integral_types.h"
+#include "stratum/glue/logging.h"
+#include "stratum/hal/lib/common/writer_mock.h"
+
+namespace stratum {
+namespace hal {
+namespace nikss {
+
+using ::testing::_;
+using ::testing::Return;
+
+namespace {
+
+// Writer keeping track of the streamed ReadResponses.
+class ReadResponseCollector : public WriterInterface<::p4::v1::ReadResponse> {
+ public:
+  bool Write(const ::p4::v1::ReadResponse& resp) override {
+    ++num_responses_;
+    num_entities_ += resp.entities_size();
+    max_response_bytes_ = std::max(max_response_bytes_, resp.ByteSizeLong());
+    return true;
+  }
+
+  size_t num_responses_ = 0;
+  size_t num_entities_ = 0;
+  size_t max_response_bytes_ = 0;
+};
+
+// Builds a table entry resembling an ACL entry with a ternary IPv4 key.
+::p4::v1::TableEntry MakeTableEntry(uint32 i) {
+  ::p4::v1::TableEntry entry;
+  entry.set_table_id(33554433);
+  entry.set_priority(10);
+  auto* match = entry.add_match();
+  match->set_field_id(1);
+  match->mutable_ternary()->set_value(
+      std::string({static_cast<char>(10), static_cast<char>(i >> 16),
+                   static_cast<char>(i >> 8), static_cast<char>(i)}));
+  match->mutable_ternary()->set_mask("\xff\xff\xff\xff");
+  auto* action = entry.mutable_action()->mutable_action();
+  action->set_action_id(16777217);
+  auto* param = action->add_params();
+  param->set_param_id(1);
+  param->set_value("\x01");
+  return entry;
+}
+
+constexpr size_t kChunkBytes = 64 * 1024;
+
+}  // namespace
+
+TEST(ChunkedReadResponseWriterTest, SmallReadIsSentAsSingleResponse) {
+  ReadResponseCollector collector;
+  ChunkedReadResponseWriter<::p4::v1::TableEntry> writer(
+      &collector, &::p4::v1::Entity::mutable_table_entry, kChunkBytes);
+  for (uint32 i = 0; i < 10; ++i) {
+    ASSERT_TRUE(writer.Write(MakeTableEntry(i)));
+  }
+  EXPECT_EQ(0u, collector.num_responses_);
+  ASSERT_TRUE(writer.Flush());
+  EXPECT_EQ(1u, collector.num_responses_);
+  EXPECT_EQ(10u, collector.num_entities_);
+  EXPECT_EQ(1u, writer.num_chunks());
+}
+
+TEST(ChunkedReadResponseWriterTest, EmptyReadSendsNothing) {
+  ReadResponseCollector collector;
+  ChunkedReadResponseWriter<::p4::v1::TableEntry> writer(
+      &collector, &::p4::v1::Entity::mutable_table_entry, kChunkBytes);
+  ASSERT_TRUE(writer.Flush());
+  EXPECT_EQ(0u, collector.num_responses_);
+}
+
+TEST(ChunkedReadResponseWriterTest, LargeReadIsSplitIntoBoundedResponses) {
+  ReadResponseCollector collector;
+  ChunkedReadResponseWriter<::p4::v1::TableEntry> writer(
+      &collector, &::p4::v1::Entity::mutable_table_entry, kChunkBytes);
+  const uint32 kNumEntries = 10000;
+  for (uint32 i = 0; i < kNumEntries; ++i) {
+    ASSERT_TRUE(writer.Write(MakeTableEntry(i)));
+  }
+  ASSERT_TRUE(writer.Flush());
+  EXPECT_EQ(kNumEntries, collector.num_entities_);
+  EXPECT_GT(collector.num_responses_, 1u);
+  // A chunk is sent before the next entity would exceed the limit.
+  EXPECT_LE(collector.max_response_bytes_, kChunkBytes);
+}
+
+TEST(ChunkedReadResponseWriterTest, WriterFailureIsSticky) {
+  WriterMock<::p4::v1::ReadResponse> writer_mock;
+  EXPECT_CALL(writer_mock, Write(_)).WillOnce(Return(false));
+  ChunkedReadResponseWriter<::p4::v1::TableEntry> writer(
+      &writer_mock, &::p4::v1::Entity::mutable_table_entry, 1);
+  // The first entity is only sent once the second one does not fit.
+  EXPECT_TRUE(writer.Write(MakeTableEntry(0)));
+  EXPECT_FALSE(writer.Write(MakeTableEntry(1)));
+  EXPECT_FALSE(writer.Write(MakeTableEntry(2)));
+  EXPECT_FALSE(writer.Flush());
+}
+
+TEST(ChunkedReadResponseWriterTest, ChunkSizeBoundsEveryResponse) {
+  const uint32 kNumEntries = 2000;
+  ::p4::v1::ReadResponse single;
+  *single.add_entities()->mutable_table_entry() = MakeTableEntry(0);
+  for (size_t chunk_bytes : {1, 1024, 16 * 1024}) {
+    ReadResponseCollector collector;
+    ChunkedReadResponseWriter<::p4::v1::TableEntry> writer(
+        &collector, &::p4::v1::Entity::mutable_table_entry, chunk_bytes);
+    for (uint32 i = 0; i < kNumEntries; ++i) {
+      ASSERT_TRUE(writer.Write(MakeTableEntry(i)));
+    }
+    ASSERT_TRUE(writer.Flush());
+    EXPECT_EQ(kNumEntries, collector.num_entities_);
+    EXPECT_EQ(collector.num_responses_, writer.num_chunks());
+    EXPECT_LE(collector.max_response_bytes_,
+              std::max(chunk_bytes, single.ByteSizeLong()));
+    if (chunk_bytes > single.ByteSizeLong()) {
+      // Every chunk but the last one is filled up to less than one entity
+      // below the limit.
+      EXPECT_LE(collector.num_responses_,
+                kNumEntries * single.ByteSizeLong() /
+                        (chunk_bytes - single.ByteSizeLong()) +
+                    1);
+    }
+  }
+  // A limit smaller than an entity sends every entity on its own.
+  ReadResponseCollector collector;
+  ChunkedReadResponseWriter<::p4::v1::TableEntry> writer(
+      &collector, &::p4::v1::Entity::mutable_table_entry, 1);
+  for (uint32 i = 0; i < 10; ++i) {
+    ASSERT_TRUE(writer.Write(MakeTableEntry(i)));
+  }
+  ASSERT_TRUE(writer.Flush());
+  EXPECT_EQ(10u, collector.num_responses_);
+}
+
+// Read benchmark: streams a 500k entry ACL table through the chunked writer
+// for a few chunk sizes, checks that no response exceeds the chunk size and
+// reports the throughput.
+TEST(ChunkedReadResponseWriterTest, ReadBenchmark) {
+  const uint32 kNumEntries = 500000;
+  std::vector<::p4::v1::TableEntry> entries;
+  entries.reserve(kNumEntries);
+  for (uint32 i = 0; i < kNumEntries; ++i) {
+    entries.push_back(MakeTableEntry(i));
+  }
+  for (size_t chunk_bytes : {64 * 1024, 1024 * 1024, 4 * 1024 * 1024}) {
+    ReadResponseCollector collector;
+    ChunkedReadResponseWriter<::p4::v1::TableEntry> writer(
+        &collector, &::p4::v1::Entity::mutable_table_entry, chunk_bytes);
+    const absl::Time start = absl::Now();
+    for (const auto& entry : entries) {
+      ASSERT_TRUE(writer.Write(entry));
+    }
+    ASSERT_TRUE(writer.Flush());
+    const absl::Duration elapsed = absl::Now() - start;
+    EXPECT_EQ(kNumEntries, collector.num_entities_);
+    EXPECT_EQ(collector.num_responses_, writer.num_chunks());
+    EXPECT_LE(collector.max_response_bytes_, chunk_bytes);
+    LOG(INFO) << "Chunk size " << chunk_bytes << " bytes: " << kNumEntries
+              << " entries in " << elapsed << " ("
+              << kNumEntries / absl::ToDoubleSeconds(elapsed)
+              << " entries/s), " << collector.num_responses_
+              << " responses, largest " << collector.max_response_bytes_
+              << " bytes.";
+  }
+}
+
+}  // namespace nikss
+}  // namespace hal
+}  // namespace stratum
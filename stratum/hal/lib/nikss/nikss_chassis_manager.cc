@@ -1,21 +1,650 @@
 #include "stratum/hal/lib/nikss/nikss_chassis_manager.h"
 
+#include <set>
+#include <utility>
+
+#include "absl/memory/memory.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/strip.h"
+#include "absl/time/time.h"
+#include "gflags/gflags.h"
+#include "google/protobuf/util/message_differencer.h"
+#include "stratum/glue/gtl/map_util.h"
+#include "stratum/glue/logging.h"
+#include "stratum/glue/status/status_macros.h"
+#include "stratum/hal/lib/common/constants.h"
+#include "stratum/hal/lib/common/utils.h"
+#include "stratum/lib/macros.h"
+#include "stratum/lib/utils.h"
+#include "stratum/public/proto/error.pb.h"
+
+DEFINE_int32(nikss_port_status_poll_interval_ms, 1000,
+             "Interval in milliseconds at which the oper state and the "
+             "counters of the NIKSS ports are polled.");
+
 namespace stratum {
 namespace hal {
 namespace nikss {
 
-NikssChassisManager::NikssChassisManager(
-    PhalInterface* phal_interface)
-    : initialized_(false),
-      phal_interface_(phal_interface) {
+ABSL_CONST_INIT absl::Mutex chassis_lock(absl::kConstInit);
+
+namespace {
+
+// Directory under which the kernel exposes the attributes and the statistics
+// (as reported through netlink) of every network interface.
+constexpr char kSysClassNet[] = "/sys/class/net/";
+
+// The helpers below take the directory the interfaces are looked up in, which
+// is kSysClassNet unless overridden by a test.
+bool InterfaceExists(const std::string& sys_class_net,
+                     const std::string& port_name) {
+  return PathExists(absl::StrCat(sys_class_net, port_name));
+}
+
+::util::StatusOr<std::string> ReadInterfaceAttribute(
+    const std::string& sys_class_net, const std::string& port_name,
+    const std::string& attribute) {
+  std::string value;
+  RETURN_IF_ERROR(ReadFileToString(
+      absl::StrCat(sys_class_net, port_name, "/", attribute), &value));
+  return std::string(absl::StripAsciiWhitespace(value));
+}
+
+::util::StatusOr<uint64> ReadInterfaceStatistic(
+    const std::string& sys_class_net, const std::string& port_name,
+    const std::string& statistic) {
+  ASSIGN_OR_RETURN(auto value,
+                   ReadInterfaceAttribute(sys_class_net, port_name,
+                                          absl::StrCat("statistics/",
+                                                       statistic)));
+  uint64 result;
+  RET_CHECK(absl::SimpleAtoi(value, &result))
+      << "Invalid value '" << value << "' of statistic " << statistic
+      << " of port " << port_name << ".";
+  return result;
+}
+
+// Returns the oper state of an interface. A missing interface is down.
+PortState ReadPortState(const std::string& sys_class_net,
+                        const std::string& port_name) {
+  if (!InterfaceExists(sys_class_net, port_name)) return PORT_STATE_DOWN;
+  auto operstate =
+      ReadInterfaceAttribute(sys_class_net, port_name, "operstate");
+  if (!operstate.ok()) return PORT_STATE_UNKNOWN;
+  if (operstate.ValueOrDie() == "up") return PORT_STATE_UP;
+  // Virtual interfaces without a notion of link, e.g. TAP devices, report an
+  // unknown oper state. Their carrier tells if they can pass traffic.
+  if (operstate.ValueOrDie() == "unknown") {
+    auto carrier = ReadInterfaceAttribute(sys_class_net, port_name, "carrier");
+    if (carrier.ok() && carrier.ValueOrDie() == "1") return PORT_STATE_UP;
+  }
+  return PORT_STATE_DOWN;
+}
+
+// Reads the kernel statistics of an interface. The kernel does not count
+// broadcast packets separately, they are part of the multicast packets.
+::util::Status ReadPortCounters(const std::string& sys_class_net,
+                                const std::string& port_name,
+                                PortCounters* counters) {
+  auto statistic = [&](const std::string& name) {
+    return ReadInterfaceStatistic(sys_class_net, port_name, name);
+  };
+  ASSIGN_OR_RETURN(uint64 rx_bytes, statistic("rx_bytes"));
+  ASSIGN_OR_RETURN(uint64 tx_bytes, statistic("tx_bytes"));
+  ASSIGN_OR_RETURN(uint64 rx_packets, statistic("rx_packets"));
+  ASSIGN_OR_RETURN(uint64 tx_packets, statistic("tx_packets"));
+  ASSIGN_OR_RETURN(uint64 multicast, statistic("multicast"));
+  ASSIGN_OR_RETURN(uint64 rx_dropped, statistic("rx_dropped"));
+  ASSIGN_OR_RETURN(uint64 tx_dropped, statistic("tx_dropped"));
+  ASSIGN_OR_RETURN(uint64 rx_errors, statistic("rx_errors"));
+  ASSIGN_OR_RETURN(uint64 tx_errors, statistic("tx_errors"));
+  ASSIGN_OR_RETURN(uint64 rx_crc_errors, statistic("rx_crc_errors"));
+
+  counters->Clear();
+  counters->set_in_octets(rx_bytes);
+  counters->set_out_octets(tx_bytes);
+  counters->set_in_unicast_pkts(rx_packets > multicast ? rx_packets - multicast
+                                                       : 0);
+  counters->set_out_unicast_pkts(tx_packets);
+  counters->set_in_multicast_pkts(multicast);
+  counters->set_in_discards(rx_dropped);
+  counters->set_out_discards(tx_dropped);
+  counters->set_in_errors(rx_errors);
+  counters->set_out_errors(tx_errors);
+  counters->set_in_fcs_errors(rx_crc_errors);
+
+  return ::util::OkStatus();
+}
+
+// Attaches a port to the NIKSS pipeline of its node.
+::util::Status AddPort(NikssInterface* nikss_interface, uint64 node_id,
+                       const std::string& port_name, uint32 port_id) {
+  LOG(INFO) << "Adding port " << port_id << " (" << port_name << ") to node "
+            << node_id << ".";
+  return nikss_interface->AddPort(node_id, port_name);
+}
+
+// Detaches a port from the NIKSS pipeline of its node.
+::util::Status RemovePort(NikssInterface* nikss_interface, uint64 node_id,
+                          const std::string& port_name, uint32 port_id) {
+  LOG(INFO) << "Removing port " << port_id << " (" << port_name
+            << ") from node " << node_id << ".";
+  return nikss_interface->DeletePort(node_id, port_name);
 }
 
+}  // namespace
+
+NikssChassisManager::NikssChassisManager(PhalInterface* phal_interface,
+                                         NikssInterface* nikss_interface)
+    : initialized_(false),
+      phal_interface_(phal_interface),
+      nikss_interface_(ABSL_DIE_IF_NULL(nikss_interface)),
+      gnmi_event_writer_(nullptr),
+      poller_shutdown_(false),
+      sys_class_net_(kSysClassNet),
+      node_id_to_port_id_to_port_state_(),
+      node_id_to_port_id_to_port_config_(),
+      node_id_to_port_id_to_port_counters_() {}
+
+NikssChassisManager::NikssChassisManager()
+    : initialized_(false),
+      phal_interface_(nullptr),
+      nikss_interface_(nullptr),
+      gnmi_event_writer_(nullptr),
+      poller_shutdown_(false),
+      sys_class_net_(kSysClassNet),
+      node_id_to_port_id_to_port_state_(),
+      node_id_to_port_id_to_port_config_(),
+      node_id_to_port_id_to_port_counters_() {}
+
 NikssChassisManager::~NikssChassisManager() = default;
 
 std::unique_ptr<NikssChassisManager> NikssChassisManager::CreateInstance(
-    PhalInterface* phal_interface) {
+    PhalInterface* phal_interface, NikssInterface* nikss_interface) {
   return absl::WrapUnique(
-      new NikssChassisManager(phal_interface));
+      new NikssChassisManager(phal_interface, nikss_interface));
+}
+
+::util::Status NikssChassisManager::PushChassisConfig(
+    const ChassisConfig& config) {
+  VLOG(1) << "NikssChassisManager::PushChassisConfig";
+  ::util::Status status = ::util::OkStatus();  // errors to keep track of.
+
+  // Build new maps. The state of ports which are kept is preserved.
+  std::map<uint64, std::map<uint32, PortState>>
+      node_id_to_port_id_to_port_state;
+  std::map<uint64, std::map<uint32, SingletonPort>>
+      node_id_to_port_id_to_port_config;
+  for (const auto& singleton_port : config.singleton_ports()) {
+    uint32 port_id = singleton_port.id();
+    uint64 node_id = singleton_port.node();
+    node_id_to_port_id_to_port_state[node_id][port_id] = PORT_STATE_UNKNOWN;
+    node_id_to_port_id_to_port_config[node_id][port_id] = singleton_port;
+  }
+
+  // Compare ports in old config and new config and perform the necessary
+  // operations.
+  for (const auto& node : config.nodes()) {
+    VLOG(1) << "Updating config for node " << node.id() << ".";
+    auto& ports_old = node_id_to_port_id_to_port_config_[node.id()];
+    auto& ports = node_id_to_port_id_to_port_config[node.id()];
+
+    // Remove or change existing port config.
+    for (const auto& port_old : ports_old) {
+      auto port_id = port_old.first;
+      const auto& singleton_port_old = port_old.second;
+      auto* singleton_port = gtl::FindOrNull(ports, port_id);
+      bool enabled_old = singleton_port_old.config_params().admin_state() ==
+                         ADMIN_STATE_ENABLED;
+      bool enabled = singleton_port != nullptr &&
+                     singleton_port->config_params().admin_state() ==
+                         ADMIN_STATE_ENABLED;
+      bool renamed = singleton_port != nullptr &&
+                     singleton_port->name() != singleton_port_old.name();
+
+      if (enabled_old && (!enabled || renamed)) {
+        APPEND_STATUS_IF_ERROR(
+            status, RemovePort(nikss_interface_, node.id(),
+                               singleton_port_old.name(), port_id));
+        if (singleton_port != nullptr &&
+            node_id_to_port_id_to_port_state_[node.id()][port_id] ==
+                PORT_STATE_UP) {
+          VLOG(1) << "Sending DOWN notification for port " << port_id
+                  << " in node " << node.id() << ".";
+          SendPortOperStateGnmiEvent(node.id(), port_id, PORT_STATE_DOWN);
+        }
+      }
+      if (enabled && (!enabled_old || renamed)) {
+        APPEND_STATUS_IF_ERROR(
+            status, AddPort(nikss_interface_, node.id(),
+                            singleton_port->name(), port_id));
+      }
+      if (singleton_port != nullptr && !renamed &&
+          enabled == enabled_old) {
+        node_id_to_port_id_to_port_state[node.id()][port_id] =
+            node_id_to_port_id_to_port_state_[node.id()][port_id];
+      }
+    }
+
+    // Add a new port config.
+    for (const auto& port : ports) {
+      auto port_id = port.first;
+      if (ports_old.count(port_id)) continue;
+      const auto& singleton_port = port.second;
+      if (singleton_port.config_params().admin_state() ==
+          ADMIN_STATE_ENABLED) {
+        APPEND_STATUS_IF_ERROR(
+            status, AddPort(nikss_interface_, node.id(), singleton_port.name(),
+                            port_id));
+      } else {
+        LOG(INFO) << "Port " << port_id
+                  << " is listed in ChassisConfig for node " << node.id()
+                  << " but its admin state is not set to enabled.";
+      }
+    }
+  }
+
+  node_id_to_port_id_to_port_state_ = node_id_to_port_id_to_port_state;
+  node_id_to_port_id_to_port_config_ = node_id_to_port_id_to_port_config;
+  // Counters are published again for ports which have been changed.
+  for (auto& node : node_id_to_port_id_to_port_counters_) {
+    for (auto it = node.second.begin(); it != node.second.end();) {
+      auto* state = gtl::FindOrNull(
+          node_id_to_port_id_to_port_state_[node.first], it->first);
+      if (state == nullptr || *state == PORT_STATE_UNKNOWN) {
+        it = node.second.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+
+  if (!initialized_) {
+    RETURN_IF_ERROR(StartPortPoller());
+    initialized_ = true;
+  }
+
+  return status;
+}
+
+::util::Status NikssChassisManager::VerifyChassisConfig(
+    const ChassisConfig& config) {
+  std::set<uint64> node_ids;
+  for (const auto& node : config.nodes()) {
+    RET_CHECK(node_ids.insert(node.id()).second)
+        << "Duplicate node ID " << node.id() << " in ChassisConfig.";
+  }
+  std::map<uint64, std::set<uint32>> node_id_to_port_ids;
+  std::map<uint64, std::set<std::string>> node_id_to_port_names;
+  for (const auto& singleton_port : config.singleton_ports()) {
+    RET_CHECK(node_ids.count(singleton_port.node()))
+        << "Unknown node " << singleton_port.node() << " in SingletonPort "
+        << singleton_port.ShortDebugString() << ".";
+    RET_CHECK(singleton_port.id() != 0)
+        << "Invalid port ID in SingletonPort "
+        << singleton_port.ShortDebugString() << ".";
+    // The name of a singleton port is the Linux interface attached to the
+    // pipeline.
+    RET_CHECK(!singleton_port.name().empty())
+        << "No interface name in SingletonPort "
+        << singleton_port.ShortDebugString() << ".";
+    RET_CHECK(node_id_to_port_ids[singleton_port.node()]
+                  .insert(singleton_port.id())
+                  .second)
+        << "Duplicate port ID " << singleton_port.id() << " in node "
+        << singleton_port.node() << ".";
+    RET_CHECK(node_id_to_port_names[singleton_port.node()]
+                  .insert(singleton_port.name())
+                  .second)
+        << "Interface " << singleton_port.name()
+        << " is used by more than one port of node " << singleton_port.node()
+        << ".";
+  }
+
+  return ::util::OkStatus();
+}
+
+::util::Status NikssChassisManager::RegisterEventNotifyWriter(
+    const std::shared_ptr<WriterInterface<GnmiEventPtr>>& writer) {
+  absl::WriterMutexLock l(&gnmi_event_lock_);
+  gnmi_event_writer_ = writer;
+  return ::util::OkStatus();
+}
+
+::util::Status NikssChassisManager::UnregisterEventNotifyWriter() {
+  absl::WriterMutexLock l(&gnmi_event_lock_);
+  gnmi_event_writer_ = nullptr;
+  return ::util::OkStatus();
+}
+
+::util::StatusOr<const SingletonPort*> NikssChassisManager::GetSingletonPort(
+    uint64 node_id, uint32 port_id) const {
+  auto* port_id_to_singleton =
+      gtl::FindOrNull(node_id_to_port_id_to_port_config_, node_id);
+  RET_CHECK(port_id_to_singleton != nullptr)
+      << "Node " << node_id << " is not configured or not known.";
+  const SingletonPort* singleton =
+      gtl::FindOrNull(*port_id_to_singleton, port_id);
+  RET_CHECK(singleton != nullptr)
+      << "Port " << port_id << " is not configured or not known for node "
+      << node_id << ".";
+  return singleton;
+}
+
+::util::StatusOr<DataResponse> NikssChassisManager::GetPortData(
+    const DataRequest::Request& request) {
+  if (!initialized_) {
+    return MAKE_ERROR(ERR_NOT_INITIALIZED) << "Not initialized!";
+  }
+  DataResponse resp;
+  using Request = DataRequest::Request;
+  switch (request.request_case()) {
+    case Request::kOperStatus: {
+      ASSIGN_OR_RETURN(auto port_state,
+                       GetPortState(request.oper_status().node_id(),
+                                    request.oper_status().port_id()));
+      resp.mutable_oper_status()->set_state(port_state);
+      break;
+    }
+    case Request::kAdminStatus: {
+      ASSIGN_OR_RETURN(auto* singleton,
+                       GetSingletonPort(request.admin_status().node_id(),
+                                        request.admin_status().port_id()));
+      resp.mutable_admin_status()->set_state(
+          singleton->config_params().admin_state());
+      break;
+    }
+    case Request::kMacAddress: {
+      ASSIGN_OR_RETURN(auto* singleton,
+                       GetSingletonPort(request.mac_address().node_id(),
+                                        request.mac_address().port_id()));
+      uint64 mac_address = kDummyMacAddress;
+      auto address = ReadInterfaceAttribute(sys_class_net_, singleton->name(),
+                                            "address");
+      if (address.ok()) {
+        auto parsed = YangStringToMacAddress(address.ValueOrDie());
+        if (parsed.ok()) mac_address = parsed.ValueOrDie();
+      }
+      resp.mutable_mac_address()->set_mac_address(mac_address);
+      break;
+    }
+    case Request::kPortSpeed: {
+      ASSIGN_OR_RETURN(auto* singleton,
+                       GetSingletonPort(request.port_speed().node_id(),
+                                        request.port_speed().port_id()));
+      resp.mutable_port_speed()->set_speed_bps(singleton->speed_bps());
+      break;
+    }
+    case Request::kNegotiatedPortSpeed: {
+      ASSIGN_OR_RETURN(
+          auto* singleton,
+          GetSingletonPort(request.negotiated_port_speed().node_id(),
+                           request.negotiated_port_speed().port_id()));
+      // The kernel reports the link speed in Mbps, or -1 for interfaces
+      // without a link speed, e.g. virtual ones.
+      uint64 speed_bps = singleton->speed_bps();
+      auto speed =
+          ReadInterfaceAttribute(sys_class_net_, singleton->name(), "speed");
+      int64 speed_mbps;
+      if (speed.ok() && absl::SimpleAtoi(speed.ValueOrDie(), &speed_mbps) &&
+          speed_mbps > 0) {
+        speed_bps = speed_mbps * 1000000ull;
+      }
+      resp.mutable_negotiated_port_speed()->set_speed_bps(speed_bps);
+      break;
+    }
+    case DataRequest::Request::kLacpRouterMac: {
+      // Find LACP System ID MAC address of port located at:
+      // - node_id: req.lacp_router_mac().node_id()
+      // - port_id: req.lacp_router_mac().port_id()
+      // and then write it into the response.
+      resp.mutable_lacp_router_mac()->set_mac_address(kDummyMacAddress);
+      break;
+    }
+    case Request::kPortCounters: {
+      RETURN_IF_ERROR(GetPortCounters(request.port_counters().node_id(),
+                                      request.port_counters().port_id(),
+                                      resp.mutable_port_counters()));
+      break;
+    }
+    case Request::kForwardingViability: {
+      // Find current port forwarding viable state for port located at:
+      // - node_id: req.forwarding_viable().node_id()
+      // - port_id: req.forwarding_viable().port_id()
+      // and then write it into the response.
+      resp.mutable_forwarding_viability()->set_state(
+          TRUNK_MEMBER_BLOCK_STATE_UNKNOWN);
+      break;
+    }
+    case DataRequest::Request::kHealthIndicator: {
+      // Find current port health indicator (LED) for port located at:
+      // - node_id: req.health_indicator().node_id()
+      // - port_id: req.health_indicator().port_id()
+      // and then write it into the response.
+      resp.mutable_health_indicator()->set_state(HEALTH_STATE_UNKNOWN);
+      break;
+    }
+    case Request::kAutonegStatus: {
+      ASSIGN_OR_RETURN(auto* singleton,
+                       GetSingletonPort(request.autoneg_status().node_id(),
+                                        request.autoneg_status().port_id()));
+      resp.mutable_autoneg_status()->set_state(
+          singleton->config_params().autoneg());
+      break;
+    }
+    case DataRequest::Request::kSdnPortId:
+      resp.mutable_sdn_port_id()->set_port_id(request.sdn_port_id().port_id());
+      break;
+    default:
+      return MAKE_ERROR(ERR_INTERNAL) << "Not supported yet";
+  }
+  return resp;
+}
+
+::util::StatusOr<PortState> NikssChassisManager::GetPortState(uint64 node_id,
+                                                              uint32 port_id) {
+  if (!initialized_) {
+    return MAKE_ERROR(ERR_NOT_INITIALIZED) << "Not initialized!";
+  }
+  auto* port_id_to_port_state =
+      gtl::FindOrNull(node_id_to_port_id_to_port_state_, node_id);
+  RET_CHECK(port_id_to_port_state != nullptr)
+      << "Node " << node_id << " is not configured or not known.";
+  const PortState* port_state_ptr =
+      gtl::FindOrNull(*port_id_to_port_state, port_id);
+  RET_CHECK(port_state_ptr != nullptr)
+      << "Port " << port_id << " is not configured or not known for node "
+      << node_id << ".";
+  if (*port_state_ptr != PORT_STATE_UNKNOWN) return *port_state_ptr;
+
+  // The port has not been polled yet, query its state.
+  ASSIGN_OR_RETURN(auto* singleton, GetSingletonPort(node_id, port_id));
+  if (singleton->config_params().admin_state() != ADMIN_STATE_ENABLED) {
+    return PORT_STATE_DOWN;
+  }
+  return ReadPortState(sys_class_net_, singleton->name());
+}
+
+::util::Status NikssChassisManager::GetPortCounters(uint64 node_id,
+                                                    uint32 port_id,
+                                                    PortCounters* counters) {
+  if (!initialized_) {
+    return MAKE_ERROR(ERR_NOT_INITIALIZED) << "Not initialized!";
+  }
+  ASSIGN_OR_RETURN(auto* singleton, GetSingletonPort(node_id, port_id));
+  if (singleton->config_params().admin_state() != ADMIN_STATE_ENABLED ||
+      !InterfaceExists(sys_class_net_, singleton->name())) {
+    VLOG(1) << "NikssChassisManager::GetPortCounters : port " << port_id
+            << " in node " << node_id << " is not enabled or does not exist,"
+            << " so stats will be set to 0.";
+    counters->Clear();
+    return ::util::OkStatus();
+  }
+
+  return ReadPortCounters(sys_class_net_, singleton->name(), counters);
+}
+
+void NikssChassisManager::SendPortOperStateGnmiEvent(uint64 node_id,
+                                                     uint32 port_id,
+                                                     PortState new_state) {
+  absl::ReaderMutexLock l(&gnmi_event_lock_);
+  if (!gnmi_event_writer_) return;
+  // Allocate and initialize a PortOperStateChangedEvent event and pass it to
+  // the gNMI publisher using the gNMI event notification channel.
+  // The GnmiEventPtr is a smart pointer (shared_ptr<>) and it takes care of
+  // the memory allocated to this event object once the event is handled by
+  // the GnmiPublisher.
+  if (!gnmi_event_writer_->Write(GnmiEventPtr(
+          new PortOperStateChangedEvent(node_id, port_id, new_state, 0)))) {
+    // Remove WriterInterface if it is no longer operational.
+    gnmi_event_writer_.reset();
+  }
+}
+
+void NikssChassisManager::SendPortCountersGnmiEvent(
+    uint64 node_id, uint32 port_id, const PortCounters& counters) {
+  absl::ReaderMutexLock l(&gnmi_event_lock_);
+  if (!gnmi_event_writer_) return;
+  if (!gnmi_event_writer_->Write(GnmiEventPtr(
+          new PortCountersChangedEvent(node_id, port_id, counters)))) {
+    // Remove WriterInterface if it is no longer operational.
+    gnmi_event_writer_.reset();
+  }
+}
+
+void NikssChassisManager::PollPortStatus() {
+  while (true) {
+    {
+      absl::MutexLock l(&poller_lock_);
+      if (poller_lock_.AwaitWithTimeout(
+              absl::Condition(&poller_shutdown_),
+              absl::Milliseconds(FLAGS_nikss_port_status_poll_interval_ms))) {
+        break;
+      }
+    }
+    PollPorts();
+  }
+}
+
+void NikssChassisManager::PollPorts() {
+  // Take a snapshot of the configured ports, so that the kernel is queried
+  // without holding the chassis lock.
+  std::vector<PolledPort> ports;
+  {
+    absl::ReaderMutexLock l(&chassis_lock);
+    for (const auto& node : node_id_to_port_id_to_port_config_) {
+      for (const auto& port : node.second) {
+        PolledPort polled = {};
+        polled.node_id = node.first;
+        polled.port_id = port.first;
+        polled.name = port.second.name();
+        polled.enabled = port.second.config_params().admin_state() ==
+                         ADMIN_STATE_ENABLED;
+        ports.push_back(std::move(polled));
+      }
+    }
+  }
+  for (auto& port : ports) {
+    port.state = port.enabled ? ReadPortState(sys_class_net_, port.name)
+                              : PORT_STATE_DOWN;
+    if (port.enabled && InterfaceExists(sys_class_net_, port.name)) {
+      auto status = ReadPortCounters(sys_class_net_, port.name, &port.counters);
+      port.counters_changed = status.ok();
+      LOG_IF_EVERY_N(WARNING, !status.ok(), 100)
+          << "Failed to read counters of port " << port.name << ": "
+          << status.error_message();
+    }
+  }
+
+  // Update the port state and only publish what has changed since the last
+  // poll. Ports which have been removed in the meantime are skipped.
+  {
+    absl::WriterMutexLock l(&chassis_lock);
+    for (auto& port : ports) {
+      auto* port_id_to_port_state =
+          gtl::FindOrNull(node_id_to_port_id_to_port_state_, port.node_id);
+      if (port_id_to_port_state == nullptr) continue;
+      auto* port_state_ptr =
+          gtl::FindOrNull(*port_id_to_port_state, port.port_id);
+      if (port_state_ptr == nullptr) continue;
+      if (*port_state_ptr != port.state) {
+        LOG(INFO) << "State of port " << port.port_id << " in node "
+                  << port.node_id << ": " << PrintPortState(port.state)
+                  << ".";
+        *port_state_ptr = port.state;
+        port.state_changed = true;
+      }
+      if (port.counters_changed) {
+        auto& last = node_id_to_port_id_to_port_counters_[port.node_id]
+                                                         [port.port_id];
+        if (google::protobuf::util::MessageDifferencer::Equals(
+                last, port.counters)) {
+          port.counters_changed = false;
+        } else {
+          last = port.counters;
+        }
+      }
+    }
+  }
+  for (const auto& port : ports) {
+    if (port.state_changed) {
+      SendPortOperStateGnmiEvent(port.node_id, port.port_id, port.state);
+    }
+    if (port.counters_changed) {
+      SendPortCountersGnmiEvent(port.node_id, port.port_id, port.counters);
+    }
+  }
+}
+
+::util::Status NikssChassisManager::StartPortPoller() {
+  if (initialized_) {
+    return MAKE_ERROR(ERR_INTERNAL)
+           << "StartPortPoller() can be called only before the class is "
+           << "initialized.";
+  }
+  {
+    absl::MutexLock l(&poller_lock_);
+    poller_shutdown_ = false;
+  }
+  port_poller_thread_ = std::thread([this]() { this->PollPortStatus(); });
+
+  return ::util::OkStatus();
+}
+
+::util::Status NikssChassisManager::StopPortPoller() {
+  {
+    absl::MutexLock l(&poller_lock_);
+    poller_shutdown_ = true;
+  }
+  if (port_poller_thread_.joinable()) port_poller_thread_.join();
+
+  return ::util::OkStatus();
+}
+
+void NikssChassisManager::CleanupInternalState() {
+  node_id_to_port_id_to_port_state_.clear();
+  node_id_to_port_id_to_port_config_.clear();
+  node_id_to_port_id_to_port_counters_.clear();
+}
+
+::util::Status NikssChassisManager::Shutdown() {
+  ::util::Status status = ::util::OkStatus();
+  {
+    absl::ReaderMutexLock l(&chassis_lock);
+    if (!initialized_) return status;
+  }
+  // The poller thread takes the chassis lock, so it is stopped without holding
+  // it. Because initialized_ is still set, StartPortPoller cannot be called.
+  APPEND_STATUS_IF_ERROR(status, StopPortPoller());
+  {
+    absl::WriterMutexLock l(&chassis_lock);
+    initialized_ = false;
+    // Ports are left attached to the pipeline, so that traffic keeps flowing
+    // until the pipeline is replaced by the next instance.
+    CleanupInternalState();
+  }
+  return status;
 }
 
 }  // namespace nikss
@@ -1,10 +1,22 @@
 #ifndef STRATUM_HAL_LIB_NIKSS_NIKSS_CHASSIS_MANAGER_H_
 #define STRATUM_HAL_LIB_NIKSS_NIKSS_CHASSIS_MANAGER_H_
 
+#include <map>
 #include <memory>
+#include <string>
+#include <thread>  // NOLINT
+#include <vector>
 
+#include "absl/base/thread_annotations.h"
 #include "absl/synchronization/mutex.h"
+#include "stratum/glue/integral_types.h"
+#include "stratum/glue/status/status.h"
+#include "stratum/glue/status/statusor.h"
+#include "stratum/hal/lib/common/common.pb.h"
+#include "stratum/hal/lib/common/gnmi_events.h"
 #include "stratum/hal/lib/common/phal_interface.h"
+#include "stratum/hal/lib/common/writer_interface.h"
+#include "stratum/hal/lib/nikss/nikss_interface.h"
 
 namespace stratum {
 namespace hal {
@@ -13,13 +25,43 @@ namespace nikss {
 // Lock which protects chassis state across the entire switch.
 extern absl::Mutex chassis_lock;
 
+// The NikssChassisManager attaches the singleton ports of the ChassisConfig,
+// which are Linux interfaces, to the NIKSS pipeline of their node. A poller
+// thread tracks the oper state and the counters the kernel keeps for every
+// port, and publishes changes as gNMI events.
 class NikssChassisManager {
  public:
   virtual ~NikssChassisManager();
 
+  virtual ::util::Status PushChassisConfig(const ChassisConfig& config)
+      EXCLUSIVE_LOCKS_REQUIRED(chassis_lock);
+
+  virtual ::util::Status VerifyChassisConfig(const ChassisConfig& config)
+      SHARED_LOCKS_REQUIRED(chassis_lock);
+
+  virtual ::util::Status Shutdown() LOCKS_EXCLUDED(chassis_lock);
+
+  virtual ::util::Status RegisterEventNotifyWriter(
+      const std::shared_ptr<WriterInterface<GnmiEventPtr>>& writer)
+      LOCKS_EXCLUDED(gnmi_event_lock_);
+
+  virtual ::util::Status UnregisterEventNotifyWriter()
+      LOCKS_EXCLUDED(gnmi_event_lock_);
+
+  virtual ::util::StatusOr<DataResponse> GetPortData(
+      const DataRequest::Request& request) SHARED_LOCKS_REQUIRED(chassis_lock);
+
+  virtual ::util::StatusOr<PortState> GetPortState(uint64 node_id,
+                                                   uint32 port_id)
+      SHARED_LOCKS_REQUIRED(chassis_lock);
+
+  virtual ::util::Status GetPortCounters(uint64 node_id, uint32 port_id,
+                                         PortCounters* counters)
+      SHARED_LOCKS_REQUIRED(chassis_lock);
+
   // Factory function for creating the instance of the class.
   static std::unique_ptr<NikssChassisManager> CreateInstance(
-      PhalInterface* phal_interface);
+      PhalInterface* phal_interface, NikssInterface* nikss_interface);
 
   // NikssChassisManager is neither copyable nor movable.
   NikssChassisManager(const NikssChassisManager&) = delete;
@@ -27,21 +69,96 @@ class NikssChassisManager {
   NikssChassisManager(NikssChassisManager&&) = delete;
   NikssChassisManager& operator=(NikssChassisManager&&) = delete;
 
+ protected:
+  // Default constructor. To be called by the Mock class instance only.
+  NikssChassisManager();
+
  private:
+  // A port polled by the poller thread.
+  struct PolledPort {
+    uint64 node_id;
+    uint32 port_id;
+    std::string name;
+    bool enabled;
+    PortState state;
+    bool state_changed;
+    PortCounters counters;
+    bool counters_changed;
+  };
+
   // Private constructor. Use CreateInstance() to create an instance of this
   // class.
-  NikssChassisManager(PhalInterface* phal_interface);
+  NikssChassisManager(PhalInterface* phal_interface,
+                      NikssInterface* nikss_interface);
+
+  // Starts and stops the poller thread.
+  ::util::Status StartPortPoller() EXCLUSIVE_LOCKS_REQUIRED(chassis_lock);
+  ::util::Status StopPortPoller() LOCKS_EXCLUDED(chassis_lock, poller_lock_);
+
+  // Cleans up the internal state. Resets all the internal port maps.
+  void CleanupInternalState() EXCLUSIVE_LOCKS_REQUIRED(chassis_lock);
+
+  // Forward port events through the registered WriterInterface<GnmiEventPtr>.
+  void SendPortOperStateGnmiEvent(uint64 node_id, uint32 port_id,
+                                  PortState new_state)
+      LOCKS_EXCLUDED(gnmi_event_lock_);
+  void SendPortCountersGnmiEvent(uint64 node_id, uint32 port_id,
+                                 const PortCounters& counters)
+      LOCKS_EXCLUDED(gnmi_event_lock_);
+
+  // Thread function polling the state and counters of all ports.
+  void PollPortStatus() LOCKS_EXCLUDED(chassis_lock, poller_lock_);
+
+  // Polls the state and counters of all ports once and publishes the changes.
+  void PollPorts() LOCKS_EXCLUDED(chassis_lock);
+
+  ::util::StatusOr<const SingletonPort*> GetSingletonPort(uint64 node_id,
+                                                          uint32 port_id) const
+      SHARED_LOCKS_REQUIRED(chassis_lock);
 
   bool initialized_ GUARDED_BY(chassis_lock);
 
   // Pointer to a PhalInterface implementation.
   PhalInterface* phal_interface_;  // not owned by this class.
 
+  // Pointer to a NikssInterface implementation that wraps all the SDE calls.
+  NikssInterface* nikss_interface_;  // not owned by this class.
+
+  // WriterInterface<GnmiEventPtr> object for sending event notifications.
+  mutable absl::Mutex gnmi_event_lock_;
+  std::shared_ptr<WriterInterface<GnmiEventPtr>> gnmi_event_writer_
+      GUARDED_BY(gnmi_event_lock_);
+
+  // Set to make the poller thread exit.
+  mutable absl::Mutex poller_lock_;
+  bool poller_shutdown_ GUARDED_BY(poller_lock_);
+
+  std::thread port_poller_thread_;
+
+  // Directory holding the Linux interfaces, with a trailing slash. Only
+  // changed by tests, before the poller thread is started.
+  std::string sys_class_net_;
+
+  // Map from node ID to another map from port ID to PortState representing
+  // the state of the singleton port uniquely identified by (node ID, port ID).
+  std::map<uint64, std::map<uint32, PortState>>
+      node_id_to_port_id_to_port_state_ GUARDED_BY(chassis_lock);
+
+  // Map from node ID to another map from port ID to SingletonPort representing
+  // the config of the singleton port uniquely identified by (node ID, port ID).
+  std::map<uint64, std::map<uint32, SingletonPort>>
+      node_id_to_port_id_to_port_config_ GUARDED_BY(chassis_lock);
+
+  // Map from node ID to another map from port ID to the counters last
+  // published for the singleton port uniquely identified by (node ID, port ID).
+  std::map<uint64, std::map<uint32, PortCounters>>
+      node_id_to_port_id_to_port_counters_ GUARDED_BY(chassis_lock);
+
+  friend class NikssChassisManagerTest;
 };
 
 }  // namespace nikss
 }  // namespace hal
 }  // namespace stratum
 
-
 #endif  // STRATUM_HAL_LIB_NIKSS_NIKSS_CHASSIS_MANAGER_H_
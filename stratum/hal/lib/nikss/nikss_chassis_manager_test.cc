@@ -0,0 +1,325 @@
+#include "stratum/hal/lib/nikss/nikss_chassis_manager.h"
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/memory/memory.h"
+#include "absl/strings/str_cat.h"
+#include "absl/synchronization/mutex.h"
+#include "gflags/gflags.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "stratum/glue/status/status_macros.h"
+#include "stratum/glue/status/status_test_util.h"
+#include "stratum/hal/lib/common/writer_mock.h"
+#include "stratum/hal/lib/nikss/nikss_interface_mock.h"
+#include "stratum/lib/test_utils/matchers.h"
+#include "stratum/lib/utils.h"
+#include "stratum/public/lib/error.h"
+
+DECLARE_string(test_tmpdir);
+DECLARE_int32(nikss_port_status_poll_interval_ms);
+
+namespace stratum {
+namespace hal {
+namespace nikss {
+
+using test_utils::StatusIs;
+using ::testing::_;
+using ::testing::ElementsAre;
+using ::testing::HasSubstr;
+using ::testing::Invoke;
+using ::testing::Pair;
+using ::testing::Return;
+using ::testing::StrictMock;
+
+class NikssChassisManagerTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    // The ports are only polled by the tests.
+    FLAGS_nikss_port_status_poll_interval_ms = 3600 * 1000;
+    // Every test has its own fake sysfs.
+    sys_class_net_ = absl::StrCat(
+        FLAGS_test_tmpdir, "/",
+        ::testing::UnitTest::GetInstance()->current_test_info()->name(),
+        "/sys/class/net/");
+    ASSERT_OK(RecursivelyCreateDir(sys_class_net_));
+    nikss_interface_mock_ =
+        absl::make_unique<StrictMock<NikssInterfaceMock>>();
+    chassis_manager_ = NikssChassisManager::CreateInstance(
+        nullptr, nikss_interface_mock_.get());
+    chassis_manager_->sys_class_net_ = sys_class_net_;
+    event_writer_ = std::make_shared<WriterMock<GnmiEventPtr>>();
+    ON_CALL(*event_writer_, Write(_))
+        .WillByDefault(Invoke([this](const GnmiEventPtr& event) {
+          events_.push_back(event);
+          return true;
+        }));
+    EXPECT_CALL(*event_writer_, Write(_)).Times(::testing::AnyNumber());
+    ASSERT_OK(chassis_manager_->RegisterEventNotifyWriter(event_writer_));
+  }
+
+  void TearDown() override { EXPECT_OK(chassis_manager_->Shutdown()); }
+
+  ::util::Status PushChassisConfig(const std::string& config_text) {
+    ChassisConfig config;
+    RETURN_IF_ERROR(ParseProtoFromString(config_text, &config));
+    absl::WriterMutexLock l(&chassis_lock);
+    RETURN_IF_ERROR(chassis_manager_->VerifyChassisConfig(config));
+    return chassis_manager_->PushChassisConfig(config);
+  }
+
+  // Creates or updates the sysfs attributes of the interface 'name'. All the
+  // statistics but rx_bytes are zero.
+  void SetInterface(const std::string& name, const std::string& operstate,
+                    uint64 rx_bytes) {
+    const std::string dir = sys_class_net_ + name;
+    ASSERT_OK(RecursivelyCreateDir(dir + "/statistics"));
+    ASSERT_OK(WriteStringToFile(operstate + "\n", dir + "/operstate"));
+    for (const char* statistic :
+         {"rx_bytes", "tx_bytes", "rx_packets", "tx_packets", "multicast",
+          "rx_dropped", "tx_dropped", "rx_errors", "tx_errors",
+          "rx_crc_errors"}) {
+      const uint64 value = std::string(statistic) == "rx_bytes" ? rx_bytes : 0;
+      ASSERT_OK(WriteStringToFile(absl::StrCat(value, "\n"),
+                                  absl::StrCat(dir, "/statistics/",
+                                               statistic)));
+    }
+  }
+
+  void PollPorts() { chassis_manager_->PollPorts(); }
+
+  // Returns the port ID and new state of the oper state events and clears
+  // them.
+  std::vector<std::pair<uint32, PortState>> TakeOperStateEvents() {
+    std::vector<std::pair<uint32, PortState>> result;
+    std::vector<GnmiEventPtr> others;
+    for (const auto& event : events_) {
+      auto* oper_state =
+          dynamic_cast<PortOperStateChangedEvent*>(event.get());
+      if (oper_state) {
+        result.emplace_back(oper_state->GetPortId(),
+                            oper_state->GetNewState());
+      } else {
+        others.push_back(event);
+      }
+    }
+    events_ = std::move(others);
+    return result;
+  }
+
+  // Returns the port ID and in_octets of the counter events and clears them.
+  std::vector<std::pair<uint32, uint64>> TakeCounterEvents() {
+    std::vector<std::pair<uint32, uint64>> result;
+    std::vector<GnmiEventPtr> others;
+    for (const auto& event : events_) {
+      auto* counters = dynamic_cast<PortCountersChangedEvent*>(event.get());
+      if (counters) {
+        result.emplace_back(counters->GetPortId(), counters->GetInOctets());
+      } else {
+        others.push_back(event);
+      }
+    }
+    events_ = std::move(others);
+    return result;
+  }
+
+  static constexpr int kNodeId = 1;
+  static constexpr char kChassisConfig[] = R"pb(
+    nodes { id: 1 }
+    singleton_ports {
+      id: 1
+      name: "veth0"
+      node: 1
+      config_params { admin_state: ADMIN_STATE_ENABLED }
+    }
+    singleton_ports {
+      id: 2
+      name: "veth1"
+      node: 1
+      config_params { admin_state: ADMIN_STATE_DISABLED }
+    }
+  )pb";
+
+  std::string sys_class_net_;
+  std::unique_ptr<StrictMock<NikssInterfaceMock>> nikss_interface_mock_;
+  std::unique_ptr<NikssChassisManager> chassis_manager_;
+  std::shared_ptr<WriterMock<GnmiEventPtr>> event_writer_;
+  // The events written to event_writer_.
+  std::vector<GnmiEventPtr> events_;
+};
+
+constexpr int NikssChassisManagerTest::kNodeId;
+constexpr char NikssChassisManagerTest::kChassisConfig[];
+
+TEST_F(NikssChassisManagerTest, PushChassisConfigAttachesEnabledPorts) {
+  EXPECT_CALL(*nikss_interface_mock_, AddPort(kNodeId, "veth0"))
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_OK(PushChassisConfig(kChassisConfig));
+
+  // Pushing the same config again does not touch the ports.
+  EXPECT_OK(PushChassisConfig(kChassisConfig));
+}
+
+TEST_F(NikssChassisManagerTest, PushChassisConfigOnlyAppliesDiff) {
+  EXPECT_CALL(*nikss_interface_mock_, AddPort(kNodeId, "veth0"))
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_CALL(*nikss_interface_mock_, AddPort(kNodeId, "veth3"))
+      .WillOnce(Return(::util::OkStatus()));
+  ASSERT_OK(PushChassisConfig(absl::StrCat(kChassisConfig, R"pb(
+    singleton_ports {
+      id: 3
+      name: "veth3"
+      node: 1
+      config_params { admin_state: ADMIN_STATE_ENABLED }
+    }
+  )pb")));
+  ::testing::Mock::VerifyAndClearExpectations(nikss_interface_mock_.get());
+
+  // Port 1 is renamed, port 2 enabled, port 3 removed and port 4 added.
+  EXPECT_CALL(*nikss_interface_mock_, DeletePort(kNodeId, "veth0"))
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_CALL(*nikss_interface_mock_, AddPort(kNodeId, "veth2"))
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_CALL(*nikss_interface_mock_, AddPort(kNodeId, "veth1"))
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_CALL(*nikss_interface_mock_, DeletePort(kNodeId, "veth3"))
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_CALL(*nikss_interface_mock_, AddPort(kNodeId, "veth4"))
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_OK(PushChassisConfig(R"pb(
+    nodes { id: 1 }
+    singleton_ports {
+      id: 1
+      name: "veth2"
+      node: 1
+      config_params { admin_state: ADMIN_STATE_ENABLED }
+    }
+    singleton_ports {
+      id: 2
+      name: "veth1"
+      node: 1
+      config_params { admin_state: ADMIN_STATE_ENABLED }
+    }
+    singleton_ports {
+      id: 4
+      name: "veth4"
+      node: 1
+      config_params { admin_state: ADMIN_STATE_ENABLED }
+    }
+  )pb"));
+}
+
+TEST_F(NikssChassisManagerTest, PushChassisConfigReportsPortErrors) {
+  // A failing port does not keep the other ports from being attached.
+  EXPECT_CALL(*nikss_interface_mock_, AddPort(kNodeId, "veth0"))
+      .WillOnce(Return(MAKE_ERROR(ERR_INTERNAL) << "veth0 not found."));
+  EXPECT_CALL(*nikss_interface_mock_, AddPort(kNodeId, "veth1"))
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_THAT(PushChassisConfig(R"pb(
+                nodes { id: 1 }
+                singleton_ports {
+                  id: 1
+                  name: "veth0"
+                  node: 1
+                  config_params { admin_state: ADMIN_STATE_ENABLED }
+                }
+                singleton_ports {
+                  id: 2
+                  name: "veth1"
+                  node: 1
+                  config_params { admin_state: ADMIN_STATE_ENABLED }
+                }
+              )pb"),
+              StatusIs(StratumErrorSpace(), ERR_INTERNAL,
+                       HasSubstr("veth0 not found.")));
+}
+
+TEST_F(NikssChassisManagerTest, PollerPublishesOperStateChanges) {
+  SetInterface("veth0", "down", 0);
+  EXPECT_CALL(*nikss_interface_mock_, AddPort(kNodeId, "veth0"))
+      .WillOnce(Return(::util::OkStatus()));
+  ASSERT_OK(PushChassisConfig(kChassisConfig));
+
+  // The disabled port is down from the start.
+  PollPorts();
+  EXPECT_THAT(TakeOperStateEvents(),
+              ElementsAre(Pair(1, PORT_STATE_DOWN), Pair(2, PORT_STATE_DOWN)));
+  PollPorts();
+  EXPECT_THAT(TakeOperStateEvents(), ElementsAre());
+
+  SetInterface("veth0", "up", 0);
+  PollPorts();
+  EXPECT_THAT(TakeOperStateEvents(), ElementsAre(Pair(1, PORT_STATE_UP)));
+  {
+    absl::ReaderMutexLock l(&chassis_lock);
+    EXPECT_THAT(chassis_manager_->GetPortState(kNodeId, 1),
+                IsOkAndHolds(PORT_STATE_UP));
+  }
+
+  // A TAP device reports an unknown oper state, its carrier is used instead.
+  SetInterface("veth0", "unknown", 0);
+  ASSERT_OK(WriteStringToFile("0\n", sys_class_net_ + "veth0/carrier"));
+  PollPorts();
+  EXPECT_THAT(TakeOperStateEvents(), ElementsAre(Pair(1, PORT_STATE_DOWN)));
+  ASSERT_OK(WriteStringToFile("1\n", sys_class_net_ + "veth0/carrier"));
+  PollPorts();
+  EXPECT_THAT(TakeOperStateEvents(), ElementsAre(Pair(1, PORT_STATE_UP)));
+}
+
+TEST_F(NikssChassisManagerTest, PollerPublishesCounterChanges) {
+  SetInterface("veth0", "up", 100);
+  EXPECT_CALL(*nikss_interface_mock_, AddPort(kNodeId, "veth0"))
+      .WillOnce(Return(::util::OkStatus()));
+  ASSERT_OK(PushChassisConfig(kChassisConfig));
+
+  // Only the enabled port has counters.
+  PollPorts();
+  EXPECT_THAT(TakeCounterEvents(), ElementsAre(Pair(1, 100)));
+  PollPorts();
+  EXPECT_THAT(TakeCounterEvents(), ElementsAre());
+
+  SetInterface("veth0", "up", 200);
+  PollPorts();
+  EXPECT_THAT(TakeCounterEvents(), ElementsAre(Pair(1, 200)));
+  {
+    absl::ReaderMutexLock l(&chassis_lock);
+    PortCounters counters;
+    EXPECT_OK(chassis_manager_->GetPortCounters(kNodeId, 1, &counters));
+    EXPECT_EQ(200U, counters.in_octets());
+  }
+}
+
+TEST_F(NikssChassisManagerTest, DisablingPortPublishesDownEvent) {
+  SetInterface("veth0", "up", 0);
+  EXPECT_CALL(*nikss_interface_mock_, AddPort(kNodeId, "veth0"))
+      .WillOnce(Return(::util::OkStatus()));
+  ASSERT_OK(PushChassisConfig(kChassisConfig));
+  PollPorts();
+  EXPECT_THAT(TakeOperStateEvents(),
+              ElementsAre(Pair(1, PORT_STATE_UP), Pair(2, PORT_STATE_DOWN)));
+
+  EXPECT_CALL(*nikss_interface_mock_, DeletePort(kNodeId, "veth0"))
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_OK(PushChassisConfig(R"pb(
+    nodes { id: 1 }
+    singleton_ports {
+      id: 1
+      name: "veth0"
+      node: 1
+      config_params { admin_state: ADMIN_STATE_DISABLED }
+    }
+  )pb"));
+  EXPECT_THAT(TakeOperStateEvents(), ElementsAre(Pair(1, PORT_STATE_DOWN)));
+  {
+    absl::ReaderMutexLock l(&chassis_lock);
+    EXPECT_THAT(chassis_manager_->GetPortState(kNodeId, 1),
+                IsOkAndHolds(PORT_STATE_DOWN));
+  }
+}
+
+}  // namespace nikss
+}  // namespace hal
+}  // namespace stratum
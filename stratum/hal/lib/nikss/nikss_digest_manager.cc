@@ -0,0 +1,473 @@
+#include "stratum/hal/lib/nikss/nikss_digest_manager.h"
+
+#include <utility>
+
+#include "absl/memory/memory.h"
+#include "gflags/gflags.h"
+#include "stratum/glue/gtl/map_util.h"
+#include "stratum/glue/logging.h"
+#include "stratum/glue/status/status_macros.h"
+#include "stratum/lib/macros.h"
+#include "stratum/public/proto/error.pb.h"
+
+DEFINE_int32(nikss_digest_poll_interval_us, 500,
+             "Interval in microseconds at which the NIKSS digest queues are "
+             "polled once they have been drained.");
+
+namespace stratum {
+namespace hal {
+namespace nikss {
+
+namespace {
+
+// Maximum number of digests read from a single queue per poll. A queue which
+// yields a full burst is polled again right away.
+constexpr size_t kMaxDigestsPerRead = 4096;
+
+// Size of the DigestLists if the controller leaves max_list_size unset.
+constexpr int kDefaultMaxListSize = 1024;
+
+::util::StatusOr<int> BitstringBitwidth(
+    const ::p4::config::v1::P4BitstringLikeTypeSpec& bitstring) {
+  switch (bitstring.type_spec_case()) {
+    case ::p4::config::v1::P4BitstringLikeTypeSpec::kBit:
+      return bitstring.bit().bitwidth();
+    case ::p4::config::v1::P4BitstringLikeTypeSpec::kInt:
+      return bitstring.int_().bitwidth();
+    default:
+      return MAKE_ERROR(ERR_UNIMPLEMENTED)
+             << "Unsupported digest field type " << bitstring.ShortDebugString()
+             << ".";
+  }
+}
+
+// Returns the bit widths of the digest fields: of the bitstring, or of each
+// member of the struct the digest is made of.
+::util::Status DigestBitwidths(const ::p4::config::v1::P4Info& p4info,
+                               const ::p4::config::v1::Digest& digest,
+                               std::vector<int>* bitwidths) {
+  const auto& type_spec = digest.type_spec();
+  if (type_spec.has_bitstring()) {
+    ASSIGN_OR_RETURN(int bitwidth, BitstringBitwidth(type_spec.bitstring()));
+    bitwidths->push_back(bitwidth);
+    return ::util::OkStatus();
+  }
+  RET_CHECK(type_spec.has_struct_())
+      << "Unsupported type of digest " << digest.preamble().name() << ": "
+      << type_spec.ShortDebugString() << ".";
+  const auto* struct_spec = gtl::FindOrNull(p4info.type_info().structs(),
+                                            type_spec.struct_().name());
+  RET_CHECK(struct_spec) << "Struct " << type_spec.struct_().name()
+                         << " of digest " << digest.preamble().name()
+                         << " not found in P4Info.";
+  for (const auto& member : struct_spec->members()) {
+    RET_CHECK(member.type_spec().has_bitstring())
+        << "Unsupported type of member " << member.name() << " of digest "
+        << digest.preamble().name() << ".";
+    ASSIGN_OR_RETURN(int bitwidth,
+                     BitstringBitwidth(member.type_spec().bitstring()));
+    bitwidths->push_back(bitwidth);
+  }
+
+  return ::util::OkStatus();
+}
+
+}  // namespace
+
+NikssDigestManager::NikssDigestManager(NikssInterface* nikss_interface,
+                                       int pipeline_id)
+    : initialized_(false),
+      shutdown_(false),
+      writer_(nullptr),
+      digests_(),
+      session_(nullptr),
+      digest_thread_id_(),
+      digests_received_(0),
+      digests_suppressed_(0),
+      digests_unconfigured_(0),
+      lists_sent_(0),
+      lists_dropped_(0),
+      lists_expired_(0),
+      read_errors_(0),
+      nikss_interface_(nikss_interface),
+      pipeline_id_(pipeline_id) {}
+
+NikssDigestManager::NikssDigestManager() : NikssDigestManager(nullptr, 0) {}
+
+NikssDigestManager::~NikssDigestManager() {}
+
+std::unique_ptr<NikssDigestManager> NikssDigestManager::CreateInstance(
+    NikssInterface* nikss_interface, int pipeline_id) {
+  return absl::WrapUnique(
+      new NikssDigestManager(ABSL_DIE_IF_NULL(nikss_interface), pipeline_id));
+}
+
+::util::Status NikssDigestManager::PushForwardingPipelineConfig(
+    const ::p4::config::v1::P4Info& p4info) {
+  absl::WriterMutexLock l(&data_lock_);
+  absl::flat_hash_map<uint32, DigestState> digests;
+  RETURN_IF_ERROR(BuildDigestStates(p4info, &digests));
+  // The session is re-created, as the pipeline may have been replaced.
+  ASSIGN_OR_RETURN(auto session, nikss_interface_->CreateSession(pipeline_id_));
+  digests_ = std::move(digests);
+  session_ = session;
+
+  if (!initialized_) {
+    shutdown_ = false;
+    int ret = pthread_create(&digest_thread_id_, nullptr,
+                             &NikssDigestManager::DigestThreadFunc, this);
+    if (ret != 0) {
+      digest_thread_id_ = 0;
+      return MAKE_ERROR(ERR_INTERNAL)
+             << "Failed to spawn digest thread for pipeline " << pipeline_id_
+             << ". Err: " << ret << ".";
+    }
+    initialized_ = true;
+  }
+
+  return ::util::OkStatus();
+}
+
+::util::Status NikssDigestManager::BuildDigestStates(
+    const ::p4::config::v1::P4Info& p4info,
+    absl::flat_hash_map<uint32, DigestState>* digests) {
+  for (const auto& digest : p4info.digests()) {
+    DigestState state;
+    state.digest = digest;
+    RETURN_IF_ERROR(DigestBitwidths(p4info, digest, &state.bitwidths));
+    state.configured = false;
+    state.next_list_id = 1;
+    // The controller configuration of an unchanged digest is carried over.
+    // Pending and unacknowledged digests belong to the previous pipeline.
+    const auto* old_state = gtl::FindOrNull(digests_, digest.preamble().id());
+    if (old_state &&
+        old_state->digest.preamble().name() == digest.preamble().name() &&
+        old_state->bitwidths == state.bitwidths) {
+      state.configured = old_state->configured;
+      state.config = old_state->config;
+      state.next_list_id = old_state->next_list_id;
+    }
+    digests->emplace(digest.preamble().id(), std::move(state));
+  }
+
+  return ::util::OkStatus();
+}
+
+::util::Status NikssDigestManager::Shutdown() {
+  ::util::Status status;
+  {
+    absl::WriterMutexLock l(&writer_lock_);
+    writer_ = nullptr;
+  }
+  pthread_t digest_thread_id;
+  {
+    absl::WriterMutexLock l(&data_lock_);
+    shutdown_ = true;
+    digest_thread_id = digest_thread_id_;
+  }
+  // The thread is joined without holding data_lock_, as it acquires it while
+  // running.
+  if (digest_thread_id != 0 && pthread_join(digest_thread_id, nullptr) != 0) {
+    ::util::Status error = MAKE_ERROR(ERR_INTERNAL)
+                           << "Failed to join thread " << digest_thread_id;
+    APPEND_STATUS_IF_ERROR(status, error);
+  }
+  {
+    absl::WriterMutexLock l(&data_lock_);
+    digests_.clear();
+    session_.reset();
+    digest_thread_id_ = 0;
+    initialized_ = false;
+  }
+  LOG(INFO) << "Digests of pipeline " << pipeline_id_ << " stopped: "
+            << digests_received_ << " digests received, "
+            << digests_suppressed_ << " suppressed, " << digests_unconfigured_
+            << " unconfigured; " << lists_sent_ << " lists sent, "
+            << lists_dropped_ << " dropped, " << lists_expired_
+            << " expired; " << read_errors_ << " read errors.";
+
+  return status;
+}
+
+::util::Status NikssDigestManager::RegisterDigestListWriter(
+    const std::shared_ptr<WriterInterface<::p4::v1::DigestList>>& writer) {
+  absl::WriterMutexLock l(&writer_lock_);
+  writer_ = writer;
+  return ::util::OkStatus();
+}
+
+::util::Status NikssDigestManager::UnregisterDigestListWriter() {
+  absl::WriterMutexLock l(&writer_lock_);
+  writer_ = nullptr;
+  return ::util::OkStatus();
+}
+
+::util::Status NikssDigestManager::WriteDigestEntry(
+    const ::p4::v1::Update::Type type,
+    const ::p4::v1::DigestEntry& digest_entry) {
+  absl::WriterMutexLock l(&data_lock_);
+  auto* state = gtl::FindOrNull(digests_, digest_entry.digest_id());
+  if (!state) {
+    return MAKE_ERROR(ERR_ENTRY_NOT_FOUND)
+           << "Digest with ID " << digest_entry.digest_id() << " not found.";
+  }
+  switch (type) {
+    case ::p4::v1::Update::INSERT:
+      if (state->configured) {
+        return MAKE_ERROR(ERR_ENTRY_EXISTS)
+               << "Digest " << state->digest.preamble().name()
+               << " is already configured.";
+      }
+      break;
+    case ::p4::v1::Update::MODIFY:
+    case ::p4::v1::Update::DELETE:
+      if (!state->configured) {
+        return MAKE_ERROR(ERR_ENTRY_NOT_FOUND)
+               << "Digest " << state->digest.preamble().name()
+               << " is not configured.";
+      }
+      break;
+    default:
+      return MAKE_ERROR(ERR_INVALID_PARAM)
+             << "Unsupported update type: " << type;
+  }
+
+  if (type == ::p4::v1::Update::DELETE) {
+    ResetDigestState(state);
+    state->configured = false;
+    state->config.Clear();
+    return ::util::OkStatus();
+  }
+
+  const auto& config = digest_entry.config();
+  RET_CHECK(config.max_timeout_ns() >= 0 && config.max_list_size() >= 0 &&
+            config.ack_timeout_ns() >= 0)
+      << "Invalid config of digest " << state->digest.preamble().name()
+      << ": " << config.ShortDebugString() << ".";
+  if (config.ack_timeout_ns() == 0) {
+    // Without acknowledgments, no digests are suppressed.
+    state->pending_keys.clear();
+    state->unacked_data.clear();
+    state->outstanding_lists.clear();
+  }
+  state->config = config;
+  state->configured = true;
+
+  return ::util::OkStatus();
+}
+
+::util::Status NikssDigestManager::ReadDigestEntry(
+    const ::p4::v1::DigestEntry& digest_entry,
+    WriterInterface<::p4::v1::DigestEntry>* writer) {
+  RET_CHECK(writer) << "Writer must be non-null.";
+  absl::ReaderMutexLock l(&data_lock_);
+  ::p4::v1::DigestEntry result;
+  if (digest_entry.digest_id() != 0) {
+    const auto* state = gtl::FindOrNull(digests_, digest_entry.digest_id());
+    if (!state || !state->configured) {
+      return MAKE_ERROR(ERR_ENTRY_NOT_FOUND)
+             << "Digest with ID " << digest_entry.digest_id()
+             << " is not configured.";
+    }
+    result.set_digest_id(digest_entry.digest_id());
+    *result.mutable_config() = state->config;
+    RET_CHECK(writer->Write(result)) << "Write to stream channel failed.";
+    return ::util::OkStatus();
+  }
+
+  // Wildcard read of all configured digests.
+  for (const auto& e : digests_) {
+    if (!e.second.configured) continue;
+    result.set_digest_id(e.first);
+    *result.mutable_config() = e.second.config;
+    RET_CHECK(writer->Write(result)) << "Write to stream channel failed.";
+  }
+
+  return ::util::OkStatus();
+}
+
+::util::Status NikssDigestManager::HandleDigestListAck(
+    const ::p4::v1::DigestListAck& ack) {
+  absl::WriterMutexLock l(&data_lock_);
+  auto* state = gtl::FindOrNull(digests_, ack.digest_id());
+  if (!state) {
+    return MAKE_ERROR(ERR_ENTRY_NOT_FOUND)
+           << "Digest with ID " << ack.digest_id() << " not found.";
+  }
+  auto* list = gtl::FindOrNull(state->outstanding_lists, ack.list_id());
+  if (!list) {
+    // The list has expired already, or acknowledgments are not used.
+    VLOG(1) << "Ignored ack of unknown list " << ack.list_id() << " of digest "
+            << state->digest.preamble().name() << ".";
+    return ::util::OkStatus();
+  }
+  for (const auto& key : list->keys) {
+    auto it = state->unacked_data.find(key);
+    if (it != state->unacked_data.end() && it->second == ack.list_id()) {
+      state->unacked_data.erase(it);
+    }
+  }
+  state->outstanding_lists.erase(ack.list_id());
+
+  return ::util::OkStatus();
+}
+
+NikssDigestManager::DigestStats NikssDigestManager::GetStats() {
+  DigestStats stats;
+  stats.digests_received = digests_received_;
+  stats.digests_suppressed = digests_suppressed_;
+  stats.digests_unconfigured = digests_unconfigured_;
+  stats.lists_sent = lists_sent_;
+  stats.lists_dropped = lists_dropped_;
+  stats.lists_expired = lists_expired_;
+  stats.read_errors = read_errors_;
+  return stats;
+}
+
+void NikssDigestManager::AddDigests(DigestState* state,
+                                    std::vector<::p4::v1::P4Data>* digests,
+                                    absl::Time now,
+                                    std::vector<::p4::v1::DigestList>* ready) {
+  const auto& config = state->config;
+  // Without a timeout, every digest is sent in a list of its own.
+  int max_list_size = config.max_list_size() > 0 ? config.max_list_size()
+                                                 : kDefaultMaxListSize;
+  if (config.max_timeout_ns() == 0) max_list_size = 1;
+  const bool suppress_duplicates = config.ack_timeout_ns() > 0;
+
+  for (auto& data : *digests) {
+    if (suppress_duplicates) {
+      std::string key = data.SerializeAsString();
+      if (!state->unacked_data.emplace(key, state->next_list_id).second) {
+        ++digests_suppressed_;
+        continue;
+      }
+      state->pending_keys.push_back(std::move(key));
+    }
+    if (state->pending.data_size() == 0) state->pending_since = now;
+    state->pending.add_data()->Swap(&data);
+    if (state->pending.data_size() >= max_list_size) {
+      ready->push_back(TakePendingList(state, now));
+    }
+  }
+}
+
+::p4::v1::DigestList NikssDigestManager::TakePendingList(DigestState* state,
+                                                        absl::Time now) {
+  ::p4::v1::DigestList list;
+  list.Swap(&state->pending);
+  list.set_digest_id(state->digest.preamble().id());
+  list.set_list_id(state->next_list_id++);
+  list.set_timestamp(absl::ToUnixNanos(now));
+  if (state->config.ack_timeout_ns() > 0) {
+    auto& outstanding = state->outstanding_lists[list.list_id()];
+    outstanding.deadline =
+        now + absl::Nanoseconds(state->config.ack_timeout_ns());
+    outstanding.keys = std::move(state->pending_keys);
+  }
+  state->pending_keys.clear();
+  return list;
+}
+
+void NikssDigestManager::ExpireOutstandingLists(DigestState* state,
+                                                absl::Time now) {
+  for (auto it = state->outstanding_lists.begin();
+       it != state->outstanding_lists.end();) {
+    if (it->second.deadline > now) {
+      ++it;
+      continue;
+    }
+    for (const auto& key : it->second.keys) {
+      auto data_it = state->unacked_data.find(key);
+      if (data_it != state->unacked_data.end() &&
+          data_it->second == it->first) {
+        state->unacked_data.erase(data_it);
+      }
+    }
+    ++lists_expired_;
+    state->outstanding_lists.erase(it++);
+  }
+}
+
+void NikssDigestManager::ResetDigestState(DigestState* state) {
+  state->pending.Clear();
+  state->pending_keys.clear();
+  state->unacked_data.clear();
+  state->outstanding_lists.clear();
+}
+
+bool NikssDigestManager::PollDigestQueues(
+    absl::Time now, std::vector<::p4::v1::P4Data>* digests,
+    std::vector<::p4::v1::DigestList>* ready) {
+  bool drained = true;
+  {
+    absl::WriterMutexLock l(&data_lock_);
+    for (auto& e : digests_) {
+      DigestState* state = &e.second;
+      digests->clear();
+      // Digests are drained even if not configured, so that the queue does
+      // not fill up with stale digests.
+      auto status = nikss_interface_->ReadDigests(
+          session_, state->digest, state->bitwidths, kMaxDigestsPerRead,
+          digests);
+      if (!status.ok()) {
+        ++read_errors_;
+        LOG_EVERY_N(ERROR, 1000)
+            << "Failed to read digest " << state->digest.preamble().name()
+            << ": " << status.error_message();
+      }
+      digests_received_ += digests->size();
+      if (digests->size() >= kMaxDigestsPerRead) drained = false;
+      if (!state->configured) {
+        digests_unconfigured_ += digests->size();
+        continue;
+      }
+      // Data whose ack timed out is accepted again right away.
+      ExpireOutstandingLists(state, now);
+      AddDigests(state, digests, now, ready);
+      if (state->pending.data_size() > 0 &&
+          now - state->pending_since >=
+              absl::Nanoseconds(state->config.max_timeout_ns())) {
+        ready->push_back(TakePendingList(state, now));
+      }
+    }
+  }
+
+  // The lists are handed over without holding data_lock_, so that a slow
+  // controller does not block configuration changes and acks. Lists dropped
+  // here are suppressed until their ack timeout like lost ones.
+  if (!ready->empty()) {
+    absl::WriterMutexLock l(&writer_lock_);
+    for (const auto& list : *ready) {
+      if (writer_ && writer_->Write(list)) {
+        ++lists_sent_;
+      } else {
+        ++lists_dropped_;
+      }
+    }
+    ready->clear();
+  }
+
+  return drained;
+}
+
+void NikssDigestManager::HandleDigests() {
+  // Reused across polls to keep their allocations.
+  std::vector<::p4::v1::P4Data> digests;
+  std::vector<::p4::v1::DigestList> ready;
+  while (!shutdown_) {
+    if (PollDigestQueues(absl::Now(), &digests, &ready)) {
+      absl::SleepFor(absl::Microseconds(FLAGS_nikss_digest_poll_interval_us));
+    }
+  }
+}
+
+void* NikssDigestManager::DigestThreadFunc(void* arg) {
+  NikssDigestManager* mgr = reinterpret_cast<NikssDigestManager*>(arg);
+  mgr->HandleDigests();
+  return nullptr;
+}
+
+}  // namespace nikss
+}  // namespace hal
+}  // namespace stratum
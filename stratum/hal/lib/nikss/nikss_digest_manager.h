@@ -0,0 +1,213 @@
+#ifndef STRATUM_HAL_LIB_NIKSS_NIKSS_DIGEST_MANAGER_H_
+#define STRATUM_HAL_LIB_NIKSS_NIKSS_DIGEST_MANAGER_H_
+
+#include <pthread.h>
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "p4/config/v1/p4info.pb.h"
+#include "p4/v1/p4runtime.pb.h"
+#include "stratum/glue/integral_types.h"
+#include "stratum/glue/status/status.h"
+#include "stratum/hal/lib/common/writer_interface.h"
+#include "stratum/hal/lib/nikss/nikss_interface.h"
+
+namespace stratum {
+namespace hal {
+namespace nikss {
+
+// The NikssDigestManager streams the digests of a NIKSS pipeline to the
+// controller. A dedicated thread drains the PSA digest queues in bursts and
+// batches the digests into DigestLists as configured by the DigestEntries of
+// the controller: a list is sent once it holds max_list_size digests or its
+// oldest digest has waited max_timeout_ns. Digest data which has been sent is
+// not sent again until the list is acknowledged or ack_timeout_ns elapses.
+class NikssDigestManager {
+ public:
+  // Digest counters.
+  struct DigestStats {
+    uint64 digests_received;      // Digests read from the pipeline.
+    uint64 digests_suppressed;    // Duplicates of unacknowledged digests.
+    uint64 digests_unconfigured;  // Digests without a DigestEntry.
+    uint64 lists_sent;            // DigestLists handed over to the controller.
+    uint64 lists_dropped;         // DigestLists dropped, no controller.
+    uint64 lists_expired;         // DigestLists not acknowledged in time.
+    uint64 read_errors;           // Failed reads of a digest queue.
+  };
+
+  virtual ~NikssDigestManager();
+
+  // Pushes the forwarding pipeline to this class. If this is the first time, it
+  // will also start the digest thread. The configuration of digests which are
+  // part of the new pipeline is kept.
+  virtual ::util::Status PushForwardingPipelineConfig(
+      const ::p4::config::v1::P4Info& p4info) LOCKS_EXCLUDED(data_lock_);
+
+  // Stops the digest thread and drops all digest configurations.
+  virtual ::util::Status Shutdown() LOCKS_EXCLUDED(data_lock_);
+
+  // Registers a writer to be invoked when a DigestList is ready.
+  virtual ::util::Status RegisterDigestListWriter(
+      const std::shared_ptr<WriterInterface<::p4::v1::DigestList>>& writer)
+      LOCKS_EXCLUDED(writer_lock_);
+
+  virtual ::util::Status UnregisterDigestListWriter()
+      LOCKS_EXCLUDED(writer_lock_);
+
+  // Inserts, modifies or deletes the configuration of a digest.
+  virtual ::util::Status WriteDigestEntry(
+      const ::p4::v1::Update::Type type,
+      const ::p4::v1::DigestEntry& digest_entry) LOCKS_EXCLUDED(data_lock_);
+
+  // Reads the configuration of the given digest, or of all configured digests
+  // if the digest ID is 0.
+  virtual ::util::Status ReadDigestEntry(
+      const ::p4::v1::DigestEntry& digest_entry,
+      WriterInterface<::p4::v1::DigestEntry>* writer)
+      LOCKS_EXCLUDED(data_lock_);
+
+  // Acknowledges a DigestList, so that its data can be sent again.
+  virtual ::util::Status HandleDigestListAck(
+      const ::p4::v1::DigestListAck& ack) LOCKS_EXCLUDED(data_lock_);
+
+  // Returns a snapshot of the digest counters.
+  virtual DigestStats GetStats();
+
+  // Factory function for creating the instance of the class.
+  static std::unique_ptr<NikssDigestManager> CreateInstance(
+      NikssInterface* nikss_interface, int pipeline_id);
+
+  // NikssDigestManager is neither copyable nor movable.
+  NikssDigestManager(const NikssDigestManager&) = delete;
+  NikssDigestManager& operator=(const NikssDigestManager&) = delete;
+
+ protected:
+  // Default constructor. To be called by the Mock class instance only.
+  NikssDigestManager();
+
+ private:
+  // A DigestList which has been sent but not acknowledged yet.
+  struct OutstandingList {
+    absl::Time deadline;
+    // Serialized data of the digests in the list.
+    std::vector<std::string> keys;
+  };
+
+  // State of a single digest of the pipeline.
+  struct DigestState {
+    ::p4::config::v1::Digest digest;
+    // Bit widths of the digest bitstring or of each struct member.
+    std::vector<int> bitwidths;
+    // Set if the controller has inserted a DigestEntry for the digest.
+    bool configured;
+    ::p4::v1::DigestEntry::Config config;
+    // The list being filled and the time its first digest arrived.
+    ::p4::v1::DigestList pending;
+    std::vector<std::string> pending_keys;
+    absl::Time pending_since;
+    uint64 next_list_id;
+    // Map from serialized digest data to the list ID it was sent or is about
+    // to be sent with. Only maintained if ack_timeout_ns is set.
+    absl::flat_hash_map<std::string, uint64> unacked_data;
+    absl::flat_hash_map<uint64, OutstandingList> outstanding_lists;
+  };
+
+  // Private constructor. Use CreateInstance() to create an instance of this
+  // class.
+  NikssDigestManager(NikssInterface* nikss_interface, int pipeline_id);
+
+  // Builds the states of the digests of a pipeline. The configuration of
+  // unchanged digests is taken over from the running pipeline.
+  ::util::Status BuildDigestStates(
+      const ::p4::config::v1::P4Info& p4info,
+      absl::flat_hash_map<uint32, DigestState>* digests)
+      SHARED_LOCKS_REQUIRED(data_lock_);
+
+  // Adds newly read digests to the pending list of a digest. Full lists are
+  // moved to ready.
+  void AddDigests(DigestState* state, std::vector<::p4::v1::P4Data>* digests,
+                  absl::Time now, std::vector<::p4::v1::DigestList>* ready)
+      EXCLUSIVE_LOCKS_REQUIRED(data_lock_);
+
+  // Finalizes the pending list of a digest, assigning its list ID.
+  ::p4::v1::DigestList TakePendingList(DigestState* state, absl::Time now)
+      EXCLUSIVE_LOCKS_REQUIRED(data_lock_);
+
+  // Forgets the data of lists which have not been acknowledged in time.
+  void ExpireOutstandingLists(DigestState* state, absl::Time now)
+      EXCLUSIVE_LOCKS_REQUIRED(data_lock_);
+
+  // Drops the pending list and all unacknowledged data of a digest.
+  static void ResetDigestState(DigestState* state);
+
+  // Reads all the digest queues once and sends the lists which are full or
+  // have timed out at 'now'. The vectors are scratch buffers reused across
+  // calls. Returns false if a queue may still hold digests.
+  bool PollDigestQueues(absl::Time now,
+                        std::vector<::p4::v1::P4Data>* digests,
+                        std::vector<::p4::v1::DigestList>* ready)
+      LOCKS_EXCLUDED(data_lock_, writer_lock_);
+
+  // Drains the digest queues until shutdown.
+  void HandleDigests() LOCKS_EXCLUDED(data_lock_, writer_lock_);
+
+  // Digest thread function.
+  static void* DigestThreadFunc(void* arg);
+
+  // Mutex lock for protecting writer_.
+  mutable absl::Mutex writer_lock_;
+
+  // Mutex lock to protect the digest states and the session.
+  mutable absl::Mutex data_lock_;
+
+  // Initialized to false, set once only on first PushForwardingPipelineConfig.
+  bool initialized_ GUARDED_BY(data_lock_);
+
+  // Set on shutdown to make the digest thread exit.
+  std::atomic<bool> shutdown_;
+
+  // Stores the registered writer for DigestLists.
+  std::shared_ptr<WriterInterface<::p4::v1::DigestList>> writer_
+      GUARDED_BY(writer_lock_);
+
+  // Map from digest ID to the state of the digest.
+  absl::flat_hash_map<uint32, DigestState> digests_ GUARDED_BY(data_lock_);
+
+  // Long-lived session of the digest thread on the running pipeline.
+  std::shared_ptr<NikssInterface::SessionInterface> session_
+      GUARDED_BY(data_lock_);
+
+  // The ID of the digest thread.
+  pthread_t digest_thread_id_ GUARDED_BY(data_lock_);
+
+  // Digest counters.
+  std::atomic<uint64> digests_received_;
+  std::atomic<uint64> digests_suppressed_;
+  std::atomic<uint64> digests_unconfigured_;
+  std::atomic<uint64> lists_sent_;
+  std::atomic<uint64> lists_dropped_;
+  std::atomic<uint64> lists_expired_;
+  std::atomic<uint64> read_errors_;
+
+  // Pointer to a NikssInterface implementation that wraps all the SDE calls.
+  // Not owned by this class.
+  NikssInterface* nikss_interface_;
+
+  // The pipeline whose digests are handled.
+  const int pipeline_id_;
+
+  friend class NikssDigestManagerTest;
+};
+
+}  // namespace nikss
+}  // namespace hal
+}  // namespace stratum
+
+#endif  // STRATUM_HAL_LIB_NIKSS_NIKSS_DIGEST_MANAGER_H_
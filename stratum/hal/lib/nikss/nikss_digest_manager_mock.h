@@ -0,0 +1,39 @@
+#ifndef STRATUM_HAL_LIB_NIKSS_NIKSS_DIGEST_MANAGER_MOCK_H_
+#define STRATUM_HAL_LIB_NIKSS_NIKSS_DIGEST_MANAGER_MOCK_H_
+
+#include <memory>
+
+#include "gmock/gmock.h"
+#include "stratum/hal/lib/nikss/nikss_digest_manager.h"
+
+namespace stratum {
+namespace hal {
+namespace nikss {
+
+class NikssDigestManagerMock : public NikssDigestManager {
+ public:
+  MOCK_METHOD1(PushForwardingPipelineConfig,
+               ::util::Status(const ::p4::config::v1::P4Info& p4info));
+  MOCK_METHOD0(Shutdown, ::util::Status());
+  MOCK_METHOD1(
+      RegisterDigestListWriter,
+      ::util::Status(
+          const std::shared_ptr<WriterInterface<::p4::v1::DigestList>>&
+              writer));
+  MOCK_METHOD0(UnregisterDigestListWriter, ::util::Status());
+  MOCK_METHOD2(WriteDigestEntry,
+               ::util::Status(const ::p4::v1::Update::Type type,
+                              const ::p4::v1::DigestEntry& digest_entry));
+  MOCK_METHOD2(ReadDigestEntry,
+               ::util::Status(const ::p4::v1::DigestEntry& digest_entry,
+                              WriterInterface<::p4::v1::DigestEntry>* writer));
+  MOCK_METHOD1(HandleDigestListAck,
+               ::util::Status(const ::p4::v1::DigestListAck& ack));
+  MOCK_METHOD0(GetStats, DigestStats());
+};
+
+}  // namespace nikss
+}  // namespace hal
+}  // namespace stratum
+
+#endif  // STRATUM_HAL_LIB_NIKSS_NIKSS_DIGEST_MANAGER_MOCK_H_
@@ -0,0 +1,253 @@
+#include "stratum/hal/lib/nikss/nikss_digest_manager.h"
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/memory/memory.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "p4/v1/p4runtime.pb.h"
+#include "stratum/glue/status/status_macros.h"
+#include "stratum/glue/status/status_test_util.h"
+#include "stratum/hal/lib/common/writer_mock.h"
+#include "stratum/hal/lib/nikss/nikss_interface_mock.h"
+#include "stratum/lib/test_utils/matchers.h"
+#include "stratum/lib/utils.h"
+
+namespace stratum {
+namespace hal {
+namespace nikss {
+
+using test_utils::EqualsProto;
+using ::testing::_;
+using ::testing::DoAll;
+using ::testing::ElementsAre;
+using ::testing::Invoke;
+using ::testing::Return;
+using ::testing::SetArgPointee;
+
+namespace {
+
+// The MAC addresses contain zero bytes, so their length is given explicitly.
+std::string Mac(const char* mac) { return std::string(mac, 6); }
+
+}  // namespace
+
+class NikssDigestManagerTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    nikss_interface_mock_ = absl::make_unique<NikssInterfaceMock>();
+    session_mock_ = std::make_shared<SessionMock>();
+    digest_manager_ = NikssDigestManager::CreateInstance(
+        nikss_interface_mock_.get(), kPipelineId);
+    digest_list_writer_ =
+        std::make_shared<WriterMock<::p4::v1::DigestList>>();
+    ON_CALL(*digest_list_writer_, Write(_))
+        .WillByDefault(Invoke([this](const ::p4::v1::DigestList& list) {
+          lists_.push_back(list);
+          return true;
+        }));
+    ASSERT_OK(digest_manager_->RegisterDigestListWriter(digest_list_writer_));
+    ASSERT_OK(BuildDigestStates());
+    start_ = absl::Now();
+  }
+
+  // Sets up the digests of kP4Info without starting the digest thread, so
+  // that the queues are only polled by the test.
+  ::util::Status BuildDigestStates() {
+    ::p4::config::v1::P4Info p4info;
+    RETURN_IF_ERROR(ParseProtoFromString(kP4Info, &p4info));
+    digest_ = p4info.digests(0);
+    absl::WriterMutexLock l(&digest_manager_->data_lock_);
+    absl::flat_hash_map<uint32, NikssDigestManager::DigestState> digests;
+    RETURN_IF_ERROR(digest_manager_->BuildDigestStates(p4info, &digests));
+    digest_manager_->digests_ = std::move(digests);
+    digest_manager_->session_ = session_mock_;
+    return ::util::OkStatus();
+  }
+
+  // Configures the digest of kP4Info.
+  ::util::Status ConfigureDigest(int64 max_timeout_ns, int32 max_list_size,
+                                 int64 ack_timeout_ns) {
+    ::p4::v1::DigestEntry entry;
+    entry.set_digest_id(kDigestId);
+    entry.mutable_config()->set_max_timeout_ns(max_timeout_ns);
+    entry.mutable_config()->set_max_list_size(max_list_size);
+    entry.mutable_config()->set_ack_timeout_ns(ack_timeout_ns);
+    return digest_manager_->WriteDigestEntry(::p4::v1::Update::INSERT, entry);
+  }
+
+  // Polls the digest queue at 'elapsed' after the start of the test. The
+  // queue yields the given MAC addresses.
+  void Poll(absl::Duration elapsed,
+            const std::vector<std::string>& macs = {}) {
+    std::vector<::p4::v1::P4Data> data;
+    for (const auto& mac : macs) {
+      data.push_back(::p4::v1::P4Data());
+      data.back().set_bitstring(mac);
+    }
+    EXPECT_CALL(*nikss_interface_mock_,
+                ReadDigests(_, EqualsProto(digest_), ElementsAre(48), _, _))
+        .WillOnce(DoAll(SetArgPointee<4>(data), Return(::util::OkStatus())));
+    std::vector<::p4::v1::P4Data> digests;
+    std::vector<::p4::v1::DigestList> ready;
+    digest_manager_->PollDigestQueues(start_ + elapsed, &digests, &ready);
+    ::testing::Mock::VerifyAndClearExpectations(nikss_interface_mock_.get());
+  }
+
+  // Returns the data of a list.
+  static std::vector<std::string> ListData(const ::p4::v1::DigestList& list) {
+    std::vector<std::string> macs;
+    for (const auto& data : list.data()) macs.push_back(data.bitstring());
+    return macs;
+  }
+
+  static constexpr int kPipelineId = 1;
+  static constexpr uint32 kDigestId = 385875969;
+  static constexpr char kP4Info[] = R"pb(
+    digests {
+      preamble {
+        id: 385875969
+        name: "mac_learn_digest"
+        alias: "mac_learn_digest"
+      }
+      type_spec { bitstring { bit { bitwidth: 48 } } }
+    }
+  )pb";
+  static constexpr char kMacA[] = "\x00\x00\x00\x00\x00\x0a";
+  static constexpr char kMacB[] = "\x00\x00\x00\x00\x00\x0b";
+
+  std::unique_ptr<NikssInterfaceMock> nikss_interface_mock_;
+  std::shared_ptr<SessionMock> session_mock_;
+  std::unique_ptr<NikssDigestManager> digest_manager_;
+  std::shared_ptr<WriterMock<::p4::v1::DigestList>> digest_list_writer_;
+  ::p4::config::v1::Digest digest_;
+  // The lists written to digest_list_writer_.
+  std::vector<::p4::v1::DigestList> lists_;
+  absl::Time start_;
+};
+
+constexpr int NikssDigestManagerTest::kPipelineId;
+constexpr uint32 NikssDigestManagerTest::kDigestId;
+constexpr char NikssDigestManagerTest::kP4Info[];
+constexpr char NikssDigestManagerTest::kMacA[];
+constexpr char NikssDigestManagerTest::kMacB[];
+
+TEST_F(NikssDigestManagerTest, ListIsSentWhenFull) {
+  ASSERT_OK(
+      ConfigureDigest(absl::ToInt64Nanoseconds(absl::Seconds(10)), 2, 0));
+  EXPECT_CALL(*digest_list_writer_, Write(_)).Times(1);
+
+  Poll(absl::ZeroDuration(), {Mac(kMacA)});
+  EXPECT_TRUE(lists_.empty());
+  Poll(absl::Milliseconds(1), {Mac(kMacB)});
+  ASSERT_EQ(1U, lists_.size());
+  EXPECT_EQ(kDigestId, lists_[0].digest_id());
+  EXPECT_EQ(1U, lists_[0].list_id());
+  EXPECT_EQ(absl::ToUnixNanos(start_ + absl::Milliseconds(1)),
+            lists_[0].timestamp());
+  EXPECT_THAT(ListData(lists_[0]), ElementsAre(Mac(kMacA), Mac(kMacB)));
+
+  auto stats = digest_manager_->GetStats();
+  EXPECT_EQ(2U, stats.digests_received);
+  EXPECT_EQ(1U, stats.lists_sent);
+}
+
+TEST_F(NikssDigestManagerTest, ListIsSentAfterMaxTimeout) {
+  ASSERT_OK(ConfigureDigest(
+      absl::ToInt64Nanoseconds(absl::Milliseconds(100)), 10, 0));
+  EXPECT_CALL(*digest_list_writer_, Write(_)).Times(1);
+
+  Poll(absl::ZeroDuration(), {Mac(kMacA)});
+  Poll(absl::Milliseconds(50), {Mac(kMacB)});
+  EXPECT_TRUE(lists_.empty());
+  // The timeout runs from the first digest of the list.
+  Poll(absl::Milliseconds(100));
+  ASSERT_EQ(1U, lists_.size());
+  EXPECT_THAT(ListData(lists_[0]), ElementsAre(Mac(kMacA), Mac(kMacB)));
+}
+
+TEST_F(NikssDigestManagerTest, ZeroMaxTimeoutSendsEveryDigest) {
+  ASSERT_OK(ConfigureDigest(0, 10, 0));
+  EXPECT_CALL(*digest_list_writer_, Write(_)).Times(2);
+
+  Poll(absl::ZeroDuration(), {Mac(kMacA), Mac(kMacB)});
+  ASSERT_EQ(2U, lists_.size());
+  EXPECT_EQ(1U, lists_[0].list_id());
+  EXPECT_THAT(ListData(lists_[0]), ElementsAre(Mac(kMacA)));
+  EXPECT_EQ(2U, lists_[1].list_id());
+  EXPECT_THAT(ListData(lists_[1]), ElementsAre(Mac(kMacB)));
+}
+
+TEST_F(NikssDigestManagerTest, DuplicatesAreSuppressedUntilAck) {
+  ASSERT_OK(ConfigureDigest(0, 1, absl::ToInt64Nanoseconds(absl::Seconds(1))));
+  EXPECT_CALL(*digest_list_writer_, Write(_)).Times(2);
+
+  Poll(absl::ZeroDuration(), {Mac(kMacA)});
+  ASSERT_EQ(1U, lists_.size());
+  Poll(absl::Milliseconds(1), {Mac(kMacA)});
+  EXPECT_EQ(1U, lists_.size());
+  EXPECT_EQ(1U, digest_manager_->GetStats().digests_suppressed);
+
+  // Once acknowledged, the data is sent again.
+  ::p4::v1::DigestListAck ack;
+  ack.set_digest_id(kDigestId);
+  ack.set_list_id(lists_[0].list_id());
+  EXPECT_OK(digest_manager_->HandleDigestListAck(ack));
+  Poll(absl::Milliseconds(2), {Mac(kMacA)});
+  ASSERT_EQ(2U, lists_.size());
+  EXPECT_EQ(2U, lists_[1].list_id());
+  EXPECT_THAT(ListData(lists_[1]), ElementsAre(Mac(kMacA)));
+  EXPECT_EQ(0U, digest_manager_->GetStats().lists_expired);
+}
+
+TEST_F(NikssDigestManagerTest, DuplicatesAreSentAgainAfterAckTimeout) {
+  ASSERT_OK(ConfigureDigest(
+      0, 1, absl::ToInt64Nanoseconds(absl::Milliseconds(100))));
+  EXPECT_CALL(*digest_list_writer_, Write(_)).Times(2);
+
+  Poll(absl::ZeroDuration(), {Mac(kMacA)});
+  Poll(absl::Milliseconds(50), {Mac(kMacA)});
+  EXPECT_EQ(1U, lists_.size());
+  // The unacknowledged list expires and the data is accepted again.
+  Poll(absl::Milliseconds(100), {Mac(kMacA)});
+  ASSERT_EQ(2U, lists_.size());
+  EXPECT_THAT(ListData(lists_[1]), ElementsAre(Mac(kMacA)));
+
+  auto stats = digest_manager_->GetStats();
+  EXPECT_EQ(1U, stats.digests_suppressed);
+  EXPECT_EQ(1U, stats.lists_expired);
+  // A late ack of the expired list is ignored.
+  ::p4::v1::DigestListAck ack;
+  ack.set_digest_id(kDigestId);
+  ack.set_list_id(1);
+  EXPECT_OK(digest_manager_->HandleDigestListAck(ack));
+}
+
+TEST_F(NikssDigestManagerTest, UnconfiguredDigestsAreDrained) {
+  EXPECT_CALL(*digest_list_writer_, Write(_)).Times(0);
+
+  Poll(absl::ZeroDuration(), {Mac(kMacA), Mac(kMacB)});
+  auto stats = digest_manager_->GetStats();
+  EXPECT_EQ(2U, stats.digests_received);
+  EXPECT_EQ(2U, stats.digests_unconfigured);
+}
+
+TEST_F(NikssDigestManagerTest, ListsAreDroppedWithoutWriter) {
+  ASSERT_OK(ConfigureDigest(0, 1, 0));
+  ASSERT_OK(digest_manager_->UnregisterDigestListWriter());
+
+  Poll(absl::ZeroDuration(), {Mac(kMacA)});
+  auto stats = digest_manager_->GetStats();
+  EXPECT_EQ(0U, stats.lists_sent);
+  EXPECT_EQ(1U, stats.lists_dropped);
+}
+
+}  // namespace nikss
+}  // namespace hal
+}  // namespace stratum
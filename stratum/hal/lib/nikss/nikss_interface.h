@@ -1,7 +1,17 @@
 #ifndef STRATUM_HAL_LIB_NIKSS_NIKSS_INTERFACE_H_
 #define STRATUM_HAL_LIB_NIKSS_NIKSS_INTERFACE_H_
 
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "p4/config/v1/p4info.pb.h"
+#include "p4/v1/p4runtime.pb.h"
+#include "stratum/glue/integral_types.h"
 #include "stratum/glue/status/status.h"
+#include "stratum/glue/status/statusor.h"
+#include "stratum/hal/lib/common/writer_interface.h"
 
 namespace stratum {
 namespace hal {
@@ -9,10 +19,294 @@ namespace nikss {
 
 class NikssInterface {
  public:
+  // SessionInterface is a proxy for a batch of NIKSS operations on a single
+  // pipeline. NIKSS objects (e.g. table contexts holding the BPF map file
+  // descriptors and BTF metadata) opened while processing a batch are kept by
+  // the session and reused by all subsequent operations of the same batch.
+  class SessionInterface {
+   public:
+    virtual ~SessionInterface() {}
+  };
+
+  virtual ~NikssInterface() {}
+
   // Add and initialize a NIKSS pipeline. The pipeline will be loaded
-  // into the Linux eBPF subsystem. Can be used to re-initialize an existing device.
+  // into the Linux eBPF subsystem. Can be used to re-initialize an existing
+  // device: a running pipeline, e.g. left over by a previous instance, is
+  // replaced and its state is not preserved. The traffic of its ports is
+  // interrupted while they are moved to the new pipeline.
   virtual ::util::Status AddPipeline(int pipeline_id,
-                                     const std::string filepath) = 0;
+                                     const std::string& bpf_obj) = 0;
+
+  // Loads a new pipeline next to the running one, without attaching it to any
+  // port. The standby pipeline is populated through a standby session and then
+  // takes over the ports with SwitchToStandbyPipeline().
+  virtual ::util::Status LoadStandbyPipeline(int pipeline_id,
+                                             const std::string& bpf_obj) = 0;
+
+  // Moves all ports of the running pipeline to the standby pipeline, which
+  // becomes the running one, and unloads the previous pipeline. Every port is
+  // moved atomically. If a port cannot be, the switch fails with
+  // ERR_OPER_NOT_SUPPORTED, the previous pipeline keeps running on all ports
+  // and the standby pipeline is unloaded.
+  virtual ::util::Status SwitchToStandbyPipeline(int pipeline_id) = 0;
+
+  // Unloads the standby pipeline, leaving the running one untouched.
+  virtual ::util::Status DiscardStandbyPipeline(int pipeline_id) = 0;
+
+  // Attaches a Linux interface to the pipeline. If the pipeline has not been
+  // loaded yet, the interface is attached once it is.
+  virtual ::util::Status AddPort(int pipeline_id,
+                                 const std::string& port_name) = 0;
+
+  // Detaches a Linux interface from the pipeline.
+  virtual ::util::Status DeletePort(int pipeline_id,
+                                    const std::string& port_name) = 0;
+
+  // Creates a new session for the given pipeline.
+  virtual ::util::StatusOr<std::shared_ptr<SessionInterface>> CreateSession(
+      int pipeline_id) = 0;
+
+  // Creates a new session for the standby pipeline of the given pipeline.
+  virtual ::util::StatusOr<std::shared_ptr<SessionInterface>>
+  CreateStandbySession(int pipeline_id) = 0;
+
+  // Inserts, modifies or deletes a table entry. The P4Info table and action
+  // descriptions are used to translate the P4Runtime entry into NIKSS match
+  // keys and action parameters.
+  virtual ::util::Status WriteTableEntry(
+      std::shared_ptr<SessionInterface> session,
+      const ::p4::v1::Update::Type type, const ::p4::config::v1::Table& table,
+      const ::p4::config::v1::Action& action,
+      const ::p4::v1::TableEntry& table_entry) = 0;
+
+  // Reads the table entries matched by the given entry: the single entry with
+  // the given key if match fields are present, the default entry if
+  // is_default_action is set, or all entries of the table otherwise. The
+  // entries are passed to the writer one at a time while the BPF map is
+  // walked. The P4Info actions of the table are needed to translate the
+  // NIKSS actions back.
+  virtual ::util::Status ReadTableEntries(
+      std::shared_ptr<SessionInterface> session,
+      const ::p4::config::v1::Table& table,
+      const std::vector<::p4::config::v1::Action>& actions,
+      const ::p4::v1::TableEntry& table_entry,
+      WriterInterface<::p4::v1::TableEntry>* writer) = 0;
+
+  // Sets the value of a single cell of an indirect counter.
+  virtual ::util::Status WriteIndirectCounter(
+      std::shared_ptr<SessionInterface> session,
+      const ::p4::config::v1::Counter& counter,
+      const ::p4::v1::CounterEntry& counter_entry) = 0;
+
+  // Reads the cell of an indirect counter given by the index of the entry, or
+  // all cells if no index is given. All cells are read from a single snapshot
+  // of the counter array.
+  virtual ::util::Status ReadIndirectCounter(
+      std::shared_ptr<SessionInterface> session,
+      const ::p4::config::v1::Counter& counter,
+      const ::p4::v1::CounterEntry& counter_entry,
+      WriterInterface<::p4::v1::CounterEntry>* writer) = 0;
+
+  // Sets the value of the direct counter of a table entry.
+  virtual ::util::Status WriteDirectCounter(
+      std::shared_ptr<SessionInterface> session,
+      const ::p4::config::v1::Table& table,
+      const ::p4::config::v1::DirectCounter& direct_counter,
+      const ::p4::v1::DirectCounterEntry& direct_counter_entry) = 0;
+
+  // Reads the direct counter of the table entry with the given key, or of all
+  // entries of the table if no match fields are given.
+  virtual ::util::Status ReadDirectCounter(
+      std::shared_ptr<SessionInterface> session,
+      const ::p4::config::v1::Table& table,
+      const ::p4::config::v1::DirectCounter& direct_counter,
+      const ::p4::v1::DirectCounterEntry& direct_counter_entry,
+      WriterInterface<::p4::v1::DirectCounterEntry>* writer) = 0;
+
+  // Sets the configuration of a single cell of an indirect meter. A meter entry
+  // without configuration resets the cell to its default, i.e. unmetered.
+  virtual ::util::Status WriteMeter(
+      std::shared_ptr<SessionInterface> session,
+      const ::p4::config::v1::Meter& meter,
+      const ::p4::v1::MeterEntry& meter_entry) = 0;
+
+  // Reads the configuration of the meter cell given by the index of the entry,
+  // or of all cells if no index is given.
+  virtual ::util::Status ReadMeter(
+      std::shared_ptr<SessionInterface> session,
+      const ::p4::config::v1::Meter& meter,
+      const ::p4::v1::MeterEntry& meter_entry,
+      WriterInterface<::p4::v1::MeterEntry>* writer) = 0;
+
+  // Sets the configuration of the direct meter of a table entry.
+  virtual ::util::Status WriteDirectMeter(
+      std::shared_ptr<SessionInterface> session,
+      const ::p4::config::v1::Table& table,
+      const ::p4::config::v1::DirectMeter& direct_meter,
+      const ::p4::v1::DirectMeterEntry& direct_meter_entry) = 0;
+
+  // Reads the direct meter of the table entry with the given key, or of all
+  // entries of the table if no match fields are given.
+  virtual ::util::Status ReadDirectMeter(
+      std::shared_ptr<SessionInterface> session,
+      const ::p4::config::v1::Table& table,
+      const ::p4::config::v1::DirectMeter& direct_meter,
+      const ::p4::v1::DirectMeterEntry& direct_meter_entry,
+      WriterInterface<::p4::v1::DirectMeterEntry>* writer) = 0;
+
+  // Sets the value of a single register cell.
+  virtual ::util::Status WriteRegister(
+      std::shared_ptr<SessionInterface> session,
+      const ::p4::config::v1::Register& reg,
+      const ::p4::v1::RegisterEntry& register_entry) = 0;
+
+  // Reads the register cell given by the index of the entry, or all cells if
+  // no index is given. All cells are read from a single snapshot of the
+  // register array.
+  virtual ::util::Status ReadRegister(
+      std::shared_ptr<SessionInterface> session,
+      const ::p4::config::v1::Register& reg,
+      const ::p4::v1::RegisterEntry& register_entry,
+      WriterInterface<::p4::v1::RegisterEntry>* writer) = 0;
+
+  // Replaces the members of a value set with the members of the given entry.
+  virtual ::util::Status WriteValueSet(
+      std::shared_ptr<SessionInterface> session,
+      const ::p4::config::v1::ValueSet& value_set,
+      const ::p4::v1::ValueSetEntry& value_set_entry) = 0;
+
+  // Reads all members of a value set.
+  virtual ::util::Status ReadValueSet(
+      std::shared_ptr<SessionInterface> session,
+      const ::p4::config::v1::ValueSet& value_set,
+      ::p4::v1::ValueSetEntry* value_set_entry) = 0;
+
+  // Members and groups of action selectors are identified by references which
+  // are allocated by NIKSS, not by the P4Runtime IDs. Table entries of tables
+  // with an action selector carry these references in place of the member and
+  // group IDs, both on write and on read.
+
+  // Adds a member to an action selector and returns its NIKSS reference.
+  virtual ::util::StatusOr<uint32> InsertActionProfileMember(
+      std::shared_ptr<SessionInterface> session,
+      const ::p4::config::v1::ActionProfile& action_profile,
+      const ::p4::config::v1::Action& action_info,
+      const ::p4::v1::Action& action) = 0;
+
+  // Changes the action of a member of an action selector.
+  virtual ::util::Status ModifyActionProfileMember(
+      std::shared_ptr<SessionInterface> session,
+      const ::p4::config::v1::ActionProfile& action_profile,
+      const ::p4::config::v1::Action& action_info,
+      const ::p4::v1::Action& action, uint32 member_ref) = 0;
+
+  // Removes a member from an action selector.
+  virtual ::util::Status DeleteActionProfileMember(
+      std::shared_ptr<SessionInterface> session,
+      const ::p4::config::v1::ActionProfile& action_profile,
+      uint32 member_ref) = 0;
+
+  // Adds an empty group to an action selector and returns its NIKSS
+  // reference.
+  virtual ::util::StatusOr<uint32> InsertActionProfileGroup(
+      std::shared_ptr<SessionInterface> session,
+      const ::p4::config::v1::ActionProfile& action_profile) = 0;
+
+  // Removes a group from an action selector. Its members are kept.
+  virtual ::util::Status DeleteActionProfileGroup(
+      std::shared_ptr<SessionInterface> session,
+      const ::p4::config::v1::ActionProfile& action_profile,
+      uint32 group_ref) = 0;
+
+  // Adds a single member to a group, leaving the other members untouched.
+  virtual ::util::Status AddActionProfileGroupMember(
+      std::shared_ptr<SessionInterface> session,
+      const ::p4::config::v1::ActionProfile& action_profile, uint32 group_ref,
+      uint32 member_ref) = 0;
+
+  // Removes a single member from a group, leaving the other members untouched.
+  virtual ::util::Status RemoveActionProfileGroupMember(
+      std::shared_ptr<SessionInterface> session,
+      const ::p4::config::v1::ActionProfile& action_profile, uint32 group_ref,
+      uint32 member_ref) = 0;
+
+  // Reads all members of an action selector as pairs of NIKSS reference and
+  // action. The P4Info actions of the tables sharing the selector are needed to
+  // translate the NIKSS actions back.
+  virtual ::util::Status ReadActionProfileMembers(
+      std::shared_ptr<SessionInterface> session,
+      const ::p4::config::v1::ActionProfile& action_profile,
+      const std::vector<::p4::config::v1::Action>& actions,
+      std::vector<std::pair<uint32, ::p4::v1::Action>>* members) = 0;
+
+  // Reads all groups of an action selector as pairs of NIKSS group reference
+  // and the references of the group members.
+  virtual ::util::Status ReadActionProfileGroups(
+      std::shared_ptr<SessionInterface> session,
+      const ::p4::config::v1::ActionProfile& action_profile,
+      std::vector<std::pair<uint32, std::vector<uint32>>>* groups) = 0;
+
+  // Creates an empty multicast group.
+  virtual ::util::Status InsertMulticastGroup(
+      std::shared_ptr<SessionInterface> session, uint32 group_id) = 0;
+
+  // Deletes a multicast group together with its replicas.
+  virtual ::util::Status DeleteMulticastGroup(
+      std::shared_ptr<SessionInterface> session, uint32 group_id) = 0;
+
+  // Adds a single replica to a multicast group, leaving the other replicas
+  // untouched.
+  virtual ::util::Status AddMulticastGroupReplica(
+      std::shared_ptr<SessionInterface> session, uint32 group_id,
+      const ::p4::v1::Replica& replica) = 0;
+
+  // Removes a single replica from a multicast group, leaving the other
+  // replicas untouched.
+  virtual ::util::Status RemoveMulticastGroupReplica(
+      std::shared_ptr<SessionInterface> session, uint32 group_id,
+      const ::p4::v1::Replica& replica) = 0;
+
+  // Reads the given multicast group, or all groups if the group ID is 0.
+  virtual ::util::Status ReadMulticastGroups(
+      std::shared_ptr<SessionInterface> session, uint32 group_id,
+      std::vector<::p4::v1::MulticastGroupEntry>* groups) = 0;
+
+  // Creates an empty clone session.
+  virtual ::util::Status InsertCloneSession(
+      std::shared_ptr<SessionInterface> session, uint32 session_id) = 0;
+
+  // Deletes a clone session together with its replicas.
+  virtual ::util::Status DeleteCloneSession(
+      std::shared_ptr<SessionInterface> session, uint32 session_id) = 0;
+
+  // Adds a single replica to a clone session, or updates it if it exists
+  // already. The class of service and the truncation length are taken from the
+  // clone session entry; the replicas of the entry are ignored.
+  virtual ::util::Status AddCloneSessionReplica(
+      std::shared_ptr<SessionInterface> session,
+      const ::p4::v1::CloneSessionEntry& clone_session,
+      const ::p4::v1::Replica& replica) = 0;
+
+  // Removes a single replica from a clone session.
+  virtual ::util::Status RemoveCloneSessionReplica(
+      std::shared_ptr<SessionInterface> session, uint32 session_id,
+      const ::p4::v1::Replica& replica) = 0;
+
+  // Reads the given clone session, or all sessions if the session ID is 0.
+  virtual ::util::Status ReadCloneSessions(
+      std::shared_ptr<SessionInterface> session, uint32 session_id,
+      std::vector<::p4::v1::CloneSessionEntry>* clone_sessions) = 0;
+
+  // Pops up to max_digests digests from the queue of the given digest and
+  // appends them to digests. The digest type is either a bitstring or a struct
+  // of bitstrings; bitwidths holds the width of the bitstring or of each struct
+  // member. Returns once the queue is empty or max_digests have been read.
+  virtual ::util::Status ReadDigests(
+      std::shared_ptr<SessionInterface> session,
+      const ::p4::config::v1::Digest& digest,
+      const std::vector<int>& bitwidths, size_t max_digests,
+      std::vector<::p4::v1::P4Data>* digests) = 0;
 
  protected:
   // Default constructor. To be called by the Mock class instance only.
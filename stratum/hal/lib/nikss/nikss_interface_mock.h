@@ -0,0 +1,214 @@
+#ifndef STRATUM_HAL_LIB_NIKSS_NIKSS_INTERFACE_MOCK_H_
+#define STRATUM_HAL_LIB_NIKSS_NIKSS_INTERFACE_MOCK_H_
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "stratum/hal/lib/nikss/nikss_interface.h"
+
+namespace stratum {
+namespace hal {
+namespace nikss {
+
+class SessionMock : public NikssInterface::SessionInterface {};
+
+class NikssInterfaceMock : public NikssInterface {
+ public:
+  MOCK_METHOD2(AddPipeline,
+               ::util::Status(int pipeline_id, const std::string& bpf_obj));
+  MOCK_METHOD2(LoadStandbyPipeline,
+               ::util::Status(int pipeline_id, const std::string& bpf_obj));
+  MOCK_METHOD1(SwitchToStandbyPipeline, ::util::Status(int pipeline_id));
+  MOCK_METHOD1(DiscardStandbyPipeline, ::util::Status(int pipeline_id));
+  MOCK_METHOD2(AddPort,
+               ::util::Status(int pipeline_id, const std::string& port_name));
+  MOCK_METHOD2(DeletePort,
+               ::util::Status(int pipeline_id, const std::string& port_name));
+  MOCK_METHOD1(CreateSession,
+               ::util::StatusOr<std::shared_ptr<SessionInterface>>(
+                   int pipeline_id));
+  MOCK_METHOD1(CreateStandbySession,
+               ::util::StatusOr<std::shared_ptr<SessionInterface>>(
+                   int pipeline_id));
+  MOCK_METHOD5(WriteTableEntry,
+               ::util::Status(std::shared_ptr<SessionInterface> session,
+                              const ::p4::v1::Update::Type type,
+                              const ::p4::config::v1::Table& table,
+                              const ::p4::config::v1::Action& action,
+                              const ::p4::v1::TableEntry& table_entry));
+  MOCK_METHOD5(ReadTableEntries,
+               ::util::Status(
+                   std::shared_ptr<SessionInterface> session,
+                   const ::p4::config::v1::Table& table,
+                   const std::vector<::p4::config::v1::Action>& actions,
+                   const ::p4::v1::TableEntry& table_entry,
+                   WriterInterface<::p4::v1::TableEntry>* writer));
+  MOCK_METHOD3(WriteIndirectCounter,
+               ::util::Status(std::shared_ptr<SessionInterface> session,
+                              const ::p4::config::v1::Counter& counter,
+                              const ::p4::v1::CounterEntry& counter_entry));
+  MOCK_METHOD4(ReadIndirectCounter,
+               ::util::Status(
+                   std::shared_ptr<SessionInterface> session,
+                   const ::p4::config::v1::Counter& counter,
+                   const ::p4::v1::CounterEntry& counter_entry,
+                   WriterInterface<::p4::v1::CounterEntry>* writer));
+  MOCK_METHOD4(
+      WriteDirectCounter,
+      ::util::Status(std::shared_ptr<SessionInterface> session,
+                     const ::p4::config::v1::Table& table,
+                     const ::p4::config::v1::DirectCounter& direct_counter,
+                     const ::p4::v1::DirectCounterEntry& direct_counter_entry));
+  MOCK_METHOD5(
+      ReadDirectCounter,
+      ::util::Status(std::shared_ptr<SessionInterface> session,
+                     const ::p4::config::v1::Table& table,
+                     const ::p4::config::v1::DirectCounter& direct_counter,
+                     const ::p4::v1::DirectCounterEntry& direct_counter_entry,
+                     WriterInterface<::p4::v1::DirectCounterEntry>* writer));
+  MOCK_METHOD3(WriteMeter,
+               ::util::Status(std::shared_ptr<SessionInterface> session,
+                              const ::p4::config::v1::Meter& meter,
+                              const ::p4::v1::MeterEntry& meter_entry));
+  MOCK_METHOD4(ReadMeter,
+               ::util::Status(std::shared_ptr<SessionInterface> session,
+                              const ::p4::config::v1::Meter& meter,
+                              const ::p4::v1::MeterEntry& meter_entry,
+                              WriterInterface<::p4::v1::MeterEntry>* writer));
+  MOCK_METHOD4(
+      WriteDirectMeter,
+      ::util::Status(std::shared_ptr<SessionInterface> session,
+                     const ::p4::config::v1::Table& table,
+                     const ::p4::config::v1::DirectMeter& direct_meter,
+                     const ::p4::v1::DirectMeterEntry& direct_meter_entry));
+  MOCK_METHOD5(
+      ReadDirectMeter,
+      ::util::Status(std::shared_ptr<SessionInterface> session,
+                     const ::p4::config::v1::Table& table,
+                     const ::p4::config::v1::DirectMeter& direct_meter,
+                     const ::p4::v1::DirectMeterEntry& direct_meter_entry,
+                     WriterInterface<::p4::v1::DirectMeterEntry>* writer));
+  MOCK_METHOD3(WriteRegister,
+               ::util::Status(std::shared_ptr<SessionInterface> session,
+                              const ::p4::config::v1::Register& reg,
+                              const ::p4::v1::RegisterEntry& register_entry));
+  MOCK_METHOD4(ReadRegister,
+               ::util::Status(
+                   std::shared_ptr<SessionInterface> session,
+                   const ::p4::config::v1::Register& reg,
+                   const ::p4::v1::RegisterEntry& register_entry,
+                   WriterInterface<::p4::v1::RegisterEntry>* writer));
+  MOCK_METHOD3(
+      WriteValueSet,
+      ::util::Status(std::shared_ptr<SessionInterface> session,
+                     const ::p4::config::v1::ValueSet& value_set,
+                     const ::p4::v1::ValueSetEntry& value_set_entry));
+  MOCK_METHOD3(ReadValueSet,
+               ::util::Status(std::shared_ptr<SessionInterface> session,
+                              const ::p4::config::v1::ValueSet& value_set,
+                              ::p4::v1::ValueSetEntry* value_set_entry));
+  MOCK_METHOD4(
+      InsertActionProfileMember,
+      ::util::StatusOr<uint32>(
+          std::shared_ptr<SessionInterface> session,
+          const ::p4::config::v1::ActionProfile& action_profile,
+          const ::p4::config::v1::Action& action_info,
+          const ::p4::v1::Action& action));
+  MOCK_METHOD5(
+      ModifyActionProfileMember,
+      ::util::Status(std::shared_ptr<SessionInterface> session,
+                     const ::p4::config::v1::ActionProfile& action_profile,
+                     const ::p4::config::v1::Action& action_info,
+                     const ::p4::v1::Action& action, uint32 member_ref));
+  MOCK_METHOD3(
+      DeleteActionProfileMember,
+      ::util::Status(std::shared_ptr<SessionInterface> session,
+                     const ::p4::config::v1::ActionProfile& action_profile,
+                     uint32 member_ref));
+  MOCK_METHOD2(
+      InsertActionProfileGroup,
+      ::util::StatusOr<uint32>(
+          std::shared_ptr<SessionInterface> session,
+          const ::p4::config::v1::ActionProfile& action_profile));
+  MOCK_METHOD3(
+      DeleteActionProfileGroup,
+      ::util::Status(std::shared_ptr<SessionInterface> session,
+                     const ::p4::config::v1::ActionProfile& action_profile,
+                     uint32 group_ref));
+  MOCK_METHOD4(
+      AddActionProfileGroupMember,
+      ::util::Status(std::shared_ptr<SessionInterface> session,
+                     const ::p4::config::v1::ActionProfile& action_profile,
+                     uint32 group_ref, uint32 member_ref));
+  MOCK_METHOD4(
+      RemoveActionProfileGroupMember,
+      ::util::Status(std::shared_ptr<SessionInterface> session,
+                     const ::p4::config::v1::ActionProfile& action_profile,
+                     uint32 group_ref, uint32 member_ref));
+  MOCK_METHOD4(
+      ReadActionProfileMembers,
+      ::util::Status(
+          std::shared_ptr<SessionInterface> session,
+          const ::p4::config::v1::ActionProfile& action_profile,
+          const std::vector<::p4::config::v1::Action>& actions,
+          std::vector<std::pair<uint32, ::p4::v1::Action>>* members));
+  MOCK_METHOD3(
+      ReadActionProfileGroups,
+      ::util::Status(
+          std::shared_ptr<SessionInterface> session,
+          const ::p4::config::v1::ActionProfile& action_profile,
+          std::vector<std::pair<uint32, std::vector<uint32>>>* groups));
+  MOCK_METHOD2(InsertMulticastGroup,
+               ::util::Status(std::shared_ptr<SessionInterface> session,
+                              uint32 group_id));
+  MOCK_METHOD2(DeleteMulticastGroup,
+               ::util::Status(std::shared_ptr<SessionInterface> session,
+                              uint32 group_id));
+  MOCK_METHOD3(AddMulticastGroupReplica,
+               ::util::Status(std::shared_ptr<SessionInterface> session,
+                              uint32 group_id,
+                              const ::p4::v1::Replica& replica));
+  MOCK_METHOD3(RemoveMulticastGroupReplica,
+               ::util::Status(std::shared_ptr<SessionInterface> session,
+                              uint32 group_id,
+                              const ::p4::v1::Replica& replica));
+  MOCK_METHOD3(ReadMulticastGroups,
+               ::util::Status(
+                   std::shared_ptr<SessionInterface> session, uint32 group_id,
+                   std::vector<::p4::v1::MulticastGroupEntry>* groups));
+  MOCK_METHOD2(InsertCloneSession,
+               ::util::Status(std::shared_ptr<SessionInterface> session,
+                              uint32 session_id));
+  MOCK_METHOD2(DeleteCloneSession,
+               ::util::Status(std::shared_ptr<SessionInterface> session,
+                              uint32 session_id));
+  MOCK_METHOD3(
+      AddCloneSessionReplica,
+      ::util::Status(std::shared_ptr<SessionInterface> session,
+                     const ::p4::v1::CloneSessionEntry& clone_session,
+                     const ::p4::v1::Replica& replica));
+  MOCK_METHOD3(RemoveCloneSessionReplica,
+               ::util::Status(std::shared_ptr<SessionInterface> session,
+                              uint32 session_id,
+                              const ::p4::v1::Replica& replica));
+  MOCK_METHOD3(ReadCloneSessions,
+               ::util::Status(
+                   std::shared_ptr<SessionInterface> session,
+                   uint32 session_id,
+                   std::vector<::p4::v1::CloneSessionEntry>* clone_sessions));
+  MOCK_METHOD5(ReadDigests,
+               ::util::Status(std::shared_ptr<SessionInterface> session,
+                              const ::p4::config::v1::Digest& digest,
+                              const std::vector<int>& bitwidths,
+                              size_t max_digests,
+                              std::vector<::p4::v1::P4Data>* digests));
+};
+
+}  // namespace nikss
+}  // namespace hal
+}  // namespace stratum
+
+#endif  // STRATUM_HAL_LIB_NIKSS_NIKSS_INTERFACE_MOCK_H_
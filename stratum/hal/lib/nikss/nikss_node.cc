@@ -1,48 +1,499 @@
 #include "stratum/hal/lib/nikss/nikss_node.h"
 
+#include <algorithm>
+#include <map>
 #include <memory>
+#include <string>
+#include <utility>
 
 #include "absl/synchronization/mutex.h"
 #include "absl/memory/memory.h"
+#include "gflags/gflags.h"
+#include "google/protobuf/util/message_differencer.h"
+#include "stratum/glue/gtl/map_util.h"
+#include "stratum/glue/status/status_macros.h"
+#include "stratum/hal/lib/common/proto_oneof_writer_wrapper.h"
+#include "stratum/hal/lib/nikss/chunked_read_response_writer.h"
 #include "stratum/lib/macros.h"
+#include "stratum/public/proto/error.pb.h"
+
+DEFINE_int32(nikss_read_chunk_size_bytes, 1024 * 1024,
+             "Maximum size in bytes of a single ReadResponse streamed by the "
+             "NIKSS backend. Reads returning more data are split into "
+             "multiple ReadResponses. Only an entity larger than this is sent "
+             "in a bigger ReadResponse of its own.");
 
 namespace stratum {
 namespace hal {
 namespace nikss {
 
-NikssNode::NikssNode(NikssInterface* nikss_interface, uint64 node_id)
-    : config_(),
+namespace {
+
+// Writer collecting the table entries read from a pipeline.
+class TableEntryCollector : public WriterInterface<::p4::v1::TableEntry> {
+ public:
+  explicit TableEntryCollector(std::vector<::p4::v1::TableEntry>* entries)
+      : entries_(entries) {}
+  bool Write(const ::p4::v1::TableEntry& entry) override {
+    entries_->push_back(entry);
+    return true;
+  }
+
+ private:
+  std::vector<::p4::v1::TableEntry>* entries_;  // not owned
+};
+
+// Writer collecting the entities of the read responses of a pipeline.
+class EntityCollector : public WriterInterface<::p4::v1::ReadResponse> {
+ public:
+  explicit EntityCollector(std::vector<::p4::v1::Entity>* entities)
+      : entities_(entities) {}
+  bool Write(const ::p4::v1::ReadResponse& resp) override {
+    entities_->insert(entities_->end(), resp.entities().begin(),
+                      resp.entities().end());
+    return true;
+  }
+
+ private:
+  std::vector<::p4::v1::Entity>* entities_;  // not owned
+};
+
+// Writer translating the NIKSS member and group references of indirect table
+// entries back into P4Runtime IDs. Entries referring to unknown members or
+// groups are passed on untranslated.
+class ActionProfileReferenceTranslator
+    : public WriterInterface<::p4::v1::TableEntry> {
+ public:
+  ActionProfileReferenceTranslator(
+      const absl::flat_hash_map<uint32, uint32>& member_ids,
+      const absl::flat_hash_map<uint32, uint32>& group_ids,
+      WriterInterface<::p4::v1::TableEntry>* writer)
+      : member_ids_(member_ids), group_ids_(group_ids), writer_(writer) {}
+  bool Write(const ::p4::v1::TableEntry& entry) override {
+    ::p4::v1::TableEntry translated = entry;
+    auto* action = translated.mutable_action();
+    if (action->has_action_profile_member_id()) {
+      const uint32* id =
+          gtl::FindOrNull(member_ids_, action->action_profile_member_id());
+      if (id) action->set_action_profile_member_id(*id);
+    } else if (action->has_action_profile_group_id()) {
+      const uint32* id =
+          gtl::FindOrNull(group_ids_, action->action_profile_group_id());
+      if (id) action->set_action_profile_group_id(*id);
+    }
+    return writer_->Write(translated);
+  }
+
+ private:
+  const absl::flat_hash_map<uint32, uint32>& member_ids_;
+  const absl::flat_hash_map<uint32, uint32>& group_ids_;
+  WriterInterface<::p4::v1::TableEntry>* writer_;  // not owned
+};
+
+// Returns the P4Info element with the given ID or name, or nullptr.
+template <typename T>
+const T* FindByIdOrNull(const ::google::protobuf::RepeatedPtrField<T>& items,
+                        uint32 id) {
+  for (const auto& item : items) {
+    if (item.id() == id) return &item;
+  }
+  return nullptr;
+}
+
+template <typename T>
+const T* FindByNameOrNull(const ::google::protobuf::RepeatedPtrField<T>& items,
+                          const std::string& name) {
+  for (const auto& item : items) {
+    if (item.name() == name) return &item;
+  }
+  return nullptr;
+}
+
+// Translates an action of one P4Info into the IDs of another P4Info, by
+// matching the names of the action and its parameters. Returns the P4Info
+// action of the translated action.
+::util::StatusOr<::p4::config::v1::Action> TranslateAction(
+    const P4InfoManager& from, const P4InfoManager& to,
+    ::p4::v1::Action* action) {
+  ASSIGN_OR_RETURN(auto old_action, from.FindActionByID(action->action_id()));
+  ASSIGN_OR_RETURN(auto new_action,
+                   to.FindActionByName(old_action.preamble().name()));
+  action->set_action_id(new_action.preamble().id());
+  for (auto& param : *action->mutable_params()) {
+    const auto* old_param =
+        FindByIdOrNull(old_action.params(), param.param_id());
+    RET_CHECK(old_param) << "Unknown parameter " << param.param_id() << ".";
+    const auto* new_param =
+        FindByNameOrNull(new_action.params(), old_param->name());
+    RET_CHECK(new_param && new_param->bitwidth() == old_param->bitwidth())
+        << "Parameter " << old_param->name() << " has changed.";
+    param.set_param_id(new_param->id());
+  }
+
+  return new_action;
+}
+
+// Returns the action selector of another P4Info with the name of the given
+// action selector.
+::util::StatusOr<::p4::config::v1::ActionProfile> TranslateActionProfile(
+    const P4InfoManager& from, const P4InfoManager& to,
+    uint32 action_profile_id) {
+  ASSIGN_OR_RETURN(auto old_action_profile,
+                   from.FindActionProfileByID(action_profile_id));
+  ASSIGN_OR_RETURN(auto new_action_profile,
+                   to.FindActionProfileByName(
+                       old_action_profile.preamble().name()));
+  RET_CHECK(new_action_profile.with_selector())
+      << "Action profile " << new_action_profile.preamble().name()
+      << " is not an action selector anymore.";
+
+  return new_action_profile;
+}
+
+// Translates a table entry of one P4Info into the IDs of another P4Info, by
+// matching the names of tables, match fields, actions and parameters. Fails
+// if the entry does not fit the other P4Info. Member and group IDs of
+// indirect entries are kept, the action selector of the table has to keep
+// its name.
+::util::StatusOr<::p4::v1::TableEntry> TranslateTableEntry(
+    const P4InfoManager& from, const P4InfoManager& to,
+    const ::p4::v1::TableEntry& entry) {
+  ASSIGN_OR_RETURN(auto old_table, from.FindTableByID(entry.table_id()));
+  ASSIGN_OR_RETURN(auto new_table,
+                   to.FindTableByName(old_table.preamble().name()));
+  ::p4::v1::TableEntry result = entry;
+  result.set_table_id(new_table.preamble().id());
+  for (auto& match : *result.mutable_match()) {
+    const auto* old_field =
+        FindByIdOrNull(old_table.match_fields(), match.field_id());
+    RET_CHECK(old_field) << "Unknown match field " << match.field_id() << ".";
+    const auto* new_field =
+        FindByNameOrNull(new_table.match_fields(), old_field->name());
+    RET_CHECK(new_field && new_field->bitwidth() == old_field->bitwidth() &&
+              new_field->match_type() == old_field->match_type())
+        << "Match field " << old_field->name() << " has changed.";
+    match.set_field_id(new_field->id());
+  }
+  if (result.action().type_case() == ::p4::v1::TableAction::kAction) {
+    RET_CHECK(!new_table.implementation_id())
+        << "Table " << new_table.preamble().name()
+        << " has an action selector now.";
+    auto* action = result.mutable_action()->mutable_action();
+    ASSIGN_OR_RETURN(auto new_action, TranslateAction(from, to, action));
+    RET_CHECK(std::any_of(new_table.action_refs().begin(),
+                          new_table.action_refs().end(),
+                          [&new_action](const ::p4::config::v1::ActionRef& ref) {
+                            return ref.id() == new_action.preamble().id();
+                          }))
+        << "Action " << new_action.preamble().name()
+        << " is not an action of table " << new_table.preamble().name() << ".";
+  } else if (old_table.implementation_id()) {
+    ASSIGN_OR_RETURN(auto new_action_profile,
+                     TranslateActionProfile(from, to,
+                                            old_table.implementation_id()));
+    RET_CHECK(new_table.implementation_id() ==
+              new_action_profile.preamble().id())
+        << "The action selector of table " << new_table.preamble().name()
+        << " has changed.";
+  }
+
+  return result;
+}
+
+// Returns the key of a table entry, which identifies the entry in its table.
+std::string TableEntryKey(const ::p4::v1::TableEntry& entry) {
+  ::p4::v1::TableEntry key;
+  key.set_table_id(entry.table_id());
+  *key.mutable_match() = entry.match();
+  key.set_priority(entry.priority());
+  return key.SerializeAsString();
+}
+
+// Returns the direct counter of the given P4Info attached to the table.
+::util::StatusOr<::p4::config::v1::DirectCounter> FindDirectCounterOfTable(
+    const P4InfoManager& p4_info_manager,
+    const ::p4::config::v1::Table& table) {
+  for (const auto& resource_id : table.direct_resource_ids()) {
+    auto direct_counter = p4_info_manager.FindDirectCounterByID(resource_id);
+    if (direct_counter.ok()) return direct_counter.ValueOrDie();
+  }
+  return MAKE_ERROR(ERR_INVALID_PARAM)
+         << "Table " << table.preamble().name() << " has no direct counter.";
+}
+
+// Returns the direct meter of the given P4Info attached to the table.
+::util::StatusOr<::p4::config::v1::DirectMeter> FindDirectMeterOfTable(
+    const P4InfoManager& p4_info_manager,
+    const ::p4::config::v1::Table& table) {
+  for (const auto& resource_id : table.direct_resource_ids()) {
+    auto direct_meter = p4_info_manager.FindDirectMeterByID(resource_id);
+    if (direct_meter.ok()) return direct_meter.ValueOrDie();
+  }
+  return MAKE_ERROR(ERR_INVALID_PARAM)
+         << "Table " << table.preamble().name() << " has no direct meter.";
+}
+
+// Checks that the index of a counter, meter or register entry, if any,
+// addresses one of the 'size' cells of the array.
+template <typename E>
+::util::Status CheckIndex(const ::p4::config::v1::Preamble& preamble,
+                          int64 size, const E& entry) {
+  if (entry.has_index() &&
+      (entry.index().index() < 0 || entry.index().index() >= size)) {
+    return MAKE_ERROR(ERR_INVALID_PARAM)
+           << "Index " << entry.index().index() << " of "
+           << preamble.name() << " is out of range, it has " << size
+           << " cells.";
+  }
+  return ::util::OkStatus();
+}
+
+// Returns true if the given value set, counter, meter or register entity
+// holds the state of a freshly loaded pipeline and needs no replay.
+bool IsInitialResourceState(const ::p4::v1::Entity& entity) {
+  switch (entity.entity_case()) {
+    case ::p4::v1::Entity::kValueSetEntry:
+      return entity.value_set_entry().members_size() == 0;
+    case ::p4::v1::Entity::kCounterEntry:
+      return entity.counter_entry().data().byte_count() == 0 &&
+             entity.counter_entry().data().packet_count() == 0;
+    case ::p4::v1::Entity::kDirectCounterEntry:
+      return entity.direct_counter_entry().data().byte_count() == 0 &&
+             entity.direct_counter_entry().data().packet_count() == 0;
+    case ::p4::v1::Entity::kMeterEntry:
+      return !entity.meter_entry().has_config();
+    case ::p4::v1::Entity::kDirectMeterEntry:
+      return !entity.direct_meter_entry().has_config();
+    case ::p4::v1::Entity::kRegisterEntry: {
+      const std::string& value =
+          entity.register_entry().data().bitstring();
+      return std::all_of(value.begin(), value.end(),
+                         [](char c) { return c == 0; });
+    }
+    default:
+      return false;
+  }
+}
+
+// Returns the plural name of the type of a value set, counter, meter or
+// register entity, for logging.
+std::string ResourceEntityTypeName(const ::p4::v1::Entity& entity) {
+  switch (entity.entity_case()) {
+    case ::p4::v1::Entity::kValueSetEntry:
+      return "value sets";
+    case ::p4::v1::Entity::kCounterEntry:
+      return "counter cells";
+    case ::p4::v1::Entity::kDirectCounterEntry:
+      return "direct counters";
+    case ::p4::v1::Entity::kMeterEntry:
+      return "meter cells";
+    case ::p4::v1::Entity::kDirectMeterEntry:
+      return "direct meters";
+    case ::p4::v1::Entity::kRegisterEntry:
+      return "register cells";
+    default:
+      return "entities";
+  }
+}
+
+// Translates a value set, counter, meter or register entity of one P4Info
+// into the IDs of another P4Info, by matching the names of the resources and
+// of the match fields of value sets. Direct counters and meters are
+// translated along with the key of their table entry. Fails if the entity
+// does not fit the other P4Info.
+::util::StatusOr<::p4::v1::Entity> TranslateResourceEntity(
+    const P4InfoManager& from, const P4InfoManager& to,
+    const ::p4::v1::Entity& entity) {
+  ::p4::v1::Entity result = entity;
+  switch (entity.entity_case()) {
+    case ::p4::v1::Entity::kValueSetEntry: {
+      auto* value_set_entry = result.mutable_value_set_entry();
+      ASSIGN_OR_RETURN(auto old_value_set,
+                       from.FindValueSetByID(value_set_entry->value_set_id()));
+      ASSIGN_OR_RETURN(auto new_value_set,
+                       to.FindValueSetByName(old_value_set.preamble().name()));
+      value_set_entry->set_value_set_id(new_value_set.preamble().id());
+      for (auto& member : *value_set_entry->mutable_members()) {
+        for (auto& match : *member.mutable_match()) {
+          const auto* old_field =
+              FindByIdOrNull(old_value_set.match(), match.field_id());
+          RET_CHECK(old_field)
+              << "Unknown match field " << match.field_id() << ".";
+          const auto* new_field =
+              FindByNameOrNull(new_value_set.match(), old_field->name());
+          RET_CHECK(new_field &&
+                    new_field->bitwidth() == old_field->bitwidth() &&
+                    new_field->match_type() == old_field->match_type())
+              << "Match field " << old_field->name() << " has changed.";
+          match.set_field_id(new_field->id());
+        }
+      }
+      break;
+    }
+    case ::p4::v1::Entity::kCounterEntry: {
+      auto* counter_entry = result.mutable_counter_entry();
+      ASSIGN_OR_RETURN(auto old_counter,
+                       from.FindCounterByID(counter_entry->counter_id()));
+      ASSIGN_OR_RETURN(auto new_counter,
+                       to.FindCounterByName(old_counter.preamble().name()));
+      RET_CHECK(new_counter.spec().unit() == old_counter.spec().unit())
+          << "The unit of counter " << new_counter.preamble().name()
+          << " has changed.";
+      RET_CHECK(counter_entry->index().index() < new_counter.size())
+          << "Counter " << new_counter.preamble().name() << " has shrunk.";
+      counter_entry->set_counter_id(new_counter.preamble().id());
+      break;
+    }
+    case ::p4::v1::Entity::kMeterEntry: {
+      auto* meter_entry = result.mutable_meter_entry();
+      ASSIGN_OR_RETURN(auto old_meter,
+                       from.FindMeterByID(meter_entry->meter_id()));
+      ASSIGN_OR_RETURN(auto new_meter,
+                       to.FindMeterByName(old_meter.preamble().name()));
+      RET_CHECK(new_meter.spec().unit() == old_meter.spec().unit())
+          << "The unit of meter " << new_meter.preamble().name()
+          << " has changed.";
+      RET_CHECK(meter_entry->index().index() < new_meter.size())
+          << "Meter " << new_meter.preamble().name() << " has shrunk.";
+      meter_entry->set_meter_id(new_meter.preamble().id());
+      break;
+    }
+    case ::p4::v1::Entity::kRegisterEntry: {
+      auto* register_entry = result.mutable_register_entry();
+      ASSIGN_OR_RETURN(auto old_register,
+                       from.FindRegisterByID(register_entry->register_id()));
+      ASSIGN_OR_RETURN(auto new_register,
+                       to.FindRegisterByName(old_register.preamble().name()));
+      RET_CHECK(::google::protobuf::util::MessageDifferencer::Equals(
+          new_register.type_spec(), old_register.type_spec()))
+          << "The type of register " << new_register.preamble().name()
+          << " has changed.";
+      RET_CHECK(register_entry->index().index() < new_register.size())
+          << "Register " << new_register.preamble().name() << " has shrunk.";
+      register_entry->set_register_id(new_register.preamble().id());
+      break;
+    }
+    case ::p4::v1::Entity::kDirectCounterEntry: {
+      auto* direct_counter_entry = result.mutable_direct_counter_entry();
+      ASSIGN_OR_RETURN(auto old_table,
+                       from.FindTableByID(
+                           direct_counter_entry->table_entry().table_id()));
+      ASSIGN_OR_RETURN(auto old_counter,
+                       FindDirectCounterOfTable(from, old_table));
+      ASSIGN_OR_RETURN(*direct_counter_entry->mutable_table_entry(),
+                       TranslateTableEntry(
+                           from, to, direct_counter_entry->table_entry()));
+      ASSIGN_OR_RETURN(auto new_table,
+                       to.FindTableByID(
+                           direct_counter_entry->table_entry().table_id()));
+      ASSIGN_OR_RETURN(auto new_counter,
+                       FindDirectCounterOfTable(to, new_table));
+      RET_CHECK(new_counter.spec().unit() == old_counter.spec().unit())
+          << "The unit of direct counter " << new_counter.preamble().name()
+          << " has changed.";
+      break;
+    }
+    case ::p4::v1::Entity::kDirectMeterEntry: {
+      auto* direct_meter_entry = result.mutable_direct_meter_entry();
+      ASSIGN_OR_RETURN(auto old_table,
+                       from.FindTableByID(
+                           direct_meter_entry->table_entry().table_id()));
+      ASSIGN_OR_RETURN(auto old_meter, FindDirectMeterOfTable(from, old_table));
+      ASSIGN_OR_RETURN(*direct_meter_entry->mutable_table_entry(),
+                       TranslateTableEntry(
+                           from, to, direct_meter_entry->table_entry()));
+      ASSIGN_OR_RETURN(auto new_table,
+                       to.FindTableByID(
+                           direct_meter_entry->table_entry().table_id()));
+      ASSIGN_OR_RETURN(auto new_meter, FindDirectMeterOfTable(to, new_table));
+      RET_CHECK(new_meter.spec().unit() == old_meter.spec().unit())
+          << "The unit of direct meter " << new_meter.preamble().name()
+          << " has changed.";
+      break;
+    }
+    default:
+      return MAKE_ERROR(ERR_INVALID_PARAM)
+             << "Unexpected entity " << entity.ShortDebugString() << ".";
+  }
+
+  return result;
+}
+
+}  // namespace
+
+NikssNode::NikssNode(NikssInterface* nikss_interface,
+                     NikssPacketioManager* nikss_packetio_manager,
+                     NikssDigestManager* nikss_digest_manager,
+                     NikssPreManager* nikss_pre_manager, uint64 node_id)
+    : pipeline_initialized_(false),
+      config_(),
+      p4_info_manager_(nullptr),
       nikss_interface_(ABSL_DIE_IF_NULL(nikss_interface)),
+      nikss_packetio_manager_(ABSL_DIE_IF_NULL(nikss_packetio_manager)),
+      nikss_digest_manager_(ABSL_DIE_IF_NULL(nikss_digest_manager)),
+      nikss_pre_manager_(ABSL_DIE_IF_NULL(nikss_pre_manager)),
       node_id_(node_id) {}
 
 NikssNode::NikssNode()
-    : nikss_interface_(nullptr),
+    : pipeline_initialized_(false),
+      p4_info_manager_(nullptr),
+      nikss_interface_(nullptr),
+      nikss_packetio_manager_(nullptr),
+      nikss_digest_manager_(nullptr),
+      nikss_pre_manager_(nullptr),
       node_id_(0) {}
 
 NikssNode::~NikssNode() = default;
 
 // Factory function for creating the instance of the class.
 std::unique_ptr<NikssNode> NikssNode::CreateInstance(
-    NikssInterface* nikss_interface, uint64 node_id) {
+    NikssInterface* nikss_interface,
+    NikssPacketioManager* nikss_packetio_manager,
+    NikssDigestManager* nikss_digest_manager,
+    NikssPreManager* nikss_pre_manager, uint64 node_id) {
   return absl::WrapUnique(
-      new NikssNode(nikss_interface, node_id));
+      new NikssNode(nikss_interface, nikss_packetio_manager,
+                    nikss_digest_manager, nikss_pre_manager, node_id));
 }
 
 ::util::Status NikssNode::PushForwardingPipelineConfig(
     const ::p4::v1::ForwardingPipelineConfig& config) {
-  // SaveForwardingPipelineConfig + CommitForwardingPipelineConfig
+  // SaveForwardingPipelineConfig + CommitForwardingPipelineConfig. A re-push
+  // replaces a running pipeline like a commit, keeping its forwarding state.
   RETURN_IF_ERROR(SaveForwardingPipelineConfig(config));
-  return CommitForwardingPipelineConfig();
+  absl::WriterMutexLock l(&lock_);
+  return CommitPipeline();
 }
 
 ::util::Status NikssNode::SaveForwardingPipelineConfig(
     const ::p4::v1::ForwardingPipelineConfig& config) {
+  absl::WriterMutexLock l(&lock_);
+  RETURN_IF_ERROR(VerifyForwardingPipelineConfig(config));
   config_ = config;
   return ::util::OkStatus();
 }
 
 ::util::Status NikssNode::CommitForwardingPipelineConfig() {
-  RETURN_IF_ERROR(nikss_interface_->AddPipeline(node_id_, config_.p4_device_config()));
+  absl::WriterMutexLock l(&lock_);
+  return CommitPipeline();
+}
+
+::util::Status NikssNode::CommitPipeline() {
+  auto p4_info_manager = absl::make_unique<P4InfoManager>(config_.p4info());
+  RETURN_IF_ERROR(p4_info_manager->InitializeAndVerify());
+  if (pipeline_initialized_) {
+    RETURN_IF_ERROR(ReplacePipeline(*p4_info_manager));
+  } else {
+    RETURN_IF_ERROR(nikss_interface_->AddPipeline(
+        node_id_, config_.p4_device_config()));
+    action_profiles_.clear();
+  }
+  RETURN_IF_ERROR(
+      nikss_packetio_manager_->PushForwardingPipelineConfig(config_.p4info()));
+  RETURN_IF_ERROR(
+      nikss_digest_manager_->PushForwardingPipelineConfig(config_.p4info()));
+  p4_info_manager_ = std::move(p4_info_manager);
+  pipeline_initialized_ = true;
   return ::util::OkStatus();
 }
 
@@ -53,6 +504,1380 @@ std::unique_ptr<NikssNode> NikssNode::CreateInstance(
   return ::util::OkStatus();
 }
 
+::util::Status NikssNode::ReplacePipeline(
+    const P4InfoManager& new_p4_info_manager) {
+  // Snapshot the state of the running pipeline. Entries of const tables are
+  // part of the program and are not carried over. Action selector members,
+  // groups and the entries referring to them are read with their P4Runtime
+  // IDs, as NIKSS allocates new references in the new pipeline.
+  std::vector<::p4::v1::TableEntry> entries;
+  std::vector<::p4::v1::Entity> action_profile_entities;
+  std::vector<::p4::v1::Entity> resource_entities;
+  std::vector<PreEntry> pre_entries;
+  {
+    ASSIGN_OR_RETURN(auto session, nikss_interface_->CreateSession(node_id_));
+    std::vector<::p4::v1::MulticastGroupEntry> groups;
+    RETURN_IF_ERROR(nikss_interface_->ReadMulticastGroups(session, 0, &groups));
+    for (auto& group : groups) {
+      pre_entries.emplace_back();
+      pre_entries.back().mutable_multicast_group_entry()->Swap(&group);
+    }
+    std::vector<::p4::v1::CloneSessionEntry> clone_sessions;
+    RETURN_IF_ERROR(
+        nikss_interface_->ReadCloneSessions(session, 0, &clone_sessions));
+    for (auto& clone_session : clone_sessions) {
+      pre_entries.emplace_back();
+      pre_entries.back().mutable_clone_session_entry()->Swap(&clone_session);
+    }
+    EntityCollector action_profile_collector(&action_profile_entities);
+    RETURN_IF_ERROR(ReadActionProfileMember(
+        session, ::p4::v1::ActionProfileMember(), &action_profile_collector));
+    RETURN_IF_ERROR(ReadActionProfileGroup(
+        session, ::p4::v1::ActionProfileGroup(), &action_profile_collector));
+    std::vector<::p4::v1::Entity> indirect_entities;
+    EntityCollector indirect_collector(&indirect_entities);
+    TableEntryCollector collector(&entries);
+    for (const auto& table : p4_info_manager_->p4_info().tables()) {
+      if (table.is_const_table()) continue;
+      ::p4::v1::TableEntry table_entry;
+      table_entry.set_table_id(table.preamble().id());
+      if (table.implementation_id()) {
+        RETURN_IF_ERROR(
+            ReadTableEntry(session, table_entry, &indirect_collector));
+        continue;
+      }
+      std::vector<::p4::config::v1::Action> actions;
+      for (const auto& action_ref : table.action_refs()) {
+        ASSIGN_OR_RETURN(auto action,
+                         p4_info_manager_->FindActionByID(action_ref.id()));
+        actions.push_back(action);
+      }
+      RETURN_IF_ERROR(nikss_interface_->ReadTableEntries(
+          session, table, actions, table_entry, &collector));
+      if (table.const_default_action_id() == 0) {
+        table_entry.set_is_default_action(true);
+        RETURN_IF_ERROR(nikss_interface_->ReadTableEntries(
+            session, table, actions, table_entry, &collector));
+      }
+    }
+    for (auto& entity : indirect_entities) {
+      entries.emplace_back();
+      entries.back().Swap(entity.mutable_table_entry());
+    }
+    EntityCollector resource_collector(&resource_entities);
+    RETURN_IF_ERROR(ReadValueSetEntry(session, ::p4::v1::ValueSetEntry(),
+                                      &resource_collector));
+    RETURN_IF_ERROR(ReadCounterEntry(session, ::p4::v1::CounterEntry(),
+                                     &resource_collector));
+    RETURN_IF_ERROR(
+        ReadMeterEntry(session, ::p4::v1::MeterEntry(), &resource_collector));
+    RETURN_IF_ERROR(ReadRegisterEntry(session, ::p4::v1::RegisterEntry(),
+                                      &resource_collector));
+    for (const auto& table : p4_info_manager_->p4_info().tables()) {
+      if (table.is_const_table()) continue;
+      if (FindDirectCounterOfTable(*p4_info_manager_, table).ok()) {
+        ::p4::v1::DirectCounterEntry direct_counter_entry;
+        direct_counter_entry.mutable_table_entry()->set_table_id(
+            table.preamble().id());
+        RETURN_IF_ERROR(ReadDirectCounterEntry(session, direct_counter_entry,
+                                               &resource_collector));
+      }
+      if (FindDirectMeterOfTable(*p4_info_manager_, table).ok()) {
+        ::p4::v1::DirectMeterEntry direct_meter_entry;
+        direct_meter_entry.mutable_table_entry()->set_table_id(
+            table.preamble().id());
+        RETURN_IF_ERROR(ReadDirectMeterEntry(session, direct_meter_entry,
+                                             &resource_collector));
+      }
+    }
+    // Cells in their initial state are left out.
+    resource_entities.erase(
+        std::remove_if(resource_entities.begin(), resource_entities.end(),
+                       IsInitialResourceState),
+        resource_entities.end());
+  }
+
+  // Make before break: the new pipeline is populated while the running one
+  // keeps forwarding and only takes over the ports once complete.
+  RETURN_IF_ERROR(nikss_interface_->LoadStandbyPipeline(
+      node_id_, config_.p4_device_config()));
+  absl::flat_hash_map<uint32, ActionProfileState> new_action_profiles;
+  absl::flat_hash_set<std::string> replayed_keys;
+  ::util::Status status = ReplayActionProfiles(
+      new_p4_info_manager, action_profile_entities, &new_action_profiles);
+  if (status.ok()) {
+    status = ReplayTableEntries(new_p4_info_manager, new_action_profiles,
+                                entries, &replayed_keys);
+  }
+  // Direct counters and meters are written to the replayed table entries.
+  if (status.ok()) {
+    status = ReplayResourceEntities(new_p4_info_manager, replayed_keys,
+                                    resource_entities);
+  }
+  if (status.ok()) status = ReplayPreEntries(pre_entries);
+  if (status.ok()) {
+    status = nikss_interface_->SwitchToStandbyPipeline(node_id_);
+  }
+  if (!status.ok()) {
+    APPEND_STATUS_IF_ERROR(status,
+                           nikss_interface_->DiscardStandbyPipeline(node_id_));
+    return status;
+  }
+  action_profiles_ = std::move(new_action_profiles);
+
+  return ::util::OkStatus();
+}
+
+::util::Status NikssNode::ReplayActionProfiles(
+    const P4InfoManager& new_p4_info_manager,
+    const std::vector<::p4::v1::Entity>& entities,
+    absl::flat_hash_map<uint32, ActionProfileState>* new_action_profiles) {
+  ASSIGN_OR_RETURN(auto session,
+                   nikss_interface_->CreateStandbySession(node_id_));
+  int num_dropped = 0;
+  // All members precede the groups.
+  for (const auto& entity : entities) {
+    if (entity.has_action_profile_member()) {
+      const auto& member = entity.action_profile_member();
+      auto action_profile = TranslateActionProfile(
+          *p4_info_manager_, new_p4_info_manager, member.action_profile_id());
+      ::p4::v1::Action action = member.action();
+      auto action_info =
+          TranslateAction(*p4_info_manager_, new_p4_info_manager, &action);
+      if (!action_profile.ok() || !action_info.ok()) {
+        VLOG(1) << "Dropping action profile member "
+                << member.ShortDebugString() << ".";
+        ++num_dropped;
+        continue;
+      }
+      ASSIGN_OR_RETURN(const uint32 member_ref,
+                       nikss_interface_->InsertActionProfileMember(
+                           session, action_profile.ValueOrDie(),
+                           action_info.ValueOrDie(), action));
+      auto& state = (*new_action_profiles)[action_profile.ValueOrDie()
+                                               .preamble()
+                                               .id()];
+      state.member_refs[member.member_id()] = member_ref;
+      state.member_ids[member_ref] = member.member_id();
+    } else if (entity.has_action_profile_group()) {
+      const auto& group = entity.action_profile_group();
+      auto action_profile = TranslateActionProfile(
+          *p4_info_manager_, new_p4_info_manager, group.action_profile_id());
+      if (!action_profile.ok()) {
+        VLOG(1) << "Dropping action profile group " << group.ShortDebugString()
+                << ": " << action_profile.status();
+        ++num_dropped;
+        continue;
+      }
+      const auto& new_action_profile = action_profile.ValueOrDie();
+      auto& state = (*new_action_profiles)[new_action_profile.preamble().id()];
+      ASSIGN_OR_RETURN(const uint32 group_ref,
+                       nikss_interface_->InsertActionProfileGroup(
+                           session, new_action_profile));
+      state.group_refs[group.group_id()] = group_ref;
+      state.group_ids[group_ref] = group.group_id();
+      auto& group_members = state.group_members[group.group_id()];
+      for (const auto& member : group.members()) {
+        // Dropped members are left out of the group.
+        const uint32* member_ref =
+            gtl::FindOrNull(state.member_refs, member.member_id());
+        if (!member_ref) continue;
+        RETURN_IF_ERROR(nikss_interface_->AddActionProfileGroupMember(
+            session, new_action_profile, group_ref, *member_ref));
+        group_members.insert(member.member_id());
+      }
+    }
+  }
+  if (num_dropped) {
+    LOG(WARNING) << num_dropped << " of " << entities.size()
+                 << " action profile members and groups do not fit the new "
+                 << "pipeline of node " << node_id_ << " and have been "
+                 << "dropped.";
+  }
+  if (!entities.empty()) {
+    LOG(INFO) << "Replayed " << entities.size() - num_dropped
+              << " action profile members and groups into the new pipeline "
+              << "of node " << node_id_ << ".";
+  }
+
+  return ::util::OkStatus();
+}
+
+::util::Status NikssNode::ReplayTableEntries(
+    const P4InfoManager& new_p4_info_manager,
+    const absl::flat_hash_map<uint32, ActionProfileState>& new_action_profiles,
+    const std::vector<::p4::v1::TableEntry>& entries,
+    absl::flat_hash_set<std::string>* replayed_keys) {
+  ASSIGN_OR_RETURN(auto session,
+                   nikss_interface_->CreateStandbySession(node_id_));
+  int num_dropped = 0;
+  for (const auto& entry : entries) {
+    auto translated_entry =
+        TranslateTableEntry(*p4_info_manager_, new_p4_info_manager, entry);
+    if (!translated_entry.ok()) {
+      VLOG(1) << "Dropping table entry " << entry.ShortDebugString() << ": "
+              << translated_entry.status();
+      ++num_dropped;
+      continue;
+    }
+    auto& new_entry = translated_entry.ValueOrDie();
+    ASSIGN_OR_RETURN(auto table,
+                     new_p4_info_manager.FindTableByID(new_entry.table_id()));
+    ::p4::config::v1::Action action;
+    if (table.implementation_id()) {
+      // Members or groups which have been dropped drop their entries too.
+      ::util::Status status = ToNikssReference(
+          gtl::FindOrNull(new_action_profiles, table.implementation_id()),
+          new_entry.mutable_action());
+      if (!status.ok()) {
+        VLOG(1) << "Dropping table entry " << entry.ShortDebugString() << ": "
+                << status;
+        ++num_dropped;
+        continue;
+      }
+    } else {
+      ASSIGN_OR_RETURN(action, new_p4_info_manager.FindActionByID(
+                                   new_entry.action().action().action_id()));
+    }
+    RETURN_IF_ERROR(nikss_interface_->WriteTableEntry(
+        session,
+        new_entry.is_default_action() ? ::p4::v1::Update::MODIFY
+                                      : ::p4::v1::Update::INSERT,
+        table, action, new_entry));
+    if (!new_entry.is_default_action()) {
+      replayed_keys->insert(TableEntryKey(new_entry));
+    }
+  }
+  if (num_dropped) {
+    LOG(WARNING) << num_dropped << " of " << entries.size()
+                 << " table entries do not fit the new pipeline of node "
+                 << node_id_ << " and have been dropped.";
+  }
+  LOG(INFO) << "Replayed " << entries.size() - num_dropped
+            << " table entries into the new pipeline of node " << node_id_
+            << ".";
+
+  return ::util::OkStatus();
+}
+
+::util::Status NikssNode::ReplayResourceEntities(
+    const P4InfoManager& new_p4_info_manager,
+    const absl::flat_hash_set<std::string>& replayed_keys,
+    const std::vector<::p4::v1::Entity>& entities) {
+  ASSIGN_OR_RETURN(auto session,
+                   nikss_interface_->CreateStandbySession(node_id_));
+  // Counts per entity type, ordered for stable logs.
+  std::map<std::string, int> num_replayed;
+  std::map<std::string, int> num_dropped;
+  for (const auto& entity : entities) {
+    const std::string type = ResourceEntityTypeName(entity);
+    auto translated_entity =
+        TranslateResourceEntity(*p4_info_manager_, new_p4_info_manager, entity);
+    if (!translated_entity.ok()) {
+      VLOG(1) << "Dropping " << entity.ShortDebugString() << ": "
+              << translated_entity.status();
+      ++num_dropped[type];
+      continue;
+    }
+    const auto& new_entity = translated_entity.ValueOrDie();
+    switch (new_entity.entity_case()) {
+      case ::p4::v1::Entity::kValueSetEntry: {
+        ASSIGN_OR_RETURN(auto value_set,
+                         new_p4_info_manager.FindValueSetByID(
+                             new_entity.value_set_entry().value_set_id()));
+        RETURN_IF_ERROR(nikss_interface_->WriteValueSet(
+            session, value_set, new_entity.value_set_entry()));
+        break;
+      }
+      case ::p4::v1::Entity::kCounterEntry: {
+        ASSIGN_OR_RETURN(auto counter,
+                         new_p4_info_manager.FindCounterByID(
+                             new_entity.counter_entry().counter_id()));
+        RETURN_IF_ERROR(nikss_interface_->WriteIndirectCounter(
+            session, counter, new_entity.counter_entry()));
+        break;
+      }
+      case ::p4::v1::Entity::kMeterEntry: {
+        ASSIGN_OR_RETURN(auto meter,
+                         new_p4_info_manager.FindMeterByID(
+                             new_entity.meter_entry().meter_id()));
+        RETURN_IF_ERROR(nikss_interface_->WriteMeter(
+            session, meter, new_entity.meter_entry()));
+        break;
+      }
+      case ::p4::v1::Entity::kRegisterEntry: {
+        ASSIGN_OR_RETURN(auto reg,
+                         new_p4_info_manager.FindRegisterByID(
+                             new_entity.register_entry().register_id()));
+        RETURN_IF_ERROR(nikss_interface_->WriteRegister(
+            session, reg, new_entity.register_entry()));
+        break;
+      }
+      case ::p4::v1::Entity::kDirectCounterEntry: {
+        const auto& direct_counter_entry = new_entity.direct_counter_entry();
+        // Table entries which have been dropped drop their counters too.
+        if (!replayed_keys.contains(
+                TableEntryKey(direct_counter_entry.table_entry()))) {
+          ++num_dropped[type];
+          continue;
+        }
+        ASSIGN_OR_RETURN(auto table,
+                         new_p4_info_manager.FindTableByID(
+                             direct_counter_entry.table_entry().table_id()));
+        ASSIGN_OR_RETURN(auto direct_counter,
+                         FindDirectCounterOfTable(new_p4_info_manager, table));
+        RETURN_IF_ERROR(nikss_interface_->WriteDirectCounter(
+            session, table, direct_counter, direct_counter_entry));
+        break;
+      }
+      case ::p4::v1::Entity::kDirectMeterEntry: {
+        const auto& direct_meter_entry = new_entity.direct_meter_entry();
+        if (!replayed_keys.contains(
+                TableEntryKey(direct_meter_entry.table_entry()))) {
+          ++num_dropped[type];
+          continue;
+        }
+        ASSIGN_OR_RETURN(auto table,
+                         new_p4_info_manager.FindTableByID(
+                             direct_meter_entry.table_entry().table_id()));
+        ASSIGN_OR_RETURN(auto direct_meter,
+                         FindDirectMeterOfTable(new_p4_info_manager, table));
+        RETURN_IF_ERROR(nikss_interface_->WriteDirectMeter(
+            session, table, direct_meter, direct_meter_entry));
+        break;
+      }
+      default:
+        break;
+    }
+    ++num_replayed[type];
+  }
+  for (const auto& e : num_dropped) {
+    LOG(WARNING) << e.second << " " << e.first << " do not fit the new "
+                 << "pipeline of node " << node_id_ << " and have been "
+                 << "dropped.";
+  }
+  for (const auto& e : num_replayed) {
+    LOG(INFO) << "Replayed " << e.second << " " << e.first
+              << " into the new pipeline of node " << node_id_ << ".";
+  }
+
+  return ::util::OkStatus();
+}
+
+::util::Status NikssNode::ReplayPreEntries(
+    const std::vector<PreEntry>& entries) {
+  ASSIGN_OR_RETURN(auto session,
+                   nikss_interface_->CreateStandbySession(node_id_));
+  for (const auto& entry : entries) {
+    RETURN_IF_ERROR(nikss_pre_manager_->WritePreEntry(
+        session, ::p4::v1::Update::INSERT, entry));
+  }
+  if (!entries.empty()) {
+    LOG(INFO) << "Replayed " << entries.size()
+              << " PRE entries into the new pipeline of node " << node_id_
+              << ".";
+  }
+
+  return ::util::OkStatus();
+}
+
+::util::Status NikssNode::WriteForwardingEntries(
+    const ::p4::v1::WriteRequest& req, std::vector<::util::Status>* results) {
+  absl::WriterMutexLock l(&lock_);
+  RET_CHECK(req.device_id() == node_id_)
+      << "Request device id must be same as id of this NikssNode.";
+  RET_CHECK(req.atomicity() == ::p4::v1::WriteRequest::CONTINUE_ON_ERROR)
+      << "Request atomicity "
+      << ::p4::v1::WriteRequest::Atomicity_Name(req.atomicity())
+      << " is not supported.";
+  if (!pipeline_initialized_) {
+    return MAKE_ERROR(ERR_NOT_INITIALIZED) << "Not initialized!";
+  }
+
+  bool success = true;
+  // A single session is used for the whole request, so that the NIKSS objects
+  // of each table are set up only once per request.
+  ASSIGN_OR_RETURN(auto session, nikss_interface_->CreateSession(node_id_));
+  results->reserve(results->size() + req.updates_size());
+  for (const auto& update : req.updates()) {
+    ::util::Status status = ::util::OkStatus();
+    switch (update.entity().entity_case()) {
+      case ::p4::v1::Entity::kTableEntry:
+        status = WriteTableEntry(session, update.type(),
+                                 update.entity().table_entry());
+        break;
+      case ::p4::v1::Entity::kCounterEntry:
+        status = WriteCounterEntry(session, update.type(),
+                                   update.entity().counter_entry());
+        break;
+      case ::p4::v1::Entity::kDirectCounterEntry:
+        status = WriteDirectCounterEntry(
+            session, update.type(), update.entity().direct_counter_entry());
+        break;
+      case ::p4::v1::Entity::kMeterEntry:
+        status = WriteMeterEntry(session, update.type(),
+                                 update.entity().meter_entry());
+        break;
+      case ::p4::v1::Entity::kDirectMeterEntry:
+        status = WriteDirectMeterEntry(session, update.type(),
+                                       update.entity().direct_meter_entry());
+        break;
+      case ::p4::v1::Entity::kRegisterEntry:
+        status = WriteRegisterEntry(session, update.type(),
+                                    update.entity().register_entry());
+        break;
+      case ::p4::v1::Entity::kValueSetEntry:
+        status = WriteValueSetEntry(session, update.type(),
+                                    update.entity().value_set_entry());
+        break;
+      case ::p4::v1::Entity::kActionProfileMember:
+        status = WriteActionProfileMember(
+            session, update.type(), update.entity().action_profile_member());
+        break;
+      case ::p4::v1::Entity::kActionProfileGroup:
+        status = WriteActionProfileGroup(
+            session, update.type(), update.entity().action_profile_group());
+        break;
+      case ::p4::v1::Entity::kDigestEntry:
+        status = nikss_digest_manager_->WriteDigestEntry(
+            update.type(), update.entity().digest_entry());
+        break;
+      case ::p4::v1::Entity::kPacketReplicationEngineEntry:
+        status = nikss_pre_manager_->WritePreEntry(
+            session, update.type(),
+            update.entity().packet_replication_engine_entry());
+        break;
+      case ::p4::v1::Entity::kExternEntry:
+      default:
+        status = MAKE_ERROR(ERR_UNIMPLEMENTED)
+                 << "Unsupported entity type: " << update.ShortDebugString();
+        break;
+    }
+    success &= status.ok();
+    results->push_back(status);
+  }
+
+  if (!success) {
+    return MAKE_ERROR(ERR_AT_LEAST_ONE_OPER_FAILED)
+           << "One or more write operations failed.";
+  }
+
+  VLOG(1) << "P4-based forwarding entities written successfully to node with "
+          << "ID " << node_id_ << ".";
+  return ::util::OkStatus();
+}
+
+::util::Status NikssNode::ReadForwardingEntries(
+    const ::p4::v1::ReadRequest& req,
+    WriterInterface<::p4::v1::ReadResponse>* writer,
+    std::vector<::util::Status>* details) {
+  RET_CHECK(writer) << "Channel writer must be non-null.";
+  RET_CHECK(details) << "Details pointer must be non-null.";
+
+  absl::ReaderMutexLock l(&lock_);
+  RET_CHECK(req.device_id() == node_id_)
+      << "Request device id must be same as id of this NikssNode.";
+  if (!pipeline_initialized_) {
+    return MAKE_ERROR(ERR_NOT_INITIALIZED) << "Not initialized!";
+  }
+
+  bool success = true;
+  ASSIGN_OR_RETURN(auto session, nikss_interface_->CreateSession(node_id_));
+  for (const auto& entity : req.entities()) {
+    switch (entity.entity_case()) {
+      case ::p4::v1::Entity::kTableEntry: {
+        auto status = ReadTableEntry(session, entity.table_entry(), writer);
+        success &= status.ok();
+        details->push_back(status);
+        break;
+      }
+      case ::p4::v1::Entity::kCounterEntry: {
+        auto status = ReadCounterEntry(session, entity.counter_entry(), writer);
+        success &= status.ok();
+        details->push_back(status);
+        break;
+      }
+      case ::p4::v1::Entity::kDirectCounterEntry: {
+        auto status = ReadDirectCounterEntry(
+            session, entity.direct_counter_entry(), writer);
+        success &= status.ok();
+        details->push_back(status);
+        break;
+      }
+      case ::p4::v1::Entity::kMeterEntry: {
+        auto status = ReadMeterEntry(session, entity.meter_entry(), writer);
+        success &= status.ok();
+        details->push_back(status);
+        break;
+      }
+      case ::p4::v1::Entity::kDirectMeterEntry: {
+        auto status = ReadDirectMeterEntry(
+            session, entity.direct_meter_entry(), writer);
+        success &= status.ok();
+        details->push_back(status);
+        break;
+      }
+      case ::p4::v1::Entity::kRegisterEntry: {
+        auto status =
+            ReadRegisterEntry(session, entity.register_entry(), writer);
+        success &= status.ok();
+        details->push_back(status);
+        break;
+      }
+      case ::p4::v1::Entity::kValueSetEntry: {
+        auto status =
+            ReadValueSetEntry(session, entity.value_set_entry(), writer);
+        success &= status.ok();
+        details->push_back(status);
+        break;
+      }
+      case ::p4::v1::Entity::kActionProfileMember: {
+        auto status = ReadActionProfileMember(
+            session, entity.action_profile_member(), writer);
+        success &= status.ok();
+        details->push_back(status);
+        break;
+      }
+      case ::p4::v1::Entity::kActionProfileGroup: {
+        auto status = ReadActionProfileGroup(
+            session, entity.action_profile_group(), writer);
+        success &= status.ok();
+        details->push_back(status);
+        break;
+      }
+      case ::p4::v1::Entity::kDigestEntry: {
+        auto status = ReadDigestEntry(entity.digest_entry(), writer);
+        success &= status.ok();
+        details->push_back(status);
+        break;
+      }
+      case ::p4::v1::Entity::kPacketReplicationEngineEntry: {
+        auto status = ReadPreEntry(
+            session, entity.packet_replication_engine_entry(), writer);
+        success &= status.ok();
+        details->push_back(status);
+        break;
+      }
+      case ::p4::v1::Entity::kExternEntry:
+      default: {
+        success = false;
+        details->push_back(MAKE_ERROR(ERR_UNIMPLEMENTED)
+                           << "Unsupported entity type: "
+                           << entity.ShortDebugString());
+        break;
+      }
+    }
+  }
+  if (!success) {
+    return MAKE_ERROR(ERR_AT_LEAST_ONE_OPER_FAILED)
+           << "One or more read operations failed.";
+  }
+  return ::util::OkStatus();
+}
+
+::util::Status NikssNode::RegisterStreamMessageResponseWriter(
+    const std::shared_ptr<WriterInterface<::p4::v1::StreamMessageResponse>>&
+        writer) {
+  absl::WriterMutexLock l(&lock_);
+  auto packet_in_writer =
+      std::make_shared<ProtoOneofWriterWrapper<::p4::v1::StreamMessageResponse,
+                                               ::p4::v1::PacketIn>>(
+          writer,
+          &::p4::v1::StreamMessageResponse::unsafe_arena_set_allocated_packet,
+          &::p4::v1::StreamMessageResponse::unsafe_arena_release_packet);
+
+  auto digest_list_writer =
+      std::make_shared<ProtoOneofWriterWrapper<::p4::v1::StreamMessageResponse,
+                                               ::p4::v1::DigestList>>(
+          writer,
+          &::p4::v1::StreamMessageResponse::unsafe_arena_set_allocated_digest,
+          &::p4::v1::StreamMessageResponse::unsafe_arena_release_digest);
+
+  RETURN_IF_ERROR(
+      nikss_packetio_manager_->RegisterPacketReceiveWriter(packet_in_writer));
+  return nikss_digest_manager_->RegisterDigestListWriter(digest_list_writer);
+}
+
+::util::Status NikssNode::UnregisterStreamMessageResponseWriter() {
+  absl::WriterMutexLock l(&lock_);
+  ::util::Status status = ::util::OkStatus();
+  APPEND_STATUS_IF_ERROR(
+      status, nikss_packetio_manager_->UnregisterPacketReceiveWriter());
+  APPEND_STATUS_IF_ERROR(status,
+                         nikss_digest_manager_->UnregisterDigestListWriter());
+  return status;
+}
+
+::util::Status NikssNode::HandleStreamMessageRequest(
+    const ::p4::v1::StreamMessageRequest& req) {
+  absl::ReaderMutexLock l(&lock_);
+  if (!pipeline_initialized_) {
+    return MAKE_ERROR(ERR_NOT_INITIALIZED) << "Not initialized!";
+  }
+
+  switch (req.update_case()) {
+    case ::p4::v1::StreamMessageRequest::kPacket: {
+      return nikss_packetio_manager_->TransmitPacket(req.packet());
+    }
+    case ::p4::v1::StreamMessageRequest::kDigestAck: {
+      return nikss_digest_manager_->HandleDigestListAck(req.digest_ack());
+    }
+    default:
+      return MAKE_ERROR(ERR_UNIMPLEMENTED)
+             << "Unsupported StreamMessageRequest " << req.ShortDebugString()
+             << ".";
+  }
+}
+
+::util::Status NikssNode::Shutdown() {
+  absl::WriterMutexLock l(&lock_);
+  ::util::Status status = ::util::OkStatus();
+  APPEND_STATUS_IF_ERROR(status, nikss_packetio_manager_->Shutdown());
+  APPEND_STATUS_IF_ERROR(status, nikss_digest_manager_->Shutdown());
+  pipeline_initialized_ = false;
+  return status;
+}
+
+std::string NikssNode::DumpPacketIoStats() {
+  return nikss_packetio_manager_->DumpStats();
+}
+
+::util::Status NikssNode::WriteTableEntry(
+    std::shared_ptr<NikssInterface::SessionInterface> session,
+    const ::p4::v1::Update::Type type,
+    const ::p4::v1::TableEntry& table_entry) {
+  ASSIGN_OR_RETURN(auto table,
+                   p4_info_manager_->FindTableByID(table_entry.table_id()));
+  ::p4::config::v1::Action action;
+  if (table.implementation_id()) {
+    // Entries of tables with an action selector are written with the NIKSS
+    // references of the members and groups.
+    ::p4::v1::TableEntry nikss_entry = table_entry;
+    if (type != ::p4::v1::Update::DELETE) {
+      RETURN_IF_ERROR(ToNikssReference(
+          gtl::FindOrNull(action_profiles_, table.implementation_id()),
+          nikss_entry.mutable_action()));
+    }
+    return nikss_interface_->WriteTableEntry(session, type, table, action,
+                                             nikss_entry);
+  }
+  if (type != ::p4::v1::Update::DELETE) {
+    RET_CHECK(table_entry.action().type_case() == ::p4::v1::TableAction::kAction)
+        << "Only direct actions are supported, got "
+        << table_entry.action().ShortDebugString() << ".";
+    ASSIGN_OR_RETURN(action, p4_info_manager_->FindActionByID(
+                                 table_entry.action().action().action_id()));
+  }
+  return nikss_interface_->WriteTableEntry(session, type, table, action,
+                                           table_entry);
+}
+
+::util::Status NikssNode::ReadTableEntry(
+    std::shared_ptr<NikssInterface::SessionInterface> session,
+    const ::p4::v1::TableEntry& table_entry,
+    WriterInterface<::p4::v1::ReadResponse>* writer) {
+  std::vector<::p4::config::v1::Table> tables;
+  if (table_entry.table_id() == 0) {
+    // Wildcard read of all tables.
+    RET_CHECK(!table_entry.match_size() && !table_entry.is_default_action())
+        << "Match fields and default actions require a table ID.";
+    const auto& p4info_tables = p4_info_manager_->p4_info().tables();
+    tables.assign(p4info_tables.begin(), p4info_tables.end());
+  } else {
+    ASSIGN_OR_RETURN(auto table,
+                     p4_info_manager_->FindTableByID(table_entry.table_id()));
+    tables.push_back(table);
+  }
+
+  // Entries are streamed to the controller in bounded chunks while the BPF
+  // maps are walked.
+  ChunkedReadResponseWriter<::p4::v1::TableEntry> chunked_writer(
+      writer, &::p4::v1::Entity::mutable_table_entry,
+      FLAGS_nikss_read_chunk_size_bytes);
+  for (const auto& table : tables) {
+    std::vector<::p4::config::v1::Action> actions;
+    for (const auto& action_ref : table.action_refs()) {
+      ASSIGN_OR_RETURN(auto action,
+                       p4_info_manager_->FindActionByID(action_ref.id()));
+      actions.push_back(action);
+    }
+    if (table.implementation_id()) {
+      const ActionProfileState empty_state;
+      const auto* state =
+          gtl::FindOrNull(action_profiles_, table.implementation_id());
+      if (!state) state = &empty_state;
+      ActionProfileReferenceTranslator translator(
+          state->member_ids, state->group_ids, &chunked_writer);
+      RETURN_IF_ERROR(nikss_interface_->ReadTableEntries(
+          session, table, actions, table_entry, &translator));
+      continue;
+    }
+    RETURN_IF_ERROR(nikss_interface_->ReadTableEntries(
+        session, table, actions, table_entry, &chunked_writer));
+  }
+  RET_CHECK(chunked_writer.Flush()) << "Write to stream channel failed.";
+
+  return ::util::OkStatus();
+}
+
+::util::Status NikssNode::WriteCounterEntry(
+    std::shared_ptr<NikssInterface::SessionInterface> session,
+    const ::p4::v1::Update::Type type,
+    const ::p4::v1::CounterEntry& counter_entry) {
+  RET_CHECK(type == ::p4::v1::Update::MODIFY)
+      << "Update type of CounterEntry " << counter_entry.ShortDebugString()
+      << " must be MODIFY.";
+  ASSIGN_OR_RETURN(auto counter, p4_info_manager_->FindCounterByID(
+                                     counter_entry.counter_id()));
+  RETURN_IF_ERROR(
+      CheckIndex(counter.preamble(), counter.size(), counter_entry));
+  return nikss_interface_->WriteIndirectCounter(session, counter,
+                                                counter_entry);
+}
+
+::util::Status NikssNode::ReadCounterEntry(
+    std::shared_ptr<NikssInterface::SessionInterface> session,
+    const ::p4::v1::CounterEntry& counter_entry,
+    WriterInterface<::p4::v1::ReadResponse>* writer) {
+  std::vector<::p4::config::v1::Counter> counters;
+  if (counter_entry.counter_id() == 0) {
+    // Wildcard read of all counters.
+    RET_CHECK(!counter_entry.has_index())
+        << "An index requires a counter ID.";
+    const auto& p4info_counters = p4_info_manager_->p4_info().counters();
+    counters.assign(p4info_counters.begin(), p4info_counters.end());
+  } else {
+    ASSIGN_OR_RETURN(auto counter, p4_info_manager_->FindCounterByID(
+                                       counter_entry.counter_id()));
+    RETURN_IF_ERROR(
+        CheckIndex(counter.preamble(), counter.size(), counter_entry));
+    counters.push_back(counter);
+  }
+
+  ChunkedReadResponseWriter<::p4::v1::CounterEntry> chunked_writer(
+      writer, &::p4::v1::Entity::mutable_counter_entry,
+      FLAGS_nikss_read_chunk_size_bytes);
+  for (const auto& counter : counters) {
+    RETURN_IF_ERROR(nikss_interface_->ReadIndirectCounter(
+        session, counter, counter_entry, &chunked_writer));
+  }
+  RET_CHECK(chunked_writer.Flush()) << "Write to stream channel failed.";
+
+  return ::util::OkStatus();
+}
+
+::util::Status NikssNode::WriteDirectCounterEntry(
+    std::shared_ptr<NikssInterface::SessionInterface> session,
+    const ::p4::v1::Update::Type type,
+    const ::p4::v1::DirectCounterEntry& direct_counter_entry) {
+  RET_CHECK(type == ::p4::v1::Update::MODIFY)
+      << "Update type of DirectCounterEntry "
+      << direct_counter_entry.ShortDebugString() << " must be MODIFY.";
+  ASSIGN_OR_RETURN(auto table,
+                   p4_info_manager_->FindTableByID(
+                       direct_counter_entry.table_entry().table_id()));
+  ASSIGN_OR_RETURN(auto direct_counter,
+                   FindDirectCounterOfTable(*p4_info_manager_, table));
+  return nikss_interface_->WriteDirectCounter(session, table, direct_counter,
+                                              direct_counter_entry);
+}
+
+::util::Status NikssNode::ReadDirectCounterEntry(
+    std::shared_ptr<NikssInterface::SessionInterface> session,
+    const ::p4::v1::DirectCounterEntry& direct_counter_entry,
+    WriterInterface<::p4::v1::ReadResponse>* writer) {
+  std::vector<std::pair<::p4::config::v1::Table,
+                        ::p4::config::v1::DirectCounter>> counters;
+  if (direct_counter_entry.table_entry().table_id() == 0) {
+    // Wildcard read of the direct counters of all tables.
+    RET_CHECK(!direct_counter_entry.table_entry().match_size())
+        << "Match fields require a table ID.";
+    for (const auto& direct_counter :
+         p4_info_manager_->p4_info().direct_counters()) {
+      ASSIGN_OR_RETURN(auto table, p4_info_manager_->FindTableByID(
+                                       direct_counter.direct_table_id()));
+      counters.emplace_back(table, direct_counter);
+    }
+  } else {
+    ASSIGN_OR_RETURN(auto table,
+                     p4_info_manager_->FindTableByID(
+                         direct_counter_entry.table_entry().table_id()));
+    ASSIGN_OR_RETURN(auto direct_counter,
+                   FindDirectCounterOfTable(*p4_info_manager_, table));
+    counters.emplace_back(table, direct_counter);
+  }
+
+  ChunkedReadResponseWriter<::p4::v1::DirectCounterEntry> chunked_writer(
+      writer, &::p4::v1::Entity::mutable_direct_counter_entry,
+      FLAGS_nikss_read_chunk_size_bytes);
+  for (const auto& counter : counters) {
+    RETURN_IF_ERROR(nikss_interface_->ReadDirectCounter(
+        session, counter.first, counter.second, direct_counter_entry,
+        &chunked_writer));
+  }
+  RET_CHECK(chunked_writer.Flush()) << "Write to stream channel failed.";
+
+  return ::util::OkStatus();
+}
+
+::util::Status NikssNode::WriteMeterEntry(
+    std::shared_ptr<NikssInterface::SessionInterface> session,
+    const ::p4::v1::Update::Type type,
+    const ::p4::v1::MeterEntry& meter_entry) {
+  RET_CHECK(type == ::p4::v1::Update::MODIFY)
+      << "Update type of MeterEntry " << meter_entry.ShortDebugString()
+      << " must be MODIFY.";
+  ASSIGN_OR_RETURN(auto meter,
+                   p4_info_manager_->FindMeterByID(meter_entry.meter_id()));
+  RETURN_IF_ERROR(CheckIndex(meter.preamble(), meter.size(), meter_entry));
+  return nikss_interface_->WriteMeter(session, meter, meter_entry);
+}
+
+::util::Status NikssNode::ReadMeterEntry(
+    std::shared_ptr<NikssInterface::SessionInterface> session,
+    const ::p4::v1::MeterEntry& meter_entry,
+    WriterInterface<::p4::v1::ReadResponse>* writer) {
+  std::vector<::p4::config::v1::Meter> meters;
+  if (meter_entry.meter_id() == 0) {
+    // Wildcard read of all meters.
+    RET_CHECK(!meter_entry.has_index()) << "An index requires a meter ID.";
+    const auto& p4info_meters = p4_info_manager_->p4_info().meters();
+    meters.assign(p4info_meters.begin(), p4info_meters.end());
+  } else {
+    ASSIGN_OR_RETURN(auto meter,
+                     p4_info_manager_->FindMeterByID(meter_entry.meter_id()));
+    RETURN_IF_ERROR(CheckIndex(meter.preamble(), meter.size(), meter_entry));
+    meters.push_back(meter);
+  }
+
+  ChunkedReadResponseWriter<::p4::v1::MeterEntry> chunked_writer(
+      writer, &::p4::v1::Entity::mutable_meter_entry,
+      FLAGS_nikss_read_chunk_size_bytes);
+  for (const auto& meter : meters) {
+    RETURN_IF_ERROR(nikss_interface_->ReadMeter(session, meter, meter_entry,
+                                                &chunked_writer));
+  }
+  RET_CHECK(chunked_writer.Flush()) << "Write to stream channel failed.";
+
+  return ::util::OkStatus();
+}
+
+::util::Status NikssNode::WriteDirectMeterEntry(
+    std::shared_ptr<NikssInterface::SessionInterface> session,
+    const ::p4::v1::Update::Type type,
+    const ::p4::v1::DirectMeterEntry& direct_meter_entry) {
+  RET_CHECK(type == ::p4::v1::Update::MODIFY)
+      << "Update type of DirectMeterEntry "
+      << direct_meter_entry.ShortDebugString() << " must be MODIFY.";
+  ASSIGN_OR_RETURN(auto table,
+                   p4_info_manager_->FindTableByID(
+                       direct_meter_entry.table_entry().table_id()));
+  ASSIGN_OR_RETURN(auto direct_meter,
+                   FindDirectMeterOfTable(*p4_info_manager_, table));
+  return nikss_interface_->WriteDirectMeter(session, table, direct_meter,
+                                            direct_meter_entry);
+}
+
+::util::Status NikssNode::ReadDirectMeterEntry(
+    std::shared_ptr<NikssInterface::SessionInterface> session,
+    const ::p4::v1::DirectMeterEntry& direct_meter_entry,
+    WriterInterface<::p4::v1::ReadResponse>* writer) {
+  std::vector<std::pair<::p4::config::v1::Table,
+                        ::p4::config::v1::DirectMeter>> meters;
+  if (direct_meter_entry.table_entry().table_id() == 0) {
+    // Wildcard read of the direct meters of all tables.
+    RET_CHECK(!direct_meter_entry.table_entry().match_size())
+        << "Match fields require a table ID.";
+    for (const auto& direct_meter :
+         p4_info_manager_->p4_info().direct_meters()) {
+      ASSIGN_OR_RETURN(auto table, p4_info_manager_->FindTableByID(
+                                       direct_meter.direct_table_id()));
+      meters.emplace_back(table, direct_meter);
+    }
+  } else {
+    ASSIGN_OR_RETURN(auto table,
+                     p4_info_manager_->FindTableByID(
+                         direct_meter_entry.table_entry().table_id()));
+    ASSIGN_OR_RETURN(auto direct_meter,
+                   FindDirectMeterOfTable(*p4_info_manager_, table));
+    meters.emplace_back(table, direct_meter);
+  }
+
+  ChunkedReadResponseWriter<::p4::v1::DirectMeterEntry> chunked_writer(
+      writer, &::p4::v1::Entity::mutable_direct_meter_entry,
+      FLAGS_nikss_read_chunk_size_bytes);
+  for (const auto& meter : meters) {
+    RETURN_IF_ERROR(nikss_interface_->ReadDirectMeter(
+        session, meter.first, meter.second, direct_meter_entry,
+        &chunked_writer));
+  }
+  RET_CHECK(chunked_writer.Flush()) << "Write to stream channel failed.";
+
+  return ::util::OkStatus();
+}
+
+::util::Status NikssNode::WriteRegisterEntry(
+    std::shared_ptr<NikssInterface::SessionInterface> session,
+    const ::p4::v1::Update::Type type,
+    const ::p4::v1::RegisterEntry& register_entry) {
+  RET_CHECK(type == ::p4::v1::Update::MODIFY)
+      << "Update type of RegisterEntry " << register_entry.ShortDebugString()
+      << " must be MODIFY.";
+  ASSIGN_OR_RETURN(auto reg, p4_info_manager_->FindRegisterByID(
+                                 register_entry.register_id()));
+  RETURN_IF_ERROR(CheckIndex(reg.preamble(), reg.size(), register_entry));
+  return nikss_interface_->WriteRegister(session, reg, register_entry);
+}
+
+::util::Status NikssNode::ReadRegisterEntry(
+    std::shared_ptr<NikssInterface::SessionInterface> session,
+    const ::p4::v1::RegisterEntry& register_entry,
+    WriterInterface<::p4::v1::ReadResponse>* writer) {
+  std::vector<::p4::config::v1::Register> registers;
+  if (register_entry.register_id() == 0) {
+    // Wildcard read of all registers.
+    RET_CHECK(!register_entry.has_index())
+        << "An index requires a register ID.";
+    const auto& p4info_registers = p4_info_manager_->p4_info().registers();
+    registers.assign(p4info_registers.begin(), p4info_registers.end());
+  } else {
+    ASSIGN_OR_RETURN(auto reg, p4_info_manager_->FindRegisterByID(
+                                   register_entry.register_id()));
+    RETURN_IF_ERROR(CheckIndex(reg.preamble(), reg.size(), register_entry));
+    registers.push_back(reg);
+  }
+
+  ChunkedReadResponseWriter<::p4::v1::RegisterEntry> chunked_writer(
+      writer, &::p4::v1::Entity::mutable_register_entry,
+      FLAGS_nikss_read_chunk_size_bytes);
+  for (const auto& reg : registers) {
+    RETURN_IF_ERROR(nikss_interface_->ReadRegister(session, reg, register_entry,
+                                                   &chunked_writer));
+  }
+  RET_CHECK(chunked_writer.Flush()) << "Write to stream channel failed.";
+
+  return ::util::OkStatus();
+}
+
+::util::Status NikssNode::WriteValueSetEntry(
+    std::shared_ptr<NikssInterface::SessionInterface> session,
+    const ::p4::v1::Update::Type type,
+    const ::p4::v1::ValueSetEntry& value_set_entry) {
+  RET_CHECK(type == ::p4::v1::Update::MODIFY)
+      << "Update type of ValueSetEntry " << value_set_entry.ShortDebugString()
+      << " must be MODIFY.";
+  ASSIGN_OR_RETURN(auto value_set, p4_info_manager_->FindValueSetByID(
+                                       value_set_entry.value_set_id()));
+  return nikss_interface_->WriteValueSet(session, value_set, value_set_entry);
+}
+
+::util::Status NikssNode::ReadValueSetEntry(
+    std::shared_ptr<NikssInterface::SessionInterface> session,
+    const ::p4::v1::ValueSetEntry& value_set_entry,
+    WriterInterface<::p4::v1::ReadResponse>* writer) {
+  std::vector<::p4::config::v1::ValueSet> value_sets;
+  if (value_set_entry.value_set_id() == 0) {
+    // Wildcard read of all value sets.
+    const auto& p4info_value_sets = p4_info_manager_->p4_info().value_sets();
+    value_sets.assign(p4info_value_sets.begin(), p4info_value_sets.end());
+  } else {
+    ASSIGN_OR_RETURN(auto value_set, p4_info_manager_->FindValueSetByID(
+                                         value_set_entry.value_set_id()));
+    value_sets.push_back(value_set);
+  }
+
+  ChunkedReadResponseWriter<::p4::v1::ValueSetEntry> chunked_writer(
+      writer, &::p4::v1::Entity::mutable_value_set_entry,
+      FLAGS_nikss_read_chunk_size_bytes);
+  ::p4::v1::ValueSetEntry result;
+  for (const auto& value_set : value_sets) {
+    RETURN_IF_ERROR(
+        nikss_interface_->ReadValueSet(session, value_set, &result));
+    RET_CHECK(chunked_writer.Write(result))
+        << "Write to stream channel failed.";
+  }
+  RET_CHECK(chunked_writer.Flush()) << "Write to stream channel failed.";
+
+  return ::util::OkStatus();
+}
+
+::util::Status NikssNode::ReadPreEntry(
+    std::shared_ptr<NikssInterface::SessionInterface> session,
+    const PreEntry& entry, WriterInterface<::p4::v1::ReadResponse>* writer) {
+  ChunkedReadResponseWriter<PreEntry> chunked_writer(
+      writer, &::p4::v1::Entity::mutable_packet_replication_engine_entry,
+      FLAGS_nikss_read_chunk_size_bytes);
+  RETURN_IF_ERROR(
+      nikss_pre_manager_->ReadPreEntry(session, entry, &chunked_writer));
+  RET_CHECK(chunked_writer.Flush()) << "Write to stream channel failed.";
+
+  return ::util::OkStatus();
+}
+
+::util::Status NikssNode::ReadDigestEntry(
+    const ::p4::v1::DigestEntry& digest_entry,
+    WriterInterface<::p4::v1::ReadResponse>* writer) {
+  ChunkedReadResponseWriter<::p4::v1::DigestEntry> chunked_writer(
+      writer, &::p4::v1::Entity::mutable_digest_entry,
+      FLAGS_nikss_read_chunk_size_bytes);
+  RETURN_IF_ERROR(
+      nikss_digest_manager_->ReadDigestEntry(digest_entry, &chunked_writer));
+  RET_CHECK(chunked_writer.Flush()) << "Write to stream channel failed.";
+
+  return ::util::OkStatus();
+}
+
+::util::StatusOr<std::vector<::p4::config::v1::Action>>
+NikssNode::FindActionsOfActionProfile(
+    const ::p4::config::v1::ActionProfile& action_profile) {
+  std::vector<::p4::config::v1::Action> actions;
+  absl::flat_hash_set<uint32> action_ids;
+  for (const auto table_id : action_profile.table_ids()) {
+    ASSIGN_OR_RETURN(auto table, p4_info_manager_->FindTableByID(table_id));
+    for (const auto& action_ref : table.action_refs()) {
+      if (!action_ids.insert(action_ref.id()).second) continue;
+      ASSIGN_OR_RETURN(auto action,
+                       p4_info_manager_->FindActionByID(action_ref.id()));
+      actions.push_back(action);
+    }
+  }
+  return actions;
+}
+
+::util::Status NikssNode::ToNikssReference(const ActionProfileState* state,
+                                           ::p4::v1::TableAction* action) {
+  switch (action->type_case()) {
+    case ::p4::v1::TableAction::kActionProfileMemberId: {
+      const uint32* member_ref =
+          state ? gtl::FindOrNull(state->member_refs,
+                                  action->action_profile_member_id())
+                : nullptr;
+      if (!member_ref) {
+        return MAKE_ERROR(ERR_ENTRY_NOT_FOUND)
+               << "Unknown action profile member "
+               << action->action_profile_member_id() << ".";
+      }
+      action->set_action_profile_member_id(*member_ref);
+      break;
+    }
+    case ::p4::v1::TableAction::kActionProfileGroupId: {
+      const uint32* group_ref =
+          state ? gtl::FindOrNull(state->group_refs,
+                                  action->action_profile_group_id())
+                : nullptr;
+      if (!group_ref) {
+        return MAKE_ERROR(ERR_ENTRY_NOT_FOUND)
+               << "Unknown action profile group "
+               << action->action_profile_group_id() << ".";
+      }
+      action->set_action_profile_group_id(*group_ref);
+      break;
+    }
+    default:
+      return MAKE_ERROR(ERR_INVALID_PARAM)
+             << "Table action " << action->ShortDebugString()
+             << " must refer to an action profile member or group.";
+  }
+  return ::util::OkStatus();
+}
+
+::util::Status NikssNode::WriteActionProfileMember(
+    std::shared_ptr<NikssInterface::SessionInterface> session,
+    const ::p4::v1::Update::Type type,
+    const ::p4::v1::ActionProfileMember& member) {
+  ASSIGN_OR_RETURN(auto action_profile,
+                   p4_info_manager_->FindActionProfileByID(
+                       member.action_profile_id()));
+  auto& state = action_profiles_[member.action_profile_id()];
+  const uint32* member_ref =
+      gtl::FindOrNull(state.member_refs, member.member_id());
+  switch (type) {
+    case ::p4::v1::Update::INSERT: {
+      if (member_ref) {
+        return MAKE_ERROR(ERR_ENTRY_EXISTS)
+               << "Action profile member " << member.member_id()
+               << " already exists.";
+      }
+      ASSIGN_OR_RETURN(auto action_info, p4_info_manager_->FindActionByID(
+                                             member.action().action_id()));
+      ASSIGN_OR_RETURN(const uint32 new_member_ref,
+                       nikss_interface_->InsertActionProfileMember(
+                           session, action_profile, action_info,
+                           member.action()));
+      state.member_refs[member.member_id()] = new_member_ref;
+      state.member_ids[new_member_ref] = member.member_id();
+      break;
+    }
+    case ::p4::v1::Update::MODIFY: {
+      if (!member_ref) {
+        return MAKE_ERROR(ERR_ENTRY_NOT_FOUND)
+               << "Action profile member " << member.member_id()
+               << " does not exist.";
+      }
+      ASSIGN_OR_RETURN(auto action_info, p4_info_manager_->FindActionByID(
+                                             member.action().action_id()));
+      RETURN_IF_ERROR(nikss_interface_->ModifyActionProfileMember(
+          session, action_profile, action_info, member.action(),
+          *member_ref));
+      break;
+    }
+    case ::p4::v1::Update::DELETE: {
+      if (!member_ref) {
+        return MAKE_ERROR(ERR_ENTRY_NOT_FOUND)
+               << "Action profile member " << member.member_id()
+               << " does not exist.";
+      }
+      for (const auto& group : state.group_members) {
+        if (group.second.contains(member.member_id())) {
+          return MAKE_ERROR(ERR_INVALID_PARAM)
+                 << "Action profile member " << member.member_id()
+                 << " is still used by group " << group.first << ".";
+        }
+      }
+      const uint32 old_member_ref = *member_ref;
+      RETURN_IF_ERROR(nikss_interface_->DeleteActionProfileMember(
+          session, action_profile, old_member_ref));
+      state.member_refs.erase(member.member_id());
+      state.member_ids.erase(old_member_ref);
+      break;
+    }
+    default:
+      return MAKE_ERROR(ERR_INVALID_PARAM)
+             << "Unsupported update type: " << type << " in action profile "
+             << "member " << member.ShortDebugString() << ".";
+  }
+
+  return ::util::OkStatus();
+}
+
+::util::Status NikssNode::ReadActionProfileMember(
+    std::shared_ptr<NikssInterface::SessionInterface> session,
+    const ::p4::v1::ActionProfileMember& member,
+    WriterInterface<::p4::v1::ReadResponse>* writer) {
+  std::vector<::p4::config::v1::ActionProfile> action_profiles;
+  if (member.action_profile_id() == 0) {
+    // Wildcard read of all action selectors.
+    RET_CHECK(member.member_id() == 0)
+        << "A member ID requires an action profile ID.";
+    for (const auto& action_profile :
+         p4_info_manager_->p4_info().action_profiles()) {
+      if (action_profile.with_selector()) {
+        action_profiles.push_back(action_profile);
+      }
+    }
+  } else {
+    ASSIGN_OR_RETURN(auto action_profile,
+                     p4_info_manager_->FindActionProfileByID(
+                         member.action_profile_id()));
+    action_profiles.push_back(action_profile);
+  }
+
+  ChunkedReadResponseWriter<::p4::v1::ActionProfileMember> chunked_writer(
+      writer, &::p4::v1::Entity::mutable_action_profile_member,
+      FLAGS_nikss_read_chunk_size_bytes);
+  for (const auto& action_profile : action_profiles) {
+    const uint32 action_profile_id = action_profile.preamble().id();
+    const auto* state = gtl::FindOrNull(action_profiles_, action_profile_id);
+    if (!state) continue;
+    ASSIGN_OR_RETURN(auto actions, FindActionsOfActionProfile(action_profile));
+    std::vector<std::pair<uint32, ::p4::v1::Action>> members;
+    RETURN_IF_ERROR(nikss_interface_->ReadActionProfileMembers(
+        session, action_profile, actions, &members));
+    ::p4::v1::ActionProfileMember result;
+    for (auto& e : members) {
+      const uint32* member_id = gtl::FindOrNull(state->member_ids, e.first);
+      if (!member_id) {
+        VLOG(1) << "Skipping unknown NIKSS member " << e.first
+                << " of action profile " << action_profile.preamble().name()
+                << ".";
+        continue;
+      }
+      if (member.member_id() && member.member_id() != *member_id) continue;
+      result.set_action_profile_id(action_profile_id);
+      result.set_member_id(*member_id);
+      *result.mutable_action() = std::move(e.second);
+      RET_CHECK(chunked_writer.Write(result))
+          << "Write to stream channel failed.";
+    }
+  }
+  RET_CHECK(chunked_writer.Flush()) << "Write to stream channel failed.";
+
+  return ::util::OkStatus();
+}
+
+::util::Status NikssNode::WriteActionProfileGroup(
+    std::shared_ptr<NikssInterface::SessionInterface> session,
+    const ::p4::v1::Update::Type type,
+    const ::p4::v1::ActionProfileGroup& group) {
+  ASSIGN_OR_RETURN(auto action_profile,
+                   p4_info_manager_->FindActionProfileByID(
+                       group.action_profile_id()));
+  auto& state = action_profiles_[group.action_profile_id()];
+  const uint32* group_ref = gtl::FindOrNull(state.group_refs, group.group_id());
+
+  absl::flat_hash_set<uint32> member_ids;
+  if (type != ::p4::v1::Update::DELETE) {
+    for (const auto& member : group.members()) {
+      if (member.weight() > 1) {
+        return MAKE_ERROR(ERR_UNIMPLEMENTED)
+               << "Member weights are not supported by NIKSS action "
+               << "selectors, got " << member.ShortDebugString() << ".";
+      }
+      if (!state.member_refs.contains(member.member_id())) {
+        return MAKE_ERROR(ERR_ENTRY_NOT_FOUND)
+               << "Action profile member " << member.member_id()
+               << " of group " << group.group_id() << " does not exist.";
+      }
+      member_ids.insert(member.member_id());
+    }
+    const int max_group_size = action_profile.max_group_size();
+    if (max_group_size > 0 &&
+        static_cast<int>(member_ids.size()) > max_group_size) {
+      return MAKE_ERROR(ERR_INVALID_PARAM)
+             << "Group " << group.group_id() << " exceeds the maximum size "
+             << max_group_size << " of action profile "
+             << action_profile.preamble().name() << ".";
+    }
+  }
+
+  switch (type) {
+    case ::p4::v1::Update::INSERT: {
+      if (group_ref) {
+        return MAKE_ERROR(ERR_ENTRY_EXISTS)
+               << "Action profile group " << group.group_id()
+               << " already exists.";
+      }
+      ASSIGN_OR_RETURN(
+          const uint32 new_group_ref,
+          nikss_interface_->InsertActionProfileGroup(session, action_profile));
+      state.group_refs[group.group_id()] = new_group_ref;
+      state.group_ids[new_group_ref] = group.group_id();
+      state.group_members[group.group_id()];
+      return UpdateActionProfileGroupMembers(session, action_profile, &state,
+                                             group.group_id(), member_ids);
+    }
+    case ::p4::v1::Update::MODIFY: {
+      if (!group_ref) {
+        return MAKE_ERROR(ERR_ENTRY_NOT_FOUND)
+               << "Action profile group " << group.group_id()
+               << " does not exist.";
+      }
+      return UpdateActionProfileGroupMembers(session, action_profile, &state,
+                                             group.group_id(), member_ids);
+    }
+    case ::p4::v1::Update::DELETE: {
+      if (!group_ref) {
+        return MAKE_ERROR(ERR_ENTRY_NOT_FOUND)
+               << "Action profile group " << group.group_id()
+               << " does not exist.";
+      }
+      const uint32 old_group_ref = *group_ref;
+      RETURN_IF_ERROR(nikss_interface_->DeleteActionProfileGroup(
+          session, action_profile, old_group_ref));
+      state.group_refs.erase(group.group_id());
+      state.group_ids.erase(old_group_ref);
+      state.group_members.erase(group.group_id());
+      return ::util::OkStatus();
+    }
+    default:
+      return MAKE_ERROR(ERR_INVALID_PARAM)
+             << "Unsupported update type: " << type << " in action profile "
+             << "group " << group.ShortDebugString() << ".";
+  }
+}
+
+::util::Status NikssNode::UpdateActionProfileGroupMembers(
+    std::shared_ptr<NikssInterface::SessionInterface> session,
+    const ::p4::config::v1::ActionProfile& action_profile,
+    ActionProfileState* state, uint32 group_id,
+    const absl::flat_hash_set<uint32>& member_ids) {
+  const uint32 group_ref = state->group_refs.at(group_id);
+  auto& current_members = state->group_members[group_id];
+  // Stale members are removed first to make room for the new ones. The state
+  // is updated after each change, so that it stays in sync with the data
+  // plane if a change fails.
+  std::vector<uint32> stale_members;
+  for (const auto member_id : current_members) {
+    if (!member_ids.contains(member_id)) stale_members.push_back(member_id);
+  }
+  for (const auto member_id : stale_members) {
+    RETURN_IF_ERROR(nikss_interface_->RemoveActionProfileGroupMember(
+        session, action_profile, group_ref, state->member_refs.at(member_id)));
+    current_members.erase(member_id);
+  }
+  for (const auto member_id : member_ids) {
+    if (current_members.contains(member_id)) continue;
+    RETURN_IF_ERROR(nikss_interface_->AddActionProfileGroupMember(
+        session, action_profile, group_ref, state->member_refs.at(member_id)));
+    current_members.insert(member_id);
+  }
+
+  return ::util::OkStatus();
+}
+
+::util::Status NikssNode::ReadActionProfileGroup(
+    std::shared_ptr<NikssInterface::SessionInterface> session,
+    const ::p4::v1::ActionProfileGroup& group,
+    WriterInterface<::p4::v1::ReadResponse>* writer) {
+  std::vector<::p4::config::v1::ActionProfile> action_profiles;
+  if (group.action_profile_id() == 0) {
+    // Wildcard read of all action selectors.
+    RET_CHECK(group.group_id() == 0)
+        << "A group ID requires an action profile ID.";
+    for (const auto& action_profile :
+         p4_info_manager_->p4_info().action_profiles()) {
+      if (action_profile.with_selector()) {
+        action_profiles.push_back(action_profile);
+      }
+    }
+  } else {
+    ASSIGN_OR_RETURN(auto action_profile,
+                     p4_info_manager_->FindActionProfileByID(
+                         group.action_profile_id()));
+    action_profiles.push_back(action_profile);
+  }
+
+  ChunkedReadResponseWriter<::p4::v1::ActionProfileGroup> chunked_writer(
+      writer, &::p4::v1::Entity::mutable_action_profile_group,
+      FLAGS_nikss_read_chunk_size_bytes);
+  for (const auto& action_profile : action_profiles) {
+    const uint32 action_profile_id = action_profile.preamble().id();
+    const auto* state = gtl::FindOrNull(action_profiles_, action_profile_id);
+    if (!state) continue;
+    std::vector<std::pair<uint32, std::vector<uint32>>> groups;
+    RETURN_IF_ERROR(nikss_interface_->ReadActionProfileGroups(
+        session, action_profile, &groups));
+    ::p4::v1::ActionProfileGroup result;
+    for (const auto& e : groups) {
+      const uint32* group_id = gtl::FindOrNull(state->group_ids, e.first);
+      if (!group_id) {
+        VLOG(1) << "Skipping unknown NIKSS group " << e.first
+                << " of action profile " << action_profile.preamble().name()
+                << ".";
+        continue;
+      }
+      if (group.group_id() && group.group_id() != *group_id) continue;
+      result.Clear();
+      result.set_action_profile_id(action_profile_id);
+      result.set_group_id(*group_id);
+      for (const auto member_ref : e.second) {
+        const uint32* member_id =
+            gtl::FindOrNull(state->member_ids, member_ref);
+        RET_CHECK(member_id) << "Unknown NIKSS member " << member_ref
+                             << " in group " << *group_id << ".";
+        auto* member = result.add_members();
+        member->set_member_id(*member_id);
+        member->set_weight(1);
+      }
+      RET_CHECK(chunked_writer.Write(result))
+          << "Write to stream channel failed.";
+    }
+  }
+  RET_CHECK(chunked_writer.Flush()) << "Write to stream channel failed.";
+
+  return ::util::OkStatus();
+}
+
 }  // namespace nikss
 }  // namespace hal
 }  // namespace stratum
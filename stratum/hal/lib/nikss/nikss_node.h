@@ -1,13 +1,25 @@
 #ifndef STRATUM_HAL_LIB_NIKSS_NIKSS_NODE_H_
 #define STRATUM_HAL_LIB_NIKSS_NIKSS_NODE_H_
 
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
 #include "absl/synchronization/mutex.h"
 #include "p4/v1/p4runtime.grpc.pb.h"
 #include "p4/v1/p4runtime.pb.h"
 #include "stratum/glue/integral_types.h"
 #include "stratum/glue/status/status.h"
+#include "stratum/glue/status/statusor.h"
+#include "stratum/hal/lib/common/writer_interface.h"
+#include "stratum/hal/lib/p4/p4_info_manager.h"
 
+#include "stratum/hal/lib/nikss/nikss_digest_manager.h"
 #include "stratum/hal/lib/nikss/nikss_interface.h"
+#include "stratum/hal/lib/nikss/nikss_packetio_manager.h"
+#include "stratum/hal/lib/nikss/nikss_pre_manager.h"
 
 namespace stratum {
 namespace hal {
@@ -24,10 +36,31 @@ class NikssNode {
   virtual ::util::Status CommitForwardingPipelineConfig() LOCKS_EXCLUDED(lock_);
   virtual ::util::Status VerifyForwardingPipelineConfig(
       const ::p4::v1::ForwardingPipelineConfig& config) const;
+  virtual ::util::Status WriteForwardingEntries(
+      const ::p4::v1::WriteRequest& req, std::vector<::util::Status>* results)
+      LOCKS_EXCLUDED(lock_);
+  virtual ::util::Status ReadForwardingEntries(
+      const ::p4::v1::ReadRequest& req,
+      WriterInterface<::p4::v1::ReadResponse>* writer,
+      std::vector<::util::Status>* details) LOCKS_EXCLUDED(lock_);
+  virtual ::util::Status RegisterStreamMessageResponseWriter(
+      const std::shared_ptr<WriterInterface<::p4::v1::StreamMessageResponse>>&
+          writer) LOCKS_EXCLUDED(lock_);
+  virtual ::util::Status UnregisterStreamMessageResponseWriter()
+      LOCKS_EXCLUDED(lock_);
+  virtual ::util::Status HandleStreamMessageRequest(
+      const ::p4::v1::StreamMessageRequest& req) LOCKS_EXCLUDED(lock_);
+  virtual ::util::Status Shutdown() LOCKS_EXCLUDED(lock_);
+
+  // Returns a human-readable dump of the packet IO counters of the node.
+  virtual std::string DumpPacketIoStats();
 
   // Factory function for creating the instance of the class.
   static std::unique_ptr<NikssNode> CreateInstance(
-      NikssInterface* nikss_interface, uint64 node_id);
+      NikssInterface* nikss_interface,
+      NikssPacketioManager* nikss_packetio_manager,
+      NikssDigestManager* nikss_digest_manager,
+      NikssPreManager* nikss_pre_manager, uint64 node_id);
 
   // NikssNode is neither copyable nor movable.
   NikssNode(const NikssNode&) = delete;
@@ -42,18 +75,277 @@ class NikssNode {
  private:
   // Private constructor. Use CreateInstance() to create an instance of this
   // class.
-  NikssNode(NikssInterface* nikss_interface, uint64 node_id);
+  NikssNode(NikssInterface* nikss_interface,
+            NikssPacketioManager* nikss_packetio_manager,
+            NikssDigestManager* nikss_digest_manager,
+            NikssPreManager* nikss_pre_manager, uint64 node_id);
+
+  // P4Runtime state of an action selector. NIKSS allocates its own references
+  // for members and groups, which are mapped to the P4Runtime IDs here.
+  struct ActionProfileState {
+    // Maps between member ID and NIKSS member reference.
+    absl::flat_hash_map<uint32, uint32> member_refs;
+    absl::flat_hash_map<uint32, uint32> member_ids;
+    // Maps between group ID and NIKSS group reference.
+    absl::flat_hash_map<uint32, uint32> group_refs;
+    absl::flat_hash_map<uint32, uint32> group_ids;
+    // Map from group ID to the IDs of the group members.
+    absl::flat_hash_map<uint32, absl::flat_hash_set<uint32>> group_members;
+  };
+
+  // Loads the pipeline of config_. A running pipeline is replaced with
+  // ReplacePipeline(), so that re-pushing a pipeline keeps its forwarding
+  // state.
+  ::util::Status CommitPipeline() EXCLUSIVE_LOCKS_REQUIRED(lock_);
+
+  // Replaces the running pipeline with the one of config_ without interrupting
+  // traffic. Table entries, action selectors, value sets, counters, meters and
+  // registers of the running pipeline are carried over as far as they fit the
+  // new P4Info, multicast groups and clone sessions entirely. Each type of
+  // state which is dropped is logged as a WARNING. Counters keep the counts up
+  // to the snapshot of the running pipeline, packets counted while the new
+  // pipeline is populated are lost. Entries of const tables and their direct
+  // counters and meters come from the new program. Fails without touching the
+  // running pipeline if its ports cannot be moved to the new pipeline
+  // atomically.
+  ::util::Status ReplacePipeline(const P4InfoManager& new_p4_info_manager)
+      EXCLUSIVE_LOCKS_REQUIRED(lock_);
+
+  // Writes the given action selector members and groups of the running
+  // pipeline into the standby pipeline, translated to the new P4Info. The
+  // NIKSS references of the new pipeline are stored in 'new_action_profiles'.
+  ::util::Status ReplayActionProfiles(
+      const P4InfoManager& new_p4_info_manager,
+      const std::vector<::p4::v1::Entity>& entities,
+      absl::flat_hash_map<uint32, ActionProfileState>* new_action_profiles)
+      EXCLUSIVE_LOCKS_REQUIRED(lock_);
+
+  // Writes the given entries of the running pipeline into the standby
+  // pipeline, translated to the new P4Info. Indirect entries refer to the
+  // members and groups in 'new_action_profiles'. The keys of the written
+  // entries are added to 'replayed_keys'.
+  ::util::Status ReplayTableEntries(
+      const P4InfoManager& new_p4_info_manager,
+      const absl::flat_hash_map<uint32, ActionProfileState>&
+          new_action_profiles,
+      const std::vector<::p4::v1::TableEntry>& entries,
+      absl::flat_hash_set<std::string>* replayed_keys)
+      EXCLUSIVE_LOCKS_REQUIRED(lock_);
+
+  // Writes the given value set, counter, meter and register entities of the
+  // running pipeline into the standby pipeline, translated to the new P4Info.
+  // Direct counters and meters are only written for the table entries in
+  // 'replayed_keys'.
+  ::util::Status ReplayResourceEntities(
+      const P4InfoManager& new_p4_info_manager,
+      const absl::flat_hash_set<std::string>& replayed_keys,
+      const std::vector<::p4::v1::Entity>& entities)
+      EXCLUSIVE_LOCKS_REQUIRED(lock_);
+
+  // Writes the given multicast groups and clone sessions of the running
+  // pipeline into the standby pipeline.
+  ::util::Status ReplayPreEntries(const std::vector<PreEntry>& entries)
+      EXCLUSIVE_LOCKS_REQUIRED(lock_);
+
+  // Writes a table entry.
+  ::util::Status WriteTableEntry(
+      std::shared_ptr<NikssInterface::SessionInterface> session,
+      const ::p4::v1::Update::Type type,
+      const ::p4::v1::TableEntry& table_entry)
+      SHARED_LOCKS_REQUIRED(lock_);
+
+  // Reads the P4 TableEntry(s) matched by the given table entry. A table ID of
+  // zero selects all tables.
+  ::util::Status ReadTableEntry(
+      std::shared_ptr<NikssInterface::SessionInterface> session,
+      const ::p4::v1::TableEntry& table_entry,
+      WriterInterface<::p4::v1::ReadResponse>* writer)
+      SHARED_LOCKS_REQUIRED(lock_);
+
+  // Writes a counter cell.
+  ::util::Status WriteCounterEntry(
+      std::shared_ptr<NikssInterface::SessionInterface> session,
+      const ::p4::v1::Update::Type type,
+      const ::p4::v1::CounterEntry& counter_entry)
+      SHARED_LOCKS_REQUIRED(lock_);
+
+  // Reads the counter cells matched by the given entry. A counter ID of zero
+  // selects all counters and a missing index all cells of a counter.
+  ::util::Status ReadCounterEntry(
+      std::shared_ptr<NikssInterface::SessionInterface> session,
+      const ::p4::v1::CounterEntry& counter_entry,
+      WriterInterface<::p4::v1::ReadResponse>* writer)
+      SHARED_LOCKS_REQUIRED(lock_);
+
+  // Writes the direct counter of a table entry.
+  ::util::Status WriteDirectCounterEntry(
+      std::shared_ptr<NikssInterface::SessionInterface> session,
+      const ::p4::v1::Update::Type type,
+      const ::p4::v1::DirectCounterEntry& direct_counter_entry)
+      SHARED_LOCKS_REQUIRED(lock_);
+
+  // Reads the direct counters matched by the given entry. A table ID of zero
+  // selects all direct counters.
+  ::util::Status ReadDirectCounterEntry(
+      std::shared_ptr<NikssInterface::SessionInterface> session,
+      const ::p4::v1::DirectCounterEntry& direct_counter_entry,
+      WriterInterface<::p4::v1::ReadResponse>* writer)
+      SHARED_LOCKS_REQUIRED(lock_);
+
+  // Writes a meter cell.
+  ::util::Status WriteMeterEntry(
+      std::shared_ptr<NikssInterface::SessionInterface> session,
+      const ::p4::v1::Update::Type type,
+      const ::p4::v1::MeterEntry& meter_entry) SHARED_LOCKS_REQUIRED(lock_);
+
+  // Reads the meter cells matched by the given entry. A meter ID of zero
+  // selects all meters and a missing index all cells of a meter.
+  ::util::Status ReadMeterEntry(
+      std::shared_ptr<NikssInterface::SessionInterface> session,
+      const ::p4::v1::MeterEntry& meter_entry,
+      WriterInterface<::p4::v1::ReadResponse>* writer)
+      SHARED_LOCKS_REQUIRED(lock_);
+
+  // Writes the direct meter of a table entry.
+  ::util::Status WriteDirectMeterEntry(
+      std::shared_ptr<NikssInterface::SessionInterface> session,
+      const ::p4::v1::Update::Type type,
+      const ::p4::v1::DirectMeterEntry& direct_meter_entry)
+      SHARED_LOCKS_REQUIRED(lock_);
+
+  // Reads the direct meters matched by the given entry. A table ID of zero
+  // selects all direct meters.
+  ::util::Status ReadDirectMeterEntry(
+      std::shared_ptr<NikssInterface::SessionInterface> session,
+      const ::p4::v1::DirectMeterEntry& direct_meter_entry,
+      WriterInterface<::p4::v1::ReadResponse>* writer)
+      SHARED_LOCKS_REQUIRED(lock_);
+
+  // Writes a register cell.
+  ::util::Status WriteRegisterEntry(
+      std::shared_ptr<NikssInterface::SessionInterface> session,
+      const ::p4::v1::Update::Type type,
+      const ::p4::v1::RegisterEntry& register_entry)
+      SHARED_LOCKS_REQUIRED(lock_);
+
+  // Reads the register cells matched by the given entry. A register ID of zero
+  // selects all registers and a missing index all cells of a register.
+  ::util::Status ReadRegisterEntry(
+      std::shared_ptr<NikssInterface::SessionInterface> session,
+      const ::p4::v1::RegisterEntry& register_entry,
+      WriterInterface<::p4::v1::ReadResponse>* writer)
+      SHARED_LOCKS_REQUIRED(lock_);
+
+  // Replaces the members of a value set.
+  ::util::Status WriteValueSetEntry(
+      std::shared_ptr<NikssInterface::SessionInterface> session,
+      const ::p4::v1::Update::Type type,
+      const ::p4::v1::ValueSetEntry& value_set_entry)
+      SHARED_LOCKS_REQUIRED(lock_);
+
+  // Reads the members of the given value set. A value set ID of zero selects
+  // all value sets.
+  ::util::Status ReadValueSetEntry(
+      std::shared_ptr<NikssInterface::SessionInterface> session,
+      const ::p4::v1::ValueSetEntry& value_set_entry,
+      WriterInterface<::p4::v1::ReadResponse>* writer)
+      SHARED_LOCKS_REQUIRED(lock_);
+
+  // Reads the multicast groups or clone sessions selected by the given entry.
+  ::util::Status ReadPreEntry(
+      std::shared_ptr<NikssInterface::SessionInterface> session,
+      const PreEntry& entry, WriterInterface<::p4::v1::ReadResponse>* writer)
+      SHARED_LOCKS_REQUIRED(lock_);
+
+  // Reads the configuration of the given digest. A digest ID of zero selects
+  // all configured digests.
+  ::util::Status ReadDigestEntry(
+      const ::p4::v1::DigestEntry& digest_entry,
+      WriterInterface<::p4::v1::ReadResponse>* writer)
+      SHARED_LOCKS_REQUIRED(lock_);
+
+  // Returns the actions of all tables sharing the given action profile.
+  ::util::StatusOr<std::vector<::p4::config::v1::Action>>
+  FindActionsOfActionProfile(
+      const ::p4::config::v1::ActionProfile& action_profile)
+      SHARED_LOCKS_REQUIRED(lock_);
+
+  // Replaces the member and group ID of an indirect table action with the
+  // NIKSS reference found in 'state', which may be null.
+  static ::util::Status ToNikssReference(const ActionProfileState* state,
+                                         ::p4::v1::TableAction* action);
+
+  // Writes an action profile member.
+  ::util::Status WriteActionProfileMember(
+      std::shared_ptr<NikssInterface::SessionInterface> session,
+      const ::p4::v1::Update::Type type,
+      const ::p4::v1::ActionProfileMember& member)
+      EXCLUSIVE_LOCKS_REQUIRED(lock_);
+
+  // Reads the action profile members matched by the given entry. An action
+  // profile ID of zero selects all action profiles and a member ID of zero all
+  // members.
+  ::util::Status ReadActionProfileMember(
+      std::shared_ptr<NikssInterface::SessionInterface> session,
+      const ::p4::v1::ActionProfileMember& member,
+      WriterInterface<::p4::v1::ReadResponse>* writer)
+      SHARED_LOCKS_REQUIRED(lock_);
+
+  // Writes an action profile group.
+  ::util::Status WriteActionProfileGroup(
+      std::shared_ptr<NikssInterface::SessionInterface> session,
+      const ::p4::v1::Update::Type type,
+      const ::p4::v1::ActionProfileGroup& group)
+      EXCLUSIVE_LOCKS_REQUIRED(lock_);
+
+  // Brings the members of a group to the given set. Only the members which
+  // differ are added or removed, so that a flapping member does not rewrite
+  // the whole group.
+  ::util::Status UpdateActionProfileGroupMembers(
+      std::shared_ptr<NikssInterface::SessionInterface> session,
+      const ::p4::config::v1::ActionProfile& action_profile,
+      ActionProfileState* state, uint32 group_id,
+      const absl::flat_hash_set<uint32>& member_ids)
+      EXCLUSIVE_LOCKS_REQUIRED(lock_);
+
+  // Reads the action profile groups matched by the given entry. An action
+  // profile ID of zero selects all action profiles and a group ID of zero all
+  // groups.
+  ::util::Status ReadActionProfileGroup(
+      std::shared_ptr<NikssInterface::SessionInterface> session,
+      const ::p4::v1::ActionProfileGroup& group,
+      WriterInterface<::p4::v1::ReadResponse>* writer)
+      SHARED_LOCKS_REQUIRED(lock_);
 
   // Reader-writer lock used to protect access to node-specific state.
   mutable absl::Mutex lock_;
 
+  // Flag indicating whether the pipeline has been pushed.
+  bool pipeline_initialized_ GUARDED_BY(lock_);
+
   // Stores pipeline information for this node.
   ::p4::v1::ForwardingPipelineConfig config_ GUARDED_BY(lock_);
 
+  // Helper class to validate the P4Info and requests against it.
+  std::unique_ptr<P4InfoManager> p4_info_manager_ GUARDED_BY(lock_);
+
+  // Map from action profile ID to the state of the action selector.
+  absl::flat_hash_map<uint32, ActionProfileState> action_profiles_
+      GUARDED_BY(lock_);
+
   // Pointer to a NikssInterface implementation that wraps all the SDE calls.
   // Not owned by this class.
   NikssInterface* nikss_interface_ = nullptr;
 
+  // Pointer to the packet IO manager of the CPU port. Not owned by this class.
+  NikssPacketioManager* nikss_packetio_manager_ = nullptr;
+
+  // Pointer to the digest manager of the pipeline. Not owned by this class.
+  NikssDigestManager* nikss_digest_manager_ = nullptr;
+
+  // Pointer to the PRE manager of the pipeline. Not owned by this class.
+  NikssPreManager* nikss_pre_manager_ = nullptr;
+
   // Logical node ID corresponding to the node/pipeline managed by this class
   // instance.
   uint64 node_id_ GUARDED_BY(lock_);
@@ -0,0 +1,1506 @@
+#include "stratum/hal/lib/nikss/nikss_node.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/memory/memory.h"
+#include "absl/strings/str_cat.h"
+#include "gflags/gflags.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "p4/v1/p4runtime.pb.h"
+#include "stratum/glue/status/status_macros.h"
+#include "stratum/glue/status/status_test_util.h"
+#include "stratum/hal/lib/common/writer_mock.h"
+#include "stratum/hal/lib/nikss/nikss_digest_manager_mock.h"
+#include "stratum/hal/lib/nikss/nikss_interface_mock.h"
+#include "stratum/hal/lib/nikss/nikss_packetio_manager_mock.h"
+#include "stratum/lib/test_utils/matchers.h"
+#include "stratum/lib/utils.h"
+
+DECLARE_int32(nikss_read_chunk_size_bytes);
+
+namespace stratum {
+namespace hal {
+namespace nikss {
+
+using test_utils::EqualsProto;
+using test_utils::StatusIs;
+using ::testing::_;
+using ::testing::DoAll;
+using ::testing::ElementsAre;
+using ::testing::HasSubstr;
+using ::testing::Invoke;
+using ::testing::Return;
+using ::testing::SetArgPointee;
+using ::testing::WithArg;
+
+class NikssNodeTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    nikss_interface_mock_ = absl::make_unique<NikssInterfaceMock>();
+    nikss_packetio_manager_mock_ =
+        absl::make_unique<NikssPacketioManagerMock>();
+    nikss_digest_manager_mock_ = absl::make_unique<NikssDigestManagerMock>();
+    nikss_pre_manager_ =
+        NikssPreManager::CreateInstance(nikss_interface_mock_.get());
+    nikss_node_ = NikssNode::CreateInstance(
+        nikss_interface_mock_.get(), nikss_packetio_manager_mock_.get(),
+        nikss_digest_manager_mock_.get(), nikss_pre_manager_.get(), kNodeId);
+    session_ = std::make_shared<SessionMock>();
+    standby_session_ = std::make_shared<SessionMock>();
+    ON_CALL(*nikss_interface_mock_, CreateSession(kNodeId))
+        .WillByDefault(Return(
+            ::util::StatusOr<std::shared_ptr<NikssInterface::SessionInterface>>(
+                session_)));
+    ON_CALL(*nikss_interface_mock_, CreateStandbySession(kNodeId))
+        .WillByDefault(Return(
+            ::util::StatusOr<std::shared_ptr<NikssInterface::SessionInterface>>(
+                standby_session_)));
+    ASSERT_OK(ParseProtoFromString(kP4Info, &p4info_));
+  }
+
+  // Pushes kP4Info as the forwarding pipeline of the node.
+  void PushForwardingPipelineConfig() {
+    ::p4::v1::ForwardingPipelineConfig config;
+    *config.mutable_p4info() = p4info_;
+    config.set_p4_device_config(kBpfObject);
+    EXPECT_CALL(*nikss_interface_mock_, AddPipeline(kNodeId, kBpfObject))
+        .WillOnce(Return(::util::OkStatus()));
+    EXPECT_CALL(*nikss_packetio_manager_mock_,
+                PushForwardingPipelineConfig(EqualsProto(p4info_)))
+        .WillOnce(Return(::util::OkStatus()));
+    EXPECT_CALL(*nikss_digest_manager_mock_,
+                PushForwardingPipelineConfig(EqualsProto(p4info_)))
+        .WillOnce(Return(::util::OkStatus()));
+    ASSERT_OK(nikss_node_->PushForwardingPipelineConfig(config));
+  }
+
+  // Writes the updates given in text format to the node.
+  ::util::Status WriteForwardingEntries(const std::string& req_str,
+                                        std::vector<::util::Status>* results) {
+    ::p4::v1::WriteRequest req;
+    RETURN_IF_ERROR(ParseProtoFromString(req_str, &req));
+    req.set_device_id(kNodeId);
+    return nikss_node_->WriteForwardingEntries(req, results);
+  }
+
+  // Reads the entities given in text format from the node.
+  ::util::Status ReadForwardingEntries(
+      const std::string& req_str,
+      WriterInterface<::p4::v1::ReadResponse>* writer,
+      std::vector<::util::Status>* details) {
+    ::p4::v1::ReadRequest req;
+    RETURN_IF_ERROR(ParseProtoFromString(req_str, &req));
+    req.set_device_id(kNodeId);
+    return nikss_node_->ReadForwardingEntries(req, writer, details);
+  }
+
+  static ::p4::v1::TableEntry ParseTableEntry(const std::string& entry_str) {
+    ::p4::v1::TableEntry entry;
+    CHECK_OK(ParseProtoFromString(entry_str, &entry));
+    return entry;
+  }
+
+  static constexpr uint64 kNodeId = 1;
+  static constexpr char kBpfObject[] = "\x7f" "ELF";
+  static constexpr char kNewBpfObject[] = "\x7f" "ELF2";
+  static constexpr char kP4Info[] = R"pb(
+    tables {
+      preamble {
+        id: 33554433
+        name: "ingress.fwd"
+        alias: "fwd"
+      }
+      match_fields {
+        id: 1
+        name: "std_meta.ingress_port"
+        bitwidth: 32
+        match_type: EXACT
+      }
+      action_refs { id: 16777217 }
+      action_refs { id: 16777218 }
+      direct_resource_ids: 318767105
+      direct_resource_ids: 352321537
+      size: 1024
+    }
+    tables {
+      preamble {
+        id: 33554434
+        name: "ingress.ecmp"
+        alias: "ecmp"
+      }
+      match_fields {
+        id: 1
+        name: "hdr.ipv4.dst_addr"
+        bitwidth: 32
+        match_type: EXACT
+      }
+      action_refs { id: 16777217 }
+      implementation_id: 285212673
+      size: 1024
+    }
+    actions {
+      preamble {
+        id: 16777217
+        name: "ingress.forward"
+        alias: "forward"
+      }
+      params {
+        id: 1
+        name: "port"
+        bitwidth: 32
+      }
+    }
+    actions {
+      preamble {
+        id: 16777218
+        name: "ingress.drop"
+        alias: "drop"
+      }
+    }
+    action_profiles {
+      preamble {
+        id: 285212673
+        name: "ingress.ecmp_selector"
+        alias: "ecmp_selector"
+      }
+      table_ids: 33554434
+      with_selector: true
+      size: 1024
+      max_group_size: 4
+    }
+    counters {
+      preamble {
+        id: 302055425
+        name: "ingress.port_counter"
+        alias: "port_counter"
+      }
+      spec { unit: BOTH }
+      size: 16
+    }
+    direct_counters {
+      preamble {
+        id: 318767105
+        name: "ingress.fwd_counter"
+        alias: "fwd_counter"
+      }
+      spec { unit: PACKETS }
+      direct_table_id: 33554433
+    }
+    meters {
+      preamble {
+        id: 335544321
+        name: "ingress.rate_limiter"
+        alias: "rate_limiter"
+      }
+      spec { unit: BYTES }
+      size: 8
+    }
+    direct_meters {
+      preamble {
+        id: 352321537
+        name: "ingress.fwd_meter"
+        alias: "fwd_meter"
+      }
+      spec { unit: BYTES }
+      direct_table_id: 33554433
+    }
+    registers {
+      preamble {
+        id: 369098753
+        name: "ingress.flow_state"
+        alias: "flow_state"
+      }
+      type_spec {
+        bitstring { bit { bitwidth: 32 } }
+      }
+      size: 16
+    }
+    value_sets {
+      preamble {
+        id: 50331649
+        name: "parser.tpids"
+        alias: "tpids"
+      }
+      match {
+        id: 1
+        name: "tpid"
+        bitwidth: 16
+        match_type: EXACT
+      }
+      size: 4
+    }
+  )pb";
+  static constexpr char kForwardEntry[] = R"pb(
+    table_id: 33554433
+    match {
+      field_id: 1
+      exact { value: "\001" }
+    }
+    action {
+      action {
+        action_id: 16777217
+        params {
+          param_id: 1
+          value: "\002"
+        }
+      }
+    }
+  )pb";
+
+  ::p4::config::v1::P4Info p4info_;
+  std::shared_ptr<NikssInterface::SessionInterface> session_;
+  std::shared_ptr<NikssInterface::SessionInterface> standby_session_;
+  std::unique_ptr<NikssInterfaceMock> nikss_interface_mock_;
+  std::unique_ptr<NikssPacketioManagerMock> nikss_packetio_manager_mock_;
+  std::unique_ptr<NikssDigestManagerMock> nikss_digest_manager_mock_;
+  std::unique_ptr<NikssPreManager> nikss_pre_manager_;
+  std::unique_ptr<NikssNode> nikss_node_;
+};
+
+constexpr uint64 NikssNodeTest::kNodeId;
+constexpr char NikssNodeTest::kBpfObject[];
+constexpr char NikssNodeTest::kNewBpfObject[];
+constexpr char NikssNodeTest::kP4Info[];
+constexpr char NikssNodeTest::kForwardEntry[];
+
+TEST_F(NikssNodeTest, WriteBeforePipelineConfigPush) {
+  std::vector<::util::Status> results;
+  EXPECT_THAT(WriteForwardingEntries("", &results),
+              StatusIs(StratumErrorSpace(), ERR_NOT_INITIALIZED,
+                       HasSubstr("Not initialized")));
+  EXPECT_TRUE(results.empty());
+}
+
+TEST_F(NikssNodeTest, WriteRejectsInvalidRequest) {
+  PushForwardingPipelineConfig();
+  std::vector<::util::Status> results;
+  ::p4::v1::WriteRequest req;
+  req.set_device_id(kNodeId + 1);
+  EXPECT_THAT(nikss_node_->WriteForwardingEntries(req, &results),
+              StatusIs(StratumErrorSpace(), ERR_INVALID_PARAM,
+                       HasSubstr("device id")));
+  req.set_device_id(kNodeId);
+  req.set_atomicity(::p4::v1::WriteRequest::DATAPLANE_ATOMIC);
+  EXPECT_THAT(nikss_node_->WriteForwardingEntries(req, &results),
+              StatusIs(StratumErrorSpace(), ERR_INVALID_PARAM,
+                       HasSubstr("DATAPLANE_ATOMIC")));
+  EXPECT_TRUE(results.empty());
+}
+
+TEST_F(NikssNodeTest, InsertModifyDeleteTableEntry) {
+  PushForwardingPipelineConfig();
+  const ::p4::v1::TableEntry entry = ParseTableEntry(kForwardEntry);
+  EXPECT_CALL(*nikss_interface_mock_, CreateSession(kNodeId)).Times(3);
+  EXPECT_CALL(*nikss_interface_mock_,
+              WriteTableEntry(session_, ::p4::v1::Update::INSERT,
+                              EqualsProto(p4info_.tables(0)),
+                              EqualsProto(p4info_.actions(0)),
+                              EqualsProto(entry)))
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_CALL(*nikss_interface_mock_,
+              WriteTableEntry(session_, ::p4::v1::Update::MODIFY,
+                              EqualsProto(p4info_.tables(0)),
+                              EqualsProto(p4info_.actions(0)),
+                              EqualsProto(entry)))
+      .WillOnce(Return(::util::OkStatus()));
+  // Deletes only need the key of the entry.
+  EXPECT_CALL(*nikss_interface_mock_,
+              WriteTableEntry(session_, ::p4::v1::Update::DELETE,
+                              EqualsProto(p4info_.tables(0)),
+                              EqualsProto(::p4::config::v1::Action()),
+                              EqualsProto(entry)))
+      .WillOnce(Return(::util::OkStatus()));
+
+  for (const std::string type : {"INSERT", "MODIFY", "DELETE"}) {
+    std::vector<::util::Status> results;
+    EXPECT_OK(WriteForwardingEntries(
+        absl::StrCat("updates { type: ", type, " entity { table_entry { ",
+                     entry.ShortDebugString(), " } } }"),
+        &results));
+    ASSERT_EQ(1U, results.size());
+    EXPECT_OK(results[0]);
+  }
+}
+
+TEST_F(NikssNodeTest, WriteErrorsAreReportedPerUpdate) {
+  PushForwardingPipelineConfig();
+  const ::p4::v1::TableEntry entry = ParseTableEntry(kForwardEntry);
+  EXPECT_CALL(*nikss_interface_mock_,
+              WriteTableEntry(session_, ::p4::v1::Update::INSERT, _, _,
+                              EqualsProto(entry)))
+      .WillOnce(Return(::util::OkStatus()))
+      .WillOnce(Return(MAKE_ERROR(ERR_ENTRY_EXISTS) << "Entry exists."));
+
+  // All updates are attempted even if one of them fails, and every failure
+  // keeps the error code of the backend.
+  const std::string update = absl::StrCat(
+      "updates { type: INSERT entity { table_entry { ",
+      entry.ShortDebugString(), " } } }");
+  std::vector<::util::Status> results;
+  EXPECT_THAT(
+      WriteForwardingEntries(
+          absl::StrCat(update, update,
+                       "updates { type: INSERT entity { extern_entry { "
+                       "extern_type_id: 1 } } }"
+                       "updates { type: INSERT entity { table_entry { "
+                       "table_id: 1 } } }"),
+          &results),
+      StatusIs(StratumErrorSpace(), ERR_AT_LEAST_ONE_OPER_FAILED,
+               HasSubstr("One or more write operations failed.")));
+  ASSERT_EQ(4U, results.size());
+  EXPECT_OK(results[0]);
+  EXPECT_EQ(ERR_ENTRY_EXISTS, results[1].error_code());
+  EXPECT_EQ(ERR_UNIMPLEMENTED, results[2].error_code());
+  EXPECT_FALSE(results[3].ok());
+}
+
+TEST_F(NikssNodeTest, WriteActionProfileMembersAndGroups) {
+  PushForwardingPipelineConfig();
+  const auto& action_profile = p4info_.action_profiles(0);
+  EXPECT_CALL(*nikss_interface_mock_,
+              InsertActionProfileMember(session_, EqualsProto(action_profile),
+                                        EqualsProto(p4info_.actions(0)), _))
+      .WillOnce(Return(7U));
+  EXPECT_CALL(*nikss_interface_mock_,
+              InsertActionProfileGroup(session_, EqualsProto(action_profile)))
+      .WillOnce(Return(3U));
+  EXPECT_CALL(*nikss_interface_mock_,
+              AddActionProfileGroupMember(session_, EqualsProto(action_profile),
+                                          3, 7))
+      .WillOnce(Return(::util::OkStatus()));
+  std::vector<::util::Status> results;
+  EXPECT_OK(WriteForwardingEntries(R"pb(
+    updates {
+      type: INSERT
+      entity {
+        action_profile_member {
+          action_profile_id: 285212673
+          member_id: 1
+          action {
+            action_id: 16777217
+            params {
+              param_id: 1
+              value: "\002"
+            }
+          }
+        }
+      }
+    }
+    updates {
+      type: INSERT
+      entity {
+        action_profile_group {
+          action_profile_id: 285212673
+          group_id: 10
+          members { member_id: 1 }
+        }
+      }
+    }
+  )pb", &results));
+
+  // Table entries refer to members and groups by their NIKSS references.
+  const char kEntry[] = R"pb(
+    table_id: 33554434
+    match {
+      field_id: 1
+      exact { value: "\n\000\000\001" }
+    }
+    action { action_profile_group_id: 10 }
+  )pb";
+  ::p4::v1::TableEntry nikss_entry = ParseTableEntry(kEntry);
+  nikss_entry.mutable_action()->set_action_profile_group_id(3);
+  EXPECT_CALL(*nikss_interface_mock_,
+              WriteTableEntry(session_, ::p4::v1::Update::INSERT,
+                              EqualsProto(p4info_.tables(1)), _,
+                              EqualsProto(nikss_entry)))
+      .WillOnce(Return(::util::OkStatus()));
+  results.clear();
+  EXPECT_OK(WriteForwardingEntries(
+      absl::StrCat("updates { type: INSERT entity { table_entry { ",
+                   ParseTableEntry(kEntry).ShortDebugString(), " } } }"),
+      &results));
+
+  // Members still used by a group and unknown members are rejected without
+  // calling NIKSS.
+  results.clear();
+  EXPECT_THAT(WriteForwardingEntries(R"pb(
+    updates {
+      type: DELETE
+      entity {
+        action_profile_member { action_profile_id: 285212673 member_id: 1 }
+      }
+    }
+    updates {
+      type: INSERT
+      entity {
+        action_profile_group {
+          action_profile_id: 285212673
+          group_id: 11
+          members { member_id: 2 }
+        }
+      }
+    }
+  )pb", &results),
+              StatusIs(StratumErrorSpace(), ERR_AT_LEAST_ONE_OPER_FAILED, _));
+  ASSERT_EQ(2U, results.size());
+  EXPECT_THAT(results[0], StatusIs(StratumErrorSpace(), ERR_INVALID_PARAM,
+                                   HasSubstr("still used by group 10")));
+  EXPECT_EQ(ERR_ENTRY_NOT_FOUND, results[1].error_code());
+
+  // Once the group is gone, the member can be deleted by its reference.
+  EXPECT_CALL(*nikss_interface_mock_,
+              DeleteActionProfileGroup(session_, EqualsProto(action_profile),
+                                       3))
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_CALL(*nikss_interface_mock_,
+              DeleteActionProfileMember(session_, EqualsProto(action_profile),
+                                        7))
+      .WillOnce(Return(::util::OkStatus()));
+  results.clear();
+  EXPECT_OK(WriteForwardingEntries(R"pb(
+    updates {
+      type: DELETE
+      entity {
+        action_profile_group { action_profile_id: 285212673 group_id: 10 }
+      }
+    }
+    updates {
+      type: DELETE
+      entity {
+        action_profile_member { action_profile_id: 285212673 member_id: 1 }
+      }
+    }
+  )pb", &results));
+}
+
+TEST_F(NikssNodeTest, ReadTableEntries) {
+  PushForwardingPipelineConfig();
+  const ::p4::v1::TableEntry entry = ParseTableEntry(kForwardEntry);
+  // A wildcard read walks all tables in a single session.
+  EXPECT_CALL(*nikss_interface_mock_, CreateSession(kNodeId)).Times(1);
+  EXPECT_CALL(*nikss_interface_mock_,
+              ReadTableEntries(session_, EqualsProto(p4info_.tables(0)),
+                               ElementsAre(EqualsProto(p4info_.actions(0)),
+                                           EqualsProto(p4info_.actions(1))),
+                               _, _))
+      .WillOnce(WithArg<4>(
+          Invoke([&entry](WriterInterface<::p4::v1::TableEntry>* writer) {
+            EXPECT_TRUE(writer->Write(entry));
+            EXPECT_TRUE(writer->Write(entry));
+            return ::util::OkStatus();
+          })));
+  EXPECT_CALL(*nikss_interface_mock_,
+              ReadTableEntries(session_, EqualsProto(p4info_.tables(1)), _, _,
+                               _))
+      .WillOnce(Return(::util::OkStatus()));
+
+  // The entries of all tables are streamed in one chunk.
+  ::p4::v1::ReadResponse expected;
+  *expected.add_entities()->mutable_table_entry() = entry;
+  *expected.add_entities()->mutable_table_entry() = entry;
+  WriterMock<::p4::v1::ReadResponse> writer_mock;
+  EXPECT_CALL(writer_mock, Write(EqualsProto(expected))).WillOnce(Return(true));
+  std::vector<::util::Status> details;
+  EXPECT_OK(ReadForwardingEntries("entities { table_entry { } }",
+                                  &writer_mock, &details));
+  ASSERT_EQ(1U, details.size());
+  EXPECT_OK(details[0]);
+}
+
+TEST_F(NikssNodeTest, ReadActionSelectorEntriesWithP4RuntimeIds) {
+  PushForwardingPipelineConfig();
+  EXPECT_CALL(*nikss_interface_mock_, InsertActionProfileMember(_, _, _, _))
+      .WillOnce(Return(7U));
+  EXPECT_CALL(*nikss_interface_mock_, InsertActionProfileGroup(_, _))
+      .WillOnce(Return(3U));
+  EXPECT_CALL(*nikss_interface_mock_, AddActionProfileGroupMember(_, _, 3, 7))
+      .WillOnce(Return(::util::OkStatus()));
+  std::vector<::util::Status> results;
+  ASSERT_OK(WriteForwardingEntries(R"pb(
+    updates {
+      type: INSERT
+      entity {
+        action_profile_member {
+          action_profile_id: 285212673
+          member_id: 1
+          action { action_id: 16777217 }
+        }
+      }
+    }
+    updates {
+      type: INSERT
+      entity {
+        action_profile_group {
+          action_profile_id: 285212673
+          group_id: 10
+          members { member_id: 1 }
+        }
+      }
+    }
+  )pb", &results));
+
+  // NIKSS returns its own references, unknown ones are skipped.
+  ::p4::v1::TableEntry nikss_entry;
+  nikss_entry.set_table_id(p4info_.tables(1).preamble().id());
+  nikss_entry.mutable_action()->set_action_profile_group_id(3);
+  EXPECT_CALL(*nikss_interface_mock_,
+              ReadTableEntries(session_, EqualsProto(p4info_.tables(1)), _, _,
+                               _))
+      .WillOnce(WithArg<4>(Invoke(
+          [&nikss_entry](WriterInterface<::p4::v1::TableEntry>* writer) {
+            EXPECT_TRUE(writer->Write(nikss_entry));
+            return ::util::OkStatus();
+          })));
+  EXPECT_CALL(*nikss_interface_mock_,
+              ReadActionProfileGroups(
+                  session_, EqualsProto(p4info_.action_profiles(0)), _))
+      .WillOnce(WithArg<2>(Invoke(
+          [](std::vector<std::pair<uint32, std::vector<uint32>>>* groups) {
+            groups->push_back({3, {7}});
+            groups->push_back({99, {}});
+            return ::util::OkStatus();
+          })));
+
+  const char kExpectedEntry[] = R"pb(
+    entities {
+      table_entry {
+        table_id: 33554434
+        action { action_profile_group_id: 10 }
+      }
+    }
+  )pb";
+  const char kExpectedGroup[] = R"pb(
+    entities {
+      action_profile_group {
+        action_profile_id: 285212673
+        group_id: 10
+        members { member_id: 1 weight: 1 }
+      }
+    }
+  )pb";
+  ::p4::v1::ReadResponse expected_entry, expected_group;
+  ASSERT_OK(ParseProtoFromString(kExpectedEntry, &expected_entry));
+  ASSERT_OK(ParseProtoFromString(kExpectedGroup, &expected_group));
+  WriterMock<::p4::v1::ReadResponse> writer_mock;
+  EXPECT_CALL(writer_mock, Write(EqualsProto(expected_entry)))
+      .WillOnce(Return(true));
+  EXPECT_CALL(writer_mock, Write(EqualsProto(expected_group)))
+      .WillOnce(Return(true));
+  std::vector<::util::Status> details;
+  EXPECT_OK(ReadForwardingEntries(R"pb(
+    entities { table_entry { table_id: 33554434 } }
+    entities { action_profile_group { action_profile_id: 285212673 } }
+  )pb", &writer_mock, &details));
+  ASSERT_EQ(2U, details.size());
+}
+
+TEST_F(NikssNodeTest, ReadErrorsAreReportedPerEntity) {
+  PushForwardingPipelineConfig();
+  EXPECT_CALL(*nikss_interface_mock_,
+              ReadTableEntries(session_, EqualsProto(p4info_.tables(0)), _, _,
+                               _))
+      .WillOnce(Return(MAKE_ERROR(ERR_INTERNAL) << "Map read failed."));
+  WriterMock<::p4::v1::ReadResponse> writer_mock;
+  EXPECT_CALL(writer_mock, Write(_)).Times(0);
+  std::vector<::util::Status> details;
+  EXPECT_THAT(ReadForwardingEntries(R"pb(
+    entities { table_entry { table_id: 33554433 } }
+    entities { extern_entry { extern_type_id: 1 } }
+  )pb", &writer_mock, &details),
+              StatusIs(StratumErrorSpace(), ERR_AT_LEAST_ONE_OPER_FAILED,
+                       HasSubstr("One or more read operations failed.")));
+  ASSERT_EQ(2U, details.size());
+  EXPECT_THAT(details[0], StatusIs(StratumErrorSpace(), ERR_INTERNAL,
+                                   HasSubstr("Map read failed.")));
+  EXPECT_EQ(ERR_UNIMPLEMENTED, details[1].error_code());
+}
+
+TEST_F(NikssNodeTest, ReadBeforePipelineConfigPush) {
+  WriterMock<::p4::v1::ReadResponse> writer_mock;
+  std::vector<::util::Status> details;
+  EXPECT_THAT(ReadForwardingEntries("entities { table_entry { } }",
+                                    &writer_mock, &details),
+              StatusIs(StratumErrorSpace(), ERR_NOT_INITIALIZED,
+                       HasSubstr("Not initialized")));
+}
+
+TEST_F(NikssNodeTest, CounterEntriesOnlySupportModify) {
+  PushForwardingPipelineConfig();
+  const char kCounterEntry[] = R"pb(
+    counter_id: 302055425
+    index { index: 3 }
+    data { byte_count: 100 packet_count: 5 }
+  )pb";
+  const char kDirectCounterEntry[] = R"pb(
+    table_entry {
+      table_id: 33554433
+      match {
+        field_id: 1
+        exact { value: "\001" }
+      }
+    }
+    data { packet_count: 9 }
+  )pb";
+  ::p4::v1::CounterEntry counter_entry;
+  ASSERT_OK(ParseProtoFromString(kCounterEntry, &counter_entry));
+  ::p4::v1::DirectCounterEntry direct_counter_entry;
+  ASSERT_OK(ParseProtoFromString(kDirectCounterEntry, &direct_counter_entry));
+  EXPECT_CALL(*nikss_interface_mock_,
+              WriteIndirectCounter(session_, EqualsProto(p4info_.counters(0)),
+                                   EqualsProto(counter_entry)))
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_CALL(*nikss_interface_mock_,
+              WriteDirectCounter(session_, EqualsProto(p4info_.tables(0)),
+                                 EqualsProto(p4info_.direct_counters(0)),
+                                 EqualsProto(direct_counter_entry)))
+      .WillOnce(Return(::util::OkStatus()));
+  std::vector<::util::Status> results;
+  EXPECT_OK(WriteForwardingEntries(
+      absl::StrCat("updates { type: MODIFY entity { counter_entry { ",
+                   kCounterEntry, " } } }",
+                   "updates { type: MODIFY entity { direct_counter_entry { ",
+                   kDirectCounterEntry, " } } }"),
+      &results));
+  ASSERT_EQ(2U, results.size());
+
+  // Counters cannot be inserted or deleted, unknown counters and tables
+  // without a direct counter are rejected, all without calling NIKSS.
+  results.clear();
+  EXPECT_THAT(
+      WriteForwardingEntries(
+          absl::StrCat(
+              "updates { type: INSERT entity { counter_entry { ",
+              kCounterEntry, " } } }",
+              "updates { type: DELETE entity { counter_entry { ",
+              kCounterEntry, " } } }",
+              "updates { type: INSERT entity { direct_counter_entry { ",
+              kDirectCounterEntry, " } } }",
+              "updates { type: DELETE entity { direct_counter_entry { ",
+              kDirectCounterEntry, " } } }",
+              "updates { type: MODIFY entity { counter_entry { ",
+              "counter_id: 1 index { index: 3 } } } }",
+              "updates { type: MODIFY entity { direct_counter_entry { ",
+              "table_entry { table_id: 33554434 } } } }"),
+          &results),
+      StatusIs(StratumErrorSpace(), ERR_AT_LEAST_ONE_OPER_FAILED, _));
+  ASSERT_EQ(6U, results.size());
+  EXPECT_THAT(results[0], StatusIs(StratumErrorSpace(), ERR_INVALID_PARAM,
+                                   HasSubstr("must be MODIFY")));
+  EXPECT_THAT(results[1], StatusIs(StratumErrorSpace(), ERR_INVALID_PARAM,
+                                   HasSubstr("must be MODIFY")));
+  EXPECT_THAT(results[2], StatusIs(StratumErrorSpace(), ERR_INVALID_PARAM,
+                                   HasSubstr("must be MODIFY")));
+  EXPECT_THAT(results[3], StatusIs(StratumErrorSpace(), ERR_INVALID_PARAM,
+                                   HasSubstr("must be MODIFY")));
+  EXPECT_FALSE(results[4].ok());
+  EXPECT_THAT(results[5], StatusIs(StratumErrorSpace(), ERR_INVALID_PARAM,
+                                   HasSubstr("has no direct counter")));
+}
+
+TEST_F(NikssNodeTest, ReadCounterEntries) {
+  PushForwardingPipelineConfig();
+  ::p4::v1::CounterEntry cell;
+  ASSERT_OK(ParseProtoFromString(R"pb(
+    counter_id: 302055425
+    index { index: 3 }
+    data { byte_count: 100 packet_count: 5 }
+  )pb", &cell));
+  // A wildcard read reads all cells of all counters, an indexed read only
+  // the requested cell.
+  EXPECT_CALL(*nikss_interface_mock_,
+              ReadIndirectCounter(session_, EqualsProto(p4info_.counters(0)),
+                                  EqualsProto(::p4::v1::CounterEntry()), _))
+      .WillOnce(WithArg<3>(
+          Invoke([&cell](WriterInterface<::p4::v1::CounterEntry>* writer) {
+            EXPECT_TRUE(writer->Write(cell));
+            return ::util::OkStatus();
+          })));
+  ::p4::v1::CounterEntry indexed;
+  indexed.set_counter_id(302055425);
+  indexed.mutable_index()->set_index(3);
+  EXPECT_CALL(*nikss_interface_mock_,
+              ReadIndirectCounter(session_, EqualsProto(p4info_.counters(0)),
+                                  EqualsProto(indexed), _))
+      .WillOnce(WithArg<3>(
+          Invoke([&cell](WriterInterface<::p4::v1::CounterEntry>* writer) {
+            EXPECT_TRUE(writer->Write(cell));
+            return ::util::OkStatus();
+          })));
+
+  ::p4::v1::ReadResponse expected;
+  *expected.add_entities()->mutable_counter_entry() = cell;
+  WriterMock<::p4::v1::ReadResponse> writer_mock;
+  EXPECT_CALL(writer_mock, Write(EqualsProto(expected)))
+      .Times(2)
+      .WillRepeatedly(Return(true));
+  std::vector<::util::Status> details;
+  EXPECT_OK(ReadForwardingEntries(
+      absl::StrCat("entities { counter_entry { } }",
+                   "entities { counter_entry { ", indexed.ShortDebugString(),
+                   " } }"),
+      &writer_mock, &details));
+  ASSERT_EQ(2U, details.size());
+
+  // An index requires a counter.
+  details.clear();
+  EXPECT_THAT(ReadForwardingEntries(
+                  "entities { counter_entry { index { index: 3 } } }",
+                  &writer_mock, &details),
+              StatusIs(StratumErrorSpace(), ERR_AT_LEAST_ONE_OPER_FAILED, _));
+  ASSERT_EQ(1U, details.size());
+  EXPECT_THAT(details[0], StatusIs(StratumErrorSpace(), ERR_INVALID_PARAM,
+                                   HasSubstr("requires a counter ID")));
+}
+
+TEST_F(NikssNodeTest, ReadDirectCounterEntries) {
+  PushForwardingPipelineConfig();
+  ::p4::v1::DirectCounterEntry direct_counter;
+  ASSERT_OK(ParseProtoFromString(R"pb(
+    table_entry {
+      table_id: 33554433
+      match {
+        field_id: 1
+        exact { value: "\001" }
+      }
+    }
+    data { packet_count: 9 }
+  )pb", &direct_counter));
+  // A wildcard read walks the direct counters of all tables, a read of an
+  // entry only reads its counter.
+  ::p4::v1::DirectCounterEntry entry_read;
+  *entry_read.mutable_table_entry() = direct_counter.table_entry();
+  auto write_direct_counter =
+      [&direct_counter](WriterInterface<::p4::v1::DirectCounterEntry>* writer) {
+        EXPECT_TRUE(writer->Write(direct_counter));
+        return ::util::OkStatus();
+      };
+  EXPECT_CALL(*nikss_interface_mock_,
+              ReadDirectCounter(session_, EqualsProto(p4info_.tables(0)),
+                                EqualsProto(p4info_.direct_counters(0)),
+                                EqualsProto(::p4::v1::DirectCounterEntry()), _))
+      .WillOnce(WithArg<4>(Invoke(write_direct_counter)));
+  EXPECT_CALL(*nikss_interface_mock_,
+              ReadDirectCounter(session_, EqualsProto(p4info_.tables(0)),
+                                EqualsProto(p4info_.direct_counters(0)),
+                                EqualsProto(entry_read), _))
+      .WillOnce(WithArg<4>(Invoke(write_direct_counter)));
+
+  ::p4::v1::ReadResponse expected;
+  *expected.add_entities()->mutable_direct_counter_entry() = direct_counter;
+  WriterMock<::p4::v1::ReadResponse> writer_mock;
+  EXPECT_CALL(writer_mock, Write(EqualsProto(expected)))
+      .Times(2)
+      .WillRepeatedly(Return(true));
+  std::vector<::util::Status> details;
+  EXPECT_OK(ReadForwardingEntries(
+      absl::StrCat("entities { direct_counter_entry { } }",
+                   "entities { direct_counter_entry { ",
+                   entry_read.ShortDebugString(), " } }"),
+      &writer_mock, &details));
+  ASSERT_EQ(2U, details.size());
+
+  // Match fields require a table, the ECMP table has no direct counter.
+  details.clear();
+  EXPECT_THAT(ReadForwardingEntries(R"pb(
+    entities {
+      direct_counter_entry {
+        table_entry {
+          match {
+            field_id: 1
+            exact { value: "\001" }
+          }
+        }
+      }
+    }
+    entities { direct_counter_entry { table_entry { table_id: 33554434 } } }
+  )pb", &writer_mock, &details),
+              StatusIs(StratumErrorSpace(), ERR_AT_LEAST_ONE_OPER_FAILED, _));
+  ASSERT_EQ(2U, details.size());
+  EXPECT_THAT(details[0], StatusIs(StratumErrorSpace(), ERR_INVALID_PARAM,
+                                   HasSubstr("require a table ID")));
+  EXPECT_THAT(details[1], StatusIs(StratumErrorSpace(), ERR_INVALID_PARAM,
+                                   HasSubstr("has no direct counter")));
+}
+
+TEST_F(NikssNodeTest, ReadCounterEntriesInChunks) {
+  PushForwardingPipelineConfig();
+  ::p4::v1::CounterEntry cell;
+  ASSERT_OK(ParseProtoFromString(R"pb(
+    counter_id: 302055425
+    index { index: 1 }
+    data { byte_count: 100 packet_count: 5 }
+  )pb", &cell));
+  // Every chunk holds two cells.
+  ::p4::v1::ReadResponse one_cell;
+  *one_cell.add_entities()->mutable_counter_entry() = cell;
+  ::gflags::FlagSaver flag_saver;
+  FLAGS_nikss_read_chunk_size_bytes = 2 * one_cell.ByteSizeLong();
+  EXPECT_CALL(*nikss_interface_mock_,
+              ReadIndirectCounter(session_, EqualsProto(p4info_.counters(0)),
+                                  _, _))
+      .WillOnce(WithArg<3>(
+          Invoke([cell](WriterInterface<::p4::v1::CounterEntry>* writer) {
+            ::p4::v1::CounterEntry next = cell;
+            for (int i = 1; i <= 3; ++i) {
+              next.mutable_index()->set_index(i);
+              EXPECT_TRUE(writer->Write(next));
+            }
+            return ::util::OkStatus();
+          })));
+
+  ::p4::v1::ReadResponse first_chunk;
+  ::p4::v1::ReadResponse second_chunk;
+  for (int i = 1; i <= 3; ++i) {
+    auto* entity = (i <= 2 ? first_chunk : second_chunk).add_entities();
+    *entity->mutable_counter_entry() = cell;
+    entity->mutable_counter_entry()->mutable_index()->set_index(i);
+  }
+  WriterMock<::p4::v1::ReadResponse> writer_mock;
+  ::testing::InSequence sequence;
+  EXPECT_CALL(writer_mock, Write(EqualsProto(first_chunk)))
+      .WillOnce(Return(true));
+  EXPECT_CALL(writer_mock, Write(EqualsProto(second_chunk)))
+      .WillOnce(Return(true));
+  std::vector<::util::Status> details;
+  EXPECT_OK(ReadForwardingEntries(
+      "entities { counter_entry { counter_id: 302055425 } }", &writer_mock,
+      &details));
+}
+
+TEST_F(NikssNodeTest, WriteMeterEntries) {
+  PushForwardingPipelineConfig();
+  const char kMeterEntry[] = R"pb(
+    meter_id: 335544321
+    index { index: 7 }
+    config { cir: 1000 cburst: 100 pir: 2000 pburst: 200 }
+  )pb";
+  const char kDirectMeterEntry[] = R"pb(
+    table_entry {
+      table_id: 33554433
+      match {
+        field_id: 1
+        exact { value: "\001" }
+      }
+    }
+    config { cir: 1000 cburst: 100 pir: 2000 pburst: 200 }
+  )pb";
+  ::p4::v1::MeterEntry meter_entry;
+  ASSERT_OK(ParseProtoFromString(kMeterEntry, &meter_entry));
+  ::p4::v1::DirectMeterEntry direct_meter_entry;
+  ASSERT_OK(ParseProtoFromString(kDirectMeterEntry, &direct_meter_entry));
+  EXPECT_CALL(*nikss_interface_mock_,
+              WriteMeter(session_, EqualsProto(p4info_.meters(0)),
+                         EqualsProto(meter_entry)))
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_CALL(*nikss_interface_mock_,
+              WriteDirectMeter(session_, EqualsProto(p4info_.tables(0)),
+                               EqualsProto(p4info_.direct_meters(0)),
+                               EqualsProto(direct_meter_entry)))
+      .WillOnce(Return(::util::OkStatus()));
+  std::vector<::util::Status> results;
+  EXPECT_OK(WriteForwardingEntries(
+      absl::StrCat("updates { type: MODIFY entity { meter_entry { ",
+                   kMeterEntry, " } } }",
+                   "updates { type: MODIFY entity { direct_meter_entry { ",
+                   kDirectMeterEntry, " } } }"),
+      &results));
+  ASSERT_EQ(2U, results.size());
+
+  // Meters cannot be inserted, unknown meters, cells beyond the end of the
+  // meter and tables without a direct meter are rejected, all without
+  // calling NIKSS.
+  results.clear();
+  EXPECT_THAT(
+      WriteForwardingEntries(
+          absl::StrCat(
+              "updates { type: INSERT entity { meter_entry { ", kMeterEntry,
+              " } } }",
+              "updates { type: DELETE entity { direct_meter_entry { ",
+              kDirectMeterEntry, " } } }",
+              "updates { type: MODIFY entity { meter_entry { ",
+              "meter_id: 1 index { index: 7 } } } }",
+              "updates { type: MODIFY entity { meter_entry { ",
+              "meter_id: 335544321 index { index: 8 } } } }",
+              "updates { type: MODIFY entity { direct_meter_entry { ",
+              "table_entry { table_id: 33554434 } } } }"),
+          &results),
+      StatusIs(StratumErrorSpace(), ERR_AT_LEAST_ONE_OPER_FAILED, _));
+  ASSERT_EQ(5U, results.size());
+  EXPECT_THAT(results[0], StatusIs(StratumErrorSpace(), ERR_INVALID_PARAM,
+                                   HasSubstr("must be MODIFY")));
+  EXPECT_THAT(results[1], StatusIs(StratumErrorSpace(), ERR_INVALID_PARAM,
+                                   HasSubstr("must be MODIFY")));
+  EXPECT_FALSE(results[2].ok());
+  EXPECT_THAT(results[3], StatusIs(StratumErrorSpace(), ERR_INVALID_PARAM,
+                                   HasSubstr("out of range")));
+  EXPECT_THAT(results[4], StatusIs(StratumErrorSpace(), ERR_INVALID_PARAM,
+                                   HasSubstr("has no direct meter")));
+}
+
+TEST_F(NikssNodeTest, ReadMeterEntries) {
+  PushForwardingPipelineConfig();
+  ::p4::v1::MeterEntry cell;
+  ASSERT_OK(ParseProtoFromString(R"pb(
+    meter_id: 335544321
+    index { index: 7 }
+    config { cir: 1000 cburst: 100 pir: 2000 pburst: 200 }
+  )pb", &cell));
+  ::p4::v1::DirectMeterEntry direct_meter;
+  ASSERT_OK(ParseProtoFromString(R"pb(
+    table_entry {
+      table_id: 33554433
+      match {
+        field_id: 1
+        exact { value: "\001" }
+      }
+    }
+    config { cir: 1000 cburst: 100 pir: 2000 pburst: 200 }
+  )pb", &direct_meter));
+  // Wildcard reads read all meters, an indexed read only the requested cell
+  // and a read of an entry only its direct meter.
+  auto write_cell = [&cell](WriterInterface<::p4::v1::MeterEntry>* writer) {
+    EXPECT_TRUE(writer->Write(cell));
+    return ::util::OkStatus();
+  };
+  EXPECT_CALL(*nikss_interface_mock_,
+              ReadMeter(session_, EqualsProto(p4info_.meters(0)),
+                        EqualsProto(::p4::v1::MeterEntry()), _))
+      .WillOnce(WithArg<3>(Invoke(write_cell)));
+  ::p4::v1::MeterEntry indexed;
+  indexed.set_meter_id(335544321);
+  indexed.mutable_index()->set_index(7);
+  EXPECT_CALL(*nikss_interface_mock_,
+              ReadMeter(session_, EqualsProto(p4info_.meters(0)),
+                        EqualsProto(indexed), _))
+      .WillOnce(WithArg<3>(Invoke(write_cell)));
+  auto write_direct_meter =
+      [&direct_meter](WriterInterface<::p4::v1::DirectMeterEntry>* writer) {
+        EXPECT_TRUE(writer->Write(direct_meter));
+        return ::util::OkStatus();
+      };
+  EXPECT_CALL(*nikss_interface_mock_,
+              ReadDirectMeter(session_, EqualsProto(p4info_.tables(0)),
+                              EqualsProto(p4info_.direct_meters(0)),
+                              EqualsProto(::p4::v1::DirectMeterEntry()), _))
+      .WillOnce(WithArg<4>(Invoke(write_direct_meter)));
+  ::p4::v1::DirectMeterEntry entry_read;
+  *entry_read.mutable_table_entry() = direct_meter.table_entry();
+  EXPECT_CALL(*nikss_interface_mock_,
+              ReadDirectMeter(session_, EqualsProto(p4info_.tables(0)),
+                              EqualsProto(p4info_.direct_meters(0)),
+                              EqualsProto(entry_read), _))
+      .WillOnce(WithArg<4>(Invoke(write_direct_meter)));
+
+  ::p4::v1::ReadResponse expected_cell;
+  *expected_cell.add_entities()->mutable_meter_entry() = cell;
+  ::p4::v1::ReadResponse expected_direct_meter;
+  *expected_direct_meter.add_entities()->mutable_direct_meter_entry() =
+      direct_meter;
+  WriterMock<::p4::v1::ReadResponse> writer_mock;
+  EXPECT_CALL(writer_mock, Write(EqualsProto(expected_cell)))
+      .Times(2)
+      .WillRepeatedly(Return(true));
+  EXPECT_CALL(writer_mock, Write(EqualsProto(expected_direct_meter)))
+      .Times(2)
+      .WillRepeatedly(Return(true));
+  std::vector<::util::Status> details;
+  EXPECT_OK(ReadForwardingEntries(
+      absl::StrCat("entities { meter_entry { } }",
+                   "entities { meter_entry { ", indexed.ShortDebugString(),
+                   " } }",
+                   "entities { direct_meter_entry { } }",
+                   "entities { direct_meter_entry { ",
+                   entry_read.ShortDebugString(), " } }"),
+      &writer_mock, &details));
+  ASSERT_EQ(4U, details.size());
+
+  // An index requires a meter and must be within the meter, the ECMP table
+  // has no direct meter.
+  details.clear();
+  EXPECT_THAT(
+      ReadForwardingEntries(
+          "entities { meter_entry { index { index: 7 } } }"
+          "entities { meter_entry { meter_id: 335544321 index { index: 8 } } }"
+          "entities { direct_meter_entry { table_entry { table_id: 33554434 "
+          "} } }",
+          &writer_mock, &details),
+      StatusIs(StratumErrorSpace(), ERR_AT_LEAST_ONE_OPER_FAILED, _));
+  ASSERT_EQ(3U, details.size());
+  EXPECT_THAT(details[0], StatusIs(StratumErrorSpace(), ERR_INVALID_PARAM,
+                                   HasSubstr("requires a meter ID")));
+  EXPECT_THAT(details[1], StatusIs(StratumErrorSpace(), ERR_INVALID_PARAM,
+                                   HasSubstr("out of range")));
+  EXPECT_THAT(details[2], StatusIs(StratumErrorSpace(), ERR_INVALID_PARAM,
+                                   HasSubstr("has no direct meter")));
+}
+
+TEST_F(NikssNodeTest, WriteAndReadRegisterEntries) {
+  PushForwardingPipelineConfig();
+  ::p4::v1::RegisterEntry cell;
+  ASSERT_OK(ParseProtoFromString(R"pb(
+    register_id: 369098753
+    index { index: 15 }
+    data { bitstring: "\x12\x34" }
+  )pb", &cell));
+  EXPECT_CALL(*nikss_interface_mock_,
+              WriteRegister(session_, EqualsProto(p4info_.registers(0)),
+                            EqualsProto(cell)))
+      .WillOnce(Return(::util::OkStatus()));
+  std::vector<::util::Status> results;
+  EXPECT_OK(WriteForwardingEntries(
+      absl::StrCat("updates { type: MODIFY entity { register_entry { ",
+                   cell.ShortDebugString(), " } } }"),
+      &results));
+  ASSERT_EQ(1U, results.size());
+
+  // Registers cannot be deleted, unknown registers and cells beyond the end
+  // of the register are rejected.
+  results.clear();
+  EXPECT_THAT(
+      WriteForwardingEntries(
+          absl::StrCat(
+              "updates { type: DELETE entity { register_entry { ",
+              cell.ShortDebugString(), " } } }",
+              "updates { type: MODIFY entity { register_entry { ",
+              "register_id: 1 index { index: 15 } } } }",
+              "updates { type: MODIFY entity { register_entry { ",
+              "register_id: 369098753 index { index: 16 } } } }"),
+          &results),
+      StatusIs(StratumErrorSpace(), ERR_AT_LEAST_ONE_OPER_FAILED, _));
+  ASSERT_EQ(3U, results.size());
+  EXPECT_THAT(results[0], StatusIs(StratumErrorSpace(), ERR_INVALID_PARAM,
+                                   HasSubstr("must be MODIFY")));
+  EXPECT_FALSE(results[1].ok());
+  EXPECT_THAT(results[2], StatusIs(StratumErrorSpace(), ERR_INVALID_PARAM,
+                                   HasSubstr("out of range")));
+
+  // A wildcard read reads all registers, an indexed read only the cell.
+  auto write_cell = [&cell](WriterInterface<::p4::v1::RegisterEntry>* writer) {
+    EXPECT_TRUE(writer->Write(cell));
+    return ::util::OkStatus();
+  };
+  EXPECT_CALL(*nikss_interface_mock_,
+              ReadRegister(session_, EqualsProto(p4info_.registers(0)),
+                           EqualsProto(::p4::v1::RegisterEntry()), _))
+      .WillOnce(WithArg<3>(Invoke(write_cell)));
+  ::p4::v1::RegisterEntry indexed;
+  indexed.set_register_id(369098753);
+  indexed.mutable_index()->set_index(15);
+  EXPECT_CALL(*nikss_interface_mock_,
+              ReadRegister(session_, EqualsProto(p4info_.registers(0)),
+                           EqualsProto(indexed), _))
+      .WillOnce(WithArg<3>(Invoke(write_cell)));
+  ::p4::v1::ReadResponse expected;
+  *expected.add_entities()->mutable_register_entry() = cell;
+  WriterMock<::p4::v1::ReadResponse> writer_mock;
+  EXPECT_CALL(writer_mock, Write(EqualsProto(expected)))
+      .Times(2)
+      .WillRepeatedly(Return(true));
+  std::vector<::util::Status> details;
+  EXPECT_OK(ReadForwardingEntries(
+      absl::StrCat("entities { register_entry { } }",
+                   "entities { register_entry { ", indexed.ShortDebugString(),
+                   " } }"),
+      &writer_mock, &details));
+  ASSERT_EQ(2U, details.size());
+
+  // An index requires a register and must be within the register.
+  details.clear();
+  EXPECT_THAT(ReadForwardingEntries(
+                  "entities { register_entry { index { index: 15 } } }"
+                  "entities { register_entry { register_id: 369098753 "
+                  "index { index: 16 } } }",
+                  &writer_mock, &details),
+              StatusIs(StratumErrorSpace(), ERR_AT_LEAST_ONE_OPER_FAILED, _));
+  ASSERT_EQ(2U, details.size());
+  EXPECT_THAT(details[0], StatusIs(StratumErrorSpace(), ERR_INVALID_PARAM,
+                                   HasSubstr("requires a register ID")));
+  EXPECT_THAT(details[1], StatusIs(StratumErrorSpace(), ERR_INVALID_PARAM,
+                                   HasSubstr("out of range")));
+}
+
+TEST_F(NikssNodeTest, WriteAndReadValueSetEntries) {
+  PushForwardingPipelineConfig();
+  ::p4::v1::ValueSetEntry value_set_entry;
+  ASSERT_OK(ParseProtoFromString(R"pb(
+    value_set_id: 50331649
+    members {
+      match {
+        field_id: 1
+        exact { value: "\x81\x00" }
+      }
+    }
+    members {
+      match {
+        field_id: 1
+        exact { value: "\x88\xa8" }
+      }
+    }
+  )pb", &value_set_entry));
+  // A write replaces all members of the value set.
+  EXPECT_CALL(*nikss_interface_mock_,
+              WriteValueSet(session_, EqualsProto(p4info_.value_sets(0)),
+                            EqualsProto(value_set_entry)))
+      .WillOnce(Return(::util::OkStatus()));
+  std::vector<::util::Status> results;
+  EXPECT_OK(WriteForwardingEntries(
+      absl::StrCat("updates { type: MODIFY entity { value_set_entry { ",
+                   value_set_entry.ShortDebugString(), " } } }"),
+      &results));
+  ASSERT_EQ(1U, results.size());
+
+  // Value sets cannot be inserted, unknown value sets are rejected.
+  results.clear();
+  EXPECT_THAT(
+      WriteForwardingEntries(
+          absl::StrCat(
+              "updates { type: INSERT entity { value_set_entry { ",
+              value_set_entry.ShortDebugString(), " } } }",
+              "updates { type: MODIFY entity { value_set_entry { ",
+              "value_set_id: 1 } } }"),
+          &results),
+      StatusIs(StratumErrorSpace(), ERR_AT_LEAST_ONE_OPER_FAILED, _));
+  ASSERT_EQ(2U, results.size());
+  EXPECT_THAT(results[0], StatusIs(StratumErrorSpace(), ERR_INVALID_PARAM,
+                                   HasSubstr("must be MODIFY")));
+  EXPECT_FALSE(results[1].ok());
+
+  // Wildcard and single reads return the whole value set.
+  EXPECT_CALL(*nikss_interface_mock_,
+              ReadValueSet(session_, EqualsProto(p4info_.value_sets(0)), _))
+      .Times(2)
+      .WillRepeatedly(DoAll(SetArgPointee<2>(value_set_entry),
+                            Return(::util::OkStatus())));
+  ::p4::v1::ReadResponse expected;
+  *expected.add_entities()->mutable_value_set_entry() = value_set_entry;
+  WriterMock<::p4::v1::ReadResponse> writer_mock;
+  EXPECT_CALL(writer_mock, Write(EqualsProto(expected)))
+      .Times(2)
+      .WillRepeatedly(Return(true));
+  std::vector<::util::Status> details;
+  EXPECT_OK(ReadForwardingEntries(
+      "entities { value_set_entry { } }"
+      "entities { value_set_entry { value_set_id: 50331649 } }",
+      &writer_mock, &details));
+  ASSERT_EQ(2U, details.size());
+
+  // Unknown value sets and NIKSS errors are reported per entity.
+  EXPECT_CALL(*nikss_interface_mock_,
+              ReadValueSet(session_, EqualsProto(p4info_.value_sets(0)), _))
+      .WillOnce(Return(MAKE_ERROR(ERR_INTERNAL) << "Map lookup failed."));
+  details.clear();
+  EXPECT_THAT(ReadForwardingEntries(
+                  "entities { value_set_entry { value_set_id: 1 } }"
+                  "entities { value_set_entry { value_set_id: 50331649 } }",
+                  &writer_mock, &details),
+              StatusIs(StratumErrorSpace(), ERR_AT_LEAST_ONE_OPER_FAILED, _));
+  ASSERT_EQ(2U, details.size());
+  EXPECT_FALSE(details[0].ok());
+  EXPECT_THAT(details[1], StatusIs(StratumErrorSpace(), ERR_INTERNAL,
+                                   HasSubstr("Map lookup failed")));
+}
+
+TEST_F(NikssNodeTest, DumpPacketIoStats) {
+  NikssPacketioManager::PacketIoStats stats;
+  stats.rx_packets = 10;
+  stats.rx_ring_drops = 1;
+  stats.rx_queue_drops = 2;
+  stats.rx_no_writer_drops = 3;
+  stats.rx_errors = 4;
+  stats.tx_packets = 20;
+  stats.tx_errors = 5;
+  EXPECT_CALL(*nikss_packetio_manager_mock_, GetStats())
+      .WillOnce(Return(stats));
+
+  EXPECT_EQ(
+      "CPU port : 10 packets received, 1 dropped (RX ring full), 2 dropped "
+      "(PacketIn queue full), 3 dropped (no controller), 4 errors; 20 packets "
+      "transmitted, 5 errors\n",
+      nikss_node_->DumpPacketIoStats());
+}
+
+TEST_F(NikssNodeTest, PushReplacesRunningPipelineWithItsState) {
+  PushForwardingPipelineConfig();
+
+  // The new P4Info renumbers the forwarding table, its match field, the
+  // forward action and its parameter and the match field of the value set,
+  // and shrinks the register.
+  ::p4::config::v1::P4Info new_p4info = p4info_;
+  auto* new_table = new_p4info.mutable_tables(0);
+  new_table->mutable_preamble()->set_id(33554435);
+  new_table->mutable_match_fields(0)->set_id(2);
+  new_table->mutable_action_refs(0)->set_id(16777219);
+  new_p4info.mutable_tables(1)->mutable_action_refs(0)->set_id(16777219);
+  auto* new_action = new_p4info.mutable_actions(0);
+  new_action->mutable_preamble()->set_id(16777219);
+  new_action->mutable_params(0)->set_id(2);
+  new_p4info.mutable_direct_counters(0)->set_direct_table_id(33554435);
+  new_p4info.mutable_direct_meters(0)->set_direct_table_id(33554435);
+  new_p4info.mutable_registers(0)->set_size(8);
+  new_p4info.mutable_value_sets(0)->mutable_match(0)->set_id(2);
+
+  // Snapshot of the running pipeline.
+  const ::p4::v1::TableEntry entry = ParseTableEntry(kForwardEntry);
+  EXPECT_CALL(*nikss_interface_mock_,
+              ReadTableEntries(session_, EqualsProto(p4info_.tables(0)), _, _,
+                               _))
+      .WillOnce(WithArg<4>(
+          Invoke([&entry](WriterInterface<::p4::v1::TableEntry>* writer) {
+            EXPECT_TRUE(writer->Write(entry));
+            return ::util::OkStatus();
+          })))
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_CALL(*nikss_interface_mock_,
+              ReadIndirectCounter(session_, EqualsProto(p4info_.counters(0)),
+                                  _, _))
+      .WillOnce(WithArg<3>(
+          Invoke([](WriterInterface<::p4::v1::CounterEntry>* writer) {
+            ::p4::v1::CounterEntry cell;
+            cell.set_counter_id(302055425);
+            cell.mutable_index()->set_index(0);
+            cell.mutable_data();
+            EXPECT_TRUE(writer->Write(cell));
+            cell.mutable_index()->set_index(3);
+            cell.mutable_data()->set_byte_count(100);
+            cell.mutable_data()->set_packet_count(5);
+            EXPECT_TRUE(writer->Write(cell));
+            return ::util::OkStatus();
+          })));
+  EXPECT_CALL(*nikss_interface_mock_,
+              ReadMeter(session_, EqualsProto(p4info_.meters(0)), _, _))
+      .WillOnce(WithArg<3>(
+          Invoke([](WriterInterface<::p4::v1::MeterEntry>* writer) {
+            ::p4::v1::MeterEntry cell;
+            cell.set_meter_id(335544321);
+            cell.mutable_index()->set_index(1);
+            cell.mutable_config()->set_cir(1000);
+            cell.mutable_config()->set_cburst(100);
+            cell.mutable_config()->set_pir(2000);
+            cell.mutable_config()->set_pburst(200);
+            EXPECT_TRUE(writer->Write(cell));
+            cell.mutable_index()->set_index(2);
+            cell.clear_config();
+            EXPECT_TRUE(writer->Write(cell));
+            return ::util::OkStatus();
+          })));
+  EXPECT_CALL(*nikss_interface_mock_,
+              ReadRegister(session_, EqualsProto(p4info_.registers(0)), _, _))
+      .WillOnce(WithArg<3>(
+          Invoke([](WriterInterface<::p4::v1::RegisterEntry>* writer) {
+            ::p4::v1::RegisterEntry cell;
+            cell.set_register_id(369098753);
+            cell.mutable_index()->set_index(2);
+            cell.mutable_data()->set_bitstring("\x07");
+            EXPECT_TRUE(writer->Write(cell));
+            cell.mutable_index()->set_index(4);
+            cell.mutable_data()->set_bitstring(std::string(4, '\0'));
+            EXPECT_TRUE(writer->Write(cell));
+            cell.mutable_index()->set_index(12);
+            cell.mutable_data()->set_bitstring("\x01");
+            EXPECT_TRUE(writer->Write(cell));
+            return ::util::OkStatus();
+          })));
+  EXPECT_CALL(*nikss_interface_mock_,
+              ReadValueSet(session_, EqualsProto(p4info_.value_sets(0)), _))
+      .WillOnce(WithArg<2>(Invoke([](::p4::v1::ValueSetEntry* value_set) {
+        CHECK_OK(ParseProtoFromString(R"pb(
+          value_set_id: 50331649
+          members {
+            match {
+              field_id: 1
+              exact { value: "\x81\x00" }
+            }
+          }
+        )pb", value_set));
+        return ::util::OkStatus();
+      })));
+  EXPECT_CALL(*nikss_interface_mock_,
+              ReadDirectCounter(session_, EqualsProto(p4info_.tables(0)),
+                                EqualsProto(p4info_.direct_counters(0)), _, _))
+      .WillOnce(WithArg<4>(
+          Invoke([](WriterInterface<::p4::v1::DirectCounterEntry>* writer) {
+            ::p4::v1::DirectCounterEntry counter;
+            *counter.mutable_table_entry() = ParseTableEntry(R"pb(
+              table_id: 33554433
+              match {
+                field_id: 1
+                exact { value: "\001" }
+              }
+            )pb");
+            counter.mutable_data()->set_packet_count(9);
+            EXPECT_TRUE(writer->Write(counter));
+            return ::util::OkStatus();
+          })));
+  // The meter of an entry which is not in the snapshot is dropped.
+  EXPECT_CALL(*nikss_interface_mock_,
+              ReadDirectMeter(session_, EqualsProto(p4info_.tables(0)),
+                              EqualsProto(p4info_.direct_meters(0)), _, _))
+      .WillOnce(WithArg<4>(
+          Invoke([](WriterInterface<::p4::v1::DirectMeterEntry>* writer) {
+            ::p4::v1::DirectMeterEntry meter;
+            *meter.mutable_table_entry() = ParseTableEntry(R"pb(
+              table_id: 33554433
+              match {
+                field_id: 1
+                exact { value: "\005" }
+              }
+            )pb");
+            meter.mutable_config()->set_cir(1000);
+            EXPECT_TRUE(writer->Write(meter));
+            return ::util::OkStatus();
+          })));
+
+  // The standby pipeline is populated with the translated state before it
+  // takes over. The running pipeline is never reloaded.
+  ::testing::InSequence sequence;
+  EXPECT_CALL(*nikss_interface_mock_, AddPipeline(_, _)).Times(0);
+  EXPECT_CALL(*nikss_interface_mock_,
+              LoadStandbyPipeline(kNodeId, kNewBpfObject))
+      .WillOnce(Return(::util::OkStatus()));
+  ::p4::v1::TableEntry new_entry = entry;
+  new_entry.set_table_id(33554435);
+  new_entry.mutable_match(0)->set_field_id(2);
+  new_entry.mutable_action()->mutable_action()->set_action_id(16777219);
+  new_entry.mutable_action()->mutable_action()->mutable_params(0)->set_param_id(
+      2);
+  EXPECT_CALL(*nikss_interface_mock_,
+              WriteTableEntry(standby_session_, ::p4::v1::Update::INSERT,
+                              EqualsProto(new_p4info.tables(0)),
+                              EqualsProto(new_p4info.actions(0)),
+                              EqualsProto(new_entry)))
+      .WillOnce(Return(::util::OkStatus()));
+  ::p4::v1::ValueSetEntry new_value_set;
+  CHECK_OK(ParseProtoFromString(R"pb(
+    value_set_id: 50331649
+    members {
+      match {
+        field_id: 2
+        exact { value: "\x81\x00" }
+      }
+    }
+  )pb", &new_value_set));
+  EXPECT_CALL(*nikss_interface_mock_,
+              WriteValueSet(standby_session_,
+                            EqualsProto(new_p4info.value_sets(0)),
+                            EqualsProto(new_value_set)))
+      .WillOnce(Return(::util::OkStatus()));
+  ::p4::v1::CounterEntry new_counter;
+  CHECK_OK(ParseProtoFromString(R"pb(
+    counter_id: 302055425
+    index { index: 3 }
+    data { byte_count: 100 packet_count: 5 }
+  )pb", &new_counter));
+  EXPECT_CALL(*nikss_interface_mock_,
+              WriteIndirectCounter(standby_session_,
+                                   EqualsProto(new_p4info.counters(0)),
+                                   EqualsProto(new_counter)))
+      .WillOnce(Return(::util::OkStatus()));
+  ::p4::v1::MeterEntry new_meter;
+  CHECK_OK(ParseProtoFromString(R"pb(
+    meter_id: 335544321
+    index { index: 1 }
+    config { cir: 1000 cburst: 100 pir: 2000 pburst: 200 }
+  )pb", &new_meter));
+  EXPECT_CALL(*nikss_interface_mock_,
+              WriteMeter(standby_session_, EqualsProto(new_p4info.meters(0)),
+                         EqualsProto(new_meter)))
+      .WillOnce(Return(::util::OkStatus()));
+  ::p4::v1::RegisterEntry new_register;
+  CHECK_OK(ParseProtoFromString(R"pb(
+    register_id: 369098753
+    index { index: 2 }
+    data { bitstring: "\x07" }
+  )pb", &new_register));
+  EXPECT_CALL(*nikss_interface_mock_,
+              WriteRegister(standby_session_,
+                            EqualsProto(new_p4info.registers(0)),
+                            EqualsProto(new_register)))
+      .WillOnce(Return(::util::OkStatus()));
+  ::p4::v1::DirectCounterEntry new_direct_counter;
+  CHECK_OK(ParseProtoFromString(R"pb(
+    table_entry {
+      table_id: 33554435
+      match {
+        field_id: 2
+        exact { value: "\001" }
+      }
+    }
+    data { packet_count: 9 }
+  )pb", &new_direct_counter));
+  EXPECT_CALL(*nikss_interface_mock_,
+              WriteDirectCounter(standby_session_,
+                                 EqualsProto(new_p4info.tables(0)),
+                                 EqualsProto(new_p4info.direct_counters(0)),
+                                 EqualsProto(new_direct_counter)))
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_CALL(*nikss_interface_mock_, WriteDirectMeter(_, _, _, _)).Times(0);
+  EXPECT_CALL(*nikss_interface_mock_, SwitchToStandbyPipeline(kNodeId))
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_CALL(*nikss_interface_mock_, DiscardStandbyPipeline(_)).Times(0);
+  EXPECT_CALL(*nikss_packetio_manager_mock_,
+              PushForwardingPipelineConfig(EqualsProto(new_p4info)))
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_CALL(*nikss_digest_manager_mock_,
+              PushForwardingPipelineConfig(EqualsProto(new_p4info)))
+      .WillOnce(Return(::util::OkStatus()));
+
+  ::p4::v1::ForwardingPipelineConfig config;
+  *config.mutable_p4info() = new_p4info;
+  config.set_p4_device_config(kNewBpfObject);
+  EXPECT_OK(nikss_node_->PushForwardingPipelineConfig(config));
+}
+
+TEST_F(NikssNodeTest, CommitDiscardsStandbyPipelineOnFailure) {
+  PushForwardingPipelineConfig();
+  const ::p4::v1::TableEntry entry = ParseTableEntry(kForwardEntry);
+  EXPECT_CALL(*nikss_interface_mock_,
+              ReadTableEntries(session_, EqualsProto(p4info_.tables(0)), _, _,
+                               _))
+      .WillOnce(WithArg<4>(
+          Invoke([&entry](WriterInterface<::p4::v1::TableEntry>* writer) {
+            EXPECT_TRUE(writer->Write(entry));
+            return ::util::OkStatus();
+          })))
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_CALL(*nikss_interface_mock_,
+              LoadStandbyPipeline(kNodeId, kNewBpfObject))
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_CALL(*nikss_interface_mock_,
+              WriteTableEntry(standby_session_, ::p4::v1::Update::INSERT, _, _,
+                              EqualsProto(entry)))
+      .WillOnce(Return(MAKE_ERROR(ERR_TABLE_FULL) << "Table is full."));
+  EXPECT_CALL(*nikss_interface_mock_, SwitchToStandbyPipeline(_)).Times(0);
+  EXPECT_CALL(*nikss_interface_mock_, DiscardStandbyPipeline(kNodeId))
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_CALL(*nikss_packetio_manager_mock_, PushForwardingPipelineConfig(_))
+      .Times(0);
+  EXPECT_CALL(*nikss_digest_manager_mock_, PushForwardingPipelineConfig(_))
+      .Times(0);
+
+  ::p4::v1::ForwardingPipelineConfig config;
+  *config.mutable_p4info() = p4info_;
+  config.set_p4_device_config(kNewBpfObject);
+  ASSERT_OK(nikss_node_->SaveForwardingPipelineConfig(config));
+  EXPECT_THAT(nikss_node_->CommitForwardingPipelineConfig(),
+              StatusIs(StratumErrorSpace(), ERR_TABLE_FULL,
+                       HasSubstr("Table is full.")));
+
+  // The running pipeline keeps serving writes.
+  EXPECT_CALL(*nikss_interface_mock_,
+              WriteTableEntry(session_, ::p4::v1::Update::MODIFY,
+                              EqualsProto(p4info_.tables(0)), _,
+                              EqualsProto(entry)))
+      .WillOnce(Return(::util::OkStatus()));
+  std::vector<::util::Status> results;
+  EXPECT_OK(WriteForwardingEntries(
+      absl::StrCat("updates { type: MODIFY entity { table_entry { ",
+                   entry.ShortDebugString(), " } } }"),
+      &results));
+}
+
+}  // namespace nikss
+}  // namespace hal
+}  // namespace stratum
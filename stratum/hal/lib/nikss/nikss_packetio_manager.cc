@@ -0,0 +1,624 @@
+#include "stratum/hal/lib/nikss/nikss_packetio_manager.h"
+
+#include <arpa/inet.h>
+#include <linux/if_ether.h>
+#include <linux/if_packet.h>
+#include <net/if.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+
+#include "absl/memory/memory.h"
+#include "absl/strings/str_cat.h"
+#include "absl/time/time.h"
+#include "stratum/glue/logging.h"
+#include "stratum/glue/status/status_macros.h"
+#include "stratum/hal/lib/common/constants.h"
+#include "stratum/lib/macros.h"
+#include "stratum/lib/utils.h"
+#include "stratum/public/proto/error.pb.h"
+
+namespace stratum {
+namespace hal {
+namespace nikss {
+
+namespace {
+
+// Geometry of the PACKET_MMAP RX ring. Frames larger than a ring frame are
+// truncated by the kernel and dropped as errors.
+constexpr size_t kRxRingFrameSize = 1 << 12;
+constexpr size_t kRxRingBlockSize = 1 << 16;
+constexpr size_t kRxRingBlockCount = 64;
+
+// Timeout of the RX thread when waiting for packets, so that it can notice a
+// shutdown.
+constexpr int kRxPollTimeoutMs = 100;
+
+// Upper bound of the packet_out header, which is serialized on the stack.
+constexpr size_t kMaxPacketOutHeaderSize = 64;
+
+// Copies a field of the given bit width at the given bit offset of a network
+// order header into a P4Runtime bytestring. The value is written in place, so
+// that the buffer of the string is reused.
+void ExtractHeaderField(const uint8* header, size_t bit_offset, int bitwidth,
+                        std::string* value) {
+  const size_t num_bytes = (bitwidth + 7) / 8;
+  value->assign(num_bytes, '\0');
+  const size_t pad_bits = num_bytes * 8 - bitwidth;
+  for (int i = 0; i < bitwidth; ++i) {
+    const size_t src = bit_offset + i;
+    const size_t dst = pad_bits + i;
+    if ((header[src / 8] >> (7 - src % 8)) & 1u) {
+      (*value)[dst / 8] |= static_cast<char>(1u << (7 - dst % 8));
+    }
+  }
+  // P4Runtime bytestrings are canonical, i.e. without leading zero bytes.
+  size_t leading_zeros = 0;
+  while (leading_zeros + 1 < value->size() && (*value)[leading_zeros] == 0) {
+    ++leading_zeros;
+  }
+  value->erase(0, leading_zeros);
+}
+
+// Writes a P4Runtime bytestring as field of the given bit width at the given
+// bit offset into a zero-initialized network order header.
+::util::Status InsertHeaderField(const std::string& value, size_t bit_offset,
+                                 int bitwidth, uint8* header) {
+  const size_t value_bits = value.size() * 8;
+  for (size_t i = 0; i < value_bits; ++i) {
+    const bool bit = (static_cast<uint8>(value[i / 8]) >> (7 - i % 8)) & 1u;
+    if (i + bitwidth < value_bits) {
+      // Bits in front of the field must be zero.
+      RET_CHECK(!bit) << "Bytestring " << StringToHex(value)
+                      << " overflows bit width " << bitwidth << ".";
+      continue;
+    }
+    if (bit) {
+      const size_t dst = bit_offset + i + bitwidth - value_bits;
+      header[dst / 8] |= 1u << (7 - dst % 8);
+    }
+  }
+  return ::util::OkStatus();
+}
+
+}  // namespace
+
+NikssPacketioManager::NikssPacketioManager(
+    const std::string& cpu_port_interface, size_t packet_in_queue_depth)
+    : initialized_(false),
+      shutdown_(false),
+      rx_writer_(nullptr),
+      packetin_header_(),
+      packetout_header_(),
+      packetin_header_size_(),
+      packetout_header_size_(),
+      packet_in_channel_(nullptr),
+      socket_fd_(-1),
+      rx_ring_(nullptr),
+      rx_ring_size_(0),
+      rx_thread_id_(),
+      packet_in_thread_id_(),
+      rx_packets_(0),
+      rx_ring_drops_(0),
+      rx_queue_drops_(0),
+      rx_no_writer_drops_(0),
+      rx_errors_(0),
+      tx_packets_(0),
+      tx_errors_(0),
+      cpu_port_interface_(cpu_port_interface),
+      packet_in_queue_depth_(packet_in_queue_depth) {}
+
+NikssPacketioManager::NikssPacketioManager()
+    : NikssPacketioManager("", 0) {}
+
+NikssPacketioManager::~NikssPacketioManager() {}
+
+std::unique_ptr<NikssPacketioManager> NikssPacketioManager::CreateInstance(
+    const std::string& cpu_port_interface, size_t packet_in_queue_depth) {
+  return absl::WrapUnique(
+      new NikssPacketioManager(cpu_port_interface, packet_in_queue_depth));
+}
+
+::util::Status NikssPacketioManager::PushForwardingPipelineConfig(
+    const ::p4::config::v1::P4Info& p4info) {
+  ::util::Status error;
+  {
+    absl::WriterMutexLock l(&data_lock_);
+    RETURN_IF_ERROR(BuildMetadataMapping(p4info));
+    if (initialized_) return ::util::OkStatus();
+    RETURN_IF_ERROR(OpenCpuPort());
+    shutdown_ = false;
+    packet_in_channel_ = Channel<std::unique_ptr<::p4::v1::PacketIn>>::Create(
+        packet_in_queue_depth_, "nikss_packet_in");
+    ResetPacketInPool();
+    int ret = pthread_create(&rx_thread_id_, nullptr,
+                             &NikssPacketioManager::CpuPortRxThreadFunc, this);
+    if (ret != 0) {
+      rx_thread_id_ = 0;
+      error = MAKE_ERROR(ERR_INTERNAL)
+              << "Failed to spawn RX thread for CPU port "
+              << cpu_port_interface_ << ". Err: " << ret << ".";
+    } else {
+      ret = pthread_create(&packet_in_thread_id_, nullptr,
+                           &NikssPacketioManager::PacketInThreadFunc, this);
+      if (ret == 0) {
+        initialized_ = true;
+        return ::util::OkStatus();
+      }
+      packet_in_thread_id_ = 0;
+      error = MAKE_ERROR(ERR_INTERNAL)
+              << "Failed to spawn PacketIn thread for CPU port "
+              << cpu_port_interface_ << ". Err: " << ret << ".";
+    }
+  }
+  // Stops the RX thread if it is already running. This is done without holding
+  // data_lock_, as the thread acquires it.
+  APPEND_STATUS_IF_ERROR(error, StopPacketIo());
+
+  return error;
+}
+
+::util::Status NikssPacketioManager::Shutdown() {
+  {
+    absl::WriterMutexLock l(&rx_writer_lock_);
+    rx_writer_ = nullptr;
+  }
+  ::util::Status status = StopPacketIo();
+  LOG(INFO) << "Packet IO on CPU port " << cpu_port_interface_
+            << " stopped: " << rx_packets_ << " packets received, "
+            << rx_ring_drops_ + rx_queue_drops_ + rx_no_writer_drops_
+            << " dropped, " << rx_errors_ << " errors; " << tx_packets_
+            << " packets transmitted, " << tx_errors_ << " errors.";
+
+  return status;
+}
+
+::util::Status NikssPacketioManager::StopPacketIo() {
+  ::util::Status status;
+  pthread_t rx_thread_id;
+  pthread_t packet_in_thread_id;
+  {
+    absl::WriterMutexLock l(&data_lock_);
+    shutdown_ = true;
+    if (packet_in_channel_ && !packet_in_channel_->Close()) {
+      ::util::Status error = MAKE_ERROR(ERR_INTERNAL)
+                             << "PacketIn channel is already closed.";
+      APPEND_STATUS_IF_ERROR(status, error);
+    }
+    rx_thread_id = rx_thread_id_;
+    packet_in_thread_id = packet_in_thread_id_;
+  }
+  // The threads are joined without holding data_lock_, as both of them acquire
+  // it while running.
+  for (pthread_t thread_id : {rx_thread_id, packet_in_thread_id}) {
+    if (thread_id != 0 && pthread_join(thread_id, nullptr) != 0) {
+      ::util::Status error = MAKE_ERROR(ERR_INTERNAL)
+                             << "Failed to join thread " << thread_id;
+      APPEND_STATUS_IF_ERROR(status, error);
+    }
+  }
+  {
+    absl::WriterMutexLock l(&data_lock_);
+    CloseCpuPort();
+    packetin_header_.clear();
+    packetout_header_.clear();
+    packetin_header_size_ = 0;
+    packetout_header_size_ = 0;
+    packet_in_channel_.reset();
+    rx_thread_id_ = 0;
+    packet_in_thread_id_ = 0;
+    initialized_ = false;
+  }
+  {
+    absl::MutexLock l(&packet_in_pool_lock_);
+    packet_in_pool_.clear();
+  }
+
+  return status;
+}
+
+::util::Status NikssPacketioManager::RegisterPacketReceiveWriter(
+    const std::shared_ptr<WriterInterface<::p4::v1::PacketIn>>& writer) {
+  absl::WriterMutexLock l(&rx_writer_lock_);
+  rx_writer_ = writer;
+  return ::util::OkStatus();
+}
+
+::util::Status NikssPacketioManager::UnregisterPacketReceiveWriter() {
+  absl::WriterMutexLock l(&rx_writer_lock_);
+  rx_writer_ = nullptr;
+  return ::util::OkStatus();
+}
+
+::util::Status NikssPacketioManager::TransmitPacket(
+    const ::p4::v1::PacketOut& packet) {
+  absl::ReaderMutexLock l(&data_lock_);
+  if (!initialized_) {
+    return MAKE_ERROR(ERR_NOT_INITIALIZED) << "Not initialized.";
+  }
+  uint8 header[kMaxPacketOutHeaderSize];
+  auto header_size = DeparsePacketOutHeader(packet, header, sizeof(header));
+  if (!header_size.ok()) {
+    ++tx_errors_;
+    return header_size.status();
+  }
+
+  // The header and the payload are sent in a single frame without copying the
+  // payload.
+  struct iovec iov[2];
+  iov[0].iov_base = header;
+  iov[0].iov_len = header_size.ValueOrDie();
+  iov[1].iov_base = const_cast<char*>(packet.payload().data());
+  iov[1].iov_len = packet.payload().size();
+  struct msghdr msg = {};
+  msg.msg_iov = iov;
+  msg.msg_iovlen = 2;
+  if (sendmsg(socket_fd_, &msg, 0) < 0) {
+    ++tx_errors_;
+    return MAKE_ERROR(ERR_INTERNAL)
+           << "Failed to send packet on CPU port " << cpu_port_interface_
+           << ": " << strerror(errno) << ".";
+  }
+  ++tx_packets_;
+
+  return ::util::OkStatus();
+}
+
+NikssPacketioManager::PacketIoStats NikssPacketioManager::GetStats() {
+  {
+    absl::ReaderMutexLock l(&data_lock_);
+    if (socket_fd_ >= 0) {
+      // The kernel resets its statistics on every read, so they are
+      // accumulated here.
+      struct tpacket_stats stats = {};
+      socklen_t len = sizeof(stats);
+      if (getsockopt(socket_fd_, SOL_PACKET, PACKET_STATISTICS, &stats,
+                     &len) == 0) {
+        rx_ring_drops_ += stats.tp_drops;
+      }
+    }
+  }
+  PacketIoStats stats;
+  stats.rx_packets = rx_packets_;
+  stats.rx_ring_drops = rx_ring_drops_;
+  stats.rx_queue_drops = rx_queue_drops_;
+  stats.rx_no_writer_drops = rx_no_writer_drops_;
+  stats.rx_errors = rx_errors_;
+  stats.tx_packets = tx_packets_;
+  stats.tx_errors = tx_errors_;
+  return stats;
+}
+
+std::string NikssPacketioManager::DumpStats() {
+  const PacketIoStats stats = GetStats();
+  return absl::StrCat(
+      "CPU port ", cpu_port_interface_, ": ", stats.rx_packets,
+      " packets received, ", stats.rx_ring_drops, " dropped (RX ring full), ",
+      stats.rx_queue_drops, " dropped (PacketIn queue full), ",
+      stats.rx_no_writer_drops, " dropped (no controller), ", stats.rx_errors,
+      " errors; ", stats.tx_packets, " packets transmitted, ", stats.tx_errors,
+      " errors\n");
+}
+
+::util::Status NikssPacketioManager::OpenCpuPort() {
+  RET_CHECK(!cpu_port_interface_.empty()) << "No CPU port interface given.";
+  const unsigned int ifindex = if_nametoindex(cpu_port_interface_.c_str());
+  if (ifindex == 0) {
+    return MAKE_ERROR(ERR_INVALID_PARAM)
+           << "CPU port interface " << cpu_port_interface_
+           << " does not exist: " << strerror(errno) << ".";
+  }
+
+  int fd = socket(AF_PACKET, SOCK_RAW, htons(ETH_P_ALL));
+  if (fd < 0) {
+    return MAKE_ERROR(ERR_INTERNAL)
+           << "Failed to open raw socket: " << strerror(errno) << ".";
+  }
+  int version = TPACKET_V2;
+  struct tpacket_req req = {};
+  req.tp_block_size = kRxRingBlockSize;
+  req.tp_block_nr = kRxRingBlockCount;
+  req.tp_frame_size = kRxRingFrameSize;
+  req.tp_frame_nr = kRxRingBlockSize / kRxRingFrameSize * kRxRingBlockCount;
+  if (setsockopt(fd, SOL_PACKET, PACKET_VERSION, &version, sizeof(version)) <
+          0 ||
+      setsockopt(fd, SOL_PACKET, PACKET_RX_RING, &req, sizeof(req)) < 0) {
+    ::util::Status error = MAKE_ERROR(ERR_INTERNAL)
+                           << "Failed to set up RX ring on CPU port "
+                           << cpu_port_interface_ << ": " << strerror(errno)
+                           << ".";
+    close(fd);
+    return error;
+  }
+  const size_t ring_size = kRxRingBlockSize * kRxRingBlockCount;
+  void* ring =
+      mmap(nullptr, ring_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (ring == MAP_FAILED) {
+    ::util::Status error = MAKE_ERROR(ERR_INTERNAL)
+                           << "Failed to map RX ring of CPU port "
+                           << cpu_port_interface_ << ": " << strerror(errno)
+                           << ".";
+    close(fd);
+    return error;
+  }
+  struct sockaddr_ll addr = {};
+  addr.sll_family = AF_PACKET;
+  addr.sll_protocol = htons(ETH_P_ALL);
+  addr.sll_ifindex = ifindex;
+  if (bind(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) < 0) {
+    ::util::Status error = MAKE_ERROR(ERR_INTERNAL)
+                           << "Failed to bind to CPU port "
+                           << cpu_port_interface_ << ": " << strerror(errno)
+                           << ".";
+    munmap(ring, ring_size);
+    close(fd);
+    return error;
+  }
+
+  socket_fd_ = fd;
+  rx_ring_ = static_cast<uint8*>(ring);
+  rx_ring_size_ = ring_size;
+  LOG(INFO) << "Opened CPU port " << cpu_port_interface_ << " with "
+            << req.tp_frame_nr << " RX ring frames.";
+
+  return ::util::OkStatus();
+}
+
+void NikssPacketioManager::CloseCpuPort() {
+  if (rx_ring_) {
+    munmap(rx_ring_, rx_ring_size_);
+    rx_ring_ = nullptr;
+    rx_ring_size_ = 0;
+  }
+  if (socket_fd_ >= 0) {
+    close(socket_fd_);
+    socket_fd_ = -1;
+  }
+}
+
+void NikssPacketioManager::ResetPacketInPool() {
+  absl::MutexLock l(&packet_in_pool_lock_);
+  packet_in_pool_.clear();
+  packet_in_pool_.reserve(packet_in_queue_depth_);
+  for (size_t i = 0; i < packet_in_queue_depth_; ++i) {
+    packet_in_pool_.push_back(absl::make_unique<::p4::v1::PacketIn>());
+  }
+}
+
+std::unique_ptr<::p4::v1::PacketIn> NikssPacketioManager::AcquirePacketIn() {
+  absl::MutexLock l(&packet_in_pool_lock_);
+  if (packet_in_pool_.empty()) return nullptr;
+  auto packet = std::move(packet_in_pool_.back());
+  packet_in_pool_.pop_back();
+  return packet;
+}
+
+void NikssPacketioManager::ReleasePacketIn(
+    std::unique_ptr<::p4::v1::PacketIn> packet) {
+  absl::MutexLock l(&packet_in_pool_lock_);
+  packet_in_pool_.push_back(std::move(packet));
+}
+
+::util::StatusOr<size_t> NikssPacketioManager::DeparsePacketOutHeader(
+    const ::p4::v1::PacketOut& packet, uint8* header, size_t max_size) {
+  RET_CHECK(packetout_header_size_ <= max_size)
+      << "PacketOut header of " << packetout_header_size_
+      << " bytes is too large.";
+  std::memset(header, 0, packetout_header_size_);
+  size_t bit_offset = 0;
+  for (const auto& p : packetout_header_) {
+    const auto id = p.first;
+    const auto bitwidth = p.second;
+    const ::p4::v1::PacketMetadata* metadata = nullptr;
+    for (const auto& m : packet.metadata()) {
+      if (m.metadata_id() == id) {
+        metadata = &m;
+        break;
+      }
+    }
+    RET_CHECK(metadata != nullptr)
+        << "Missing metadata with Id " << id << " in PacketOut "
+        << packet.ShortDebugString();
+    RETURN_IF_ERROR(
+        InsertHeaderField(metadata->value(), bit_offset, bitwidth, header));
+    bit_offset += bitwidth;
+  }
+
+  return packetout_header_size_;
+}
+
+::util::Status NikssPacketioManager::ParsePacketIn(const uint8* frame,
+                                                   size_t length,
+                                                   ::p4::v1::PacketIn* packet) {
+  RET_CHECK(length >= packetin_header_size_) << "Received packet is too small.";
+
+  // Existing metadata entries are overwritten instead of being reallocated.
+  while (packet->metadata_size() > static_cast<int>(packetin_header_.size())) {
+    packet->mutable_metadata()->RemoveLast();
+  }
+  size_t bit_offset = 0;
+  for (size_t i = 0; i < packetin_header_.size(); ++i) {
+    const auto& p = packetin_header_[i];
+    auto* metadata = static_cast<int>(i) < packet->metadata_size()
+                         ? packet->mutable_metadata(i)
+                         : packet->add_metadata();
+    metadata->set_metadata_id(p.first);
+    ExtractHeaderField(frame, bit_offset, p.second,
+                       metadata->mutable_value());
+    bit_offset += p.second;
+  }
+  packet->mutable_payload()->assign(
+      reinterpret_cast<const char*>(frame) + packetin_header_size_,
+      length - packetin_header_size_);
+
+  return ::util::OkStatus();
+}
+
+void NikssPacketioManager::HandleCpuPortRx() {
+  std::unique_ptr<ChannelWriter<std::unique_ptr<::p4::v1::PacketIn>>> writer;
+  int fd;
+  uint8* ring;
+  {
+    absl::ReaderMutexLock l(&data_lock_);
+    writer = ChannelWriter<std::unique_ptr<::p4::v1::PacketIn>>::Create(
+        packet_in_channel_);
+    fd = socket_fd_;
+    ring = rx_ring_;
+  }
+  if (!writer) return;
+
+  const size_t num_frames =
+      kRxRingBlockSize / kRxRingFrameSize * kRxRingBlockCount;
+  // The sockaddr_ll of each frame follows the tpacket2_hdr.
+  const size_t addr_offset = TPACKET_ALIGN(sizeof(struct tpacket2_hdr));
+  struct pollfd pfd = {};
+  pfd.fd = fd;
+  pfd.events = POLLIN | POLLERR;
+  size_t frame_idx = 0;
+  // The PacketIn taken from the pool is only handed over when it was enqueued,
+  // otherwise it is reused for the next frame.
+  std::unique_ptr<::p4::v1::PacketIn> packet_in;
+  while (!shutdown_) {
+    uint8* frame = ring + frame_idx * kRxRingFrameSize;
+    auto* hdr = reinterpret_cast<struct tpacket2_hdr*>(frame);
+    if (!(__atomic_load_n(&hdr->tp_status, __ATOMIC_ACQUIRE) &
+          TP_STATUS_USER)) {
+      poll(&pfd, 1, kRxPollTimeoutMs);
+      continue;
+    }
+
+    const auto* addr =
+        reinterpret_cast<const struct sockaddr_ll*>(frame + addr_offset);
+    if (addr->sll_pkttype == PACKET_OUTGOING) {
+      // Our own PacketOuts.
+    } else if (hdr->tp_snaplen < hdr->tp_len) {
+      ++rx_errors_;
+      LOG_EVERY_N(WARNING, 1000)
+          << "Dropped truncated packet of " << hdr->tp_len
+          << " bytes on CPU port " << cpu_port_interface_ << ".";
+    } else if (!packet_in && !(packet_in = AcquirePacketIn())) {
+      // All the PacketIns of the pool are queued, i.e. the queue is full.
+      ++rx_queue_drops_;
+      LOG_EVERY_N(WARNING, 1000)
+          << "PacketIn queue full, dropped " << rx_queue_drops_
+          << " packets on CPU port " << cpu_port_interface_ << " so far.";
+    } else {
+      ::util::Status status;
+      {
+        absl::ReaderMutexLock l(&data_lock_);
+        status = ParsePacketIn(frame + hdr->tp_mac, hdr->tp_snaplen,
+                               packet_in.get());
+      }
+      if (!status.ok()) {
+        ++rx_errors_;
+      } else if (!writer->TryWrite(std::move(packet_in)).ok()) {
+        // The pool is not larger than the queue, so the write only fails once
+        // the channel has been closed.
+        break;
+      }
+    }
+
+    // Hand the frame back to the kernel.
+    __atomic_store_n(&hdr->tp_status, TP_STATUS_KERNEL, __ATOMIC_RELEASE);
+    frame_idx = (frame_idx + 1) % num_frames;
+  }
+}
+
+void NikssPacketioManager::HandlePacketInQueue() {
+  std::unique_ptr<ChannelReader<std::unique_ptr<::p4::v1::PacketIn>>> reader;
+  {
+    absl::ReaderMutexLock l(&data_lock_);
+    reader = ChannelReader<std::unique_ptr<::p4::v1::PacketIn>>::Create(
+        packet_in_channel_);
+  }
+  if (!reader) return;
+
+  std::unique_ptr<::p4::v1::PacketIn> packet_in;
+  while (true) {
+    int code = reader->Read(&packet_in, absl::InfiniteDuration()).error_code();
+    if (code == ERR_CANCELLED) break;
+    if (code == ERR_ENTRY_NOT_FOUND) {
+      LOG(ERROR) << "Read with infinite timeout failed with ENTRY_NOT_FOUND.";
+      continue;
+    }
+    bool written = false;
+    {
+      absl::WriterMutexLock l(&rx_writer_lock_);
+      if (rx_writer_) {
+        rx_writer_->Write(*packet_in);
+        written = true;
+      }
+    }
+    if (written) {
+      ++rx_packets_;
+      VLOG(1) << "Handled PacketIn: " << packet_in->ShortDebugString();
+    } else {
+      ++rx_no_writer_drops_;
+    }
+    ReleasePacketIn(std::move(packet_in));
+  }
+}
+
+::util::Status NikssPacketioManager::BuildMetadataMapping(
+    const ::p4::config::v1::P4Info& p4_info) {
+  std::vector<std::pair<uint32, int>> packetin_header;
+  std::vector<std::pair<uint32, int>> packetout_header;
+  size_t packetin_bits = 0;
+  size_t packetout_bits = 0;
+  for (const auto& controller_packet_metadata :
+       p4_info.controller_packet_metadata()) {
+    const std::string& name = controller_packet_metadata.preamble().name();
+    if (name != kIngressMetadataPreambleName &&
+        name != kEgressMetadataPreambleName) {
+      LOG(WARNING) << "Skipped unknown metadata preamble: " << name << ".";
+      continue;
+    }
+    // The order in the P4Info is representative of the actual header structure.
+    for (const auto& metadata : controller_packet_metadata.metadata()) {
+      uint32 id = metadata.id();
+      int bitwidth = metadata.bitwidth();
+      if (name == kIngressMetadataPreambleName) {
+        packetin_header.push_back(std::make_pair(id, bitwidth));
+        packetin_bits += bitwidth;
+      } else {
+        packetout_header.push_back(std::make_pair(id, bitwidth));
+        packetout_bits += bitwidth;
+      }
+    }
+  }
+
+  RET_CHECK(packetin_bits % 8 == 0)
+      << "PacketIn header size must be multiple of 8 bits.";
+  RET_CHECK(packetout_bits % 8 == 0)
+      << "PacketOut header size must be multiple of 8 bits.";
+  RET_CHECK(packetout_bits / 8 <= kMaxPacketOutHeaderSize)
+      << "PacketOut header must not be larger than "
+      << kMaxPacketOutHeaderSize << " bytes.";
+  packetin_header_ = std::move(packetin_header);
+  packetout_header_ = std::move(packetout_header);
+  packetin_header_size_ = packetin_bits / 8;
+  packetout_header_size_ = packetout_bits / 8;
+
+  return ::util::OkStatus();
+}
+
+void* NikssPacketioManager::CpuPortRxThreadFunc(void* arg) {
+  NikssPacketioManager* mgr = reinterpret_cast<NikssPacketioManager*>(arg);
+  mgr->HandleCpuPortRx();
+  return nullptr;
+}
+
+void* NikssPacketioManager::PacketInThreadFunc(void* arg) {
+  NikssPacketioManager* mgr = reinterpret_cast<NikssPacketioManager*>(arg);
+  mgr->HandlePacketInQueue();
+  return nullptr;
+}
+
+}  // namespace nikss
+}  // namespace hal
+}  // namespace stratum
@@ -0,0 +1,211 @@
+#ifndef STRATUM_HAL_LIB_NIKSS_NIKSS_PACKETIO_MANAGER_H_
+#define STRATUM_HAL_LIB_NIKSS_NIKSS_PACKETIO_MANAGER_H_
+
+#include <pthread.h>
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/synchronization/mutex.h"
+#include "p4/config/v1/p4info.pb.h"
+#include "p4/v1/p4runtime.pb.h"
+#include "stratum/glue/integral_types.h"
+#include "stratum/glue/status/status.h"
+#include "stratum/glue/status/statusor.h"
+#include "stratum/hal/lib/common/writer_interface.h"
+#include "stratum/lib/channel/channel.h"
+
+namespace stratum {
+namespace hal {
+namespace nikss {
+
+// The NikssPacketioManager handles controller packet I/O of a NIKSS pipeline.
+// Packets punted by the pipeline arrive on the CPU port interface (e.g. a TAP
+// or veth device) with the PSA packet_in header in front and are received
+// through a PACKET_MMAP ring on a dedicated RX thread. The frames are parsed
+// into PacketIns taken from a preallocated pool and handed over to the
+// StreamChannel writer through a bounded queue; the messages are returned to
+// the pool once written, so that their buffers are reused. Packets arriving
+// while the pool is exhausted are dropped and counted. PacketOuts are injected
+// on the same interface with the packet_out header prepended.
+class NikssPacketioManager {
+ public:
+  // Counters of the CPU port.
+  struct PacketIoStats {
+    uint64 rx_packets;         // Packets handed over to the controller.
+    uint64 rx_ring_drops;      // Packets dropped by the kernel, ring full.
+    uint64 rx_queue_drops;     // Packets dropped, PacketIn queue full.
+    uint64 rx_no_writer_drops; // Packets dropped, no controller registered.
+    uint64 rx_errors;          // Truncated or malformed packets.
+    uint64 tx_packets;         // PacketOuts injected.
+    uint64 tx_errors;          // PacketOuts that could not be injected.
+  };
+
+  virtual ~NikssPacketioManager();
+
+  // Pushes the forwarding pipeline to this class. If this is the first time, it
+  // will also open the CPU port and start the packet IO threads.
+  virtual ::util::Status PushForwardingPipelineConfig(
+      const ::p4::config::v1::P4Info& p4info) LOCKS_EXCLUDED(data_lock_);
+
+  // Stops the packet IO threads and closes the CPU port.
+  virtual ::util::Status Shutdown() LOCKS_EXCLUDED(data_lock_);
+
+  // Registers a writer to be invoked when we capture a packet on the CPU port.
+  virtual ::util::Status RegisterPacketReceiveWriter(
+      const std::shared_ptr<WriterInterface<::p4::v1::PacketIn>>& writer)
+      LOCKS_EXCLUDED(rx_writer_lock_);
+
+  virtual ::util::Status UnregisterPacketReceiveWriter()
+      LOCKS_EXCLUDED(rx_writer_lock_);
+
+  // Transmits a packet to the CPU port.
+  virtual ::util::Status TransmitPacket(const ::p4::v1::PacketOut& packet)
+      LOCKS_EXCLUDED(data_lock_);
+
+  // Returns a snapshot of the packet IO counters.
+  virtual PacketIoStats GetStats() LOCKS_EXCLUDED(data_lock_);
+
+  // Returns a human-readable dump of the packet IO counters, e.g. for the
+  // gNMI packet IO debug string of the node.
+  std::string DumpStats() LOCKS_EXCLUDED(data_lock_);
+
+  // Factory function for creating the instance of the class.
+  static std::unique_ptr<NikssPacketioManager> CreateInstance(
+      const std::string& cpu_port_interface, size_t packet_in_queue_depth);
+
+  // NikssPacketioManager is neither copyable nor movable.
+  NikssPacketioManager(const NikssPacketioManager&) = delete;
+  NikssPacketioManager& operator=(const NikssPacketioManager&) = delete;
+
+ protected:
+  // Default constructor. To be called by the Mock class instance only.
+  NikssPacketioManager();
+
+ private:
+  // Private constructor. Use CreateInstance() to create an instance of this
+  // class.
+  NikssPacketioManager(const std::string& cpu_port_interface,
+                       size_t packet_in_queue_depth);
+
+  // Builds the packet header structure for controller packets.
+  ::util::Status BuildMetadataMapping(const ::p4::config::v1::P4Info& p4_info)
+      EXCLUSIVE_LOCKS_REQUIRED(data_lock_);
+
+  // Opens a raw socket on the CPU port and maps its RX ring.
+  ::util::Status OpenCpuPort() EXCLUSIVE_LOCKS_REQUIRED(data_lock_);
+
+  // Unmaps the RX ring and closes the raw socket.
+  void CloseCpuPort() EXCLUSIVE_LOCKS_REQUIRED(data_lock_);
+
+  // Stops the packet IO threads which have been started, closes the CPU port
+  // and clears the metadata mappings.
+  ::util::Status StopPacketIo() LOCKS_EXCLUDED(data_lock_);
+
+  // Fills the PacketIn pool with packet_in_queue_depth_ messages.
+  void ResetPacketInPool() LOCKS_EXCLUDED(packet_in_pool_lock_);
+
+  // Takes a PacketIn from the pool. Returns nullptr if all of them are queued
+  // or being written, i.e. the PacketIn queue is full.
+  std::unique_ptr<::p4::v1::PacketIn> AcquirePacketIn()
+      LOCKS_EXCLUDED(packet_in_pool_lock_);
+
+  // Returns a PacketIn to the pool.
+  void ReleasePacketIn(std::unique_ptr<::p4::v1::PacketIn> packet)
+      LOCKS_EXCLUDED(packet_in_pool_lock_);
+
+  // Parses a received frame into a PacketIn, filling the metadata fields. The
+  // metadata entries of the given packet are reused if already present.
+  ::util::Status ParsePacketIn(const uint8* frame, size_t length,
+                               ::p4::v1::PacketIn* packet)
+      SHARED_LOCKS_REQUIRED(data_lock_);
+
+  // Serializes the PacketOut metadata fields into the header buffer. Returns
+  // the number of header bytes.
+  ::util::StatusOr<size_t> DeparsePacketOutHeader(
+      const ::p4::v1::PacketOut& packet, uint8* header, size_t max_size)
+      SHARED_LOCKS_REQUIRED(data_lock_);
+
+  // Drains the RX ring into the PacketIn queue until shutdown.
+  void HandleCpuPortRx() LOCKS_EXCLUDED(data_lock_);
+
+  // Forwards PacketIns from the queue to the registered receive writer.
+  void HandlePacketInQueue() LOCKS_EXCLUDED(rx_writer_lock_);
+
+  // CPU port RX thread function.
+  static void* CpuPortRxThreadFunc(void* arg);
+
+  // PacketIn forwarding thread function.
+  static void* PacketInThreadFunc(void* arg);
+
+  // Mutex lock for protecting rx_writer_.
+  mutable absl::Mutex rx_writer_lock_;
+
+  // Mutex lock to protect the metadata mappings and the CPU port.
+  mutable absl::Mutex data_lock_;
+
+  // Initialized to false, set once only on first PushForwardingPipelineConfig.
+  bool initialized_ GUARDED_BY(data_lock_);
+
+  // Set on shutdown to make the RX thread exit.
+  std::atomic<bool> shutdown_;
+
+  // Stores the registered writer for PacketIns.
+  std::shared_ptr<WriterInterface<::p4::v1::PacketIn>> rx_writer_
+      GUARDED_BY(rx_writer_lock_);
+
+  // List of metadata id and bitwidth pairs. Stores the size and structure of
+  // the CPU packet headers.
+  std::vector<std::pair<uint32, int>> packetin_header_ GUARDED_BY(data_lock_);
+  std::vector<std::pair<uint32, int>> packetout_header_ GUARDED_BY(data_lock_);
+  size_t packetin_header_size_ GUARDED_BY(data_lock_);
+  size_t packetout_header_size_ GUARDED_BY(data_lock_);
+
+  // Bounded queue between the RX thread and the StreamChannel writer.
+  std::shared_ptr<Channel<std::unique_ptr<::p4::v1::PacketIn>>>
+      packet_in_channel_ GUARDED_BY(data_lock_);
+
+  // Mutex lock for protecting packet_in_pool_.
+  absl::Mutex packet_in_pool_lock_;
+
+  // The PacketIns not in use. The pool holds as many messages as the queue, so
+  // the queue never fills up and an empty pool is the only drop condition.
+  std::vector<std::unique_ptr<::p4::v1::PacketIn>> packet_in_pool_
+      GUARDED_BY(packet_in_pool_lock_);
+
+  // Raw socket bound to the CPU port and its memory-mapped RX ring.
+  int socket_fd_ GUARDED_BY(data_lock_);
+  uint8* rx_ring_ GUARDED_BY(data_lock_);
+  size_t rx_ring_size_ GUARDED_BY(data_lock_);
+
+  // The IDs of the packet IO threads.
+  pthread_t rx_thread_id_ GUARDED_BY(data_lock_);
+  pthread_t packet_in_thread_id_ GUARDED_BY(data_lock_);
+
+  // Packet IO counters.
+  std::atomic<uint64> rx_packets_;
+  std::atomic<uint64> rx_ring_drops_;
+  std::atomic<uint64> rx_queue_drops_;
+  std::atomic<uint64> rx_no_writer_drops_;
+  std::atomic<uint64> rx_errors_;
+  std::atomic<uint64> tx_packets_;
+  std::atomic<uint64> tx_errors_;
+
+  // Name of the Linux interface used as CPU port.
+  const std::string cpu_port_interface_;
+
+  // Maximum number of PacketIns waiting for the StreamChannel writer.
+  const size_t packet_in_queue_depth_;
+
+  friend class NikssPacketioManagerTest;
+};
+
+}  // namespace nikss
+}  // namespace hal
+}  // namespace stratum
+
+#endif  // STRATUM_HAL_LIB_NIKSS_NIKSS_PACKETIO_MANAGER_H_
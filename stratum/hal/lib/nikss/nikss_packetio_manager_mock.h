@@ -0,0 +1,32 @@
+#ifndef STRATUM_HAL_LIB_NIKSS_NIKSS_PACKETIO_MANAGER_MOCK_H_
+#define STRATUM_HAL_LIB_NIKSS_NIKSS_PACKETIO_MANAGER_MOCK_H_
+
+#include <memory>
+
+#include "gmock/gmock.h"
+#include "stratum/hal/lib/nikss/nikss_packetio_manager.h"
+
+namespace stratum {
+namespace hal {
+namespace nikss {
+
+class NikssPacketioManagerMock : public NikssPacketioManager {
+ public:
+  MOCK_METHOD1(PushForwardingPipelineConfig,
+               ::util::Status(const ::p4::config::v1::P4Info& p4info));
+  MOCK_METHOD0(Shutdown, ::util::Status());
+  MOCK_METHOD1(
+      RegisterPacketReceiveWriter,
+      ::util::Status(
+          const std::shared_ptr<WriterInterface<::p4::v1::PacketIn>>& writer));
+  MOCK_METHOD0(UnregisterPacketReceiveWriter, ::util::Status());
+  MOCK_METHOD1(TransmitPacket,
+               ::util::Status(const ::p4::v1::PacketOut& packet));
+  MOCK_METHOD0(GetStats, PacketIoStats());
+};
+
+}  // namespace nikss
+}  // namespace hal
+}  // namespace stratum
+
+#endif  // STRATUM_HAL_LIB_NIKSS_NIKSS_PACKETIO_MANAGER_MOCK_H_
@@ -0,0 +1,287 @@
+#include "stratum/hal/lib/nikss/nikss_packetio_manager.h"
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/synchronization/mutex.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "p4/v1/p4runtime.pb.h"
+#include "stratum/glue/status/status_macros.h"
+#include "stratum/glue/status/status_test_util.h"
+#include "stratum/lib/test_utils/matchers.h"
+#include "stratum/lib/utils.h"
+
+namespace stratum {
+namespace hal {
+namespace nikss {
+
+using test_utils::EqualsProto;
+using test_utils::StatusIs;
+using ::testing::HasSubstr;
+
+class NikssPacketioManagerTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    nikss_packetio_manager_ = NikssPacketioManager::CreateInstance(
+        kCpuPortInterface, kPacketInQueueDepth);
+  }
+
+  void TearDown() override { EXPECT_OK(nikss_packetio_manager_->Shutdown()); }
+
+  // Sets up the controller header layout without opening the CPU port.
+  ::util::Status BuildMetadataMapping(const std::string& p4info_str = kP4Info) {
+    ::p4::config::v1::P4Info p4info;
+    RETURN_IF_ERROR(ParseProtoFromString(p4info_str, &p4info));
+    absl::WriterMutexLock l(&nikss_packetio_manager_->data_lock_);
+    return nikss_packetio_manager_->BuildMetadataMapping(p4info);
+  }
+
+  ::util::Status ParsePacketIn(const std::string& frame,
+                               ::p4::v1::PacketIn* packet) {
+    absl::ReaderMutexLock l(&nikss_packetio_manager_->data_lock_);
+    return nikss_packetio_manager_->ParsePacketIn(
+        reinterpret_cast<const uint8*>(frame.data()), frame.size(), packet);
+  }
+
+  void ResetPacketInPool() { nikss_packetio_manager_->ResetPacketInPool(); }
+
+  std::unique_ptr<::p4::v1::PacketIn> AcquirePacketIn() {
+    return nikss_packetio_manager_->AcquirePacketIn();
+  }
+
+  void ReleasePacketIn(std::unique_ptr<::p4::v1::PacketIn> packet) {
+    nikss_packetio_manager_->ReleasePacketIn(std::move(packet));
+  }
+
+  ::util::StatusOr<std::string> DeparsePacketOutHeader(
+      const ::p4::v1::PacketOut& packet) {
+    absl::ReaderMutexLock l(&nikss_packetio_manager_->data_lock_);
+    uint8 header[64];
+    ASSIGN_OR_RETURN(size_t size,
+                     nikss_packetio_manager_->DeparsePacketOutHeader(
+                         packet, header, sizeof(header)));
+    return std::string(reinterpret_cast<const char*>(header), size);
+  }
+
+  static constexpr char kCpuPortInterface[] = "nikss-test-cpu0";
+  static constexpr size_t kPacketInQueueDepth = 16;
+  static constexpr char kP4Info[] = R"pb(
+    controller_packet_metadata {
+      preamble {
+        id: 67146229
+        name: "packet_in"
+        alias: "packet_in"
+        annotations: "@controller_header(\"packet_in\")"
+      }
+      metadata {
+        id: 1
+        name: "ingress_port"
+        bitwidth: 9
+      }
+      metadata {
+        id: 2
+        name: "_pad0"
+        bitwidth: 7
+      }
+    }
+    controller_packet_metadata {
+      preamble {
+        id: 67121543
+        name: "packet_out"
+        alias: "packet_out"
+        annotations: "@controller_header(\"packet_out\")"
+      }
+      metadata {
+        id: 1
+        name: "egress_port"
+        bitwidth: 9
+      }
+      metadata {
+        id: 2
+        name: "cpu_loopback_mode"
+        bitwidth: 2
+      }
+      metadata {
+        id: 3
+        name: "pad0"
+        annotations: "@padding"
+        bitwidth: 85
+      }
+      metadata {
+        id: 4
+        name: "ether_type"
+        bitwidth: 16
+      }
+    }
+  )pb";
+
+  std::unique_ptr<NikssPacketioManager> nikss_packetio_manager_;
+};
+
+constexpr char NikssPacketioManagerTest::kCpuPortInterface[];
+constexpr size_t NikssPacketioManagerTest::kPacketInQueueDepth;
+constexpr char NikssPacketioManagerTest::kP4Info[];
+
+TEST_F(NikssPacketioManagerTest, PushInvalidPacketInConfig) {
+  // The total length of packet-in metadata is not byte aligned.
+  const char invalid_packet_in[] = R"pb(
+    controller_packet_metadata {
+      preamble {
+        id: 67146229
+        name: "packet_in"
+      }
+      metadata {
+        id: 1
+        name: "ingress_port"
+        bitwidth: 9
+      }
+    }
+  )pb";
+  ::p4::config::v1::P4Info p4info;
+  ASSERT_OK(ParseProtoFromString(invalid_packet_in, &p4info));
+  EXPECT_THAT(
+      nikss_packetio_manager_->PushForwardingPipelineConfig(p4info),
+      StatusIs(StratumErrorSpace(), ERR_INVALID_PARAM,
+               HasSubstr("PacketIn header size must be multiple of 8 bits.")));
+}
+
+TEST_F(NikssPacketioManagerTest, PushConfigWithMissingCpuPort) {
+  ::p4::config::v1::P4Info p4info;
+  ASSERT_OK(ParseProtoFromString(kP4Info, &p4info));
+  EXPECT_THAT(nikss_packetio_manager_->PushForwardingPipelineConfig(p4info),
+              StatusIs(StratumErrorSpace(), ERR_INVALID_PARAM,
+                       HasSubstr(kCpuPortInterface)));
+}
+
+TEST_F(NikssPacketioManagerTest, TransmitPacketBeforePipelineConfigPush) {
+  ::p4::v1::PacketOut packet;
+  EXPECT_THAT(nikss_packetio_manager_->TransmitPacket(packet),
+              StatusIs(StratumErrorSpace(), ERR_NOT_INITIALIZED,
+                       HasSubstr("Not initialized")));
+}
+
+TEST_F(NikssPacketioManagerTest, ParsePacketIn) {
+  ASSERT_OK(BuildMetadataMapping());
+  const std::string frame("\xd5\x80payload", 9);
+  ::p4::v1::PacketIn packet;
+  // Stale metadata of a reused PacketIn must be replaced.
+  packet.add_metadata()->set_metadata_id(1);
+  packet.add_metadata()->set_metadata_id(2);
+  packet.add_metadata()->set_metadata_id(3);
+  ASSERT_OK(ParsePacketIn(frame, &packet));
+
+  const char kExpectedPacketIn[] = R"pb(
+    payload: "payload"
+    metadata {
+      metadata_id: 1
+      value: "\001\253"
+    }
+    metadata {
+      metadata_id: 2
+      value: "\000"
+    }
+  )pb";
+  ::p4::v1::PacketIn expected_packet;
+  ASSERT_OK(ParseProtoFromString(kExpectedPacketIn, &expected_packet));
+  EXPECT_THAT(packet, EqualsProto(expected_packet));
+}
+
+TEST_F(NikssPacketioManagerTest, ParseTooShortPacketIn) {
+  ASSERT_OK(BuildMetadataMapping());
+  ::p4::v1::PacketIn packet;
+  EXPECT_THAT(ParsePacketIn(std::string("\xd5", 1), &packet),
+              StatusIs(StratumErrorSpace(), ERR_INVALID_PARAM,
+                       HasSubstr("Received packet is too small.")));
+}
+
+TEST_F(NikssPacketioManagerTest, PacketInPoolIsBoundedByQueueDepth) {
+  ResetPacketInPool();
+  std::vector<std::unique_ptr<::p4::v1::PacketIn>> packets;
+  for (size_t i = 0; i < kPacketInQueueDepth; ++i) {
+    packets.push_back(AcquirePacketIn());
+    ASSERT_NE(nullptr, packets.back());
+  }
+  // The queue is full.
+  EXPECT_EQ(nullptr, AcquirePacketIn());
+
+  // A released PacketIn is handed out again, with its buffers.
+  packets.back()->set_payload("payload");
+  ::p4::v1::PacketIn* released = packets.back().get();
+  ReleasePacketIn(std::move(packets.back()));
+  packets.pop_back();
+  auto packet = AcquirePacketIn();
+  EXPECT_EQ(released, packet.get());
+  EXPECT_EQ(nullptr, AcquirePacketIn());
+}
+
+TEST_F(NikssPacketioManagerTest, DeparsePacketOutHeader) {
+  ASSERT_OK(BuildMetadataMapping());
+  const char kPacketOut[] = R"pb(
+    payload: "payload"
+    metadata {
+      metadata_id: 4
+      value: "\276\357"
+    }
+    metadata {
+      metadata_id: 1
+      value: "\001\253"
+    }
+    metadata {
+      metadata_id: 2
+      value: "\001"
+    }
+    metadata {
+      metadata_id: 3
+      value: "\000"
+    }
+  )pb";
+  ::p4::v1::PacketOut packet;
+  ASSERT_OK(ParseProtoFromString(kPacketOut, &packet));
+  ASSERT_OK_AND_ASSIGN(auto header, DeparsePacketOutHeader(packet));
+  EXPECT_EQ(std::string("\xd5\xa0\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00"
+                        "\xbe\xef",
+                        14),
+            header);
+}
+
+TEST_F(NikssPacketioManagerTest, DeparsePacketOutHeaderWithOverflow) {
+  ASSERT_OK(BuildMetadataMapping());
+  const char kPacketOut[] = R"pb(
+    metadata {
+      metadata_id: 1
+      value: "\003\253"
+    }
+    metadata {
+      metadata_id: 2
+      value: "\001"
+    }
+    metadata {
+      metadata_id: 3
+      value: "\000"
+    }
+    metadata {
+      metadata_id: 4
+      value: "\276\357"
+    }
+  )pb";
+  ::p4::v1::PacketOut packet;
+  ASSERT_OK(ParseProtoFromString(kPacketOut, &packet));
+  EXPECT_THAT(DeparsePacketOutHeader(packet).status(),
+              StatusIs(StratumErrorSpace(), ERR_INVALID_PARAM,
+                       HasSubstr("overflows bit width 9")));
+}
+
+TEST_F(NikssPacketioManagerTest, DeparsePacketOutHeaderWithMissingMetadata) {
+  ASSERT_OK(BuildMetadataMapping());
+  ::p4::v1::PacketOut packet;
+  EXPECT_THAT(DeparsePacketOutHeader(packet).status(),
+              StatusIs(StratumErrorSpace(), ERR_INVALID_PARAM,
+                       HasSubstr("Missing metadata with Id 1")));
+}
+
+}  // namespace nikss
+}  // namespace hal
+}  // namespace stratum
@@ -0,0 +1,298 @@
+#include "stratum/hal/lib/nikss/nikss_pre_manager.h"
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include "absl/container/flat_hash_set.h"
+#include "absl/memory/memory.h"
+#include "stratum/glue/logging.h"
+#include "stratum/glue/status/status_macros.h"
+#include "stratum/lib/macros.h"
+#include "stratum/public/proto/error.pb.h"
+
+namespace stratum {
+namespace hal {
+namespace nikss {
+
+namespace {
+
+// Replicas are identified by their egress port and instance.
+using ReplicaKey = std::pair<uint32, uint32>;
+
+ReplicaKey KeyOf(const ::p4::v1::Replica& replica) {
+  return std::make_pair(replica.egress_port(), replica.instance());
+}
+
+// Checks that the replicas of an entry are unique and fit the NIKSS PRE.
+::util::Status ValidateReplicas(
+    const google::protobuf::RepeatedPtrField<::p4::v1::Replica>& replicas) {
+  absl::flat_hash_set<ReplicaKey> keys;
+  for (const auto& replica : replicas) {
+    RET_CHECK(replica.instance() <= UINT16_MAX)
+        << "Instance of Replica " << replica.ShortDebugString()
+        << " exceeds maximum value.";
+    RET_CHECK(keys.insert(KeyOf(replica)).second)
+        << "Duplicate Replica " << replica.ShortDebugString() << ".";
+  }
+
+  return ::util::OkStatus();
+}
+
+// Computes the replicas which have to be added and removed to turn the current
+// replicas into the desired ones.
+void DiffReplicas(
+    const google::protobuf::RepeatedPtrField<::p4::v1::Replica>& current,
+    const google::protobuf::RepeatedPtrField<::p4::v1::Replica>& desired,
+    std::vector<::p4::v1::Replica>* to_add,
+    std::vector<::p4::v1::Replica>* to_remove) {
+  absl::flat_hash_set<ReplicaKey> current_keys;
+  for (const auto& replica : current) current_keys.insert(KeyOf(replica));
+  absl::flat_hash_set<ReplicaKey> desired_keys;
+  for (const auto& replica : desired) {
+    desired_keys.insert(KeyOf(replica));
+    if (!current_keys.contains(KeyOf(replica))) to_add->push_back(replica);
+  }
+  for (const auto& replica : current) {
+    if (!desired_keys.contains(KeyOf(replica))) to_remove->push_back(replica);
+  }
+}
+
+// Sorts replicas by instance and port, for a stable read order.
+void SortReplicas(
+    google::protobuf::RepeatedPtrField<::p4::v1::Replica>* replicas) {
+  std::sort(replicas->begin(), replicas->end(),
+            [](const ::p4::v1::Replica& a, const ::p4::v1::Replica& b) {
+              return std::make_pair(a.instance(), a.egress_port()) <
+                     std::make_pair(b.instance(), b.egress_port());
+            });
+}
+
+}  // namespace
+
+NikssPreManager::NikssPreManager(NikssInterface* nikss_interface)
+    : nikss_interface_(ABSL_DIE_IF_NULL(nikss_interface)) {}
+
+NikssPreManager::NikssPreManager() : nikss_interface_(nullptr) {}
+
+NikssPreManager::~NikssPreManager() = default;
+
+std::unique_ptr<NikssPreManager> NikssPreManager::CreateInstance(
+    NikssInterface* nikss_interface) {
+  return absl::WrapUnique(new NikssPreManager(nikss_interface));
+}
+
+::util::Status NikssPreManager::WritePreEntry(
+    std::shared_ptr<NikssInterface::SessionInterface> session,
+    const ::p4::v1::Update::Type type, const PreEntry& entry) {
+  absl::WriterMutexLock l(&lock_);
+  switch (entry.type_case()) {
+    case PreEntry::kMulticastGroupEntry:
+      return WriteMulticastGroupEntry(session, type,
+                                      entry.multicast_group_entry());
+    case PreEntry::kCloneSessionEntry:
+      return WriteCloneSessionEntry(session, type,
+                                    entry.clone_session_entry());
+    default:
+      return MAKE_ERROR(ERR_UNIMPLEMENTED)
+             << "Unsupported PRE entry: " << entry.ShortDebugString();
+  }
+}
+
+::util::Status NikssPreManager::ReadPreEntry(
+    std::shared_ptr<NikssInterface::SessionInterface> session,
+    const PreEntry& entry, WriterInterface<PreEntry>* writer) {
+  RET_CHECK(writer) << "Writer must be non-null.";
+  absl::ReaderMutexLock l(&lock_);
+  switch (entry.type_case()) {
+    case PreEntry::kMulticastGroupEntry:
+      return ReadMulticastGroupEntry(session, entry.multicast_group_entry(),
+                                     writer);
+    case PreEntry::kCloneSessionEntry:
+      return ReadCloneSessionEntry(session, entry.clone_session_entry(),
+                                   writer);
+    default:
+      return MAKE_ERROR(ERR_UNIMPLEMENTED)
+             << "Unsupported PRE entry: " << entry.ShortDebugString();
+  }
+}
+
+::util::Status NikssPreManager::WriteMulticastGroupEntry(
+    std::shared_ptr<NikssInterface::SessionInterface> session,
+    const ::p4::v1::Update::Type type,
+    const ::p4::v1::MulticastGroupEntry& entry) {
+  VLOG(1) << ::p4::v1::Update_Type_Name(type) << " "
+          << entry.ShortDebugString();
+  const uint32 group_id = entry.multicast_group_id();
+  RET_CHECK(group_id != 0) << "Invalid group id in MulticastGroupEntry "
+                           << entry.ShortDebugString() << ".";
+  switch (type) {
+    case ::p4::v1::Update::INSERT: {
+      RETURN_IF_ERROR(ValidateReplicas(entry.replicas()));
+      RETURN_IF_ERROR(
+          nikss_interface_->InsertMulticastGroup(session, group_id));
+      for (const auto& replica : entry.replicas()) {
+        ::util::Status status = nikss_interface_->AddMulticastGroupReplica(
+            session, group_id, replica);
+        if (!status.ok()) {
+          // Do not leave a partially populated group behind.
+          APPEND_STATUS_IF_ERROR(
+              status,
+              nikss_interface_->DeleteMulticastGroup(session, group_id));
+          return status;
+        }
+      }
+      break;
+    }
+    case ::p4::v1::Update::MODIFY: {
+      RETURN_IF_ERROR(ValidateReplicas(entry.replicas()));
+      std::vector<::p4::v1::MulticastGroupEntry> current;
+      RETURN_IF_ERROR(
+          nikss_interface_->ReadMulticastGroups(session, group_id, &current));
+      RET_CHECK(current.size() == 1);
+      std::vector<::p4::v1::Replica> to_add;
+      std::vector<::p4::v1::Replica> to_remove;
+      DiffReplicas(current[0].replicas(), entry.replicas(), &to_add,
+                   &to_remove);
+      // New replicas are added first, so that the group never misses a
+      // replica which is part of both the old and the new membership.
+      for (const auto& replica : to_add) {
+        RETURN_IF_ERROR(nikss_interface_->AddMulticastGroupReplica(
+            session, group_id, replica));
+      }
+      for (const auto& replica : to_remove) {
+        RETURN_IF_ERROR(nikss_interface_->RemoveMulticastGroupReplica(
+            session, group_id, replica));
+      }
+      VLOG(1) << "Modified multicast group " << group_id << ": "
+              << to_add.size() << " replicas added, " << to_remove.size()
+              << " removed.";
+      break;
+    }
+    case ::p4::v1::Update::DELETE: {
+      LOG_IF(WARNING, entry.replicas_size() != 0)
+          << "Replicas are ignored on MulticastGroupEntry delete requests: "
+          << entry.ShortDebugString() << ".";
+      RETURN_IF_ERROR(
+          nikss_interface_->DeleteMulticastGroup(session, group_id));
+      break;
+    }
+    default:
+      return MAKE_ERROR(ERR_UNIMPLEMENTED)
+             << "Unsupported update type: " << type;
+  }
+
+  return ::util::OkStatus();
+}
+
+::util::Status NikssPreManager::WriteCloneSessionEntry(
+    std::shared_ptr<NikssInterface::SessionInterface> session,
+    const ::p4::v1::Update::Type type,
+    const ::p4::v1::CloneSessionEntry& entry) {
+  VLOG(1) << ::p4::v1::Update_Type_Name(type) << " "
+          << entry.ShortDebugString();
+  const uint32 session_id = entry.session_id();
+  RET_CHECK(session_id != 0) << "Invalid session id in CloneSessionEntry "
+                             << entry.ShortDebugString() << ".";
+  RET_CHECK(entry.class_of_service() <= UINT8_MAX)
+      << "Class of service exceeds maximum value: "
+      << entry.ShortDebugString() << ".";
+  RET_CHECK(entry.packet_length_bytes() <= UINT16_MAX)
+      << "Packet length exceeds maximum value: " << entry.ShortDebugString()
+      << ".";
+
+  switch (type) {
+    case ::p4::v1::Update::INSERT: {
+      RETURN_IF_ERROR(ValidateReplicas(entry.replicas()));
+      RETURN_IF_ERROR(
+          nikss_interface_->InsertCloneSession(session, session_id));
+      for (const auto& replica : entry.replicas()) {
+        ::util::Status status =
+            nikss_interface_->AddCloneSessionReplica(session, entry, replica);
+        if (!status.ok()) {
+          // Do not leave a partially populated session behind.
+          APPEND_STATUS_IF_ERROR(
+              status,
+              nikss_interface_->DeleteCloneSession(session, session_id));
+          return status;
+        }
+      }
+      break;
+    }
+    case ::p4::v1::Update::MODIFY: {
+      RETURN_IF_ERROR(ValidateReplicas(entry.replicas()));
+      std::vector<::p4::v1::CloneSessionEntry> current;
+      RETURN_IF_ERROR(
+          nikss_interface_->ReadCloneSessions(session, session_id, &current));
+      RET_CHECK(current.size() == 1);
+      std::vector<::p4::v1::Replica> to_add;
+      std::vector<::p4::v1::Replica> to_remove;
+      DiffReplicas(current[0].replicas(), entry.replicas(), &to_add,
+                   &to_remove);
+      // The class of service and the truncation length are stored with every
+      // replica, so all of them are updated if these change.
+      if (current[0].class_of_service() != entry.class_of_service() ||
+          current[0].packet_length_bytes() != entry.packet_length_bytes()) {
+        to_add.assign(entry.replicas().begin(), entry.replicas().end());
+      }
+      for (const auto& replica : to_add) {
+        RETURN_IF_ERROR(
+            nikss_interface_->AddCloneSessionReplica(session, entry, replica));
+      }
+      for (const auto& replica : to_remove) {
+        RETURN_IF_ERROR(nikss_interface_->RemoveCloneSessionReplica(
+            session, session_id, replica));
+      }
+      break;
+    }
+    case ::p4::v1::Update::DELETE: {
+      RETURN_IF_ERROR(
+          nikss_interface_->DeleteCloneSession(session, session_id));
+      break;
+    }
+    default:
+      return MAKE_ERROR(ERR_UNIMPLEMENTED)
+             << "Unsupported update type: " << type << " on CloneSessionEntry "
+             << entry.ShortDebugString() << ".";
+  }
+
+  return ::util::OkStatus();
+}
+
+::util::Status NikssPreManager::ReadMulticastGroupEntry(
+    std::shared_ptr<NikssInterface::SessionInterface> session,
+    const ::p4::v1::MulticastGroupEntry& entry,
+    WriterInterface<PreEntry>* writer) {
+  std::vector<::p4::v1::MulticastGroupEntry> groups;
+  RETURN_IF_ERROR(nikss_interface_->ReadMulticastGroups(
+      session, entry.multicast_group_id(), &groups));
+  PreEntry result;
+  for (auto& group : groups) {
+    SortReplicas(group.mutable_replicas());
+    result.mutable_multicast_group_entry()->Swap(&group);
+    RET_CHECK(writer->Write(result)) << "Write to stream channel failed.";
+  }
+
+  return ::util::OkStatus();
+}
+
+::util::Status NikssPreManager::ReadCloneSessionEntry(
+    std::shared_ptr<NikssInterface::SessionInterface> session,
+    const ::p4::v1::CloneSessionEntry& entry,
+    WriterInterface<PreEntry>* writer) {
+  std::vector<::p4::v1::CloneSessionEntry> clone_sessions;
+  RETURN_IF_ERROR(nikss_interface_->ReadCloneSessions(
+      session, entry.session_id(), &clone_sessions));
+  PreEntry result;
+  for (auto& clone_session : clone_sessions) {
+    SortReplicas(clone_session.mutable_replicas());
+    result.mutable_clone_session_entry()->Swap(&clone_session);
+    RET_CHECK(writer->Write(result)) << "Write to stream channel failed.";
+  }
+
+  return ::util::OkStatus();
+}
+
+}  // namespace nikss
+}  // namespace hal
+}  // namespace stratum
@@ -0,0 +1,95 @@
+#ifndef STRATUM_HAL_LIB_NIKSS_NIKSS_PRE_MANAGER_H_
+#define STRATUM_HAL_LIB_NIKSS_NIKSS_PRE_MANAGER_H_
+
+#include <memory>
+
+#include "absl/synchronization/mutex.h"
+#include "p4/v1/p4runtime.pb.h"
+#include "stratum/glue/integral_types.h"
+#include "stratum/glue/status/status.h"
+#include "stratum/hal/lib/common/writer_interface.h"
+#include "stratum/hal/lib/nikss/nikss_interface.h"
+
+namespace stratum {
+namespace hal {
+namespace nikss {
+
+using PreEntry = ::p4::v1::PacketReplicationEngineEntry;
+
+// The NikssPreManager maps the P4Runtime packet replication engine entries,
+// i.e. multicast groups and clone sessions, onto the NIKSS PRE. Modifying an
+// entry only touches the replicas which actually change, and new replicas are
+// added before stale ones are removed, so that packets keep being replicated
+// to the unchanged replicas throughout the update.
+class NikssPreManager {
+ public:
+  virtual ~NikssPreManager();
+
+  // Writes a PRE entry.
+  virtual ::util::Status WritePreEntry(
+      std::shared_ptr<NikssInterface::SessionInterface> session,
+      const ::p4::v1::Update::Type type, const PreEntry& entry)
+      LOCKS_EXCLUDED(lock_);
+
+  // Reads a PRE entry. A multicast group or clone session ID of zero selects
+  // all groups or sessions.
+  virtual ::util::Status ReadPreEntry(
+      std::shared_ptr<NikssInterface::SessionInterface> session,
+      const PreEntry& entry, WriterInterface<PreEntry>* writer)
+      LOCKS_EXCLUDED(lock_);
+
+  // Factory function for creating the instance of the class.
+  static std::unique_ptr<NikssPreManager> CreateInstance(
+      NikssInterface* nikss_interface);
+
+  // NikssPreManager is neither copyable nor movable.
+  NikssPreManager(const NikssPreManager&) = delete;
+  NikssPreManager& operator=(const NikssPreManager&) = delete;
+
+ protected:
+  // Default constructor. To be called by the Mock class instance only.
+  NikssPreManager();
+
+ private:
+  // Private constructor. Use CreateInstance() to create an instance of this
+  // class.
+  explicit NikssPreManager(NikssInterface* nikss_interface);
+
+  // Inserts, modifies or deletes a multicast group entry.
+  ::util::Status WriteMulticastGroupEntry(
+      std::shared_ptr<NikssInterface::SessionInterface> session,
+      const ::p4::v1::Update::Type type,
+      const ::p4::v1::MulticastGroupEntry& entry)
+      EXCLUSIVE_LOCKS_REQUIRED(lock_);
+
+  // Inserts, modifies or deletes a clone session entry.
+  ::util::Status WriteCloneSessionEntry(
+      std::shared_ptr<NikssInterface::SessionInterface> session,
+      const ::p4::v1::Update::Type type,
+      const ::p4::v1::CloneSessionEntry& entry) EXCLUSIVE_LOCKS_REQUIRED(lock_);
+
+  // Reads multicast group entries.
+  ::util::Status ReadMulticastGroupEntry(
+      std::shared_ptr<NikssInterface::SessionInterface> session,
+      const ::p4::v1::MulticastGroupEntry& entry,
+      WriterInterface<PreEntry>* writer) SHARED_LOCKS_REQUIRED(lock_);
+
+  // Reads clone session entries.
+  ::util::Status ReadCloneSessionEntry(
+      std::shared_ptr<NikssInterface::SessionInterface> session,
+      const ::p4::v1::CloneSessionEntry& entry,
+      WriterInterface<PreEntry>* writer) SHARED_LOCKS_REQUIRED(lock_);
+
+  // Reader-writer lock used to protect access to the PRE.
+  mutable absl::Mutex lock_;
+
+  // Pointer to a NikssInterface implementation that wraps all the SDE calls.
+  // Not owned by this class.
+  NikssInterface* nikss_interface_ = nullptr;
+};
+
+}  // namespace nikss
+}  // namespace hal
+}  // namespace stratum
+
+#endif  // STRATUM_HAL_LIB_NIKSS_NIKSS_PRE_MANAGER_H_
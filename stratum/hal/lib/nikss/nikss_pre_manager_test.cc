@@ -0,0 +1,286 @@
+#include "stratum/hal/lib/nikss/nikss_pre_manager.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/memory/memory.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "p4/v1/p4runtime.pb.h"
+#include "stratum/glue/status/status_macros.h"
+#include "stratum/glue/status/status_test_util.h"
+#include "stratum/hal/lib/common/writer_mock.h"
+#include "stratum/hal/lib/nikss/nikss_interface_mock.h"
+#include "stratum/lib/test_utils/matchers.h"
+#include "stratum/lib/utils.h"
+#include "stratum/public/lib/error.h"
+
+namespace stratum {
+namespace hal {
+namespace nikss {
+
+using test_utils::EqualsProto;
+using test_utils::StatusIs;
+using ::testing::_;
+using ::testing::DoAll;
+using ::testing::HasSubstr;
+using ::testing::InSequence;
+using ::testing::Return;
+using ::testing::SetArgPointee;
+using ::testing::StrictMock;
+
+namespace {
+
+::p4::v1::Replica MakeReplica(uint32 egress_port, uint32 instance) {
+  ::p4::v1::Replica replica;
+  replica.set_egress_port(egress_port);
+  replica.set_instance(instance);
+  return replica;
+}
+
+}  // namespace
+
+class NikssPreManagerTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    // Any NIKSS call not expected by a test is an error.
+    nikss_interface_mock_ =
+        absl::make_unique<StrictMock<NikssInterfaceMock>>();
+    session_mock_ = std::make_shared<SessionMock>();
+    nikss_pre_manager_ =
+        NikssPreManager::CreateInstance(nikss_interface_mock_.get());
+  }
+
+  // Writes the PRE entry given in text format.
+  ::util::Status WritePreEntry(::p4::v1::Update::Type type,
+                               const std::string& entry_text) {
+    PreEntry entry;
+    RETURN_IF_ERROR(ParseProtoFromString(entry_text, &entry));
+    return nikss_pre_manager_->WritePreEntry(session_mock_, type, entry);
+  }
+
+  // Makes the NIKSS multicast group kGroupId hold the given replicas.
+  void ExpectReadMulticastGroup(
+      const std::vector<::p4::v1::Replica>& replicas) {
+    std::vector<::p4::v1::MulticastGroupEntry> groups(1);
+    groups[0].set_multicast_group_id(kGroupId);
+    for (const auto& replica : replicas) *groups[0].add_replicas() = replica;
+    EXPECT_CALL(*nikss_interface_mock_, ReadMulticastGroups(_, kGroupId, _))
+        .WillOnce(DoAll(SetArgPointee<2>(groups), Return(::util::OkStatus())));
+  }
+
+  static constexpr uint32 kGroupId = 10;
+  static constexpr uint32 kSessionId = 20;
+
+  std::unique_ptr<StrictMock<NikssInterfaceMock>> nikss_interface_mock_;
+  std::shared_ptr<SessionMock> session_mock_;
+  std::unique_ptr<NikssPreManager> nikss_pre_manager_;
+};
+
+constexpr uint32 NikssPreManagerTest::kGroupId;
+constexpr uint32 NikssPreManagerTest::kSessionId;
+
+TEST_F(NikssPreManagerTest, InsertMulticastGroup) {
+  {
+    InSequence s;
+    EXPECT_CALL(*nikss_interface_mock_, InsertMulticastGroup(_, kGroupId))
+        .WillOnce(Return(::util::OkStatus()));
+    EXPECT_CALL(*nikss_interface_mock_,
+                AddMulticastGroupReplica(_, kGroupId,
+                                         EqualsProto(MakeReplica(1, 0))))
+        .WillOnce(Return(::util::OkStatus()));
+    EXPECT_CALL(*nikss_interface_mock_,
+                AddMulticastGroupReplica(_, kGroupId,
+                                         EqualsProto(MakeReplica(2, 1))))
+        .WillOnce(Return(::util::OkStatus()));
+  }
+  EXPECT_OK(WritePreEntry(::p4::v1::Update::INSERT, R"pb(
+    multicast_group_entry {
+      multicast_group_id: 10
+      replicas { egress_port: 1 instance: 0 }
+      replicas { egress_port: 2 instance: 1 }
+    }
+  )pb"));
+}
+
+TEST_F(NikssPreManagerTest, InsertMulticastGroupIsRolledBackOnError) {
+  {
+    InSequence s;
+    EXPECT_CALL(*nikss_interface_mock_, InsertMulticastGroup(_, kGroupId))
+        .WillOnce(Return(::util::OkStatus()));
+    EXPECT_CALL(*nikss_interface_mock_,
+                AddMulticastGroupReplica(_, kGroupId,
+                                         EqualsProto(MakeReplica(1, 0))))
+        .WillOnce(Return(::util::OkStatus()));
+    EXPECT_CALL(*nikss_interface_mock_,
+                AddMulticastGroupReplica(_, kGroupId,
+                                         EqualsProto(MakeReplica(2, 0))))
+        .WillOnce(Return(MAKE_ERROR(ERR_INTERNAL) << "Port 2 not found."));
+    EXPECT_CALL(*nikss_interface_mock_, DeleteMulticastGroup(_, kGroupId))
+        .WillOnce(Return(::util::OkStatus()));
+  }
+  EXPECT_THAT(WritePreEntry(::p4::v1::Update::INSERT, R"pb(
+                multicast_group_entry {
+                  multicast_group_id: 10
+                  replicas { egress_port: 1 instance: 0 }
+                  replicas { egress_port: 2 instance: 0 }
+                }
+              )pb"),
+              StatusIs(StratumErrorSpace(), ERR_INTERNAL,
+                       HasSubstr("Port 2 not found.")));
+}
+
+TEST_F(NikssPreManagerTest, InsertMulticastGroupWithDuplicateReplicas) {
+  EXPECT_THAT(WritePreEntry(::p4::v1::Update::INSERT, R"pb(
+                multicast_group_entry {
+                  multicast_group_id: 10
+                  replicas { egress_port: 1 instance: 0 }
+                  replicas { egress_port: 1 instance: 0 }
+                }
+              )pb"),
+              StatusIs(StratumErrorSpace(), ERR_INVALID_PARAM,
+                       HasSubstr("Duplicate Replica")));
+}
+
+TEST_F(NikssPreManagerTest, ModifyMulticastGroupOnlyChangesDiff) {
+  ExpectReadMulticastGroup(
+      {MakeReplica(1, 0), MakeReplica(2, 0), MakeReplica(3, 1)});
+  // The new replica is added before the stale one is removed. The unchanged
+  // replicas are not touched.
+  {
+    InSequence s;
+    EXPECT_CALL(*nikss_interface_mock_,
+                AddMulticastGroupReplica(_, kGroupId,
+                                         EqualsProto(MakeReplica(4, 0))))
+        .WillOnce(Return(::util::OkStatus()));
+    EXPECT_CALL(*nikss_interface_mock_,
+                RemoveMulticastGroupReplica(_, kGroupId,
+                                            EqualsProto(MakeReplica(1, 0))))
+        .WillOnce(Return(::util::OkStatus()));
+  }
+  EXPECT_OK(WritePreEntry(::p4::v1::Update::MODIFY, R"pb(
+    multicast_group_entry {
+      multicast_group_id: 10
+      replicas { egress_port: 3 instance: 1 }
+      replicas { egress_port: 2 instance: 0 }
+      replicas { egress_port: 4 instance: 0 }
+    }
+  )pb"));
+}
+
+TEST_F(NikssPreManagerTest, ModifyMulticastGroupWithSameReplicas) {
+  ExpectReadMulticastGroup({MakeReplica(1, 0), MakeReplica(2, 0)});
+  // Replicas are matched by port and instance, not by their order.
+  EXPECT_OK(WritePreEntry(::p4::v1::Update::MODIFY, R"pb(
+    multicast_group_entry {
+      multicast_group_id: 10
+      replicas { egress_port: 2 instance: 0 }
+      replicas { egress_port: 1 instance: 0 }
+    }
+  )pb"));
+}
+
+TEST_F(NikssPreManagerTest, DeleteMulticastGroup) {
+  EXPECT_CALL(*nikss_interface_mock_, DeleteMulticastGroup(_, kGroupId))
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_OK(WritePreEntry(::p4::v1::Update::DELETE, R"pb(
+    multicast_group_entry { multicast_group_id: 10 }
+  )pb"));
+}
+
+TEST_F(NikssPreManagerTest, ModifyCloneSessionOnlyChangesDiff) {
+  const char kCloneSession[] = R"pb(
+    clone_session_entry {
+      session_id: 20
+      class_of_service: 1
+      replicas { egress_port: 1 instance: 0 }
+      replicas { egress_port: 2 instance: 0 }
+    }
+  )pb";
+  PreEntry current;
+  ASSERT_OK(ParseProtoFromString(kCloneSession, &current));
+  std::vector<::p4::v1::CloneSessionEntry> sessions = {
+      current.clone_session_entry()};
+  EXPECT_CALL(*nikss_interface_mock_, ReadCloneSessions(_, kSessionId, _))
+      .WillOnce(DoAll(SetArgPointee<2>(sessions), Return(::util::OkStatus())));
+  {
+    InSequence s;
+    EXPECT_CALL(*nikss_interface_mock_,
+                AddCloneSessionReplica(_, _, EqualsProto(MakeReplica(3, 0))))
+        .WillOnce(Return(::util::OkStatus()));
+    EXPECT_CALL(*nikss_interface_mock_,
+                RemoveCloneSessionReplica(_, kSessionId,
+                                          EqualsProto(MakeReplica(1, 0))))
+        .WillOnce(Return(::util::OkStatus()));
+  }
+  EXPECT_OK(WritePreEntry(::p4::v1::Update::MODIFY, R"pb(
+    clone_session_entry {
+      session_id: 20
+      class_of_service: 1
+      replicas { egress_port: 2 instance: 0 }
+      replicas { egress_port: 3 instance: 0 }
+    }
+  )pb"));
+}
+
+TEST_F(NikssPreManagerTest, ModifyCloneSessionClassOfServiceRewritesAll) {
+  const char kCloneSession[] = R"pb(
+    clone_session_entry {
+      session_id: 20
+      class_of_service: 1
+      replicas { egress_port: 1 instance: 0 }
+      replicas { egress_port: 2 instance: 0 }
+    }
+  )pb";
+  PreEntry current;
+  ASSERT_OK(ParseProtoFromString(kCloneSession, &current));
+  std::vector<::p4::v1::CloneSessionEntry> sessions = {
+      current.clone_session_entry()};
+  EXPECT_CALL(*nikss_interface_mock_, ReadCloneSessions(_, kSessionId, _))
+      .WillOnce(DoAll(SetArgPointee<2>(sessions), Return(::util::OkStatus())));
+  // The class of service is stored per replica, so the kept replica is
+  // written again along with the new one.
+  EXPECT_CALL(*nikss_interface_mock_,
+              AddCloneSessionReplica(_, _, EqualsProto(MakeReplica(2, 0))))
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_CALL(*nikss_interface_mock_,
+              AddCloneSessionReplica(_, _, EqualsProto(MakeReplica(3, 0))))
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_CALL(*nikss_interface_mock_,
+              RemoveCloneSessionReplica(_, kSessionId,
+                                        EqualsProto(MakeReplica(1, 0))))
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_OK(WritePreEntry(::p4::v1::Update::MODIFY, R"pb(
+    clone_session_entry {
+      session_id: 20
+      class_of_service: 2
+      replicas { egress_port: 2 instance: 0 }
+      replicas { egress_port: 3 instance: 0 }
+    }
+  )pb"));
+}
+
+TEST_F(NikssPreManagerTest, ReadMulticastGroupSortsReplicas) {
+  ExpectReadMulticastGroup(
+      {MakeReplica(2, 1), MakeReplica(3, 0), MakeReplica(1, 1)});
+  PreEntry expected;
+  ASSERT_OK(ParseProtoFromString(R"pb(
+    multicast_group_entry {
+      multicast_group_id: 10
+      replicas { egress_port: 3 instance: 0 }
+      replicas { egress_port: 1 instance: 1 }
+      replicas { egress_port: 2 instance: 1 }
+    }
+  )pb", &expected));
+  WriterMock<PreEntry> writer;
+  EXPECT_CALL(writer, Write(EqualsProto(expected))).WillOnce(Return(true));
+
+  PreEntry entry;
+  entry.mutable_multicast_group_entry()->set_multicast_group_id(kGroupId);
+  EXPECT_OK(nikss_pre_manager_->ReadPreEntry(session_mock_, entry, &writer));
+}
+
+}  // namespace nikss
+}  // namespace hal
+}  // namespace stratum
@@ -2,7 +2,10 @@
 
 #include "absl/memory/memory.h"
 #include "absl/synchronization/mutex.h"
+#include "stratum/glue/gtl/map_util.h"
+#include "stratum/glue/status/status_macros.h"
 #include "stratum/hal/lib/nikss/nikss_node.h"
+#include "stratum/lib/macros.h"
 
 #include <nikss/nikss.h>
 
@@ -25,16 +28,24 @@ NikssSwitch::NikssSwitch(PhalInterface* phal_interface,
 NikssSwitch::~NikssSwitch() {}
 
 ::util::Status NikssSwitch::PushChassisConfig(const ChassisConfig& config) {
+  absl::WriterMutexLock l(&chassis_lock);
+  RETURN_IF_ERROR(phal_interface_->PushChassisConfig(config));
+  RETURN_IF_ERROR(nikss_chassis_manager_->PushChassisConfig(config));
   return ::util::OkStatus();
 }
 
 ::util::Status NikssSwitch::VerifyChassisConfig(const ChassisConfig& config) {
-  return ::util::OkStatus();
+  absl::ReaderMutexLock l(&chassis_lock);
+  ::util::Status status = ::util::OkStatus();
+  APPEND_STATUS_IF_ERROR(status, phal_interface_->VerifyChassisConfig(config));
+  APPEND_STATUS_IF_ERROR(status,
+                         nikss_chassis_manager_->VerifyChassisConfig(config));
+  return status;
 }
 
 ::util::Status NikssSwitch::PushForwardingPipelineConfig(
     uint64 node_id, const ::p4::v1::ForwardingPipelineConfig& config) {
-
+  absl::WriterMutexLock l(&chassis_lock);
   LOG(INFO) << "Pushing P4-based forwarding pipeline to NIKSS";
 
   ASSIGN_OR_RETURN(auto* node, GetNikssNodeFromNodeId(node_id));
@@ -48,20 +59,48 @@ NikssSwitch::~NikssSwitch() {}
 
 ::util::Status NikssSwitch::SaveForwardingPipelineConfig(
     uint64 node_id, const ::p4::v1::ForwardingPipelineConfig& config) {
+  absl::WriterMutexLock l(&chassis_lock);
+  ASSIGN_OR_RETURN(auto* node, GetNikssNodeFromNodeId(node_id));
+  RETURN_IF_ERROR(node->SaveForwardingPipelineConfig(config));
+
+  LOG(INFO) << "P4-based forwarding pipeline config saved successfully to "
+            << "node with ID " << node_id << ".";
+
   return ::util::OkStatus();
 }
 
 ::util::Status NikssSwitch::CommitForwardingPipelineConfig(uint64 node_id) {
+  absl::WriterMutexLock l(&chassis_lock);
+  ASSIGN_OR_RETURN(auto* node, GetNikssNodeFromNodeId(node_id));
+  RETURN_IF_ERROR(node->CommitForwardingPipelineConfig());
+
+  LOG(INFO) << "P4-based forwarding pipeline config committed successfully to "
+            << "node with ID " << node_id << ".";
+
   return ::util::OkStatus();
 }
 
 ::util::Status NikssSwitch::VerifyForwardingPipelineConfig(
     uint64 node_id, const ::p4::v1::ForwardingPipelineConfig& config) {
+  absl::WriterMutexLock l(&chassis_lock);
+  ASSIGN_OR_RETURN(auto* node, GetNikssNodeFromNodeId(node_id));
+  RETURN_IF_ERROR(node->VerifyForwardingPipelineConfig(config));
+
+  LOG(INFO) << "P4-based forwarding pipeline config verified successfully for "
+            << "node with ID " << node_id << ".";
+
   return ::util::OkStatus();
 }
 
 ::util::Status NikssSwitch::Shutdown() {
-  return ::util::OkStatus();
+  ::util::Status status = ::util::OkStatus();
+  for (const auto& entry : node_id_to_nikss_node_) {
+    NikssNode* node = entry.second;
+    APPEND_STATUS_IF_ERROR(status, node->Shutdown());
+  }
+  APPEND_STATUS_IF_ERROR(status, nikss_chassis_manager_->Shutdown());
+
+  return status;
 }
 
 ::util::Status NikssSwitch::Freeze() { return ::util::OkStatus(); }
@@ -70,45 +109,105 @@ NikssSwitch::~NikssSwitch() {}
 
 ::util::Status NikssSwitch::WriteForwardingEntries(
     const ::p4::v1::WriteRequest& req, std::vector<::util::Status>* results) {
-  return ::util::OkStatus();
+  if (!req.updates_size()) return ::util::OkStatus();  // nothing to do.
+  RET_CHECK(req.device_id()) << "No device_id in WriteRequest.";
+  RET_CHECK(results != nullptr)
+      << "Need to provide non-null results pointer for non-empty updates.";
+
+  absl::ReaderMutexLock l(&chassis_lock);
+  ASSIGN_OR_RETURN(auto* node, GetNikssNodeFromNodeId(req.device_id()));
+  return node->WriteForwardingEntries(req, results);
 }
 
 ::util::Status NikssSwitch::ReadForwardingEntries(
     const ::p4::v1::ReadRequest& req,
     WriterInterface<::p4::v1::ReadResponse>* writer,
     std::vector<::util::Status>* details) {
-  return ::util::OkStatus();
+  RET_CHECK(req.device_id()) << "No device_id in ReadRequest.";
+  RET_CHECK(writer) << "Channel writer must be non-null.";
+  RET_CHECK(details) << "Details pointer must be non-null.";
+
+  absl::ReaderMutexLock l(&chassis_lock);
+  ASSIGN_OR_RETURN(auto* node, GetNikssNodeFromNodeId(req.device_id()));
+  return node->ReadForwardingEntries(req, writer, details);
 }
 
 ::util::Status NikssSwitch::RegisterStreamMessageResponseWriter(
     uint64 node_id,
     std::shared_ptr<WriterInterface<::p4::v1::StreamMessageResponse>> writer) {
-  return ::util::OkStatus();
+  ASSIGN_OR_RETURN(auto* node, GetNikssNodeFromNodeId(node_id));
+  return node->RegisterStreamMessageResponseWriter(writer);
 }
 
 ::util::Status NikssSwitch::UnregisterStreamMessageResponseWriter(
     uint64 node_id) {
-  return ::util::OkStatus();
+  ASSIGN_OR_RETURN(auto* node, GetNikssNodeFromNodeId(node_id));
+  return node->UnregisterStreamMessageResponseWriter();
 }
 
 ::util::Status NikssSwitch::HandleStreamMessageRequest(
     uint64 node_id, const ::p4::v1::StreamMessageRequest& request) {
-  return ::util::OkStatus();
+  ASSIGN_OR_RETURN(auto* node, GetNikssNodeFromNodeId(node_id));
+  return node->HandleStreamMessageRequest(request);
 }
 
 ::util::Status NikssSwitch::RegisterEventNotifyWriter(
     std::shared_ptr<WriterInterface<GnmiEventPtr>> writer) {
-  return ::util::OkStatus();
+  return nikss_chassis_manager_->RegisterEventNotifyWriter(writer);
 }
 
 ::util::Status NikssSwitch::UnregisterEventNotifyWriter() {
-  return ::util::OkStatus();
+  return nikss_chassis_manager_->UnregisterEventNotifyWriter();
 }
 
 ::util::Status NikssSwitch::RetrieveValue(uint64 /*node_id*/,
                                          const DataRequest& request,
                                          WriterInterface<DataResponse>* writer,
                                          std::vector<::util::Status>* details) {
+  absl::ReaderMutexLock l(&chassis_lock);
+  for (const auto& req : request.requests()) {
+    ::util::StatusOr<DataResponse> resp;
+    switch (req.request_case()) {
+      case DataRequest::Request::kOperStatus:
+      case DataRequest::Request::kAdminStatus:
+      case DataRequest::Request::kMacAddress:
+      case DataRequest::Request::kPortSpeed:
+      case DataRequest::Request::kNegotiatedPortSpeed:
+      case DataRequest::Request::kLacpRouterMac:
+      case DataRequest::Request::kPortCounters:
+      case DataRequest::Request::kForwardingViability:
+      case DataRequest::Request::kHealthIndicator:
+      case DataRequest::Request::kAutonegStatus:
+      case DataRequest::Request::kSdnPortId:
+        resp = nikss_chassis_manager_->GetPortData(req);
+        break;
+      case DataRequest::Request::kNodePacketioDebugInfo: {
+        auto node_or =
+            GetNikssNodeFromNodeId(req.node_packetio_debug_info().node_id());
+        if (!node_or.ok()) {
+          resp = node_or.status();
+          break;
+        }
+        DataResponse data;
+        data.mutable_node_packetio_debug_info()->set_debug_string(
+            node_or.ValueOrDie()->DumpPacketIoStats());
+        resp = data;
+        break;
+      }
+      default:
+        resp =
+            MAKE_ERROR(ERR_UNIMPLEMENTED)
+            << "DataRequest field "
+            << req.descriptor()->FindFieldByNumber(req.request_case())->name()
+            << " is not supported yet: " << req.ShortDebugString() << ".";
+        break;
+    }
+    if (resp.ok()) {
+      // If everything is OK send it to the caller.
+      writer->Write(resp.ValueOrDie());
+    }
+    if (details) details->push_back(resp.status());
+  }
   return ::util::OkStatus();
 }
 
@@ -138,6 +237,6 @@ std::unique_ptr<NikssSwitch> NikssSwitch::CreateInstance(
   return node;
 }
 
-}  // namespace bmv2
-}  // namespace hal
 }  // namespace nikss
+}  // namespace hal
+}  // namespace stratum
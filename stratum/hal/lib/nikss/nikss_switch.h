@@ -17,15 +17,16 @@ class NikssSwitch : public SwitchInterface {
   ::util::Status PushChassisConfig(const ChassisConfig& config) override;
   ::util::Status VerifyChassisConfig(const ChassisConfig& config) override;
   ::util::Status PushForwardingPipelineConfig(
-      uint64 node_id,
-      const ::p4::v1::ForwardingPipelineConfig& config) override;
+      uint64 node_id, const ::p4::v1::ForwardingPipelineConfig& config) override
+      LOCKS_EXCLUDED(chassis_lock);
   ::util::Status SaveForwardingPipelineConfig(
-      uint64 node_id,
-      const ::p4::v1::ForwardingPipelineConfig& config) override;
-  ::util::Status CommitForwardingPipelineConfig(uint64 node_id) override;
+      uint64 node_id, const ::p4::v1::ForwardingPipelineConfig& config) override
+      LOCKS_EXCLUDED(chassis_lock);
+  ::util::Status CommitForwardingPipelineConfig(uint64 node_id) override
+      LOCKS_EXCLUDED(chassis_lock);
   ::util::Status VerifyForwardingPipelineConfig(
-      uint64 node_id,
-      const ::p4::v1::ForwardingPipelineConfig& config) override;
+      uint64 node_id, const ::p4::v1::ForwardingPipelineConfig& config) override
+      LOCKS_EXCLUDED(chassis_lock);
   ::util::Status Shutdown() override;
   ::util::Status Freeze() override;
   ::util::Status Unfreeze() override;
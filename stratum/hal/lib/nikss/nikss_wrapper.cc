@@ -1,5 +1,13 @@
 #include "stratum/hal/lib/nikss/nikss_wrapper.h"
 
+#include <errno.h>
+#include <linux/bpf.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
 #include <memory>
 #include <set>
 #include <utility>
@@ -7,9 +15,17 @@
 #include <string>
 #include <iostream>
 
+#include "absl/cleanup/cleanup.h"
 #include "absl/memory/memory.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_replace.h"
 #include "absl/synchronization/mutex.h"
+#include "stratum/glue/gtl/map_util.h"
 #include "stratum/glue/status/status.h"
+#include "stratum/hal/lib/nikss/array_map_snapshot.h"
+#include "stratum/hal/lib/nikss/value_set_diff.h"
+#include "stratum/hal/lib/p4/utils.h"
 #include "stratum/lib/utils.h"
 #include "stratum/lib/macros.h"
 
@@ -17,14 +33,14 @@
 #include <nikss/nikss_pipeline.h>
 
 // A macro for simplify checking the return value of NIKSS API.
-// For now, we always return ERR_INTERNAL.
+// The NIKSS return code (an errno value) is mapped to a Stratum error code.
 #define RETURN_IF_NIKSS_ERROR(expr)                                               \
   do {                                                                            \
     /* Using _status below to avoid capture problems if expr is "status". */      \
     const int __ret = (expr);                                                     \
     if (__ret != 0) {                                                             \
-      return MAKE_ERROR(ERR_INTERNAL) << "Return Error: "                         \
-                                      << #expr << " failed with code " << __ret;  \
+      return MAKE_ERROR(NikssErrorToErrorCode(__ret))                             \
+             << "Return Error: " << #expr << " failed with code " << __ret;      \
     }                                                                             \
   } while (0)
 
@@ -36,26 +52,2200 @@ namespace nikss {
 NikssWrapper* NikssWrapper::singleton_ = nullptr;
 ABSL_CONST_INIT absl::Mutex NikssWrapper::init_lock_(absl::kConstInit);
 
+namespace {
+
+// Maps a NIKSS return code to the closest Stratum error code.
+ErrorCode NikssErrorToErrorCode(int ret) {
+  switch (ret) {
+    case EEXIST:
+      return ERR_ENTRY_EXISTS;
+    case ENOENT:
+      return ERR_ENTRY_NOT_FOUND;
+    case EINVAL:
+      return ERR_INVALID_PARAM;
+    case ENOSPC:
+    case E2BIG:
+      return ERR_TABLE_FULL;
+    case ENOMEM:
+      return ERR_NO_RESOURCE;
+    case EOPNOTSUPP:
+      return ERR_OPER_NOT_SUPPORTED;
+    default:
+      return ERR_INTERNAL;
+  }
+}
+
+// NIKSS names the BPF maps after the fully qualified P4 object name with the
+// dots replaced by underscores, e.g. "ingress.tbl_fwd" becomes
+// "ingress_tbl_fwd".
+std::string P4NameToNikssName(const std::string& p4_name) {
+  return absl::StrReplaceAll(p4_name, {{".", "_"}});
+}
+
+// Converts a P4Runtime byte string into the layout NIKSS expects. The eBPF
+// backend stores fields up to 64 bits as host-order integers and wider fields
+// as byte arrays in network order.
+std::string P4RuntimeByteStringToNikssData(const std::string& value,
+                                           int bitwidth) {
+  std::string data =
+      P4RuntimeByteStringToPaddedByteString(value, (bitwidth + 7) / 8);
+  if (bitwidth <= 64) std::reverse(data.begin(), data.end());
+  return data;
+}
+
+// Converts data read from NIKSS back into a canonical P4Runtime byte string.
+std::string NikssDataToP4RuntimeByteString(const void* data, size_t size,
+                                           int bitwidth) {
+  std::string bytes(static_cast<const char*>(data), size);
+  if (bitwidth <= 64) std::reverse(bytes.begin(), bytes.end());
+  return ByteStringToP4RuntimeByteString(
+      P4RuntimeByteStringToPaddedByteString(bytes, (bitwidth + 7) / 8));
+}
+
+// Returns true if the byte string is all zeros, i.e. a wildcard mask.
+bool IsAllZeros(const std::string& bytes) {
+  return bytes.find_first_not_of('\x00') == std::string::npos;
+}
+
+::util::Status BuildMatchKey(const ::p4::config::v1::MatchField& match_field,
+                             const ::p4::v1::FieldMatch* field_match,
+                             nikss_match_key_t* mk) {
+  const int bitwidth = match_field.bitwidth();
+  switch (match_field.match_type()) {
+    case ::p4::config::v1::MatchField::EXACT: {
+      RET_CHECK(field_match && field_match->has_exact())
+          << "Missing exact match field " << match_field.name() << ".";
+      std::string data =
+          P4RuntimeByteStringToNikssData(field_match->exact().value(), bitwidth);
+      nikss_matchkey_type(mk, NIKSS_EXACT);
+      RETURN_IF_NIKSS_ERROR(nikss_matchkey_data(mk, data.data(), data.size()));
+      break;
+    }
+    case ::p4::config::v1::MatchField::LPM: {
+      // A missing LPM field is a wildcard, i.e. a prefix of length zero.
+      std::string data = P4RuntimeByteStringToNikssData(
+          field_match ? field_match->lpm().value() : "", bitwidth);
+      nikss_matchkey_type(mk, NIKSS_LPM);
+      RETURN_IF_NIKSS_ERROR(nikss_matchkey_data(mk, data.data(), data.size()));
+      RETURN_IF_NIKSS_ERROR(nikss_matchkey_prefix_len(
+          mk, field_match ? field_match->lpm().prefix_len() : 0));
+      break;
+    }
+    case ::p4::config::v1::MatchField::TERNARY: {
+      // A missing ternary field is a wildcard, i.e. an all-zero mask.
+      std::string data = P4RuntimeByteStringToNikssData(
+          field_match ? field_match->ternary().value() : "", bitwidth);
+      std::string mask = P4RuntimeByteStringToNikssData(
+          field_match ? field_match->ternary().mask() : "", bitwidth);
+      nikss_matchkey_type(mk, NIKSS_TERNARY);
+      RETURN_IF_NIKSS_ERROR(nikss_matchkey_data(mk, data.data(), data.size()));
+      RETURN_IF_NIKSS_ERROR(nikss_matchkey_mask(mk, mask.data(), mask.size()));
+      break;
+    }
+    default:
+      return MAKE_ERROR(ERR_UNIMPLEMENTED)
+             << "Match type "
+             << ::p4::config::v1::MatchField::MatchType_Name(
+                    match_field.match_type())
+             << " of field " << match_field.name() << " is not supported.";
+  }
+  return ::util::OkStatus();
+}
+
+::util::Status BuildTableKey(const ::p4::config::v1::Table& table,
+                             const ::p4::v1::TableEntry& table_entry,
+                             nikss_table_entry_t* entry) {
+  // NIKSS expects all key fields in the P4Info order.
+  for (const auto& match_field : table.match_fields()) {
+    const ::p4::v1::FieldMatch* field_match = nullptr;
+    for (const auto& match : table_entry.match()) {
+      if (match.field_id() == match_field.id()) {
+        field_match = &match;
+        break;
+      }
+    }
+    nikss_match_key_t mk;
+    nikss_matchkey_init(&mk);
+    auto mk_cleanup = absl::MakeCleanup([&mk]() { nikss_matchkey_free(&mk); });
+    RETURN_IF_ERROR(BuildMatchKey(match_field, field_match, &mk));
+    RETURN_IF_NIKSS_ERROR(nikss_table_entry_matchkey(entry, &mk));
+  }
+  if (table_entry.priority()) {
+    nikss_table_entry_priority(entry, table_entry.priority());
+  }
+  return ::util::OkStatus();
+}
+
+// Adds the parameters of a P4Runtime action to a NIKSS action, in the P4Info
+// order.
+::util::Status BuildActionParams(const ::p4::config::v1::Action& action_info,
+                                 const ::p4::v1::Action& action,
+                                 nikss_action_t* nikss_action) {
+  for (const auto& param_info : action_info.params()) {
+    const ::p4::v1::Action::Param* param = nullptr;
+    for (const auto& p : action.params()) {
+      if (p.param_id() == param_info.id()) {
+        param = &p;
+        break;
+      }
+    }
+    RET_CHECK(param) << "Missing parameter " << param_info.name()
+                     << " of action " << action_info.preamble().name() << ".";
+    std::string data =
+        P4RuntimeByteStringToNikssData(param->value(), param_info.bitwidth());
+    nikss_action_param_t nikss_param;
+    RETURN_IF_NIKSS_ERROR(
+        nikss_action_param_create(&nikss_param, data.data(), data.size()));
+    // The action takes over the ownership of the parameter.
+    RETURN_IF_NIKSS_ERROR(nikss_action_param(nikss_action, &nikss_param));
+  }
+  return ::util::OkStatus();
+}
+
+::util::Status BuildTableAction(nikss_table_entry_ctx_t* table_ctx,
+                                const ::p4::config::v1::Action& action_info,
+                                const ::p4::v1::Action& action,
+                                nikss_action_t* nikss_action) {
+  // NIKSS numbers the actions of each table on its own, independent of the
+  // P4Info IDs. An unknown action is rejected by NIKSS on write.
+  nikss_action_set_id(nikss_action,
+                      nikss_table_get_action_id_by_name(
+                          table_ctx, action_info.preamble().name().c_str()));
+  return BuildActionParams(action_info, action, nikss_action);
+}
+
+// Builds the action of a table entry which refers to a member or a group of
+// an action selector. NIKSS passes the reference as the only parameter.
+::util::Status BuildIndirectTableAction(const ::p4::v1::TableAction& action,
+                                        nikss_action_t* nikss_action) {
+  uint32 reference;
+  switch (action.type_case()) {
+    case ::p4::v1::TableAction::kActionProfileMemberId:
+      reference = action.action_profile_member_id();
+      break;
+    case ::p4::v1::TableAction::kActionProfileGroupId:
+      reference = action.action_profile_group_id();
+      break;
+    default:
+      return MAKE_ERROR(ERR_INVALID_PARAM)
+             << "Table action " << action.ShortDebugString()
+             << " is not a member or group of an action selector.";
+  }
+  nikss_action_param_t nikss_param;
+  RETURN_IF_NIKSS_ERROR(
+      nikss_action_param_create(&nikss_param, &reference, sizeof(reference)));
+  if (action.type_case() == ::p4::v1::TableAction::kActionProfileGroupId) {
+    nikss_action_param_mark_group_reference(&nikss_param);
+  }
+  RETURN_IF_NIKSS_ERROR(nikss_action_param(nikss_action, &nikss_param));
+  return ::util::OkStatus();
+}
+
+// Returns the NIKSS name of the action selector implementing the given action
+// profile. Action profiles without selector are not supported by NIKSS.
+::util::StatusOr<std::string> ActionSelectorName(
+    const ::p4::config::v1::ActionProfile& action_profile) {
+  if (!action_profile.with_selector()) {
+    return MAKE_ERROR(ERR_UNIMPLEMENTED)
+           << "Action profile " << action_profile.preamble().name()
+           << " without selector is not supported.";
+  }
+  return P4NameToNikssName(action_profile.preamble().name());
+}
+
+// Sets the action of an action selector member. Like tables, action selectors
+// number their actions on their own.
+::util::Status BuildSelectorMember(
+    nikss_action_selector_context_t* selector_ctx,
+    const ::p4::config::v1::Action& action_info, const ::p4::v1::Action& action,
+    nikss_action_selector_member_context_t* member) {
+  nikss_action_t nikss_action;
+  nikss_action_init(&nikss_action);
+  auto action_cleanup =
+      absl::MakeCleanup([&nikss_action]() { nikss_action_free(&nikss_action); });
+  nikss_action_set_id(&nikss_action,
+                      nikss_action_selector_get_action_id_by_name(
+                          selector_ctx, action_info.preamble().name().c_str()));
+  RETURN_IF_ERROR(BuildActionParams(action_info, action, &nikss_action));
+  RETURN_IF_NIKSS_ERROR(
+      nikss_action_selector_member_action(member, &nikss_action));
+  return ::util::OkStatus();
+}
+
+// Translates a NIKSS match key into a P4Runtime field match and appends it to
+// the given match fields. Wildcards are omitted, as in P4Runtime entries.
+::util::Status AppendP4FieldMatch(
+    nikss_match_key_t* mk, const ::p4::config::v1::MatchField& match_field,
+    ::google::protobuf::RepeatedPtrField<::p4::v1::FieldMatch>* matches) {
+  const int bitwidth = match_field.bitwidth();
+  std::string value = NikssDataToP4RuntimeByteString(
+      nikss_matchkey_get_data(mk), nikss_matchkey_get_data_size(mk), bitwidth);
+  switch (nikss_matchkey_get_type(mk)) {
+    case NIKSS_EXACT: {
+      auto* field_match = matches->Add();
+      field_match->set_field_id(match_field.id());
+      field_match->mutable_exact()->set_value(value);
+      break;
+    }
+    case NIKSS_LPM: {
+      const uint32 prefix_len = nikss_matchkey_get_prefix_len(mk);
+      if (prefix_len == 0) break;
+      auto* field_match = matches->Add();
+      field_match->set_field_id(match_field.id());
+      field_match->mutable_lpm()->set_value(value);
+      field_match->mutable_lpm()->set_prefix_len(prefix_len);
+      break;
+    }
+    case NIKSS_TERNARY: {
+      std::string mask = NikssDataToP4RuntimeByteString(
+          nikss_matchkey_get_mask(mk), nikss_matchkey_get_mask_size(mk),
+          bitwidth);
+      if (IsAllZeros(mask)) break;
+      auto* field_match = matches->Add();
+      field_match->set_field_id(match_field.id());
+      field_match->mutable_ternary()->set_value(value);
+      field_match->mutable_ternary()->set_mask(mask);
+      break;
+    }
+    default:
+      return MAKE_ERROR(ERR_UNIMPLEMENTED)
+             << "Unsupported match type of field " << match_field.name() << ".";
+  }
+  return ::util::OkStatus();
+}
+
+// Translates the key of a NIKSS table entry into the match fields and the
+// priority of a P4Runtime table entry.
+::util::Status BuildP4TableKey(nikss_table_entry_t* entry,
+                               const ::p4::config::v1::Table& table,
+                               ::p4::v1::TableEntry* result) {
+  result->set_table_id(table.preamble().id());
+  int field_index = 0;
+  nikss_match_key_t* mk;
+  while ((mk = nikss_table_entry_get_next_matchkey(entry)) != nullptr) {
+    auto mk_cleanup = absl::MakeCleanup([mk]() { nikss_matchkey_free(mk); });
+    RET_CHECK(field_index < table.match_fields_size())
+        << "NIKSS entry of table " << table.preamble().name()
+        << " has more key fields than the P4Info.";
+    RETURN_IF_ERROR(AppendP4FieldMatch(
+        mk, table.match_fields(field_index++), result->mutable_match()));
+  }
+  const uint32 priority = nikss_table_entry_get_priority(entry);
+  if (priority) result->set_priority(priority);
+
+  return ::util::OkStatus();
+}
+
+// Translates a NIKSS table entry into a P4Runtime table entry. The key is
+// translated only if read_key is set, as NIKSS does not return the key of
+// default entries.
+::util::Status BuildP4TableEntry(
+    nikss_table_entry_t* entry, const ::p4::config::v1::Table& table,
+    const absl::flat_hash_map<uint32, const ::p4::config::v1::Action*>&
+        nikss_id_to_action,
+    bool read_key, ::p4::v1::TableEntry* result) {
+  result->set_table_id(table.preamble().id());
+  if (read_key) {
+    RETURN_IF_ERROR(BuildP4TableKey(entry, table, result));
+  } else {
+    result->set_is_default_action(true);
+  }
+
+  if (table.implementation_id()) {
+    // Entries of tables with an action selector refer to a member or group.
+    nikss_action_param_t* param = nikss_action_param_get_next(entry);
+    RET_CHECK(param) << "NIKSS entry of table " << table.preamble().name()
+                     << " has no member or group reference.";
+    auto param_cleanup =
+        absl::MakeCleanup([param]() { nikss_action_param_free(param); });
+    uint32 reference = 0;
+    RET_CHECK(nikss_action_param_get_data_len(param) == sizeof(reference));
+    std::memcpy(&reference, nikss_action_param_get_data(param),
+                sizeof(reference));
+    if (nikss_action_param_is_group_reference(param)) {
+      result->mutable_action()->set_action_profile_group_id(reference);
+    } else {
+      result->mutable_action()->set_action_profile_member_id(reference);
+    }
+    return ::util::OkStatus();
+  }
+
+  const uint32 nikss_action_id = nikss_table_entry_get_action_id(entry);
+  const auto* action_info =
+      gtl::FindPtrOrNull(nikss_id_to_action, nikss_action_id);
+  RET_CHECK(action_info) << "Unknown NIKSS action ID " << nikss_action_id
+                         << " in table " << table.preamble().name() << ".";
+  auto* action = result->mutable_action()->mutable_action();
+  action->set_action_id(action_info->preamble().id());
+  int param_index = 0;
+  nikss_action_param_t* param;
+  while ((param = nikss_action_param_get_next(entry)) != nullptr) {
+    auto param_cleanup =
+        absl::MakeCleanup([param]() { nikss_action_param_free(param); });
+    RET_CHECK(param_index < action_info->params_size())
+        << "NIKSS action " << action_info->preamble().name()
+        << " has more parameters than the P4Info.";
+    const auto& param_info = action_info->params(param_index++);
+    auto* p4_param = action->add_params();
+    p4_param->set_param_id(param_info.id());
+    p4_param->set_value(NikssDataToP4RuntimeByteString(
+        nikss_action_param_get_data(param),
+        nikss_action_param_get_data_len(param), param_info.bitwidth()));
+  }
+
+  return ::util::OkStatus();
+}
+
+// Copies the values of a NIKSS counter entry into P4Runtime counter data,
+// according to the unit of the counter.
+void NikssCounterToCounterData(nikss_counter_entry_t* entry,
+                               ::p4::config::v1::CounterSpec::Unit unit,
+                               ::p4::v1::CounterData* data) {
+  if (unit == ::p4::config::v1::CounterSpec::BYTES ||
+      unit == ::p4::config::v1::CounterSpec::BOTH) {
+    data->set_byte_count(nikss_counter_entry_get_bytes(entry));
+  }
+  if (unit == ::p4::config::v1::CounterSpec::PACKETS ||
+      unit == ::p4::config::v1::CounterSpec::BOTH) {
+    data->set_packet_count(nikss_counter_entry_get_packets(entry));
+  }
+}
+
+void CounterDataToNikssCounter(const ::p4::v1::CounterData& data,
+                               nikss_counter_entry_t* entry) {
+  nikss_counter_entry_set_bytes(entry, data.byte_count());
+  nikss_counter_entry_set_packets(entry, data.packet_count());
+}
+
+// Returns the NIKSS direct counter context of the given table entry which
+// belongs to the P4 direct counter. NIKSS names direct counters after the
+// counter instance, which is the last component of the P4 name.
+::util::StatusOr<nikss_direct_counter_context_t*> FindDirectCounter(
+    nikss_table_entry_ctx_t* table_ctx, nikss_table_entry_t* entry,
+    const ::p4::config::v1::DirectCounter& direct_counter) {
+  const std::string& p4_name = direct_counter.preamble().name();
+  const std::string instance_name = p4_name.substr(p4_name.rfind('.') + 1);
+  nikss_direct_counter_context_t* dc_ctx;
+  while ((dc_ctx = nikss_direct_counter_get_next_ctx(table_ctx, entry)) !=
+         nullptr) {
+    const std::string name = nikss_direct_counter_get_name(dc_ctx);
+    if (name == instance_name || name == P4NameToNikssName(p4_name)) {
+      return dc_ctx;
+    }
+  }
+  return MAKE_ERROR(ERR_ENTRY_NOT_FOUND)
+         << "Direct counter " << p4_name << " not found in NIKSS table.";
+}
+
+// Copies a P4Runtime meter configuration into a NIKSS meter entry. Like
+// P4Runtime, NIKSS takes the rates in units (bytes or packets) per second and
+// the burst sizes in units.
+::util::Status MeterConfigToNikssMeter(const ::p4::v1::MeterConfig& config,
+                                       nikss_meter_entry_t* entry) {
+  RET_CHECK(config.cir() >= 0 && config.cburst() >= 0 && config.pir() >= 0 &&
+            config.pburst() >= 0)
+      << "Meter rates and burst sizes must not be negative, got "
+      << config.ShortDebugString() << ".";
+  RET_CHECK(config.pir() >= config.cir())
+      << "The peak rate of a meter must not be below its committed rate, got "
+      << config.ShortDebugString() << ".";
+  RETURN_IF_NIKSS_ERROR(nikss_meter_entry_data(entry, config.pir(),
+                                               config.pburst(), config.cir(),
+                                               config.cburst()));
+  return ::util::OkStatus();
+}
+
+// Copies the configuration of a NIKSS meter entry into P4Runtime. The config is
+// left unset for unconfigured meters, which let all packets pass as green.
+void NikssMeterToMeterConfig(nikss_meter_entry_t* entry,
+                             ::p4::v1::MeterEntry* result) {
+  nikss_meter_value_t pir = 0, pbs = 0, cir = 0, cbs = 0;
+  nikss_meter_entry_get_data(entry, &pir, &pbs, &cir, &cbs);
+  result->clear_config();
+  if (!pir && !pbs && !cir && !cbs) return;
+  auto* config = result->mutable_config();
+  config->set_cir(cir);
+  config->set_cburst(cbs);
+  config->set_pir(pir);
+  config->set_pburst(pbs);
+}
+
+// Returns the NIKSS direct meter context of the given table entry which
+// belongs to the P4 direct meter. Direct meters are named like direct
+// counters.
+::util::StatusOr<nikss_direct_meter_context_t*> FindDirectMeter(
+    nikss_table_entry_ctx_t* table_ctx, nikss_table_entry_t* entry,
+    const ::p4::config::v1::DirectMeter& direct_meter) {
+  const std::string& p4_name = direct_meter.preamble().name();
+  const std::string instance_name = p4_name.substr(p4_name.rfind('.') + 1);
+  nikss_direct_meter_context_t* dm_ctx;
+  while ((dm_ctx = nikss_direct_meter_get_next_ctx(table_ctx, entry)) !=
+         nullptr) {
+    const std::string name = nikss_direct_meter_get_name(dm_ctx);
+    if (name == instance_name || name == P4NameToNikssName(p4_name)) {
+      return dm_ctx;
+    }
+  }
+  return MAKE_ERROR(ERR_ENTRY_NOT_FOUND)
+         << "Direct meter " << p4_name << " not found in NIKSS table.";
+}
+
+// Returns the bitwidth of the cells of a register. Only registers of bit<W>
+// and int<W> cells are supported, which covers the usual PSA programs.
+::util::StatusOr<int> RegisterBitwidth(const ::p4::config::v1::Register& reg) {
+  const auto& type_spec = reg.type_spec();
+  if (type_spec.has_bitstring()) {
+    if (type_spec.bitstring().has_bit()) {
+      return type_spec.bitstring().bit().bitwidth();
+    }
+    if (type_spec.bitstring().has_int_()) {
+      return type_spec.bitstring().int_().bitwidth();
+    }
+  }
+  return MAKE_ERROR(ERR_UNIMPLEMENTED)
+         << "Register " << reg.preamble().name() << " has unsupported type "
+         << type_spec.ShortDebugString() << ".";
+}
+
+// Builds the NIKSS entry of a value set member. NIKSS expects all fields in
+// the P4Info order.
+::util::Status BuildValueSetEntry(const ::p4::config::v1::ValueSet& value_set,
+                                  const ::p4::v1::ValueSetMember& member,
+                                  nikss_value_set_entry_t* entry) {
+  for (const auto& match_field : value_set.match()) {
+    const ::p4::v1::FieldMatch* field_match = nullptr;
+    for (const auto& match : member.match()) {
+      if (match.field_id() == match_field.id()) {
+        field_match = &match;
+        break;
+      }
+    }
+    nikss_match_key_t mk;
+    nikss_matchkey_init(&mk);
+    auto mk_cleanup = absl::MakeCleanup([&mk]() { nikss_matchkey_free(&mk); });
+    RETURN_IF_ERROR(BuildMatchKey(match_field, field_match, &mk));
+    RETURN_IF_NIKSS_ERROR(nikss_value_set_entry_matchkey(entry, &mk));
+  }
+  return ::util::OkStatus();
+}
+
+// Translates a NIKSS value set entry into a P4Runtime value set member.
+::util::Status BuildP4ValueSetMember(
+    nikss_value_set_entry_t* entry, const ::p4::config::v1::ValueSet& value_set,
+    ::p4::v1::ValueSetMember* member) {
+  int field_index = 0;
+  nikss_match_key_t* mk;
+  while ((mk = nikss_value_set_entry_get_next_matchkey(entry)) != nullptr) {
+    auto mk_cleanup = absl::MakeCleanup([mk]() { nikss_matchkey_free(mk); });
+    RET_CHECK(field_index < value_set.match_size())
+        << "NIKSS entry of value set " << value_set.preamble().name()
+        << " has more fields than the P4Info.";
+    RETURN_IF_ERROR(AppendP4FieldMatch(mk, value_set.match(field_index++),
+                                       member->mutable_match()));
+  }
+  return ::util::OkStatus();
+}
+
+// Returns the number of possible CPUs, i.e. the number of values per key of a
+// per-CPU BPF map.
+int NumPossibleCpus() {
+  static const int num_cpus = []() {
+    std::ifstream file("/sys/devices/system/cpu/possible");
+    std::string range;
+    std::getline(file, range);
+    // The file holds a range such as "0-7".
+    int last_cpu = 0;
+    const auto pos = range.find('-');
+    if (!absl::SimpleAtoi(range.substr(pos == std::string::npos ? 0 : pos + 1),
+                          &last_cpu)) {
+      return 1;
+    }
+    return last_cpu + 1;
+  }();
+  return num_cpus;
+}
+
+// Takes a snapshot of all cells of a BPF array map, e.g. of an indirect counter
+// or a register. The whole array is read with a single batched lookup instead
+// of one system call per index. Falls back to per-index lookups on kernels
+// without batch support.
+::util::Status SnapshotArrayMap(const nikss_bpf_map_descriptor_t& map,
+                                ArrayMapSnapshot* snapshot) {
+  RET_CHECK(map.key_size == sizeof(uint32))
+      << "Map is expected to be an array.";
+  const bool per_cpu = map.type == BPF_MAP_TYPE_PERCPU_ARRAY;
+  snapshot->num_values = per_cpu ? NumPossibleCpus() : 1;
+  // Per-CPU values are padded to 8 bytes by the kernel.
+  snapshot->value_stride =
+      per_cpu ? (map.value_size + 7) / 8 * 8 : map.value_size;
+  const size_t entry_size = snapshot->value_stride * snapshot->num_values;
+  snapshot->keys.resize(map.max_entries);
+  snapshot->values.resize(entry_size * map.max_entries);
+
+  union bpf_attr attr;
+  std::memset(&attr, 0, sizeof(attr));
+  uint32 out_batch = 0;
+  attr.batch.map_fd = map.fd;
+  attr.batch.out_batch = reinterpret_cast<uint64>(&out_batch);
+  attr.batch.keys = reinterpret_cast<uint64>(snapshot->keys.data());
+  attr.batch.values = reinterpret_cast<uint64>(snapshot->values.data());
+  attr.batch.count = map.max_entries;
+  snapshot->count = map.max_entries;
+  // The end of the map is signaled with ENOENT, after the batch was filled.
+  if (syscall(__NR_bpf, BPF_MAP_LOOKUP_BATCH, &attr, sizeof(attr)) != 0 &&
+      errno != ENOENT) {
+    if (errno != EINVAL && errno != EOPNOTSUPP) {
+      return MAKE_ERROR(ERR_INTERNAL)
+             << "Batched map lookup failed: " << strerror(errno) << ".";
+    }
+    LOG_FIRST_N(WARNING, 1) << "Batched BPF map lookups are not supported, "
+                            << "falling back to per-index map reads.";
+    for (uint32 i = 0; i < map.max_entries; ++i) {
+      snapshot->keys[i] = i;
+      std::memset(&attr, 0, sizeof(attr));
+      attr.map_fd = map.fd;
+      attr.key = reinterpret_cast<uint64>(&snapshot->keys[i]);
+      attr.value = reinterpret_cast<uint64>(&snapshot->values[i * entry_size]);
+      if (syscall(__NR_bpf, BPF_MAP_LOOKUP_ELEM, &attr, sizeof(attr)) != 0) {
+        return MAKE_ERROR(ERR_INTERNAL)
+               << "Map lookup failed: " << strerror(errno) << ".";
+      }
+    }
+  } else {
+    snapshot->count = attr.batch.count;
+  }
+  for (size_t i = 0; i < snapshot->count; ++i) {
+    RET_CHECK(snapshot->keys[i] < map.max_entries);
+  }
+
+  return ::util::OkStatus();
+}
+
+// Takes a snapshot of all cells of an indirect counter.
+::util::Status SnapshotCounter(const nikss_bpf_map_descriptor_t& map,
+                               ::p4::config::v1::CounterSpec::Unit unit,
+                               std::vector<::p4::v1::CounterData>* cells) {
+  ArrayMapSnapshot snapshot;
+  RETURN_IF_ERROR(SnapshotArrayMap(map, &snapshot));
+  return ArrayMapSnapshotToCounterData(snapshot, map.value_size,
+                                       map.max_entries, unit, cells);
+}
+
+// A replaced pipeline alternates between two NIKSS pipeline IDs, so that the
+// new pipeline can be loaded while the previous one is still running.
+constexpr nikss_pipeline_id_t kAlternatePipelineIdOffset = 1 << 16;
+
+nikss_pipeline_id_t AlternateNikssPipelineId(int pipeline_id,
+                                             nikss_pipeline_id_t current) {
+  const auto primary = static_cast<nikss_pipeline_id_t>(pipeline_id);
+  return current == primary ? primary + kAlternatePipelineIdOffset : primary;
+}
+
+// Loads a BPF object into the given pipeline. NIKSS only loads objects from a
+// path, so the object is passed through an anonymous memory file instead of a
+// file on disk. This avoids leftover files and races between nodes.
+::util::Status LoadBpfObject(nikss_context_t* ctx, const std::string& bpf_obj) {
+  int fd = memfd_create("stratum_bpf_obj", MFD_CLOEXEC);
+  if (fd < 0) {
+    return MAKE_ERROR(ERR_INTERNAL)
+           << "Failed to create memory file for BPF object: "
+           << strerror(errno) << ".";
+  }
+  auto fd_cleanup = absl::MakeCleanup([fd]() { close(fd); });
+  size_t written = 0;
+  while (written < bpf_obj.size()) {
+    ssize_t ret =
+        write(fd, bpf_obj.data() + written, bpf_obj.size() - written);
+    if (ret < 0 && errno == EINTR) continue;
+    if (ret < 0) {
+      return MAKE_ERROR(ERR_INTERNAL)
+             << "Failed to write BPF object to memory file: "
+             << strerror(errno) << ".";
+    }
+    written += ret;
+  }
+  const std::string path = absl::StrCat("/proc/self/fd/", fd);
+  RETURN_IF_NIKSS_ERROR(nikss_pipeline_load(ctx, path.c_str()));
+
+  return ::util::OkStatus();
+}
+
+// Returns the names of the interfaces attached to the given pipeline.
+::util::StatusOr<std::vector<std::string>> GetPipelinePorts(
+    nikss_context_t* ctx) {
+  nikss_port_list_t list;
+  RETURN_IF_NIKSS_ERROR(nikss_pipeline_port_list_init(&list, ctx));
+  auto list_cleanup =
+      absl::MakeCleanup([&list]() { nikss_pipeline_port_list_free(&list); });
+  std::vector<std::string> ports;
+  nikss_port_spec_t* port;
+  while ((port = nikss_pipeline_port_list_get_next_port(&list)) != nullptr) {
+    ports.push_back(nikss_port_spec_get_name(port));
+    nikss_port_spec_free(port);
+  }
+
+  return ports;
+}
+
+// Moves the given interfaces from one pipeline to another. In the hitless
+// mode, an interface is attached to the new pipeline while it is still
+// attached to the old one, so that NIKSS replaces its programs in place and
+// no packet is left unprocessed. If NIKSS refuses to replace the programs,
+// the interface is attached back to the old pipeline and the move fails with
+// ERR_OPER_NOT_SUPPORTED. Otherwise, an interface is detached from the old
+// pipeline right before it is attached to the new one, which interrupts its
+// traffic for the time of the re-attachment.
+::util::Status MovePorts(const std::vector<std::string>& ports,
+                         nikss_context_t* from, nikss_context_t* to,
+                         bool hitless) {
+  for (const auto& port : ports) {
+    int port_id;
+    if (!hitless) {
+      RETURN_IF_NIKSS_ERROR(nikss_pipeline_del_port(from, port.c_str()));
+      RETURN_IF_NIKSS_ERROR(
+          nikss_pipeline_add_port(to, port.c_str(), &port_id));
+      VLOG(1) << "Moved port " << port << " to the new NIKSS pipeline.";
+      continue;
+    }
+    int ret = nikss_pipeline_add_port(to, port.c_str(), &port_id);
+    if (ret != 0) {
+      // Some of the programs may have been replaced already.
+      int restore_ret = nikss_pipeline_add_port(from, port.c_str(), &port_id);
+      if (restore_ret != 0) {
+        LOG(ERROR) << "Failed to restore the programs of the previous NIKSS "
+                   << "pipeline on port " << port << ", code " << restore_ret
+                   << ".";
+      }
+      return MAKE_ERROR(ERR_OPER_NOT_SUPPORTED)
+             << "Port " << port << " cannot be moved to the new NIKSS "
+             << "pipeline atomically, code " << ret << ".";
+    }
+    VLOG(1) << "Moved port " << port << " atomically to the new NIKSS "
+            << "pipeline.";
+  }
+
+  return ::util::OkStatus();
+}
+
+// Wrapper around a NIKSS multicast group context.
+struct MulticastGroupContext {
+  explicit MulticastGroupContext(uint32 group_id) {
+    nikss_mcast_grp_context_init(&ctx);
+    nikss_mcast_grp_id_set(&ctx, group_id);
+  }
+  ~MulticastGroupContext() { nikss_mcast_grp_context_free(&ctx); }
+  nikss_mcast_grp_ctx_t ctx;
+};
+
+// Wrapper around a NIKSS multicast group member.
+struct MulticastGroupMember {
+  explicit MulticastGroupMember(const ::p4::v1::Replica& replica) {
+    nikss_mcast_grp_member_init(&member);
+    nikss_mcast_grp_member_set_port(&member, replica.egress_port());
+    nikss_mcast_grp_member_set_instance(&member, replica.instance());
+  }
+  ~MulticastGroupMember() { nikss_mcast_grp_member_free(&member); }
+  nikss_mcast_grp_member_t member;
+};
+
+// Wrapper around a NIKSS clone session context.
+struct CloneSessionContext {
+  explicit CloneSessionContext(uint32 session_id) {
+    nikss_clone_session_context_init(&ctx);
+    nikss_clone_session_id_set(&ctx, session_id);
+  }
+  ~CloneSessionContext() { nikss_clone_session_context_free(&ctx); }
+  nikss_clone_session_ctx_t ctx;
+};
+
+// Wrapper around a NIKSS clone session entry.
+struct CloneSessionReplica {
+  explicit CloneSessionReplica(const ::p4::v1::Replica& replica) {
+    nikss_clone_session_entry_init(&entry);
+    nikss_clone_session_entry_set_egress_port(&entry, replica.egress_port());
+    nikss_clone_session_entry_set_instance(&entry, replica.instance());
+  }
+  ~CloneSessionReplica() { nikss_clone_session_entry_free(&entry); }
+  nikss_clone_session_entry_t entry;
+};
+
+// Appends the replicas of a NIKSS multicast group to the given entry.
+void BuildMulticastGroupEntry(nikss_context_t* ctx,
+                              nikss_mcast_grp_ctx_t* group,
+                              ::p4::v1::MulticastGroupEntry* result) {
+  result->set_multicast_group_id(nikss_mcast_grp_get_id(group));
+  // The members are owned by the group context.
+  nikss_mcast_grp_member_t* member;
+  while ((member = nikss_mcast_grp_get_next_member(ctx, group)) != nullptr) {
+    auto* replica = result->add_replicas();
+    replica->set_egress_port(nikss_mcast_grp_member_get_port(member));
+    replica->set_instance(nikss_mcast_grp_member_get_instance(member));
+  }
+}
+
+// Appends the replicas of a NIKSS clone session to the given entry. The class
+// of service and the truncation length are shared by all replicas.
+void BuildCloneSessionEntry(nikss_context_t* ctx,
+                            nikss_clone_session_ctx_t* clone_session,
+                            ::p4::v1::CloneSessionEntry* result) {
+  result->set_session_id(nikss_clone_session_get_id(clone_session));
+  // The entries are owned by the clone session context.
+  nikss_clone_session_entry_t* entry;
+  while ((entry = nikss_clone_session_get_next_entry(ctx, clone_session)) !=
+         nullptr) {
+    if (result->replicas_size() == 0) {
+      result->set_class_of_service(nikss_clone_session_entry_get_cos(entry));
+      if (nikss_clone_session_entry_get_truncate_state(entry)) {
+        result->set_packet_length_bytes(
+            nikss_clone_session_entry_get_truncate_length(entry));
+      }
+    }
+    auto* replica = result->add_replicas();
+    replica->set_egress_port(nikss_clone_session_entry_get_egress_port(entry));
+    replica->set_instance(nikss_clone_session_entry_get_instance(entry));
+  }
+}
+
+}  // namespace
+
 NikssWrapper::NikssWrapper() {}
 
+::util::StatusOr<std::shared_ptr<NikssInterface::SessionInterface>>
+NikssWrapper::Session::CreateSession(
+    std::shared_ptr<nikss_context_t> pipeline_ctx) {
+  RET_CHECK(pipeline_ctx) << "Pipeline context must be non-null.";
+  return std::shared_ptr<NikssInterface::SessionInterface>(
+      new Session(std::move(pipeline_ctx)));
+}
+
+::util::StatusOr<nikss_table_entry_ctx_t*>
+NikssWrapper::Session::GetTableContext(const std::string& table_name) {
+  auto* table_context = gtl::FindOrNull(table_contexts_, table_name);
+  if (table_context) return &(*table_context)->ctx;
+
+  auto new_context = absl::make_unique<TableContext>();
+  RETURN_IF_NIKSS_ERROR(nikss_table_entry_ctx_tblname(
+      nikss_ctx_, &new_context->ctx, table_name.c_str()));
+  nikss_table_entry_ctx_t* ctx = &new_context->ctx;
+  table_contexts_.emplace(table_name, std::move(new_context));
+  return ctx;
+}
+
+::util::StatusOr<NikssWrapper::CounterContext*>
+NikssWrapper::Session::GetCounterContext(const std::string& counter_name) {
+  auto* counter_context = gtl::FindOrNull(counter_contexts_, counter_name);
+  if (counter_context) return counter_context->get();
+
+  auto new_context = absl::make_unique<CounterContext>();
+  RETURN_IF_NIKSS_ERROR(nikss_counter_ctx_name(nikss_ctx_, &new_context->ctx,
+                                               counter_name.c_str()));
+  CounterContext* ctx = new_context.get();
+  counter_contexts_.emplace(counter_name, std::move(new_context));
+  return ctx;
+}
+
+::util::StatusOr<NikssWrapper::MeterContext*>
+NikssWrapper::Session::GetMeterContext(const std::string& meter_name) {
+  auto* meter_context = gtl::FindOrNull(meter_contexts_, meter_name);
+  if (meter_context) return meter_context->get();
+
+  ASSIGN_OR_RETURN(auto new_context, OpenMeterContext(meter_name));
+  MeterContext* ctx = new_context.get();
+  meter_contexts_.emplace(meter_name, std::move(new_context));
+  return ctx;
+}
+
+::util::StatusOr<NikssWrapper::RegisterContext*>
+NikssWrapper::Session::GetRegisterContext(const std::string& register_name) {
+  auto* register_context = gtl::FindOrNull(register_contexts_, register_name);
+  if (register_context) return register_context->get();
+
+  ASSIGN_OR_RETURN(auto new_context, OpenRegisterContext(register_name));
+  RegisterContext* ctx = new_context.get();
+  register_contexts_.emplace(register_name, std::move(new_context));
+  return ctx;
+}
+
+::util::StatusOr<NikssWrapper::DigestContext*>
+NikssWrapper::Session::GetDigestContext(const std::string& digest_name) {
+  auto* digest_context = gtl::FindOrNull(digest_contexts_, digest_name);
+  if (digest_context) return digest_context->get();
+
+  auto new_context = absl::make_unique<DigestContext>();
+  RETURN_IF_NIKSS_ERROR(nikss_digest_ctx_name(nikss_ctx_, &new_context->ctx,
+                                              digest_name.c_str()));
+  DigestContext* ctx = new_context.get();
+  digest_contexts_.emplace(digest_name, std::move(new_context));
+  return ctx;
+}
+
+::util::StatusOr<NikssWrapper::ActionSelectorContext*>
+NikssWrapper::Session::GetActionSelectorContext(
+    const std::string& action_selector_name) {
+  auto* action_selector_context =
+      gtl::FindOrNull(action_selector_contexts_, action_selector_name);
+  if (action_selector_context) return action_selector_context->get();
+
+  ASSIGN_OR_RETURN(auto new_context,
+                   OpenActionSelectorContext(action_selector_name));
+  ActionSelectorContext* ctx = new_context.get();
+  action_selector_contexts_.emplace(action_selector_name,
+                                    std::move(new_context));
+  return ctx;
+}
+
+::util::StatusOr<std::unique_ptr<NikssWrapper::ActionSelectorContext>>
+NikssWrapper::Session::OpenActionSelectorContext(
+    const std::string& action_selector_name) {
+  auto action_selector_context = absl::make_unique<ActionSelectorContext>();
+  RETURN_IF_NIKSS_ERROR(nikss_action_selector_ctx_name(
+      nikss_ctx_, &action_selector_context->ctx,
+      action_selector_name.c_str()));
+  return action_selector_context;
+}
+
+::util::StatusOr<std::unique_ptr<NikssWrapper::MeterContext>>
+NikssWrapper::Session::OpenMeterContext(const std::string& meter_name) {
+  auto meter_context = absl::make_unique<MeterContext>();
+  RETURN_IF_NIKSS_ERROR(nikss_meter_ctx_name(&meter_context->ctx, nikss_ctx_,
+                                             meter_name.c_str()));
+  return meter_context;
+}
+
+::util::StatusOr<std::unique_ptr<NikssWrapper::RegisterContext>>
+NikssWrapper::Session::OpenRegisterContext(const std::string& register_name) {
+  auto register_context = absl::make_unique<RegisterContext>();
+  RETURN_IF_NIKSS_ERROR(nikss_register_ctx_name(
+      &register_context->ctx, nikss_ctx_, register_name.c_str()));
+  return register_context;
+}
+
+::util::StatusOr<std::unique_ptr<NikssWrapper::ValueSetContext>>
+NikssWrapper::Session::OpenValueSetContext(const std::string& value_set_name) {
+  auto value_set_context = absl::make_unique<ValueSetContext>();
+  RETURN_IF_NIKSS_ERROR(nikss_value_set_context_name(
+      nikss_ctx_, &value_set_context->ctx, value_set_name.c_str()));
+  return value_set_context;
+}
+
+::util::StatusOr<std::unique_ptr<NikssWrapper::TableContext>>
+NikssWrapper::Session::OpenTableContext(const std::string& table_name) {
+  auto table_context = absl::make_unique<TableContext>();
+  RETURN_IF_NIKSS_ERROR(nikss_table_entry_ctx_tblname(
+      nikss_ctx_, &table_context->ctx, table_name.c_str()));
+  return table_context;
+}
+
+NikssWrapper::PipelineContext NikssWrapper::NewPipelineContext(
+    nikss_pipeline_id_t nikss_pipeline_id) {
+  PipelineContext pipeline;
+  pipeline.ctx.reset(new nikss_context_t, NikssContextDeleter());
+  nikss_context_init(pipeline.ctx.get());
+  nikss_context_set_pipeline(pipeline.ctx.get(), nikss_pipeline_id);
+  pipeline.nikss_pipeline_id = nikss_pipeline_id;
+  return pipeline;
+}
+
+nikss_context_t* NikssWrapper::GetPipelineContext(int pipeline_id) {
+  auto* pipeline = gtl::FindOrNull(pipeline_contexts_, pipeline_id);
+  if (pipeline) return pipeline->ctx.get();
+
+  PipelineContext new_pipeline =
+      NewPipelineContext(static_cast<nikss_pipeline_id_t>(pipeline_id));
+  if (!nikss_pipeline_exists(new_pipeline.ctx.get())) {
+    // A pipeline which has been replaced before, possibly by a previous
+    // instance of Stratum, runs under the alternate NIKSS pipeline ID.
+    PipelineContext alternate = NewPipelineContext(AlternateNikssPipelineId(
+        pipeline_id, new_pipeline.nikss_pipeline_id));
+    if (nikss_pipeline_exists(alternate.ctx.get())) {
+      new_pipeline = std::move(alternate);
+    }
+  }
+  nikss_context_t* ctx = new_pipeline.ctx.get();
+  pipeline_contexts_.emplace(pipeline_id, std::move(new_pipeline));
+  return ctx;
+}
+
 ::util::Status NikssWrapper::AddPipeline(int pipeline_id,
-                                         const std::string bpf_obj) {
-  std::string tmp_filepath = "/tmp/stratum_bpf.o";
-  // FIXME: nikss currently doesn't support loading BPF programs from memory.
-  //  So, we save it to the disk first and let NIKSS load it from the disk.
-  RETURN_IF_ERROR(WriteStringToFile(bpf_obj, tmp_filepath));
+                                         const std::string& bpf_obj) {
+  {
+    absl::WriterMutexLock l(&data_lock_);
+    nikss_context_t* ctx = GetPipelineContext(pipeline_id);
+    if (!nikss_pipeline_exists(ctx)) {
+      RETURN_IF_ERROR(LoadBpfObject(ctx, bpf_obj));
+      return AttachConfiguredPorts(pipeline_id);
+    }
+  }
+
+  // A pipeline is already running, e.g. loaded by a previous instance of
+  // Stratum. Its state is not carried over, so its ports may be moved to the
+  // new pipeline disruptively.
+  LOG(INFO) << "Replacing the running NIKSS pipeline of node " << pipeline_id
+            << ".";
+  RETURN_IF_ERROR(LoadStandbyPipeline(pipeline_id, bpf_obj));
+  absl::WriterMutexLock l(&data_lock_);
+  RETURN_IF_ERROR(SwitchPipeline(pipeline_id, /*hitless=*/false));
+  return AttachConfiguredPorts(pipeline_id);
+}
+
+::util::Status NikssWrapper::LoadStandbyPipeline(int pipeline_id,
+                                                 const std::string& bpf_obj) {
+  absl::WriterMutexLock l(&data_lock_);
+  RET_CHECK(!standby_contexts_.contains(pipeline_id))
+      << "A standby pipeline is already loaded for node " << pipeline_id
+      << ".";
+  GetPipelineContext(pipeline_id);
+  const auto& active = pipeline_contexts_.at(pipeline_id);
+  PipelineContext standby = NewPipelineContext(
+      AlternateNikssPipelineId(pipeline_id, active.nikss_pipeline_id));
+  if (nikss_pipeline_exists(standby.ctx.get())) {
+    // Leftover of an interrupted pipeline replacement.
+    LOG(WARNING) << "Unloading stale NIKSS pipeline "
+                 << standby.nikss_pipeline_id << ".";
+    RETURN_IF_NIKSS_ERROR(nikss_pipeline_unload(standby.ctx.get()));
+  }
+  RETURN_IF_ERROR(LoadBpfObject(standby.ctx.get(), bpf_obj));
+  standby_contexts_.emplace(pipeline_id, std::move(standby));
+
+  return ::util::OkStatus();
+}
+
+::util::StatusOr<std::shared_ptr<NikssInterface::SessionInterface>>
+NikssWrapper::CreateStandbySession(int pipeline_id) {
+  absl::WriterMutexLock l(&data_lock_);
+  auto* standby = gtl::FindOrNull(standby_contexts_, pipeline_id);
+  RET_CHECK(standby) << "No standby pipeline loaded for node " << pipeline_id
+                     << ".";
+  return Session::CreateSession(standby->ctx);
+}
+
+::util::Status NikssWrapper::SwitchToStandbyPipeline(int pipeline_id) {
+  absl::WriterMutexLock l(&data_lock_);
+  return SwitchPipeline(pipeline_id, /*hitless=*/true);
+}
+
+::util::Status NikssWrapper::SwitchPipeline(int pipeline_id, bool hitless) {
+  auto* standby = gtl::FindOrNull(standby_contexts_, pipeline_id);
+  RET_CHECK(standby) << "No standby pipeline loaded for node " << pipeline_id
+                     << ".";
+  auto* active = gtl::FindOrNull(pipeline_contexts_, pipeline_id);
+  RET_CHECK(active) << "No pipeline running for node " << pipeline_id << ".";
+
+  ASSIGN_OR_RETURN(auto ports, GetPipelinePorts(active->ctx.get()));
+  ::util::Status status =
+      MovePorts(ports, active->ctx.get(), standby->ctx.get(), hitless);
+  if (!status.ok()) {
+    // Attach all ports back to the previous pipeline, which keeps running,
+    // and drop the new one.
+    LOG(ERROR) << "Failed to move ports to the new NIKSS pipeline: " << status;
+    auto moved_ports = GetPipelinePorts(standby->ctx.get());
+    if (moved_ports.ok()) {
+      APPEND_STATUS_IF_ERROR(
+          status, MovePorts(moved_ports.ValueOrDie(), standby->ctx.get(),
+                            active->ctx.get(), hitless));
+    }
+    int ret = nikss_pipeline_unload(standby->ctx.get());
+    if (ret != 0) {
+      LOG(WARNING) << "Failed to unload new NIKSS pipeline "
+                   << standby->nikss_pipeline_id << ", code " << ret << ".";
+    }
+    standby_contexts_.erase(pipeline_id);
+    return status;
+  }
+
+  // The previous pipeline does not carry any traffic anymore.
+  int ret = nikss_pipeline_unload(active->ctx.get());
+  if (ret != 0) {
+    LOG(WARNING) << "Failed to unload previous NIKSS pipeline "
+                 << active->nikss_pipeline_id << ", code " << ret << ".";
+  }
+  *active = std::move(*standby);
+  standby_contexts_.erase(pipeline_id);
+  LOG(INFO) << "Switched " << ports.size() << " ports of node " << pipeline_id
+            << " to NIKSS pipeline " << active->nikss_pipeline_id << ".";
+
+  return ::util::OkStatus();
+}
+
+::util::Status NikssWrapper::DiscardStandbyPipeline(int pipeline_id) {
+  absl::WriterMutexLock l(&data_lock_);
+  auto* standby = gtl::FindOrNull(standby_contexts_, pipeline_id);
+  if (!standby) return ::util::OkStatus();
+  int ret = nikss_pipeline_unload(standby->ctx.get());
+  standby_contexts_.erase(pipeline_id);
+  RETURN_IF_NIKSS_ERROR(ret);
+
+  return ::util::OkStatus();
+}
+
+::util::Status NikssWrapper::AddPort(int pipeline_id,
+                                     const std::string& port_name) {
+  absl::WriterMutexLock l(&data_lock_);
+  configured_ports_[pipeline_id].insert(port_name);
+  nikss_context_t* ctx = GetPipelineContext(pipeline_id);
+  if (!nikss_pipeline_exists(ctx)) {
+    VLOG(1) << "Port " << port_name << " will be attached once the pipeline "
+            << "of node " << pipeline_id << " is loaded.";
+    return ::util::OkStatus();
+  }
+
+  return AttachConfiguredPorts(pipeline_id);
+}
+
+::util::Status NikssWrapper::DeletePort(int pipeline_id,
+                                        const std::string& port_name) {
+  absl::WriterMutexLock l(&data_lock_);
+  auto* ports = gtl::FindOrNull(configured_ports_, pipeline_id);
+  if (ports) ports->erase(port_name);
+  nikss_context_t* ctx = GetPipelineContext(pipeline_id);
+  if (!nikss_pipeline_exists(ctx)) return ::util::OkStatus();
+  ASSIGN_OR_RETURN(auto attached, GetPipelinePorts(ctx));
+  if (std::find(attached.begin(), attached.end(), port_name) ==
+      attached.end()) {
+    return ::util::OkStatus();
+  }
+  RETURN_IF_NIKSS_ERROR(nikss_pipeline_del_port(ctx, port_name.c_str()));
+  LOG(INFO) << "Detached port " << port_name << " from the NIKSS pipeline of "
+            << "node " << pipeline_id << ".";
+
+  return ::util::OkStatus();
+}
+
+::util::Status NikssWrapper::AttachConfiguredPorts(int pipeline_id) {
+  auto* ports = gtl::FindOrNull(configured_ports_, pipeline_id);
+  if (!ports || ports->empty()) return ::util::OkStatus();
+  nikss_context_t* ctx = GetPipelineContext(pipeline_id);
+  ASSIGN_OR_RETURN(auto attached, GetPipelinePorts(ctx));
+  ::util::Status status = ::util::OkStatus();
+  for (const auto& port : *ports) {
+    if (std::find(attached.begin(), attached.end(), port) != attached.end()) {
+      continue;
+    }
+    int port_id;
+    int ret = nikss_pipeline_add_port(ctx, port.c_str(), &port_id);
+    if (ret != 0) {
+      ::util::Status error = MAKE_ERROR(NikssErrorToErrorCode(ret))
+                             << "Failed to attach port " << port
+                             << " to the NIKSS pipeline of node "
+                             << pipeline_id << ", code " << ret << ".";
+      APPEND_STATUS_IF_ERROR(status, error);
+      continue;
+    }
+    LOG(INFO) << "Attached port " << port << " (ifindex " << port_id
+              << ") to the NIKSS pipeline of node " << pipeline_id << ".";
+  }
+
+  return status;
+}
+
+::util::StatusOr<std::shared_ptr<NikssInterface::SessionInterface>>
+NikssWrapper::CreateSession(int pipeline_id) {
+  absl::WriterMutexLock l(&data_lock_);
+  GetPipelineContext(pipeline_id);
+  return Session::CreateSession(pipeline_contexts_.at(pipeline_id).ctx);
+}
+
+::util::Status NikssWrapper::WriteTableEntry(
+    std::shared_ptr<NikssInterface::SessionInterface> session,
+    const ::p4::v1::Update::Type type, const ::p4::config::v1::Table& table,
+    const ::p4::config::v1::Action& action,
+    const ::p4::v1::TableEntry& table_entry) {
+  auto real_session = std::dynamic_pointer_cast<Session>(session);
+  RET_CHECK(real_session);
+
+  ASSIGN_OR_RETURN(
+      auto* table_ctx,
+      real_session->GetTableContext(P4NameToNikssName(table.preamble().name())));
+  // Entries of tables with an action selector refer to members or groups.
+  if (table.implementation_id()) nikss_table_entry_ctx_mark_indirect(table_ctx);
+
+  nikss_table_entry_t entry;
+  nikss_table_entry_init(&entry);
+  auto entry_cleanup =
+      absl::MakeCleanup([&entry]() { nikss_table_entry_free(&entry); });
+
+  if (!table_entry.is_default_action()) {
+    RETURN_IF_ERROR(BuildTableKey(table, table_entry, &entry));
+  }
+
+  nikss_action_t nikss_action;
+  nikss_action_init(&nikss_action);
+  auto action_cleanup =
+      absl::MakeCleanup([&nikss_action]() { nikss_action_free(&nikss_action); });
+  if (type != ::p4::v1::Update::DELETE && table.implementation_id()) {
+    RETURN_IF_ERROR(
+        BuildIndirectTableAction(table_entry.action(), &nikss_action));
+    nikss_table_entry_action(&entry, &nikss_action);
+  } else if (type != ::p4::v1::Update::DELETE) {
+    RETURN_IF_ERROR(BuildTableAction(table_ctx, action,
+                                     table_entry.action().action(),
+                                     &nikss_action));
+    nikss_table_entry_action(&entry, &nikss_action);
+  }
+
+  if (table_entry.is_default_action()) {
+    RET_CHECK(type == ::p4::v1::Update::MODIFY)
+        << "The default action of table " << table.preamble().name()
+        << " can only be modified.";
+    RETURN_IF_NIKSS_ERROR(
+        nikss_table_entry_set_default_entry(table_ctx, &entry));
+    return ::util::OkStatus();
+  }
+
+  switch (type) {
+    case ::p4::v1::Update::INSERT:
+      RETURN_IF_NIKSS_ERROR(nikss_table_entry_add(table_ctx, &entry));
+      break;
+    case ::p4::v1::Update::MODIFY:
+      RETURN_IF_NIKSS_ERROR(nikss_table_entry_update(table_ctx, &entry));
+      break;
+    case ::p4::v1::Update::DELETE:
+      RETURN_IF_NIKSS_ERROR(nikss_table_entry_del(table_ctx, &entry));
+      break;
+    default:
+      return MAKE_ERROR(ERR_INVALID_PARAM)
+             << "Unsupported update type: " << type << " in table entry "
+             << table_entry.ShortDebugString() << ".";
+  }
+
+  return ::util::OkStatus();
+}
+
+::util::Status NikssWrapper::ReadTableEntries(
+    std::shared_ptr<NikssInterface::SessionInterface> session,
+    const ::p4::config::v1::Table& table,
+    const std::vector<::p4::config::v1::Action>& actions,
+    const ::p4::v1::TableEntry& table_entry,
+    WriterInterface<::p4::v1::TableEntry>* writer) {
+  auto real_session = std::dynamic_pointer_cast<Session>(session);
+  RET_CHECK(real_session);
+  RET_CHECK(writer) << "Writer must be non-null.";
+  const std::string table_name = P4NameToNikssName(table.preamble().name());
+
+  ASSIGN_OR_RETURN(auto* table_ctx, real_session->GetTableContext(table_name));
+  if (table.implementation_id()) nikss_table_entry_ctx_mark_indirect(table_ctx);
+  absl::flat_hash_map<uint32, const ::p4::config::v1::Action*>
+      nikss_id_to_action;
+  for (const auto& action : actions) {
+    nikss_id_to_action[nikss_table_get_action_id_by_name(
+        table_ctx, action.preamble().name().c_str())] = &action;
+  }
+
+  // The result entry is reused for all entries to avoid re-allocations.
+  ::p4::v1::TableEntry result;
+
+  if (table_entry.is_default_action()) {
+    nikss_table_entry_t entry;
+    nikss_table_entry_init(&entry);
+    auto entry_cleanup =
+        absl::MakeCleanup([&entry]() { nikss_table_entry_free(&entry); });
+    RETURN_IF_NIKSS_ERROR(
+        nikss_table_entry_get_default_entry(table_ctx, &entry));
+    RETURN_IF_ERROR(BuildP4TableEntry(&entry, table, nikss_id_to_action,
+                                      /*read_key=*/false, &result));
+    RET_CHECK(writer->Write(result)) << "Write to stream channel failed.";
+    return ::util::OkStatus();
+  }
+
+  if (table_entry.match_size()) {
+    nikss_table_entry_t entry;
+    nikss_table_entry_init(&entry);
+    auto entry_cleanup =
+        absl::MakeCleanup([&entry]() { nikss_table_entry_free(&entry); });
+    RETURN_IF_ERROR(BuildTableKey(table, table_entry, &entry));
+    RETURN_IF_NIKSS_ERROR(nikss_table_entry_get(table_ctx, &entry));
+    RETURN_IF_ERROR(BuildP4TableEntry(&entry, table, nikss_id_to_action,
+                                      /*read_key=*/true, &result));
+    RET_CHECK(writer->Write(result)) << "Write to stream channel failed.";
+    return ::util::OkStatus();
+  }
+
+  // Wildcard read: walk the BPF map and stream the entries as we go.
+  ASSIGN_OR_RETURN(auto iter_ctx, real_session->OpenTableContext(table_name));
+  if (table.implementation_id()) {
+    nikss_table_entry_ctx_mark_indirect(&iter_ctx->ctx);
+  }
+  nikss_table_entry_t* entry;
+  while ((entry = nikss_table_entry_get_next(&iter_ctx->ctx)) != nullptr) {
+    auto entry_cleanup =
+        absl::MakeCleanup([entry]() { nikss_table_entry_free(entry); });
+    result.Clear();
+    RETURN_IF_ERROR(BuildP4TableEntry(entry, table, nikss_id_to_action,
+                                      /*read_key=*/true, &result));
+    RET_CHECK(writer->Write(result)) << "Write to stream channel failed.";
+  }
+
+  return ::util::OkStatus();
+}
+
+::util::Status NikssWrapper::WriteIndirectCounter(
+    std::shared_ptr<NikssInterface::SessionInterface> session,
+    const ::p4::config::v1::Counter& counter,
+    const ::p4::v1::CounterEntry& counter_entry) {
+  auto real_session = std::dynamic_pointer_cast<Session>(session);
+  RET_CHECK(real_session);
+  RET_CHECK(counter_entry.has_index())
+      << "Writing all cells of a counter is not supported.";
+  ASSIGN_OR_RETURN(auto* counter_ctx,
+                   real_session->GetCounterContext(
+                       P4NameToNikssName(counter.preamble().name())));
+
+  nikss_counter_entry_t entry;
+  nikss_counter_entry_init(&entry);
+  auto entry_cleanup =
+      absl::MakeCleanup([&entry]() { nikss_counter_entry_free(&entry); });
+  const uint32 index = counter_entry.index().index();
+  RETURN_IF_NIKSS_ERROR(
+      nikss_counter_entry_set_key(&entry, &index, sizeof(index)));
+  CounterDataToNikssCounter(counter_entry.data(), &entry);
+  RETURN_IF_NIKSS_ERROR(nikss_counter_set(&counter_ctx->ctx, &entry));
+
+  return ::util::OkStatus();
+}
+
+::util::Status NikssWrapper::ReadIndirectCounter(
+    std::shared_ptr<NikssInterface::SessionInterface> session,
+    const ::p4::config::v1::Counter& counter,
+    const ::p4::v1::CounterEntry& counter_entry,
+    WriterInterface<::p4::v1::CounterEntry>* writer) {
+  auto real_session = std::dynamic_pointer_cast<Session>(session);
+  RET_CHECK(real_session);
+  RET_CHECK(writer) << "Writer must be non-null.";
+  ASSIGN_OR_RETURN(auto* counter_ctx,
+                   real_session->GetCounterContext(
+                       P4NameToNikssName(counter.preamble().name())));
+  const auto unit = counter.spec().unit();
+
+  ::p4::v1::CounterEntry result;
+  result.set_counter_id(counter.preamble().id());
+  if (counter_entry.has_index()) {
+    nikss_counter_entry_t entry;
+    nikss_counter_entry_init(&entry);
+    auto entry_cleanup =
+        absl::MakeCleanup([&entry]() { nikss_counter_entry_free(&entry); });
+    const uint32 index = counter_entry.index().index();
+    RETURN_IF_NIKSS_ERROR(
+        nikss_counter_entry_set_key(&entry, &index, sizeof(index)));
+    RETURN_IF_NIKSS_ERROR(nikss_counter_get(&counter_ctx->ctx, &entry));
+    result.mutable_index()->set_index(index);
+    NikssCounterToCounterData(&entry, unit, result.mutable_data());
+    RET_CHECK(writer->Write(result)) << "Write to stream channel failed.";
+    return ::util::OkStatus();
+  }
+
+  // Wildcard read: a single snapshot of the whole counter array.
+  std::vector<::p4::v1::CounterData> cells;
+  RETURN_IF_ERROR(SnapshotCounter(counter_ctx->ctx.counter, unit, &cells));
+  for (size_t i = 0; i < cells.size(); ++i) {
+    result.mutable_index()->set_index(i);
+    *result.mutable_data() = cells[i];
+    RET_CHECK(writer->Write(result)) << "Write to stream channel failed.";
+  }
+
+  return ::util::OkStatus();
+}
+
+::util::Status NikssWrapper::WriteDirectCounter(
+    std::shared_ptr<NikssInterface::SessionInterface> session,
+    const ::p4::config::v1::Table& table,
+    const ::p4::config::v1::DirectCounter& direct_counter,
+    const ::p4::v1::DirectCounterEntry& direct_counter_entry) {
+  auto real_session = std::dynamic_pointer_cast<Session>(session);
+  RET_CHECK(real_session);
+  RET_CHECK(direct_counter_entry.table_entry().match_size())
+      << "Writing direct counters of all entries is not supported.";
+  ASSIGN_OR_RETURN(
+      auto* table_ctx,
+      real_session->GetTableContext(P4NameToNikssName(table.preamble().name())));
+
+  // The entry is read first, as NIKSS updates the action and the direct
+  // resources of an entry together.
+  nikss_table_entry_t entry;
+  nikss_table_entry_init(&entry);
+  auto entry_cleanup =
+      absl::MakeCleanup([&entry]() { nikss_table_entry_free(&entry); });
+  RETURN_IF_ERROR(
+      BuildTableKey(table, direct_counter_entry.table_entry(), &entry));
+  RETURN_IF_NIKSS_ERROR(nikss_table_entry_get(table_ctx, &entry));
+  ASSIGN_OR_RETURN(auto* dc_ctx,
+                   FindDirectCounter(table_ctx, &entry, direct_counter));
+
+  nikss_counter_entry_t counter;
+  nikss_counter_entry_init(&counter);
+  auto counter_cleanup =
+      absl::MakeCleanup([&counter]() { nikss_counter_entry_free(&counter); });
+  CounterDataToNikssCounter(direct_counter_entry.data(), &counter);
+  RETURN_IF_NIKSS_ERROR(
+      nikss_table_entry_set_direct_counter(&entry, dc_ctx, &counter));
+  RETURN_IF_NIKSS_ERROR(nikss_table_entry_update(table_ctx, &entry));
+
+  return ::util::OkStatus();
+}
+
+::util::Status NikssWrapper::ReadDirectCounter(
+    std::shared_ptr<NikssInterface::SessionInterface> session,
+    const ::p4::config::v1::Table& table,
+    const ::p4::config::v1::DirectCounter& direct_counter,
+    const ::p4::v1::DirectCounterEntry& direct_counter_entry,
+    WriterInterface<::p4::v1::DirectCounterEntry>* writer) {
+  auto real_session = std::dynamic_pointer_cast<Session>(session);
+  RET_CHECK(real_session);
+  RET_CHECK(writer) << "Writer must be non-null.";
+  const std::string table_name = P4NameToNikssName(table.preamble().name());
+  ASSIGN_OR_RETURN(auto* table_ctx, real_session->GetTableContext(table_name));
+  const auto unit = direct_counter.spec().unit();
+
+  // The result entry is reused for all entries to avoid re-allocations.
+  ::p4::v1::DirectCounterEntry result;
+  auto build_result = [&](nikss_table_entry_ctx_t* ctx,
+                          nikss_table_entry_t* entry) -> ::util::Status {
+    result.Clear();
+    RETURN_IF_ERROR(BuildP4TableKey(entry, table, result.mutable_table_entry()));
+    ASSIGN_OR_RETURN(auto* dc_ctx, FindDirectCounter(ctx, entry, direct_counter));
+    nikss_counter_entry_t counter;
+    nikss_counter_entry_init(&counter);
+    auto counter_cleanup =
+        absl::MakeCleanup([&counter]() { nikss_counter_entry_free(&counter); });
+    RETURN_IF_NIKSS_ERROR(nikss_direct_counter_get_entry(dc_ctx, &counter));
+    NikssCounterToCounterData(&counter, unit, result.mutable_data());
+    return ::util::OkStatus();
+  };
+
+  if (direct_counter_entry.table_entry().match_size()) {
+    nikss_table_entry_t entry;
+    nikss_table_entry_init(&entry);
+    auto entry_cleanup =
+        absl::MakeCleanup([&entry]() { nikss_table_entry_free(&entry); });
+    RETURN_IF_ERROR(
+        BuildTableKey(table, direct_counter_entry.table_entry(), &entry));
+    RETURN_IF_NIKSS_ERROR(nikss_table_entry_get(table_ctx, &entry));
+    RETURN_IF_ERROR(build_result(table_ctx, &entry));
+    RET_CHECK(writer->Write(result)) << "Write to stream channel failed.";
+    return ::util::OkStatus();
+  }
+
+  // Wildcard read: the direct counters are stored with the table entries, so
+  // they are read in the same walk of the table map.
+  ASSIGN_OR_RETURN(auto iter_ctx, real_session->OpenTableContext(table_name));
+  nikss_table_entry_t* entry;
+  while ((entry = nikss_table_entry_get_next(&iter_ctx->ctx)) != nullptr) {
+    auto entry_cleanup =
+        absl::MakeCleanup([entry]() { nikss_table_entry_free(entry); });
+    RETURN_IF_ERROR(build_result(&iter_ctx->ctx, entry));
+    RET_CHECK(writer->Write(result)) << "Write to stream channel failed.";
+  }
+
+  return ::util::OkStatus();
+}
 
-  auto ctx = absl::make_unique<nikss_context_t>();
-  nikss_context_init(ctx.get());
-  nikss_context_set_pipeline(ctx.get(), static_cast<nikss_pipeline_id_t>(pipeline_id));
+::util::Status NikssWrapper::WriteMeter(
+    std::shared_ptr<NikssInterface::SessionInterface> session,
+    const ::p4::config::v1::Meter& meter,
+    const ::p4::v1::MeterEntry& meter_entry) {
+  auto real_session = std::dynamic_pointer_cast<Session>(session);
+  RET_CHECK(real_session);
+  RET_CHECK(meter_entry.has_index())
+      << "Writing all cells of a meter is not supported.";
+  ASSIGN_OR_RETURN(auto* meter_ctx,
+                   real_session->GetMeterContext(
+                       P4NameToNikssName(meter.preamble().name())));
 
-  if (nikss_pipeline_exists(ctx.get())) {
-    LOG(INFO) << "NIKSS pipeline already exists, re-pushing is not supported yet.";
+  nikss_meter_entry_t entry;
+  nikss_meter_entry_init(&entry);
+  auto entry_cleanup =
+      absl::MakeCleanup([&entry]() { nikss_meter_entry_free(&entry); });
+  const uint32 index = meter_entry.index().index();
+  RETURN_IF_NIKSS_ERROR(nikss_meter_entry_index(
+      &entry, reinterpret_cast<const char*>(&index), sizeof(index)));
+  if (!meter_entry.has_config()) {
+    RETURN_IF_NIKSS_ERROR(nikss_meter_ctx_reset(&meter_ctx->ctx, &entry));
     return ::util::OkStatus();
   }
+  RETURN_IF_ERROR(MeterConfigToNikssMeter(meter_entry.config(), &entry));
+  RETURN_IF_NIKSS_ERROR(nikss_meter_ctx_update(&meter_ctx->ctx, &entry));
+
+  return ::util::OkStatus();
+}
+
+::util::Status NikssWrapper::ReadMeter(
+    std::shared_ptr<NikssInterface::SessionInterface> session,
+    const ::p4::config::v1::Meter& meter,
+    const ::p4::v1::MeterEntry& meter_entry,
+    WriterInterface<::p4::v1::MeterEntry>* writer) {
+  auto real_session = std::dynamic_pointer_cast<Session>(session);
+  RET_CHECK(real_session);
+  RET_CHECK(writer) << "Writer must be non-null.";
+  ASSIGN_OR_RETURN(auto* meter_ctx,
+                   real_session->GetMeterContext(
+                       P4NameToNikssName(meter.preamble().name())));
+
+  ::p4::v1::MeterEntry result;
+  result.set_meter_id(meter.preamble().id());
+  auto read_cell = [&](uint32 index) -> ::util::Status {
+    nikss_meter_entry_t entry;
+    nikss_meter_entry_init(&entry);
+    auto entry_cleanup =
+        absl::MakeCleanup([&entry]() { nikss_meter_entry_free(&entry); });
+    RETURN_IF_NIKSS_ERROR(nikss_meter_entry_index(
+        &entry, reinterpret_cast<const char*>(&index), sizeof(index)));
+    RETURN_IF_NIKSS_ERROR(nikss_meter_ctx_get(&meter_ctx->ctx, &entry));
+    result.mutable_index()->set_index(index);
+    NikssMeterToMeterConfig(&entry, &result);
+    RET_CHECK(writer->Write(result)) << "Write to stream channel failed.";
+    return ::util::OkStatus();
+  };
+
+  if (meter_entry.has_index()) return read_cell(meter_entry.index().index());
+
+  // Wildcard read. NIKSS converts the token bucket state of each cell back into
+  // rates, so the cells are read one by one; meters are small compared to
+  // tables and registers.
+  for (int64 index = 0; index < meter.size(); ++index) {
+    RETURN_IF_ERROR(read_cell(index));
+  }
+
+  return ::util::OkStatus();
+}
+
+::util::Status NikssWrapper::WriteDirectMeter(
+    std::shared_ptr<NikssInterface::SessionInterface> session,
+    const ::p4::config::v1::Table& table,
+    const ::p4::config::v1::DirectMeter& direct_meter,
+    const ::p4::v1::DirectMeterEntry& direct_meter_entry) {
+  auto real_session = std::dynamic_pointer_cast<Session>(session);
+  RET_CHECK(real_session);
+  RET_CHECK(direct_meter_entry.table_entry().match_size())
+      << "Writing direct meters of all entries is not supported.";
+  ASSIGN_OR_RETURN(
+      auto* table_ctx,
+      real_session->GetTableContext(P4NameToNikssName(table.preamble().name())));
+
+  // The entry is read first, as NIKSS updates the action and the direct
+  // resources of an entry together.
+  nikss_table_entry_t entry;
+  nikss_table_entry_init(&entry);
+  auto entry_cleanup =
+      absl::MakeCleanup([&entry]() { nikss_table_entry_free(&entry); });
+  RETURN_IF_ERROR(
+      BuildTableKey(table, direct_meter_entry.table_entry(), &entry));
+  RETURN_IF_NIKSS_ERROR(nikss_table_entry_get(table_ctx, &entry));
+  ASSIGN_OR_RETURN(auto* dm_ctx,
+                   FindDirectMeter(table_ctx, &entry, direct_meter));
+
+  // A missing config resets the meter, i.e. all packets pass as green.
+  nikss_meter_entry_t meter;
+  nikss_meter_entry_init(&meter);
+  auto meter_cleanup =
+      absl::MakeCleanup([&meter]() { nikss_meter_entry_free(&meter); });
+  RETURN_IF_ERROR(
+      MeterConfigToNikssMeter(direct_meter_entry.config(), &meter));
+  RETURN_IF_NIKSS_ERROR(
+      nikss_table_entry_set_direct_meter(&entry, dm_ctx, &meter));
+  RETURN_IF_NIKSS_ERROR(nikss_table_entry_update(table_ctx, &entry));
+
+  return ::util::OkStatus();
+}
+
+::util::Status NikssWrapper::ReadDirectMeter(
+    std::shared_ptr<NikssInterface::SessionInterface> session,
+    const ::p4::config::v1::Table& table,
+    const ::p4::config::v1::DirectMeter& direct_meter,
+    const ::p4::v1::DirectMeterEntry& direct_meter_entry,
+    WriterInterface<::p4::v1::DirectMeterEntry>* writer) {
+  auto real_session = std::dynamic_pointer_cast<Session>(session);
+  RET_CHECK(real_session);
+  RET_CHECK(writer) << "Writer must be non-null.";
+  const std::string table_name = P4NameToNikssName(table.preamble().name());
+  ASSIGN_OR_RETURN(auto* table_ctx, real_session->GetTableContext(table_name));
+
+  // The result entry is reused for all entries to avoid re-allocations.
+  ::p4::v1::DirectMeterEntry result;
+  ::p4::v1::MeterEntry config;
+  auto build_result = [&](nikss_table_entry_ctx_t* ctx,
+                          nikss_table_entry_t* entry) -> ::util::Status {
+    result.Clear();
+    RETURN_IF_ERROR(BuildP4TableKey(entry, table, result.mutable_table_entry()));
+    ASSIGN_OR_RETURN(auto* dm_ctx, FindDirectMeter(ctx, entry, direct_meter));
+    nikss_meter_entry_t meter;
+    nikss_meter_entry_init(&meter);
+    auto meter_cleanup =
+        absl::MakeCleanup([&meter]() { nikss_meter_entry_free(&meter); });
+    RETURN_IF_NIKSS_ERROR(nikss_direct_meter_get_entry(dm_ctx, &meter));
+    NikssMeterToMeterConfig(&meter, &config);
+    if (config.has_config()) *result.mutable_config() = config.config();
+    return ::util::OkStatus();
+  };
+
+  if (direct_meter_entry.table_entry().match_size()) {
+    nikss_table_entry_t entry;
+    nikss_table_entry_init(&entry);
+    auto entry_cleanup =
+        absl::MakeCleanup([&entry]() { nikss_table_entry_free(&entry); });
+    RETURN_IF_ERROR(
+        BuildTableKey(table, direct_meter_entry.table_entry(), &entry));
+    RETURN_IF_NIKSS_ERROR(nikss_table_entry_get(table_ctx, &entry));
+    RETURN_IF_ERROR(build_result(table_ctx, &entry));
+    RET_CHECK(writer->Write(result)) << "Write to stream channel failed.";
+    return ::util::OkStatus();
+  }
+
+  // Wildcard read: the direct meters are stored with the table entries, so
+  // they are read in the same walk of the table map.
+  ASSIGN_OR_RETURN(auto iter_ctx, real_session->OpenTableContext(table_name));
+  nikss_table_entry_t* entry;
+  while ((entry = nikss_table_entry_get_next(&iter_ctx->ctx)) != nullptr) {
+    auto entry_cleanup =
+        absl::MakeCleanup([entry]() { nikss_table_entry_free(entry); });
+    RETURN_IF_ERROR(build_result(&iter_ctx->ctx, entry));
+    RET_CHECK(writer->Write(result)) << "Write to stream channel failed.";
+  }
+
+  return ::util::OkStatus();
+}
+
+::util::Status NikssWrapper::WriteRegister(
+    std::shared_ptr<NikssInterface::SessionInterface> session,
+    const ::p4::config::v1::Register& reg,
+    const ::p4::v1::RegisterEntry& register_entry) {
+  auto real_session = std::dynamic_pointer_cast<Session>(session);
+  RET_CHECK(real_session);
+  RET_CHECK(register_entry.has_index())
+      << "Writing all cells of a register is not supported.";
+  RET_CHECK(register_entry.data().has_bitstring())
+      << "Register " << reg.preamble().name()
+      << " only accepts bitstring data, got "
+      << register_entry.data().ShortDebugString() << ".";
+  ASSIGN_OR_RETURN(const int bitwidth, RegisterBitwidth(reg));
+  ASSIGN_OR_RETURN(auto* register_ctx,
+                   real_session->GetRegisterContext(
+                       P4NameToNikssName(reg.preamble().name())));
+
+  nikss_register_entry_t entry;
+  nikss_register_entry_init(&entry);
+  auto entry_cleanup =
+      absl::MakeCleanup([&entry]() { nikss_register_entry_free(&entry); });
+  const uint32 index = register_entry.index().index();
+  RETURN_IF_NIKSS_ERROR(
+      nikss_register_entry_set_key(&entry, &index, sizeof(index)));
+  std::string data = P4RuntimeByteStringToNikssData(
+      register_entry.data().bitstring(), bitwidth);
+  RETURN_IF_NIKSS_ERROR(
+      nikss_register_entry_set_value(&entry, data.data(), data.size()));
+  RETURN_IF_NIKSS_ERROR(nikss_register_set(&register_ctx->ctx, &entry));
+
+  return ::util::OkStatus();
+}
+
+::util::Status NikssWrapper::ReadRegister(
+    std::shared_ptr<NikssInterface::SessionInterface> session,
+    const ::p4::config::v1::Register& reg,
+    const ::p4::v1::RegisterEntry& register_entry,
+    WriterInterface<::p4::v1::RegisterEntry>* writer) {
+  auto real_session = std::dynamic_pointer_cast<Session>(session);
+  RET_CHECK(real_session);
+  RET_CHECK(writer) << "Writer must be non-null.";
+  ASSIGN_OR_RETURN(const int bitwidth, RegisterBitwidth(reg));
+  ASSIGN_OR_RETURN(auto* register_ctx,
+                   real_session->GetRegisterContext(
+                       P4NameToNikssName(reg.preamble().name())));
+
+  ::p4::v1::RegisterEntry result;
+  result.set_register_id(reg.preamble().id());
+  if (register_entry.has_index()) {
+    nikss_register_entry_t entry;
+    nikss_register_entry_init(&entry);
+    auto entry_cleanup =
+        absl::MakeCleanup([&entry]() { nikss_register_entry_free(&entry); });
+    const uint32 index = register_entry.index().index();
+    RETURN_IF_NIKSS_ERROR(
+        nikss_register_entry_set_key(&entry, &index, sizeof(index)));
+    RETURN_IF_NIKSS_ERROR(nikss_register_get(&register_ctx->ctx, &entry));
+    nikss_struct_field_t* field =
+        nikss_register_entry_get_next_value_field(&register_ctx->ctx, &entry);
+    RET_CHECK(field) << "NIKSS entry of register " << reg.preamble().name()
+                     << " has no value.";
+    result.mutable_index()->set_index(index);
+    result.mutable_data()->set_bitstring(NikssDataToP4RuntimeByteString(
+        nikss_struct_get_field_data(field),
+        nikss_struct_get_field_data_len(field), bitwidth));
+    RET_CHECK(writer->Write(result)) << "Write to stream channel failed.";
+    return ::util::OkStatus();
+  }
+
+  // Wildcard read: a single batched lookup of the whole register array.
+  const auto& map = register_ctx->ctx.reg;
+  ArrayMapSnapshot snapshot;
+  RETURN_IF_ERROR(SnapshotArrayMap(map, &snapshot));
+  RET_CHECK(snapshot.num_values == 1)
+      << "Per-CPU register " << reg.preamble().name() << " is not supported.";
+  for (size_t i = 0; i < snapshot.count; ++i) {
+    result.mutable_index()->set_index(snapshot.keys[i]);
+    result.mutable_data()->set_bitstring(NikssDataToP4RuntimeByteString(
+        snapshot.value(i, 0), map.value_size, bitwidth));
+    RET_CHECK(writer->Write(result)) << "Write to stream channel failed.";
+  }
+
+  return ::util::OkStatus();
+}
+
+::util::Status NikssWrapper::WriteValueSet(
+    std::shared_ptr<NikssInterface::SessionInterface> session,
+    const ::p4::config::v1::ValueSet& value_set,
+    const ::p4::v1::ValueSetEntry& value_set_entry) {
+  auto real_session = std::dynamic_pointer_cast<Session>(session);
+  RET_CHECK(real_session);
+  if (value_set.size() > 0 &&
+      value_set_entry.members_size() > value_set.size()) {
+    return MAKE_ERROR(ERR_TABLE_FULL)
+           << "Value set " << value_set.preamble().name() << " holds at most "
+           << value_set.size() << " members, got "
+           << value_set_entry.members_size() << ".";
+  }
+  ASSIGN_OR_RETURN(auto value_set_ctx,
+                   real_session->OpenValueSetContext(
+                       P4NameToNikssName(value_set.preamble().name())));
+
+  // The write replaces the whole set. Only the difference to the installed
+  // members is written, so that members kept by the write never disappear
+  // from the data plane.
+  std::vector<::p4::v1::ValueSetMember> installed;
+  nikss_value_set_entry_t* current;
+  while ((current = nikss_value_set_get_next_entry(&value_set_ctx->ctx)) !=
+         nullptr) {
+    auto current_cleanup =
+        absl::MakeCleanup([current]() { nikss_value_set_entry_free(current); });
+    installed.emplace_back();
+    RETURN_IF_ERROR(
+        BuildP4ValueSetMember(current, value_set, &installed.back()));
+  }
+  auto diff = DiffValueSetMembers(value_set, installed, value_set_entry);
+
+  // Stale members are removed first to make room for the new ones.
+  for (const auto& member : diff.to_delete) {
+    nikss_value_set_entry_t entry;
+    nikss_value_set_entry_init(&entry);
+    auto entry_cleanup =
+        absl::MakeCleanup([&entry]() { nikss_value_set_entry_free(&entry); });
+    RETURN_IF_ERROR(BuildValueSetEntry(value_set, member, &entry));
+    RETURN_IF_NIKSS_ERROR(
+        nikss_value_set_delete(&value_set_ctx->ctx, &entry));
+  }
+  for (const auto& member : diff.to_insert) {
+    nikss_value_set_entry_t entry;
+    nikss_value_set_entry_init(&entry);
+    auto entry_cleanup =
+        absl::MakeCleanup([&entry]() { nikss_value_set_entry_free(&entry); });
+    RETURN_IF_ERROR(BuildValueSetEntry(value_set, member, &entry));
+    RETURN_IF_NIKSS_ERROR(
+        nikss_value_set_insert(&value_set_ctx->ctx, &entry));
+  }
+
+  return ::util::OkStatus();
+}
+
+::util::Status NikssWrapper::ReadValueSet(
+    std::shared_ptr<NikssInterface::SessionInterface> session,
+    const ::p4::config::v1::ValueSet& value_set,
+    ::p4::v1::ValueSetEntry* value_set_entry) {
+  auto real_session = std::dynamic_pointer_cast<Session>(session);
+  RET_CHECK(real_session);
+  RET_CHECK(value_set_entry) << "Value set entry must be non-null.";
+  ASSIGN_OR_RETURN(auto value_set_ctx,
+                   real_session->OpenValueSetContext(
+                       P4NameToNikssName(value_set.preamble().name())));
 
-  RETURN_IF_NIKSS_ERROR(nikss_pipeline_load(ctx.get(), tmp_filepath.c_str()));
-  RemoveFile(tmp_filepath);
+  value_set_entry->Clear();
+  value_set_entry->set_value_set_id(value_set.preamble().id());
+  nikss_value_set_entry_t* entry;
+  while ((entry = nikss_value_set_get_next_entry(&value_set_ctx->ctx)) !=
+         nullptr) {
+    auto entry_cleanup =
+        absl::MakeCleanup([entry]() { nikss_value_set_entry_free(entry); });
+    RETURN_IF_ERROR(BuildP4ValueSetMember(entry, value_set,
+                                          value_set_entry->add_members()));
+  }
+
+  return ::util::OkStatus();
+}
+
+::util::StatusOr<uint32> NikssWrapper::InsertActionProfileMember(
+    std::shared_ptr<NikssInterface::SessionInterface> session,
+    const ::p4::config::v1::ActionProfile& action_profile,
+    const ::p4::config::v1::Action& action_info,
+    const ::p4::v1::Action& action) {
+  auto real_session = std::dynamic_pointer_cast<Session>(session);
+  RET_CHECK(real_session);
+  ASSIGN_OR_RETURN(auto selector_name, ActionSelectorName(action_profile));
+  ASSIGN_OR_RETURN(auto* selector_ctx,
+                   real_session->GetActionSelectorContext(selector_name));
+
+  nikss_action_selector_member_context_t member;
+  nikss_action_selector_member_init(&member);
+  auto member_cleanup = absl::MakeCleanup(
+      [&member]() { nikss_action_selector_member_free(&member); });
+  RETURN_IF_ERROR(
+      BuildSelectorMember(&selector_ctx->ctx, action_info, action, &member));
+  RETURN_IF_NIKSS_ERROR(
+      nikss_action_selector_add_member(&selector_ctx->ctx, &member));
+
+  return nikss_action_selector_get_member_reference(&member);
+}
+
+::util::Status NikssWrapper::ModifyActionProfileMember(
+    std::shared_ptr<NikssInterface::SessionInterface> session,
+    const ::p4::config::v1::ActionProfile& action_profile,
+    const ::p4::config::v1::Action& action_info,
+    const ::p4::v1::Action& action, uint32 member_ref) {
+  auto real_session = std::dynamic_pointer_cast<Session>(session);
+  RET_CHECK(real_session);
+  ASSIGN_OR_RETURN(auto selector_name, ActionSelectorName(action_profile));
+  ASSIGN_OR_RETURN(auto* selector_ctx,
+                   real_session->GetActionSelectorContext(selector_name));
+
+  nikss_action_selector_member_context_t member;
+  nikss_action_selector_member_init(&member);
+  auto member_cleanup = absl::MakeCleanup(
+      [&member]() { nikss_action_selector_member_free(&member); });
+  nikss_action_selector_set_member_reference(&member, member_ref);
+  RETURN_IF_ERROR(
+      BuildSelectorMember(&selector_ctx->ctx, action_info, action, &member));
+  RETURN_IF_NIKSS_ERROR(
+      nikss_action_selector_update_member(&selector_ctx->ctx, &member));
+
+  return ::util::OkStatus();
+}
+
+::util::Status NikssWrapper::DeleteActionProfileMember(
+    std::shared_ptr<NikssInterface::SessionInterface> session,
+    const ::p4::config::v1::ActionProfile& action_profile,
+    uint32 member_ref) {
+  auto real_session = std::dynamic_pointer_cast<Session>(session);
+  RET_CHECK(real_session);
+  ASSIGN_OR_RETURN(auto selector_name, ActionSelectorName(action_profile));
+  ASSIGN_OR_RETURN(auto* selector_ctx,
+                   real_session->GetActionSelectorContext(selector_name));
+
+  nikss_action_selector_member_context_t member;
+  nikss_action_selector_member_init(&member);
+  auto member_cleanup = absl::MakeCleanup(
+      [&member]() { nikss_action_selector_member_free(&member); });
+  nikss_action_selector_set_member_reference(&member, member_ref);
+  RETURN_IF_NIKSS_ERROR(
+      nikss_action_selector_del_member(&selector_ctx->ctx, &member));
+
+  return ::util::OkStatus();
+}
+
+::util::StatusOr<uint32> NikssWrapper::InsertActionProfileGroup(
+    std::shared_ptr<NikssInterface::SessionInterface> session,
+    const ::p4::config::v1::ActionProfile& action_profile) {
+  auto real_session = std::dynamic_pointer_cast<Session>(session);
+  RET_CHECK(real_session);
+  ASSIGN_OR_RETURN(auto selector_name, ActionSelectorName(action_profile));
+  ASSIGN_OR_RETURN(auto* selector_ctx,
+                   real_session->GetActionSelectorContext(selector_name));
+
+  nikss_action_selector_group_context_t group;
+  nikss_action_selector_group_init(&group);
+  auto group_cleanup = absl::MakeCleanup(
+      [&group]() { nikss_action_selector_group_free(&group); });
+  RETURN_IF_NIKSS_ERROR(
+      nikss_action_selector_add_group(&selector_ctx->ctx, &group));
+
+  return nikss_action_selector_get_group_reference(&group);
+}
+
+::util::Status NikssWrapper::DeleteActionProfileGroup(
+    std::shared_ptr<NikssInterface::SessionInterface> session,
+    const ::p4::config::v1::ActionProfile& action_profile, uint32 group_ref) {
+  auto real_session = std::dynamic_pointer_cast<Session>(session);
+  RET_CHECK(real_session);
+  ASSIGN_OR_RETURN(auto selector_name, ActionSelectorName(action_profile));
+  ASSIGN_OR_RETURN(auto* selector_ctx,
+                   real_session->GetActionSelectorContext(selector_name));
+
+  nikss_action_selector_group_context_t group;
+  nikss_action_selector_group_init(&group);
+  auto group_cleanup = absl::MakeCleanup(
+      [&group]() { nikss_action_selector_group_free(&group); });
+  nikss_action_selector_set_group_reference(&group, group_ref);
+  RETURN_IF_NIKSS_ERROR(
+      nikss_action_selector_del_group(&selector_ctx->ctx, &group));
+
+  return ::util::OkStatus();
+}
+
+::util::Status NikssWrapper::AddActionProfileGroupMember(
+    std::shared_ptr<NikssInterface::SessionInterface> session,
+    const ::p4::config::v1::ActionProfile& action_profile, uint32 group_ref,
+    uint32 member_ref) {
+  auto real_session = std::dynamic_pointer_cast<Session>(session);
+  RET_CHECK(real_session);
+  ASSIGN_OR_RETURN(auto selector_name, ActionSelectorName(action_profile));
+  ASSIGN_OR_RETURN(auto* selector_ctx,
+                   real_session->GetActionSelectorContext(selector_name));
+
+  nikss_action_selector_group_context_t group;
+  nikss_action_selector_group_init(&group);
+  auto group_cleanup = absl::MakeCleanup(
+      [&group]() { nikss_action_selector_group_free(&group); });
+  nikss_action_selector_set_group_reference(&group, group_ref);
+  nikss_action_selector_member_context_t member;
+  nikss_action_selector_member_init(&member);
+  auto member_cleanup = absl::MakeCleanup(
+      [&member]() { nikss_action_selector_member_free(&member); });
+  nikss_action_selector_set_member_reference(&member, member_ref);
+  // A single update of the group map, the other members stay in place.
+  RETURN_IF_NIKSS_ERROR(nikss_action_selector_add_member_to_group(
+      &selector_ctx->ctx, &group, &member));
+
+  return ::util::OkStatus();
+}
+
+::util::Status NikssWrapper::RemoveActionProfileGroupMember(
+    std::shared_ptr<NikssInterface::SessionInterface> session,
+    const ::p4::config::v1::ActionProfile& action_profile, uint32 group_ref,
+    uint32 member_ref) {
+  auto real_session = std::dynamic_pointer_cast<Session>(session);
+  RET_CHECK(real_session);
+  ASSIGN_OR_RETURN(auto selector_name, ActionSelectorName(action_profile));
+  ASSIGN_OR_RETURN(auto* selector_ctx,
+                   real_session->GetActionSelectorContext(selector_name));
+
+  nikss_action_selector_group_context_t group;
+  nikss_action_selector_group_init(&group);
+  auto group_cleanup = absl::MakeCleanup(
+      [&group]() { nikss_action_selector_group_free(&group); });
+  nikss_action_selector_set_group_reference(&group, group_ref);
+  nikss_action_selector_member_context_t member;
+  nikss_action_selector_member_init(&member);
+  auto member_cleanup = absl::MakeCleanup(
+      [&member]() { nikss_action_selector_member_free(&member); });
+  nikss_action_selector_set_member_reference(&member, member_ref);
+  RETURN_IF_NIKSS_ERROR(nikss_action_selector_del_member_from_group(
+      &selector_ctx->ctx, &group, &member));
+
+  return ::util::OkStatus();
+}
+
+::util::Status NikssWrapper::ReadActionProfileMembers(
+    std::shared_ptr<NikssInterface::SessionInterface> session,
+    const ::p4::config::v1::ActionProfile& action_profile,
+    const std::vector<::p4::config::v1::Action>& actions,
+    std::vector<std::pair<uint32, ::p4::v1::Action>>* members) {
+  auto real_session = std::dynamic_pointer_cast<Session>(session);
+  RET_CHECK(real_session);
+  RET_CHECK(members) << "Members must be non-null.";
+  ASSIGN_OR_RETURN(auto selector_name, ActionSelectorName(action_profile));
+  ASSIGN_OR_RETURN(auto iter_ctx,
+                   real_session->OpenActionSelectorContext(selector_name));
+  absl::flat_hash_map<uint32, const ::p4::config::v1::Action*>
+      nikss_id_to_action;
+  for (const auto& action : actions) {
+    nikss_id_to_action[nikss_action_selector_get_action_id_by_name(
+        &iter_ctx->ctx, action.preamble().name().c_str())] = &action;
+  }
+
+  nikss_action_selector_member_context_t* member;
+  while ((member = nikss_action_selector_get_next_member(&iter_ctx->ctx)) !=
+         nullptr) {
+    auto member_cleanup = absl::MakeCleanup(
+        [member]() { nikss_action_selector_member_free(member); });
+    const uint32 nikss_action_id =
+        nikss_action_selector_get_member_action_id(&iter_ctx->ctx, member);
+    const auto* action_info =
+        gtl::FindPtrOrNull(nikss_id_to_action, nikss_action_id);
+    RET_CHECK(action_info) << "Unknown NIKSS action ID " << nikss_action_id
+                           << " in action selector "
+                           << action_profile.preamble().name() << ".";
+    ::p4::v1::Action action;
+    action.set_action_id(action_info->preamble().id());
+    int param_index = 0;
+    nikss_action_param_t* param;
+    while ((param = nikss_action_selector_action_param_get_next(member)) !=
+           nullptr) {
+      auto param_cleanup =
+          absl::MakeCleanup([param]() { nikss_action_param_free(param); });
+      RET_CHECK(param_index < action_info->params_size())
+          << "NIKSS action " << action_info->preamble().name()
+          << " has more parameters than the P4Info.";
+      const auto& param_info = action_info->params(param_index++);
+      auto* p4_param = action.add_params();
+      p4_param->set_param_id(param_info.id());
+      p4_param->set_value(NikssDataToP4RuntimeByteString(
+          nikss_action_param_get_data(param),
+          nikss_action_param_get_data_len(param), param_info.bitwidth()));
+    }
+    members->emplace_back(nikss_action_selector_get_member_reference(member),
+                          std::move(action));
+  }
+
+  return ::util::OkStatus();
+}
+
+::util::Status NikssWrapper::ReadActionProfileGroups(
+    std::shared_ptr<NikssInterface::SessionInterface> session,
+    const ::p4::config::v1::ActionProfile& action_profile,
+    std::vector<std::pair<uint32, std::vector<uint32>>>* groups) {
+  auto real_session = std::dynamic_pointer_cast<Session>(session);
+  RET_CHECK(real_session);
+  RET_CHECK(groups) << "Groups must be non-null.";
+  ASSIGN_OR_RETURN(auto selector_name, ActionSelectorName(action_profile));
+  ASSIGN_OR_RETURN(auto iter_ctx,
+                   real_session->OpenActionSelectorContext(selector_name));
+
+  nikss_action_selector_group_context_t* group;
+  while ((group = nikss_action_selector_get_next_group(&iter_ctx->ctx)) !=
+         nullptr) {
+    auto group_cleanup = absl::MakeCleanup(
+        [group]() { nikss_action_selector_group_free(group); });
+    std::vector<uint32> member_refs;
+    nikss_action_selector_member_context_t* member;
+    while ((member = nikss_action_selector_get_next_group_member(
+                &iter_ctx->ctx, group)) != nullptr) {
+      member_refs.push_back(nikss_action_selector_get_member_reference(member));
+      nikss_action_selector_member_free(member);
+    }
+    groups->emplace_back(nikss_action_selector_get_group_reference(group),
+                         std::move(member_refs));
+  }
+
+  return ::util::OkStatus();
+}
+
+::util::Status NikssWrapper::ReadDigests(
+    std::shared_ptr<NikssInterface::SessionInterface> session,
+    const ::p4::config::v1::Digest& digest, const std::vector<int>& bitwidths,
+    size_t max_digests, std::vector<::p4::v1::P4Data>* digests) {
+  auto real_session = std::dynamic_pointer_cast<Session>(session);
+  RET_CHECK(real_session);
+  RET_CHECK(digests) << "Digests must be non-null.";
+  ASSIGN_OR_RETURN(auto* digest_ctx,
+                   real_session->GetDigestContext(
+                       P4NameToNikssName(digest.preamble().name())));
+  const bool is_struct = digest.type_spec().has_struct_();
+
+  for (size_t n = 0; n < max_digests; ++n) {
+    nikss_digest_t nikss_digest;
+    // The queue is drained until NIKSS reports that it is empty.
+    const int ret = nikss_digest_get_next(&digest_ctx->ctx, &nikss_digest);
+    if (ret == ENOENT) break;
+    RETURN_IF_NIKSS_ERROR(ret);
+    auto digest_cleanup = absl::MakeCleanup(
+        [&nikss_digest]() { nikss_digest_free(&nikss_digest); });
+
+    ::p4::v1::P4Data data;
+    size_t num_fields = 0;
+    nikss_struct_field_t* field;
+    while ((field = nikss_digest_get_next_field(&digest_ctx->ctx,
+                                                &nikss_digest)) != nullptr) {
+      RET_CHECK(num_fields < bitwidths.size())
+          << "Digest " << digest.preamble().name() << " has more than "
+          << bitwidths.size() << " fields.";
+      std::string value = NikssDataToP4RuntimeByteString(
+          nikss_struct_get_field_data(field),
+          nikss_struct_get_field_data_len(field), bitwidths[num_fields++]);
+      if (is_struct) {
+        data.mutable_struct_()->add_members()->set_bitstring(std::move(value));
+      } else {
+        data.set_bitstring(std::move(value));
+      }
+    }
+    RET_CHECK(num_fields == bitwidths.size())
+        << "Digest " << digest.preamble().name() << " has " << num_fields
+        << " fields, expected " << bitwidths.size() << ".";
+    digests->push_back(std::move(data));
+  }
+
+  return ::util::OkStatus();
+}
+
+::util::Status NikssWrapper::InsertMulticastGroup(
+    std::shared_ptr<NikssInterface::SessionInterface> session,
+    uint32 group_id) {
+  auto real_session = std::dynamic_pointer_cast<Session>(session);
+  RET_CHECK(real_session);
+  MulticastGroupContext group(group_id);
+  if (nikss_mcast_grp_exists(real_session->nikss_ctx_, &group.ctx)) {
+    return MAKE_ERROR(ERR_ENTRY_EXISTS)
+           << "Multicast group " << group_id << " already exists.";
+  }
+  RETURN_IF_NIKSS_ERROR(
+      nikss_mcast_grp_create(real_session->nikss_ctx_, &group.ctx));
+
+  return ::util::OkStatus();
+}
+
+::util::Status NikssWrapper::DeleteMulticastGroup(
+    std::shared_ptr<NikssInterface::SessionInterface> session,
+    uint32 group_id) {
+  auto real_session = std::dynamic_pointer_cast<Session>(session);
+  RET_CHECK(real_session);
+  MulticastGroupContext group(group_id);
+  if (!nikss_mcast_grp_exists(real_session->nikss_ctx_, &group.ctx)) {
+    return MAKE_ERROR(ERR_ENTRY_NOT_FOUND)
+           << "Multicast group " << group_id << " does not exist.";
+  }
+  RETURN_IF_NIKSS_ERROR(
+      nikss_mcast_grp_delete(real_session->nikss_ctx_, &group.ctx));
+
+  return ::util::OkStatus();
+}
+
+::util::Status NikssWrapper::AddMulticastGroupReplica(
+    std::shared_ptr<NikssInterface::SessionInterface> session,
+    uint32 group_id, const ::p4::v1::Replica& replica) {
+  auto real_session = std::dynamic_pointer_cast<Session>(session);
+  RET_CHECK(real_session);
+  MulticastGroupContext group(group_id);
+  MulticastGroupMember member(replica);
+  RETURN_IF_NIKSS_ERROR(nikss_mcast_grp_member_update(
+      real_session->nikss_ctx_, &group.ctx, &member.member));
+
+  return ::util::OkStatus();
+}
+
+::util::Status NikssWrapper::RemoveMulticastGroupReplica(
+    std::shared_ptr<NikssInterface::SessionInterface> session,
+    uint32 group_id, const ::p4::v1::Replica& replica) {
+  auto real_session = std::dynamic_pointer_cast<Session>(session);
+  RET_CHECK(real_session);
+  MulticastGroupContext group(group_id);
+  MulticastGroupMember member(replica);
+  RETURN_IF_NIKSS_ERROR(nikss_mcast_grp_member_delete(
+      real_session->nikss_ctx_, &group.ctx, &member.member));
+
+  return ::util::OkStatus();
+}
+
+::util::Status NikssWrapper::ReadMulticastGroups(
+    std::shared_ptr<NikssInterface::SessionInterface> session,
+    uint32 group_id, std::vector<::p4::v1::MulticastGroupEntry>* groups) {
+  auto real_session = std::dynamic_pointer_cast<Session>(session);
+  RET_CHECK(real_session);
+  RET_CHECK(groups) << "Groups must be non-null.";
+  nikss_context_t* ctx = real_session->nikss_ctx_;
+  if (group_id != 0) {
+    MulticastGroupContext group(group_id);
+    if (!nikss_mcast_grp_exists(ctx, &group.ctx)) {
+      return MAKE_ERROR(ERR_ENTRY_NOT_FOUND)
+             << "Multicast group " << group_id << " does not exist.";
+    }
+    groups->emplace_back();
+    BuildMulticastGroupEntry(ctx, &group.ctx, &groups->back());
+    return ::util::OkStatus();
+  }
+
+  nikss_mcast_grp_list_t list;
+  RETURN_IF_NIKSS_ERROR(nikss_mcast_grp_list_init(ctx, &list));
+  auto list_cleanup =
+      absl::MakeCleanup([&list]() { nikss_mcast_grp_list_free(&list); });
+  // The group contexts are owned by the list.
+  nikss_mcast_grp_ctx_t* group;
+  while ((group = nikss_mcast_grp_get_next_id(&list)) != nullptr) {
+    groups->emplace_back();
+    BuildMulticastGroupEntry(ctx, group, &groups->back());
+  }
+
+  return ::util::OkStatus();
+}
+
+::util::Status NikssWrapper::InsertCloneSession(
+    std::shared_ptr<NikssInterface::SessionInterface> session,
+    uint32 session_id) {
+  auto real_session = std::dynamic_pointer_cast<Session>(session);
+  RET_CHECK(real_session);
+  CloneSessionContext clone_session(session_id);
+  if (nikss_clone_session_exists(real_session->nikss_ctx_,
+                                 &clone_session.ctx)) {
+    return MAKE_ERROR(ERR_ENTRY_EXISTS)
+           << "Clone session " << session_id << " already exists.";
+  }
+  RETURN_IF_NIKSS_ERROR(
+      nikss_clone_session_create(real_session->nikss_ctx_, &clone_session.ctx));
+
+  return ::util::OkStatus();
+}
+
+::util::Status NikssWrapper::DeleteCloneSession(
+    std::shared_ptr<NikssInterface::SessionInterface> session,
+    uint32 session_id) {
+  auto real_session = std::dynamic_pointer_cast<Session>(session);
+  RET_CHECK(real_session);
+  CloneSessionContext clone_session(session_id);
+  if (!nikss_clone_session_exists(real_session->nikss_ctx_,
+                                  &clone_session.ctx)) {
+    return MAKE_ERROR(ERR_ENTRY_NOT_FOUND)
+           << "Clone session " << session_id << " does not exist.";
+  }
+  RETURN_IF_NIKSS_ERROR(
+      nikss_clone_session_delete(real_session->nikss_ctx_, &clone_session.ctx));
+
+  return ::util::OkStatus();
+}
+
+::util::Status NikssWrapper::AddCloneSessionReplica(
+    std::shared_ptr<NikssInterface::SessionInterface> session,
+    const ::p4::v1::CloneSessionEntry& clone_session_entry,
+    const ::p4::v1::Replica& replica) {
+  auto real_session = std::dynamic_pointer_cast<Session>(session);
+  RET_CHECK(real_session);
+  CloneSessionContext clone_session(clone_session_entry.session_id());
+  CloneSessionReplica entry(replica);
+  nikss_clone_session_entry_set_cos(&entry.entry,
+                                    clone_session_entry.class_of_service());
+  if (clone_session_entry.packet_length_bytes() > 0) {
+    nikss_clone_session_entry_set_truncate(
+        &entry.entry, clone_session_entry.packet_length_bytes());
+  }
+  RETURN_IF_NIKSS_ERROR(nikss_clone_session_entry_update(
+      real_session->nikss_ctx_, &clone_session.ctx, &entry.entry));
+
+  return ::util::OkStatus();
+}
+
+::util::Status NikssWrapper::RemoveCloneSessionReplica(
+    std::shared_ptr<NikssInterface::SessionInterface> session,
+    uint32 session_id, const ::p4::v1::Replica& replica) {
+  auto real_session = std::dynamic_pointer_cast<Session>(session);
+  RET_CHECK(real_session);
+  CloneSessionContext clone_session(session_id);
+  CloneSessionReplica entry(replica);
+  RETURN_IF_NIKSS_ERROR(nikss_clone_session_entry_delete(
+      real_session->nikss_ctx_, &clone_session.ctx, &entry.entry));
+
+  return ::util::OkStatus();
+}
+
+::util::Status NikssWrapper::ReadCloneSessions(
+    std::shared_ptr<NikssInterface::SessionInterface> session,
+    uint32 session_id,
+    std::vector<::p4::v1::CloneSessionEntry>* clone_sessions) {
+  auto real_session = std::dynamic_pointer_cast<Session>(session);
+  RET_CHECK(real_session);
+  RET_CHECK(clone_sessions) << "Clone sessions must be non-null.";
+  nikss_context_t* ctx = real_session->nikss_ctx_;
+  if (session_id != 0) {
+    CloneSessionContext clone_session(session_id);
+    if (!nikss_clone_session_exists(ctx, &clone_session.ctx)) {
+      return MAKE_ERROR(ERR_ENTRY_NOT_FOUND)
+             << "Clone session " << session_id << " does not exist.";
+    }
+    clone_sessions->emplace_back();
+    BuildCloneSessionEntry(ctx, &clone_session.ctx, &clone_sessions->back());
+    return ::util::OkStatus();
+  }
+
+  nikss_clone_session_list_t list;
+  RETURN_IF_NIKSS_ERROR(nikss_clone_session_list_init(ctx, &list));
+  auto list_cleanup =
+      absl::MakeCleanup([&list]() { nikss_clone_session_list_free(&list); });
+  // The clone session contexts are owned by the list.
+  nikss_clone_session_ctx_t* clone_session;
+  while ((clone_session = nikss_clone_session_get_next_id(&list)) != nullptr) {
+    clone_sessions->emplace_back();
+    BuildCloneSessionEntry(ctx, clone_session, &clone_sessions->back());
+  }
 
   return ::util::OkStatus();
 }
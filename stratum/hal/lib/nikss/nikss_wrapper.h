@@ -1,12 +1,20 @@
 #ifndef STRATUM_HAL_LIB_NIKSS_NIKSS_WRAPPER_H_
 #define STRATUM_HAL_LIB_NIKSS_NIKSS_WRAPPER_H_
 
+#include <memory>
+#include <set>
 #include <string>
+#include <utility>
+#include <vector>
 
+#include "absl/container/flat_hash_map.h"
 #include "absl/synchronization/mutex.h"
 #include "stratum/glue/status/status.h"
+#include "stratum/glue/status/statusor.h"
 #include "stratum/hal/lib/nikss/nikss_interface.h"
 
+#include <nikss/nikss.h>
+
 namespace stratum {
 namespace hal {
 namespace nikss {
@@ -15,9 +23,310 @@ namespace nikss {
 // to talk to the Linux eBPF subsystem via the NIKSS APIs calls.
 class NikssWrapper : public NikssInterface {
  public:
+  // Wrapper around a NIKSS table context. Opening a table context looks up
+  // the pinned BPF maps and parses their BTF, so it is done at most once per
+  // table and session.
+  struct TableContext {
+    TableContext() { nikss_table_entry_ctx_init(&ctx); }
+    ~TableContext() { nikss_table_entry_ctx_free(&ctx); }
+    nikss_table_entry_ctx_t ctx;
+  };
+
+  // Wrapper around a NIKSS counter context.
+  struct CounterContext {
+    CounterContext() { nikss_counter_ctx_init(&ctx); }
+    ~CounterContext() { nikss_counter_ctx_free(&ctx); }
+    nikss_counter_context_t ctx;
+  };
+
+  // Wrapper around a NIKSS meter context.
+  struct MeterContext {
+    MeterContext() { nikss_meter_ctx_init(&ctx); }
+    ~MeterContext() { nikss_meter_ctx_free(&ctx); }
+    nikss_meter_ctx_t ctx;
+  };
+
+  // Wrapper around a NIKSS register context.
+  struct RegisterContext {
+    RegisterContext() { nikss_register_ctx_init(&ctx); }
+    ~RegisterContext() { nikss_register_ctx_free(&ctx); }
+    nikss_register_context_t ctx;
+  };
+
+  // Wrapper around a NIKSS value set context.
+  struct ValueSetContext {
+    ValueSetContext() { nikss_value_set_context_init(&ctx); }
+    ~ValueSetContext() { nikss_value_set_context_free(&ctx); }
+    nikss_value_set_context_t ctx;
+  };
+
+  // Wrapper around a NIKSS action selector context.
+  struct ActionSelectorContext {
+    ActionSelectorContext() { nikss_action_selector_ctx_init(&ctx); }
+    ~ActionSelectorContext() { nikss_action_selector_ctx_free(&ctx); }
+    nikss_action_selector_context_t ctx;
+  };
+
+  // Wrapper around a NIKSS digest context.
+  struct DigestContext {
+    DigestContext() { nikss_digest_ctx_init(&ctx); }
+    ~DigestContext() { nikss_digest_ctx_free(&ctx); }
+    nikss_digest_context_t ctx;
+  };
+
+  class Session : public NikssInterface::SessionInterface {
+   public:
+    ~Session() override {}
+
+    // Returns the context of the given table, opening it on first use.
+    ::util::StatusOr<nikss_table_entry_ctx_t*> GetTableContext(
+        const std::string& table_name);
+
+    // Returns the context of the given counter, opening it on first use.
+    ::util::StatusOr<CounterContext*> GetCounterContext(
+        const std::string& counter_name);
+
+    // Returns the context of the given meter, opening it on first use.
+    ::util::StatusOr<MeterContext*> GetMeterContext(
+        const std::string& meter_name);
+
+    // Returns the context of the given register, opening it on first use.
+    ::util::StatusOr<RegisterContext*> GetRegisterContext(
+        const std::string& register_name);
+
+    // Returns the context of the given action selector, opening it on first
+    // use.
+    ::util::StatusOr<ActionSelectorContext*> GetActionSelectorContext(
+        const std::string& action_selector_name);
+
+    // Returns the context of the given digest, opening it on first use.
+    ::util::StatusOr<DigestContext*> GetDigestContext(
+        const std::string& digest_name);
+
+    // Opens a new context of the given meter, register or value set. Used to
+    // iterate over them, as the NIKSS contexts carry the iterator state.
+    ::util::StatusOr<std::unique_ptr<MeterContext>> OpenMeterContext(
+        const std::string& meter_name);
+    ::util::StatusOr<std::unique_ptr<RegisterContext>> OpenRegisterContext(
+        const std::string& register_name);
+    ::util::StatusOr<std::unique_ptr<ValueSetContext>> OpenValueSetContext(
+        const std::string& value_set_name);
+    ::util::StatusOr<std::unique_ptr<ActionSelectorContext>>
+    OpenActionSelectorContext(const std::string& action_selector_name);
+
+    // Opens a new context of the given table which is not shared with other
+    // operations of the session. Used to iterate over tables, as a NIKSS
+    // table context carries the iterator state.
+    ::util::StatusOr<std::unique_ptr<TableContext>> OpenTableContext(
+        const std::string& table_name);
+
+    static ::util::StatusOr<std::shared_ptr<NikssInterface::SessionInterface>>
+    CreateSession(std::shared_ptr<nikss_context_t> pipeline_ctx);
+
+    // Pipeline context the session operates on. The session shares the
+    // ownership, so that a long-lived session stays valid if the pipeline is
+    // replaced meanwhile.
+    const std::shared_ptr<nikss_context_t> pipeline_ctx_;
+    nikss_context_t* const nikss_ctx_;
+
+   private:
+    // Private constructor. Use CreateSession() instead.
+    explicit Session(std::shared_ptr<nikss_context_t> pipeline_ctx)
+        : pipeline_ctx_(std::move(pipeline_ctx)),
+          nikss_ctx_(pipeline_ctx_.get()) {}
+
+    // Map from NIKSS table name to the table context opened in this session.
+    absl::flat_hash_map<std::string, std::unique_ptr<TableContext>>
+        table_contexts_;
+
+    // Map from NIKSS counter name to the counter context opened in this
+    // session.
+    absl::flat_hash_map<std::string, std::unique_ptr<CounterContext>>
+        counter_contexts_;
+
+    // Map from NIKSS meter name to the meter context opened in this session.
+    absl::flat_hash_map<std::string, std::unique_ptr<MeterContext>>
+        meter_contexts_;
+
+    // Map from NIKSS register name to the register context opened in this
+    // session.
+    absl::flat_hash_map<std::string, std::unique_ptr<RegisterContext>>
+        register_contexts_;
+
+    // Map from NIKSS action selector name to the action selector context
+    // opened in this session.
+    absl::flat_hash_map<std::string, std::unique_ptr<ActionSelectorContext>>
+        action_selector_contexts_;
+
+    // Map from NIKSS digest name to the digest context opened in this session.
+    absl::flat_hash_map<std::string, std::unique_ptr<DigestContext>>
+        digest_contexts_;
+  };
+
   // NikssInterface public methods.
   ::util::Status AddPipeline(int pipeline_id,
-                             const std::string filepath) override;
+                             const std::string& bpf_obj) override
+      LOCKS_EXCLUDED(data_lock_);
+  ::util::Status LoadStandbyPipeline(int pipeline_id,
+                                     const std::string& bpf_obj) override
+      LOCKS_EXCLUDED(data_lock_);
+  ::util::Status SwitchToStandbyPipeline(int pipeline_id) override
+      LOCKS_EXCLUDED(data_lock_);
+  ::util::Status DiscardStandbyPipeline(int pipeline_id) override
+      LOCKS_EXCLUDED(data_lock_);
+  ::util::Status AddPort(int pipeline_id, const std::string& port_name) override
+      LOCKS_EXCLUDED(data_lock_);
+  ::util::Status DeletePort(int pipeline_id,
+                            const std::string& port_name) override
+      LOCKS_EXCLUDED(data_lock_);
+  ::util::StatusOr<std::shared_ptr<NikssInterface::SessionInterface>>
+  CreateSession(int pipeline_id) override LOCKS_EXCLUDED(data_lock_);
+  ::util::StatusOr<std::shared_ptr<NikssInterface::SessionInterface>>
+  CreateStandbySession(int pipeline_id) override LOCKS_EXCLUDED(data_lock_);
+  ::util::Status WriteTableEntry(
+      std::shared_ptr<NikssInterface::SessionInterface> session,
+      const ::p4::v1::Update::Type type, const ::p4::config::v1::Table& table,
+      const ::p4::config::v1::Action& action,
+      const ::p4::v1::TableEntry& table_entry) override;
+  ::util::Status ReadTableEntries(
+      std::shared_ptr<NikssInterface::SessionInterface> session,
+      const ::p4::config::v1::Table& table,
+      const std::vector<::p4::config::v1::Action>& actions,
+      const ::p4::v1::TableEntry& table_entry,
+      WriterInterface<::p4::v1::TableEntry>* writer) override;
+  ::util::Status WriteIndirectCounter(
+      std::shared_ptr<NikssInterface::SessionInterface> session,
+      const ::p4::config::v1::Counter& counter,
+      const ::p4::v1::CounterEntry& counter_entry) override;
+  ::util::Status ReadIndirectCounter(
+      std::shared_ptr<NikssInterface::SessionInterface> session,
+      const ::p4::config::v1::Counter& counter,
+      const ::p4::v1::CounterEntry& counter_entry,
+      WriterInterface<::p4::v1::CounterEntry>* writer) override;
+  ::util::Status WriteDirectCounter(
+      std::shared_ptr<NikssInterface::SessionInterface> session,
+      const ::p4::config::v1::Table& table,
+      const ::p4::config::v1::DirectCounter& direct_counter,
+      const ::p4::v1::DirectCounterEntry& direct_counter_entry) override;
+  ::util::Status ReadDirectCounter(
+      std::shared_ptr<NikssInterface::SessionInterface> session,
+      const ::p4::config::v1::Table& table,
+      const ::p4::config::v1::DirectCounter& direct_counter,
+      const ::p4::v1::DirectCounterEntry& direct_counter_entry,
+      WriterInterface<::p4::v1::DirectCounterEntry>* writer) override;
+  ::util::Status WriteMeter(
+      std::shared_ptr<NikssInterface::SessionInterface> session,
+      const ::p4::config::v1::Meter& meter,
+      const ::p4::v1::MeterEntry& meter_entry) override;
+  ::util::Status ReadMeter(
+      std::shared_ptr<NikssInterface::SessionInterface> session,
+      const ::p4::config::v1::Meter& meter,
+      const ::p4::v1::MeterEntry& meter_entry,
+      WriterInterface<::p4::v1::MeterEntry>* writer) override;
+  ::util::Status WriteDirectMeter(
+      std::shared_ptr<NikssInterface::SessionInterface> session,
+      const ::p4::config::v1::Table& table,
+      const ::p4::config::v1::DirectMeter& direct_meter,
+      const ::p4::v1::DirectMeterEntry& direct_meter_entry) override;
+  ::util::Status ReadDirectMeter(
+      std::shared_ptr<NikssInterface::SessionInterface> session,
+      const ::p4::config::v1::Table& table,
+      const ::p4::config::v1::DirectMeter& direct_meter,
+      const ::p4::v1::DirectMeterEntry& direct_meter_entry,
+      WriterInterface<::p4::v1::DirectMeterEntry>* writer) override;
+  ::util::Status WriteRegister(
+      std::shared_ptr<NikssInterface::SessionInterface> session,
+      const ::p4::config::v1::Register& reg,
+      const ::p4::v1::RegisterEntry& register_entry) override;
+  ::util::Status ReadRegister(
+      std::shared_ptr<NikssInterface::SessionInterface> session,
+      const ::p4::config::v1::Register& reg,
+      const ::p4::v1::RegisterEntry& register_entry,
+      WriterInterface<::p4::v1::RegisterEntry>* writer) override;
+  ::util::Status WriteValueSet(
+      std::shared_ptr<NikssInterface::SessionInterface> session,
+      const ::p4::config::v1::ValueSet& value_set,
+      const ::p4::v1::ValueSetEntry& value_set_entry) override;
+  ::util::Status ReadValueSet(
+      std::shared_ptr<NikssInterface::SessionInterface> session,
+      const ::p4::config::v1::ValueSet& value_set,
+      ::p4::v1::ValueSetEntry* value_set_entry) override;
+  ::util::StatusOr<uint32> InsertActionProfileMember(
+      std::shared_ptr<NikssInterface::SessionInterface> session,
+      const ::p4::config::v1::ActionProfile& action_profile,
+      const ::p4::config::v1::Action& action_info,
+      const ::p4::v1::Action& action) override;
+  ::util::Status ModifyActionProfileMember(
+      std::shared_ptr<NikssInterface::SessionInterface> session,
+      const ::p4::config::v1::ActionProfile& action_profile,
+      const ::p4::config::v1::Action& action_info,
+      const ::p4::v1::Action& action, uint32 member_ref) override;
+  ::util::Status DeleteActionProfileMember(
+      std::shared_ptr<NikssInterface::SessionInterface> session,
+      const ::p4::config::v1::ActionProfile& action_profile,
+      uint32 member_ref) override;
+  ::util::StatusOr<uint32> InsertActionProfileGroup(
+      std::shared_ptr<NikssInterface::SessionInterface> session,
+      const ::p4::config::v1::ActionProfile& action_profile) override;
+  ::util::Status DeleteActionProfileGroup(
+      std::shared_ptr<NikssInterface::SessionInterface> session,
+      const ::p4::config::v1::ActionProfile& action_profile,
+      uint32 group_ref) override;
+  ::util::Status AddActionProfileGroupMember(
+      std::shared_ptr<NikssInterface::SessionInterface> session,
+      const ::p4::config::v1::ActionProfile& action_profile, uint32 group_ref,
+      uint32 member_ref) override;
+  ::util::Status RemoveActionProfileGroupMember(
+      std::shared_ptr<NikssInterface::SessionInterface> session,
+      const ::p4::config::v1::ActionProfile& action_profile, uint32 group_ref,
+      uint32 member_ref) override;
+  ::util::Status ReadActionProfileMembers(
+      std::shared_ptr<NikssInterface::SessionInterface> session,
+      const ::p4::config::v1::ActionProfile& action_profile,
+      const std::vector<::p4::config::v1::Action>& actions,
+      std::vector<std::pair<uint32, ::p4::v1::Action>>* members) override;
+  ::util::Status ReadActionProfileGroups(
+      std::shared_ptr<NikssInterface::SessionInterface> session,
+      const ::p4::config::v1::ActionProfile& action_profile,
+      std::vector<std::pair<uint32, std::vector<uint32>>>* groups) override;
+  ::util::Status InsertMulticastGroup(
+      std::shared_ptr<NikssInterface::SessionInterface> session,
+      uint32 group_id) override;
+  ::util::Status DeleteMulticastGroup(
+      std::shared_ptr<NikssInterface::SessionInterface> session,
+      uint32 group_id) override;
+  ::util::Status AddMulticastGroupReplica(
+      std::shared_ptr<NikssInterface::SessionInterface> session,
+      uint32 group_id, const ::p4::v1::Replica& replica) override;
+  ::util::Status RemoveMulticastGroupReplica(
+      std::shared_ptr<NikssInterface::SessionInterface> session,
+      uint32 group_id, const ::p4::v1::Replica& replica) override;
+  ::util::Status ReadMulticastGroups(
+      std::shared_ptr<NikssInterface::SessionInterface> session,
+      uint32 group_id,
+      std::vector<::p4::v1::MulticastGroupEntry>* groups) override;
+  ::util::Status InsertCloneSession(
+      std::shared_ptr<NikssInterface::SessionInterface> session,
+      uint32 session_id) override;
+  ::util::Status DeleteCloneSession(
+      std::shared_ptr<NikssInterface::SessionInterface> session,
+      uint32 session_id) override;
+  ::util::Status AddCloneSessionReplica(
+      std::shared_ptr<NikssInterface::SessionInterface> session,
+      const ::p4::v1::CloneSessionEntry& clone_session,
+      const ::p4::v1::Replica& replica) override;
+  ::util::Status RemoveCloneSessionReplica(
+      std::shared_ptr<NikssInterface::SessionInterface> session,
+      uint32 session_id, const ::p4::v1::Replica& replica) override;
+  ::util::Status ReadCloneSessions(
+      std::shared_ptr<NikssInterface::SessionInterface> session,
+      uint32 session_id,
+      std::vector<::p4::v1::CloneSessionEntry>* clone_sessions) override;
+  ::util::Status ReadDigests(
+      std::shared_ptr<NikssInterface::SessionInterface> session,
+      const ::p4::config::v1::Digest& digest,
+      const std::vector<int>& bitwidths, size_t max_digests,
+      std::vector<::p4::v1::P4Data>* digests) override;
 
   static NikssWrapper* CreateSingleton() LOCKS_EXCLUDED(init_lock_);
 
@@ -37,9 +346,61 @@ class NikssWrapper : public NikssInterface {
   static NikssWrapper* singleton_ GUARDED_BY(init_lock_);
 
  private:
+  // Releases a NIKSS pipeline context.
+  struct NikssContextDeleter {
+    void operator()(nikss_context_t* ctx) const {
+      nikss_context_free(ctx);
+      delete ctx;
+    }
+  };
+
+  // NIKSS context of a pipeline and the NIKSS pipeline ID it refers to.
+  struct PipelineContext {
+    std::shared_ptr<nikss_context_t> ctx;
+    nikss_pipeline_id_t nikss_pipeline_id;
+  };
 
   // Private constructor, use CreateSingleton and GetSingleton().
   NikssWrapper();
+
+  // Creates a context for the given NIKSS pipeline ID.
+  static PipelineContext NewPipelineContext(
+      nikss_pipeline_id_t nikss_pipeline_id);
+
+  // Returns the context of the running pipeline, creating it on first use.
+  nikss_context_t* GetPipelineContext(int pipeline_id)
+      EXCLUSIVE_LOCKS_REQUIRED(data_lock_);
+
+  // Moves all ports of the running pipeline to the standby pipeline, which
+  // becomes the running one, and unloads the previous pipeline. If a port
+  // cannot be moved, the previous pipeline keeps all ports and the standby
+  // pipeline is unloaded. With 'hitless' set, every port has to be moved
+  // atomically.
+  ::util::Status SwitchPipeline(int pipeline_id, bool hitless)
+      EXCLUSIVE_LOCKS_REQUIRED(data_lock_);
+
+  // Attaches the configured interfaces of a pipeline which are not attached to
+  // it yet.
+  ::util::Status AttachConfiguredPorts(int pipeline_id)
+      EXCLUSIVE_LOCKS_REQUIRED(data_lock_);
+
+  // Mutex protecting the pipeline contexts.
+  absl::Mutex data_lock_;
+
+  // Map from pipeline ID to the NIKSS context of the running pipeline. A single
+  // context is kept for the lifetime of a pipeline and shared by all sessions.
+  absl::flat_hash_map<int, PipelineContext> pipeline_contexts_
+      GUARDED_BY(data_lock_);
+
+  // Map from pipeline ID to the NIKSS context of a pipeline which has been
+  // loaded to replace the running one, but is not attached to any port yet.
+  absl::flat_hash_map<int, PipelineContext> standby_contexts_
+      GUARDED_BY(data_lock_);
+
+  // Map from pipeline ID to the names of the interfaces which have to be
+  // attached to the pipeline.
+  absl::flat_hash_map<int, std::set<std::string>> configured_ports_
+      GUARDED_BY(data_lock_);
 };
 
 }  // namespace nikss
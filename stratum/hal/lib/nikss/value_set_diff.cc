@@ -0,0 +1,80 @@
+#include "stratum/hal/lib/nikss/value_set_diff.h"
+
+#include <string>
+#include <utility>
+
+#include "absl/container/flat_hash_map.h"
+#include "stratum/hal/lib/p4/utils.h"
+
+namespace stratum {
+namespace hal {
+namespace nikss {
+
+namespace {
+
+// Returns true if the byte string is all zeros, i.e. a wildcard mask.
+bool IsAllZeros(const std::string& bytes) {
+  return bytes.find_first_not_of('\x00') == std::string::npos;
+}
+
+}  // namespace
+
+::p4::v1::ValueSetMember CanonicalValueSetMember(
+    const ::p4::config::v1::ValueSet& value_set,
+    const ::p4::v1::ValueSetMember& member) {
+  ::p4::v1::ValueSetMember result;
+  for (const auto& match_field : value_set.match()) {
+    for (const auto& match : member.match()) {
+      if (match.field_id() != match_field.id()) continue;
+      if (match.has_lpm() && match.lpm().prefix_len() == 0) break;
+      if (match.has_ternary() && IsAllZeros(match.ternary().mask())) break;
+      auto* field_match = result.add_match();
+      *field_match = match;
+      if (match.has_exact()) {
+        field_match->mutable_exact()->set_value(
+            ByteStringToP4RuntimeByteString(match.exact().value()));
+      } else if (match.has_lpm()) {
+        field_match->mutable_lpm()->set_value(
+            ByteStringToP4RuntimeByteString(match.lpm().value()));
+      } else if (match.has_ternary()) {
+        field_match->mutable_ternary()->set_value(
+            ByteStringToP4RuntimeByteString(match.ternary().value()));
+        field_match->mutable_ternary()->set_mask(
+            ByteStringToP4RuntimeByteString(match.ternary().mask()));
+      }
+      break;
+    }
+  }
+  return result;
+}
+
+ValueSetMemberDiff DiffValueSetMembers(
+    const ::p4::config::v1::ValueSet& value_set,
+    const std::vector<::p4::v1::ValueSetMember>& installed,
+    const ::p4::v1::ValueSetEntry& value_set_entry) {
+  absl::flat_hash_map<std::string, const ::p4::v1::ValueSetMember*>
+      installed_keys;
+  for (const auto& member : installed) {
+    installed_keys.emplace(member.SerializeAsString(), &member);
+  }
+  absl::flat_hash_map<std::string, ::p4::v1::ValueSetMember> requested;
+  for (const auto& member : value_set_entry.members()) {
+    auto canonical = CanonicalValueSetMember(value_set, member);
+    requested.emplace(canonical.SerializeAsString(), std::move(canonical));
+  }
+
+  ValueSetMemberDiff diff;
+  for (const auto& e : installed_keys) {
+    if (!requested.contains(e.first)) diff.to_delete.push_back(*e.second);
+  }
+  for (auto& e : requested) {
+    if (!installed_keys.contains(e.first)) {
+      diff.to_insert.push_back(std::move(e.second));
+    }
+  }
+  return diff;
+}
+
+}  // namespace nikss
+}  // namespace hal
+}  // namespace stratum
@@ -0,0 +1,40 @@
+#ifndef STRATUM_HAL_LIB_NIKSS_VALUE_SET_DIFF_H_
+#define STRATUM_HAL_LIB_NIKSS_VALUE_SET_DIFF_H_
+
+#include <vector>
+
+#include "p4/config/v1/p4info.pb.h"
+#include "p4/v1/p4runtime.pb.h"
+
+namespace stratum {
+namespace hal {
+namespace nikss {
+
+// Members to remove from and to add to a value set to turn the installed
+// members into the requested ones.
+struct ValueSetMemberDiff {
+  std::vector<::p4::v1::ValueSetMember> to_delete;
+  std::vector<::p4::v1::ValueSetMember> to_insert;
+};
+
+// Returns a value set member with the fields in the P4Info order and
+// wildcards omitted, i.e. in the form read back from NIKSS. Used to compare
+// members of a request with the ones installed.
+::p4::v1::ValueSetMember CanonicalValueSetMember(
+    const ::p4::config::v1::ValueSet& value_set,
+    const ::p4::v1::ValueSetMember& member);
+
+// Returns the difference between the 'installed' members, as read back from
+// NIKSS, and the members of the write request. Members present in both are
+// left out, so that they never disappear from the data plane. Duplicate
+// members are reported once.
+ValueSetMemberDiff DiffValueSetMembers(
+    const ::p4::config::v1::ValueSet& value_set,
+    const std::vector<::p4::v1::ValueSetMember>& installed,
+    const ::p4::v1::ValueSetEntry& value_set_entry);
+
+}  // namespace nikss
+}  // namespace hal
+}  // namespace stratum
+
+#endif  // STRATUM_HAL_LIB_NIKSS_VALUE_SET_DIFF_H_
@@ -0,0 +1,143 @@
+#include "stratum/hal/lib/nikss/value_set_diff.h"
+
+#include <string>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "p4/config/v1/p4info.pb.h"
+#include "p4/v1/p4runtime.pb.h"
+#include "stratum/glue/status/status_test_util.h"
+#include "stratum/lib/test_utils/matchers.h"
+#include "stratum/lib/utils.h"
+
+namespace stratum {
+namespace hal {
+namespace nikss {
+
+using test_utils::EqualsProto;
+using ::testing::ElementsAre;
+using ::testing::IsEmpty;
+using ::testing::UnorderedElementsAre;
+
+namespace {
+
+// TPIDs in canonical form.
+const std::string kCTag("\x81\x00", 2);
+const std::string kSTag("\x88\xa8", 2);
+const std::string kQinQTag("\x91\x00", 2);
+
+constexpr char kValueSet[] = R"pb(
+  preamble { id: 50331649 name: "parser.tpids" }
+  match { id: 1 name: "tpid" bitwidth: 16 match_type: EXACT }
+  match { id: 2 name: "pcp" bitwidth: 3 match_type: TERNARY }
+  size: 4
+)pb";
+
+// Returns a member with an exact TPID and, unless 'pcp_mask' is empty, a
+// ternary PCP, in the form read back from NIKSS.
+::p4::v1::ValueSetMember MakeMember(const std::string& tpid,
+                                    const std::string& pcp = "",
+                                    const std::string& pcp_mask = "") {
+  ::p4::v1::ValueSetMember member;
+  auto* exact = member.add_match();
+  exact->set_field_id(1);
+  exact->mutable_exact()->set_value(tpid);
+  if (!pcp_mask.empty()) {
+    auto* ternary = member.add_match();
+    ternary->set_field_id(2);
+    ternary->mutable_ternary()->set_value(pcp);
+    ternary->mutable_ternary()->set_mask(pcp_mask);
+  }
+  return member;
+}
+
+class ValueSetDiffTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    ASSERT_OK(ParseProtoFromString(kValueSet, &value_set_));
+  }
+
+  ::p4::v1::ValueSetEntry MakeEntry(
+      const std::vector<::p4::v1::ValueSetMember>& members) {
+    ::p4::v1::ValueSetEntry entry;
+    entry.set_value_set_id(value_set_.preamble().id());
+    for (const auto& member : members) *entry.add_members() = member;
+    return entry;
+  }
+
+  ::p4::config::v1::ValueSet value_set_;
+};
+
+}  // namespace
+
+TEST_F(ValueSetDiffTest, CanonicalMemberIsInP4InfoOrderWithoutWildcards) {
+  ::p4::v1::ValueSetMember member;
+  auto* ternary = member.add_match();
+  ternary->set_field_id(2);
+  ternary->mutable_ternary()->set_value(std::string("\x00\x05", 2));
+  ternary->mutable_ternary()->set_mask(std::string("\x00\x07", 2));
+  auto* exact = member.add_match();
+  exact->set_field_id(1);
+  exact->mutable_exact()->set_value(std::string("\x00\x81\x00", 3));
+
+  EXPECT_THAT(CanonicalValueSetMember(value_set_, member),
+              EqualsProto(MakeMember(kCTag, "\x05", "\x07")));
+
+  // An all-zeros mask is a wildcard and is left out.
+  ternary->mutable_ternary()->set_mask(std::string("\x00", 1));
+  EXPECT_THAT(CanonicalValueSetMember(value_set_, member),
+              EqualsProto(MakeMember(kCTag)));
+}
+
+TEST_F(ValueSetDiffTest, OnlyChangedMembersAreWritten) {
+  std::vector<::p4::v1::ValueSetMember> installed = {
+      MakeMember(kCTag), MakeMember(kSTag)};
+  auto diff = DiffValueSetMembers(
+      value_set_, installed,
+      MakeEntry({MakeMember(kSTag), MakeMember(kQinQTag)}));
+
+  EXPECT_THAT(diff.to_delete, ElementsAre(EqualsProto(MakeMember(kCTag))));
+  EXPECT_THAT(diff.to_insert, ElementsAre(EqualsProto(MakeMember(kQinQTag))));
+}
+
+TEST_F(ValueSetDiffTest, MembersInAnotherFormAreKept) {
+  std::vector<::p4::v1::ValueSetMember> installed = {
+      MakeMember(kCTag), MakeMember(kSTag, "\x05", "\x07")};
+  // Padded values, fields out of order and a wildcard PCP still match the
+  // installed members, and duplicates are written once.
+  ::p4::v1::ValueSetMember reordered;
+  *reordered.add_match() =
+      MakeMember("\x00", std::string("\x00\x05", 2), std::string("\x00\x07", 2))
+          .match(1);
+  reordered.add_match()->CopyFrom(
+      MakeMember(std::string("\x00\x88\xa8", 3)).match(0));
+  auto wildcard = MakeMember(kCTag, "\x00", std::string("\x00", 1));
+  auto diff = DiffValueSetMembers(
+      value_set_, installed,
+      MakeEntry({reordered, wildcard, wildcard, MakeMember(kQinQTag),
+                 MakeMember(std::string("\x00\x91\x00", 3))}));
+
+  EXPECT_THAT(diff.to_delete, IsEmpty());
+  EXPECT_THAT(diff.to_insert, ElementsAre(EqualsProto(MakeMember(kQinQTag))));
+}
+
+TEST_F(ValueSetDiffTest, EmptyWriteClearsTheSet) {
+  std::vector<::p4::v1::ValueSetMember> installed = {
+      MakeMember(kCTag), MakeMember(kSTag)};
+  auto diff = DiffValueSetMembers(value_set_, installed, MakeEntry({}));
+
+  EXPECT_THAT(diff.to_delete,
+              UnorderedElementsAre(EqualsProto(MakeMember(kCTag)),
+                                   EqualsProto(MakeMember(kSTag))));
+  EXPECT_THAT(diff.to_insert, IsEmpty());
+
+  diff = DiffValueSetMembers(value_set_, {},
+                             MakeEntry({MakeMember(kCTag)}));
+  EXPECT_THAT(diff.to_delete, IsEmpty());
+  EXPECT_THAT(diff.to_insert, ElementsAre(EqualsProto(MakeMember(kCTag))));
+}
+
+}  // namespace nikss
+}  // namespace hal
+}  // namespace stratum
@@ -392,7 +392,8 @@ void NP4ChassisManager::ReadPortStatusChangeEvents() {
   }
 
   port_status_change_event_channel_ =
-      Channel<PortStatusChangeEvent>::Create(kMaxPortStatusChangeEventDepth);
+      Channel<PortStatusChangeEvent>::Create(kMaxPortStatusChangeEventDepth,
+                                             "np4_port_status_events");
 
   absl::WriterMutexLock l(&port_status_change_event_writer_lock_);
   port_status_change_event_writer_ =
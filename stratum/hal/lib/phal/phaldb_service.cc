@@ -198,7 +198,8 @@ namespace {
     ::grpc::ServerWriter<SubscribeResponse>* stream) {
   ASSIGN_OR_RETURN(auto path, ToPhalDBPath(req->path()));
   // Create writer and reader channels
-  std::shared_ptr<Channel<PhalDB>> channel = Channel<PhalDB>::Create(128);
+  std::shared_ptr<Channel<PhalDB>> channel =
+      Channel<PhalDB>::Create(128, "phaldb_subscribe");
 
   {
     // Lock subscriber channels
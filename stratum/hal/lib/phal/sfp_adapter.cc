@@ -234,7 +234,7 @@ SfpAdapter::~SfpAdapter() {
            << "Database subscription already created before.";
   }
 
-  channel_ = Channel<PhalDB>::Create(kDefaultChannelDepth);
+  channel_ = Channel<PhalDB>::Create(kDefaultChannelDepth, "phal_sfp_adapter");
   auto reader = ChannelReader<PhalDB>::Create(channel_);
   auto writer = ChannelWriter<PhalDB>::Create(channel_);
   ASSIGN_OR_RETURN(query_, Subscribe({kAllTransceiversPath}, std::move(writer),
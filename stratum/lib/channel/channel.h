@@ -8,15 +8,18 @@
 #include <deque>
 #include <list>
 #include <memory>
+#include <string>
 #include <unordered_map>
 #include <utility>
 #include <vector>
 
 #include "absl/base/thread_annotations.h"
+#include "absl/cleanup/cleanup.h"
 #include "absl/memory/memory.h"
 #include "absl/synchronization/mutex.h"
 #include "absl/time/time.h"
 #include "stratum/lib/channel/channel_internal.h"
+#include "stratum/lib/channel/channel_stats.h"
 #include "stratum/lib/macros.h"
 
 namespace stratum {
@@ -150,6 +153,11 @@ namespace stratum {
 //    Reading necessarily consumes data which will not be available to other
 //    threads. Additionally, Reading from multiple threads can easily cause
 //    out-of-sender-order processing of messages.
+//
+// 3. A Channel created with a name timestamps every message on enqueue and
+//    records the queueing delay, the queue depth and the time writers are
+//    blocked in a ChannelStats instance registered under that name. Unnamed
+//    Channels do not pay for this.
 
 template <typename T>
 class Channel;
@@ -203,7 +211,6 @@ class SelectResult {
     const std::vector<channel_internal::ChannelBase*>& channels,
     absl::Duration timeout);
 
-// TODO(unknown): add support for optional en/dequeue timestamping.
 template <typename T>
 class Channel : public channel_internal::ChannelBase {
   // Check the type requirements documented at the top of this file.
@@ -218,6 +225,13 @@ class Channel : public channel_internal::ChannelBase {
     return absl::WrapUnique(new Channel<T>(max_depth));
   }
 
+  // Creates shared Channel object with given maximum queue depth, which keeps
+  // statistics under the given name. See ChannelStats.
+  static std::unique_ptr<Channel<T>> Create(size_t max_depth,
+                                            const std::string& name) {
+    return absl::WrapUnique(new Channel<T>(max_depth, name));
+  }
+
   // Closes the Channel. Any blocked Read() or Write() operations immediately
   // return ERR_CANCELLED. Returns false if the Channel is already closed.
   virtual bool Close() LOCKS_EXCLUDED(queue_lock_);
@@ -234,6 +248,13 @@ class Channel : public channel_internal::ChannelBase {
   // queue depth.
   explicit Channel(size_t max_depth) : closed_(false), max_depth_(max_depth) {}
 
+  // Protected constructor which intializes the Channel to the given maximum
+  // queue depth and registers its statistics under the given name.
+  Channel(size_t max_depth, const std::string& name)
+      : closed_(false),
+        max_depth_(max_depth),
+        stats_(ChannelStats::CreateInstance(name, max_depth)) {}
+
   // Writes a copy of t into the Channel. Returns ERR_SUCCESS on successful
   // enqueue. Blocks if the queue is full until the timeout, then returns
   // ERR_NO_RESOURCE. Returns ERR_CANCELLED if the Channel is closed.
@@ -248,6 +269,13 @@ class Channel : public channel_internal::ChannelBase {
   virtual ::util::Status TryWrite(const T& t) LOCKS_EXCLUDED(queue_lock_);
   virtual ::util::Status TryWrite(T&& t) LOCKS_EXCLUDED(queue_lock_);
 
+  // Moves all of the elements of t_s into the Channel, in order, and clears
+  // t_s. Blocks while the queue is full until the timeout, then returns
+  // ERR_NO_RESOURCE. Returns ERR_CANCELLED if the Channel is closed. On error,
+  // t_s holds the elements which have not been written.
+  virtual ::util::Status WriteBatch(std::vector<T>* t_s, absl::Duration timeout)
+      LOCKS_EXCLUDED(queue_lock_);
+
   // Reads and pops the first element of the queue into t. Returns ERR_SUCCESS
   // on successful dequeue. Blocks if the queue is empty until the timeout, then
   // returns ERR_ENTRY_NOT_FOUND. Returns ERR_CANCELED if Channel is closed and
@@ -293,6 +321,12 @@ class Channel : public channel_internal::ChannelBase {
   // ready flags to the given value and signaling their condition variables.
   void ClearSelectList(bool ready) EXCLUSIVE_LOCKS_REQUIRED(queue_lock_);
 
+  // Helper functions called after a message has been pushed to or 'count'
+  // messages have been popped from the internal queue. They maintain the
+  // enqueue timestamps and update the statistics of named Channels.
+  void RecordEnqueue() EXCLUSIVE_LOCKS_REQUIRED(queue_lock_);
+  void RecordDequeue(size_t count) EXCLUSIVE_LOCKS_REQUIRED(queue_lock_);
+
   // Mutex to protect internal queue of the Channel and state.
   mutable absl::Mutex queue_lock_;
   std::deque<T> queue_ GUARDED_BY(queue_lock_);
@@ -303,6 +337,12 @@ class Channel : public channel_internal::ChannelBase {
   // Maximum queue depth.
   const size_t max_depth_;
 
+  // Statistics of a named Channel, nullptr if the Channel has no name.
+  const std::shared_ptr<ChannelStats> stats_;
+
+  // Enqueue time of each message in queue_, only kept if stats_ is set.
+  std::deque<absl::Time> enqueue_times_ GUARDED_BY(queue_lock_);
+
   // Condition variable for ChannelReaders waiting on empty queue_.
   mutable absl::CondVar cond_not_empty_;
 
@@ -379,6 +419,10 @@ class ChannelWriter {
   virtual ::util::Status TryWrite(T&& t) {
     return channel_->TryWrite(std::move(t));
   }
+  virtual ::util::Status WriteBatch(std::vector<T>* t_s,
+                                    absl::Duration timeout) {
+    return channel_->WriteBatch(t_s, timeout);
+  }
   virtual bool IsClosed() { return channel_->IsClosed(); }
 
   // Disallow copy and assign.
@@ -424,6 +468,7 @@ template <typename T>
   RETURN_IF_ERROR(CheckWriteStateAndBlock(timeout));
   // Enqueue message.
   queue_.push_back(t);
+  RecordEnqueue();
   // Signal next blocked ChannelReader.
   cond_not_empty_.Signal();
   // Signal any Select()-ing threads..
@@ -438,6 +483,7 @@ template <typename T>
   RETURN_IF_ERROR(CheckWriteStateAndBlock(timeout));
   // Enqueue message.
   queue_.push_back(std::move(t));
+  RecordEnqueue();
   // Signal next blocked ChannelReader.
   cond_not_empty_.Signal();
   // Signal any Select()-ing threads..
@@ -452,7 +498,14 @@ template <typename T>
   // Wait with timeout for non-full internal buffer. While is required as
   // signals may be delivered without an actual call to Signal() or
   // SignallAll().
-  absl::Time deadline = absl::Now() + timeout;
+  absl::Time start = absl::Now();
+  absl::Time deadline = start + timeout;
+  // Record the time spent waiting for room in the queue, however the wait
+  // ends.
+  auto record_blocked_time = absl::MakeCleanup([this, start]() {
+    if (stats_) stats_->RecordBlockedWrite(absl::Now() - start);
+  });
+  if (queue_.size() < max_depth_) std::move(record_blocked_time).Cancel();
   while (queue_.size() == max_depth_) {
     bool expired = cond_not_full_.WaitWithDeadline(&queue_lock_, deadline);
     // Could have been signalled because Channel is now closed.
@@ -480,6 +533,7 @@ template <typename T>
   RETURN_IF_ERROR(CheckWriteState());
   // Enqueue message.
   queue_.push_back(t);
+  RecordEnqueue();
   // Signal next blocked ChannelReader.
   cond_not_empty_.Signal();
   // Signal any Select()-ing threads..
@@ -494,6 +548,7 @@ template <typename T>
   RETURN_IF_ERROR(CheckWriteState());
   // Enqueue message.
   queue_.push_back(std::move(t));
+  RecordEnqueue();
   // Signal next blocked ChannelReader.
   cond_not_empty_.Signal();
   // Signal any Select()-ing threads..
@@ -501,6 +556,31 @@ template <typename T>
   return ::util::OkStatus();
 }
 
+template <typename T>
+::util::Status Channel<T>::WriteBatch(std::vector<T>* t_s,
+                                      absl::Duration timeout) {
+  absl::MutexLock l(&queue_lock_);
+  absl::Time deadline = absl::Now() + timeout;
+  ::util::Status status = ::util::OkStatus();
+  size_t written = 0;
+  while (written < t_s->size()) {
+    // Check internal state, blocking until the deadline if queue is full.
+    status = CheckWriteStateAndBlock(deadline - absl::Now());
+    if (!status.ok()) break;
+    // Enqueue as many messages as fit.
+    while (written < t_s->size() && queue_.size() < max_depth_) {
+      queue_.push_back(std::move((*t_s)[written++]));
+      RecordEnqueue();
+    }
+    // Signal all blocked ChannelReaders.
+    cond_not_empty_.SignalAll();
+    // Signal any Select()-ing threads..
+    ClearSelectList(true);
+  }
+  t_s->erase(t_s->begin(), t_s->begin() + written);
+  return status;
+}
+
 template <typename T>
 ::util::Status Channel<T>::CheckWriteState() {
   // Check for Channel closure.
@@ -535,6 +615,24 @@ void Channel<T>::ClearSelectList(bool ready) {
   }
 }
 
+template <typename T>
+void Channel<T>::RecordEnqueue() {
+  if (!stats_) return;
+  enqueue_times_.push_back(absl::Now());
+  stats_->RecordWrite(queue_.size());
+}
+
+template <typename T>
+void Channel<T>::RecordDequeue(size_t count) {
+  if (!stats_) return;
+  absl::Time now = absl::Now();
+  for (size_t i = 0; i < count; ++i) {
+    stats_->RecordRead(now - enqueue_times_.front(),
+                       queue_.size() + count - i - 1);
+    enqueue_times_.pop_front();
+  }
+}
+
 template <typename T>
 ::util::Status Channel<T>::Read(T* t, absl::Duration timeout) {
   absl::MutexLock l(&queue_lock_);
@@ -558,6 +656,7 @@ template <typename T>
   // Dequeue message.
   *t = std::move(queue_.front());
   queue_.pop_front();
+  RecordDequeue(1);
   // Signal next blocked ChannelWriter.
   cond_not_full_.Signal();
   return ::util::OkStatus();
@@ -575,6 +674,7 @@ template <typename T>
   // Dequeue message.
   *t = std::move(queue_.front());
   queue_.pop_front();
+  RecordDequeue(1);
   // Signal next blocked ChannelWriter.
   cond_not_full_.Signal();
   return ::util::OkStatus();
@@ -590,6 +690,7 @@ template <typename T>
   std::move(queue_.begin(), queue_.end(), t_s->begin());
   // Clear internal buffer.
   queue_.erase(queue_.begin(), queue_.end());
+  RecordDequeue(t_s->size());
   // Signal all blocked ChannelWriters.
   cond_not_full_.SignalAll();
   return ::util::OkStatus();
@@ -0,0 +1,129 @@
+// Copyright 2018-present Open Networking Foundation
+// SPDX-License-Identifier: Apache-2.0
+
+#include "stratum/lib/channel/channel_stats.h"
+
+#include <algorithm>
+
+#include "absl/strings/str_cat.h"
+
+namespace stratum {
+
+namespace {
+
+// Registry of all the live ChannelStats instances.
+ABSL_CONST_INIT absl::Mutex registry_lock(absl::kConstInit);
+std::vector<ChannelStats*>* registry GUARDED_BY(registry_lock) = nullptr;
+
+// Returns the upper bound of the given histogram bucket, in microseconds.
+int64 DelayBucketBound(int bucket) { return int64{1} << (2 * bucket); }
+
+}  // namespace
+
+constexpr int ChannelStats::kNumDelayBuckets;
+
+ChannelStats::ChannelStats(const std::string& name, size_t max_depth)
+    : name_(name) {
+  stats_.name = name;
+  stats_.max_depth = max_depth;
+  stats_.delay_buckets.resize(kNumDelayBuckets, 0);
+}
+
+ChannelStats::~ChannelStats() {
+  absl::MutexLock l(&registry_lock);
+  registry->erase(std::remove(registry->begin(), registry->end(), this),
+                  registry->end());
+}
+
+std::shared_ptr<ChannelStats> ChannelStats::CreateInstance(
+    const std::string& name, size_t max_depth) {
+  std::shared_ptr<ChannelStats> stats(new ChannelStats(name, max_depth));
+  absl::MutexLock l(&registry_lock);
+  if (registry == nullptr) registry = new std::vector<ChannelStats*>();
+  registry->push_back(stats.get());
+  return stats;
+}
+
+std::vector<ChannelStats::Snapshot> ChannelStats::GetAllSnapshots() {
+  std::vector<Snapshot> snapshots;
+  {
+    absl::MutexLock l(&registry_lock);
+    if (registry == nullptr) return snapshots;
+    for (const auto* stats : *registry) {
+      snapshots.push_back(stats->GetSnapshot());
+    }
+  }
+  std::stable_sort(snapshots.begin(), snapshots.end(),
+                   [](const Snapshot& lhs, const Snapshot& rhs) {
+                     return lhs.name < rhs.name;
+                   });
+  return snapshots;
+}
+
+std::string ChannelStats::DumpAll() {
+  std::string dump;
+  for (const auto& stats : GetAllSnapshots()) {
+    absl::StrAppend(&dump, stats.name, ": depth ", stats.depth, "/",
+                    stats.max_depth, " (high-water ", stats.high_water_depth,
+                    "), ", stats.writes, " writes, ", stats.reads, " reads");
+    if (stats.reads > 0) {
+      absl::StrAppend(&dump, ", queueing delay avg ",
+                      absl::FormatDuration(stats.total_delay / stats.reads),
+                      " max ", absl::FormatDuration(stats.max_delay));
+    }
+    if (stats.blocked_writes > 0) {
+      absl::StrAppend(&dump, ", ", stats.blocked_writes,
+                      " writes blocked for ",
+                      absl::FormatDuration(stats.blocked_write_time));
+    }
+    absl::StrAppend(&dump, "\n  delay histogram:");
+    for (int i = 0; i < kNumDelayBuckets; ++i) {
+      if (i < kNumDelayBuckets - 1) {
+        absl::StrAppend(&dump, " <", DelayBucketBound(i), "us:");
+      } else {
+        absl::StrAppend(&dump, " >=", DelayBucketBound(i - 1), "us:");
+      }
+      absl::StrAppend(&dump, stats.delay_buckets[i]);
+    }
+    absl::StrAppend(&dump, "\n");
+  }
+  return dump;
+}
+
+int ChannelStats::GetDelayBucket(absl::Duration delay) {
+  const int64 usecs = absl::ToInt64Microseconds(delay);
+  int bucket = 0;
+  while (bucket < kNumDelayBuckets - 1 && usecs >= DelayBucketBound(bucket)) {
+    ++bucket;
+  }
+  return bucket;
+}
+
+void ChannelStats::RecordWrite(size_t depth) {
+  absl::MutexLock l(&lock_);
+  ++stats_.writes;
+  stats_.depth = depth;
+  stats_.high_water_depth = std::max(stats_.high_water_depth, depth);
+}
+
+void ChannelStats::RecordRead(absl::Duration delay, size_t depth) {
+  absl::MutexLock l(&lock_);
+  ++stats_.reads;
+  stats_.depth = depth;
+  ++stats_.delay_buckets[GetDelayBucket(delay)];
+  stats_.total_delay += delay;
+  stats_.max_delay = std::max(stats_.max_delay, delay);
+}
+
+void ChannelStats::RecordBlockedWrite(absl::Duration blocked_time) {
+  absl::MutexLock l(&lock_);
+  ++stats_.blocked_writes;
+  stats_.blocked_write_time += blocked_time;
+}
+
+ChannelStats::Snapshot ChannelStats::GetSnapshot() const {
+  absl::MutexLock l(&lock_);
+  return stats_;
+}
+
+}  // namespace stratum
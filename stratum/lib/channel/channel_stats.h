@@ -0,0 +1,100 @@
+// Copyright 2018-present Open Networking Foundation
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef STRATUM_LIB_CHANNEL_CHANNEL_STATS_H_
+#define STRATUM_LIB_CHANNEL_CHANNEL_STATS_H_
+
+#include <stddef.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "stratum/glue/integral_types.h"
+
+namespace stratum {
+
+// ChannelStats collects the queueing statistics of a named Channel: how long
+// messages wait in the queue between Write() and Read(), how deep the queue
+// gets and how long writers are blocked on a full queue. All the live
+// instances are kept in a process-wide registry, so the stats of every named
+// Channel can be dumped from a debug endpoint without knowing its owner.
+//
+// This class is thread-safe.
+class ChannelStats {
+ public:
+  // The queueing delay histogram has kNumDelayBuckets buckets. Bucket i counts
+  // the delays lower than 4^i microseconds which do not fit in bucket i - 1.
+  // The last bucket counts all the delays of a second or more.
+  static constexpr int kNumDelayBuckets = 12;
+
+  // A consistent copy of the statistics of a Channel.
+  struct Snapshot {
+    std::string name;
+    size_t max_depth = 0;
+    // Current and maximum observed number of enqueued messages.
+    size_t depth = 0;
+    size_t high_water_depth = 0;
+    uint64 writes = 0;
+    uint64 reads = 0;
+    // Histogram of the time messages spent in the queue.
+    std::vector<uint64> delay_buckets;
+    absl::Duration total_delay = absl::ZeroDuration();
+    absl::Duration max_delay = absl::ZeroDuration();
+    // Writes which had to wait for room in the queue and the total time they
+    // were blocked.
+    uint64 blocked_writes = 0;
+    absl::Duration blocked_write_time = absl::ZeroDuration();
+  };
+
+  ~ChannelStats();
+
+  // Creates the stats of a Channel and adds them to the registry. They are
+  // removed from the registry when the returned object is destroyed. Several
+  // Channels may share the same name.
+  static std::shared_ptr<ChannelStats> CreateInstance(const std::string& name,
+                                                      size_t max_depth);
+
+  // Returns snapshots of the stats of all live named Channels, sorted by name.
+  static std::vector<Snapshot> GetAllSnapshots();
+
+  // Returns a human-readable dump of the stats of all live named Channels.
+  static std::string DumpAll();
+
+  // Returns the index of the histogram bucket counting the given delay.
+  static int GetDelayBucket(absl::Duration delay);
+
+  // Records a message written to the queue, which now holds 'depth' messages.
+  void RecordWrite(size_t depth) LOCKS_EXCLUDED(lock_);
+
+  // Records a message read from the queue, which now holds 'depth' messages,
+  // after waiting in it for 'delay'.
+  void RecordRead(absl::Duration delay, size_t depth) LOCKS_EXCLUDED(lock_);
+
+  // Records a write which was blocked on a full queue for 'blocked_time'.
+  void RecordBlockedWrite(absl::Duration blocked_time) LOCKS_EXCLUDED(lock_);
+
+  // Returns a copy of the statistics.
+  Snapshot GetSnapshot() const LOCKS_EXCLUDED(lock_);
+
+  const std::string& name() const { return name_; }
+
+  // Disallow copy and assign.
+  ChannelStats(const ChannelStats&) = delete;
+  ChannelStats& operator=(const ChannelStats&) = delete;
+
+ private:
+  // Private constructor. Use CreateInstance() to create an instance.
+  ChannelStats(const std::string& name, size_t max_depth);
+
+  const std::string name_;
+  mutable absl::Mutex lock_;
+  Snapshot stats_ GUARDED_BY(lock_);
+};
+
+}  // namespace stratum
+
+#endif  // STRATUM_LIB_CHANNEL_CHANNEL_STATS_H_
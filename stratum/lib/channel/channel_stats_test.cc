@@ -0,0 +1,93 @@
+// Copyright 2018-present Open Networking Foundation
+// SPDX-License-Identifier: Apache-2.0
+
+#include "stratum/lib/channel/channel_stats.h"
+
+#include <memory>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace stratum {
+
+using ::testing::HasSubstr;
+using ::testing::IsEmpty;
+using ::testing::Not;
+
+namespace {
+
+// Returns the stats of the live channels with one of the given names, sorted
+// by name. Channels of other tests may be registered too.
+std::vector<ChannelStats::Snapshot> GetSnapshotsNamed(
+    const std::set<std::string>& names) {
+  std::vector<ChannelStats::Snapshot> snapshots;
+  for (auto& snapshot : ChannelStats::GetAllSnapshots()) {
+    if (names.count(snapshot.name)) snapshots.push_back(std::move(snapshot));
+  }
+  return snapshots;
+}
+
+}  // namespace
+
+TEST(ChannelStatsTest, DelayBuckets) {
+  EXPECT_EQ(0, ChannelStats::GetDelayBucket(absl::ZeroDuration()));
+  EXPECT_EQ(1, ChannelStats::GetDelayBucket(absl::Microseconds(1)));
+  EXPECT_EQ(1, ChannelStats::GetDelayBucket(absl::Microseconds(3)));
+  EXPECT_EQ(2, ChannelStats::GetDelayBucket(absl::Microseconds(4)));
+  EXPECT_EQ(5, ChannelStats::GetDelayBucket(absl::Milliseconds(1)));
+  EXPECT_EQ(ChannelStats::kNumDelayBuckets - 1,
+            ChannelStats::GetDelayBucket(absl::Seconds(2)));
+  EXPECT_EQ(ChannelStats::kNumDelayBuckets - 1,
+            ChannelStats::GetDelayBucket(absl::InfiniteDuration()));
+}
+
+TEST(ChannelStatsTest, RecordAndSnapshot) {
+  auto stats = ChannelStats::CreateInstance("test", 8);
+  stats->RecordWrite(1);
+  stats->RecordWrite(2);
+  stats->RecordWrite(3);
+  stats->RecordRead(absl::Microseconds(2), 2);
+  stats->RecordRead(absl::Milliseconds(5), 1);
+  stats->RecordBlockedWrite(absl::Milliseconds(3));
+
+  ChannelStats::Snapshot snapshot = stats->GetSnapshot();
+  EXPECT_EQ("test", snapshot.name);
+  EXPECT_EQ(8U, snapshot.max_depth);
+  EXPECT_EQ(1U, snapshot.depth);
+  EXPECT_EQ(3U, snapshot.high_water_depth);
+  EXPECT_EQ(3U, snapshot.writes);
+  EXPECT_EQ(2U, snapshot.reads);
+  ASSERT_EQ(ChannelStats::kNumDelayBuckets, snapshot.delay_buckets.size());
+  EXPECT_EQ(1U, snapshot.delay_buckets[1]);
+  EXPECT_EQ(1U, snapshot.delay_buckets[7]);
+  EXPECT_EQ(absl::Microseconds(5002), snapshot.total_delay);
+  EXPECT_EQ(absl::Milliseconds(5), snapshot.max_delay);
+  EXPECT_EQ(1U, snapshot.blocked_writes);
+  EXPECT_EQ(absl::Milliseconds(3), snapshot.blocked_write_time);
+}
+
+TEST(ChannelStatsTest, RegistryFollowsInstanceLifetime) {
+  auto b = ChannelStats::CreateInstance("channel-b", 1);
+  auto a = ChannelStats::CreateInstance("channel-a", 1);
+  a->RecordWrite(1);
+
+  std::vector<ChannelStats::Snapshot> snapshots =
+      GetSnapshotsNamed({"channel-a", "channel-b"});
+  ASSERT_EQ(2U, snapshots.size());
+  EXPECT_EQ("channel-a", snapshots[0].name);
+  EXPECT_EQ(1U, snapshots[0].writes);
+  EXPECT_EQ("channel-b", snapshots[1].name);
+  EXPECT_THAT(ChannelStats::DumpAll(),
+              HasSubstr("channel-a: depth 1/1 (high-water 1), 1 writes"));
+
+  a.reset();
+  b.reset();
+  EXPECT_THAT(GetSnapshotsNamed({"channel-a", "channel-b"}), IsEmpty());
+  EXPECT_THAT(ChannelStats::DumpAll(), Not(HasSubstr("channel-a")));
+}
+
+}  // namespace stratum
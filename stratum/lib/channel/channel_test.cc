@@ -9,6 +9,8 @@
 
 #include <set>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "absl/synchronization/mutex.h"
 #include "gmock/gmock.h"
@@ -97,6 +99,82 @@ TEST(ChannelTest, TestReadWriteClose) {
   EXPECT_EQ(ERR_CANCELLED, reader->Read(&msg, timeout).error_code());
 }
 
+// Test WriteBatch() on a Channel which only has room for part of the batch.
+TEST(ChannelTest, TestWriteBatch) {
+  std::shared_ptr<Channel<int>> channel = Channel<int>::Create(3);
+  auto reader = ChannelReader<int>::Create(channel);
+  auto writer = ChannelWriter<int>::Create(channel);
+
+  std::vector<int> msgs = {1, 2};
+  EXPECT_OK(writer->WriteBatch(&msgs, absl::InfiniteDuration()));
+  EXPECT_TRUE(msgs.empty());
+  // Only the first message fits, the others are left in the batch.
+  msgs = {3, 4, 5};
+  EXPECT_EQ(ERR_NO_RESOURCE,
+            writer->WriteBatch(&msgs, absl::Milliseconds(10)).error_code());
+  EXPECT_EQ(std::vector<int>({4, 5}), msgs);
+
+  EXPECT_OK(reader->ReadAll(&msgs));
+  EXPECT_EQ(std::vector<int>({1, 2, 3}), msgs);
+
+  EXPECT_TRUE(channel->Close());
+  msgs = {6};
+  EXPECT_EQ(ERR_CANCELLED,
+            writer->WriteBatch(&msgs, absl::InfiniteDuration()).error_code());
+  EXPECT_EQ(1, msgs.size());
+}
+
+// Test the statistics of a named Channel.
+namespace {
+
+// Returns the stats of the live channels with the given name. Channels of
+// other tests may be registered too.
+std::vector<ChannelStats::Snapshot> GetSnapshotsNamed(const std::string& name) {
+  std::vector<ChannelStats::Snapshot> snapshots;
+  for (auto& snapshot : ChannelStats::GetAllSnapshots()) {
+    if (snapshot.name == name) snapshots.push_back(std::move(snapshot));
+  }
+  return snapshots;
+}
+
+}  // namespace
+
+TEST(ChannelTest, TestNamedChannelStats) {
+  std::shared_ptr<Channel<int>> channel =
+      Channel<int>::Create(2, "test-channel");
+  auto reader = ChannelReader<int>::Create(channel);
+  auto writer = ChannelWriter<int>::Create(channel);
+
+  EXPECT_OK(writer->TryWrite(1));
+  EXPECT_OK(writer->TryWrite(2));
+  // Blocks until the timeout as the Channel is full.
+  EXPECT_EQ(ERR_NO_RESOURCE,
+            writer->Write(3, absl::Milliseconds(10)).error_code());
+  int msg;
+  EXPECT_OK(reader->TryRead(&msg));
+  std::vector<int> msgs;
+  EXPECT_OK(reader->ReadAll(&msgs));
+
+  std::vector<ChannelStats::Snapshot> snapshots =
+      GetSnapshotsNamed("test-channel");
+  ASSERT_EQ(1, snapshots.size());
+  const ChannelStats::Snapshot& stats = snapshots[0];
+  EXPECT_EQ(0, stats.depth);
+  EXPECT_EQ(2, stats.high_water_depth);
+  EXPECT_EQ(2, stats.writes);
+  EXPECT_EQ(2, stats.reads);
+  EXPECT_EQ(1, stats.blocked_writes);
+  EXPECT_GE(stats.blocked_write_time, absl::Milliseconds(10));
+  // Both messages waited at least for the blocked write.
+  EXPECT_GE(stats.max_delay, absl::Milliseconds(10));
+
+  // The stats are unregistered along with the Channel.
+  reader.reset();
+  writer.reset();
+  channel.reset();
+  EXPECT_TRUE(GetSnapshotsNamed("test-channel").empty());
+}
+
 namespace {
 
 void* TestCloseReadFunc(void* arg) {
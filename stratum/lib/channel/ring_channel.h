@@ -0,0 +1,574 @@
+// Copyright 2018-present Open Networking Foundation
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef STRATUM_LIB_CHANNEL_RING_CHANNEL_H_
+#define STRATUM_LIB_CHANNEL_RING_CHANNEL_H_
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <atomic>
+#include <list>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "absl/base/optimization.h"
+#include "absl/base/thread_annotations.h"
+#include "absl/memory/memory.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "stratum/lib/channel/channel.h"
+#include "stratum/lib/macros.h"
+
+namespace stratum {
+
+// RingChannel<T, Ring> is a Channel<T> backed by a bounded lock-free ring
+// buffer instead of a mutex-protected deque. Messages are exchanged without
+// taking any lock as long as the ring is neither empty (for readers) nor full
+// (for writers). Only then does a thread block on a mutex and condition
+// variable, and the other side takes that lock only if it knows that there is
+// a blocked thread to wake up.
+//
+// Two variants are provided:
+//
+//   SpscChannel<T>: At most one thread may write and at most one thread may
+//   read at any given time.
+//
+//   MpscChannel<T>: Any number of threads may write concurrently, at most one
+//   thread may read at any given time.
+//
+// Both are used through the usual ChannelReader<T> and ChannelWriter<T>, so
+// existing users of Channel<T> can switch by changing the Create() call:
+//
+//   std::shared_ptr<Channel<T>> channel = MpscChannel<T>::Create(max_depth);
+//   auto reader = ChannelReader<T>::Create(channel);
+//   auto writer = ChannelWriter<T>::Create(channel);
+//
+// Notes on Usage:
+//
+// 1. The maximum depth is rounded up to the next power of two, and is at least
+//    two.
+//
+// 2. T must be default-constructible, as the ring holds an instance of T per
+//    slot. Slots are reused, so a message is only destroyed when its slot is
+//    overwritten or the Channel is destroyed.
+//
+// 3. Violating the single reader (or single writer) requirement corrupts the
+//    Channel. Use a Channel<T> if this cannot be guaranteed.
+
+namespace channel_internal {
+
+// Returns the smallest power of two which is greater than or equal to n.
+inline size_t RoundUpToPowerOfTwo(size_t n) {
+  size_t result = 1;
+  while (result < n) result <<= 1;
+  return result;
+}
+
+// Bounded single-producer single-consumer ring. Each side caches the last
+// seen index of the other side so that the shared cache line is only read
+// when the ring looks empty or full.
+//
+// The indices are padded to be on their own cache lines. Padding is used
+// rather than alignment as over-aligned objects are not supported by operator
+// new before C++17.
+template <typename T>
+class SpscRing {
+ public:
+  explicit SpscRing(size_t capacity)
+      : mask_(capacity - 1),
+        slots_(new T[capacity]),
+        head_(0),
+        tail_cache_(0),
+        tail_(0),
+        head_cache_(0) {}
+
+  // Moves *t into the ring and returns true, or returns false if the ring is
+  // full. *t is left untouched in the latter case. Producer side only.
+  bool TryPush(T* t) {
+    const size_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail - head_cache_ > mask_) {
+      head_cache_ = head_.load(std::memory_order_acquire);
+      if (tail - head_cache_ > mask_) return false;
+    }
+    slots_[tail & mask_] = std::move(*t);
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Moves the oldest element into *t and returns true, or returns false if
+  // the ring is empty. Consumer side only.
+  bool TryPop(T* t) {
+    const size_t head = head_.load(std::memory_order_relaxed);
+    if (head == tail_cache_) {
+      tail_cache_ = tail_.load(std::memory_order_acquire);
+      if (head == tail_cache_) return false;
+    }
+    *t = std::move(slots_[head & mask_]);
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Returns true if there are no elements in the ring. Can be called from any
+  // thread.
+  bool Empty() const {
+    return head_.load(std::memory_order_acquire) ==
+           tail_.load(std::memory_order_acquire);
+  }
+
+  size_t Capacity() const { return mask_ + 1; }
+
+  // Disallow copy and assign.
+  SpscRing(const SpscRing&) = delete;
+  SpscRing& operator=(const SpscRing&) = delete;
+
+ private:
+  const size_t mask_;
+  const std::unique_ptr<T[]> slots_;
+  char pad0_[ABSL_CACHELINE_SIZE];
+  // Consumer side.
+  std::atomic<size_t> head_;
+  size_t tail_cache_;
+  char pad1_[ABSL_CACHELINE_SIZE - sizeof(std::atomic<size_t>) -
+             sizeof(size_t)];
+  // Producer side.
+  std::atomic<size_t> tail_;
+  size_t head_cache_;
+  char pad2_[ABSL_CACHELINE_SIZE - sizeof(std::atomic<size_t>) -
+             sizeof(size_t)];
+};
+
+// Bounded multi-producer single-consumer ring. Every slot carries a sequence
+// number telling whether it is free for the producer of a given position or
+// holds the element for the consumer of that position. Producers claim a
+// position with a CAS on the tail and publish the element through the
+// sequence number of its slot, so a slow producer never exposes a partially
+// written element. The capacity must be at least two.
+template <typename T>
+class MpscRing {
+ public:
+  explicit MpscRing(size_t capacity)
+      : mask_(capacity - 1), slots_(new Slot[capacity]), head_(0), tail_(0) {
+    for (size_t i = 0; i < capacity; ++i) {
+      slots_[i].seq.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  // Moves *t into the ring and returns true, or returns false if the ring is
+  // full. *t is left untouched in the latter case. Thread-safe.
+  bool TryPush(T* t) {
+    size_t pos = tail_.load(std::memory_order_relaxed);
+    Slot* slot;
+    while (true) {
+      slot = &slots_[pos & mask_];
+      const size_t seq = slot->seq.load(std::memory_order_acquire);
+      const intptr_t diff =
+          static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+      if (diff == 0) {
+        // The slot is free. Try to claim the position.
+        if (tail_.compare_exchange_weak(pos, pos + 1,
+                                        std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (diff < 0) {
+        // The slot still holds the element of the previous round.
+        return false;
+      } else {
+        // Another producer claimed the position first.
+        pos = tail_.load(std::memory_order_relaxed);
+      }
+    }
+    slot->value = std::move(*t);
+    slot->seq.store(pos + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Moves the oldest element into *t and returns true, or returns false if
+  // the ring is empty or the oldest element is still being written. Consumer
+  // side only.
+  bool TryPop(T* t) {
+    const size_t head = head_.load(std::memory_order_relaxed);
+    Slot* slot = &slots_[head & mask_];
+    if (slot->seq.load(std::memory_order_acquire) != head + 1) return false;
+    *t = std::move(slot->value);
+    // Hand the slot over to the producer of the next round.
+    slot->seq.store(head + mask_ + 1, std::memory_order_release);
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Returns true if there is no element ready to be popped. Can be called from
+  // any thread.
+  bool Empty() const {
+    const size_t head = head_.load(std::memory_order_acquire);
+    return slots_[head & mask_].seq.load(std::memory_order_acquire) !=
+           head + 1;
+  }
+
+  size_t Capacity() const { return mask_ + 1; }
+
+  // Disallow copy and assign.
+  MpscRing(const MpscRing&) = delete;
+  MpscRing& operator=(const MpscRing&) = delete;
+
+ private:
+  struct Slot {
+    std::atomic<size_t> seq;
+    T value;
+  };
+
+  const size_t mask_;
+  const std::unique_ptr<Slot[]> slots_;
+  char pad0_[ABSL_CACHELINE_SIZE];
+  // Consumer side.
+  std::atomic<size_t> head_;
+  char pad1_[ABSL_CACHELINE_SIZE - sizeof(std::atomic<size_t>)];
+  // Producer side.
+  std::atomic<size_t> tail_;
+  char pad2_[ABSL_CACHELINE_SIZE - sizeof(std::atomic<size_t>)];
+};
+
+}  // namespace channel_internal
+
+template <typename T, typename Ring>
+class RingChannel : public Channel<T> {
+ public:
+  ~RingChannel() override {}
+
+  // Creates a RingChannel holding up to max_depth messages, rounded up to the
+  // next power of two. The ring of MpscChannel cannot tell a full slot from a
+  // free one with a single slot, so there are always at least two.
+  static std::unique_ptr<Channel<T>> Create(size_t max_depth) {
+    const size_t capacity =
+        channel_internal::RoundUpToPowerOfTwo(std::max<size_t>(max_depth, 2));
+    return absl::WrapUnique(new RingChannel<T, Ring>(capacity));
+  }
+
+  bool Close() LOCKS_EXCLUDED(lock_) override;
+  bool IsClosed() override;
+
+  // Disallow copy and assign.
+  RingChannel(const RingChannel&) = delete;
+  RingChannel& operator=(const RingChannel&) = delete;
+
+ protected:
+  // The following functions implement the Channel<T> interface. See channel.h
+  // for their documentation.
+  ::util::Status Write(const T& t, absl::Duration timeout)
+      LOCKS_EXCLUDED(lock_) override;
+  ::util::Status Write(T&& t, absl::Duration timeout)
+      LOCKS_EXCLUDED(lock_) override;
+  ::util::Status TryWrite(const T& t) LOCKS_EXCLUDED(lock_) override;
+  ::util::Status TryWrite(T&& t) LOCKS_EXCLUDED(lock_) override;
+  ::util::Status WriteBatch(std::vector<T>* t_s, absl::Duration timeout)
+      LOCKS_EXCLUDED(lock_) override;
+  ::util::Status Read(T* t, absl::Duration timeout)
+      LOCKS_EXCLUDED(lock_) override;
+  ::util::Status TryRead(T* t) LOCKS_EXCLUDED(lock_) override;
+  ::util::Status ReadAll(std::vector<T>* t_s) LOCKS_EXCLUDED(lock_) override;
+  void SelectRegister(
+      const std::shared_ptr<channel_internal::SelectData>& select_data,
+      bool* ready) LOCKS_EXCLUDED(lock_) override;
+
+ private:
+  // Private constructor which initializes the ring to the given capacity,
+  // which must be a power of two.
+  explicit RingChannel(size_t capacity)
+      : Channel<T>(capacity),
+        ring_(capacity),
+        closed_(false),
+        waiting_readers_(0),
+        waiting_writers_(0),
+        num_selects_(0) {}
+
+  // Slow path of the writes. Blocks until *t could be moved into the ring or
+  // the deadline is reached.
+  ::util::Status WaitAndPush(T* t, absl::Time deadline) LOCKS_EXCLUDED(lock_);
+
+  // Slow path of Read(). Blocks until an element could be moved into *t or
+  // the deadline is reached.
+  ::util::Status WaitAndPop(T* t, absl::Time deadline) LOCKS_EXCLUDED(lock_);
+
+  // Wakes up a blocked ChannelReader and any Select()-ing threads, if there
+  // are any. Called after elements have been pushed.
+  void NotifyReaders() LOCKS_EXCLUDED(lock_);
+
+  // Wakes up one or all blocked ChannelWriters, if there are any. Called after
+  // elements have been popped.
+  void NotifyWriters(bool all) LOCKS_EXCLUDED(lock_);
+
+  // Signals all the registered Select() operations and clears the list. If
+  // ready is true, the operations are also marked done.
+  void ClearSelectList(bool ready) EXCLUSIVE_LOCKS_REQUIRED(lock_);
+
+  Ring ring_;
+
+  // Set under lock_, but read without it on the fast paths.
+  std::atomic<bool> closed_;
+
+  // The number of blocked threads and registered Select() operations. They
+  // are incremented before a thread re-checks the ring and goes to sleep, and
+  // are read by the other side after updating the ring. This ordering, along
+  // with the fences, guarantees that either the blocked thread sees the update
+  // or the other side sees the thread and takes lock_ to signal it.
+  std::atomic<int> waiting_readers_;
+  std::atomic<int> waiting_writers_;
+  std::atomic<int> num_selects_;
+
+  // Mutex used only to block on an empty or full ring.
+  absl::Mutex lock_;
+  std::list<std::shared_ptr<channel_internal::SelectData>> select_list_
+      GUARDED_BY(lock_);
+
+  // Condition variable for ChannelReaders waiting on an empty ring.
+  absl::CondVar cond_not_empty_;
+
+  // Condition variable for ChannelWriters waiting on a full ring.
+  absl::CondVar cond_not_full_;
+};
+
+// Lock-free Channel with a single writer and a single reader.
+template <typename T>
+using SpscChannel = RingChannel<T, channel_internal::SpscRing<T>>;
+
+// Lock-free Channel with any number of writers and a single reader.
+template <typename T>
+using MpscChannel = RingChannel<T, channel_internal::MpscRing<T>>;
+
+template <typename T, typename Ring>
+bool RingChannel<T, Ring>::Close() {
+  absl::MutexLock l(&lock_);
+  if (closed_.load(std::memory_order_relaxed)) return false;
+  closed_.store(true, std::memory_order_release);
+  // Signal all blocked ChannelWriters.
+  cond_not_full_.SignalAll();
+  // Signal all blocked ChannelReaders.
+  cond_not_empty_.SignalAll();
+  // Signal any Select()-ing threads.
+  ClearSelectList(false);
+  return true;
+}
+
+template <typename T, typename Ring>
+bool RingChannel<T, Ring>::IsClosed() {
+  return closed_.load(std::memory_order_acquire);
+}
+
+template <typename T, typename Ring>
+::util::Status RingChannel<T, Ring>::Write(const T& t,
+                                           absl::Duration timeout) {
+  T copy(t);
+  return Write(std::move(copy), timeout);
+}
+
+template <typename T, typename Ring>
+::util::Status RingChannel<T, Ring>::Write(T&& t, absl::Duration timeout) {
+  if (closed_.load(std::memory_order_acquire)) {
+    return MAKE_ERROR(ERR_CANCELLED) << "Channel is closed.";
+  }
+  if (!ring_.TryPush(&t)) {
+    RETURN_IF_ERROR(WaitAndPush(&t, absl::Now() + timeout));
+  }
+  NotifyReaders();
+  return ::util::OkStatus();
+}
+
+template <typename T, typename Ring>
+::util::Status RingChannel<T, Ring>::TryWrite(const T& t) {
+  T copy(t);
+  return TryWrite(std::move(copy));
+}
+
+template <typename T, typename Ring>
+::util::Status RingChannel<T, Ring>::TryWrite(T&& t) {
+  if (closed_.load(std::memory_order_acquire)) {
+    return MAKE_ERROR(ERR_CANCELLED) << "Channel is closed.";
+  }
+  if (!ring_.TryPush(&t)) {
+    // Not logged, callers of TryWrite() are expected to handle a full
+    // Channel, e.g. by dropping the message.
+    return MAKE_ERROR(ERR_NO_RESOURCE).without_logging() << "Channel is full.";
+  }
+  NotifyReaders();
+  return ::util::OkStatus();
+}
+
+template <typename T, typename Ring>
+::util::Status RingChannel<T, Ring>::WriteBatch(std::vector<T>* t_s,
+                                                absl::Duration timeout) {
+  if (closed_.load(std::memory_order_acquire)) {
+    return MAKE_ERROR(ERR_CANCELLED) << "Channel is closed.";
+  }
+  absl::Time deadline = absl::Now() + timeout;
+  ::util::Status status = ::util::OkStatus();
+  size_t written = 0;
+  for (; written < t_s->size(); ++written) {
+    T* t = &(*t_s)[written];
+    if (ring_.TryPush(t)) continue;
+    // The ring is full. Let the ChannelReader drain what was written so far
+    // before blocking.
+    if (written > 0) NotifyReaders();
+    status = WaitAndPush(t, deadline);
+    if (!status.ok()) break;
+  }
+  t_s->erase(t_s->begin(), t_s->begin() + written);
+  // A single notification for the whole batch.
+  if (written > 0) NotifyReaders();
+  return status;
+}
+
+template <typename T, typename Ring>
+::util::Status RingChannel<T, Ring>::Read(T* t, absl::Duration timeout) {
+  if (closed_.load(std::memory_order_acquire)) {
+    return MAKE_ERROR(ERR_CANCELLED).without_logging() << "Channel is closed.";
+  }
+  if (!ring_.TryPop(t)) {
+    RETURN_IF_ERROR(WaitAndPop(t, absl::Now() + timeout));
+  }
+  NotifyWriters(false);
+  return ::util::OkStatus();
+}
+
+template <typename T, typename Ring>
+::util::Status RingChannel<T, Ring>::TryRead(T* t) {
+  if (closed_.load(std::memory_order_acquire)) {
+    return MAKE_ERROR(ERR_CANCELLED) << "Channel is closed.";
+  }
+  if (!ring_.TryPop(t)) {
+    return MAKE_ERROR(ERR_ENTRY_NOT_FOUND) << "Channel is empty.";
+  }
+  NotifyWriters(false);
+  return ::util::OkStatus();
+}
+
+template <typename T, typename Ring>
+::util::Status RingChannel<T, Ring>::ReadAll(std::vector<T>* t_s) {
+  if (closed_.load(std::memory_order_acquire)) {
+    return MAKE_ERROR(ERR_CANCELLED) << "Channel is closed.";
+  }
+  t_s->clear();
+  T t;
+  while (ring_.TryPop(&t)) t_s->push_back(std::move(t));
+  if (!t_s->empty()) NotifyWriters(true);
+  return ::util::OkStatus();
+}
+
+template <typename T, typename Ring>
+void RingChannel<T, Ring>::SelectRegister(
+    const std::shared_ptr<channel_internal::SelectData>& select_data,
+    bool* ready) {
+  absl::MutexLock l(&lock_);
+  // Check for Channel closure.
+  if (closed_.load(std::memory_order_relaxed)) return;
+  absl::MutexLock sel_lock(&select_data->lock);
+  // Only enqueue a copy of select_data if the operation is not done.
+  if (!select_data->done) {
+    select_list_.push_back(select_data);
+    num_selects_.fetch_add(1);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+  }
+  // Messages written before the registration was visible to the writers do
+  // not trigger a notification, so the ring is checked afterwards.
+  if (!ring_.Empty()) {
+    *ready = true;
+    select_data->done = true;
+  }
+}
+
+template <typename T, typename Ring>
+::util::Status RingChannel<T, Ring>::WaitAndPush(T* t, absl::Time deadline) {
+  absl::MutexLock l(&lock_);
+  waiting_writers_.fetch_add(1);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  ::util::Status status = ::util::OkStatus();
+  bool expired = false;
+  while (true) {
+    // Could have been signalled because Channel is now closed.
+    if (closed_.load(std::memory_order_relaxed)) {
+      status = MAKE_ERROR(ERR_CANCELLED) << "Channel is closed.";
+      break;
+    }
+    if (ring_.TryPush(t)) break;
+    if (expired) {
+      status = MAKE_ERROR(ERR_NO_RESOURCE)
+               << "Write did not succeed within timeout due to full Channel.";
+      break;
+    }
+    expired = cond_not_full_.WaitWithDeadline(&lock_, deadline);
+  }
+  waiting_writers_.fetch_sub(1);
+  return status;
+}
+
+template <typename T, typename Ring>
+::util::Status RingChannel<T, Ring>::WaitAndPop(T* t, absl::Time deadline) {
+  absl::MutexLock l(&lock_);
+  waiting_readers_.fetch_add(1);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  ::util::Status status = ::util::OkStatus();
+  bool expired = false;
+  while (true) {
+    // Could have been signalled because Channel is now closed.
+    if (closed_.load(std::memory_order_relaxed)) {
+      status = MAKE_ERROR(ERR_CANCELLED).without_logging()
+               << "Channel is closed.";
+      break;
+    }
+    if (ring_.TryPop(t)) break;
+    if (expired) {
+      status = MAKE_ERROR(ERR_ENTRY_NOT_FOUND)
+               << "Read did not succeed within timeout due to empty Channel.";
+      break;
+    }
+    expired = cond_not_empty_.WaitWithDeadline(&lock_, deadline);
+  }
+  waiting_readers_.fetch_sub(1);
+  return status;
+}
+
+template <typename T, typename Ring>
+void RingChannel<T, Ring>::NotifyReaders() {
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (waiting_readers_.load(std::memory_order_relaxed) == 0 &&
+      num_selects_.load(std::memory_order_relaxed) == 0) {
+    return;
+  }
+  absl::MutexLock l(&lock_);
+  // Signal next blocked ChannelReader.
+  cond_not_empty_.Signal();
+  // Signal any Select()-ing threads.
+  ClearSelectList(true);
+}
+
+template <typename T, typename Ring>
+void RingChannel<T, Ring>::NotifyWriters(bool all) {
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (waiting_writers_.load(std::memory_order_relaxed) == 0) return;
+  absl::MutexLock l(&lock_);
+  if (all) {
+    cond_not_full_.SignalAll();
+  } else {
+    cond_not_full_.Signal();
+  }
+}
+
+template <typename T, typename Ring>
+void RingChannel<T, Ring>::ClearSelectList(bool ready) {
+  while (!select_list_.empty()) {
+    auto& select_data = select_list_.front();
+    {
+      // Set select done flag and signal Select()-ing thread. The ready flag
+      // is not touched as the Select() may have returned already.
+      absl::MutexLock sel_lock(&select_data->lock);
+      if (ready) select_data->done = true;
+      select_data->cond.Signal();
+    }
+    select_list_.pop_front();
+  }
+  num_selects_.store(0);
+}
+
+}  // namespace stratum
+
+#endif  // STRATUM_LIB_CHANNEL_RING_CHANNEL_H_
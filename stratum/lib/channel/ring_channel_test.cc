@@ -0,0 +1,220 @@
+// Copyright 2018-present Open Networking Foundation
+// SPDX-License-Identifier: Apache-2.0
+
+#include "stratum/lib/channel/ring_channel.h"
+
+#include <pthread.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/synchronization/mutex.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "stratum/glue/status/status_test_util.h"
+
+namespace stratum {
+
+using channel_internal::ChannelBase;
+using ::testing::ElementsAre;
+using ::testing::IsEmpty;
+
+// The tests are run for both variants of the ring.
+template <typename RingChannelType>
+class RingChannelTest : public ::testing::Test {
+ protected:
+  static std::shared_ptr<Channel<int>> Create(size_t max_depth) {
+    return RingChannelType::Create(max_depth);
+  }
+};
+
+typedef ::testing::Types<SpscChannel<int>, MpscChannel<int>> RingChannelTypes;
+TYPED_TEST_SUITE(RingChannelTest, RingChannelTypes);
+
+TYPED_TEST(RingChannelTest, TestReadWriteClose) {
+  // The depth is rounded up to 4.
+  auto channel = this->Create(3);
+  auto reader = ChannelReader<int>::Create(channel);
+  auto writer = ChannelWriter<int>::Create(channel);
+  absl::Duration timeout = absl::InfiniteDuration();
+
+  for (int i = 0; i < 4; ++i) EXPECT_OK(writer->TryWrite(i));
+  EXPECT_EQ(ERR_NO_RESOURCE, writer->TryWrite(4).error_code());
+  EXPECT_EQ(ERR_NO_RESOURCE,
+            writer->Write(4, absl::Milliseconds(10)).error_code());
+
+  int msg;
+  for (int i = 0; i < 4; ++i) {
+    EXPECT_OK(reader->Read(&msg, timeout));
+    EXPECT_EQ(i, msg);
+  }
+  EXPECT_EQ(ERR_ENTRY_NOT_FOUND, reader->TryRead(&msg).error_code());
+  EXPECT_EQ(ERR_ENTRY_NOT_FOUND,
+            reader->Read(&msg, absl::Milliseconds(10)).error_code());
+
+  // The indices wrap around the ring.
+  for (int round = 0; round < 10; ++round) {
+    EXPECT_OK(writer->TryWrite(round));
+    EXPECT_OK(writer->TryWrite(round + 1));
+    EXPECT_OK(reader->TryRead(&msg));
+    EXPECT_EQ(round, msg);
+    EXPECT_OK(reader->TryRead(&msg));
+    EXPECT_EQ(round + 1, msg);
+  }
+
+  EXPECT_TRUE(channel->Close());
+  EXPECT_FALSE(channel->Close());
+  EXPECT_TRUE(reader->IsClosed());
+  EXPECT_EQ(ERR_CANCELLED, writer->TryWrite(1).error_code());
+  EXPECT_EQ(ERR_CANCELLED, reader->Read(&msg, timeout).error_code());
+}
+
+TYPED_TEST(RingChannelTest, TestWriteBatchReadAll) {
+  auto channel = this->Create(4);
+  auto reader = ChannelReader<int>::Create(channel);
+  auto writer = ChannelWriter<int>::Create(channel);
+
+  std::vector<int> msgs = {1, 2, 3};
+  EXPECT_OK(writer->WriteBatch(&msgs, absl::InfiniteDuration()));
+  EXPECT_THAT(msgs, IsEmpty());
+  // Only one of the two messages fits.
+  msgs = {4, 5};
+  EXPECT_EQ(ERR_NO_RESOURCE,
+            writer->WriteBatch(&msgs, absl::Milliseconds(10)).error_code());
+  EXPECT_THAT(msgs, ElementsAre(5));
+
+  EXPECT_OK(reader->ReadAll(&msgs));
+  EXPECT_THAT(msgs, ElementsAre(1, 2, 3, 4));
+  EXPECT_OK(reader->ReadAll(&msgs));
+  EXPECT_THAT(msgs, IsEmpty());
+}
+
+TYPED_TEST(RingChannelTest, TestBlockingReadWrite) {
+  auto channel = this->Create(2);
+  auto reader = ChannelReader<int>::Create(channel);
+  auto writer = ChannelWriter<int>::Create(channel);
+
+  // The writer blocks on the full ring and the reader on the empty ring, so
+  // both sides go through the slow path many times.
+  constexpr int kNumMessages = 10000;
+  pthread_t tid;
+  ASSERT_EQ(0, pthread_create(
+                   &tid, nullptr,
+                   [](void* arg) -> void* {
+                     auto* writer = static_cast<ChannelWriter<int>*>(arg);
+                     absl::Duration timeout = absl::InfiniteDuration();
+                     std::vector<int> batch;
+                     for (int i = 0; i < kNumMessages; i += 2) {
+                       EXPECT_OK(writer->Write(i, timeout));
+                       batch = {i + 1};
+                       EXPECT_OK(writer->WriteBatch(&batch, timeout));
+                     }
+                     return nullptr;
+                   },
+                   writer.get()));
+  for (int i = 0; i < kNumMessages; ++i) {
+    int msg = -1;
+    EXPECT_OK(reader->Read(&msg, absl::InfiniteDuration()));
+    EXPECT_EQ(i, msg);
+  }
+  EXPECT_EQ(0, pthread_join(tid, nullptr));
+}
+
+TYPED_TEST(RingChannelTest, TestCloseWakesBlockedReader) {
+  auto channel = this->Create(1);
+  auto reader = ChannelReader<int>::Create(channel);
+
+  pthread_t tid;
+  ASSERT_EQ(0, pthread_create(
+                   &tid, nullptr,
+                   [](void* arg) -> void* {
+                     absl::SleepFor(absl::Milliseconds(50));
+                     static_cast<Channel<int>*>(arg)->Close();
+                     return nullptr;
+                   },
+                   channel.get()));
+  int msg;
+  EXPECT_EQ(ERR_CANCELLED,
+            reader->Read(&msg, absl::InfiniteDuration()).error_code());
+  EXPECT_EQ(0, pthread_join(tid, nullptr));
+}
+
+TYPED_TEST(RingChannelTest, TestSelect) {
+  std::shared_ptr<Channel<int>> channel = this->Create(4);
+  auto reader = ChannelReader<int>::Create(channel);
+  auto writer = ChannelWriter<int>::Create(channel);
+  std::vector<ChannelBase*> channels = {channel.get()};
+
+  EXPECT_EQ(ERR_ENTRY_NOT_FOUND,
+            Select(channels, absl::Milliseconds(10)).status().error_code());
+
+  // A message written before the Select() marks the Channel ready.
+  EXPECT_OK(writer->TryWrite(1));
+  auto status_or_ready = Select(channels, absl::InfiniteDuration());
+  ASSERT_OK(status_or_ready.status());
+  EXPECT_TRUE(status_or_ready.ValueOrDie()(channel.get()));
+  int msg;
+  EXPECT_OK(reader->TryRead(&msg));
+
+  // A message written during the Select() wakes it up.
+  pthread_t tid;
+  ASSERT_EQ(0, pthread_create(
+                   &tid, nullptr,
+                   [](void* arg) -> void* {
+                     absl::SleepFor(absl::Milliseconds(50));
+                     EXPECT_OK(static_cast<ChannelWriter<int>*>(arg)->Write(
+                         2, absl::InfiniteDuration()));
+                     return nullptr;
+                   },
+                   writer.get()));
+  EXPECT_OK(Select(channels, absl::InfiniteDuration()).status());
+  EXPECT_EQ(0, pthread_join(tid, nullptr));
+  EXPECT_OK(reader->TryRead(&msg));
+  EXPECT_EQ(2, msg);
+}
+
+// Multiple writers write concurrently to a MpscChannel. The messages of each
+// writer must be received in order and none may be lost.
+TEST(RingChannelTest, MpscStressTest) {
+  constexpr int kNumWriters = 4;
+  constexpr int kNumMessages = 20000;
+  std::shared_ptr<Channel<int>> channel = MpscChannel<int>::Create(16);
+  auto reader = ChannelReader<int>::Create(channel);
+
+  struct WriterArgs {
+    std::unique_ptr<ChannelWriter<int>> writer;
+    int id;
+  };
+  std::vector<WriterArgs> args(kNumWriters);
+  std::vector<pthread_t> tids(kNumWriters);
+  for (int i = 0; i < kNumWriters; ++i) {
+    args[i].writer = ChannelWriter<int>::Create(channel);
+    args[i].id = i;
+    ASSERT_EQ(0, pthread_create(
+                     &tids[i], nullptr,
+                     [](void* arg) -> void* {
+                       auto* args = static_cast<WriterArgs*>(arg);
+                       for (int n = 0; n < kNumMessages; ++n) {
+                         EXPECT_OK(args->writer->Write(
+                             n * kNumWriters + args->id,
+                             absl::InfiniteDuration()));
+                       }
+                       return nullptr;
+                     },
+                     &args[i]));
+  }
+
+  std::vector<int> next(kNumWriters, 0);
+  for (int i = 0; i < kNumWriters * kNumMessages; ++i) {
+    int msg = -1;
+    ASSERT_OK(reader->Read(&msg, absl::InfiniteDuration()));
+    const int id = msg % kNumWriters;
+    EXPECT_EQ(next[id], msg / kNumWriters);
+    next[id] = msg / kNumWriters + 1;
+  }
+  for (pthread_t tid : tids) EXPECT_EQ(0, pthread_join(tid, nullptr));
+  for (int n : next) EXPECT_EQ(kNumMessages, n);
+}
+
+}  // namespace stratum
@@ -5,6 +5,11 @@
 #include "stratum/lib/p4runtime/sdn_controller_manager.h"
 
 #include <algorithm>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
 
 #include "absl/numeric/int128.h"
 #include "absl/status/status.h"
@@ -20,6 +25,11 @@ namespace stratum {
 namespace p4runtime {
 namespace {
 
+// Registry of all the live send queues.
+ABSL_CONST_INIT absl::Mutex send_queue_registry_lock(absl::kConstInit);
+std::vector<SdnConnection::SendQueue*>* send_queue_registry
+    ABSL_GUARDED_BY(send_queue_registry_lock) = nullptr;
+
 std::string PrettyPrintRoleName(const absl::optional<std::string>& name) {
   return (name.has_value()) ? absl::StrCat("'", *name, "'") : "<default>";
 }
@@ -303,8 +313,179 @@ grpc::Status VerifyRoleCanAccessIds(
 
 }  // namespace
 
+SdnConnection::SendQueue::SendQueue(
+    grpc::ServerReaderWriterInterface<p4::v1::StreamMessageResponse,
+                                      p4::v1::StreamMessageRequest>* stream,
+    const SendQueueOptions& options)
+    : options_(options), stream_(stream), closed_(false), stopped_(false) {
+  absl::MutexLock l(&send_queue_registry_lock);
+  if (send_queue_registry == nullptr) {
+    send_queue_registry = new std::vector<SdnConnection::SendQueue*>();
+  }
+  send_queue_registry->push_back(this);
+}
+
+SdnConnection::SendQueue::~SendQueue() {
+  absl::MutexLock l(&send_queue_registry_lock);
+  send_queue_registry->erase(std::remove(send_queue_registry->begin(),
+                                         send_queue_registry->end(), this),
+                             send_queue_registry->end());
+}
+
+std::string SdnConnection::SendQueue::DumpAll() {
+  std::vector<std::pair<std::string, std::string>> dumps;
+  {
+    absl::MutexLock l(&send_queue_registry_lock);
+    if (send_queue_registry == nullptr) return "";
+    for (const auto* queue : *send_queue_registry) {
+      absl::MutexLock queue_lock(&queue->lock_);
+      const SendQueueStats& stats = queue->stats_;
+      dumps.emplace_back(
+          queue->name_,
+          absl::StrCat(queue->name_, ": depth ", queue->queue_.size(), "/",
+                       queue->options_.max_depth, " (high-water ",
+                       stats.max_depth_seen, "), ", stats.sent, " sent, ",
+                       stats.dropped, " dropped, ", stats.write_failures,
+                       " write failures\n"));
+    }
+  }
+  std::stable_sort(dumps.begin(), dumps.end(),
+                   [](const std::pair<std::string, std::string>& lhs,
+                      const std::pair<std::string, std::string>& rhs) {
+                     return lhs.first < rhs.first;
+                   });
+  std::string dump;
+  for (const auto& e : dumps) absl::StrAppend(&dump, e.second);
+  return dump;
+}
+
+bool SdnConnection::SendQueue::Enqueue(
+    const p4::v1::StreamMessageResponse& response) {
+  absl::MutexLock l(&lock_);
+  if (closed_) {
+    ++stats_.dropped;
+    return false;
+  }
+  if (queue_.size() >= options_.max_depth && !response.has_arbitration()) {
+    if (options_.drop_policy == SendQueueDropPolicy::kDropNewest) {
+      ++stats_.dropped;
+      return false;
+    }
+    auto oldest = std::find_if(
+        queue_.begin(), queue_.end(),
+        [](const p4::v1::StreamMessageResponse& queued) {
+          return !queued.has_arbitration();
+        });
+    if (oldest != queue_.end()) {
+      queue_.erase(oldest);
+      ++stats_.dropped;
+    }
+  }
+  queue_.push_back(response);
+  stats_.max_depth_seen = std::max(stats_.max_depth_seen, queue_.size());
+  return true;
+}
+
+void SdnConnection::SendQueue::Run() {
+  while (true) {
+    p4::v1::StreamMessageResponse response;
+    {
+      absl::MutexLock l(&lock_);
+      lock_.Await(absl::Condition(this, &SendQueue::HasWork));
+      if (queue_.empty()) break;
+      response = std::move(queue_.front());
+      queue_.pop_front();
+    }
+    VLOG(2) << "Sending response: " << response.ShortDebugString();
+    // The stream is written without holding the lock, so that messages can be
+    // queued while a slow controller is being written to.
+    bool success = stream_->Write(response);
+    LOG_IF_EVERY_N(ERROR, !success, 100)
+        << "Could not send stream message response: "
+        << response.ShortDebugString();
+    absl::MutexLock l(&lock_);
+    if (success) {
+      ++stats_.sent;
+    } else {
+      ++stats_.write_failures;
+    }
+  }
+  absl::MutexLock l(&lock_);
+  stopped_ = true;
+}
+
+void SdnConnection::SendQueue::Close() {
+  absl::MutexLock l(&lock_);
+  closed_ = true;
+}
+
+void SdnConnection::SendQueue::Discard() {
+  absl::MutexLock l(&lock_);
+  closed_ = true;
+  stats_.dropped += queue_.size();
+  queue_.clear();
+}
+
+bool SdnConnection::SendQueue::AwaitStopped(absl::Duration timeout) {
+  absl::MutexLock l(&lock_);
+  return lock_.AwaitWithTimeout(absl::Condition(&stopped_), timeout);
+}
+
+SendQueueStats SdnConnection::SendQueue::GetStats() const {
+  absl::MutexLock l(&lock_);
+  SendQueueStats stats = stats_;
+  stats.depth = queue_.size();
+  return stats;
+}
+
+void SdnConnection::SendQueue::SetName(const std::string& name) {
+  absl::MutexLock l(&lock_);
+  name_ = name;
+}
+
+SdnConnection::SdnConnection(
+    grpc::ServerContext* context,
+    grpc::ServerReaderWriterInterface<p4::v1::StreamMessageResponse,
+                                      p4::v1::StreamMessageRequest>* stream,
+    const SendQueueOptions& options)
+    : initialized_(false),
+      grpc_context_(context),
+      grpc_stream_(stream),
+      send_queue_(std::make_shared<SendQueue>(stream, options)),
+      drain_timeout_(options.drain_timeout),
+      cancel_stream_([context]() { context->TryCancel(); }) {
+  send_queue_->SetName(GetName());
+}
+
+SdnConnection::~SdnConnection() {
+  send_queue_->Close();
+  if (!writer_thread_.joinable()) return;
+  if (!send_queue_->AwaitStopped(drain_timeout_)) {
+    LOG(WARNING) << "Controller " << GetName() << " did not read its last "
+                 << send_queue_->GetStats().depth
+                 << " stream message responses within "
+                 << absl::FormatDuration(drain_timeout_)
+                 << ", cancelling the stream.";
+    send_queue_->Discard();
+    cancel_stream_();
+  }
+  writer_thread_.join();
+}
+
+void SdnConnection::Initialize() {
+  StartWriterThread();
+  initialized_ = true;
+}
+
+void SdnConnection::StartWriterThread() {
+  std::call_once(writer_thread_started_, [this]() {
+    writer_thread_ = std::thread([queue = send_queue_]() { queue->Run(); });
+  });
+}
+
 void SdnConnection::SetElectionId(const absl::optional<absl::uint128>& id) {
   election_id_ = id;
+  send_queue_->SetName(GetName());
 }
 
 absl::optional<absl::uint128> SdnConnection::GetElectionId() const {
@@ -313,6 +494,7 @@ absl::optional<absl::uint128> SdnConnection::GetElectionId() const {
 
 void SdnConnection::SetRoleName(const absl::optional<std::string>& name) {
   role_name_ = name;
+  send_queue_->SetName(GetName());
 }
 
 absl::optional<std::string> SdnConnection::GetRoleName() const {
@@ -327,10 +509,12 @@ std::string SdnConnection::GetName() const {
 
 void SdnConnection::SendStreamMessageResponse(
     const p4::v1::StreamMessageResponse& response) {
-  VLOG(2) << "Sending response: " << response.ShortDebugString();
-  if (!grpc_stream_->Write(response)) {
-    LOG(ERROR) << "Could not send stream message response to gRPC context '"
-               << grpc_context_ << "': " << response.ShortDebugString();
+  StartWriterThread();
+  if (!send_queue_->Enqueue(response)) {
+    LOG_EVERY_N(WARNING, 1000)
+        << "Dropped stream message response to gRPC context '"
+        << grpc_context_ << "', the send queue is full or closed: "
+        << response.ShortDebugString();
   }
 }
 
@@ -485,6 +669,7 @@ grpc::Status SdnControllerManager::HandleArbitrationUpdate(
                 << PrettyPrintElectionId(new_election_id_for_connection);
     }
   }
+  UpdatePrimarySnapshot();
 
   return grpc::Status::OK;
 }
@@ -508,10 +693,17 @@ void SdnControllerManager::Disconnect(SdnConnection* connection) {
                 << PrettyPrintRoleName(connection->GetRoleName())
                 << " with election ID "
                 << PrettyPrintElectionId(connection->GetElectionId()) << ".";
+      SendQueueStats stats = connection->GetSendQueueStats();
+      LOG(INFO) << "Send queue of SDN connection " << connection->GetName()
+                << ": " << stats.sent << " sent, " << stats.dropped
+                << " dropped, " << stats.write_failures
+                << " write failures, maximum depth " << stats.max_depth_seen
+                << ".";
       connections_.erase(iter);
       break;
     }
   }
+  UpdatePrimarySnapshot();
 
   // If connection was the primary connection we need to inform all existing
   // connections.
@@ -622,6 +814,16 @@ int SdnControllerManager::ActiveConnections() const {
   return connections_.size();
 }
 
+std::vector<std::pair<std::string, SendQueueStats>>
+SdnControllerManager::GetSendQueueStats() const {
+  absl::MutexLock l(&lock_);
+  std::vector<std::pair<std::string, SendQueueStats>> stats;
+  for (const auto& connection : connections_) {
+    stats.emplace_back(connection->GetName(), connection->GetSendQueueStats());
+  }
+  return stats;
+}
+
 p4::v1::ReadRequest SdnControllerManager::ExpandWildcardsInReadRequest(
     const p4::v1::ReadRequest& request,
     const p4::config::v1::P4Info& p4info) const {
@@ -797,26 +999,51 @@ absl::Status SdnControllerManager::SendPacketInToPrimary(
   return SendStreamMessageToPrimary(response);
 }
 
-absl::Status SdnControllerManager::SendStreamMessageToPrimary(
-    const p4::v1::StreamMessageResponse& response) {
-  absl::MutexLock l(&lock_);
-
-  bool found_at_least_one_primary = false;
-
+void SdnControllerManager::UpdatePrimarySnapshot() {
+  auto primaries = std::make_shared<std::vector<PrimaryConnection>>();
   for (const auto& connection : connections_) {
     absl::optional<absl::uint128> election_id_past_for_role =
         election_id_past_by_role_[connection->GetRoleName()];
     if (election_id_past_for_role.has_value() &&
         election_id_past_for_role == connection->GetElectionId()) {
-      absl::optional<P4RoleConfig> role_config =
-          role_config_by_name_[connection->GetRoleName()];
-      if (VerifyStreamMessageNotFiltered(role_config, response)) {
-        found_at_least_one_primary = true;
-        connection->SendStreamMessageResponse(response);
-      }
-      // We don't report an error for packets getting filtered as this is
-      // expected operation.
+      primaries->push_back({connection->GetRoleName(),
+                            *election_id_past_for_role,
+                            connection->GetSendQueue(),
+                            role_config_by_name_[connection->GetRoleName()]});
+    }
+  }
+  std::atomic_store(
+      &primaries_,
+      std::shared_ptr<const std::vector<PrimaryConnection>>(primaries));
+}
+
+absl::flat_hash_map<absl::optional<std::string>, absl::uint128>
+SdnControllerManager::GetPrimaryElectionIds() const {
+  std::shared_ptr<const std::vector<PrimaryConnection>> primaries =
+      std::atomic_load(&primaries_);
+  absl::flat_hash_map<absl::optional<std::string>, absl::uint128>
+      election_ids;
+  for (const auto& primary : *primaries) {
+    election_ids[primary.role_name] = primary.election_id;
+  }
+  return election_ids;
+}
+
+absl::Status SdnControllerManager::SendStreamMessageToPrimary(
+    const p4::v1::StreamMessageResponse& response) {
+  std::shared_ptr<const std::vector<PrimaryConnection>> primaries =
+      std::atomic_load(&primaries_);
+
+  bool found_at_least_one_primary = false;
+
+  for (const auto& primary : *primaries) {
+    if (VerifyStreamMessageNotFiltered(primary.role_config, response)) {
+      found_at_least_one_primary = true;
+      // Only queues the message, the writer thread of the connection sends it.
+      primary.send_queue->Enqueue(response);
     }
+    // We don't report an error for packets getting filtered as this is
+    // expected operation.
   }
 
   if (!found_at_least_one_primary) {
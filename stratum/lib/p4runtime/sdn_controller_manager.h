@@ -5,13 +5,21 @@
 #ifndef STRATUM_LIB_P4RUNTIME_SDN_CONTROLLER_MANAGER_H_
 #define STRATUM_LIB_P4RUNTIME_SDN_CONTROLLER_MANAGER_H_
 
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>  // NOLINT
 #include <string>
+#include <thread>  // NOLINT
+#include <utility>
 #include <vector>
 
 #include "absl/container/flat_hash_map.h"
 #include "absl/container/flat_hash_set.h"
 #include "absl/numeric/int128.h"
 #include "absl/status/status.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
 #include "p4/v1/p4runtime.grpc.pb.h"
 #include "p4/v1/p4runtime.pb.h"
 #include "stratum/public/proto/p4_role_config.pb.h"
@@ -22,16 +30,118 @@ namespace p4runtime {
 // Named role for a SDN controller.
 constexpr char kP4RuntimeRoleSdnController[] = "sdn_controller";
 
+// Policy applied when a message is sent to a connection whose send queue is
+// full.
+enum class SendQueueDropPolicy {
+  kDropOldest,  // Discard the oldest queued message.
+  kDropNewest,  // Discard the message being sent.
+};
+
+// Configuration of the send queue of a connection.
+struct SendQueueOptions {
+  size_t max_depth = 1024;
+  SendQueueDropPolicy drop_policy = SendQueueDropPolicy::kDropOldest;
+  // Time given to a closing connection to write the messages still queued,
+  // e.g. a final arbitration update or error, before its stream is cancelled.
+  absl::Duration drain_timeout = absl::Seconds(1);
+};
+
+// Counters of the send queue of a connection.
+struct SendQueueStats {
+  size_t depth = 0;             // Messages waiting to be sent.
+  size_t max_depth_seen = 0;    // High-water mark of depth.
+  uint64_t sent = 0;            // Messages written to the stream.
+  uint64_t dropped = 0;         // Messages discarded by the drop policy.
+  uint64_t write_failures = 0;  // Failed stream writes.
+};
+
 // A connection between a controller and p4rt server.
 class SdnConnection {
  public:
+  // Bounded queue of the messages to be sent to a controller. The queue is
+  // drained by a dedicated writer thread per connection, so that a slow
+  // controller does not delay the messages sent to other controllers.
+  // Arbitration updates are never dropped, even if the queue is full. All the
+  // live queues are kept in a process-wide registry, so that their counters
+  // can be exported without access to the connections.
+  class SendQueue {
+   public:
+    SendQueue(grpc::ServerReaderWriterInterface<p4::v1::StreamMessageResponse,
+                                                p4::v1::StreamMessageRequest>*
+                  stream,
+              const SendQueueOptions& options);
+    ~SendQueue();
+
+    // SendQueue is neither copyable nor movable.
+    SendQueue(const SendQueue&) = delete;
+    SendQueue& operator=(const SendQueue&) = delete;
+
+    // Returns a human-readable dump of the counters of all live send queues,
+    // sorted by name.
+    static std::string DumpAll();
+
+    // Queues a message. Returns false if the message has been dropped.
+    bool Enqueue(const p4::v1::StreamMessageResponse& response)
+        ABSL_LOCKS_EXCLUDED(lock_);
+
+    // Writes queued messages to the stream until the queue is closed and
+    // empty.
+    void Run() ABSL_LOCKS_EXCLUDED(lock_);
+
+    // Closes the queue. Messages queued afterwards are dropped, the ones
+    // already queued are still written by Run().
+    void Close() ABSL_LOCKS_EXCLUDED(lock_);
+
+    // Closes the queue and drops all messages which have not been written yet.
+    // Run() returns once the message being written, if any, is done.
+    void Discard() ABSL_LOCKS_EXCLUDED(lock_);
+
+    // Waits until Run() has returned or the timeout expires. Returns true if
+    // Run() has returned.
+    bool AwaitStopped(absl::Duration timeout) ABSL_LOCKS_EXCLUDED(lock_);
+
+    SendQueueStats GetStats() const ABSL_LOCKS_EXCLUDED(lock_);
+
+    // Sets the name the queue is dumped under.
+    void SetName(const std::string& name) ABSL_LOCKS_EXCLUDED(lock_);
+
+   private:
+    bool HasWork() const ABSL_EXCLUSIVE_LOCKS_REQUIRED(lock_) {
+      return closed_ || !queue_.empty();
+    }
+
+    const SendQueueOptions options_;
+    grpc::ServerReaderWriterInterface<p4::v1::StreamMessageResponse,
+                                      p4::v1::StreamMessageRequest>* const
+        stream_;  // not owned.
+
+    mutable absl::Mutex lock_;
+    std::string name_ ABSL_GUARDED_BY(lock_);
+    std::deque<p4::v1::StreamMessageResponse> queue_ ABSL_GUARDED_BY(lock_);
+    bool closed_ ABSL_GUARDED_BY(lock_);
+    bool stopped_ ABSL_GUARDED_BY(lock_);
+    SendQueueStats stats_ ABSL_GUARDED_BY(lock_);
+  };
+
   SdnConnection(
       grpc::ServerContext* context,
       grpc::ServerReaderWriterInterface<p4::v1::StreamMessageResponse,
-                                        p4::v1::StreamMessageRequest>* stream)
-      : initialized_(false), grpc_context_(context), grpc_stream_(stream) {}
-
-  void Initialize() { initialized_ = true; }
+                                        p4::v1::StreamMessageRequest>* stream,
+      const SendQueueOptions& options = SendQueueOptions());
+
+  // Stops the writer thread, if it has been started. Messages queued so far
+  // are still sent, unless the controller does not read them within the drain
+  // timeout. In that case the remaining messages are dropped and the stream
+  // is cancelled, so that the writer thread does not block on it forever.
+  ~SdnConnection();
+
+  // SdnConnection is neither copyable nor movable.
+  SdnConnection(const SdnConnection&) = delete;
+  SdnConnection& operator=(const SdnConnection&) = delete;
+
+  // Marks the connection as attached to a controller manager, which may send
+  // messages to it from now on.
+  void Initialize();
   bool IsInitialized() const { return initialized_; }
 
   void SetElectionId(const absl::optional<absl::uint128>& id);
@@ -43,10 +153,20 @@ class SdnConnection {
   // A unique name string for the controller.
   std::string GetName() const;
 
-  // Sends back StreamMessageResponse to this controller.
+  // Queues a StreamMessageResponse to be sent back to this controller. Does
+  // not block on the stream.
   void SendStreamMessageResponse(const p4::v1::StreamMessageResponse& response);
 
+  // The send queue of this connection. It may outlive the connection, in which
+  // case messages sent to it are dropped.
+  std::shared_ptr<SendQueue> GetSendQueue() const { return send_queue_; }
+
+  SendQueueStats GetSendQueueStats() const { return send_queue_->GetStats(); }
+
  private:
+  // Starts the writer thread, unless it is already running.
+  void StartWriterThread();
+
   // The SDN connection should be initialized through arbitration before it can
   // be used.
   bool initialized_;
@@ -68,6 +188,21 @@ class SdnConnection {
   grpc::ServerReaderWriterInterface<p4::v1::StreamMessageResponse,
                                     p4::v1::StreamMessageRequest>*
       grpc_stream_;  // not owned.
+
+  // All writes to the stream go through the send queue and its writer thread.
+  // The thread is only started once the connection is initialized or a message
+  // is sent to it, so that connections rejected before their first arbitration
+  // update never spawn one.
+  const std::shared_ptr<SendQueue> send_queue_;
+  std::once_flag writer_thread_started_;
+  std::thread writer_thread_;
+
+  // Time given to the writer thread to send the queued messages on close, and
+  // the function cancelling the stream once it has expired.
+  const absl::Duration drain_timeout_;
+  std::function<void()> cancel_stream_;
+
+  friend class SdnConnectionTest;
 };
 
 class SdnControllerManager {
@@ -102,12 +237,36 @@ class SdnControllerManager {
   absl::Status SendPacketInToPrimary(
       const p4::v1::StreamMessageResponse& response) ABSL_LOCKS_EXCLUDED(lock_);
 
+  // Queues a message on all primary connections whose role accepts it. The
+  // primary connections are taken from a snapshot, without acquiring lock_.
   absl::Status SendStreamMessageToPrimary(
       const p4::v1::StreamMessageResponse& response) ABSL_LOCKS_EXCLUDED(lock_);
 
+  // Returns the election ID of the primary connection of every role which has
+  // one. Reads the primary snapshot, without acquiring lock_.
+  absl::flat_hash_map<absl::optional<std::string>, absl::uint128>
+  GetPrimaryElectionIds() const ABSL_LOCKS_EXCLUDED(lock_);
+
+  // Returns the send queue counters of all active connections, by name.
+  std::vector<std::pair<std::string, SendQueueStats>> GetSendQueueStats() const
+      ABSL_LOCKS_EXCLUDED(lock_);
+
  private:
+  // A primary connection and the config of its role, as used for routing
+  // stream messages.
+  struct PrimaryConnection {
+    absl::optional<std::string> role_name;
+    absl::uint128 election_id;
+    std::shared_ptr<SdnConnection::SendQueue> send_queue;
+    absl::optional<P4RoleConfig> role_config;
+  };
+
   SdnControllerManager() : device_id_(0) {}
 
+  // Rebuilds the snapshot of the primary connections. Has to be called after
+  // every change to the connections, their election IDs or the role configs.
+  void UpdatePrimarySnapshot() ABSL_EXCLUSIVE_LOCKS_REQUIRED(lock_);
+
   // Goes through the current list of active connections, and returns if one of
   // them is currently the primary.
   bool PrimaryConnectionExists(const absl::optional<std::string>& role_name)
@@ -169,6 +328,12 @@ class SdnControllerManager {
   absl::flat_hash_map<absl::optional<std::string>,
                       absl::optional<absl::uint128>>
       election_id_past_by_role_ ABSL_GUARDED_BY(lock_);
+
+  // Immutable snapshot of the primary connections. It is replaced as a whole
+  // under lock_ and read with std::atomic_load, so that sending a message never
+  // waits for an arbitration update.
+  std::shared_ptr<const std::vector<PrimaryConnection>> primaries_ =
+      std::make_shared<const std::vector<PrimaryConnection>>();
 };
 
 }  // namespace p4runtime
@@ -0,0 +1,289 @@
+// Copyright 2021-present Open Networking Foundation
+// SPDX-License-Identifier: Apache-2.0
+
+#include "stratum/lib/p4runtime/sdn_controller_manager.h"
+
+#include <memory>
+#include <string>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "absl/memory/memory.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/synchronization/notification.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "gmock/gmock.h"
+#include "grpcpp/grpcpp.h"
+#include "gtest/gtest.h"
+#include "p4/v1/p4runtime.pb.h"
+#include "stratum/lib/p4runtime/stream_message_reader_writer_mock.h"
+
+namespace stratum {
+namespace p4runtime {
+
+using ::testing::_;
+using ::testing::ElementsAre;
+using ::testing::HasSubstr;
+using ::testing::Invoke;
+using ::testing::Not;
+using ::testing::Return;
+
+class SendQueueTest : public ::testing::Test {
+ protected:
+  // Creates the queue under test. Its writer is not started, so that messages
+  // stay queued until RunUntilWritten() is called.
+  void CreateQueue(size_t max_depth, SendQueueDropPolicy drop_policy) {
+    SendQueueOptions options;
+    options.max_depth = max_depth;
+    options.drop_policy = drop_policy;
+    queue_ = std::make_shared<SdnConnection::SendQueue>(&stream_, options);
+  }
+
+  // Returns a PacketIn message with the given payload.
+  static p4::v1::StreamMessageResponse PacketIn(const std::string& payload) {
+    p4::v1::StreamMessageResponse response;
+    response.mutable_packet()->set_payload(payload);
+    return response;
+  }
+
+  // Runs the writer of the queue until 'count' messages have been written to
+  // the stream, then closes the queue. Returns the payloads of the PacketIns
+  // which have been written, or "arbitration" for arbitration updates.
+  std::vector<std::string> RunUntilWritten(int count, bool success = true) {
+    absl::Mutex lock;
+    std::vector<std::string> written;
+    absl::Notification done;
+    EXPECT_CALL(stream_, Write(_, _))
+        .Times(count)
+        .WillRepeatedly(
+            Invoke([&](const p4::v1::StreamMessageResponse& response,
+                       grpc::WriteOptions options) {
+              absl::MutexLock l(&lock);
+              written.push_back(response.has_arbitration()
+                                    ? "arbitration"
+                                    : response.packet().payload());
+              if (written.size() == static_cast<size_t>(count)) done.Notify();
+              return success;
+            }));
+    std::thread writer([this]() { queue_->Run(); });
+    done.WaitForNotification();
+    queue_->Close();
+    writer.join();
+    absl::MutexLock l(&lock);
+    return written;
+  }
+
+  StreamMessageReaderWriterMock stream_;
+  std::shared_ptr<SdnConnection::SendQueue> queue_;
+};
+
+TEST_F(SendQueueTest, DropOldestDiscardsTheOldestMessage) {
+  CreateQueue(2, SendQueueDropPolicy::kDropOldest);
+  EXPECT_TRUE(queue_->Enqueue(PacketIn("1")));
+  EXPECT_TRUE(queue_->Enqueue(PacketIn("2")));
+  EXPECT_TRUE(queue_->Enqueue(PacketIn("3")));
+
+  SendQueueStats stats = queue_->GetStats();
+  EXPECT_EQ(2U, stats.depth);
+  EXPECT_EQ(2U, stats.max_depth_seen);
+  EXPECT_EQ(1U, stats.dropped);
+  EXPECT_THAT(RunUntilWritten(2), ElementsAre("2", "3"));
+}
+
+TEST_F(SendQueueTest, DropNewestDiscardsTheMessageBeingSent) {
+  CreateQueue(2, SendQueueDropPolicy::kDropNewest);
+  EXPECT_TRUE(queue_->Enqueue(PacketIn("1")));
+  EXPECT_TRUE(queue_->Enqueue(PacketIn("2")));
+  EXPECT_FALSE(queue_->Enqueue(PacketIn("3")));
+
+  SendQueueStats stats = queue_->GetStats();
+  EXPECT_EQ(2U, stats.depth);
+  EXPECT_EQ(1U, stats.dropped);
+  EXPECT_THAT(RunUntilWritten(2), ElementsAre("1", "2"));
+}
+
+TEST_F(SendQueueTest, ArbitrationUpdatesAreNeverDropped) {
+  CreateQueue(2, SendQueueDropPolicy::kDropOldest);
+  p4::v1::StreamMessageResponse arbitration;
+  arbitration.mutable_arbitration()->set_device_id(1);
+  EXPECT_TRUE(queue_->Enqueue(arbitration));
+  EXPECT_TRUE(queue_->Enqueue(PacketIn("1")));
+  // The oldest message which is not an arbitration update is dropped.
+  EXPECT_TRUE(queue_->Enqueue(PacketIn("2")));
+  // Arbitration updates are queued even if the queue is full.
+  EXPECT_TRUE(queue_->Enqueue(arbitration));
+
+  SendQueueStats stats = queue_->GetStats();
+  EXPECT_EQ(3U, stats.depth);
+  EXPECT_EQ(3U, stats.max_depth_seen);
+  EXPECT_EQ(1U, stats.dropped);
+  EXPECT_THAT(RunUntilWritten(3),
+              ElementsAre("arbitration", "2", "arbitration"));
+}
+
+TEST_F(SendQueueTest, StatsCountSentMessagesAndWriteFailures) {
+  CreateQueue(4, SendQueueDropPolicy::kDropOldest);
+  EXPECT_TRUE(queue_->Enqueue(PacketIn("1")));
+  EXPECT_TRUE(queue_->Enqueue(PacketIn("2")));
+  EXPECT_THAT(RunUntilWritten(2, /*success=*/false), ElementsAre("1", "2"));
+
+  SendQueueStats stats = queue_->GetStats();
+  EXPECT_EQ(0U, stats.depth);
+  EXPECT_EQ(2U, stats.max_depth_seen);
+  EXPECT_EQ(0U, stats.sent);
+  EXPECT_EQ(2U, stats.write_failures);
+  EXPECT_EQ(0U, stats.dropped);
+}
+
+TEST_F(SendQueueTest, CloseWritesQueuedMessagesAndDropsLaterOnes) {
+  CreateQueue(4, SendQueueDropPolicy::kDropOldest);
+  EXPECT_TRUE(queue_->Enqueue(PacketIn("1")));
+  EXPECT_TRUE(queue_->Enqueue(PacketIn("2")));
+  queue_->Close();
+  EXPECT_FALSE(queue_->Enqueue(PacketIn("3")));
+  EXPECT_FALSE(queue_->AwaitStopped(absl::ZeroDuration()));
+
+  // The writer sends what has been queued before the close, then stops.
+  EXPECT_CALL(stream_, Write(_, _)).Times(2).WillRepeatedly(Return(true));
+  queue_->Run();
+  EXPECT_TRUE(queue_->AwaitStopped(absl::ZeroDuration()));
+
+  SendQueueStats stats = queue_->GetStats();
+  EXPECT_EQ(0U, stats.depth);
+  EXPECT_EQ(2U, stats.sent);
+  EXPECT_EQ(1U, stats.dropped);
+}
+
+TEST_F(SendQueueTest, DiscardDropsQueuedAndLaterMessages) {
+  CreateQueue(4, SendQueueDropPolicy::kDropOldest);
+  EXPECT_TRUE(queue_->Enqueue(PacketIn("1")));
+  EXPECT_TRUE(queue_->Enqueue(PacketIn("2")));
+  queue_->Discard();
+  EXPECT_FALSE(queue_->Enqueue(PacketIn("3")));
+
+  EXPECT_CALL(stream_, Write(_, _)).Times(0);
+  queue_->Run();
+
+  SendQueueStats stats = queue_->GetStats();
+  EXPECT_EQ(0U, stats.depth);
+  EXPECT_EQ(0U, stats.sent);
+  EXPECT_EQ(3U, stats.dropped);
+}
+
+TEST_F(SendQueueTest, DumpAllListsLiveQueues) {
+  CreateQueue(4, SendQueueDropPolicy::kDropNewest);
+  queue_->SetName("test-queue");
+  EXPECT_TRUE(queue_->Enqueue(PacketIn("1")));
+  EXPECT_THAT(SdnConnection::SendQueue::DumpAll(),
+              HasSubstr("test-queue: depth 1/4 (high-water 1), 0 sent, "
+                        "0 dropped, 0 write failures"));
+
+  queue_.reset();
+  EXPECT_THAT(SdnConnection::SendQueue::DumpAll(),
+              Not(HasSubstr("test-queue")));
+}
+
+class SdnConnectionTest : public ::testing::Test {
+ protected:
+  // Creates the connection under test. Cancelling its stream notifies
+  // cancelled_ instead of cancelling the RPC of context_, which is not bound
+  // to one.
+  void CreateConnection(absl::Duration drain_timeout) {
+    SendQueueOptions options;
+    options.drain_timeout = drain_timeout;
+    connection_ =
+        absl::make_unique<SdnConnection>(&context_, &stream_, options);
+    connection_->cancel_stream_ = [this]() { cancelled_.Notify(); };
+  }
+
+  // Returns a PacketIn message with the given payload.
+  static p4::v1::StreamMessageResponse PacketIn(const std::string& payload) {
+    p4::v1::StreamMessageResponse response;
+    response.mutable_packet()->set_payload(payload);
+    return response;
+  }
+
+  grpc::ServerContext context_;
+  StreamMessageReaderWriterMock stream_;
+  absl::Notification cancelled_;
+  std::unique_ptr<SdnConnection> connection_;
+};
+
+TEST_F(SdnConnectionTest, QueuedMessagesAreSentOnClose) {
+  CreateConnection(absl::Seconds(10));
+  // The controller reads slowly, so that messages are still queued when the
+  // connection closes.
+  EXPECT_CALL(stream_, Write(_, _))
+      .Times(3)
+      .WillRepeatedly(Invoke([](const p4::v1::StreamMessageResponse& response,
+                                grpc::WriteOptions options) {
+        absl::SleepFor(absl::Milliseconds(10));
+        return true;
+      }));
+  for (const char* payload : {"1", "2", "3"}) {
+    connection_->SendStreamMessageResponse(PacketIn(payload));
+  }
+  auto queue = connection_->GetSendQueue();
+  connection_.reset();
+
+  EXPECT_FALSE(cancelled_.HasBeenNotified());
+  SendQueueStats stats = queue->GetStats();
+  EXPECT_EQ(3U, stats.sent);
+  EXPECT_EQ(0U, stats.dropped);
+}
+
+TEST_F(SdnConnectionTest, ControllerWhichNeverReadsIsCancelledOnClose) {
+  CreateConnection(absl::Milliseconds(100));
+  // Writes block until the stream is cancelled, like the ones to a controller
+  // which has stopped reading once the flow control window is full.
+  EXPECT_CALL(stream_, Write(_, _))
+      .WillOnce(Invoke([this](const p4::v1::StreamMessageResponse& response,
+                              grpc::WriteOptions options) {
+        cancelled_.WaitForNotification();
+        return false;
+      }));
+  for (const char* payload : {"1", "2", "3"}) {
+    connection_->SendStreamMessageResponse(PacketIn(payload));
+  }
+  auto queue = connection_->GetSendQueue();
+  connection_.reset();
+
+  EXPECT_TRUE(cancelled_.HasBeenNotified());
+  SendQueueStats stats = queue->GetStats();
+  EXPECT_EQ(0U, stats.depth);
+  EXPECT_EQ(0U, stats.sent);
+  EXPECT_EQ(1U, stats.write_failures);
+  EXPECT_EQ(2U, stats.dropped);
+}
+
+TEST(SdnControllerManagerTest, ArbitrationResponseIsSentThroughSendQueue) {
+  grpc::ServerContext context;
+  StreamMessageReaderWriterMock stream;
+  absl::Notification written;
+  EXPECT_CALL(stream, Write(_, _))
+      .WillOnce(Invoke([&written](const p4::v1::StreamMessageResponse& response,
+                                  grpc::WriteOptions options) {
+        EXPECT_TRUE(response.has_arbitration());
+        written.Notify();
+        return true;
+      }));
+  SdnControllerManager manager(/*device_id=*/1);
+  SdnConnection connection(&context, &stream);
+
+  p4::v1::MasterArbitrationUpdate update;
+  update.set_device_id(1);
+  update.mutable_election_id()->set_low(1);
+  EXPECT_TRUE(manager.HandleArbitrationUpdate(update, &connection).ok());
+  written.WaitForNotification();
+
+  auto stats = manager.GetSendQueueStats();
+  ASSERT_EQ(1U, stats.size());
+  EXPECT_EQ(connection.GetName(), stats[0].first);
+  EXPECT_EQ(0U, stats[0].second.dropped);
+  manager.Disconnect(&connection);
+  EXPECT_EQ(0, manager.ActiveConnections());
+}
+
+}  // namespace p4runtime
+}  // namespace stratum
@@ -4,115 +4,241 @@
 
 #include "stratum/lib/timer_daemon.h"
 
+#include <algorithm>
+#include <limits>
+
+#include "absl/strings/str_cat.h"
 #include "absl/synchronization/mutex.h"
+#include "gflags/gflags.h"
+#include "stratum/glue/logging.h"
+
+DEFINE_int32(timer_daemon_worker_threads, 1,
+             "Number of threads executing the timer actions. If 0, the actions "
+             "are executed by the timer thread. More than 1 executes the "
+             "actions of different timers concurrently, which requires all of "
+             "them to be thread-safe.");
+DEFINE_int32(timer_daemon_resolution_us, 100,
+             "Resolution of the timer daemon in microseconds.");
+DEFINE_int32(timer_daemon_late_threshold_us, 10000,
+             "Timer actions starting more than this many microseconds after "
+             "their due time are counted and logged as late.");
 
 namespace stratum {
 namespace hal {
 
-namespace {
-// A function that is executed by the thread created by TimerDaemon::Start().
-// It provides a timer resolution of 1ms.
-static void* Timer(void* arg) {
-  while (true) {
-    // Sleep for 1ms.
-    absl::SleepFor(absl::Milliseconds(1));
+TimerDaemon::TimerDaemon()
+    : resolution_(absl::Microseconds(
+          std::max(1, FLAGS_timer_daemon_resolution_us))),
+      epoch_(absl::Now()),
+      timers_(),
+      wakeup_tick_(0),
+      queue_(),
+      stats_(),
+      started_(false) {}
 
-    // Call the method that will process the list of timers.
-    // If the method returns 'false' it means that this thread should be
-    // terminated.
-    if (!TimerDaemon::Execute()) break;
-  }
+void* TimerDaemon::TimerThreadFunc(void* arg) {
+  reinterpret_cast<TimerDaemon*>(arg)->RunTimer();
+  return nullptr;
+}
+
+void* TimerDaemon::WorkerThreadFunc(void* arg) {
+  reinterpret_cast<TimerDaemon*>(arg)->RunWorker();
   return nullptr;
 }
-}  // namespace
 
 bool TimerDaemon::IsStopped() {
   absl::WriterMutexLock l(&access_lock_);
   return !started_;
 }
 
-TimerDaemon::DescriptorPtr TimerDaemon::GetAction() {
-  // Once woken up check if the timer at the top of the heap is due.
-  absl::WriterMutexLock l(&access_lock_);
+uint64 TimerDaemon::ToTick(absl::Time time, bool round_up) const {
+  if (time <= epoch_) return 0;
+  absl::Duration rem;
+  int64 tick = absl::IDivDuration(time - epoch_, resolution_, &rem);
+  if (round_up && rem > absl::ZeroDuration()) ++tick;
+  return tick;
+}
 
-  if (timers_.empty()) {
-    return nullptr;
-  }
-  if (timers_.front().expired()) {
-    pop_heap(timers_.begin(), timers_.end(), TimerDescriptorComparator());
-    timers_.pop_back();
-    return nullptr;
-  }
-  TimerDaemon::DescriptorPtr front = DescriptorPtr(timers_.front());
-  absl::Time now = absl::Now();
-  if (front->due_time_ <= now) {
-    pop_heap(timers_.begin(), timers_.end(), TimerDescriptorComparator());
-    timers_.pop_back();
-    if (front->Repeat()) {
-      // Periodic timer. Insert it in the queue again.
-      front->due_time_ += front->Period();
-      timers_.push_back(front);
-      push_heap(timers_.begin(), timers_.end(), TimerDescriptorComparator());
+absl::Time TimerDaemon::FromTick(uint64 tick) const {
+  return epoch_ + resolution_ * static_cast<int64>(tick);
+}
+
+std::vector<TimerDaemon::DueAction> TimerDaemon::GetDueActions(
+    absl::Time now) {
+  std::vector<DescriptorWeakPtr> expired;
+  timers_.Advance(ToTick(now, /*round_up=*/false), &expired);
+  std::vector<DueAction> due;
+  for (const auto& weak : expired) {
+    // Canceled timers have expired weak pointers and are simply dropped.
+    DescriptorPtr desc = weak.lock();
+    if (desc == nullptr) continue;
+    const absl::Time due_time = desc->due_time_;
+    if (desc->Repeat()) {
+      // Periodic timer. Insert it in the wheel again. If the daemon fell
+      // behind, the periods that already passed are skipped instead of being
+      // executed back-to-back.
+      absl::Time next = due_time + desc->Period();
+      if (desc->Period() <= absl::ZeroDuration()) {
+        next = now + resolution_;
+      } else if (next <= now) {
+        int64 missed = (now - due_time) / desc->Period();
+        stats_.skipped_periods += missed;
+        next = due_time + (missed + 1) * desc->Period();
+      }
+      desc->due_time_ = next;
+      timers_.Insert(ToTick(next, /*round_up=*/true), weak);
     }
-    return front;
+    if (desc->in_flight_) {
+      // The previous execution of this timer has not finished yet.
+      ++stats_.skipped_periods;
+      continue;
+    }
+    desc->in_flight_ = true;
+    due.push_back(DueAction{std::move(desc), due_time});
   }
-  return nullptr;
+  return due;
 }
 
-bool TimerDaemon::Execute() {
-  TimerDaemon* daemon = GetInstance();
+void TimerDaemon::ExecuteAction(const DueAction& action) {
+  const absl::Duration lag =
+      std::max(absl::Now() - action.due_time, absl::ZeroDuration());
+  // Execute the timer's action!
+  const auto& status = action.desc->ExecuteAction();
+  if (status.ok()) {
+    VLOG(1) << "Timer has been triggered!";
+  } else {
+    LOG(ERROR) << "Error executing action: " << status;
+  }
+  const bool late =
+      lag > absl::Microseconds(FLAGS_timer_daemon_late_threshold_us);
+  LOG_IF_EVERY_N(WARNING, late, 100)
+      << "Timer action started " << lag << " after its due time.";
+
+  absl::WriterMutexLock l(&access_lock_);
+  action.desc->in_flight_ = false;
+  ++stats_.executions;
+  if (late) ++stats_.late_executions;
+  stats_.total_lag += lag;
+  stats_.max_lag = std::max(stats_.max_lag, lag);
+}
 
-  if (daemon->IsStopped()) return false;
+void TimerDaemon::RunTimer() {
+  while (true) {
+    std::vector<DueAction> due;
+    {
+      absl::WriterMutexLock l(&access_lock_);
+      if (!started_) break;
+      due = GetDueActions(absl::Now());
+      if (!worker_tids_.empty()) {
+        // Hand the actions over to the worker threads.
+        for (auto& action : due) queue_.push_back(std::move(action));
+        if (!due.empty()) worker_cond_.SignalAll();
+        due.clear();
+      }
+    }
+    for (const auto& action : due) ExecuteAction(action);
 
-  auto front = daemon->GetAction();
-  if (front != nullptr) {
-    // Execute the timer's action!
-    const auto& status = front->ExecuteAction();
-    if (status.ok()) {
-      VLOG(1) << "Timer has been triggered!";
+    // Sleep until the next deadline or until an earlier timer is requested.
+    absl::WriterMutexLock l(&access_lock_);
+    if (!started_) break;
+    uint64 tick;
+    absl::Time deadline = absl::InfiniteFuture();
+    if (timers_.NextEventTick(&tick)) {
+      deadline = FromTick(tick);
     } else {
-      LOG(ERROR) << "Error executing action: " << status;
+      tick = std::numeric_limits<uint64>::max();
+    }
+    if (deadline > absl::Now()) {
+      wakeup_tick_ = tick;
+      timer_cond_.WaitWithDeadline(&access_lock_, deadline);
+      wakeup_tick_ = 0;
+    }
+  }
+}
+
+void TimerDaemon::RunWorker() {
+  while (true) {
+    DueAction action;
+    {
+      absl::WriterMutexLock l(&access_lock_);
+      while (started_ && queue_.empty()) worker_cond_.Wait(&access_lock_);
+      if (!started_) break;
+      action = std::move(queue_.front());
+      queue_.pop_front();
     }
+    ExecuteAction(action);
+  }
+}
+
+bool TimerDaemon::Execute() {
+  TimerDaemon* daemon = GetInstance();
+  std::vector<DueAction> due;
+  {
+    absl::WriterMutexLock l(&daemon->access_lock_);
+    if (!daemon->started_) return false;
+    due = daemon->GetDueActions(absl::Now());
   }
+  for (const auto& action : due) daemon->ExecuteAction(action);
   return true;
 }
 
 ::util::Status TimerDaemon::Start() {
-  absl::WriterMutexLock l(&GetInstance()->access_lock_);
-  if (GetInstance()->started_ == true) {
+  TimerDaemon* daemon = GetInstance();
+  absl::WriterMutexLock l(&daemon->access_lock_);
+  if (daemon->started_ == true) {
     return ::util::OkStatus();
   }
 
-  GetInstance()->started_ = true;
+  daemon->started_ = true;
 
-  if (pthread_create(&GetInstance()->tid_, nullptr, &Timer, nullptr) != 0) {
+  if (pthread_create(&daemon->tid_, nullptr, &TimerThreadFunc, daemon) != 0) {
+    daemon->started_ = false;
     return MAKE_ERROR(ERR_INTERNAL) << "Failed to create the timer thread.";
-  } else {
-    VLOG(1) << "The timer daemon has been started.";
-    return ::util::OkStatus();
   }
+  for (int i = 0; i < FLAGS_timer_daemon_worker_threads; ++i) {
+    pthread_t tid;
+    if (pthread_create(&tid, nullptr, &WorkerThreadFunc, daemon) != 0) {
+      // The timer thread executes the actions itself if there are no workers.
+      LOG(ERROR) << "Failed to create timer worker thread " << i << ".";
+      break;
+    }
+    daemon->worker_tids_.push_back(tid);
+  }
+  VLOG(1) << "The timer daemon has been started with "
+          << daemon->worker_tids_.size() << " worker threads.";
+  return ::util::OkStatus();
 }
 
 ::util::Status TimerDaemon::Stop() {
+  TimerDaemon* daemon = GetInstance();
   {
-    absl::WriterMutexLock l(&GetInstance()->access_lock_);
-    if (GetInstance()->started_ == false) {
+    absl::WriterMutexLock l(&daemon->access_lock_);
+    if (daemon->started_ == false) {
       return ::util::OkStatus();
     }
 
-    GetInstance()->started_ = false;
+    daemon->started_ = false;
+    daemon->timer_cond_.Signal();
+    daemon->worker_cond_.SignalAll();
   }
 
-  if (pthread_join(GetInstance()->tid_, nullptr) != 0) {
-    return MAKE_ERROR(ERR_INTERNAL) << "Failed to join the timer thread.";
-  } else {
-    absl::WriterMutexLock l(&GetInstance()->access_lock_);
-    GetInstance()->timers_.clear();
-    GetInstance()->tid_ = 0;
-
-    VLOG(1) << "The timer daemon has been stopped.";
-    return ::util::OkStatus();
+  ::util::Status status = ::util::OkStatus();
+  if (pthread_join(daemon->tid_, nullptr) != 0) {
+    APPEND_ERROR(status) << "Failed to join the timer thread.";
+  }
+  for (pthread_t tid : daemon->worker_tids_) {
+    if (pthread_join(tid, nullptr) != 0) {
+      APPEND_ERROR(status) << "Failed to join a timer worker thread.";
+    }
   }
+  absl::WriterMutexLock l(&daemon->access_lock_);
+  daemon->worker_tids_.clear();
+  daemon->timers_.Clear();
+  daemon->queue_.clear();
+  daemon->tid_ = 0;
+  if (status.ok()) VLOG(1) << "The timer daemon has been stopped.";
+
+  return status;
 }
 
 ::util::Status TimerDaemon::RequestOneShotTimer(uint64 delay_ms,
@@ -130,6 +256,27 @@ bool TimerDaemon::Execute() {
   return GetInstance()->RequestTimer(true, delay_ms, period_ms, action, desc);
 }
 
+TimerDaemon::Stats TimerDaemon::GetStats() {
+  TimerDaemon* daemon = GetInstance();
+  absl::WriterMutexLock l(&daemon->access_lock_);
+  return daemon->stats_;
+}
+
+std::string TimerDaemon::DumpStats() {
+  const Stats stats = GetStats();
+  std::string dump = absl::StrCat(
+      stats.executions, " executions, ", stats.late_executions,
+      " late (lag over ", FLAGS_timer_daemon_late_threshold_us, "us), ",
+      stats.skipped_periods, " skipped periods");
+  if (stats.executions > 0) {
+    absl::StrAppend(&dump, ", lag avg ",
+                    absl::FormatDuration(stats.total_lag / stats.executions),
+                    " max ", absl::FormatDuration(stats.max_lag));
+  }
+  absl::StrAppend(&dump, "\n");
+  return dump;
+}
+
 ::util::Status TimerDaemon::RequestTimer(bool repeat, uint64 delay_ms,
                                          uint64 period_ms, Action action,
                                          DescriptorPtr* desc) {
@@ -141,8 +288,10 @@ bool TimerDaemon::Execute() {
   *desc = std::make_shared<Descriptor>(repeat, action);
   (*desc)->due_time_ = now + absl::Milliseconds(delay_ms);
   (*desc)->period_ = absl::Milliseconds(period_ms);
-  timers_.push_back(DescriptorWeakPtr(*desc));
-  push_heap(timers_.begin(), timers_.end(), TimerDescriptorComparator());
+  const uint64 tick = ToTick((*desc)->due_time_, /*round_up=*/true);
+  timers_.Insert(tick, DescriptorWeakPtr(*desc));
+  // Wake up the timer thread if it sleeps past the new deadline.
+  if (tick < wakeup_tick_) timer_cond_.Signal();
 
   return ::util::OkStatus();
 }
@@ -7,9 +7,10 @@
 
 #include <pthread.h>
 
-#include <algorithm>
+#include <deque>
 #include <functional>
 #include <memory>
+#include <string>
 #include <vector>
 
 #include "absl/synchronization/mutex.h"
@@ -19,11 +20,20 @@
 #include "stratum/glue/status/status.h"
 #include "stratum/glue/status/status_macros.h"
 #include "stratum/lib/macros.h"
+#include "stratum/lib/timing_wheel.h"
 #include "stratum/public/lib/error.h"
 
 namespace stratum {
 namespace hal {
 
+// TimerDaemon executes one-shot and periodic timer actions. The timers are kept
+// in a hierarchical timing wheel. A single timer thread sleeps until the next
+// deadline (or until an earlier timer is requested) and hands the due actions
+// over to a pool of worker threads. With more than one worker thread, a slow
+// action does not delay the others, but the actions of different timers may
+// run concurrently. Actions of the same timer never run concurrently: if a
+// periodic action is still running when it is due again, that period is
+// skipped.
 class TimerDaemon final {
  private:
   using Action = std::function<::util::Status()>;
@@ -42,6 +52,9 @@ class TimerDaemon final {
     bool repeat_;
     absl::Time due_time_;
     absl::Duration period_;
+    // True while the action is queued for or being executed by a worker.
+    // Guarded by TimerDaemon::access_lock_.
+    bool in_flight_ = false;
 
    private:
     Action action_ = []() {
@@ -52,51 +65,31 @@ class TimerDaemon final {
 
   using DescriptorWeakPtr = std::weak_ptr<Descriptor>;
 
-  // In order to use TimerDaemon::Descriptor as a key in heap operations a
-  // comparator functor has to be defined.
-  struct TimerDescriptorComparator {
-    bool operator()(const TimerDaemon::DescriptorWeakPtr& lhs,
-                    const TimerDaemon::DescriptorWeakPtr& rhs) const {
-      // The goal of this method is to find which timer descriptor describes a
-      // timer that should be executed earlier: lhs or rhs?
-      // If a timer is canceled then the weak pointer pointing to it will
-      // 'expire' and there is no point in keeping such pointer on the heap. As
-      // the most effective way of removing an element from a heap is to move it
-      // to the top and then delete it, expired pointers should be theated as
-      // ones that are to be executed 'now'. This approach makes them to
-      // 'bubbled up' to the top as quickly as possible and then they can be
-      // removed.
-      if (lhs.expired() && !rhs.expired()) {
-        // rhs is expired, so, it is the lowest number.
-        return true;
-      }
-      if (rhs.expired() && !lhs.expired()) {
-        // lhs is expired, so, it is the lowest number.
-        return false;
-      }
-      if (rhs.expired() && lhs.expired()) {
-        // Both are expired, so, it really does not matter what we return.
-        return false;
-      }
-      // Both elements are still valid. Compare them!
-      return std::shared_ptr<Descriptor>(lhs)->due_time_ >
-             std::shared_ptr<Descriptor>(rhs)->due_time_;
-    }
-  };
-
  public:
   using DescriptorPtr = std::shared_ptr<Descriptor>;
 
-  // Starts the timer service. Creates a thread that calls Execute() every 1ms.
+  // Timer delivery statistics, accumulated since the daemon was created. The
+  // lag of an execution is the time between the due time of the timer and the
+  // moment its action starts.
+  struct Stats {
+    uint64 executions = 0;
+    // Executions whose lag exceeded --timer_daemon_late_threshold_us.
+    uint64 late_executions = 0;
+    // Periods of periodic timers that were skipped because the previous
+    // execution was still running or the daemon fell behind.
+    uint64 skipped_periods = 0;
+    absl::Duration total_lag = absl::ZeroDuration();
+    absl::Duration max_lag = absl::ZeroDuration();
+  };
+
+  // Starts the timer service. Creates the timer thread and
+  // --timer_daemon_worker_threads worker threads.
   static ::util::Status Start() LOCKS_EXCLUDED(access_lock_);
-  // Stops the timer service. Notifies the timer thread to exit and waits until
-  // it joins.
+  // Stops the timer service. Notifies the timer and worker threads to exit and
+  // waits until they join. Pending timers are dropped.
   static ::util::Status Stop() LOCKS_EXCLUDED(access_lock_);
-  // The 'worker' of the timer service. Is called every 1ms and checks if the
-  // first timer to be executed should be executed. If so, the action is
-  // executed and then if the timer is periodic the timer is updated and
-  // re-inserted into the heap with timers. It also takes care of all expired
-  // timers.
+  // Executes the actions of all due timers on the calling thread and
+  // re-schedules the periodic ones. Returns false if the daemon is stopped.
   static bool Execute() LOCKS_EXCLUDED(access_lock_);
 
   // Creates a one-shot timer that will execute 'action' 'delay_ms' milliseconds
@@ -111,16 +104,43 @@ class TimerDaemon final {
                                              const Action& action,
                                              DescriptorPtr* desc);
 
+  // Returns the timer delivery statistics.
+  static Stats GetStats() LOCKS_EXCLUDED(access_lock_);
+  // Returns a human-readable dump of the timer delivery statistics.
+  static std::string DumpStats() LOCKS_EXCLUDED(access_lock_);
+
  private:
-  TimerDaemon() : started_(false) {}
+  TimerDaemon();
 
-  // If there is an action to be executed at this moment of time a non-null
-  // pointer is returned.
-  DescriptorPtr GetAction();
+  // A timer whose action is to be executed and the time it was due.
+  struct DueAction {
+    DescriptorPtr desc;
+    absl::Time due_time;
+  };
+
+  // Advances the timing wheel to 'now', re-schedules the due periodic timers
+  // and returns the actions to be executed.
+  std::vector<DueAction> GetDueActions(absl::Time now)
+      EXCLUSIVE_LOCKS_REQUIRED(access_lock_);
+
+  // Executes a due action and updates the statistics.
+  void ExecuteAction(const DueAction& action) LOCKS_EXCLUDED(access_lock_);
 
   // Returns true if the timer daemon is stopped.
   bool IsStopped();
 
+  // Converts between absolute times and ticks of the timing wheel. Due times
+  // are rounded up, so a timer never fires early.
+  uint64 ToTick(absl::Time time, bool round_up) const;
+  absl::Time FromTick(uint64 tick) const;
+
+  // Main loops of the timer thread and of the worker threads.
+  void RunTimer() LOCKS_EXCLUDED(access_lock_);
+  void RunWorker() LOCKS_EXCLUDED(access_lock_);
+
+  static void* TimerThreadFunc(void* arg);
+  static void* WorkerThreadFunc(void* arg);
+
   static TimerDaemon* GetInstance() {
     static TimerDaemon* singleton = new TimerDaemon();
 
@@ -131,13 +151,35 @@ class TimerDaemon final {
                               Action action, DescriptorPtr* desc)
       LOCKS_EXCLUDED(access_lock_);
 
-  // A Mutex used to guard access to the list of pointers to timer requests and
-  // the started_ flag.
+  // A Mutex used to guard access to the timing wheel, the queue of actions to
+  // be executed and the started_ flag.
   mutable absl::Mutex access_lock_;
 
-  std::vector<DescriptorWeakPtr> timers_ GUARDED_BY(access_lock_);
+  // Signaled when a timer is requested or the daemon is stopped, to wake up
+  // the timer thread.
+  absl::CondVar timer_cond_;
+
+  // Signaled when an action is queued or the daemon is stopped, to wake up the
+  // worker threads.
+  absl::CondVar worker_cond_;
+
+  // The duration of a tick of the timing wheel and the time of tick 0.
+  const absl::Duration resolution_;
+  const absl::Time epoch_;
+
+  TimingWheel<DescriptorWeakPtr> timers_ GUARDED_BY(access_lock_);
+
+  // The tick the timer thread sleeps until, used to decide if the thread has
+  // to be woken up when a new timer is requested.
+  uint64 wakeup_tick_ GUARDED_BY(access_lock_);
+
+  // Due timers waiting for a worker thread.
+  std::deque<DueAction> queue_ GUARDED_BY(access_lock_);
+
+  Stats stats_ GUARDED_BY(access_lock_);
 
   pthread_t tid_ = 0;  // will not be destroyed before the thread is joined.
+  std::vector<pthread_t> worker_tids_;
 
   bool started_ GUARDED_BY(access_lock_);
 
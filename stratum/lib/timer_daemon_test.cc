@@ -4,13 +4,27 @@
 
 #include "stratum/lib/timer_daemon.h"
 
+#include <memory>
+#include <string>
+
+#include "absl/strings/str_cat.h"
 #include "absl/synchronization/mutex.h"
+#include "absl/synchronization/notification.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "gflags/gflags.h"
+#include "gmock/gmock.h"
 #include "gtest/gtest.h"
 #include "stratum/glue/status/status_test_util.h"
 
+DECLARE_int32(timer_daemon_late_threshold_us);
+DECLARE_int32(timer_daemon_worker_threads);
+
 namespace stratum {
 namespace hal {
 
+using ::testing::HasSubstr;
+
 class TimerDaemonTest : public ::testing::Test {
  protected:
   TimerDaemonTest() {}
@@ -38,18 +52,6 @@ class TimerDaemonTest : public ::testing::Test {
 
   void TearDown() override { ASSERT_OK(TimerDaemon::Stop()); }
 
-  TimerDaemon::DescriptorPtr GetTimerDescriptorPtr(const absl::Time when) {
-    TimerDaemon::DescriptorPtr desc = std::make_shared<TimerDaemon::Descriptor>(
-        /* repeat = */ false, []() { return ::util::OkStatus(); });
-    desc->due_time_ = when;
-    return desc;
-  }
-
-  TimerDaemon::DescriptorWeakPtr GetTimerDescriptorWeakPtr(
-      const TimerDaemon::DescriptorPtr& desc) {
-    return TimerDaemon::DescriptorWeakPtr(desc);
-  }
-
   // A counter used to check if timers are executed in correct order. Each timer
   // checks if the 'count_' has expected value and then increments it.
   // This simple mechanism allows for checking if all timers are handled as
@@ -57,63 +59,8 @@ class TimerDaemonTest : public ::testing::Test {
   int count_ GUARDED_BY(access_lock_);
   // A Mutex used to guard access to the 'count_'.
   mutable absl::Mutex access_lock_;
-
-  // A comparator used internally by the TimerSevice to compare timestamps.
-  // This class is private, so, it is instantiated here to allow access by
-  // relevant tests.
-  TimerDaemon::TimerDescriptorComparator cmp_;
 };
 
-TEST_F(TimerDaemonTest, CompareSmallerBigger) {
-  absl::Time now = absl::Now();
-  auto desc1 = GetTimerDescriptorPtr(now);
-  auto desc2 = GetTimerDescriptorPtr(now + absl::Milliseconds(10));
-
-  auto weak1 = GetTimerDescriptorWeakPtr(desc1);
-  auto weak2 = GetTimerDescriptorWeakPtr(desc2);
-
-  // 0 > 10
-  EXPECT_FALSE(cmp_(weak1, weak2));
-
-  desc2.reset();
-  // 0 > expired 10
-  EXPECT_FALSE(cmp_(weak1, weak2));
-
-  desc1.reset();
-  // expired 0 > expired 10
-  EXPECT_FALSE(cmp_(weak1, weak2));
-
-  desc2 = GetTimerDescriptorPtr(now + absl::Milliseconds(10));
-  weak2 = GetTimerDescriptorWeakPtr(desc2);
-  // expired 0 > 10
-  EXPECT_TRUE(cmp_(weak1, weak2));
-}
-
-TEST_F(TimerDaemonTest, CompareBiggerSmaller) {
-  absl::Time now = absl::Now();
-  auto desc1 = GetTimerDescriptorPtr(now + absl::Milliseconds(10));
-  auto desc2 = GetTimerDescriptorPtr(now);
-
-  auto weak1 = GetTimerDescriptorWeakPtr(desc1);
-  auto weak2 = GetTimerDescriptorWeakPtr(desc2);
-
-  // 10 > 0
-  EXPECT_TRUE(cmp_(weak1, weak2));
-
-  desc2.reset();
-  // 10 > expired 0
-  EXPECT_FALSE(cmp_(weak1, weak2));
-
-  desc1.reset();
-  // expired 10 > expired 0
-  EXPECT_FALSE(cmp_(weak1, weak2));
-
-  desc2 = GetTimerDescriptorPtr(now);
-  weak2 = GetTimerDescriptorWeakPtr(desc2);
-  // expired 10 > 0
-  EXPECT_TRUE(cmp_(weak1, weak2));
-}
-
 TEST_F(TimerDaemonTest, CreateOneShot) {
   // This test verifies that TimerDaemon does create one-shot timer.
   TimerDaemon::DescriptorPtr desc;
@@ -152,6 +99,110 @@ TEST_F(TimerDaemonTest, CreateTwoOneShots) {
 
 TEST_F(TimerDaemonTest, CreatePeriodic) {
   // This test verifies that TimerDaemon does create periodic timer.
+  TimerDaemon::DescriptorPtr desc;
+  const absl::Time start = absl::Now();
+  ASSERT_OK(TimerDaemon::RequestPeriodicTimer(
+      0, 100,
+      [&]() {
+        absl::WriterMutexLock l(&access_lock_);
+        count_++;
+        return ::util::OkStatus();
+      },
+      &desc));
+  {
+    absl::WriterMutexLock l(&access_lock_);
+    EXPECT_TRUE(access_lock_.AwaitWithTimeout(
+        absl::Condition(
+            +[](int* count) { return *count >= 3; }, &count_),
+        absl::Seconds(10)));
+  }
+  // Executed at 0, 100 and 200ms.
+  EXPECT_GE(absl::Now() - start, absl::Milliseconds(200));
+  desc.reset();
+}
+
+TEST_F(TimerDaemonTest, CanceledTimerIsNotExecuted) {
+  // This test verifies that a timer is canceled by releasing its descriptor.
+  TimerDaemon::DescriptorPtr desc;
+  ASSERT_OK(TimerDaemon::RequestOneShotTimer(
+      100,
+      [&]() {
+        absl::WriterMutexLock l(&access_lock_);
+        count_++;
+        return ::util::OkStatus();
+      },
+      &desc));
+  desc.reset();
+  usleep(200000);
+  absl::WriterMutexLock l(&access_lock_);
+  EXPECT_EQ(count_, 0);
+}
+
+TEST_F(TimerDaemonTest, SlowActionDoesNotDelayOtherTimers) {
+  // This test verifies that with multiple worker threads, a slow action does
+  // not delay the timers due after it.
+  ::gflags::FlagSaver flag_saver;
+  FLAGS_timer_daemon_worker_threads = 2;
+  ASSERT_OK(TimerDaemon::Stop());
+  ASSERT_OK(TimerDaemon::Start());
+  auto release = std::make_shared<absl::Notification>();
+  auto released = std::make_shared<absl::Notification>();
+  TimerDaemon::DescriptorPtr desc1, desc2;
+  ASSERT_OK(TimerDaemon::RequestOneShotTimer(
+      10,
+      [release, released]() {
+        release->WaitForNotification();
+        released->Notify();
+        return ::util::OkStatus();
+      },
+      &desc1));
+  ASSERT_OK(TimerDaemon::RequestOneShotTimer(
+      50,
+      [&]() {
+        absl::WriterMutexLock l(&access_lock_);
+        count_++;
+        return ::util::OkStatus();
+      },
+      &desc2));
+  {
+    absl::WriterMutexLock l(&access_lock_);
+    EXPECT_TRUE(access_lock_.AwaitWithTimeout(
+        absl::Condition(
+            +[](int* count) { return *count == 1; }, &count_),
+        absl::Seconds(10)));
+  }
+  // Let the slow action finish before the daemon is stopped.
+  release->Notify();
+  EXPECT_TRUE(released->WaitForNotificationWithTimeout(absl::Seconds(10)));
+}
+
+TEST_F(TimerDaemonTest, LateExecutionsAreCounted) {
+  // This test verifies that the lag of the executions is tracked.
+  ::gflags::FlagSaver flag_saver;
+  FLAGS_timer_daemon_late_threshold_us = 0;
+  const TimerDaemon::Stats before = TimerDaemon::GetStats();
+  TimerDaemon::DescriptorPtr desc;
+  ASSERT_OK(TimerDaemon::RequestOneShotTimer(
+      10, []() { return ::util::OkStatus(); }, &desc));
+  usleep(100000);
+  const TimerDaemon::Stats after = TimerDaemon::GetStats();
+  EXPECT_EQ(before.executions + 1, after.executions);
+  EXPECT_EQ(before.late_executions + 1, after.late_executions);
+  EXPECT_GT(after.total_lag, before.total_lag);
+  EXPECT_GE(after.max_lag, after.total_lag - before.total_lag);
+}
+
+TEST_F(TimerDaemonTest, DumpStats) {
+  TimerDaemon::DescriptorPtr desc;
+  ASSERT_OK(TimerDaemon::RequestOneShotTimer(
+      10, []() { return ::util::OkStatus(); }, &desc));
+  usleep(100000);
+  const TimerDaemon::Stats stats = TimerDaemon::GetStats();
+  const std::string dump = TimerDaemon::DumpStats();
+  EXPECT_THAT(dump, HasSubstr(absl::StrCat(stats.executions, " executions, ",
+                                           stats.late_executions, " late")));
+  EXPECT_THAT(dump, HasSubstr(absl::StrCat(stats.skipped_periods,
+                                           " skipped periods, lag avg ")));
 }
 
 TEST_F(TimerDaemonTest, StartIdempotent) {
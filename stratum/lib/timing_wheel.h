@@ -0,0 +1,178 @@
+// Copyright 2018-present Open Networking Foundation
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef STRATUM_LIB_TIMING_WHEEL_H_
+#define STRATUM_LIB_TIMING_WHEEL_H_
+
+#include <stddef.h>
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include "stratum/glue/integral_types.h"
+
+namespace stratum {
+namespace hal {
+
+// A hierarchical timing wheel. Values are inserted with the tick at which they
+// expire and are handed back by Advance() once the wheel reaches that tick.
+// Insertion is O(1) and advancing costs O(1) per tick that has work to do, as
+// runs of ticks without any expiration are skipped.
+//
+// The wheel has kLevels levels of kSlots slots. A slot of level L covers
+// kSlots^L ticks. A value is kept at the lowest level whose range covers its
+// expiration and is moved ("cascaded") to a lower level when the wheel enters
+// the range of its slot. Expirations further away than kMaxDelta ticks are
+// parked in the top level and re-inserted when they get closer.
+//
+// This class is not thread-safe.
+template <typename T>
+class TimingWheel {
+ public:
+  static constexpr int kLevels = 4;
+  static constexpr int kSlotBits = 6;
+  static constexpr int kSlots = 1 << kSlotBits;
+  static constexpr uint64 kMaxDelta = (1ULL << (kLevels * kSlotBits)) - 1;
+
+  TimingWheel() : now_(0), size_(0), counts_() {}
+
+  // Returns the tick the wheel has been advanced to.
+  uint64 Now() const { return now_; }
+
+  // Returns the number of values in the wheel.
+  size_t Size() const { return size_; }
+
+  // Adds 'value' expiring at 'tick'. Values expiring at or before Now() are
+  // returned by the next call to Advance().
+  void Insert(uint64 tick, T value) {
+    ++size_;
+    Place(Entry{tick, std::move(value)});
+  }
+
+  // Advances the wheel to 'tick' and appends all the values that expired on
+  // the way to 'expired', in the order of their expiration ticks.
+  void Advance(uint64 tick, std::vector<T>* expired) {
+    TakeAll(&due_, expired);
+    while (now_ < tick) {
+      // Jump to the next tick at which a slot of the lowest non-empty level
+      // has to be processed.
+      int level = 0;
+      while (level < kLevels && counts_[level] == 0) ++level;
+      if (level == kLevels) {
+        now_ = tick;
+        break;
+      }
+      uint64 next = level == 0 ? now_ + 1
+                               : ((now_ >> (level * kSlotBits)) + 1)
+                                     << (level * kSlotBits);
+      if (next > tick) {
+        now_ = tick;
+        break;
+      }
+      now_ = next;
+      // Cascade the slots whose range starts at this tick, top-down, so the
+      // values can move down several levels at once.
+      for (int l = kLevels - 1; l > 0; --l) {
+        if ((now_ & ((1ULL << (l * kSlotBits)) - 1)) != 0) continue;
+        std::vector<Entry> entries;
+        entries.swap(slots_[l][SlotIndex(now_, l)]);
+        counts_[l] -= entries.size();
+        for (auto& entry : entries) Place(std::move(entry));
+      }
+      auto* slot = &slots_[0][SlotIndex(now_, 0)];
+      counts_[0] -= slot->size();
+      TakeAll(slot, expired);
+      TakeAll(&due_, expired);
+    }
+  }
+
+  // Returns the next tick at which Advance() has to be called to process the
+  // wheel, or false if the wheel is empty. The returned tick is either an
+  // expiration or a cascade of a slot that contains values.
+  bool NextEventTick(uint64* tick) const {
+    if (size_ == 0) return false;
+    if (!due_.empty()) {
+      *tick = now_;
+      return true;
+    }
+    // A slot of a higher level may start before the earliest expiration of
+    // the lower levels, so the earliest slot of every level is considered.
+    bool found = false;
+    for (int level = 0; level < kLevels; ++level) {
+      if (counts_[level] == 0) continue;
+      const int shift = level * kSlotBits;
+      // Slots of level 0 are always ahead of now. A slot of a higher level may
+      // be the current one again after a full rotation.
+      for (int i = 1; i <= kSlots; ++i) {
+        const uint64 start = ((now_ >> shift) + i) << shift;
+        if (slots_[level][SlotIndex(start, level)].empty()) continue;
+        if (!found || start < *tick) *tick = start;
+        found = true;
+        break;
+      }
+    }
+    return found;
+  }
+
+  // Removes all the values from the wheel. Now() is not changed.
+  void Clear() {
+    for (auto& level : slots_) {
+      for (auto& slot : level) slot.clear();
+    }
+    due_.clear();
+    std::fill(counts_, counts_ + kLevels, 0);
+    size_ = 0;
+  }
+
+ private:
+  struct Entry {
+    uint64 tick;
+    T value;
+  };
+
+  static int SlotIndex(uint64 tick, int level) {
+    return (tick >> (level * kSlotBits)) & (kSlots - 1);
+  }
+
+  // Puts the entry in the slot covering its expiration.
+  void Place(Entry entry) {
+    if (entry.tick <= now_) {
+      due_.push_back(std::move(entry));
+      return;
+    }
+    const uint64 delta = std::min(entry.tick - now_, kMaxDelta);
+    const uint64 tick = now_ + delta;
+    int level = 0;
+    while (level < kLevels - 1 &&
+           delta >= (1ULL << ((level + 1) * kSlotBits))) {
+      ++level;
+    }
+    slots_[level][SlotIndex(tick, level)].push_back(std::move(entry));
+    ++counts_[level];
+  }
+
+  // Moves the values of all entries to 'expired'.
+  void TakeAll(std::vector<Entry>* entries, std::vector<T>* expired) {
+    if (entries->empty()) return;
+    std::stable_sort(
+        entries->begin(), entries->end(),
+        [](const Entry& lhs, const Entry& rhs) { return lhs.tick < rhs.tick; });
+    for (auto& entry : *entries) expired->push_back(std::move(entry.value));
+    size_ -= entries->size();
+    entries->clear();
+  }
+
+  uint64 now_;
+  size_t size_;
+  // The number of entries in each level, used to skip empty levels.
+  size_t counts_[kLevels];
+  std::vector<Entry> slots_[kLevels][kSlots];
+  // Entries whose expiration was reached while being inserted or cascaded.
+  std::vector<Entry> due_;
+};
+
+}  // namespace hal
+}  // namespace stratum
+
+#endif  // STRATUM_LIB_TIMING_WHEEL_H_
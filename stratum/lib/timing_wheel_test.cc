@@ -0,0 +1,109 @@
+// Copyright 2018-present Open Networking Foundation
+// SPDX-License-Identifier: Apache-2.0
+
+#include "stratum/lib/timing_wheel.h"
+
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace stratum {
+namespace hal {
+
+using ::testing::ElementsAre;
+using ::testing::IsEmpty;
+
+TEST(TimingWheelTest, EmptyWheel) {
+  TimingWheel<int> wheel;
+  uint64 tick;
+  EXPECT_FALSE(wheel.NextEventTick(&tick));
+  std::vector<int> expired;
+  wheel.Advance(1000, &expired);
+  EXPECT_THAT(expired, IsEmpty());
+  EXPECT_EQ(1000U, wheel.Now());
+}
+
+TEST(TimingWheelTest, ValuesExpireInOrder) {
+  TimingWheel<int> wheel;
+  wheel.Insert(30, 3);
+  wheel.Insert(10, 1);
+  wheel.Insert(20, 2);
+  EXPECT_EQ(3U, wheel.Size());
+
+  std::vector<int> expired;
+  wheel.Advance(9, &expired);
+  EXPECT_THAT(expired, IsEmpty());
+  wheel.Advance(20, &expired);
+  EXPECT_THAT(expired, ElementsAre(1, 2));
+  wheel.Advance(100, &expired);
+  EXPECT_THAT(expired, ElementsAre(1, 2, 3));
+  EXPECT_EQ(0U, wheel.Size());
+}
+
+TEST(TimingWheelTest, ValuesInThePastExpireOnNextAdvance) {
+  TimingWheel<int> wheel;
+  std::vector<int> expired;
+  wheel.Advance(100, &expired);
+  wheel.Insert(50, 1);
+  wheel.Insert(100, 2);
+  uint64 tick;
+  ASSERT_TRUE(wheel.NextEventTick(&tick));
+  EXPECT_EQ(100U, tick);
+  wheel.Advance(100, &expired);
+  EXPECT_THAT(expired, ElementsAre(1, 2));
+}
+
+TEST(TimingWheelTest, ValuesAreCascadedFromHigherLevels) {
+  // One value per level of the wheel and one beyond its range.
+  const std::vector<uint64> ticks = {
+      5, 100, 5000, 300000, TimingWheel<int>::kMaxDelta + 12345};
+  TimingWheel<int> wheel;
+  for (size_t i = 0; i < ticks.size(); ++i) wheel.Insert(ticks[i], i);
+
+  for (size_t i = 0; i < ticks.size(); ++i) {
+    std::vector<int> expired;
+    wheel.Advance(ticks[i] - 1, &expired);
+    EXPECT_THAT(expired, IsEmpty()) << "tick " << ticks[i];
+    wheel.Advance(ticks[i], &expired);
+    EXPECT_THAT(expired, ElementsAre(i)) << "tick " << ticks[i];
+  }
+  EXPECT_EQ(0U, wheel.Size());
+}
+
+TEST(TimingWheelTest, NextEventTickNeverSkipsAnExpiration) {
+  TimingWheel<int> wheel;
+  std::vector<int> expired;
+  wheel.Advance(4000, &expired);
+  // Expires at a lower level than the cascade of the second value.
+  wheel.Insert(4050, 1);
+  wheel.Insert(4096 + 4096 + 10, 2);
+
+  // Advancing from event to event must find both values, exactly on time.
+  std::vector<uint64> expiration_ticks;
+  uint64 tick;
+  while (wheel.NextEventTick(&tick)) {
+    ASSERT_GT(tick, wheel.Now());
+    size_t before = expired.size();
+    wheel.Advance(tick, &expired);
+    if (expired.size() > before) expiration_ticks.push_back(tick);
+  }
+  EXPECT_THAT(expired, ElementsAre(1, 2));
+  EXPECT_THAT(expiration_ticks, ElementsAre(4050, 4096 + 4096 + 10));
+}
+
+TEST(TimingWheelTest, ClearRemovesAllValues) {
+  TimingWheel<int> wheel;
+  wheel.Insert(10, 1);
+  wheel.Insert(100000, 2);
+  wheel.Clear();
+  EXPECT_EQ(0U, wheel.Size());
+  uint64 tick;
+  EXPECT_FALSE(wheel.NextEventTick(&tick));
+  std::vector<int> expired;
+  wheel.Advance(200000, &expired);
+  EXPECT_THAT(expired, IsEmpty());
+}
+
+}  // namespace hal
+}  // namespace stratum